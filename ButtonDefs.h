@@ -168,4 +168,76 @@ BUTTON gTextButton = {
 	COLOR_NONE
 };
 
-BUTTON* gButtons[] = { &gNewButton, &gDelayButton, &gSaveButton, &gCopyButton, &gHilighterButton, &gRectangleButton, &gArrowButton, &gRedactButton, &gTextButton };
+BUTTON gPenButton = {
+	{ 650, 0, 720, 52 },
+	L"Pen",
+	NULL,
+	NULL,
+	IDB_PEN32x32RED,
+	IDB_PEN32x32D,
+	BUTTONSTATE_NORMAL,
+	0x50,				// Hotkey (P)
+	NULL,
+	FALSE,
+	BUTTON_PEN,
+	FALSE,
+	IDC_REDCROSSHAIR,
+	NULL,
+	COLOR_RED
+};
+
+BUTTON gEraserButton = {
+	{ 722, 0, 792, 52 },
+	L"Eraser",
+	NULL,
+	NULL,
+	IDB_ERASER32x32E,
+	IDB_ERASER32x32D,
+	BUTTONSTATE_NORMAL,
+	0x45,				// Hotkey (E)
+	NULL,
+	FALSE,
+	BUTTON_ERASER,
+	FALSE,
+	IDC_ERASERCURSOR,
+	NULL,
+	COLOR_NONE
+};
+
+BUTTON gSpotlightButton = {
+	{ 794, 0, 864, 52 },
+	L"Spotlight",
+	NULL,
+	NULL,
+	IDB_SPOTLIGHT32x32E,
+	IDB_SPOTLIGHT32x32D,
+	BUTTONSTATE_NORMAL,
+	0x46,				// Hotkey (F)
+	NULL,
+	FALSE,
+	BUTTON_SPOTLIGHT,
+	FALSE,
+	IDC_BLACKCROSSHAIR,
+	NULL,
+	COLOR_NONE
+};
+
+BUTTON gCalloutButton = {
+	{ 866, 0, 936, 52 },
+	L"Zoom 4x",
+	NULL,
+	NULL,
+	IDB_CALLOUT32x32E,
+	IDB_CALLOUT32x32D,
+	BUTTONSTATE_NORMAL,
+	0x4D,				// Hotkey (M)
+	NULL,
+	FALSE,
+	BUTTON_CALLOUT,
+	FALSE,
+	IDC_BLACKCROSSHAIR,
+	NULL,
+	COLOR_NONE
+};
+
+BUTTON* gButtons[] = { &gNewButton, &gDelayButton, &gSaveButton, &gCopyButton, &gHilighterButton, &gRectangleButton, &gArrowButton, &gRedactButton, &gTextButton, &gPenButton, &gEraserButton, &gSpotlightButton, &gCalloutButton };
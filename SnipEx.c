@@ -34,10 +34,10 @@
 
 #include <stdio.h>								// For doing stuff with strings
 
-#include <math.h>								// Needed to introduce some math to draw the arrow head for the arrow tool
-
 #include "resource.h"							// Images, cursors, etc.
 
+#include "SnipExStroke.h"						// Turns mouse movement into rows of pixels to draw
+
 #include "SnipEx.h"								// My custom definitions
 
 #include "ButtonDefs.h"							// Buttons!
@@ -48,6 +48,44 @@
 
 #include "SnipExTray.h"							// Background mode for Win+Shift+S intercept on Win10
 
+#include "SnipExCoverage.h"						// Remembers which pixels the hilighter has already touched
+
+#include "SnipExBlend.h"							// Pixel kernels for the drawing tools
+
+#include "SnipExTextLines.h"						// Finds lines of text in the snip for the hilighter to snap to
+
+#include "SnipExFilter.h"							// Pixelate and blur filters for the redact tool
+
+#include "SnipExMatch.h"							// Finds the other places in the snip that look like what was just redacted
+
+#include "SnipExRaster.h"						// Smoothed boxes, arrows and pen strokes
+
+#include "SnipExBrush.h"						// Round, chisel and square tips for the hilighter and redact tool
+
+#include "SnipExPen.h"							// Smooths and simplifies the pen's strokes
+
+#include "SnipExFlood.h"							// Finds areas of similar color for Shift+click to fill or redact
+
+#include "SnipExOverlay.h"							// Works out which parts of the capture overlay change as the selection is dragged
+
+#include "SnipExCapture.h"							// Works out how to snip just one region of the desktop, such as one monitor
+
+#include "SnipExScreen.h"							// Captures the screen
+
+#include "SnipExReplay.h"							// Plays back captures saved to disk, for --replay
+
+#include "SnipExSnap.h"							// Finds the edges in the screenshot for the capture selection to snap to
+
+#include "SnipExAnalysis.h"						// Works things out about the screenshot in the background during a capture
+
+#include "SnipExResample.h"						// Magnifies part of the snip for the callout tool
+
+#include "SnipExJournal.h"						// Keeps the tiles that recent changes drew on, for fast undo
+
+#include "SnipExSession.h"						// Writes the snip and its changes to disk as they happen, to recover them after a crash
+
+#include "SnipExDocument.h"						// The annotations on the snip, for drawing and undo
+
 APPSTATE gAppState = APPSTATE_BEFORECAPTURE;	// To track the overall state of the application
 
 BOOL gMainWindowIsRunning;						// Set this to FALSE to exit the app immediately.
@@ -68,25 +106,73 @@ INT16  gDisplayLeft;							// Depending on how the monitors are arranged, the le
 
 INT16  gDisplayTop;								// Depending on how the monitors are arranged, the top-most coordinate might not be zero.
 
-UINT16 gStartingMainWindowWidth  = 668;			// The beginning width of the tool window - just enough to fit all the buttons.
+CAPTURESOURCE gCaptureSource;					// Where snips come from: the screen, or frames on disk with --replay.
+
+ANALYSIS gAnalysis;								// Works things out about gCleanScreenShot in the background during a capture.
+
+UINT16 gStartingMainWindowWidth  = 956;			// The beginning width of the tool window - just enough to fit all the buttons.
 
 UINT16 gStartingMainWindowHeight = 92;			// The beginning height of the tool window - just enough to fit the buttons.
 
 HBITMAP gCleanScreenShot;						// A clean copy of the screenshot from before we started drawing on it.
 
-HBITMAP gScratchBitmap;							// For use during drawing.
-
 RECT gCaptureSelectionRectangle;				// The rectangle the user draws with the mouse to select a subsection of the screen.
 
+RECT gLastCaptureRegion;						// Where the last snip was taken from, in screen coordinates, for "Repeat last region".
+
 int gCaptureWidth;								// Width in pixels of the user's captured snip.
 
 int gCaptureHeight;								// Height in pixels of the user's captured snip.
 
 BOOL gLeftMouseButtonIsDown;					// When the user is drawing with the mouse, the left mouse button is down.
 
-UINT8   gCurrentSnipState;						// An array of bitmap states that we can revert back to, so we can undo changes. ctrl-z.
+HBITMAP gSnipBitmap;							// The snip with every annotation drawn in. This is what gets painted, saved and copied. A top-down 32bpp DIB section.
+
+UINT32* gSnipBits;								// The pixels of gSnipBitmap. Call GdiFlush before touching them if GDI has drawn on the bitmap.
+
+HANDLE gTextLineThread;							// Finds the lines of text in gTextLinePixels for the hilighter to snap to. NULL if it was never started.
+
+UINT32* gTextLinePixels;						// A copy of gSnipBits for gTextLineThread to look at, since the snip keeps changing while it works.
+
+TEXTLINES gTextLines;							// The lines of text that gTextLineThread found. Don't touch them until it has finished.
+
+DOCUMENT gDocument;								// The untouched snip and the list of annotations on top of it, so we can undo changes. ctrl-z.
+
+REDACTMODE gRedactMode;							// Whether the redact tool blacks out, pixelates or blurs.
+
+UINT32* gRedactSource;							// A pixelated or blurred copy of gSnipBits that the redact tool copies from. NULL when blacking out.
 
-HBITMAP gSnipStates[32];						// Snip state 0 will always be the unaltered clip right as the user first took it.
+DWORD gRedactEveryOccurrence;					// After a redact stroke, should we look for the same pixels elsewhere in the snip and offer to redact them too?
+
+UINT32* gRedactOriginal;						// A copy of gSnipBits from before the redact stroke, for gRedactEveryOccurrence. NULL otherwise.
+
+HANDLE gRedactSearchThread;						// Looks for the other places in the snip that look like what was just redacted. NULL if there's no search.
+
+const ANNOTATION* gRedactSearchStroke;			// The redact stroke that gRedactSearchThread is looking for. Only compared with the top of gDocument until the search is done.
+
+UINT32 gRedactSearchStep;						// The step of gRedactSearchStroke, in case a newer annotation ends up where it was in memory.
+
+RECT gRedactSearchBounds;						// The bounds of gRedactSearchStroke, copied so that gRedactSearchThread never touches the stroke.
+
+UINT32* gRedactSearchPixels;					// gRedactOriginal, handed over to gRedactSearchThread, which frees it.
+
+UINT32* gRedactSearchSource;					// gRedactSource, handed over so that the matches can be redacted the same way as the stroke.
+
+MATCHES gRedactSearchMatches;					// What gRedactSearchThread found. Don't touch them until it has finished.
+
+DWORD gBrushTip = BRUSHTIP_SQUARE;				// The BRUSHTIP that the hilighter and redact tool draw with. Picked from the window menu.
+
+DWORD gBrushSize = BRUSH_HEIGHT;				// How tall the hilighter and redact brushes are, in pixels. [ and ] make them smaller and bigger.
+
+DWORD gUndoMemory = UNDO_MEMORY_MB;			// How many megabytes of the snip undo can keep copies of, so that it can put changes back without redrawing them.
+
+SESSION gSession;								// Where gDocument and every change to it are written as they happen, so that they can be recovered if SnipEx crashes.
+
+DWORD gSessionRecovery;							// Does the user want the snip written to gSession as it changes? Off unless the user turns it on, since the file holds the snip as it was taken, before anything was redacted.
+
+INT32 gCalloutZoom = 4;							// How many times bigger the callout tool makes its copy. Right-clicking the button cycles through 2x, 3x, 4x, 6x and 8x.
+
+SHAPE gShapePreview;							// The box, arrow, spotlight or callout that's being dragged out. It's drawn over the snip in WM_PAINT, and only drawn into the snip on WM_LBUTTONUP.
 
 HBITMAP gUACIcon;								// The UAC icon that sits next to the "Replace Windows Snipping Tool with SnipEx" menu item.
 
@@ -102,6 +188,10 @@ wchar_t gAutoSavePath[MAX_PATH];				// The folder where auto-saved snips go.
 
 DWORD gHotkeyIntercept;						// Should SnipEx intercept Win+Shift+S in the background?
 
+DWORD gGammaCorrectBlending;					// Should the hilighter, boxes, arrows, capture overlay and drop shadow blend in linear light instead of in sRGB? Off unless the user turns it on.
+
+HBITMAP gDimmedScreenShot;						// gCleanScreenShot, darkened, for the parts of the capture overlay outside of the selection.
+
 BOOL gStartedMinimized;							// Was SnipEx launched with --minimized (tray mode)?
 
 DWORD gPendingCaptureMode;						// 0=normal (manual rectangle), 1=current monitor, 2=all monitors
@@ -149,10 +239,14 @@ int CALLBACK WinMain(_In_ HINSTANCE Instance, _In_opt_ HINSTANCE PreviousInstanc
 		return(0);
 	}
 
-	// Check if started in tray/minimized mode (auto-start with Windows).
+	InitializeBlendTables();
+
+	// Check if started in tray/minimized mode (auto-start with Windows), or asked to replay captures from disk.
 	{
 		int ArgumentCount = 0;
 
+		BOOL ReplayFailed = FALSE;
+
 		LPWSTR* Arguments = CommandLineToArgvW(GetCommandLineW(), &ArgumentCount);
 
 		if (Arguments != NULL)
@@ -162,13 +256,29 @@ int CALLBACK WinMain(_In_ HINSTANCE Instance, _In_opt_ HINSTANCE PreviousInstanc
 				if (_wcsicmp(Arguments[Index], L"--minimized") == 0)
 				{
 					gStartedMinimized = TRUE;
+				}
+				else if (_wcsicmp(Arguments[Index], L"--replay") == 0 && Index + 1 < ArgumentCount)
+				{
+					Index++;
 
-					break;
+					if (OpenReplaySource(Arguments[Index], &gCaptureSource) == FALSE)
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: Failed to open replay manifest %s!\n", __FUNCTIONW__, __LINE__, Arguments[Index]);
+
+						ReplayFailed = TRUE;
+					}
 				}
 			}
 
 			LocalFree(Arguments);
 		}
+
+		if (ReplayFailed)
+		{
+			MessageBoxW(NULL, L"Failed to open the replay manifest!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
+
+			return(0);
+		}
 	}
 
 	if ((gFont = GetStockObject(DEFAULT_GUI_FONT)) == NULL)
@@ -187,20 +297,15 @@ int CALLBACK WinMain(_In_ HINSTANCE Instance, _In_opt_ HINSTANCE PreviousInstanc
 	// in reverse order, the left-most X coordinate may be e.g. negative 1920! In other words, 0,0 may not 
 	// necessarily be the top-left corner of the user's viewing area.
 	
-	gDisplayWidth  = (UINT16)GetSystemMetrics(SM_CXVIRTUALSCREEN);
-
-	gDisplayHeight = (UINT16)GetSystemMetrics(SM_CYVIRTUALSCREEN);
-
-	gDisplayLeft   = (INT16)GetSystemMetrics(SM_XVIRTUALSCREEN);
-
-	gDisplayTop    = (INT16)GetSystemMetrics(SM_YVIRTUALSCREEN);
-
-	if (gDisplayWidth == 0 || gDisplayHeight == 0)
+	// Unless captures are being replayed, they come from the screen, and the layout is whatever it is right now.
+	if (gCaptureSource.Capture == NULL && OpenScreenSource(&gCaptureSource) == FALSE)
 	{
 		MessageBoxW(NULL, L"Failed to retrieve display area via GetSystemMetrics!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
 
 		return(0);
 	}
+	
+	SetDisplayArea();
 
 	MyOutputDebugStringW(L"[%s] Line %d: Detected a screen area of %dx%d.\n", __FUNCTIONW__, __LINE__, gDisplayWidth, gDisplayHeight);
 
@@ -452,6 +557,12 @@ int CALLBACK WinMain(_In_ HINSTANCE Instance, _In_opt_ HINSTANCE PreviousInstanc
 
 	AdjustWindowSizeForThickTitleBars();
 
+	// Another program may already have this hotkey, in which case the menu item still works.
+	if (RegisterHotKey(gMainWindowHandle, HOTKEY_REPEATREGION, MOD_CONTROL | MOD_ALT | MOD_SHIFT | MOD_NOREPEAT, 'R') == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: RegisterHotKey failed! Error 0x%08lx. Ctrl+Alt+Shift+R will not repeat the last region.\n", __FUNCTIONW__, __LINE__, GetLastError());
+	}
+
 	// Start hotkey intercept if enabled and needed (Win10).
 	if (gHotkeyIntercept && IsHotkeyInterceptNeeded())
 	{
@@ -469,6 +580,9 @@ int CALLBACK WinMain(_In_ HINSTANCE Instance, _In_opt_ HINSTANCE PreviousInstanc
 		}
 	}
 
+	// Offer to put back the snip that was being worked on if SnipEx crashed last time.
+	RecoverSession();
+
 	gMainWindowIsRunning = TRUE;
 
 	MSG MainWindowMessage      = { 0 };
@@ -512,6 +626,13 @@ int CALLBACK WinMain(_In_ HINSTANCE Instance, _In_opt_ HINSTANCE PreviousInstanc
 		Sleep(1); // Could be anywhere from 0.5ms to 15.6ms
 	}
 
+	// SnipEx is closing normally, so the snip doesn't need recovering.
+	CloseSession(&gSession, TRUE);
+
+	StopAnalysis(&gAnalysis);
+
+	CloseCaptureSource(&gCaptureSource);
+
 	return(0);
 }
 
@@ -526,9 +647,15 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 	static POINT PreviousMousePos;
 
-	static SMALLPOINT HilighterPixelsAlreadyDrawn[32768] = { 0 }; // 128k of memory
+	static INT32 HilightBandTop;					// The top and height in snip coordinates of the band that the hilighter or redact brush moves along, fixed for the whole stroke.
+
+	static INT32 HilightBandHeight;
+
+	static INT32 StrokeBrushWidth;					// The width of the hilighter or redact brush, fixed for the whole stroke.
 
-	static UINT16 HilighterPixelsAlreadyDrawnCounter = 0;	
+	static ANNOTATION* CurrentStroke;				// The hilight, redact or pen stroke that is being drawn, if there is one.
+
+	static PENFILTER PenFilter;						// Smooths the mouse samples of the pen stroke that is being drawn.
 
 	switch (Message)
 	{
@@ -544,16 +671,52 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 			break;
 		}
+		case WM_HOTKEY:
+		{
+			// Not while a snip is already being taken, or the delay is counting down to one.
+			if (WParam == HOTKEY_REPEATREGION && (gAppState == APPSTATE_BEFORECAPTURE || gAppState == APPSTATE_AFTERCAPTURE))
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: Repeat last region hotkey pressed.\n", __FUNCTIONW__, __LINE__);
+
+				if (RepeatLastRegion() == FALSE)
+				{
+					gMainWindowIsRunning = FALSE;
+
+					CRASH(0);
+				}
+			}
+
+			break;
+		}
+		case WM_REDACT_MATCHES_FOUND:
+		{
+			RedactEveryOccurrence();
+
+			break;
+		}
 		case WM_TRAYICON:
 		{
 			HandleTrayIconMessage(Window, WParam, LParam);
 
 			break;
 		}
+		case WM_DISPLAYCHANGE:
+		{
+			// Not in the middle of a snip, whose screenshot and overlay are the size of the old desktop. The layout is
+			// refreshed again before the next snip anyway.
+			if (gAppState == APPSTATE_BEFORECAPTURE || gAppState == APPSTATE_AFTERCAPTURE)
+			{
+				RefreshDisplayLayout();
+			}
+
+			break;
+		}
 		case WM_CLOSE:
 		{
 			StopHotkeyIntercept();
 
+			UnregisterHotKey(gMainWindowHandle, HOTKEY_REPEATREGION);
+
 			PostQuitMessage(0);
 
 			gMainWindowIsRunning = FALSE;
@@ -562,39 +725,43 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 		}
 		case WM_KEYDOWN:
 		{
-			// Ctrl+Z, Undo
+			// Ctrl+Z, Undo. Ctrl+Y or Ctrl+Shift+Z, Redo.
 			if ((WParam == 0x5A) && GetKeyState(VK_CONTROL) && (gAppState == APPSTATE_AFTERCAPTURE) && !CurrentlyDrawing)
 			{	
-				if (gCurrentSnipState > 0)
+				if (GetKeyState(VK_SHIFT) & 0x8000)
 				{
-					gCurrentSnipState--;
-
-					MyOutputDebugStringW(L"[%s] Line %d: Deleting gSnipStates[%d]\n", __FUNCTIONW__, __LINE__, gCurrentSnipState + 1);
-
-					memset(HilighterPixelsAlreadyDrawn, 0, sizeof(HilighterPixelsAlreadyDrawn));
-
-					HilighterPixelsAlreadyDrawnCounter = 0;
-
-					if (DeleteObject(gSnipStates[gCurrentSnipState + 1]) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject failed!\n", __FUNCTIONW__, __LINE__);
+					RedoChange();
+				}
+				else
+				{
+					UndoChange();
+				}
+			}
 
-						CRASH(0);
-					}
+			if ((WParam == 0x59) && GetKeyState(VK_CONTROL) && (gAppState == APPSTATE_AFTERCAPTURE) && !CurrentlyDrawing)
+			{
+				RedoChange();
+			}
 
-					gSnipStates[gCurrentSnipState + 1] = NULL;
+			// [ and ] make the hilighter and redact brushes smaller and bigger.
+			if ((WParam == VK_OEM_4 || WParam == VK_OEM_6) && !CurrentlyDrawing)
+			{
+				DWORD Step = max(gBrushSize / 8, 1);
 
-					if (gAutoCopy)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
+				if (WParam == VK_OEM_4)
+				{
+					gBrushSize = max(gBrushSize - Step, BRUSH_MIN_SIZE);
+				}
+				else
+				{
+					gBrushSize = min(gBrushSize + Step, BRUSH_MAX_SIZE);
+				}
 
-						if (CopyButton_Click() == FALSE)
-						{
-							MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
+				MyOutputDebugStringW(L"[%s] Line %d: Brush size is now %lu.\n", __FUNCTIONW__, __LINE__, gBrushSize);
 
-							CRASH(0);
-						}
-					}
+				if (SetSnipExRegValue(REG_BRUSHSIZENAME, &gBrushSize) != ERROR_SUCCESS)
+				{
+					CRASH(0);
 				}
 			}
 			
@@ -676,14 +843,42 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 				MousePosWhenDrawingStarted = Mouse;
 
-				if (gCurrentSnipState >= _countof(gSnipStates) - 1)
+				// The brush tools draw from here to the first place the mouse moves to. The brush is centered on the mouse.
+				HilightBandTop = Mouse.y - SNIP_CLIENT_TOP - ((INT32)gBrushSize / 2);
+
+				HilightBandHeight = (INT32)gBrushSize;
+
+				PreviousMousePos.y = HilightBandTop;
+
+				// If the stroke starts on or near a line of text, line the hilighter band up with the text.
+				if (gHilighterButton.SelectedTool == TRUE)
 				{
-					MessageBoxW(gMainWindowHandle, L"Maximum number of changes exceeded. Ctrl+Z to undo a change first.", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
+					const TEXTLINES* TextLines = GetDetectedTextLines();
 
-					break;
+					const TEXTLINE* TextLine = NULL;
+
+					if (TextLines != NULL)
+					{
+						TextLine = FindNearestTextLine(TextLines, Mouse.y - SNIP_CLIENT_TOP, TEXT_LINE_SNAP_DISTANCE);
+					}
+
+					if (TextLine != NULL)
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: Snapping hilighter to the line of text at %d, height %d.\n", __FUNCTIONW__, __LINE__, TextLine->Top, TextLine->Height);
+
+						HilightBandTop = TextLine->Top - 2;
+
+						HilightBandHeight = TextLine->Height + 4;
+
+						PreviousMousePos.y = HilightBandTop;
+					}
 				}
 
-				if (Mouse.x < 2 || Mouse.y < 52)
+				StrokeBrushWidth = GetBrushWidth(HilightBandHeight);
+
+				PreviousMousePos.x = Mouse.x - SNIP_CLIENT_LEFT - (StrokeBrushWidth / 2);
+
+				if (Mouse.x < SNIP_CLIENT_LEFT || Mouse.y < SNIP_CLIENT_TOP)
 				{
 					MyOutputDebugStringW(L"[%s] Line %d: Mouse was not over the screen capture area. Will not start drawing.\n", __FUNCTIONW__, __LINE__);
 
@@ -701,16 +896,109 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 					MyOutputDebugStringW(L"[%s] Line %d: Drawing started.\n", __FUNCTIONW__, __LINE__);
 				}
 
-				if (gScratchBitmap != NULL)
+				// Everything drawn from now until the mouse button comes back up is undone together.
+				BeginDocumentStep(&gDocument);
+
+				if (gRedactButton.SelectedTool == TRUE && gRedactMode != REDACTMODE_BLACK)
+				{
+					// Filter the whole snip once now, so that the stroke itself only has to copy pixels.
+					if (CreateRedactSource() == FALSE)
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: CreateRedactSource failed! Redacting with black instead.\n", __FUNCTIONW__, __LINE__);
+					}
+				}
+
+				// Shift+click with the pen or the redact tool fills or redacts the whole area of similar color under the mouse,
+				// such as a text box, instead of starting a stroke.
+				if ((gPenButton.SelectedTool == TRUE || gRedactButton.SelectedTool == TRUE) && (GetKeyState(VK_SHIFT) & 0x8000))
+				{
+					POINT Point = { Mouse.x - SNIP_CLIENT_LEFT, Mouse.y - SNIP_CLIENT_TOP };
+
+					FillRegionAt(Point);
+
+					break;
+				}
+
+				if (gRedactButton.SelectedTool == TRUE && gRedactEveryOccurrence)
+				{
+					gRedactOriginal = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)gCaptureWidth * gCaptureHeight * sizeof(UINT32));
+
+					if (gRedactOriginal == NULL)
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: HeapAlloc failed! Won't look for other places to redact.\n", __FUNCTIONW__, __LINE__);
+					}
+					else
+					{
+						GdiFlush();
+
+						CopyMemory(gRedactOriginal, gSnipBits, (SIZE_T)gCaptureWidth * gCaptureHeight * sizeof(UINT32));
+					}
+				}
+
+				if (gHilighterButton.SelectedTool == TRUE)
+				{
+					CurrentStroke = BeginStroke(&gDocument, ANNOTATION_HILIGHT, PreviousMousePos, (BRUSHTIP)gBrushTip, StrokeBrushWidth, HilightBandHeight, GetHilightColor(gHilighterButton.Color), gGammaCorrectBlending ? BLENDMODE_LINEAR : BLENDMODE_SRGB);
+				}
+				else if (gRedactButton.SelectedTool == TRUE)
+				{
+					CurrentStroke = BeginStroke(&gDocument, ANNOTATION_REDACT, PreviousMousePos, (BRUSHTIP)gBrushTip, StrokeBrushWidth, HilightBandHeight, 0xFF000000, BLENDMODE_SRGB);
+				}
+				else if (gEraserButton.SelectedTool == TRUE)
+				{
+					// The eraser is centered on the mouse.
+					PreviousMousePos.x = Mouse.x - SNIP_CLIENT_LEFT - (ERASER_SIZE / 2);
+
+					PreviousMousePos.y = Mouse.y - SNIP_CLIENT_TOP - (ERASER_SIZE / 2);
+
+					CurrentStroke = BeginStroke(&gDocument, ANNOTATION_ERASE, PreviousMousePos, BRUSHTIP_SQUARE, ERASER_SIZE, ERASER_SIZE, 0, BLENDMODE_SRGB);
+
+					// Erase under the mouse right away, so that clicking without dragging still erases something.
+					RECT Damage = { 0 };
+
+					GdiFlush();
+
+					if (CurrentStroke != NULL && AddStrokePoint(&gDocument, CurrentStroke, PreviousMousePos, NULL, &Damage) == FALSE)
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: AddStrokePoint failed!\n", __FUNCTIONW__, __LINE__);
+					}
+
+					SnipToClientRect(&Damage);
+
+					InvalidateRect(Window, &Damage, FALSE);
+				}
+
+				if ((gHilighterButton.SelectedTool == TRUE || gRedactButton.SelectedTool == TRUE || gEraserButton.SelectedTool == TRUE) && CurrentStroke == NULL)
 				{
-					MyOutputDebugStringW(L"[%s] Line %d: gScratchBitmap was not null, but it was expected to be!\n", __FUNCTIONW__, __LINE__);
+					MyOutputDebugStringW(L"[%s] Line %d: BeginStroke failed!\n", __FUNCTIONW__, __LINE__);
 				}
 
-				gScratchBitmap = CopyImage(gSnipStates[gCurrentSnipState], IMAGE_BITMAP, 0, 0, 0);
+				if (gPenButton.SelectedTool == TRUE)
+				{
+					// The pen is centered on the middle of the pixel under the mouse.
+					RASTERPOINT Point = { (float)(Mouse.x - SNIP_CLIENT_LEFT) + 0.5f, (float)(Mouse.y - SNIP_CLIENT_TOP) + 0.5f };
+
+					ResetPenFilter(&PenFilter);
+
+					Point = FilterPenPoint(&PenFilter, Point, (UINT32)GetMessageTime());
+
+					// Make sure GDI has finished any drawing it has queued up on the snip bitmap before we touch its pixels.
+					GdiFlush();
+
+					RECT Damage = { 0 };
+
+					CurrentStroke = BeginPenStroke(&gDocument, Point, PEN_WIDTH, ColorToPixel(GetToolColor(gPenButton.Color)), gGammaCorrectBlending ? BLENDMODE_LINEAR : BLENDMODE_SRGB, &Damage);
+
+					if (CurrentStroke == NULL)
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: BeginPenStroke failed!\n", __FUNCTIONW__, __LINE__);
+					}
+
+					SnipToClientRect(&Damage);
 
-				gCurrentSnipState++;
+					InvalidateRect(Window, &Damage, FALSE);
+				}
 
-				MyOutputDebugStringW(L"[%s] Line %d: Snips: %i\n", __FUNCTIONW__, __LINE__, gCurrentSnipState);
+				MyOutputDebugStringW(L"[%s] Line %d: Annotations: %u\n", __FUNCTIONW__, __LINE__, gDocument.Count);
 			}
 
 			break;
@@ -724,9 +1012,11 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 			gLeftMouseButtonIsDown = FALSE;
 
+			BOOL WasDrawing = CurrentlyDrawing;
+
 			if (gTextButton.SelectedTool == TRUE)
 			{
-				if (MousePosWhenDrawingStarted.x < 2 || MousePosWhenDrawingStarted.y < 52)
+				if (MousePosWhenDrawingStarted.x < SNIP_CLIENT_LEFT || MousePosWhenDrawingStarted.y < SNIP_CLIENT_TOP)
 				{
 					MyOutputDebugStringW(L"[%s] Line %d: Mouse was not over the screen capture area. Will not place text.\n", __FUNCTIONW__, __LINE__);
 
@@ -735,16 +1025,6 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 				MyOutputDebugStringW(L"[%s] Line %d: Placing text at %dx%d.\n", __FUNCTIONW__, __LINE__, MousePosWhenDrawingStarted.x, MousePosWhenDrawingStarted.y);
 
-				HDC ScratchDC = CreateCompatibleDC(NULL);				
-
-				SetBkMode(ScratchDC, TRANSPARENT);
-
-				SelectObject(ScratchDC, (HBITMAP)gScratchBitmap);
-
-				SelectObject(ScratchDC, (HFONT)gFont);
-
-				SetTextColor(ScratchDC, gFontColor);
-
 				gTextBoxLocation.x = MousePosWhenDrawingStarted.x;
 
 				gTextBoxLocation.y = MousePosWhenDrawingStarted.y;
@@ -760,17 +1040,49 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 				GetTextMetricsW(DC, &TextMetrics);
 
+				SIZE TextSize = { 0 };
+
+				GetTextExtentPoint32W(DC, gTextBuffer, (int)wcslen(gTextBuffer), &TextSize);
+
 				DeleteDC(DC);
 
-				TextOutW(ScratchDC, MousePosWhenDrawingStarted.x - 6, MousePosWhenDrawingStarted.y - 58 - (TextMetrics.tmHeight / 2), gTextBuffer, (int)wcslen(gTextBuffer));
+				if (wcslen(gTextBuffer) > 0)
+				{
+					// The text keeps its own copy of the font, so that picking a different font later doesn't change it.
+					LOGFONTW LogFont = { 0 };
+
+					GetObjectW(gFont, sizeof(LOGFONTW), &LogFont);
+
+					ANNOTATION Text = { 0 };
+
+					Text.Type = ANNOTATION_TEXT;
+
+					Text.Color = ColorToPixel(gFontColor);
+
+					Text.Start.x = MousePosWhenDrawingStarted.x - SNIP_CLIENT_LEFT - TEXT_CURSOR_OFFSET_X;
 
-				DeleteDC(ScratchDC);
+					Text.Start.y = MousePosWhenDrawingStarted.y - SNIP_CLIENT_TOP - TEXT_CURSOR_OFFSET_Y - (TextMetrics.tmHeight / 2);
 
-				RECT SnipRect = { 0 };
+					Text.Text = gTextBuffer;
 
-				GetClientRect(Window, &SnipRect);
+					Text.Font = &LogFont;
 
-				SnipRect.top = 54;
+					Text.FontSize = sizeof(LOGFONTW);
+
+					SetRect(&Text.Bounds, Text.Start.x, Text.Start.y, Text.Start.x + TextSize.cx, Text.Start.y + TextSize.cy);
+
+					// Italic and script fonts can draw a little past the box that GetTextExtentPoint32W measures.
+					InflateRect(&Text.Bounds, TextMetrics.tmAveCharWidth + TextMetrics.tmOverhang, 2);
+
+					if (AddAnnotation(&gDocument, &Text) == NULL)
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: AddAnnotation failed!\n", __FUNCTIONW__, __LINE__);
+					}
+				}
+
+				RECT SnipRect = { 0, 0, gCaptureWidth, gCaptureHeight };
+
+				SnipToClientRect(&SnipRect);
 
 				InvalidateRect(Window, &SnipRect, FALSE);
 
@@ -789,478 +1101,324 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 				
 			CurrentlyDrawing = FALSE;			
 
-			if (gScratchBitmap != NULL)
+			if (gShapePreview.Type != SHAPE_NONE)
 			{
-				gSnipStates[gCurrentSnipState] = CopyImage(gScratchBitmap, IMAGE_BITMAP, 0, 0, 0);
+				// Now that the user has let go, the shape goes into the snip for real.
+				ANNOTATION Shape = { 0 };
 
-				if (DeleteObject(gScratchBitmap) == 0)
-				{
-					MyOutputDebugStringW(L"[%s] Line %d: DeleteObject failed! Was the bitmap still selected into a DC?\n", __FUNCTIONW__, __LINE__);
+				ShapeToAnnotation(&gShapePreview, &Shape);
 
-					CRASH(0);
-				}
-				else
+				if (Shape.Type == ANNOTATION_CALLOUT)
 				{
-					MyOutputDebugStringW(L"[%s] Line %d: gScratchBitmap deleted.\n", __FUNCTIONW__, __LINE__);
-				}
+					if (IsRectEmpty(&Shape.Inset))
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: The callout is too big to fit in the snip even at %dx. Not adding it.\n", __FUNCTIONW__, __LINE__, CALLOUT_MIN_ZOOM);
+					}
+					else
+					{
+						// The preview was magnified with a quick nearest-neighbour copy. This makes the real one with the
+						// Lanczos filter, so what's on the screen has to be repainted.
+						GdiFlush();
 
-				gScratchBitmap = NULL;
+						if (AddCalloutAnnotation(&gDocument, &Shape) == NULL)
+						{
+							MyOutputDebugStringW(L"[%s] Line %d: AddCalloutAnnotation failed!\n", __FUNCTIONW__, __LINE__);
+						}
 
-				if (gAutoCopy)
-				{
-					MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
+						RECT Damage = Shape.Bounds;
 
-					if (CopyButton_Click() == FALSE)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
+						SnipToClientRect(&Damage);
 
-						CRASH(0);
+						InvalidateRect(gMainWindowHandle, &Damage, FALSE);
 					}
 				}
-			}
+				else if (AddAnnotation(&gDocument, &Shape) == NULL)
+				{
+					MyOutputDebugStringW(L"[%s] Line %d: AddAnnotation failed!\n", __FUNCTIONW__, __LINE__);
+				}
 
-			break;
-		}
-		case WM_MOUSEMOVE:
-		case WM_NCMOUSEMOVE:		
-		{
-			// Handle drawing first			
+				ZeroMemory(&gShapePreview, sizeof(gShapePreview));
+			}
 
-			if (CurrentlyDrawing)
+			if (CurrentStroke != NULL && CurrentStroke->Type == ANNOTATION_PEN)
 			{
-				if (gScratchBitmap == NULL)
-				{
-					MyOutputDebugStringW(L"[%s] Line %d: gScratchBitmap is NULL\n", __FUNCTIONW__, __LINE__);
+				// The smoothed stroke trails a little behind the mouse, so finish it where the mouse button came up.
+				POINT Mouse = { 0 };
 
-					break;
-				}				
+				GetCursorPos(&Mouse);
 
-				if (gHilighterButton.SelectedTool == TRUE)
-				{
-					POINT Mouse = { 0 };
+				ScreenToClient(gMainWindowHandle, &Mouse);
 
-					GetCursorPos(&Mouse);					
+				RASTERPOINT Point = { (float)(Mouse.x - SNIP_CLIENT_LEFT) + 0.5f, (float)(Mouse.y - SNIP_CLIENT_TOP) + 0.5f };
 
-					ScreenToClient(gMainWindowHandle, &Mouse);
+				RECT Damage = { 0 };
 
-					// Adjust for snip area, maintain Y axis
-					Mouse.x -= 7;
+				GdiFlush();
 
-					Mouse.y = MousePosWhenDrawingStarted.y - 66;
+				if (AddPenPoint(&gDocument, CurrentStroke, Point, &Damage) == FALSE)
+				{
+					MyOutputDebugStringW(L"[%s] Line %d: AddPenPoint failed!\n", __FUNCTIONW__, __LINE__);
+				}
 
-					HDC ScratchDC = CreateCompatibleDC(NULL);
+				EndPenStroke(&gDocument, CurrentStroke, PEN_SIMPLIFY_TOLERANCE, &Damage);
 
-					HDC HilightDC = CreateCompatibleDC(NULL);
+				MyOutputDebugStringW(L"[%s] Line %d: Pen stroke simplified to %u points.\n", __FUNCTIONW__, __LINE__, CurrentStroke->PenPointCount);
 
-					SelectObject(ScratchDC, (HBITMAP)gScratchBitmap);					
+				SnipToClientRect(&Damage);
 
-					BYTE HilightBits[] = { 0, 0, 0, 0 }; 
+				InvalidateRect(Window, &Damage, FALSE);
 
-					switch (gHilighterButton.Color)
+				CurrentStroke = NULL;
+			}
+			else if (CurrentStroke != NULL)
+			{
+				// A redact stroke keeps the part of gRedactSource that it copied from, so gRedactSource can go.
+				// The search can take a while on a big snip, so it happens on gRedactSearchThread, which takes
+				// gRedactOriginal and gRedactSource, and asks about what it found with WM_REDACT_MATCHES_FOUND.
+				if (EndStroke(&gDocument, CurrentStroke, gRedactSource) == TRUE && gRedactOriginal != NULL)
+				{
+					if (StartRedactSearch(CurrentStroke) == FALSE)
 					{
-						case COLOR_YELLOW:
-						{							
-							memset(&HilightBits[0], 0x00, 1);
-
-							memset(&HilightBits[1], 0xFF, 1);
-
-							memset(&HilightBits[2], 0xFF, 1);
-
-							memset(&HilightBits[3], 0xFF, 1);
-
-							break;
-						}
-						case COLOR_PINK:
-						{
-							memset(&HilightBits[0], 0xDC, 1);
-
-							memset(&HilightBits[1], 0x00, 1);
-
-							memset(&HilightBits[2], 0xFF, 1);
-
-							memset(&HilightBits[3], 0xFF, 1);
-
-							break;
-						}						
-						case COLOR_ORANGE:
-						{
-							memset(&HilightBits[0], 0x00, 1);
-
-							memset(&HilightBits[1], 0x6A, 1);
+						MyOutputDebugStringW(L"[%s] Line %d: StartRedactSearch failed! Won't look for other places to redact.\n", __FUNCTIONW__, __LINE__);
+					}
+				}
 
-							memset(&HilightBits[2], 0xFF, 1);
+				CurrentStroke = NULL;
+			}
 
-							memset(&HilightBits[3], 0xFF, 1);
+			if (gRedactOriginal != NULL)
+			{
+				HeapFree(GetProcessHeap(), 0, gRedactOriginal);
 
-							break;
-						}
-						case COLOR_GREEN:
-						{
-							memset(&HilightBits[0], 0x00, 1);
+				gRedactOriginal = NULL;
+			}
 
-							memset(&HilightBits[1], 0xFF, 1);
+			if (gRedactSource != NULL)
+			{
+				HeapFree(GetProcessHeap(), 0, gRedactSource);
 
-							memset(&HilightBits[2], 0x00, 1);
+				gRedactSource = NULL;
+			}
 
-							memset(&HilightBits[3], 0xFF, 1);
+			if (WasDrawing == TRUE && gAutoCopy)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
 
-							break;
-						}
-						default:
-						{
-							MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown color in hilighter function!\n", __FUNCTIONW__, __LINE__);
-						}
-					}
+				if (CopyButton_Click() == FALSE)
+				{
+					MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
 
-					HBITMAP HilightPixel = CreateBitmap(1, 1, 1, 32, HilightBits);
+					CRASH(0);
+				}
+			}
 
-					SelectObject(HilightDC, HilightPixel);
-					
-					BLENDFUNCTION InverseBlendFunction = { AC_SRC_OVER, 0, 0, AC_SRC_ALPHA };					
+			break;
+		}
+		case WM_MOUSEMOVE:
+		case WM_NCMOUSEMOVE:		
+		{
+			// Handle drawing first			
 
-					for (UINT8 XPixel = 0; XPixel < 10; XPixel++)
-					{
-						for (UINT8 YPixel = 0; YPixel < 20; YPixel++)
-						{
-							BOOL PixelAlreadyDrawn = FALSE;							
+			if (CurrentlyDrawing)
+			{
+				if (gSnipBitmap == NULL)
+				{
+					MyOutputDebugStringW(L"[%s] Line %d: gSnipBitmap is NULL\n", __FUNCTIONW__, __LINE__);
 
-							for (UINT16 Counter = 0; Counter < _countof(HilighterPixelsAlreadyDrawn); Counter++)
-							{
-								if ((HilighterPixelsAlreadyDrawn[Counter].x == Mouse.x + XPixel) && (HilighterPixelsAlreadyDrawn[Counter].y == Mouse.y + YPixel))
-								{
-									PixelAlreadyDrawn = TRUE;
-								}
-							}
+					break;
+				}				
 
-							if (PixelAlreadyDrawn == FALSE)
-							{								
-								COLORREF CurrentPixelColor = GetPixel(ScratchDC, Mouse.x + XPixel, Mouse.y + YPixel);
+				if (gHilighterButton.SelectedTool == TRUE)
+				{
+					POINT Mouse = { 0 };
 
-								UINT16 CurrentPixelBrightness = GetRValue(CurrentPixelColor) + GetGValue(CurrentPixelColor) + GetBValue(CurrentPixelColor);
+					GetCursorPos(&Mouse);					
 
-								// x/3, 765 = 255, 382.5 = 128, 0 = 0
-								InverseBlendFunction.SourceConstantAlpha = (BYTE)(CurrentPixelBrightness / 3);
+					ScreenToClient(gMainWindowHandle, &Mouse);
 
-								GdiAlphaBlend(ScratchDC, Mouse.x + XPixel, Mouse.y + YPixel, 1, 1, HilightDC, 0, 0, 1, 1, InverseBlendFunction);
+					// Adjust for snip area, maintain Y axis
+					Mouse.x -= SNIP_CLIENT_LEFT + (StrokeBrushWidth / 2);
 
-								HilighterPixelsAlreadyDrawn[HilighterPixelsAlreadyDrawnCounter].x = (UINT16)(Mouse.x + XPixel);
+					Mouse.y = HilightBandTop;
 
-								HilighterPixelsAlreadyDrawn[HilighterPixelsAlreadyDrawnCounter].y = (UINT16)(Mouse.y + YPixel);
+					// Make sure GDI has finished any drawing it has queued up on the snip bitmap before we touch its pixels.
+					GdiFlush();
 
-								HilighterPixelsAlreadyDrawnCounter++;
+					// Stamp the brush everywhere between the last mouse sample and this one, so that a fast drag leaves no gaps.
+					RECT Damage = { 0 };
 
-								if (HilighterPixelsAlreadyDrawnCounter >= _countof(HilighterPixelsAlreadyDrawn) - 1)
-								{
-									HilighterPixelsAlreadyDrawnCounter = 0;
-								}
-							}
-						}
-					}
-				
-					if (DeleteDC(HilightDC) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteDC(HilightDC) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteDC(ScratchDC) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteDC(gScratchDC) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteObject(HilightPixel) == 0)
+					if (CurrentStroke != NULL && AddStrokePoint(&gDocument, CurrentStroke, Mouse, NULL, &Damage) == FALSE)
 					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject(HilightPixel) failed!\n", __FUNCTIONW__, __LINE__);
+						MyOutputDebugStringW(L"[%s] Line %d: AddStrokePoint failed!\n", __FUNCTIONW__, __LINE__);
 					}
 
-					PreviousMousePos.x = Mouse.x;
-
-					RECT SnipRect = { 0 };
-
-					GetClientRect(Window, &SnipRect);
-
-					SnipRect.top = MousePosWhenDrawingStarted.y - 10;
-
-					SnipRect.bottom = MousePosWhenDrawingStarted.y + 10;
-
-					InvalidateRect(Window, &SnipRect, FALSE);
+					PreviousMousePos = Mouse;
 
-					UpdateWindow(gMainWindowHandle);
-				}
-				else if (gRectangleButton.SelectedTool == TRUE)
-				{
-					HBITMAP CleanCopy = CopyImage(gSnipStates[gCurrentSnipState - 1], IMAGE_BITMAP, 0, 0, 0);
-
-					HDC CopyDC = CreateCompatibleDC(NULL);
-					
-					SelectObject(CopyDC, CleanCopy);
-
-					HPEN Pen = NULL; //CreatePen(PS_SOLID, 2, RGB(255, 0, 0));
-
-					switch (gRectangleButton.Color)
+					// Only the pixels that were actually hilighted need to be repainted.
+					if (IsRectEmpty(&Damage) == FALSE)
 					{
-						case COLOR_RED:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(255, 0, 0));						
+						SnipToClientRect(&Damage);
 
-							break;
-						}
-						case COLOR_GREEN:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(0, 255, 0));						
-
-							break;
-						}
-						case COLOR_BLUE:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(0, 0, 255));						
-
-							break;
-						}
-						case COLOR_BLACK:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(0, 0, 0));						
+						InvalidateRect(Window, &Damage, FALSE);
 
-							break;
-						}
-						case COLOR_WHITE:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));						
-
-							break;
-						}
-						case COLOR_YELLOW:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 0));						
-
-							break;
-						}
-						default:
-						{
-							MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown color for arrow tool!\n", __FUNCTIONW__, __LINE__);
-						}
+						UpdateWindow(gMainWindowHandle);
 					}
+				}
+				else if (gPenButton.SelectedTool == TRUE)
+				{
+					POINT Mouse = { 0 };
 
-					SelectObject(CopyDC, Pen);
-
-					SelectObject(CopyDC, (HBRUSH)GetStockObject(NULL_BRUSH));
+					GetCursorPos(&Mouse);
 
-					POINT CurrentMousePos = { 0 };
+					ScreenToClient(gMainWindowHandle, &Mouse);
 
-					GetCursorPos(&CurrentMousePos);
+					RASTERPOINT Point = { (float)(Mouse.x - SNIP_CLIENT_LEFT) + 0.5f, (float)(Mouse.y - SNIP_CLIENT_TOP) + 0.5f };
 
-					ScreenToClient(gMainWindowHandle, &CurrentMousePos);
+					Point = FilterPenPoint(&PenFilter, Point, (UINT32)GetMessageTime());
 
-					Rectangle(CopyDC, MousePosWhenDrawingStarted.x, MousePosWhenDrawingStarted.y - 56, CurrentMousePos.x, CurrentMousePos.y - 56);
+					GdiFlush();
 
-					HDC ScratchDC = CreateCompatibleDC(NULL);
+					// Only the newest segment is drawn, so this costs the same however long the stroke gets.
+					RECT Damage = { 0 };
 
-					SelectObject(ScratchDC, (HBITMAP)gScratchBitmap);
-					
-					BitBlt(ScratchDC, 0, 0, gCaptureWidth, gCaptureHeight, CopyDC, 0, 0, SRCCOPY);					
-					
-					// DeleteObject will fail if the object is still selected into a DC.
-					if (DeleteDC(CopyDC) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteDC(CopyDC) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteDC(ScratchDC) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteDC(gScratchDC) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteObject(Pen) == 0)
+					if (CurrentStroke != NULL && AddPenPoint(&gDocument, CurrentStroke, Point, &Damage) == FALSE)
 					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject(Pen) failed!\n", __FUNCTIONW__, __LINE__);
+						MyOutputDebugStringW(L"[%s] Line %d: AddPenPoint failed!\n", __FUNCTIONW__, __LINE__);
 					}
-					if (DeleteObject(CleanCopy) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject(CleanCopy) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-
-					RECT SnipRect = { 0 };
-
-					GetClientRect(Window, &SnipRect);
 
-					SnipRect.top = 54;					
+					SnipToClientRect(&Damage);
 
-					InvalidateRect(Window, &SnipRect, FALSE);
+					InvalidateRect(Window, &Damage, FALSE);
 
 					UpdateWindow(gMainWindowHandle);
 				}
-				else if (gArrowButton.SelectedTool == TRUE)
+				else if (gRectangleButton.SelectedTool == TRUE || gArrowButton.SelectedTool == TRUE || gCalloutButton.SelectedTool == TRUE)
 				{
-					HBITMAP CleanCopy = CopyImage(gSnipStates[gCurrentSnipState - 1], IMAGE_BITMAP, 0, 0, 0);
-
-					HDC CopyDC = CreateCompatibleDC(NULL);
-
-					SelectObject(CopyDC, CleanCopy);
-
-					HPEN Pen = NULL;
-
-					HBRUSH Brush = NULL;
+					// The box, arrow or callout isn't drawn into the snip until the mouse button comes back up. Until then it's
+					// only drawn over the snip in WM_PAINT, so all we have to do here is repaint where it was and where it is now.
+					POINT CurrentMousePos = { 0 };
 
-					switch (gArrowButton.Color)
-					{
-						case COLOR_RED:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(255, 0, 0));
+					GetCursorPos(&CurrentMousePos);
 
-							Brush = CreateSolidBrush(RGB(255, 0, 0));
+					ScreenToClient(gMainWindowHandle, &CurrentMousePos);
 
-							break;
-						}
-						case COLOR_GREEN:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(0, 255, 0));
+					RECT Damage = { 0 };
 
-							Brush = CreateSolidBrush(RGB(0, 255, 0));
+					GetShapeBounds(&gShapePreview, &Damage);
 
-							break;
-						}
-						case COLOR_BLUE:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(0, 0, 255));
+					gShapePreview.Type = (gRectangleButton.SelectedTool == TRUE) ? SHAPE_BOX : ((gArrowButton.SelectedTool == TRUE) ? SHAPE_ARROW : SHAPE_CALLOUT);
 
-							Brush = CreateSolidBrush(RGB(0, 0, 255));
+					// Callouts are drawn in the box's color, so that they match the boxes around them.
+					gShapePreview.Color = GetToolColor((gArrowButton.SelectedTool == TRUE) ? gArrowButton.Color : gRectangleButton.Color);
 
-							break;
-						}
-						case COLOR_BLACK:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(0, 0, 0));
+					gShapePreview.Start.x = MousePosWhenDrawingStarted.x;
 
-							Brush = CreateSolidBrush(RGB(0, 0, 0));
+					gShapePreview.Start.y = MousePosWhenDrawingStarted.y - SNIP_CLIENT_TOP;
 
-							break;
-						}
-						case COLOR_WHITE:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
+					gShapePreview.End.x = CurrentMousePos.x;
 
-							Brush = CreateSolidBrush(RGB(255, 255, 255));
+					gShapePreview.End.y = CurrentMousePos.y - SNIP_CLIENT_TOP;
 
-							break;
-						}
-						case COLOR_YELLOW:
-						{
-							Pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 0));
+					RECT NewBounds = { 0 };
 
-							Brush = CreateSolidBrush(RGB(255, 255, 0));
+					GetShapeBounds(&gShapePreview, &NewBounds);
 
-							break;
-						}
-						default:
-						{
-							MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown color for arrow tool!\n", __FUNCTIONW__, __LINE__);
-						}
-					}
+					UnionRect(&Damage, &Damage, &NewBounds);
 
-					SelectObject(CopyDC, Pen);
+					SnipToClientRect(&Damage);
 
-					SelectObject(CopyDC, Brush);
+					InvalidateRect(Window, &Damage, FALSE);
 
+					UpdateWindow(gMainWindowHandle);
+				}
+				else if (gSpotlightButton.SelectedTool == TRUE)
+				{
+					// Like the box and arrow, the spotlight is only drawn over the snip until the mouse button comes up. It dims
+					// the whole snip, but as its rectangle moves, only the strips that go from dimmed to not dimmed or back
+					// change, so those are all that get repainted.
 					POINT CurrentMousePos = { 0 };
-					
+
 					GetCursorPos(&CurrentMousePos);
 
 					ScreenToClient(gMainWindowHandle, &CurrentMousePos);
 
-					POINT p0 = { 0 };
+					HRGN Changed = GetSpotlightRegion(&gShapePreview);
 
-					POINT p1 = { 0 };
+					gShapePreview.Type = SHAPE_SPOTLIGHT;
 
-					p0.x = MousePosWhenDrawingStarted.x;
+					gShapePreview.Start.x = MousePosWhenDrawingStarted.x;
 
-					p0.y = MousePosWhenDrawingStarted.y - 56;
+					gShapePreview.Start.y = MousePosWhenDrawingStarted.y - SNIP_CLIENT_TOP;
 
-					p1.x = CurrentMousePos.x;
+					gShapePreview.End.x = CurrentMousePos.x;
 
-					p1.y = CurrentMousePos.y - 56;
+					gShapePreview.End.y = CurrentMousePos.y - SNIP_CLIENT_TOP;
 
-					MoveToEx(CopyDC, p0.x, p0.y, NULL);
+					HRGN Dimmed = GetSpotlightRegion(&gShapePreview);
 
-					LineTo(CopyDC, p1.x, p1.y);					
-
-					const float dx = (float)(p1.x - p0.x);
-
-					const float dy = (float)(p1.y - p0.y);
-
-					float ArrowLength = (float)sqrt((double)dx * (double)dx + (double)dy * (double)dy);
-
-					// unit vector parallel to the line.
-					float ux = dx / ArrowLength;
-
-					float uy = dy / ArrowLength;
-
-					// unit vector perpendicular to ux,uy
-					float vx = -uy;
-
-					float vy = ux;
+					if (Changed != NULL && Dimmed != NULL && CombineRgn(Changed, Changed, Dimmed, RGN_XOR) != ERROR)
+					{
+						OffsetRgn(Changed, SNIP_CLIENT_LEFT, SNIP_CLIENT_TOP);
 
-					int head_length = 10;
+						InvalidateRgn(Window, Changed, FALSE);
+					}
+					else
+					{
+						MyOutputDebugStringW(L"[%s] Line %d: Failed to work out what the spotlight changed! Repainting the whole snip.\n", __FUNCTIONW__, __LINE__);
 
-					int head_width  = 10;
+						RECT Damage = { 0, 0, gCaptureWidth, gCaptureHeight };
 
-					float half_width = 0.5f * head_width;
-					
-					POINT ArrowHead = p1;
+						SnipToClientRect(&Damage);
 
-					POINT ArrowCorner1 = { 0 };
-					
-					ArrowCorner1.x = (LONG)roundf(p1.x - head_length*ux + half_width*vx);
+						InvalidateRect(Window, &Damage, FALSE);
+					}
 
-					ArrowCorner1.y = (LONG)roundf(p1.y - head_length*uy + half_width*vy);
+					if (Changed != NULL)
+					{
+						DeleteObject(Changed);
+					}
 
-					POINT ArrowCorner2 = { 0 };
-					
-					ArrowCorner2.x = (LONG)roundf(p1.x - head_length*ux - half_width*vx);
+					if (Dimmed != NULL)
+					{
+						DeleteObject(Dimmed);
+					}
 
-					ArrowCorner2.y = (LONG)roundf(p1.y - head_length*uy - half_width*vy);
+					UpdateWindow(gMainWindowHandle);
+				}
+				else if (gEraserButton.SelectedTool == TRUE)
+				{
+					POINT Mouse = { 0 };
 
-					POINT Arrow[3];
-					
-					Arrow[0] = ArrowHead;
+					GetCursorPos(&Mouse);
 
-					Arrow[1] = ArrowCorner1;
+					ScreenToClient(gMainWindowHandle, &Mouse);
 
-					Arrow[2] = ArrowCorner2;
-					
-					Polygon(CopyDC, Arrow, 3);					
+					// Unlike the hilighter and redact tools, the eraser goes wherever the mouse goes.
+					Mouse.x -= SNIP_CLIENT_LEFT + (ERASER_SIZE / 2);
 
-					HDC ScratchDC = CreateCompatibleDC(NULL);
+					Mouse.y -= SNIP_CLIENT_TOP + (ERASER_SIZE / 2);
 
-					SelectObject(ScratchDC, (HBITMAP)gScratchBitmap);
+					GdiFlush();
 
-					BitBlt(ScratchDC, 0, 0, gCaptureWidth, gCaptureHeight, CopyDC, 0, 0, SRCCOPY);
+					// The brush only copies back the rows of the original snip that it passes over, so this costs
+					// the same however big the snip is.
+					RECT Damage = { 0 };
 
-					// DeleteObject will fail if the object is still selected into a DC.
-					if (DeleteDC(CopyDC) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteDC(CopyDC) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteDC(ScratchDC) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteDC(gScratchDC) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteObject(Pen) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject(RedPen) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteObject(Brush) == 0)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject(RedBrush) failed!\n", __FUNCTIONW__, __LINE__);
-					}
-					if (DeleteObject(CleanCopy) == 0)
+					if (CurrentStroke != NULL && AddStrokePoint(&gDocument, CurrentStroke, Mouse, NULL, &Damage) == FALSE)
 					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject(CleanCopy) failed!\n", __FUNCTIONW__, __LINE__);
+						MyOutputDebugStringW(L"[%s] Line %d: AddStrokePoint failed!\n", __FUNCTIONW__, __LINE__);
 					}
 
-					RECT SnipRect = { 0 };
-
-					GetClientRect(Window, &SnipRect);
+					PreviousMousePos = Mouse;
 
-					SnipRect.top = 54;
+					if (IsRectEmpty(&Damage) == FALSE)
+					{
+						SnipToClientRect(&Damage);
 
-					InvalidateRect(Window, &SnipRect, FALSE);
+						InvalidateRect(Window, &Damage, FALSE);
 
-					UpdateWindow(gMainWindowHandle);
+						UpdateWindow(gMainWindowHandle);
+					}
 				}
 				else if (gRedactButton.SelectedTool == TRUE)
 				{
@@ -1271,40 +1429,31 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 					ScreenToClient(gMainWindowHandle, &Mouse);
 
 					// Adjust for snip area, maintain Y axis
-					Mouse.x -= 7;
-
-					Mouse.y = MousePosWhenDrawingStarted.y - 66;
+					Mouse.x -= SNIP_CLIENT_LEFT + (StrokeBrushWidth / 2);
 
-					HDC ScratchDC = CreateCompatibleDC(NULL);					
+					Mouse.y = HilightBandTop;
 
-					SelectObject(ScratchDC, (HBITMAP)gScratchBitmap);					
+					// Make sure GDI has finished any drawing it has queued up on the snip bitmap before we touch its pixels.
+					GdiFlush();
 
-					for (UINT8 XPixel = 0; XPixel < 10; XPixel++)
-					{
-						for (UINT8 YPixel = 0; YPixel < 20; YPixel++)
-						{
-							PatBlt(ScratchDC, Mouse.x + XPixel, Mouse.y + YPixel, 1, 1, BLACKNESS);								
-						}
-					}
+					// Only the pixels that were actually redacted need to be repainted.
+					RECT Damage = { 0 };
 
-					if (DeleteDC(ScratchDC) == 0)
+					if (CurrentStroke != NULL && AddStrokePoint(&gDocument, CurrentStroke, Mouse, gRedactSource, &Damage) == FALSE)
 					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteDC(gScratchDC) failed!\n", __FUNCTIONW__, __LINE__);
+						MyOutputDebugStringW(L"[%s] Line %d: AddStrokePoint failed!\n", __FUNCTIONW__, __LINE__);
 					}
 
-					PreviousMousePos.x = Mouse.x;
+					PreviousMousePos = Mouse;
 
-					RECT SnipRect = { 0 };
-
-					GetClientRect(Window, &SnipRect);
-
-					SnipRect.top = MousePosWhenDrawingStarted.y - 10;
-
-					SnipRect.bottom = MousePosWhenDrawingStarted.y + 10;
+					if (IsRectEmpty(&Damage) == FALSE)
+					{
+						SnipToClientRect(&Damage);
 
-					InvalidateRect(Window, &SnipRect, FALSE);
+						InvalidateRect(Window, &Damage, FALSE);
 
-					UpdateWindow(gMainWindowHandle);
+						UpdateWindow(gMainWindowHandle);
+					}
 				}
 			}
 
@@ -1320,7 +1469,7 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 					InvalidateRect(Window, NULL, FALSE);
 				}
 
-				if (gButtons[Counter]->SelectedTool == TRUE && gAppState == APPSTATE_AFTERCAPTURE && gSnipStates[0] != NULL && gButtons[Counter]->Cursor != NULL)
+				if (gButtons[Counter]->SelectedTool == TRUE && gAppState == APPSTATE_AFTERCAPTURE && gSnipBitmap != NULL && gButtons[Counter]->Cursor != NULL)
 				{
 					POINT Mouse = { 0 };
 
@@ -1328,7 +1477,7 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 					ScreenToClient(gMainWindowHandle, &Mouse);
 
-					if (Mouse.x >= 2 && Mouse.y >= 54)
+					if (Mouse.x >= SNIP_CLIENT_LEFT && Mouse.y >= SNIP_CLIENT_TOP)
 					{
 						if (GetCursor() != gButtons[Counter]->Cursor)
 						{
@@ -1598,35 +1747,197 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 
 										gButtons[Counter]->Cursor = LoadCursorW(GetModuleHandleW(NULL), MAKEINTRESOURCEW(gButtons[Counter]->CursorId));
 									}
-									else if (gButtons[Counter]->Id == BUTTON_TEXT)
+									else if (gButtons[Counter]->Id == BUTTON_PEN)
 									{
-										CHOOSEFONTW FontChoice = { sizeof(CHOOSEFONTW) };
+										switch (gButtons[Counter]->Color)
+										{
+											case COLOR_RED:
+											{
+												gButtons[Counter]->Color = COLOR_GREEN;
+												
+												gButtons[Counter]->EnabledIconId = IDB_PEN32x32GREEN;
 
-										LOGFONTW LogFont = { 0 };
+												gButtons[Counter]->CursorId = IDC_GREENCROSSHAIR;												
 
-										GetObject(gFont, sizeof(LOGFONTW), &LogFont);
+												break;
+											}
+											case COLOR_GREEN:
+											{
+												gButtons[Counter]->Color = COLOR_BLUE;
 
-										FontChoice.Flags = CF_EFFECTS | CF_INITTOLOGFONTSTRUCT | CF_SCREENFONTS;
+												gButtons[Counter]->EnabledIconId = IDB_PEN32x32BLUE;
 
-										FontChoice.hwndOwner = gMainWindowHandle;
+												gButtons[Counter]->CursorId = IDC_BLUECROSSHAIR;												
 
-										FontChoice.lpLogFont = &LogFont;
+												break;
+											}
+											case COLOR_BLUE:
+											{
+												gButtons[Counter]->Color = COLOR_BLACK;
 
-										FontChoice.rgbColors = RGB(0, 0, 0);
+												gButtons[Counter]->EnabledIconId = IDB_PEN32x32BLACK;
 
-										if (ChooseFont(&FontChoice))
-										{
-											MyOutputDebugStringW(L"[%s] Line %d: ChooseFont successful.\n", __FUNCTIONW__, __LINE__);
+												gButtons[Counter]->CursorId = IDC_BLACKCROSSHAIR;
 
-											HFONT TmpFont = CreateFontIndirectW(&LogFont);
+												break;
+											}
+											case COLOR_BLACK:
+											{
+												gButtons[Counter]->Color = COLOR_WHITE;
 
-											if (TmpFont)
+												gButtons[Counter]->EnabledIconId = IDB_PEN32x32WHITE;
+
+												gButtons[Counter]->CursorId = IDC_WHITECROSSHAIR;
+
+												break;
+											}
+											case COLOR_WHITE:
 											{
-												DeleteObject(gFont);
+												gButtons[Counter]->Color = COLOR_YELLOW;
 
-												gFont = TmpFont;
+												gButtons[Counter]->EnabledIconId = IDB_PEN32x32YELLOW;
 
-												gFontColor = FontChoice.rgbColors;
+												gButtons[Counter]->CursorId = IDC_YELLOWCROSSHAIR;
+
+												break;
+											}
+											case COLOR_YELLOW:
+											{
+												gButtons[Counter]->Color = COLOR_RED;
+
+												gButtons[Counter]->EnabledIconId = IDB_PEN32x32RED;
+
+												gButtons[Counter]->CursorId = IDC_REDCROSSHAIR;
+
+												break;
+											}
+											default:
+											{
+												MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown color when trying to change pen color!\n", __FUNCTIONW__, __LINE__);
+											}
+										}
+
+										DeleteObject(gButtons[Counter]->EnabledIcon);
+
+										DeleteObject(gButtons[Counter]->Cursor);
+
+										gButtons[Counter]->EnabledIcon = (HBITMAP)LoadImageW(GetModuleHandleW(NULL), MAKEINTRESOURCEW(gButtons[Counter]->EnabledIconId), IMAGE_BITMAP, 0, 0, 0);
+
+										gButtons[Counter]->Cursor = LoadCursorW(GetModuleHandleW(NULL), MAKEINTRESOURCEW(gButtons[Counter]->CursorId));
+									}
+									else if (gButtons[Counter]->Id == BUTTON_REDACT)
+									{
+										switch (gRedactMode)
+										{
+											case REDACTMODE_BLACK:
+											{
+												gRedactMode = REDACTMODE_PIXELATE;
+
+												gButtons[Counter]->Caption = L"Pixelate";
+
+												break;
+											}
+											case REDACTMODE_PIXELATE:
+											{
+												gRedactMode = REDACTMODE_BLUR;
+
+												gButtons[Counter]->Caption = L"Blur";
+
+												break;
+											}
+											case REDACTMODE_BLUR:
+											{
+												gRedactMode = REDACTMODE_BLACK;
+
+												gButtons[Counter]->Caption = L"Redact";
+
+												break;
+											}
+											default:
+											{
+												MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown redact mode when trying to change it!\n", __FUNCTIONW__, __LINE__);
+											}
+										}
+									}
+									else if (gButtons[Counter]->Id == BUTTON_CALLOUT)
+									{
+										switch (gCalloutZoom)
+										{
+											case 2:
+											{
+												gCalloutZoom = 3;
+
+												gButtons[Counter]->Caption = L"Zoom 3x";
+
+												break;
+											}
+											case 3:
+											{
+												gCalloutZoom = 4;
+
+												gButtons[Counter]->Caption = L"Zoom 4x";
+
+												break;
+											}
+											case 4:
+											{
+												gCalloutZoom = 6;
+
+												gButtons[Counter]->Caption = L"Zoom 6x";
+
+												break;
+											}
+											case 6:
+											{
+												gCalloutZoom = 8;
+
+												gButtons[Counter]->Caption = L"Zoom 8x";
+
+												break;
+											}
+											case 8:
+											{
+												gCalloutZoom = 2;
+
+												gButtons[Counter]->Caption = L"Zoom 2x";
+
+												break;
+											}
+											default:
+											{
+												MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown zoom when trying to change the callout's zoom!\n", __FUNCTIONW__, __LINE__);
+											}
+										}
+									}
+									else if (gButtons[Counter]->Id == BUTTON_TEXT)
+									{
+										CHOOSEFONTW FontChoice = { sizeof(CHOOSEFONTW) };
+
+										LOGFONTW LogFont = { 0 };
+
+										GetObject(gFont, sizeof(LOGFONTW), &LogFont);
+
+										FontChoice.Flags = CF_EFFECTS | CF_INITTOLOGFONTSTRUCT | CF_SCREENFONTS;
+
+										FontChoice.hwndOwner = gMainWindowHandle;
+
+										FontChoice.lpLogFont = &LogFont;
+
+										FontChoice.rgbColors = RGB(0, 0, 0);
+
+										if (ChooseFont(&FontChoice))
+										{
+											MyOutputDebugStringW(L"[%s] Line %d: ChooseFont successful.\n", __FUNCTIONW__, __LINE__);
+
+											HFONT TmpFont = CreateFontIndirectW(&LogFont);
+
+											if (TmpFont)
+											{
+												DeleteObject(gFont);
+
+												gFont = TmpFont;
+
+												gFontColor = FontChoice.rgbColors;
 											}
 										}
 									}
@@ -1729,10 +2040,6 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 			{
 				case BUTTON_NEW:
 				{
-					memset(HilighterPixelsAlreadyDrawn, 0, sizeof(HilighterPixelsAlreadyDrawn));
-
-					HilighterPixelsAlreadyDrawnCounter = 0;
-
 					if (GetKeyState(VK_SHIFT) & 0x8000)
 					{
 						BOOL AllMonitors = (GetKeyState(VK_CONTROL) & 0x8000) ? TRUE : FALSE;
@@ -1825,6 +2132,10 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 				case BUTTON_ARROW:
 				case BUTTON_REDACT:
 				case BUTTON_TEXT:
+				case BUTTON_PEN:
+				case BUTTON_ERASER:
+				case BUTTON_SPOTLIGHT:
+				case BUTTON_CALLOUT:
 				{
 					if (gButtons[LOWORD(WParam) - 10001]->Enabled == TRUE)
 					{
@@ -2035,6 +2346,91 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 					CRASH(0);
 				}
 			}
+			else if (WParam == SYSCMD_GAMMA)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Gamma-correct blending' menu item.\n", __FUNCTIONW__, __LINE__);
+
+				if (gGammaCorrectBlending)
+				{
+					CheckMenuItem(GetSystemMenu(gMainWindowHandle, FALSE), SYSCMD_GAMMA, MF_BYCOMMAND | MF_UNCHECKED);
+
+					gGammaCorrectBlending = FALSE;
+				}
+				else
+				{
+					CheckMenuItem(GetSystemMenu(gMainWindowHandle, FALSE), SYSCMD_GAMMA, MF_BYCOMMAND | MF_CHECKED);
+
+					gGammaCorrectBlending = TRUE;
+				}
+
+				if (SetSnipExRegValue(REG_GAMMACORRECTNAME, &gGammaCorrectBlending) != ERROR_SUCCESS)
+				{
+					CRASH(0);
+				}
+			}
+			else if (WParam == SYSCMD_REDACTALL)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Redact every occurrence' menu item.\n", __FUNCTIONW__, __LINE__);
+
+				if (gRedactEveryOccurrence)
+				{
+					CheckMenuItem(GetSystemMenu(gMainWindowHandle, FALSE), SYSCMD_REDACTALL, MF_BYCOMMAND | MF_UNCHECKED);
+
+					gRedactEveryOccurrence = FALSE;
+				}
+				else
+				{
+					CheckMenuItem(GetSystemMenu(gMainWindowHandle, FALSE), SYSCMD_REDACTALL, MF_BYCOMMAND | MF_CHECKED);
+
+					gRedactEveryOccurrence = TRUE;
+				}
+
+				if (SetSnipExRegValue(REG_REDACTALLNAME, &gRedactEveryOccurrence) != ERROR_SUCCESS)
+				{
+					CRASH(0);
+				}
+			}
+			else if (WParam == SYSCMD_RECOVERY)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Recover snips after a crash' menu item.\n", __FUNCTIONW__, __LINE__);
+
+				if (gSessionRecovery)
+				{
+					CheckMenuItem(GetSystemMenu(gMainWindowHandle, FALSE), SYSCMD_RECOVERY, MF_BYCOMMAND | MF_UNCHECKED);
+
+					gSessionRecovery = FALSE;
+
+					// Don't leave the snip on disk once the user has said they don't want it there.
+					CloseSession(&gSession, TRUE);
+
+					gDocument.Session = NULL;
+				}
+				else
+				{
+					// This starts with the next snip, since the session file has to begin with the snip as it was taken.
+					CheckMenuItem(GetSystemMenu(gMainWindowHandle, FALSE), SYSCMD_RECOVERY, MF_BYCOMMAND | MF_CHECKED);
+
+					gSessionRecovery = TRUE;
+				}
+
+				if (SetSnipExRegValue(REG_SESSIONRECOVERYNAME, &gSessionRecovery) != ERROR_SUCCESS)
+				{
+					CRASH(0);
+				}
+			}
+			else if (WParam == SYSCMD_BRUSHTIP)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Brush tip' menu item.\n", __FUNCTIONW__, __LINE__);
+
+				gBrushTip = (gBrushTip == BRUSHTIP_CHISEL) ? BRUSHTIP_SQUARE : gBrushTip + 1;
+
+				ModifyMenuW(GetSystemMenu(gMainWindowHandle, FALSE), SYSCMD_BRUSHTIP, MF_BYCOMMAND | MF_STRING, SYSCMD_BRUSHTIP, GetBrushTipMenuText(gBrushTip));
+
+				if (SetSnipExRegValue(REG_BRUSHTIPNAME, &gBrushTip) != ERROR_SUCCESS)
+				{
+					CRASH(0);
+				}
+			}
 			else if (WParam == SYSCMD_AUTOSAVE)
 			{
 				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Automatically save screen captures' menu item.\n", __FUNCTIONW__, __LINE__);
@@ -2150,38 +2546,32 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 			{
 				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Undo' menu item.\n", __FUNCTIONW__, __LINE__);
 
-				if (gCurrentSnipState > 0 && (gAppState == APPSTATE_AFTERCAPTURE))
+				if (gAppState == APPSTATE_AFTERCAPTURE)
 				{
-					gCurrentSnipState--;
-
-					MyOutputDebugStringW(L"[%s] Line %d: Deleting gSnipStates[gCurrentSnipState + 1]\n", __FUNCTIONW__, __LINE__);
-
-					memset(HilighterPixelsAlreadyDrawn, 0, sizeof(HilighterPixelsAlreadyDrawn));
+					UndoChange();
+				}
+			}
+			else if (WParam == SYSCMD_REDO)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Redo' menu item.\n", __FUNCTIONW__, __LINE__);
 
-					HilighterPixelsAlreadyDrawnCounter = 0;
+				if (gAppState == APPSTATE_AFTERCAPTURE)
+				{
+					RedoChange();
+				}
+			}
+			else if (WParam == SYSCMD_REPEATREGION)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: User clicked on 'Repeat last region' menu item.\n", __FUNCTIONW__, __LINE__);
 
-					if (DeleteObject(gSnipStates[gCurrentSnipState + 1]) == 0)
+				if (gAppState == APPSTATE_BEFORECAPTURE || gAppState == APPSTATE_AFTERCAPTURE)
+				{
+					if (RepeatLastRegion() == FALSE)
 					{
-						MyOutputDebugStringW(L"[%s] Line %d: DeleteObject failed!\n", __FUNCTIONW__, __LINE__);
+						gMainWindowIsRunning = FALSE;
 
 						CRASH(0);
 					}
-
-					gSnipStates[gCurrentSnipState + 1] = NULL;
-
-					InvalidateRect(Window, NULL, FALSE);
-
-					if (gAutoCopy)
-					{
-						MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
-
-						if (CopyButton_Click() == FALSE)
-						{
-							MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
-
-							CRASH(0);
-						}
-					}
 				}
 			}
 
@@ -2218,24 +2608,21 @@ LRESULT CALLBACK MainWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_ WP
 			{
 				HDC MemDC = CreateCompatibleDC(PaintStruct.hdc);
 
-				if (CurrentlyDrawing == TRUE)
-				{
-					if (gScratchBitmap != NULL)
-					{						
-						SelectObject(MemDC, gScratchBitmap);						
-					}
-				}
-				else
-				{
-					if (gSnipStates[gCurrentSnipState] != NULL)
-					{						
-						SelectObject(MemDC, gSnipStates[gCurrentSnipState]);						
-					}
+				if (gSnipBitmap != NULL)
+				{						
+					SelectObject(MemDC, gSnipBitmap);						
 				}
 
-				BitBlt(PaintStruct.hdc, 2, 56, gCaptureWidth, gCaptureHeight, MemDC, 0, 0, SRCCOPY);
+				BitBlt(PaintStruct.hdc, SNIP_CLIENT_LEFT, SNIP_CLIENT_TOP, gCaptureWidth, gCaptureHeight, MemDC, 0, 0, SRCCOPY);
 
 				DeleteDC(MemDC);
+
+				// Draw the box or arrow that's being dragged out on top of the snip. It's clipped to the snip, the same as it
+				// will be once it's drawn into it.
+				if (CurrentlyDrawing == TRUE && gShapePreview.Type != SHAPE_NONE)
+				{
+					PaintShapePreview(PaintStruct.hdc, &gShapePreview);
+				}
 			}	
 
 			EndPaint(Window, &PaintStruct);
@@ -2324,9 +2711,13 @@ void DrawButton(_In_ DRAWITEMSTRUCT* DrawItemStruct, _In_ BUTTON Button)
 
 	TextOutW(DrawItemStruct->hDC, TextX, TextY, Button.Caption, (int)wcslen(Button.Caption));
 
-	MoveToEx(DrawItemStruct->hDC, TextX + 6, TextY + 13, NULL);
+	// Underline the first letter if it's the hotkey. (The redact button's caption changes with its mode, but its hotkey doesn't.)
+	if (Button.Caption[0] == (wchar_t)Button.Hotkey)
+	{
+		MoveToEx(DrawItemStruct->hDC, TextX + 6, TextY + 13, NULL);
 
-	LineTo(DrawItemStruct->hDC, TextX , TextY + 13);
+		LineTo(DrawItemStruct->hDC, TextX , TextY + 13);
+	}
 
 	if (DeleteObject(ButtonFont) == 0)
 	{
@@ -2398,6 +2789,8 @@ LRESULT CALLBACK CaptureWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_
 
 				gAppState = APPSTATE_BEFORECAPTURE;	
 
+				StopAnalysis(&gAnalysis);
+
 				for (UINT8 Counter = 0; Counter < _countof(gButtons); Counter++)
 				{
 					if (gButtons[Counter]->Id == BUTTON_NEW || gButtons[Counter]->Id == BUTTON_DELAY)
@@ -2432,118 +2825,56 @@ LRESULT CALLBACK CaptureWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_
 		{
 			if (gCleanScreenShot != NULL)
 			{
-				PAINTSTRUCT PaintStruct = { 0 };			
-
-				BeginPaint(Window, &PaintStruct);
+				PAINTSTRUCT PaintStruct = { 0 };
 
-				HDC BackBufferDC = CreateCompatibleDC(PaintStruct.hdc);
+				OVERLAYPIECE Pieces[OVERLAY_MAX_PIECES] = { 0 };
 
-				HBITMAP ScreenShotCopy = CopyImage(gCleanScreenShot, IMAGE_BITMAP, 0, 0, 0);
-
-				SelectObject(BackBufferDC, ScreenShotCopy);				
-
-				if (MouseHasMovedWhileLeftMouseButtonWasDown)
-				{					
-					SelectObject(BackBufferDC, (HBRUSH)GetStockObject(NULL_BRUSH));
-
-					Rectangle(BackBufferDC, gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.top, gCaptureSelectionRectangle.right, gCaptureSelectionRectangle.bottom);
-				}
-
-				BLENDFUNCTION BlendFunction = { AC_SRC_OVER, 0, 128, AC_SRC_ALPHA };
-
-				HDC AlphaDC = CreateCompatibleDC(PaintStruct.hdc);
+				BeginPaint(Window, &PaintStruct);
 
-									 // B G R A
-				UCHAR BitmapBits[] = { 0xAA, 0xAA, 0xAA, 0xFF };
+				// gDimmedScreenShot was darkened once when the screenshot was taken, so every piece of the overlay is
+				// just a copy from one screenshot or the other. The pieces don't overlap, so nothing is drawn twice and
+				// no back buffer is needed, and only the parts that changed since the last paint are copied at all.
+				HDC CleanDC = CreateCompatibleDC(PaintStruct.hdc);
 
-				// Create 1 32-bit pixel.
-				HBITMAP AlphaBitmap = CreateBitmap(1, 1, 1, 32, BitmapBits);
+				SelectObject(CleanDC, gCleanScreenShot);
 
-				SelectObject(AlphaDC, AlphaBitmap);
+				HDC DimmedDC = CreateCompatibleDC(PaintStruct.hdc);
 
-				// This will darken the entire display area if nothing is selected.
-				// Otherwise, it will darken everything to the right side of the selection rectangle.
-				GdiAlphaBlend(
-					BackBufferDC,
-					max(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right),
-					0,
-					gDisplayWidth - max(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right),
-					max(gDisplayHeight, gCaptureSelectionRectangle.top),
-					AlphaDC,
-					0,
-					0,
-					1,
-					1,
-					BlendFunction);
+				SelectObject(DimmedDC, gDimmedScreenShot);
 
-				// This darkens everything to the left side of the selection rectangle
-				// Not needed if the user is not holding down the left mouse button
-				if (LMouseButtonDown)
-				{
-					GdiAlphaBlend(
-						BackBufferDC,
-						0,
-						0,
-						min(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right),
-						max(gDisplayHeight, gCaptureSelectionRectangle.top),
-						AlphaDC,
-						0,
-						0,
-						1,
-						1,
-						BlendFunction);
-				}
+				UINT32 PieceCount = GetOverlayPieces(&gCaptureSelectionRectangle, MouseHasMovedWhileLeftMouseButtonWasDown, gDisplayWidth, gDisplayHeight, Pieces);
 
-				// This darkens everything directly above the selection rectangle
-				if (LMouseButtonDown)
+				for (UINT32 Piece = 0; Piece < PieceCount; Piece++)
 				{
-					GdiAlphaBlend(
-						BackBufferDC,
-						min(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right),
-						0,
-						max(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right) - min(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right),
-						min(gCaptureSelectionRectangle.top, gCaptureSelectionRectangle.bottom),
-						AlphaDC,
-						0,
-						0,
-						1,
-						1,
-						BlendFunction);
-				}
+					RECT Area = { 0 };
 
-				//// This darkens everything directly below the selection rectangle
-				if (LMouseButtonDown)
-				{
-					GdiAlphaBlend(
-						BackBufferDC,
-						min(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right),
-						max(gCaptureSelectionRectangle.top, gCaptureSelectionRectangle.bottom),
-						max(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right) - min(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right),
-						max(gCaptureSelectionRectangle.bottom, gDisplayHeight),
-						AlphaDC,
-						0,
-						0,
-						1,
-						1,
-						BlendFunction);
-				}
+					if (IntersectRect(&Area, &Pieces[Piece].Rect, &PaintStruct.rcPaint) == FALSE)
+					{
+						continue;
+					}
 
-				// Finally, blit the fully-drawn backbuffer to the screen.
-				BitBlt(PaintStruct.hdc, 0, 0, gDisplayWidth, gDisplayHeight, BackBufferDC, 0, 0, SRCCOPY);		
-				
-				if (ScreenShotCopy)
-				{
-					DeleteObject(ScreenShotCopy);
+					if (Pieces[Piece].Kind == OVERLAYPIXEL_OUTLINE)
+					{
+						FillRect(PaintStruct.hdc, &Area, (HBRUSH)GetStockObject(BLACK_BRUSH));
+					}
+					else
+					{
+						BitBlt(
+							PaintStruct.hdc,
+							Area.left,
+							Area.top,
+							Area.right - Area.left,
+							Area.bottom - Area.top,
+							Pieces[Piece].Kind == OVERLAYPIXEL_CLEAN ? CleanDC : DimmedDC,
+							Area.left,
+							Area.top,
+							SRCCOPY);
+					}
 				}
 
-				DeleteDC(BackBufferDC);
-				
-				if (AlphaBitmap)
-				{
-					DeleteObject(AlphaBitmap);
-				}
+				DeleteDC(CleanDC);
 
-				DeleteDC(AlphaDC);
+				DeleteDC(DimmedDC);
 
 				EndPaint(Window, &PaintStruct);
 			}
@@ -2575,6 +2906,8 @@ LRESULT CALLBACK CaptureWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_
 
 			Mouse.y = GET_Y_LPARAM(LParam);
 
+			SnapToCaptureEdges(&Mouse);
+
 			gCaptureSelectionRectangle.left = Mouse.x;
 
 			gCaptureSelectionRectangle.right = Mouse.x;
@@ -2597,6 +2930,12 @@ LRESULT CALLBACK CaptureWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_
 		{
 			if (LMouseButtonDown)
 			{
+				RECT PreviousSelection = gCaptureSelectionRectangle;
+
+				BOOL PreviouslyOutlined = MouseHasMovedWhileLeftMouseButtonWasDown;
+
+				RECT Damage[OVERLAY_MAX_DAMAGE] = { 0 };
+
 				MouseHasMovedWhileLeftMouseButtonWasDown = TRUE;
 
 				POINT Mouse = { 0 };
@@ -2605,11 +2944,20 @@ LRESULT CALLBACK CaptureWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_
 
 				Mouse.y = GET_Y_LPARAM(LParam);
 
+				SnapToCaptureEdges(&Mouse);
+
 				gCaptureSelectionRectangle.right = Mouse.x;
 
 				gCaptureSelectionRectangle.bottom = Mouse.y;				
 
-				InvalidateRect(Window, NULL, FALSE);
+				// Only repaint the strips along the edges of the selection that went from dimmed to clean or back, and
+				// where the outline was or is now. On a big desktop that's a tiny fraction of the whole thing.
+				UINT32 DamageCount = GetOverlayDamage(&PreviousSelection, PreviouslyOutlined, &gCaptureSelectionRectangle, TRUE, gDisplayWidth, gDisplayHeight, Damage);
+
+				for (UINT32 Index = 0; Index < DamageCount; Index++)
+				{
+					InvalidateRect(Window, &Damage[Index], FALSE);
+				}
 
 				UpdateWindow(gCaptureWindowHandle);
 			}
@@ -2624,6 +2972,47 @@ LRESULT CALLBACK CaptureWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_
 	return(Result);
 }
 
+void SnapToCaptureEdges(_Inout_ POINT* Mouse)
+{
+	// Holding Alt drags the selection freely. If the user is quick enough to start dragging before the edges have
+	// been found, there's just nothing to snap to until they have.
+	if ((GetKeyState(VK_MENU) & 0x8000) || IsAnalysisReady(&gAnalysis, ANALYSISRESULT_EDGES) == FALSE)
+	{
+		return;
+	}
+
+	POINT Screen = *Mouse;
+
+	UINT DpiX = 96;
+
+	UINT DpiY = 96;
+
+	ClientToScreen(gCaptureWindowHandle, &Screen);
+
+	// SNAP_DISTANCE is in pixels at 96 DPI, so that snapping reaches just as far on a 4K monitor at 200% as it does
+	// on a 1080p one at 100%.
+	if (GetDpiForMonitor(MonitorFromPoint(Screen, MONITOR_DEFAULTTONEAREST), MDT_EFFECTIVE_DPI, &DpiX, &DpiY) != S_OK)
+	{
+		DpiX = 96;
+	}
+
+	INT32 Distance = MulDiv(SNAP_DISTANCE, (int)DpiX, 96);
+
+	INT32 SnappedX = Mouse->x;
+
+	INT32 SnappedY = Mouse->y;
+
+	// Each side is snapped on its own, so a corner of the selection snaps into the corner of a window, and a side
+	// near just one edge only snaps to that one.
+	SnapToVerticalEdge(&gAnalysis.SnapEdges, Mouse->x, Mouse->y, Distance, &SnappedX);
+
+	SnapToHorizontalEdge(&gAnalysis.SnapEdges, Mouse->x, Mouse->y, Distance, &SnappedY);
+
+	Mouse->x = SnappedX;
+
+	Mouse->y = SnappedY;
+}
+
 void CaptureWindow_OnLeftButtonUp(void)
 {	
 	MyOutputDebugStringW(L"[%s] Line %d: Left mouse button up over capture window. Selection complete.\n", __FUNCTIONW__, __LINE__);
@@ -2636,52 +3025,33 @@ void CaptureWindow_OnLeftButtonUp(void)
 
 		ShowWindow(gCaptureWindowHandle, SW_HIDE);
 
-		ShowWindow(gMainWindowHandle, SW_RESTORE);
-
-		RECT CurrentWindowPos = { 0 };
+		// The selection is done, and the analysis was only for dragging it out, so stop the workers and free what
+		// they made rather than leaving them running until the next capture.
+		StopAnalysis(&gAnalysis);
 
-		// Includes both client and non-client area. In other words it returns the same values that I passed in to CreateWindowEx
-		GetWindowRect(gMainWindowHandle, &CurrentWindowPos);
+		ShowWindow(gMainWindowHandle, SW_RESTORE);
 
 		// The reason behind all this is because depending on how the user dragged the selection rectangle, it might be inverted,
 		// i.e. the right could actually be the left and the top could be the bottom.
-		int PreviousWindowWidth  = CurrentWindowPos.right - CurrentWindowPos.left;
-
-		int PreviousWindowHeight = CurrentWindowPos.bottom - CurrentWindowPos.top;
-		
 		gCaptureWidth  = (gCaptureSelectionRectangle.right - gCaptureSelectionRectangle.left) > 0 ? (gCaptureSelectionRectangle.right - gCaptureSelectionRectangle.left) + ((int)gShouldAddDropShadow * 8) : (gCaptureSelectionRectangle.left - gCaptureSelectionRectangle.right) + ((int)gShouldAddDropShadow * 8);
 
 		gCaptureHeight = (gCaptureSelectionRectangle.bottom - gCaptureSelectionRectangle.top) > 0 ? (gCaptureSelectionRectangle.bottom - gCaptureSelectionRectangle.top) + ((int)gShouldAddDropShadow * 8) : (gCaptureSelectionRectangle.top - gCaptureSelectionRectangle.bottom) + ((int)gShouldAddDropShadow * 8);		
 
-		int NewWindowWidth  = 0;
-
-		int NewWindowHeight = 0;
-
-		if (gCaptureWidth > PreviousWindowWidth - 20)
-		{
-			NewWindowWidth = gCaptureWidth + 20;
-		}
-		else
-		{
-			NewWindowWidth = PreviousWindowWidth;
-		}
-
-		NewWindowHeight = gCaptureHeight + PreviousWindowHeight + 7;
+		// Remember where on the desktop this was, in screen coordinates, so that the same region can be snipped again.
+		SetRect(
+			&gLastCaptureRegion,
+			min(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right) + gDisplayLeft,
+			min(gCaptureSelectionRectangle.top, gCaptureSelectionRectangle.bottom) + gDisplayTop,
+			max(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right) + gDisplayLeft,
+			max(gCaptureSelectionRectangle.top, gCaptureSelectionRectangle.bottom) + gDisplayTop);
 
-		SetWindowPos(
-			gMainWindowHandle,
-			HWND_TOP,
-			CurrentWindowPos.left,
-			CurrentWindowPos.top,
-			NewWindowWidth,
-			NewWindowHeight,
-			0);
+		FitMainWindowToSnip();
 
-		gSnipStates[0] = CreateBitmap(gCaptureWidth, gCaptureHeight, 1, 32, NULL);
+		gSnipBitmap = CreateDibSection32(gCaptureWidth, gCaptureHeight, &gSnipBits);
 
 		HDC SnipDC = CreateCompatibleDC(NULL);
 
-		SelectObject(SnipDC, gSnipStates[0]);		
+		SelectObject(SnipDC, gSnipBitmap);		
 
 		HDC BigDC = CreateCompatibleDC(NULL);
 
@@ -2689,211 +3059,166 @@ void CaptureWindow_OnLeftButtonUp(void)
 		
 		BitBlt(SnipDC, 0, 0, gCaptureWidth, gCaptureHeight, BigDC, min(gCaptureSelectionRectangle.left, gCaptureSelectionRectangle.right), min(gCaptureSelectionRectangle.top, gCaptureSelectionRectangle.bottom), SRCCOPY);
 
-		if (gShouldAddDropShadow)
-		{
-			MyOutputDebugStringW(L"[%s] Line %d: Adding shadow effect.\n", __FUNCTIONW__, __LINE__);
-
-			HPEN Pen0 = CreatePen(PS_SOLID, 1, RGB(128, 128, 128));
+		DeleteDC(BigDC);
 
-			HPEN Pen1 = CreatePen(PS_SOLID, 1, RGB(159, 159, 159));
+		DeleteDC(SnipDC);
 
-			HPEN Pen2 = CreatePen(PS_SOLID, 1, RGB(172, 172, 172));
+		FinishSnip();
+	}
+}
 
-			HPEN Pen3 = CreatePen(PS_SOLID, 1, RGB(192, 192, 192));
-
-			HPEN Pen4 = CreatePen(PS_SOLID, 1, RGB(215, 215, 215));
-
-			HPEN Pen5 = CreatePen(PS_SOLID, 1, RGB(234, 234, 234));
-
-			HPEN Pen6 = CreatePen(PS_SOLID, 1, RGB(245, 245, 245));
-
-			HPEN Pen7 = CreatePen(PS_SOLID, 1, RGB(250, 250, 250));
-
-
-			//
-			SelectObject(SnipDC, Pen0);
-
-			MoveToEx(SnipDC, 0, gCaptureHeight - 8, NULL);
-
-			LineTo(SnipDC, gCaptureWidth - 8, gCaptureHeight - 8);
-
-			LineTo(SnipDC, gCaptureWidth - 8, -1);
-
-			//
-			SelectObject(SnipDC, Pen1);
-
-			MoveToEx(SnipDC, 0, gCaptureHeight - 7, NULL);
-
-			LineTo(SnipDC, gCaptureWidth - 7, gCaptureHeight - 7);
-
-			LineTo(SnipDC, gCaptureWidth - 7, -1);
-
-			//
-			SelectObject(SnipDC, Pen2);
-
-			MoveToEx(SnipDC, 0, gCaptureHeight - 6, NULL);
-
-			LineTo(SnipDC, gCaptureWidth - 6, gCaptureHeight - 6);
-
-			LineTo(SnipDC, gCaptureWidth - 6, -1);
-			
-			//
-			SelectObject(SnipDC, Pen3);
-
-			MoveToEx(SnipDC, 0, gCaptureHeight - 5, NULL);
-
-			LineTo(SnipDC, gCaptureWidth - 5, gCaptureHeight - 5);
-
-			LineTo(SnipDC, gCaptureWidth - 5, -1);
-
-			//
-			SelectObject(SnipDC, Pen4);
-
-			MoveToEx(SnipDC, 0, gCaptureHeight - 4, NULL);
-
-			LineTo(SnipDC, gCaptureWidth - 4, gCaptureHeight - 4);
-
-			LineTo(SnipDC, gCaptureWidth - 4, -1);
+// Does everything that comes after the snip's pixels have been captured into gSnipBitmap, and the main window
+// has been sized to fit it: adds the drop shadow, starts the document and the session, and turns on the tools.
+void FinishSnip(void)
+{
+	if (gShouldAddDropShadow)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: Adding shadow effect.\n", __FUNCTIONW__, __LINE__);
 
-			//
-			SelectObject(SnipDC, Pen5);
+		GdiFlush();
 
-			MoveToEx(SnipDC, 0, gCaptureHeight - 3, NULL);
+		AddDropShadow(gSnipBits, gCaptureWidth, gCaptureHeight);
+	}
 
-			LineTo(SnipDC, gCaptureWidth - 3, gCaptureHeight - 3);
+	GdiFlush();
 
-			LineTo(SnipDC, gCaptureWidth - 3, -1);
+	// The snip as it is right now is the base that every annotation gets drawn on top of.
+	if (gSnipBits == NULL || InitializeDocument(&gDocument, gSnipBits, gCaptureWidth, gCaptureHeight, min((SIZE_T)gUndoMemory, MAXSIZE_T / (1024 * 1024)) * 1024 * 1024, RenderAnnotation, NULL) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: InitializeDocument failed!\n", __FUNCTIONW__, __LINE__);
 
-			//
-			SelectObject(SnipDC, Pen6);
+		CRASH(0);
+	}
 
-			MoveToEx(SnipDC, 0, gCaptureHeight - 2, NULL);
+	StartSession();
 
-			LineTo(SnipDC, gCaptureWidth - 2, gCaptureHeight - 2);
+	EnableSnipEditing();
 
-			LineTo(SnipDC, gCaptureWidth - 2, -1);
+	if (gRememberLastTool)
+	{
+		if (GetSnipExRegValue(REG_LASTTOOLNAME, &gLastTool) != ERROR_SUCCESS)
+		{
+			CRASH(0);
+		}
 
-			//
-			SelectObject(SnipDC, Pen7);
+		if (gLastTool >= BUTTON_HILIGHT)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: Selecting previously used tool: %d\n", __FUNCTIONW__, __LINE__, gLastTool);
 
-			MoveToEx(SnipDC, 0, gCaptureHeight - 1, NULL);
+			SendMessageW(gMainWindowHandle, WM_COMMAND, gLastTool, 0);
+		}
+		else
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: No previously used tool detected.\n", __FUNCTIONW__, __LINE__);
+		}
+	}
 
-			LineTo(SnipDC, gCaptureWidth - 1, gCaptureHeight - 1);
+	SetCursor(LoadCursorW(NULL, IDC_ARROW));
 
-			LineTo(SnipDC, gCaptureWidth - 1, -1);
+	gNewButton.SelectedTool = FALSE;
 
-			// MSDN says that DeleteObject will fail and return 0 if the object is still selected into a DC.
-			// Yet Pen7 is still selected, yet DeleteObject does not fail when we try to delete Pen7, and I don't know why.
+	gNewButton.State = BUTTONSTATE_NORMAL;
 
-			DeleteObject(Pen0);
+	gDelayButton.SelectedTool = FALSE;
 
-			DeleteObject(Pen1);
+	gDelayButton.State = BUTTONSTATE_NORMAL;
 
-			DeleteObject(Pen2);
+	if (gAutoCopy)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
 
-			DeleteObject(Pen3);
+		if (CopyButton_Click() == FALSE)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
 
-			DeleteObject(Pen4);
+			CRASH(0);
+		}
+	}
 
-			DeleteObject(Pen5);
+	if (gAutoSave)
+	{
+		AutoSaveSnip();
+	}
+}
 
-			DeleteObject(Pen6);
+BOOL NewButton_Click(void)
+{
+	BOOL Result              = FALSE;
 
-			DeleteObject(Pen7);			
+	UINT32* CleanBits        = NULL;
 
-			                                    //
-			                                    //
-			                                    //
-			                                    //
-			                                    //
-			//////////////////////////////////////
+	UINT32* DimmedBits       = NULL;
 
-			// Set the alpha to 0 on the shadowed bits
+	// Now the "capture window" comes to life. It is a duplicate of the entire display surface,
+	// including multiple monitors. Take a screenshot of it, then overlay it on top of the real
+	// desktop, and then allow the user to select a subsection of the screenshot with the mouse.
 
-			//GetDIBits()
-		}
+	PrepareForCapture();
 
+	gCleanScreenShot = CreateDibSection32(gDisplayWidth, gDisplayHeight, &CleanBits);
 
+	if (gCleanScreenShot == NULL)
+	{
+		MessageBoxW(NULL, L"CreateDibSection32 failed!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
 
-		DeleteDC(BigDC);
+		goto Cleanup;
+	}
 
-		DeleteDC(SnipDC);
+	if (CaptureDesktop(&gCaptureSource, CleanBits) == FALSE)
+	{
+		MessageBoxW(NULL, L"Failed to capture the desktop!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
 
-		for (UINT8 Counter = 0; Counter < _countof(gButtons); Counter++)
-		{
-			gButtons[Counter]->Enabled = TRUE;
-		}
+		goto Cleanup;
+	}
 
-		if (gRememberLastTool)
-		{
-			if (GetSnipExRegValue(REG_LASTTOOLNAME, &gLastTool) != ERROR_SUCCESS)
-			{
-				CRASH(0);
-			}
+	// Darken a copy of the whole screenshot once now, rather than every time the capture overlay is painted.
+	gDimmedScreenShot = CreateDibSection32(gDisplayWidth, gDisplayHeight, &DimmedBits);
 
-			if (gLastTool >= BUTTON_HILIGHT)
-			{
-				MyOutputDebugStringW(L"[%s] Line %d: Selecting previously used tool: %d\n", __FUNCTIONW__, __LINE__, gLastTool);
+	if (gDimmedScreenShot == NULL)
+	{
+		MessageBoxW(NULL, L"CreateDibSection32 failed!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
 
-				SendMessageW(gMainWindowHandle, WM_COMMAND, gLastTool, 0);
-			}
-			else
-			{
-				MyOutputDebugStringW(L"[%s] Line %d: No previously used tool detected.\n", __FUNCTIONW__, __LINE__);
-			}
-		}
+		goto Cleanup;
+	}
 
-		wchar_t TitleBuffer[128] = { 0 };
+	// The dimmed copy is the first thing the analysis makes, and this thread helps make it. Everything else the
+	// analysis works out carries on in the background while the user drags out the selection.
+	BLENDMODE DimMode = gGammaCorrectBlending ? BLENDMODE_LINEAR : BLENDMODE_SRGB;
 
-		(void)_snwprintf_s(TitleBuffer, _countof(TitleBuffer), _TRUNCATE, L"SnipEx - Current Snip: %dx%d", gCaptureWidth, gCaptureHeight);
+	if (StartAnalysis(&gAnalysis, CleanBits, gDisplayWidth, gDisplayHeight, DimmedBits, 0xFFAAAAAA, 128, DimMode) == FALSE || WaitForAnalysis(&gAnalysis, ANALYSISRESULT_DIMMED) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: Failed to start the analysis. Dimming the screenshot here instead.\n", __FUNCTIONW__, __LINE__);
 
-		SetWindowTextW(gMainWindowHandle, TitleBuffer);
+		StopAnalysis(&gAnalysis);
 
-		SetCursor(LoadCursorW(NULL, IDC_ARROW));
+		CopyMemory(DimmedBits, CleanBits, (SIZE_T)gDisplayWidth * gDisplayHeight * sizeof(UINT32));
 
-		gNewButton.SelectedTool = FALSE;
+		RECT DisplayRect = { 0, 0, gDisplayWidth, gDisplayHeight };
 
-		gNewButton.State = BUTTONSTATE_NORMAL;
+		BlendRect(DimmedBits, gDisplayWidth, &DisplayRect, 0xFFAAAAAA, 128, DimMode);
+	}
 
-		gDelayButton.SelectedTool = FALSE;
+	ShowWindow(gCaptureWindowHandle, SW_SHOW);
 
-		gDelayButton.State = BUTTONSTATE_NORMAL;
+	SetWindowPos(gCaptureWindowHandle, HWND_TOP, gDisplayLeft, gDisplayTop, gDisplayWidth, gDisplayHeight, SWP_NOOWNERZORDER | SWP_FRAMECHANGED);
 
-		if (gAutoCopy)
-		{
-			MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
+	SetForegroundWindow(gCaptureWindowHandle);
 
-			if (CopyButton_Click() == FALSE)
-			{
-				MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
+	Result = TRUE;
 
-				CRASH(0);
-			}
-		}
+Cleanup:
 
-		if (gAutoSave)
-		{
-			AutoSaveSnip();
-		}
-	}
+	return(Result);
 }
 
-BOOL NewButton_Click(void)
+// Puts the main window back to its starting size and minimizes it, and throws away the last screenshot and snip,
+// ready for a new one to be taken.
+void PrepareForCapture(void)
 {
-	BOOL Result              = FALSE;
-
 	RECT CurrentWindowPos    = { 0 };
 
 	wchar_t TitleBuffer[64]  = { 0 };
 
-	HDC ScreenDC             = NULL;
-
-	HDC MemoryDC             = NULL;
-
-	// Now the "capture window" comes to life. It is a duplicate of the entire display surface,
-	// including multiple monitors. Take a screenshot of it, then overlay it on top of the real
-	// desktop, and then allow the user to select a subsection of the screenshot with the mouse.
-
 	KillTimer(gMainWindowHandle, DELAY_TIMER);
 
 	gCurrentDelayCountdown = gStartingDelayCountdown;
@@ -2919,6 +3244,9 @@ BOOL NewButton_Click(void)
 
 	RtlZeroMemory(&gCaptureSelectionRectangle, sizeof(RECT));
 
+	// The analysis reads the screenshot, so it has to stop before the screenshot is deleted.
+	StopAnalysis(&gAnalysis);
+
 	if (gCleanScreenShot != NULL)
 	{
 		if (DeleteObject(gCleanScreenShot) == 0)
@@ -2931,94 +3259,46 @@ BOOL NewButton_Click(void)
 		gCleanScreenShot = NULL;
 	}
 
-	if (gScratchBitmap != NULL)
+	if (gDimmedScreenShot != NULL)
 	{
-		if (DeleteObject(gScratchBitmap) == 0)
+		if (DeleteObject(gDimmedScreenShot) == 0)
 		{
-			MyOutputDebugStringW(L"[%s] Line %d: Failed to DeleteObject(gScratchBitmap!)!\n", __FUNCTIONW__, __LINE__);
+			MyOutputDebugStringW(L"[%s] Line %d: Failed to DeleteObject(gDimmedScreenShot!)!\n", __FUNCTIONW__, __LINE__);
 
 			CRASH(0);
 		}
 
-		gScratchBitmap = NULL;
-	}
-
-	for (INT8 SnipState = 0; SnipState < _countof(gSnipStates) - 1; SnipState++)
-	{
-		if (gSnipStates[SnipState] != NULL)
-		{
-			if (DeleteObject(gSnipStates[SnipState]) == 0)
-			{
-				MyOutputDebugStringW(L"[%s] Line %d: Failed to DeleteObject(gSnipStates[%d]!)!\n", __FUNCTIONW__, __LINE__, SnipState);
-
-				CRASH(0);
-			}
-
-			gSnipStates[SnipState] = NULL;
-		}
+		gDimmedScreenShot = NULL;
 	}
 
-	gCurrentSnipState = 0;
-
-
-
-	// We just minimized the main window. Allow a brief moment for the minimize animation to finish before capturing the screen.
-	Sleep(250);
-
-
-
-	ScreenDC = GetDC(NULL);
-
-	if (ScreenDC == NULL)
-	{
-		MessageBoxW(NULL, L"GetDC(NULL) failed!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);	
-
-		goto Cleanup;
-	}
+	// Nothing in the old snip needs recovering any more.
+	CloseSession(&gSession, TRUE);
 
-	MemoryDC = CreateCompatibleDC(ScreenDC);
+	FreeDocument(&gDocument);
 
-	if (MemoryDC == NULL)
+	if (gSnipBitmap != NULL)
 	{
-		MessageBoxW(NULL, L"CreateCompatibleDC(ScreenDC) failed!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);		
-
-		goto Cleanup;
-	}
+		if (DeleteObject(gSnipBitmap) == 0)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: Failed to DeleteObject(gSnipBitmap!)!\n", __FUNCTIONW__, __LINE__);
 
-	gCleanScreenShot = CreateCompatibleBitmap(ScreenDC, gDisplayWidth, gDisplayHeight);
+			CRASH(0);
+		}
 
-	if (gCleanScreenShot == NULL)
-	{
-		MessageBoxW(NULL, L"CreateCompatibleBitmap failed!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
+		gSnipBitmap = NULL;
 
-		goto Cleanup;
+		gSnipBits = NULL;
 	}
 
-	SelectObject(MemoryDC, gCleanScreenShot);
-
-	BitBlt(MemoryDC, 0, 0, gDisplayWidth, gDisplayHeight, ScreenDC, gDisplayLeft, gDisplayTop, SRCCOPY);
-
-	ShowWindow(gCaptureWindowHandle, SW_SHOW);
-
-	SetWindowPos(gCaptureWindowHandle, HWND_TOP, gDisplayLeft, gDisplayTop, gDisplayWidth, gDisplayHeight, SWP_NOOWNERZORDER | SWP_FRAMECHANGED);
-
-	SetForegroundWindow(gCaptureWindowHandle);
-
-	Result = TRUE;
-
-Cleanup:
+	StopTextLineDetection();
 
-	if (MemoryDC != NULL)
-	{
-		DeleteDC(MemoryDC);
-	}
+	StopRedactSearch();
 
-	if (ScreenDC != NULL)
-	{
-		ReleaseDC(NULL, ScreenDC);
-	}
+	// We just minimized the main window. Allow a brief moment for the minimize animation to finish before capturing the screen.
+	Sleep(250);
 
-	return(Result);
+	// Monitors may have been plugged in, unplugged or rearranged since the last snip.
+	RefreshDisplayLayout();
 }
 
 // Returns TRUE if the snip was saved. Returns FALSE if there was an error or if user cancelled.
@@ -3180,14 +3460,14 @@ BOOL CopyButton_Click(void)
 
 	HDC DestinationDC     = NULL;
 
-	if (gSnipStates[gCurrentSnipState] == NULL)
+	if (gSnipBitmap == NULL)
 	{
-		MyOutputDebugStringW(L"[%s] Line %d: gSnipStates[gCurrentSnipState] is NULL. This is a bug.\n",__FUNCTIONW__, __LINE__);
+		MyOutputDebugStringW(L"[%s] Line %d: gSnipBitmap is NULL. This is a bug.\n",__FUNCTIONW__, __LINE__);
 
 		goto Cleanup;
 	}
 
-	GetObjectW(gSnipStates[gCurrentSnipState], sizeof(BITMAP), &Bitmap);
+	GetObjectW(gSnipBitmap, sizeof(BITMAP), &Bitmap);
 
 	ClipboardCopy = CreateBitmap(Bitmap.bmWidth, Bitmap.bmHeight, 1, 32, NULL);
 
@@ -3195,7 +3475,7 @@ BOOL CopyButton_Click(void)
 
 	DestinationDC = CreateCompatibleDC(NULL);
 
-	SelectObject(SourceDC, gSnipStates[gCurrentSnipState]);
+	SelectObject(SourceDC, gSnipBitmap);
 
 	SelectObject(DestinationDC, ClipboardCopy);
 
@@ -3287,7 +3567,7 @@ BOOL SaveBitmapToFile(_In_ wchar_t* FilePath)
 		goto Cleanup;
 	}
 
-	if (GetObject(gSnipStates[gCurrentSnipState], sizeof(BITMAP), &Bitmap) == 0)
+	if (GetObject(gSnipBitmap, sizeof(BITMAP), &Bitmap) == 0)
 	{
 		MyOutputDebugStringW(L"[%s] Line %d: GetObject failed!\n", __FUNCTIONW__, __LINE__);
 
@@ -3387,10 +3667,10 @@ BOOL SaveBitmapToFile(_In_ wchar_t* FilePath)
 	
 	DC = CreateCompatibleDC(NULL);
 	
-	SelectObject(DC, gSnipStates[gCurrentSnipState]);
+	SelectObject(DC, gSnipBitmap);
 
 	// Retrieve the color table (RGBQUAD array) and the bits (array of palette indices) from the DIB.  
-	GetDIBits(DC, gSnipStates[gCurrentSnipState], 0, (WORD)BitmapInfoHeaderPointer->biHeight, Bits, BitmapInfoPointer, DIB_RGB_COLORS);
+	GetDIBits(DC, gSnipBitmap, 0, (WORD)BitmapInfoHeaderPointer->biHeight, Bits, BitmapInfoPointer, DIB_RGB_COLORS);
 
 	BitmapFileHeader.bfType = 0x4d42;	// "BM"
 
@@ -3546,7 +3826,7 @@ BOOL SavePngToFile(_In_ wchar_t* FilePath)
 		goto Cleanup;
 	}	
 
-	if ((Error = GdipCreateBitmapFromHBITMAP(gSnipStates[gCurrentSnipState], NULL, &GdipBitmap)) != 0)
+	if ((Error = GdipCreateBitmapFromHBITMAP(gSnipBitmap, NULL, &GdipBitmap)) != 0)
 	{
 		MessageBoxW(gMainWindowHandle, L"GdipCreateBitmapFromHBITMAP failed!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
 
@@ -3644,6 +3924,43 @@ HRESULT AddAllMenuItems(_In_ HINSTANCE Instance)
 		goto Exit;
 	}
 
+	if ((Result = GetSnipExRegValue(REG_GAMMACORRECTNAME, &gGammaCorrectBlending)) != ERROR_SUCCESS)
+	{
+		goto Exit;
+	}
+
+	if ((Result = GetSnipExRegValue(REG_REDACTALLNAME, &gRedactEveryOccurrence)) != ERROR_SUCCESS)
+	{
+		goto Exit;
+	}
+
+	if ((Result = GetSnipExRegValue(REG_BRUSHTIPNAME, &gBrushTip)) != ERROR_SUCCESS)
+	{
+		goto Exit;
+	}
+
+	if ((Result = GetSnipExRegValue(REG_BRUSHSIZENAME, &gBrushSize)) != ERROR_SUCCESS)
+	{
+		goto Exit;
+	}
+
+	if (gBrushTip > BRUSHTIP_CHISEL)
+	{
+		gBrushTip = BRUSHTIP_SQUARE;
+	}
+
+	gBrushSize = min(max(gBrushSize, BRUSH_MIN_SIZE), BRUSH_MAX_SIZE);
+
+	if ((Result = GetSnipExRegValue(REG_UNDOMEMORYNAME, &gUndoMemory)) != ERROR_SUCCESS)
+	{
+		goto Exit;
+	}
+
+	if ((Result = GetSnipExRegValue(REG_SESSIONRECOVERYNAME, &gSessionRecovery)) != ERROR_SUCCESS)
+	{
+		goto Exit;
+	}
+
 	GetSnipExRegString(REG_AUTOSAVEPATHNAME, gAutoSavePath, _countof(gAutoSavePath));
 
 	if ((Result = GetSnipExRegValue(REG_HOTKEYINTERCEPTNAME, &gHotkeyIntercept)) != ERROR_SUCCESS)
@@ -3669,6 +3986,35 @@ HRESULT AddAllMenuItems(_In_ HINSTANCE Instance)
 		AppendMenuW(SystemMenu, MF_STRING | MF_UNCHECKED, SYSCMD_AUTOCOPY, L"Automatically copy snip to clipboard");
 	}
 
+	if (gGammaCorrectBlending > 0)
+	{
+		AppendMenuW(SystemMenu, MF_STRING | MF_CHECKED, SYSCMD_GAMMA, L"Gamma-correct blending");
+	}
+	else
+	{
+		AppendMenuW(SystemMenu, MF_STRING | MF_UNCHECKED, SYSCMD_GAMMA, L"Gamma-correct blending");
+	}
+
+	if (gRedactEveryOccurrence > 0)
+	{
+		AppendMenuW(SystemMenu, MF_STRING | MF_CHECKED, SYSCMD_REDACTALL, L"Redact every occurrence");
+	}
+	else
+	{
+		AppendMenuW(SystemMenu, MF_STRING | MF_UNCHECKED, SYSCMD_REDACTALL, L"Redact every occurrence");
+	}
+
+	if (gSessionRecovery > 0)
+	{
+		AppendMenuW(SystemMenu, MF_STRING | MF_CHECKED, SYSCMD_RECOVERY, L"Recover snips after a crash");
+	}
+	else
+	{
+		AppendMenuW(SystemMenu, MF_STRING | MF_UNCHECKED, SYSCMD_RECOVERY, L"Recover snips after a crash");
+	}
+
+	AppendMenuW(SystemMenu, MF_STRING, SYSCMD_BRUSHTIP, GetBrushTipMenuText(gBrushTip));
+
 	if (gAutoSave > 0 && wcslen(gAutoSavePath) > 0)
 	{
 		AppendMenuW(SystemMenu, MF_STRING | MF_CHECKED, SYSCMD_AUTOSAVE, L"Automatically save screen captures");
@@ -3706,6 +4052,10 @@ HRESULT AddAllMenuItems(_In_ HINSTANCE Instance)
 
 	AppendMenuW(SystemMenu, MF_STRING, SYSCMD_UNDO, L"Undo (Ctrl+Z)");
 
+	AppendMenuW(SystemMenu, MF_STRING, SYSCMD_REDO, L"Redo (Ctrl+Y)");
+
+	AppendMenuW(SystemMenu, MF_STRING, SYSCMD_REPEATREGION, L"Repeat last region (Ctrl+Alt+Shift+R)");
+
 	if (GetSnippingToolHookState() == SNIPPINGTOOLHOOKSTATE_REPLACED)
 	{
 		ReplaceCommand = SYSCMD_RESTORE;
@@ -4217,7 +4567,7 @@ Exit:
 
 BOOL AutoSaveSnip(void)
 {
-	if (!gAutoSave || wcslen(gAutoSavePath) == 0 || gSnipStates[gCurrentSnipState] == NULL)
+	if (!gAutoSave || wcslen(gAutoSavePath) == 0 || gSnipBitmap == NULL)
 	{
 		return(FALSE);
 	}
@@ -4240,52 +4590,1192 @@ BOOL AutoSaveSnip(void)
 }
 
 
-BOOL FullScreenSnip(_In_ BOOL AllMonitors)
+// Sets gDisplayWidth, gDisplayHeight, gDisplayLeft and gDisplayTop to the desktop of gCaptureSource.
+void SetDisplayArea(void)
+{
+	gDisplayWidth  = (UINT16)(gCaptureSource.Layout.Desktop.right - gCaptureSource.Layout.Desktop.left);
+
+	gDisplayHeight = (UINT16)(gCaptureSource.Layout.Desktop.bottom - gCaptureSource.Layout.Desktop.top);
+
+	gDisplayLeft   = (INT16)gCaptureSource.Layout.Desktop.left;
+
+	gDisplayTop    = (INT16)gCaptureSource.Layout.Desktop.top;
+}
+
+void RefreshDisplayLayout(void)
 {
-	if (NewButton_Click() == FALSE)
+	if (RefreshCaptureLayout(&gCaptureSource) == FALSE)
 	{
-		return(FALSE);
+		return;
 	}
 
-	if (AllMonitors)
+	SetDisplayArea();
+
+	MyOutputDebugStringW(L"[%s] Line %d: The displays changed. The screen area is now %dx%d at %d,%d with %u monitors.\n", __FUNCTIONW__, __LINE__, gDisplayWidth, gDisplayHeight, gDisplayLeft, gDisplayTop, gCaptureSource.Layout.MonitorCount);
+
+	// Only the part of the last region that is still on the desktop can be snipped again. If none of it is, it's
+	// left empty, and "Repeat last region" starts a normal snip instead.
+	if (IntersectRect(&gLastCaptureRegion, &gLastCaptureRegion, &gCaptureSource.Layout.Desktop) == FALSE)
 	{
-		gCaptureSelectionRectangle.left   = 0;
+		SetRectEmpty(&gLastCaptureRegion);
+	}
+}
+
+BOOL FullScreenSnip(_In_ BOOL AllMonitors)
+{
+	RefreshDisplayLayout();
 
-		gCaptureSelectionRectangle.top    = 0;
+	RECT Region = { gDisplayLeft, gDisplayTop, gDisplayLeft + gDisplayWidth, gDisplayTop + gDisplayHeight };
 
-		gCaptureSelectionRectangle.right  = gDisplayWidth;
+	// The monitors come from the capture source, so that a replayed capture snips the monitors it was saved with.
+	if (AllMonitors == FALSE)
+	{
+		RECT WindowRect = { 0 };
+
+		GetWindowRect(gMainWindowHandle, &WindowRect);
 
-		gCaptureSelectionRectangle.bottom = gDisplayHeight;
+		FindCaptureMonitor(&gCaptureSource.Layout, &WindowRect, &Region);
 	}
-	else
+
+	return(RegionSnip(&Region));
+}
+
+BOOL RegionSnip(_In_ const RECT* Region)
+{
+	BOOL Result = FALSE;
+
+	CAPTUREPLAN Plan = { 0 };
+
+	RECT Selection = *Region;
+
+	// The plan works in desktop coordinates, where 0,0 is the top left of the virtual desktop, like the capture overlay.
+	OffsetRect(&Selection, -gDisplayLeft, -gDisplayTop);
+
+	if (PlanRegionCapture(&Selection, gShouldAddDropShadow ? 8 : 0, gDisplayWidth, gDisplayHeight, &Plan) == FALSE)
 	{
-		HMONITOR Monitor = MonitorFromWindow(gMainWindowHandle, MONITOR_DEFAULTTONEAREST);
+		MyOutputDebugStringW(L"[%s] Line %d: The region is no longer on the desktop. Starting a normal snip instead.\n", __FUNCTIONW__, __LINE__);
 
-		MONITORINFO MonitorInfo = { sizeof(MONITORINFO) };
+		return(NewButton_Click());
+	}
 
-		if (GetMonitorInfoW(Monitor, &MonitorInfo))
-		{
-			gCaptureSelectionRectangle.left   = MonitorInfo.rcMonitor.left - gDisplayLeft;
+	PrepareForCapture();
 
-			gCaptureSelectionRectangle.top    = MonitorInfo.rcMonitor.top - gDisplayTop;
+	gCaptureSelectionRectangle = Plan.Selection;
 
-			gCaptureSelectionRectangle.right  = MonitorInfo.rcMonitor.right - gDisplayLeft;
+	gCaptureWidth  = Plan.Width;
 
-			gCaptureSelectionRectangle.bottom = MonitorInfo.rcMonitor.bottom - gDisplayTop;
-		}
-		else
-		{
-			gCaptureSelectionRectangle.left   = 0;
+	gCaptureHeight = Plan.Height;
 
-			gCaptureSelectionRectangle.top    = 0;
+	gSnipBitmap = CreateDibSection32(gCaptureWidth, gCaptureHeight, &gSnipBits);
+
+	if (gSnipBitmap == NULL)
+	{
+		MessageBoxW(NULL, L"CreateDibSection32 failed!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
 
-			gCaptureSelectionRectangle.right  = gDisplayWidth;
+		goto Cleanup;
+	}
 
-			gCaptureSelectionRectangle.bottom = gDisplayHeight;
-		}
+	// Only the region itself is captured, straight into the snip.
+	if (CaptureRegion(&gCaptureSource, &Plan, gSnipBits) == FALSE)
+	{
+		MessageBoxW(NULL, L"Failed to capture the region!", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
+
+		goto Cleanup;
 	}
 
-	CaptureWindow_OnLeftButtonUp();
+	SetRect(&gLastCaptureRegion, Plan.Selection.left + gDisplayLeft, Plan.Selection.top + gDisplayTop, Plan.Selection.right + gDisplayLeft, Plan.Selection.bottom + gDisplayTop);
 
-	return(TRUE);
-}
\ No newline at end of file
+	gAppState = APPSTATE_AFTERCAPTURE;
+
+	ShowWindow(gMainWindowHandle, SW_RESTORE);
+
+	SetForegroundWindow(gMainWindowHandle);
+
+	FitMainWindowToSnip();
+
+	FinishSnip();
+
+	InvalidateRect(gMainWindowHandle, NULL, FALSE);
+
+	Result = TRUE;
+
+Cleanup:
+
+	return(Result);
+}
+
+BOOL RepeatLastRegion(void)
+{
+	// This can shrink or empty gLastCaptureRegion, if the monitors it was on are gone.
+	RefreshDisplayLayout();
+
+	if (IsRectEmpty(&gLastCaptureRegion))
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: There is no last region yet. Starting a normal snip instead.\n", __FUNCTIONW__, __LINE__);
+
+		ShowWindow(gMainWindowHandle, SW_RESTORE);
+
+		SetForegroundWindow(gMainWindowHandle);
+
+		return(NewButton_Click());
+	}
+
+	return(RegionSnip(&gLastCaptureRegion));
+}
+
+
+// Creates a blank top-down 32bpp DIB section. Bits receives a pointer to the pixels, which stays
+// valid until the bitmap is deleted.
+HBITMAP CreateDibSection32(_In_ INT32 Width, _In_ INT32 Height, _Out_ UINT32** Bits)
+{
+	BITMAPINFO BitmapInfo = { 0 };
+
+	BitmapInfo.bmiHeader.biSize        = sizeof(BITMAPINFOHEADER);
+
+	BitmapInfo.bmiHeader.biWidth       = Width;
+
+	// A negative height makes the DIB top-down, so row 0 in memory is row 0 on the screen.
+	BitmapInfo.bmiHeader.biHeight      = -Height;
+
+	BitmapInfo.bmiHeader.biPlanes      = 1;
+
+	BitmapInfo.bmiHeader.biBitCount    = 32;
+
+	BitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+	HBITMAP Bitmap = CreateDIBSection(NULL, &BitmapInfo, DIB_RGB_COLORS, (void**)Bits, NULL, 0);
+
+	if (Bitmap == NULL)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: CreateDIBSection failed!\n", __FUNCTIONW__, __LINE__);
+
+		*Bits = NULL;
+	}
+
+	return(Bitmap);
+}
+
+
+// Darkens the bottom and right 8 pixels of the snip, which were captured from just outside of the
+// selection, so that the snip looks like it is casting a shadow. Each of the 8 bands is lighter
+// than the one inside of it. Over a white background the sRGB blend gives the same grays
+// (128, 159, 172, 192, 215, 234, 245, 250) that used to be drawn with pens.
+void AddDropShadow(_Inout_ UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height)
+{
+	static const UINT8 ShadowAlpha[8] = { 127, 96, 83, 63, 40, 21, 10, 5 };
+
+	for (INT32 Band = 0; Band < _countof(ShadowAlpha); Band++)
+	{
+		// The bottom edge, from the left side up to (but not including) the right edge's column.
+		RECT Bottom = { 0, Height - 8 + Band, Width - 8 + Band, Height - 7 + Band };
+
+		// The right edge, from its corner with the bottom edge all the way up to the top.
+		RECT Right = { Width - 8 + Band, 0, Width - 7 + Band, Height - 7 + Band };
+
+		BlendRect(Pixels, Width, &Bottom, 0xFF000000, ShadowAlpha[Band], gGammaCorrectBlending ? BLENDMODE_LINEAR : BLENDMODE_SRGB);
+
+		BlendRect(Pixels, Width, &Right, 0xFF000000, ShadowAlpha[Band], gGammaCorrectBlending ? BLENDMODE_LINEAR : BLENDMODE_SRGB);
+	}
+}
+
+
+// Makes gRedactSource, a pixelated or blurred copy of gSnipBits, depending on gRedactMode.
+// Returns FALSE if memory could not be allocated.
+BOOL CreateRedactSource(void)
+{
+	gRedactSource = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)gCaptureWidth * gCaptureHeight * sizeof(UINT32));
+
+	if (gRedactSource == NULL)
+	{
+		return(FALSE);
+	}
+
+	// Make sure GDI has finished any drawing it has queued up on the snip bitmap before we read its pixels.
+	GdiFlush();
+
+	if (gRedactMode == REDACTMODE_PIXELATE)
+	{
+		PixelateImage(gSnipBits, gRedactSource, gCaptureWidth, gCaptureHeight, REDACT_PIXELATE_SIZE);
+	}
+	else if (BlurImage(gSnipBits, gRedactSource, gCaptureWidth, gCaptureHeight, REDACT_BLUR_RADIUS) == FALSE)
+	{
+		HeapFree(GetProcessHeap(), 0, gRedactSource);
+
+		gRedactSource = NULL;
+
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+
+DWORD WINAPI RedactSearchThreadProc(_In_ LPVOID Parameter)
+{
+	UNREFERENCED_PARAMETER(Parameter);
+
+	if (FindTemplateMatches(gRedactSearchPixels, gCaptureWidth, gCaptureHeight, &gRedactSearchBounds, MATCH_MAX_DIFFERENCE, MATCH_MIN_CORRELATION, &gRedactSearchMatches) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: FindTemplateMatches failed!\n", __FUNCTIONW__, __LINE__);
+	}
+
+	HeapFree(GetProcessHeap(), 0, gRedactSearchPixels);
+
+	gRedactSearchPixels = NULL;
+
+	PostMessageW(gMainWindowHandle, WM_REDACT_MATCHES_FOUND, 0, 0);
+
+	return(0);
+}
+
+BOOL StartRedactSearch(_In_ const ANNOTATION* Stroke)
+{
+	StopRedactSearch();
+
+	gRedactSearchStroke = Stroke;
+
+	gRedactSearchStep = Stroke->Step;
+
+	gRedactSearchBounds = Stroke->Bounds;
+
+	gRedactSearchPixels = gRedactOriginal;
+
+	gRedactSearchSource = gRedactSource;
+
+	gRedactOriginal = NULL;
+
+	gRedactSource = NULL;
+
+	gRedactSearchThread = CreateThread(NULL, 0, RedactSearchThreadProc, NULL, 0, NULL);
+
+	if (gRedactSearchThread == NULL)
+	{
+		StopRedactSearch();
+
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+void RedactEveryOccurrence(void)
+{
+	// Left over from a search that was stopped, or another one is still going and will post its own.
+	if (gRedactSearchThread == NULL || WaitForSingleObject(gRedactSearchThread, 0) != WAIT_OBJECT_0)
+	{
+		return;
+	}
+
+	MyOutputDebugStringW(L"[%s] Line %d: Found %u other places that look like the redacted area.\n", __FUNCTIONW__, __LINE__, gRedactSearchMatches.Count);
+
+	// The copies have to be part of the same change as the stroke, so that one undo takes them all back off. If
+	// the stroke was undone, or anything has been drawn since, it's too late to ask.
+	const ANNOTATION* Stroke = gRedactSearchStroke;
+
+	BOOL StrokeIsOnTop = gDocument.Count > 0 && gDocument.Annotations[gDocument.Count - 1] == Stroke && Stroke->Step == gRedactSearchStep && gDocument.Step == gRedactSearchStep;
+
+	if (StrokeIsOnTop == FALSE || gLeftMouseButtonIsDown == TRUE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: The snip has changed since the redact stroke. Not asking about the other places.\n", __FUNCTIONW__, __LINE__);
+
+		StopRedactSearch();
+
+		return;
+	}
+
+	if (gRedactSearchMatches.Count == 0)
+	{
+		StopRedactSearch();
+
+		return;
+	}
+
+	wchar_t Question[128] = { 0 };
+
+	(void)_snwprintf_s(Question, _countof(Question), _TRUNCATE, L"The same thing appears %u more time%s in this snip. Redact %s too?", gRedactSearchMatches.Count, gRedactSearchMatches.Count == 1 ? L"" : L"s", gRedactSearchMatches.Count == 1 ? L"it" : L"them");
+
+	if (MessageBoxW(gMainWindowHandle, Question, L"Redact Every Occurrence", MB_YESNO | MB_ICONQUESTION) == IDYES)
+	{
+		// Redact the same pixels, relative to each match, that the stroke redacted, the same way the stroke did.
+		for (UINT32 Index = 0; Index < gRedactSearchMatches.Count; Index++)
+		{
+			if (AddTranslatedStroke(&gDocument, Stroke, gRedactSearchMatches.Matches[Index].Rectangle.left - Stroke->Bounds.left, gRedactSearchMatches.Matches[Index].Rectangle.top - Stroke->Bounds.top, gRedactSearchSource) == NULL)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: AddTranslatedStroke failed!\n", __FUNCTIONW__, __LINE__);
+
+				break;
+			}
+		}
+
+		RECT SnipRect = { 0, 0, gCaptureWidth, gCaptureHeight };
+
+		SnipToClientRect(&SnipRect);
+
+		InvalidateRect(gMainWindowHandle, &SnipRect, FALSE);
+
+		// The snip was already copied when the stroke ended, without these.
+		if (gAutoCopy)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
+
+			if (CopyButton_Click() == FALSE)
+			{
+				MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
+			}
+		}
+	}
+
+	StopRedactSearch();
+}
+
+void StopRedactSearch(void)
+{
+	if (gRedactSearchThread != NULL)
+	{
+		WaitForSingleObject(gRedactSearchThread, INFINITE);
+
+		CloseHandle(gRedactSearchThread);
+
+		gRedactSearchThread = NULL;
+	}
+
+	if (gRedactSearchPixels != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, gRedactSearchPixels);
+
+		gRedactSearchPixels = NULL;
+	}
+
+	if (gRedactSearchSource != NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, gRedactSearchSource);
+
+		gRedactSearchSource = NULL;
+	}
+
+	FreeMatches(&gRedactSearchMatches);
+
+	gRedactSearchStroke = NULL;
+}
+
+
+void FillRegionAt(_In_ POINT Point)
+{
+	// Make sure GDI has finished any drawing it has queued up on the snip bitmap before we read its pixels.
+	GdiFlush();
+
+	FLOODREGION Region = { 0 };
+
+	if (FloodFillRegion(gSnipBits, gCaptureWidth, gCaptureHeight, Point.x, Point.y, FLOOD_TOLERANCE, FALSE, &Region) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: FloodFillRegion failed!\n", __FUNCTIONW__, __LINE__);
+
+		return;
+	}
+
+	MyOutputDebugStringW(L"[%s] Line %d: Found %llu pixels of similar color around %dx%d.\n", __FUNCTIONW__, __LINE__, Region.PixelCount, Point.x, Point.y);
+
+	// The pen fills with its color. The redact tool blacks out, or copies from gRedactSource if it pixelates or blurs.
+	UINT32 Color = 0xFF000000;
+
+	const UINT32* Source = NULL;
+
+	if (gPenButton.SelectedTool == TRUE)
+	{
+		Color = ColorToPixel(GetToolColor(gPenButton.Color));
+	}
+	else
+	{
+		Source = gRedactSource;
+	}
+
+	ANNOTATION* Annotation = AddRegionAnnotation(&gDocument, &Region, Color, Source);
+
+	if (Annotation == NULL)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: AddRegionAnnotation failed!\n", __FUNCTIONW__, __LINE__);
+
+		FreeFloodRegion(&Region);
+
+		return;
+	}
+
+	RECT Damage = Annotation->Bounds;
+
+	SnipToClientRect(&Damage);
+
+	InvalidateRect(gMainWindowHandle, &Damage, FALSE);
+}
+
+
+COLORREF GetToolColor(_In_ UINT8 Color)
+{
+	switch (Color)
+	{
+		case COLOR_RED:
+		{
+			return(RGB(255, 0, 0));
+		}
+		case COLOR_GREEN:
+		{
+			return(RGB(0, 255, 0));
+		}
+		case COLOR_BLUE:
+		{
+			return(RGB(0, 0, 255));
+		}
+		case COLOR_BLACK:
+		{
+			return(RGB(0, 0, 0));
+		}
+		case COLOR_WHITE:
+		{
+			return(RGB(255, 255, 255));
+		}
+		case COLOR_YELLOW:
+		{
+			return(RGB(255, 255, 0));
+		}
+		default:
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown tool color %d!\n", __FUNCTIONW__, __LINE__, Color);
+		}
+	}
+
+	return(RGB(255, 0, 0));
+}
+
+
+INT32 GetBrushWidth(_In_ INT32 BrushHeight)
+{
+	// A round tip is a circle, so that the ends of a stroke are round. The others keep the shape of the original 10 x 20 brush.
+	if (gBrushTip == BRUSHTIP_ROUND)
+	{
+		return(BrushHeight);
+	}
+
+	return(max((BrushHeight * BRUSH_WIDTH) / BRUSH_HEIGHT, 1));
+}
+
+
+wchar_t* GetBrushTipMenuText(_In_ DWORD BrushTip)
+{
+	switch (BrushTip)
+	{
+		case BRUSHTIP_ROUND:
+		{
+			return(L"Brush tip: Round");
+		}
+		case BRUSHTIP_CHISEL:
+		{
+			return(L"Brush tip: Chisel");
+		}
+		default:
+		{
+			return(L"Brush tip: Square");
+		}
+	}
+}
+
+
+UINT32 GetHilightColor(_In_ UINT8 Color)
+{
+	switch (Color)
+	{
+		case COLOR_YELLOW:
+		{
+			return(HILIGHT_YELLOW);
+		}
+		case COLOR_PINK:
+		{
+			return(HILIGHT_PINK);
+		}
+		case COLOR_ORANGE:
+		{
+			return(HILIGHT_ORANGE);
+		}
+		case COLOR_GREEN:
+		{
+			return(HILIGHT_GREEN);
+		}
+		default:
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: BUG: Unknown color in hilighter function!\n", __FUNCTIONW__, __LINE__);
+		}
+	}
+
+	return(0);
+}
+
+
+// COLORREFs are 0x00BBGGRR, but the pixels of a 32bpp DIB section and the annotations in gDocument are 0xAARRGGBB.
+UINT32 ColorToPixel(_In_ COLORREF Color)
+{
+	return(0xFF000000 | ((UINT32)GetRValue(Color) << 16) | ((UINT32)GetGValue(Color) << 8) | (UINT32)GetBValue(Color));
+}
+
+
+COLORREF PixelToColor(_In_ UINT32 Pixel)
+{
+	return(RGB((Pixel >> 16) & 0xFF, (Pixel >> 8) & 0xFF, Pixel & 0xFF));
+}
+
+
+void ShapeToAnnotation(_In_ const SHAPE* Shape, _Out_ ANNOTATION* Annotation)
+{
+	ZeroMemory(Annotation, sizeof(ANNOTATION));
+
+	Annotation->Start = Shape->Start;
+
+	Annotation->End = Shape->End;
+
+	Annotation->BlendMode = gGammaCorrectBlending ? BLENDMODE_LINEAR : BLENDMODE_SRGB;
+
+	if (Shape->Type == SHAPE_SPOTLIGHT)
+	{
+		// A spotlight dims toward black, and touches everything in the snip except its rectangle.
+		Annotation->Type = ANNOTATION_SPOTLIGHT;
+
+		Annotation->Color = (UINT32)SPOTLIGHT_DIM << 24;
+
+		SetRect(&Annotation->Bounds, 0, 0, gCaptureWidth, gCaptureHeight);
+
+		return;
+	}
+
+	if (Shape->Type == SHAPE_CALLOUT)
+	{
+		Annotation->Type = ANNOTATION_CALLOUT;
+
+		Annotation->Color = ColorToPixel(Shape->Color);
+
+		Annotation->PenWidth = SHAPE_PEN_WIDTH;
+
+		// Bounds and Inset are left empty if there's nowhere to put the magnified copy.
+		RECT Source = { 0 };
+
+		if (GetCalloutSource(Shape->Start, Shape->End, gCaptureWidth, gCaptureHeight, &Source) && GetCalloutInset(&Source, gCalloutZoom, gCaptureWidth, gCaptureHeight, &Annotation->Inset))
+		{
+			Annotation->Start.x = Source.left;
+
+			Annotation->Start.y = Source.top;
+
+			Annotation->End.x = Source.right - 1;
+
+			Annotation->End.y = Source.bottom - 1;
+
+			GetCalloutBounds(Annotation, &Annotation->Bounds);
+		}
+
+		return;
+	}
+
+	Annotation->Type = (Shape->Type == SHAPE_BOX) ? ANNOTATION_BOX : ANNOTATION_ARROW;
+
+	Annotation->Color = ColorToPixel(Shape->Color);
+
+	Annotation->PenWidth = SHAPE_PEN_WIDTH;
+
+	GetBoxOrArrowBounds(Annotation, &Annotation->Bounds);
+}
+
+
+void PaintShapePreview(_In_ HDC DC, _In_ const SHAPE* Shape)
+{
+	if (Shape->Type == SHAPE_NONE || gSnipBits == NULL)
+	{
+		return;
+	}
+
+	ANNOTATION Preview = { 0 };
+
+	ShapeToAnnotation(Shape, &Preview);
+
+	RECT Snip = { 0, 0, gCaptureWidth, gCaptureHeight };
+
+	RECT Areas[4] = { 0 };
+
+	UINT32 AreaCount = 0;
+
+	if (Preview.Type == ANNOTATION_SPOTLIGHT)
+	{
+		// A spotlight covers the whole snip, but dragging it out only changes a few strips at a time, and those are all
+		// that get invalidated. The pixels inside its rectangle were already painted correctly by the BitBlt of the snip,
+		// so only the dimmed strips around it that are being repainted need to be drawn here.
+		RECT Clip = { 0 };
+
+		if (GetClipBox(DC, &Clip) == ERROR)
+		{
+			return;
+		}
+
+		OffsetRect(&Clip, -SNIP_CLIENT_LEFT, -SNIP_CLIENT_TOP);
+
+		if (IntersectRect(&Clip, &Clip, &Snip) == FALSE)
+		{
+			return;
+		}
+
+		AreaCount = GetSpotlightStrips(&Preview, &Clip, Areas);
+	}
+	else if (IntersectRect(&Areas[0], &Preview.Bounds, &Snip) == TRUE)
+	{
+		AreaCount = 1;
+	}
+
+	GdiFlush();
+
+	for (UINT32 AreaIndex = 0; AreaIndex < AreaCount; AreaIndex++)
+	{
+		RECT Area = Areas[AreaIndex];
+
+		INT32 AreaWidth = Area.right - Area.left;
+
+		INT32 AreaHeight = Area.bottom - Area.top;
+
+		// Draw onto a copy of the part of the snip under the shape, then put the copy on the screen over the snip.
+		UINT32* Pixels = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)AreaWidth * AreaHeight * sizeof(UINT32));
+
+		if (Pixels == NULL)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: HeapAlloc failed!\n", __FUNCTIONW__, __LINE__);
+
+			return;
+		}
+
+		for (INT32 Row = 0; Row < AreaHeight; Row++)
+		{
+			CopyMemory(&Pixels[(SIZE_T)Row * AreaWidth], &gSnipBits[(SIZE_T)(Area.top + Row) * gCaptureWidth + Area.left], (SIZE_T)AreaWidth * sizeof(UINT32));
+		}
+
+		RASTERTARGET Target = { 0 };
+
+		Target.Pixels = Pixels;
+
+		Target.Stride = AreaWidth;
+
+		Target.Bounds = Area;
+
+		if (Preview.Type == ANNOTATION_SPOTLIGHT)
+		{
+			DrawSpotlight(&Target, &Preview);
+		}
+		else if (Preview.Type == ANNOTATION_CALLOUT)
+		{
+			// Nearest-neighbour is good enough while dragging, and fast enough to keep up with the mouse at any zoom. The
+			// inset is always inside the snip, so it's always inside Area.
+			RECT Source = { Preview.Start.x, Preview.Start.y, Preview.End.x + 1, Preview.End.y + 1 };
+
+			ResampleImageNearest(
+				gSnipBits,
+				gCaptureWidth,
+				&Source,
+				&Pixels[(SIZE_T)(Preview.Inset.top - Area.top) * AreaWidth + (Preview.Inset.left - Area.left)],
+				AreaWidth,
+				Preview.Inset.right - Preview.Inset.left,
+				Preview.Inset.bottom - Preview.Inset.top);
+
+			DrawCallout(&Target, &Preview, NULL);
+		}
+		else
+		{
+			DrawBoxOrArrow(&Target, &Preview);
+		}
+
+		BITMAPINFO BitmapInfo = { 0 };
+
+		BitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+
+		BitmapInfo.bmiHeader.biWidth = AreaWidth;
+
+		// Negative for top-down, the same as the snip.
+		BitmapInfo.bmiHeader.biHeight = -AreaHeight;
+
+		BitmapInfo.bmiHeader.biPlanes = 1;
+
+		BitmapInfo.bmiHeader.biBitCount = 32;
+
+		BitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+		if (SetDIBitsToDevice(DC, SNIP_CLIENT_LEFT + Area.left, SNIP_CLIENT_TOP + Area.top, (DWORD)AreaWidth, (DWORD)AreaHeight, 0, 0, 0, (UINT)AreaHeight, Pixels, &BitmapInfo, DIB_RGB_COLORS) == 0)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: SetDIBitsToDevice failed!\n", __FUNCTIONW__, __LINE__);
+		}
+
+		HeapFree(GetProcessHeap(), 0, Pixels);
+	}
+}
+
+
+HRGN GetSpotlightRegion(_In_ const SHAPE* Shape)
+{
+	HRGN Region = CreateRectRgn(0, 0, 0, 0);
+
+	if (Region == NULL || Shape->Type != SHAPE_SPOTLIGHT)
+	{
+		return(Region);
+	}
+
+	ANNOTATION Spotlight = { 0 };
+
+	ShapeToAnnotation(Shape, &Spotlight);
+
+	RECT Strips[4] = { 0 };
+
+	UINT32 Count = GetSpotlightStrips(&Spotlight, &Spotlight.Bounds, Strips);
+
+	for (UINT32 Index = 0; Index < Count; Index++)
+	{
+		HRGN Strip = CreateRectRgnIndirect(&Strips[Index]);
+
+		if (Strip == NULL)
+		{
+			DeleteObject(Region);
+
+			return(NULL);
+		}
+
+		CombineRgn(Region, Region, Strip, RGN_OR);
+
+		DeleteObject(Strip);
+	}
+
+	return(Region);
+}
+
+
+void GetShapeBounds(_In_ const SHAPE* Shape, _Out_ RECT* Bounds)
+{
+	SetRectEmpty(Bounds);
+
+	if (Shape->Type == SHAPE_NONE)
+	{
+		return;
+	}
+
+	ANNOTATION Annotation = { 0 };
+
+	ShapeToAnnotation(Shape, &Annotation);
+
+	*Bounds = Annotation.Bounds;
+}
+
+
+void RenderAnnotation(_In_ const ANNOTATION* Annotation, _In_ const RECT* Clip, _In_opt_ void* Context)
+{
+	UNREFERENCED_PARAMETER(Context);
+
+	HDC DC = CreateCompatibleDC(NULL);
+
+	SelectObject(DC, gSnipBitmap);
+
+	IntersectClipRect(DC, Clip->left, Clip->top, Clip->right, Clip->bottom);
+
+	if (Annotation->Type == ANNOTATION_TEXT && Annotation->Text != NULL && Annotation->FontSize == sizeof(LOGFONTW))
+	{
+		HFONT Font = CreateFontIndirectW((const LOGFONTW*)Annotation->Font);
+
+		HGDIOBJ OldFont = SelectObject(DC, Font);
+
+		SetBkMode(DC, TRANSPARENT);
+
+		SetTextColor(DC, PixelToColor(Annotation->Color));
+
+		TextOutW(DC, Annotation->Start.x, Annotation->Start.y, Annotation->Text, (int)wcslen(Annotation->Text));
+
+		SelectObject(DC, OldFont);
+
+		if (Font != NULL && DeleteObject(Font) == 0)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: DeleteObject(Font) failed!\n", __FUNCTIONW__, __LINE__);
+		}
+	}
+
+	if (DeleteDC(DC) == 0)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: DeleteDC failed!\n", __FUNCTIONW__, __LINE__);
+	}
+
+	// The document goes straight to the pixels for everything else, so GDI has to be done with them first.
+	GdiFlush();
+}
+
+
+BOOL UndoChange(void)
+{
+	RECT Damage = { 0 };
+
+	SIZE_T JournalBytes = 0;
+
+	UINT64 JournalFileBytes = 0;
+
+	// Make sure GDI has finished any drawing it has queued up on the snip bitmap before the document touches its pixels.
+	GdiFlush();
+
+	if (UndoDocumentStep(&gDocument, &Damage) == FALSE)
+	{
+		return(FALSE);
+	}
+
+	GetJournalUsage(&gDocument.Journal, &JournalBytes, &JournalFileBytes);
+
+	MyOutputDebugStringW(L"[%s] Line %d: Undid a change. Annotations left: %u. Undo journal: %Iu bytes in memory, %llu bytes in its scratch file.\n", __FUNCTIONW__, __LINE__, gDocument.Count, JournalBytes, JournalFileBytes);
+
+	SnipToClientRect(&Damage);
+
+	InvalidateRect(gMainWindowHandle, &Damage, FALSE);
+
+	if (gAutoCopy)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
+
+		if (CopyButton_Click() == FALSE)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
+
+			CRASH(0);
+		}
+	}
+
+	return(TRUE);
+}
+
+BOOL RedoChange(void)
+{
+	RECT Damage = { 0 };
+
+	GdiFlush();
+
+	if (RedoDocumentStep(&gDocument, &Damage) == FALSE)
+	{
+		return(FALSE);
+	}
+
+	MyOutputDebugStringW(L"[%s] Line %d: Redid a change. Annotations: %u\n", __FUNCTIONW__, __LINE__, gDocument.Count);
+
+	SnipToClientRect(&Damage);
+
+	InvalidateRect(gMainWindowHandle, &Damage, FALSE);
+
+	if (gAutoCopy)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: Auto copy enabled. Copying snip to clipboard.\n", __FUNCTIONW__, __LINE__);
+
+		if (CopyButton_Click() == FALSE)
+		{
+			MyOutputDebugStringW(L"[%s] Line %d: Auto copy failed!\n", __FUNCTIONW__, __LINE__);
+
+			CRASH(0);
+		}
+	}
+
+	return(TRUE);
+}
+
+// Moves a rectangle on the snip to where that part of the snip is painted in the main window's client area.
+void SnipToClientRect(_Inout_ RECT* Rect)
+{
+	OffsetRect(Rect, SNIP_CLIENT_LEFT, SNIP_CLIENT_TOP);
+}
+
+// Makes the main window big enough to show a gCaptureWidth x gCaptureHeight snip under the buttons.
+void FitMainWindowToSnip(void)
+{
+	RECT CurrentWindowPos = { 0 };
+
+	// Includes both client and non-client area. In other words it returns the same values that I passed in to CreateWindowEx
+	GetWindowRect(gMainWindowHandle, &CurrentWindowPos);
+
+	int PreviousWindowWidth  = CurrentWindowPos.right - CurrentWindowPos.left;
+
+	int PreviousWindowHeight = CurrentWindowPos.bottom - CurrentWindowPos.top;
+
+	int NewWindowWidth  = 0;
+
+	int NewWindowHeight = 0;
+
+	if (gCaptureWidth > PreviousWindowWidth - 20)
+	{
+		NewWindowWidth = gCaptureWidth + 20;
+	}
+	else
+	{
+		NewWindowWidth = PreviousWindowWidth;
+	}
+
+	NewWindowHeight = gCaptureHeight + PreviousWindowHeight + 7;
+
+	SetWindowPos(
+		gMainWindowHandle,
+		HWND_TOP,
+		CurrentWindowPos.left,
+		CurrentWindowPos.top,
+		NewWindowWidth,
+		NewWindowHeight,
+		0);
+}
+
+DWORD WINAPI TextLineThreadProc(_In_ LPVOID Parameter)
+{
+	UNREFERENCED_PARAMETER(Parameter);
+
+	if (FindTextLines(gTextLinePixels, gCaptureWidth, gCaptureHeight, gCaptureWidth, &gTextLines) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: FindTextLines failed! Out of memory?\n", __FUNCTIONW__, __LINE__);
+	}
+
+	HeapFree(GetProcessHeap(), 0, gTextLinePixels);
+
+	gTextLinePixels = NULL;
+
+	return(0);
+}
+
+BOOL StartTextLineDetection(void)
+{
+	StopTextLineDetection();
+
+	gTextLinePixels = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)gCaptureWidth * gCaptureHeight * sizeof(UINT32));
+
+	if (gTextLinePixels == NULL)
+	{
+		return(FALSE);
+	}
+
+	// Copy the pixels now, on this thread, so that the snip can keep changing while gTextLineThread works.
+	GdiFlush();
+
+	CopyMemory(gTextLinePixels, gSnipBits, (SIZE_T)gCaptureWidth * gCaptureHeight * sizeof(UINT32));
+
+	gTextLineThread = CreateThread(NULL, 0, TextLineThreadProc, NULL, 0, NULL);
+
+	if (gTextLineThread == NULL)
+	{
+		HeapFree(GetProcessHeap(), 0, gTextLinePixels);
+
+		gTextLinePixels = NULL;
+
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+const struct TEXTLINES* GetDetectedTextLines(void)
+{
+	if (gTextLineThread == NULL || WaitForSingleObject(gTextLineThread, 0) != WAIT_OBJECT_0)
+	{
+		return(NULL);
+	}
+
+	return(&gTextLines);
+}
+
+void StopTextLineDetection(void)
+{
+	if (gTextLineThread != NULL)
+	{
+		WaitForSingleObject(gTextLineThread, INFINITE);
+
+		CloseHandle(gTextLineThread);
+
+		gTextLineThread = NULL;
+	}
+
+	FreeTextLines(&gTextLines);
+}
+
+// Turns on everything that works on a snip, once gSnipBitmap and gDocument are ready.
+void EnableSnipEditing(void)
+{
+	wchar_t TitleBuffer[128] = { 0 };
+
+	// Look for lines of text in the snip on a background thread, so that the hilighter can snap to them.
+	if (StartTextLineDetection() == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: StartTextLineDetection failed! The hilighter will not snap to text.\n", __FUNCTIONW__, __LINE__);
+	}
+
+	for (UINT8 Counter = 0; Counter < _countof(gButtons); Counter++)
+	{
+		gButtons[Counter]->Enabled = TRUE;
+	}
+
+	(void)_snwprintf_s(TitleBuffer, _countof(TitleBuffer), _TRUNCATE, L"SnipEx - Current Snip: %dx%d", gCaptureWidth, gCaptureHeight);
+
+	SetWindowTextW(gMainWindowHandle, TitleBuffer);
+}
+
+// Gets the path of the session file, %LOCALAPPDATA%\SnipEx\Session.snx, and makes its folder if it isn't there yet.
+BOOL GetSessionPath(_Out_writes_(PathLength) wchar_t* Path, _In_ DWORD PathLength)
+{
+	DWORD Length = GetEnvironmentVariableW(L"LOCALAPPDATA", Path, PathLength);
+
+	if (Length == 0 || Length >= PathLength)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: GetEnvironmentVariableW(LOCALAPPDATA) failed! Error 0x%08lx\n", __FUNCTIONW__, __LINE__, GetLastError());
+
+		return(FALSE);
+	}
+
+	if (wcscat_s(Path, PathLength, L"\\" SESSION_FOLDER) != 0)
+	{
+		return(FALSE);
+	}
+
+	if (CreateDirectoryW(Path, NULL) == FALSE && GetLastError() != ERROR_ALREADY_EXISTS)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: CreateDirectoryW(%s) failed! Error 0x%08lx\n", __FUNCTIONW__, __LINE__, Path, GetLastError());
+
+		return(FALSE);
+	}
+
+	if (wcscat_s(Path, PathLength, L"\\" SESSION_FILE_NAME) != 0)
+	{
+		return(FALSE);
+	}
+
+	return(TRUE);
+}
+
+// Starts writing gDocument to the session file, so that it can be recovered if SnipEx crashes. If it can't, the
+// snip can still be worked on, it just won't be recoverable.
+void StartSession(void)
+{
+	wchar_t Path[MAX_PATH] = { 0 };
+
+	if (gSessionRecovery == FALSE)
+	{
+		return;
+	}
+
+	if (GetSessionPath(Path, _countof(Path)) == FALSE || OpenSession(&gSession, Path, gDocument.Base, gCaptureWidth, gCaptureHeight) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: Could not start the session file! This snip will not be recoverable.\n", __FUNCTIONW__, __LINE__);
+
+		return;
+	}
+
+	gDocument.Session = &gSession;
+}
+
+// If the session file from last time is still there, SnipEx didn't close normally, so ask the user whether they
+// want the snip back, and if they do, put it and every change to it back the way they were. Returns TRUE if it did.
+BOOL RecoverSession(void)
+{
+	BOOL Recovered = FALSE;
+
+	wchar_t Path[MAX_PATH] = { 0 };
+
+	UINT8* Data = NULL;
+
+	SIZE_T Size = 0;
+
+	SESSIONREADER Reader = { 0 };
+
+	BOOL Reading = FALSE;
+
+	UINT32 Replayed = 0;
+
+	if (gSessionRecovery == FALSE || GetSessionPath(Path, _countof(Path)) == FALSE)
+	{
+		return(FALSE);
+	}
+
+	if (LoadSessionFile(Path, &Data, &Size) == FALSE)
+	{
+		return(FALSE);
+	}
+
+	// The whole file is in memory now, so delete it before doing anything with it. If something in it makes SnipEx
+	// crash again, the next start won't find it and try to recover it again, and again.
+	if (DeleteFileW(Path) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: DeleteFileW(%s) failed! Error 0x%08lx. Not recovering it.\n", __FUNCTIONW__, __LINE__, Path, GetLastError());
+
+		goto Cleanup;
+	}
+
+	if ((Reading = BeginSessionRead(&Reader, Data, Size)) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: The session file left over from last time is not a session.\n", __FUNCTIONW__, __LINE__);
+
+		goto Cleanup;
+	}
+
+	if (MessageBoxW(NULL, L"SnipEx did not close normally last time. Do you want to recover the snip you were working on?", L"SnipEx", MB_YESNO | MB_ICONQUESTION | MB_SYSTEMMODAL) != IDYES)
+	{
+		goto Cleanup;
+	}
+
+	gSnipBitmap = CreateDibSection32(Reader.Width, Reader.Height, &gSnipBits);
+
+	if (gSnipBitmap == NULL || gSnipBits == NULL)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: CreateDibSection32 failed for a %dx%d snip!\n", __FUNCTIONW__, __LINE__, Reader.Width, Reader.Height);
+
+		goto Failed;
+	}
+
+	// Whatever part of the snip was never written stays black.
+	if (ReadSessionBase(&Reader, gSnipBits) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: The session file ended before the whole snip. Recovering what there is of it.\n", __FUNCTIONW__, __LINE__);
+	}
+
+	if (InitializeDocument(&gDocument, gSnipBits, Reader.Width, Reader.Height, min((SIZE_T)gUndoMemory, MAXSIZE_T / (1024 * 1024)) * 1024 * 1024, RenderAnnotation, NULL) == FALSE)
+	{
+		MyOutputDebugStringW(L"[%s] Line %d: InitializeDocument failed!\n", __FUNCTIONW__, __LINE__);
+
+		goto Failed;
+	}
+
+	gCaptureWidth  = Reader.Width;
+
+	gCaptureHeight = Reader.Height;
+
+	gAppState = APPSTATE_AFTERCAPTURE;
+
+	ShowWindow(gMainWindowHandle, SW_RESTORE);
+
+	FitMainWindowToSnip();
+
+	// The old file is all in memory, so the new session can replace it, and the changes go into it as they're put back.
+	StartSession();
+
+	Replayed = ReplayDocumentSession(&gDocument, &Reader);
+
+	MyOutputDebugStringW(L"[%s] Line %d: Recovered a %dx%d snip and %u changes to it from the session file.\n", __FUNCTIONW__, __LINE__, gCaptureWidth, gCaptureHeight, Replayed);
+
+	EnableSnipEditing();
+
+	InvalidateRect(gMainWindowHandle, NULL, FALSE);
+
+	Recovered = TRUE;
+
+	goto Cleanup;
+
+Failed:
+
+	MessageBoxW(NULL, L"SnipEx could not recover the snip from last time. It has been thrown away.", L"Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL);
+
+	if (gSnipBitmap != NULL)
+	{
+		DeleteObject(gSnipBitmap);
+
+		gSnipBitmap = NULL;
+	}
+
+	gSnipBits = NULL;
+
+Cleanup:
+
+	if (Reading)
+	{
+		EndSessionRead(&Reader);
+	}
+
+	HeapFree(GetProcessHeap(), 0, Data);
+
+	return(Recovered);
+}
@@ -18,6 +18,66 @@
 
 #define REG_AUTOSAVEPATHNAME L"AutoSavePath"
 
+#define REG_GAMMACORRECTNAME L"GammaCorrectBlending"
+
+#define REG_REDACTALLNAME    L"RedactEveryOccurrence"
+
+#define REG_BRUSHTIPNAME     L"BrushTip"
+
+#define REG_BRUSHSIZENAME    L"BrushSize"
+
+#define REG_UNDOMEMORYNAME   L"UndoMemoryMB"
+
+#define REG_SESSIONRECOVERYNAME L"SessionRecovery"
+
+// Where the snip and its changes are written as they happen, under %LOCALAPPDATA%, so that they can be recovered
+// if SnipEx crashes. Deleted whenever SnipEx closes normally or a new snip is taken.
+#define SESSION_FOLDER       L"SnipEx"
+
+#define SESSION_FILE_NAME    L"Session.snx"
+
+// How many megabytes of copies of the snip undo keeps to begin with, to put changes back without redrawing them.
+// Changes that don't fit are still undone, just more slowly. 0 turns it off.
+#define UNDO_MEMORY_MB       256
+
+// Posted to the main window by gRedactSearchThread when it has finished looking for other places to redact.
+#define WM_REDACT_MATCHES_FOUND (WM_APP + 102)
+
+// Where the top-left corner of the snip is painted in the main window's client area, under the buttons.
+#define SNIP_CLIENT_LEFT     2
+
+#define SNIP_CLIENT_TOP      56
+
+// How far up and to the left of the mouse typed text starts, so that it sits under the text cursor.
+#define TEXT_CURSOR_OFFSET_X 4
+
+#define TEXT_CURSOR_OFFSET_Y 2
+
+// The size of the hilighter and redact brushes to begin with, in pixels. [ and ] change the height, and the width follows it.
+#define BRUSH_WIDTH          10
+
+#define BRUSH_HEIGHT         20
+
+// The size of the blocks that the redact tool's pixelate mode averages together, and the radius of its blur mode.
+#define REDACT_PIXELATE_SIZE 12
+
+#define REDACT_BLUR_RADIUS   8
+
+// How wide the outline of the box tool and the line of the arrow tool are, in pixels.
+#define SHAPE_PEN_WIDTH      2
+
+// How wide the freehand pen draws, in pixels.
+#define PEN_WIDTH            3
+
+// How far off, per color channel, a pixel can be from the one that was Shift+clicked on and still be filled or redacted along with it.
+#define FLOOD_TOLERANCE      16
+
+// The size of the square eraser brush, in pixels. EraserCursor.cur outlines a square this size around its hot spot.
+#define ERASER_SIZE          16
+
+// How much the spotlight tool darkens the snip outside of its rectangle, from 0 (not at all) to 255 (all the way to black).
+#define SPOTLIGHT_DIM        128
+
 
 // You could refer to an individual button like gButtons[BUTTON_NEW - 10001], gButtons[BUTTON_DELAY - 10001], etc.
 
@@ -39,6 +99,14 @@
 
 #define BUTTON_TEXT	   10009
 
+#define BUTTON_PEN     10010
+
+#define BUTTON_ERASER  10011
+
+#define BUTTON_SPOTLIGHT 10012
+
+#define BUTTON_CALLOUT 10013
+
 
 #define COLOR_NONE		0	// For buttons for which color is not applicable, such as the Save button for example
 
@@ -73,18 +141,26 @@
 
 #define SYSCMD_AUTOSAVE 20007
 
+// 20008 is SYSCMD_HOTKEY, in SnipExTray.h.
+#define SYSCMD_GAMMA    20009
 
-#define DELAY_TIMER    30001
+#define SYSCMD_REDACTALL 20010
 
+#define SYSCMD_BRUSHTIP  20011
+
+#define SYSCMD_REDO      20012
+
+#define SYSCMD_REPEATREGION 20013
+
+#define SYSCMD_RECOVERY  20014
 
-// This is like Microsoft's POINT struct, but smaller.
-// It's just for efficiency's sake since I don't need LONGs for this, yet...
-typedef struct SMALLPOINT
-{
-	UINT16 x;
-	UINT16 y;
 
-} SMALLPOINT;
+// The id of the global hotkey, Ctrl+Alt+Shift+R, that snips the same region as last time.
+#define HOTKEY_REPEATREGION 1
+
+
+#define DELAY_TIMER    30001
+
 
 typedef enum BUTTONSTATE
 {
@@ -113,6 +189,38 @@ typedef struct BUTTON
 
 } BUTTON;
 
+// Right-clicking the Redact button cycles through these.
+typedef enum REDACTMODE
+{
+	REDACTMODE_BLACK,
+	REDACTMODE_PIXELATE,
+	REDACTMODE_BLUR
+
+} REDACTMODE;
+
+typedef enum SHAPETYPE
+{
+	SHAPE_NONE,
+	SHAPE_BOX,
+	SHAPE_ARROW,
+	SHAPE_SPOTLIGHT,
+	SHAPE_CALLOUT
+
+} SHAPETYPE;
+
+// Declared in SnipExDocument.h, which the other files that include this one don't need.
+struct ANNOTATION;
+
+// A box, an arrow, or the rectangle of a spotlight or a callout, in snip coordinates.
+typedef struct SHAPE
+{
+	SHAPETYPE Type;
+	POINT     Start;
+	POINT     End;
+	COLORREF  Color;
+
+} SHAPE;
+
 typedef enum APPSTATE
 {
 	APPSTATE_BEFORECAPTURE,
@@ -134,11 +242,21 @@ LRESULT CALLBACK CaptureWindowCallback(_In_ HWND Window, _In_ UINT Message, _In_
 
 BOOL CALLBACK TextEditCallback(_In_ HWND Dialog, _In_ UINT Message, _In_ WPARAM WParam, _In_ LPARAM LParam);
 
+// Moves Mouse, in the capture window's client coordinates, onto the nearest window or panel edge within a few
+// pixels, unless Alt is held down.
+void SnapToCaptureEdges(_Inout_ POINT* Mouse);
+
 void CaptureWindow_OnLeftButtonUp(void);
 
 // Returns TRUE if we were successful in creating the capture window. FALSE if it fails.
 BOOL NewButton_Click(void);
 
+// Puts the main window back to its starting size and minimizes it, and throws away the last screenshot and snip.
+void PrepareForCapture(void);
+
+// Adds the drop shadow, starts the document and the session, and turns on the tools, once the snip has been captured.
+void FinishSnip(void);
+
 // Returns TRUE if the snip was saved. Returns FALSE if there was an error or if user cancelled.
 BOOL SaveButton_Click(void);
 
@@ -170,10 +288,25 @@ LSTATUS GetSnipExRegString(_In_ wchar_t* ValueName, _Out_writes_(BufferLength) w
 
 BOOL AutoSaveSnip(void);
 
+// Sets gDisplayWidth, gDisplayHeight, gDisplayLeft and gDisplayTop to the desktop of gCaptureSource.
+void SetDisplayArea(void);
+
+// Catches gCaptureSource and the gDisplay globals up with monitors that have been plugged in, unplugged, moved or
+// resized, and trims gLastCaptureRegion to what is still on the desktop.
+void RefreshDisplayLayout(void);
+
 // Captures the full screen without user selection. If AllMonitors is TRUE, captures the
 // entire virtual desktop. If FALSE, captures only the monitor containing the SnipEx window.
 BOOL FullScreenSnip(_In_ BOOL AllMonitors);
 
+// Snips Region, in screen coordinates, straight from the screen into the snip, without copying the rest of the
+// desktop or showing the capture overlay. If none of Region is on the desktop, starts a normal snip instead.
+// Returns FALSE if it fails.
+BOOL RegionSnip(_In_ const RECT* Region);
+
+// Snips the same region of the screen as the last snip. Starts a normal snip if there hasn't been one yet.
+BOOL RepeatLastRegion(void);
+
 LSTATUS DeleteSnipExRegValue(_In_ wchar_t* ValueName);
 
 // If the user has a custom DPI or scaling level set, the title bar and borders
@@ -181,4 +314,101 @@ LSTATUS DeleteSnipExRegValue(_In_ wchar_t* ValueName);
 // so to compensate we need to make our window size larger as DPI goes up.
 void AdjustWindowSizeForThickTitleBars(void);
 
+// Creates a blank top-down 32bpp DIB section whose pixels can be written to directly.
+HBITMAP CreateDibSection32(_In_ INT32 Width, _In_ INT32 Height, _Out_ UINT32** Bits);
+
+// Blends a drop shadow into the bottom and right 8 pixels of the snip.
+void AddDropShadow(_Inout_ UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height);
+
+UINT32 GetHilightColor(_In_ UINT8 Color);
+
+UINT32 ColorToPixel(_In_ COLORREF Color);
+
+COLORREF PixelToColor(_In_ UINT32 Pixel);
+
+BOOL CreateRedactSource(void);
+
+COLORREF GetToolColor(_In_ UINT8 Color);
+
+// Gets how wide the hilighter or redact brush is when it's BrushHeight pixels tall, for the tip in gBrushTip.
+INT32 GetBrushWidth(_In_ INT32 BrushHeight);
+
+// Gets the text of the window menu item that picks the brush tip.
+wchar_t* GetBrushTipMenuText(_In_ DWORD BrushTip);
+
+// Fills in the box, arrow, spotlight or callout annotation that Shape becomes once the mouse button comes up.
+void ShapeToAnnotation(_In_ const SHAPE* Shape, _Out_ struct ANNOTATION* Annotation);
+
+// Paints a box, an arrow, a spotlight or a callout over the snip on the screen, without drawing it into the snip. It's drawn by the
+// same code that will draw it into the snip, so it looks exactly the same once the mouse button comes up. A spotlight
+// only paints the dimmed strips around its rectangle that are inside DC's clipping region. A callout's copy is
+// magnified with nearest-neighbour until then, and with the Lanczos filter once it goes into the snip.
+void PaintShapePreview(_In_ HDC DC, _In_ const SHAPE* Shape);
+
+// Gets the rectangle that the shape will touch, so that only that much has to be repainted.
+void GetShapeBounds(_In_ const SHAPE* Shape, _Out_ RECT* Bounds);
+
+// Gets the part of the snip, in snip coordinates, that a spotlight dims. Empty if Shape isn't a spotlight.
+// The caller deletes the region. Returns NULL if it could not be created.
+HRGN GetSpotlightRegion(_In_ const SHAPE* Shape);
+
+// Finds the other places in gRedactSearchPixels that look like gRedactSearchBounds, and posts
+// WM_REDACT_MATCHES_FOUND to the main window once they're in gRedactSearchMatches.
+DWORD WINAPI RedactSearchThreadProc(_In_ LPVOID Parameter);
+
+// Starts looking for the other places in the snip that looked just like the redact stroke's bounds did before it
+// was redacted, on gRedactSearchThread. Takes gRedactOriginal and gRedactSource. Any earlier search is stopped first.
+BOOL StartRedactSearch(_In_ const struct ANNOTATION* Stroke);
+
+// Once gRedactSearchThread has finished, offers to redact what it found the same way as the stroke, if the stroke
+// is still the last change to the snip. Then stops the search.
+void RedactEveryOccurrence(void);
+
+// Waits for gRedactSearchThread, if there is one, and frees everything it was given and found.
+void StopRedactSearch(void);
+
+// Fills the area of similar color around Point, in snip coordinates, with the pen's color, or redacts it if the
+// redact tool is selected, as one change.
+void FillRegionAt(_In_ POINT Point);
+
+// Draws the text of gDocument into gSnipBitmap with GDI.
+void RenderAnnotation(_In_ const struct ANNOTATION* Annotation, _In_ const RECT* Clip, _In_opt_ void* Context);
+
+// Takes the most recent change off of the snip. Returns FALSE if there was nothing to undo.
+BOOL UndoChange(void);
+
+// Puts the most recently undone change back on the snip. Returns FALSE if there was nothing to redo.
+BOOL RedoChange(void);
+
+// Moves a rectangle on the snip to where that part of the snip is painted in the main window's client area.
+void SnipToClientRect(_Inout_ RECT* Rect);
+
+// Makes the main window big enough to show a gCaptureWidth x gCaptureHeight snip under the buttons.
+void FitMainWindowToSnip(void);
+
+// Finds the lines of text in gTextLinePixels and puts them in gTextLines.
+DWORD WINAPI TextLineThreadProc(_In_ LPVOID Parameter);
+
+// Starts finding the lines of text in the snip on gTextLineThread. Any earlier detection is stopped first.
+BOOL StartTextLineDetection(void);
+
+// Returns the lines of text found by StartTextLineDetection, or NULL if it has not finished yet.
+const struct TEXTLINES* GetDetectedTextLines(void);
+
+// Waits for gTextLineThread, if there is one, and frees the lines of text it found.
+void StopTextLineDetection(void);
+
+// Starts looking for lines of text in the new snip, enables the buttons, and puts the snip's size in the title bar.
+void EnableSnipEditing(void);
+
+// Gets the full path of the session file, creating the folder it goes in if it needs to be. Returns FALSE if it can't.
+BOOL GetSessionPath(_Out_writes_(PathLength) wchar_t* Path, _In_ DWORD PathLength);
+
+// Starts writing the snip in gDocument and every change to it to the session file, unless the user turned that off.
+void StartSession(void);
+
+// If SnipEx didn't close cleanly last time and left a session file behind, offers to put that snip back the way it
+// was, and does. Returns TRUE if it did.
+BOOL RecoverSession(void);
+
 #pragma endregion
\ No newline at end of file
@@ -0,0 +1,584 @@
+// SnipExAnalysis.c
+// Author: Joseph Ryan Ries, 2017-2020
+// The background analysis of the screenshot. There's no queue to lock: every task is known up front, in one
+// array, and a worker takes the next one by incrementing NextTask. Each task is one band of rows of one result,
+// and only ever writes to those rows, so no two tasks touch the same memory, except for the histogram, whose bins
+// each band adds its own counts to with an interlocked add at the end. The worker that finishes a result's last
+// band publishes it with an interlocked write to its Ready flag, which also makes sure that everything the bands
+// wrote is seen by whoever sees the flag.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <stdlib.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExBlend.h"
+
+#include "SnipExSnap.h"
+
+#include "SnipExAnalysis.h"
+
+
+static void DimBand(_Inout_ ANALYSIS* Analysis, _In_ INT32 Top, _In_ INT32 Bottom)
+{
+    SIZE_T First = (SIZE_T)Top * Analysis->Width;
+
+    RECT Band = { 0, Top, Analysis->Width, Bottom };
+
+    CopyMemory(&Analysis->Dimmed[First], &Analysis->Pixels[First], (SIZE_T)(Bottom - Top) * Analysis->Width * sizeof(UINT32));
+
+    BlendRect(Analysis->Dimmed, Analysis->Width, &Band, Analysis->DimColor, Analysis->DimAlpha, Analysis->DimMode);
+}
+
+
+static void EdgeBand(_Inout_ ANALYSIS* Analysis, _In_ INT32 Top, _In_ INT32 Bottom)
+{
+    INT32 Width = Analysis->Width;
+
+    // The brightness of the row above, this row and the row below, which are passed along as the band goes down.
+    UINT8* Rows = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * 3);
+
+    if (Rows == NULL)
+    {
+        ZeroMemory(&Analysis->Edges[(SIZE_T)Top * Width], (SIZE_T)(Bottom - Top) * Width);
+
+        return;
+    }
+
+    UINT8* Above = Rows;
+
+    UINT8* Middle = Rows + Width;
+
+    UINT8* Below = Rows + 2 * (SIZE_T)Width;
+
+    GetBrightnessRow(Analysis->Pixels, Width, Analysis->Height, Top - 1, Above);
+
+    GetBrightnessRow(Analysis->Pixels, Width, Analysis->Height, Top, Middle);
+
+    for (INT32 Y = Top; Y < Bottom; Y++)
+    {
+        GetBrightnessRow(Analysis->Pixels, Width, Analysis->Height, Y + 1, Below);
+
+        GetEdgeRow(Above, Middle, Below, Width, &Analysis->Edges[(SIZE_T)Y * Width]);
+
+        UINT8* Spare = Above;
+
+        Above = Middle;
+
+        Middle = Below;
+
+        Below = Spare;
+    }
+
+    HeapFree(GetProcessHeap(), 0, Rows);
+}
+
+
+static __forceinline UINT8 SobelMagnitude(_In_ const UINT8* Above, _In_ const UINT8* Middle, _In_ const UINT8* Below, _In_ INT32 Left, _In_ INT32 X, _In_ INT32 Right)
+{
+    INT32 GradientX = (Above[Right] + 2 * Middle[Right] + Below[Right]) - (Above[Left] + 2 * Middle[Left] + Below[Left]);
+
+    INT32 GradientY = (Below[Left] + 2 * Below[X] + Below[Right]) - (Above[Left] + 2 * Above[X] + Above[Right]);
+
+    // Each gradient is at most 4 * 255 either way, so this is at most 255.
+    return (UINT8)((abs(GradientX) + abs(GradientY)) >> 3);
+}
+
+
+static void GradientBand(_Inout_ ANALYSIS* Analysis, _In_ INT32 Top, _In_ INT32 Bottom)
+{
+    INT32 Width = Analysis->Width;
+
+    UINT8* Rows = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * 3);
+
+    if (Rows == NULL)
+    {
+        ZeroMemory(&Analysis->Gradient[(SIZE_T)Top * Width], (SIZE_T)(Bottom - Top) * Width);
+
+        return;
+    }
+
+    UINT8* Above = Rows;
+
+    UINT8* Middle = Rows + Width;
+
+    UINT8* Below = Rows + 2 * (SIZE_T)Width;
+
+    GetBrightnessRow(Analysis->Pixels, Width, Analysis->Height, Top - 1, Above);
+
+    GetBrightnessRow(Analysis->Pixels, Width, Analysis->Height, Top, Middle);
+
+    for (INT32 Y = Top; Y < Bottom; Y++)
+    {
+        UINT8* Gradient = &Analysis->Gradient[(SIZE_T)Y * Width];
+
+        GetBrightnessRow(Analysis->Pixels, Width, Analysis->Height, Y + 1, Below);
+
+        // The first and last columns repeat themselves off of the sides, and the columns in between don't need
+        // to check, which lets the compiler vectorize them.
+        Gradient[0] = SobelMagnitude(Above, Middle, Below, 0, 0, min(1, Width - 1));
+
+        for (INT32 X = 1; X < Width - 1; X++)
+        {
+            Gradient[X] = SobelMagnitude(Above, Middle, Below, X - 1, X, X + 1);
+        }
+
+        if (Width > 1)
+        {
+            Gradient[Width - 1] = SobelMagnitude(Above, Middle, Below, Width - 2, Width - 1, Width - 1);
+        }
+
+        UINT8* Spare = Above;
+
+        Above = Middle;
+
+        Middle = Below;
+
+        Below = Spare;
+    }
+
+    HeapFree(GetProcessHeap(), 0, Rows);
+}
+
+
+static void HashBand(_Inout_ ANALYSIS* Analysis, _In_ INT32 Top, _In_ INT32 Bottom)
+{
+    for (INT32 Y = Top; Y < Bottom; Y++)
+    {
+        const UINT32* Row = &Analysis->Pixels[(SIZE_T)Y * Analysis->Width];
+
+        UINT64 Hash = 0xCBF29CE484222325ull;
+
+        for (INT32 X = 0; X < Analysis->Width; X++)
+        {
+            Hash = (Hash ^ Row[X]) * 0x100000001B3ull;
+        }
+
+        Analysis->RowHashes[Y] = Hash;
+    }
+}
+
+
+static void HistogramBand(_Inout_ ANALYSIS* Analysis, _In_ INT32 Top, _In_ INT32 Bottom)
+{
+    // Counted privately first, so that the shared bins are only touched once each per band.
+    LONG Counts[ANALYSIS_HISTOGRAM_BINS] = { 0 };
+
+    for (INT32 Y = Top; Y < Bottom; Y++)
+    {
+        const UINT32* Row = &Analysis->Pixels[(SIZE_T)Y * Analysis->Width];
+
+        for (INT32 X = 0; X < Analysis->Width; X++)
+        {
+            UINT32 Pixel = Row[X];
+
+            Counts[((Pixel >> 12) & 0xF00) | ((Pixel >> 8) & 0xF0) | ((Pixel >> 4) & 0xF)]++;
+        }
+    }
+
+    for (UINT32 Bin = 0; Bin < ANALYSIS_HISTOGRAM_BINS; Bin++)
+    {
+        if (Counts[Bin] != 0)
+        {
+            InterlockedExchangeAdd(&Analysis->Histogram[Bin], Counts[Bin]);
+        }
+    }
+}
+
+
+// Averages each 2 x 2 block of pixels, all four channels at once, two to a word, rounding to nearest.
+static __forceinline UINT32 AverageFour(_In_ UINT32 A, _In_ UINT32 B, _In_ UINT32 C, _In_ UINT32 D)
+{
+    UINT32 RedBlue = (A & 0x00FF00FF) + (B & 0x00FF00FF) + (C & 0x00FF00FF) + (D & 0x00FF00FF) + 0x00020002;
+
+    UINT32 AlphaGreen = ((A >> 8) & 0x00FF00FF) + ((B >> 8) & 0x00FF00FF) + ((C >> 8) & 0x00FF00FF) + ((D >> 8) & 0x00FF00FF) + 0x00020002;
+
+    return ((RedBlue >> 2) & 0x00FF00FF) | (((AlphaGreen >> 2) & 0x00FF00FF) << 8);
+}
+
+
+static void PyramidBand(_Inout_ ANALYSIS* Analysis, _In_ INT32 Top, _In_ INT32 Bottom)
+{
+    const UINT32* Source = Analysis->Pixels;
+
+    INT32 SourceWidth = Analysis->Width;
+
+    BOOL LastBand = (Bottom == Analysis->Height);
+
+    // Bands start on a multiple of 1 << ANALYSIS_PYRAMID_LEVELS rows, so each level's rows of this band come only
+    // from the level above's rows of this band. The last band also takes whatever is left over at the bottom.
+    for (UINT32 Level = 0; Level < Analysis->PyramidLevels; Level++)
+    {
+        ANALYSISLEVEL* Target = &Analysis->Pyramid[Level];
+
+        INT32 First = Top >> (Level + 1);
+
+        INT32 Last = LastBand ? Target->Height : min(Bottom >> (Level + 1), Target->Height);
+
+        for (INT32 Y = First; Y < Last; Y++)
+        {
+            const UINT32* Upper = &Source[(SIZE_T)(2 * Y) * SourceWidth];
+
+            const UINT32* Lower = Upper + SourceWidth;
+
+            UINT32* Row = &Target->Pixels[(SIZE_T)Y * Target->Width];
+
+            for (INT32 X = 0; X < Target->Width; X++)
+            {
+                Row[X] = AverageFour(Upper[2 * X], Upper[2 * X + 1], Lower[2 * X], Lower[2 * X + 1]);
+            }
+        }
+
+        Source = Target->Pixels;
+
+        SourceWidth = Target->Width;
+    }
+}
+
+
+static void RunTask(_Inout_ ANALYSIS* Analysis, _In_ LONG Index)
+{
+    const ANALYSISTASK* Task = &Analysis->Tasks[Index];
+
+    switch (Task->Result)
+    {
+        case ANALYSISRESULT_DIMMED:
+        {
+            DimBand(Analysis, Task->Top, Task->Bottom);
+
+            break;
+        }
+        case ANALYSISRESULT_EDGES:
+        {
+            EdgeBand(Analysis, Task->Top, Task->Bottom);
+
+            break;
+        }
+        case ANALYSISRESULT_GRADIENT:
+        {
+            GradientBand(Analysis, Task->Top, Task->Bottom);
+
+            break;
+        }
+        case ANALYSISRESULT_ROWHASHES:
+        {
+            HashBand(Analysis, Task->Top, Task->Bottom);
+
+            break;
+        }
+        case ANALYSISRESULT_HISTOGRAM:
+        {
+            HistogramBand(Analysis, Task->Top, Task->Bottom);
+
+            break;
+        }
+        default:
+        {
+            PyramidBand(Analysis, Task->Top, Task->Bottom);
+
+            break;
+        }
+    }
+
+    if (InterlockedDecrement(&Analysis->Remaining[Task->Result]) == 0)
+    {
+        // The lists of edges need every band's flags, so they're made by whoever finishes the last band. If that
+        // fails, the lists are left empty, which just means there's nothing to snap to.
+        if (Task->Result == ANALYSISRESULT_EDGES)
+        {
+            BuildSnapEdges(Analysis->Edges, Analysis->Width, Analysis->Height, &Analysis->Cancelled, &Analysis->SnapEdges);
+
+            HeapFree(GetProcessHeap(), 0, Analysis->Edges);
+
+            Analysis->Edges = NULL;
+        }
+
+        InterlockedExchange(&Analysis->Ready[Task->Result], TRUE);
+
+        SetEvent(Analysis->ReadyEvents[Task->Result]);
+    }
+}
+
+
+static DWORD WINAPI AnalysisThreadProc(_In_ LPVOID Parameter)
+{
+    ANALYSIS* Analysis = Parameter;
+
+    while (InterlockedCompareExchange(&Analysis->Cancelled, FALSE, FALSE) == FALSE)
+    {
+        LONG Index = InterlockedIncrement(&Analysis->NextTask) - 1;
+
+        if (Index >= Analysis->TaskCount)
+        {
+            break;
+        }
+
+        RunTask(Analysis, Index);
+    }
+
+    return 0;
+}
+
+
+static void FreeAnalysis(_Inout_ ANALYSIS* Analysis)
+{
+    if (Analysis->Tasks != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Analysis->Tasks);
+    }
+
+    if (Analysis->Edges != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Analysis->Edges);
+    }
+
+    FreeSnapEdges(&Analysis->SnapEdges);
+
+    if (Analysis->Gradient != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Analysis->Gradient);
+    }
+
+    if (Analysis->RowHashes != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Analysis->RowHashes);
+    }
+
+    // The levels are all in one block, which starts with level 0.
+    if (Analysis->Pyramid[0].Pixels != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Analysis->Pyramid[0].Pixels);
+    }
+
+    for (UINT32 Result = 0; Result < ANALYSISRESULT_COUNT; Result++)
+    {
+        if (Analysis->ReadyEvents[Result] != NULL)
+        {
+            CloseHandle(Analysis->ReadyEvents[Result]);
+        }
+    }
+
+    if (Analysis->CancelEvent != NULL)
+    {
+        CloseHandle(Analysis->CancelEvent);
+    }
+
+    ZeroMemory(Analysis, sizeof(ANALYSIS));
+}
+
+
+BOOL StartAnalysis(
+    _Out_ ANALYSIS* Analysis,
+    _In_reads_(Width * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _Out_writes_(Width * Height) UINT32* Dimmed,
+    _In_ UINT32 Color,
+    _In_ UINT8 Alpha,
+    _In_ BLENDMODE Mode)
+{
+    SYSTEM_INFO SystemInfo = { 0 };
+
+    SIZE_T PyramidSize = 0;
+
+    ZeroMemory(Analysis, sizeof(ANALYSIS));
+
+    if (Width <= 0 || Height <= 0)
+    {
+        return FALSE;
+    }
+
+    Analysis->Pixels = Pixels;
+
+    Analysis->Width = Width;
+
+    Analysis->Height = Height;
+
+    Analysis->Dimmed = Dimmed;
+
+    Analysis->DimColor = Color;
+
+    Analysis->DimAlpha = Alpha;
+
+    Analysis->DimMode = Mode;
+
+    for (INT32 LevelWidth = Width / 2, LevelHeight = Height / 2;
+        Analysis->PyramidLevels < ANALYSIS_PYRAMID_LEVELS && LevelWidth >= ANALYSIS_PYRAMID_MIN && LevelHeight >= ANALYSIS_PYRAMID_MIN;
+        LevelWidth /= 2, LevelHeight /= 2)
+    {
+        Analysis->Pyramid[Analysis->PyramidLevels].Width = LevelWidth;
+
+        Analysis->Pyramid[Analysis->PyramidLevels].Height = LevelHeight;
+
+        Analysis->PyramidLevels++;
+
+        PyramidSize += (SIZE_T)LevelWidth * LevelHeight;
+    }
+
+    LONG BandCount = (Height + ANALYSIS_BAND_ROWS - 1) / ANALYSIS_BAND_ROWS;
+
+    Analysis->Tasks = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)BandCount * ANALYSISRESULT_COUNT * sizeof(ANALYSISTASK));
+
+    Analysis->Edges = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * Height);
+
+    Analysis->Gradient = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * Height);
+
+    Analysis->RowHashes = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Height * sizeof(UINT64));
+
+    if (PyramidSize > 0)
+    {
+        Analysis->Pyramid[0].Pixels = HeapAlloc(GetProcessHeap(), 0, PyramidSize * sizeof(UINT32));
+    }
+
+    Analysis->CancelEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    if (Analysis->Tasks == NULL || Analysis->Edges == NULL || Analysis->Gradient == NULL || Analysis->RowHashes == NULL ||
+        (PyramidSize > 0 && Analysis->Pyramid[0].Pixels == NULL) || Analysis->CancelEvent == NULL)
+    {
+        FreeAnalysis(Analysis);
+
+        return FALSE;
+    }
+
+    for (UINT32 Level = 1; Level < Analysis->PyramidLevels; Level++)
+    {
+        ANALYSISLEVEL* Above = &Analysis->Pyramid[Level - 1];
+
+        Analysis->Pyramid[Level].Pixels = Above->Pixels + (SIZE_T)Above->Width * Above->Height;
+    }
+
+    for (UINT32 Result = 0; Result < ANALYSISRESULT_COUNT; Result++)
+    {
+        Analysis->ReadyEvents[Result] = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+        if (Analysis->ReadyEvents[Result] == NULL)
+        {
+            FreeAnalysis(Analysis);
+
+            return FALSE;
+        }
+
+        for (LONG Band = 0; Band < BandCount; Band++)
+        {
+            ANALYSISTASK* Task = &Analysis->Tasks[Analysis->TaskCount++];
+
+            Task->Result = (ANALYSISRESULT)Result;
+
+            Task->Top = Band * ANALYSIS_BAND_ROWS;
+
+            Task->Bottom = min(Task->Top + ANALYSIS_BAND_ROWS, Height);
+        }
+
+        Analysis->Remaining[Result] = BandCount;
+    }
+
+    GetSystemInfo(&SystemInfo);
+
+    DWORD ThreadCount = min(max(SystemInfo.dwNumberOfProcessors, 2) - 1, ANALYSIS_MAX_THREADS);
+
+    for (DWORD Index = 0; Index < ThreadCount; Index++)
+    {
+        HANDLE Thread = CreateThread(NULL, 0, AnalysisThreadProc, Analysis, 0, NULL);
+
+        if (Thread != NULL)
+        {
+            Analysis->Threads[Analysis->ThreadCount++] = Thread;
+        }
+    }
+
+    if (Analysis->ThreadCount == 0)
+    {
+        FreeAnalysis(Analysis);
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+BOOL IsAnalysisReady(_In_ ANALYSIS* Analysis, _In_ ANALYSISRESULT Result)
+{
+    return (InterlockedCompareExchange(&Analysis->Ready[Result], TRUE, TRUE) == TRUE);
+}
+
+
+BOOL WaitForAnalysis(_Inout_ ANALYSIS* Analysis, _In_ ANALYSISRESULT Result)
+{
+    if (Analysis->Tasks == NULL)
+    {
+        return FALSE;
+    }
+
+    HANDLE Events[2] = { Analysis->ReadyEvents[Result], Analysis->CancelEvent };
+
+    while (IsAnalysisReady(Analysis, Result) == FALSE)
+    {
+        if (InterlockedCompareExchange(&Analysis->Cancelled, FALSE, FALSE))
+        {
+            return FALSE;
+        }
+
+        // Only the next task can be taken, and only if it's one of Result's, so that the caller isn't held up
+        // doing some other result's work.
+        LONG Index = InterlockedCompareExchange(&Analysis->NextTask, 0, 0);
+
+        if (Index < Analysis->TaskCount && Analysis->Tasks[Index].Result == Result)
+        {
+            if (InterlockedCompareExchange(&Analysis->NextTask, Index + 1, Index) == Index)
+            {
+                RunTask(Analysis, Index);
+            }
+
+            continue;
+        }
+
+        // Otherwise the workers have the rest of it, so sleep until whoever finishes its last band, or cancels
+        // the analysis, sets one of the events.
+        WaitForMultipleObjects(_countof(Events), Events, FALSE, INFINITE);
+    }
+
+    return TRUE;
+}
+
+
+void CancelAnalysis(_Inout_ ANALYSIS* Analysis)
+{
+    InterlockedExchange(&Analysis->Cancelled, TRUE);
+
+    if (Analysis->CancelEvent != NULL)
+    {
+        SetEvent(Analysis->CancelEvent);
+    }
+}
+
+
+void StopAnalysis(_Inout_ ANALYSIS* Analysis)
+{
+    if (Analysis->Tasks == NULL)
+    {
+        return;
+    }
+
+    CancelAnalysis(Analysis);
+
+    WaitForMultipleObjects(Analysis->ThreadCount, Analysis->Threads, TRUE, INFINITE);
+
+    for (DWORD Index = 0; Index < Analysis->ThreadCount; Index++)
+    {
+        CloseHandle(Analysis->Threads[Index]);
+    }
+
+    FreeAnalysis(Analysis);
+}
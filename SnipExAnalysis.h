@@ -0,0 +1,168 @@
+// SnipExAnalysis.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Works things out about the screenshot in the background, while the user is still dragging out a selection and
+// the CPU has nothing else to do, so that whatever needs them later has them straight away: the dimmed copy that
+// the capture overlay shows, the long edges that the selection snaps to, how strong the edges are at each pixel, a
+// hash of each row, smaller copies of the screenshot, and how often each color turns up. Each result is split into
+// bands of rows that worker threads take one at a time, and is ready as soon as its last band is done. Needs
+// SnipExBlend.h and SnipExSnap.h to be included first.
+
+#pragma once
+
+// How many rows each band of work covers. A multiple of 1 << ANALYSIS_PYRAMID_LEVELS, so that every level of
+// the pyramid can be made from the rows of one band alone.
+#define ANALYSIS_BAND_ROWS       64
+
+#define ANALYSIS_MAX_THREADS     16
+
+// How many smaller copies of the screenshot are made, each half the width and height of the one before.
+#define ANALYSIS_PYRAMID_LEVELS  6
+
+// Levels smaller than this across or down aren't made.
+#define ANALYSIS_PYRAMID_MIN     16
+
+// The color histogram has a bin for each color with 4 bits of red, green and blue.
+#define ANALYSIS_HISTOGRAM_BINS  4096
+
+typedef enum ANALYSISRESULT
+{
+    // The screenshot with the overlay's gray blended over all of it.
+    ANALYSISRESULT_DIMMED,
+
+    // The SNAPEDGE_ flags of each pixel, and the lists of long edges that the capture selection snaps to, which
+    // are made from them. Next after the dimmed copy, since the user can start dragging as soon as the overlay is
+    // up. If there wasn't the memory to make the lists, they're ready, but there aren't any.
+    ANALYSISRESULT_EDGES,
+
+    // Sobel gradient magnitude of each pixel's brightness, from 0 for flat to 255 for the sharpest edges.
+    ANALYSISRESULT_GRADIENT,
+
+    // A 64-bit FNV-1a hash of each row's pixels, so that rows can be compared without looking at them.
+    ANALYSISRESULT_ROWHASHES,
+
+    // How many pixels there are of each color, to 4 bits a channel.
+    ANALYSISRESULT_HISTOGRAM,
+
+    // The smaller copies of the screenshot, each pixel the average of 4 pixels of the level above.
+    ANALYSISRESULT_PYRAMID,
+
+    ANALYSISRESULT_COUNT
+
+} ANALYSISRESULT;
+
+typedef struct ANALYSISLEVEL
+{
+    INT32   Width;
+
+    INT32   Height;
+
+    UINT32* Pixels;
+
+} ANALYSISLEVEL;
+
+typedef struct ANALYSISTASK
+{
+    ANALYSISRESULT Result;
+
+    // The rows of the screenshot the task covers. Right and bottom exclusive.
+    INT32          Top;
+
+    INT32          Bottom;
+
+} ANALYSISTASK;
+
+typedef struct ANALYSIS
+{
+    // The screenshot, which has to stay as it is until the analysis is stopped. Owned by the caller.
+    const UINT32*  Pixels;
+
+    INT32          Width;
+
+    INT32          Height;
+
+    // Where the dimmed copy goes, and how it's dimmed. Owned by the caller.
+    UINT32*        Dimmed;
+
+    UINT32         DimColor;
+
+    UINT8          DimAlpha;
+
+    BLENDMODE      DimMode;
+
+    // The SNAPEDGE_ flags of each pixel, Width x Height. Freed once SnapEdges has been made from them.
+    UINT8*         Edges;
+
+    SNAPEDGES      SnapEdges;
+
+    // Width x Height.
+    UINT8*         Gradient;
+
+    // One for each row.
+    UINT64*        RowHashes;
+
+    // Indexed by ((Red >> 4) << 8) | ((Green >> 4) << 4) | (Blue >> 4).
+    volatile LONG  Histogram[ANALYSIS_HISTOGRAM_BINS];
+
+    // Level 0 is half the size of the screenshot.
+    ANALYSISLEVEL  Pyramid[ANALYSIS_PYRAMID_LEVELS];
+
+    UINT32         PyramidLevels;
+
+    // Every band of every result, in the order they're done. The dimmed copy is first, since the overlay
+    // can't be shown without it.
+    ANALYSISTASK*  Tasks;
+
+    LONG           TaskCount;
+
+    // The next task to be taken. Taking one is just an increment, so the workers never wait for each other.
+    volatile LONG  NextTask;
+
+    // How many bands of each result aren't done yet. Whoever does the last one sets its Ready flag.
+    volatile LONG  Remaining[ANALYSISRESULT_COUNT];
+
+    volatile LONG  Ready[ANALYSISRESULT_COUNT];
+
+    // Manual-reset events, set along with each Ready flag, for WaitForAnalysis to sleep on.
+    HANDLE         ReadyEvents[ANALYSISRESULT_COUNT];
+
+    // Once set, no more tasks are taken.
+    volatile LONG  Cancelled;
+
+    // A manual-reset event that's set along with Cancelled, to wake WaitForAnalysis.
+    HANDLE         CancelEvent;
+
+    HANDLE         Threads[ANALYSIS_MAX_THREADS];
+
+    DWORD          ThreadCount;
+
+} ANALYSIS;
+
+
+// Starts analysing the Width x Height screenshot in Pixels on worker threads, one fewer than there are
+// processors, so that the UI thread keeps one to itself. The dimmed copy is made in Dimmed, by blending Color
+// over the screenshot with Alpha in Mode. Returns FALSE if memory could not be allocated or no thread could be
+// started, in which case nothing is running and nothing needs stopping.
+BOOL StartAnalysis(
+    _Out_ ANALYSIS* Analysis,
+    _In_reads_(Width * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _Out_writes_(Width * Height) UINT32* Dimmed,
+    _In_ UINT32 Color,
+    _In_ UINT8 Alpha,
+    _In_ BLENDMODE Mode);
+
+// Returns TRUE once Result is done and can be read. Never blocks.
+BOOL IsAnalysisReady(_In_ ANALYSIS* Analysis, _In_ ANALYSISRESULT Result);
+
+// Waits for Result to be done, helping with its bands on the calling thread while there are any left to take,
+// and otherwise sleeping until the workers finish it. Returns FALSE if the analysis was cancelled first, or was
+// never started.
+BOOL WaitForAnalysis(_Inout_ ANALYSIS* Analysis, _In_ ANALYSISRESULT Result);
+
+// Tells the workers to stop taking bands. Doesn't wait for them; the results that are ready stay ready.
+void CancelAnalysis(_Inout_ ANALYSIS* Analysis);
+
+// Cancels the analysis, waits for the workers to finish the bands they're on, and frees the results. Does
+// nothing if it was never started or is already stopped.
+void StopAnalysis(_Inout_ ANALYSIS* Analysis);
@@ -0,0 +1,945 @@
+// SnipExBlend.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Pixel kernels for the drawing tools. Each kernel has a scalar reference version, plus SSE2 and
+// AVX2 versions on x86/x64 and a NEON version on ARM64, all of which must give identical results.
+// Blending in linear light needs table lookups, so that mode only has a scalar and an AVX2 (gather) version.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <intrin.h>
+#include <math.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExBlend.h"
+
+
+typedef void (*HILIGHTSPANFUNCTION)(UINT32*, const UINT8*, UINT32, UINT32);
+
+static HILIGHTSPANFUNCTION gHilightSpanSrgbFunction;
+
+static HILIGHTSPANFUNCTION gHilightSpanLinearFunction;
+
+// These are UINT32 rather than UINT16 and UINT8 so that AVX2 can gather from them.
+static UINT32 gSrgbToLinear[256];
+
+static UINT32 gLinearToSrgb[LINEAR_MAX + 1];
+
+
+// Exact round(X / 255) for 0 <= X <= 65025, without a divide.
+static __forceinline UINT32 Div255(_In_ UINT32 X)
+{
+    X += 128;
+
+    return (X + (X >> 8)) >> 8;
+}
+
+
+// x / 3 for 0 <= x <= 765, without a divide. 43691 / 131072 is just over 1/3, and the error
+// never adds up to a whole number in that range. The SIMD kernels depend on this, because they
+// only have 16-bit multipliers.
+static __forceinline UINT32 Div3(_In_ UINT32 X)
+{
+    return (X * 43691) >> 17;
+}
+
+
+void InitializeBlendTables(void)
+{
+    for (UINT32 Index = 0; Index < _countof(gSrgbToLinear); Index++)
+    {
+        double Srgb = Index / 255.0;
+
+        double Linear = (Srgb <= 0.04045) ? Srgb / 12.92 : pow((Srgb + 0.055) / 1.055, 2.4);
+
+        gSrgbToLinear[Index] = (UINT32)(Linear * LINEAR_MAX + 0.5);
+    }
+
+    for (UINT32 Index = 0; Index < _countof(gLinearToSrgb); Index++)
+    {
+        double Linear = (double)Index / LINEAR_MAX;
+
+        double Srgb = (Linear <= 0.0031308) ? Linear * 12.92 : 1.055 * pow(Linear, 1.0 / 2.4) - 0.055;
+
+        gLinearToSrgb[Index] = (UINT32)(Srgb * 255.0 + 0.5);
+    }
+}
+
+
+UINT16 SrgbToLinear(_In_ UINT8 Srgb)
+{
+    return (UINT16)gSrgbToLinear[Srgb];
+}
+
+
+UINT8 LinearToSrgb(_In_ UINT16 Linear)
+{
+    return (UINT8)gLinearToSrgb[min(Linear, LINEAR_MAX)];
+}
+
+
+// Mixes two 12-bit linear values. Alpha256 is from 0 to 256. Shifting by 8 instead of dividing by 255
+// keeps the products small enough for 32-bit SIMD lanes.
+static __forceinline UINT32 MixLinear(_In_ UINT32 Color, _In_ UINT32 Pixel, _In_ UINT32 Alpha256)
+{
+    return (Color * Alpha256 + Pixel * (256 - Alpha256) + 128) >> 8;
+}
+
+
+static __forceinline UINT32 HilightPixel(_In_ UINT32 Pixel, _In_ UINT32 Color)
+{
+    UINT32 Alpha = Div3((Pixel & 0xFF) + ((Pixel >> 8) & 0xFF) + ((Pixel >> 16) & 0xFF));
+
+    UINT32 Result = 0;
+
+    // The same blend as GdiAlphaBlend with a fully opaque source and a constant alpha, applied to all four channels.
+    for (UINT32 Shift = 0; Shift < 32; Shift += 8)
+    {
+        Result |= Div255(((Color >> Shift) & 0xFF) * Alpha + ((Pixel >> Shift) & 0xFF) * (255 - Alpha)) << Shift;
+    }
+
+    return Result;
+}
+
+
+static __forceinline UINT32 HilightPixelLinear(_In_ UINT32 Pixel, _In_ UINT32 Color)
+{
+    // The alpha still comes from the sRGB brightness, so that the hilighter decides what is paper and what is text the same way in both modes.
+    UINT32 Alpha = Div3((Pixel & 0xFF) + ((Pixel >> 8) & 0xFF) + ((Pixel >> 16) & 0xFF));
+
+    UINT32 Alpha256 = Alpha + (Alpha >> 7);
+
+    UINT32 Result = Div255((Color >> 24) * Alpha + (Pixel >> 24) * (255 - Alpha)) << 24;
+
+    for (UINT32 Shift = 0; Shift < 24; Shift += 8)
+    {
+        Result |= gLinearToSrgb[MixLinear(gSrgbToLinear[(Color >> Shift) & 0xFF], gSrgbToLinear[(Pixel >> Shift) & 0xFF], Alpha256)] << Shift;
+    }
+
+    return Result;
+}
+
+
+static void HilightSpanSrgbScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        if (Mask[Index])
+        {
+            Pixels[Index] = HilightPixel(Pixels[Index], Color);
+        }
+    }
+}
+
+
+static void HilightSpanLinearScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        if (Mask[Index])
+        {
+            Pixels[Index] = HilightPixelLinear(Pixels[Index], Color);
+        }
+    }
+}
+
+
+void HilightSpanScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    if (Mode == BLENDMODE_LINEAR)
+    {
+        HilightSpanLinearScalar(Pixels, Mask, Count, Color);
+    }
+    else
+    {
+        HilightSpanSrgbScalar(Pixels, Mask, Count, Color);
+    }
+}
+
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+// Blends two pixels that have been widened to 16 bits per channel.
+static __forceinline __m128i HilightWideSse2(_In_ __m128i Wide, _In_ __m128i ColorWide)
+{
+    // Broadcast each pixel's B, G and R into all four of that pixel's lanes and add them up,
+    // so that every lane ends up holding the alpha for the pixel it belongs to.
+    __m128i Sum = _mm_add_epi16(
+        _mm_add_epi16(
+            _mm_shufflehi_epi16(_mm_shufflelo_epi16(Wide, _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(0, 0, 0, 0)),
+            _mm_shufflehi_epi16(_mm_shufflelo_epi16(Wide, _MM_SHUFFLE(1, 1, 1, 1)), _MM_SHUFFLE(1, 1, 1, 1))),
+        _mm_shufflehi_epi16(_mm_shufflelo_epi16(Wide, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 2, 2, 2)));
+
+    __m128i Alpha = _mm_srli_epi16(_mm_mulhi_epu16(Sum, _mm_set1_epi16((short)43691)), 1);
+
+    __m128i Blend = _mm_add_epi16(
+        _mm_mullo_epi16(ColorWide, Alpha),
+        _mm_mullo_epi16(Wide, _mm_sub_epi16(_mm_set1_epi16(255), Alpha)));
+
+    Blend = _mm_add_epi16(Blend, _mm_set1_epi16(128));
+
+    return _mm_srli_epi16(_mm_add_epi16(Blend, _mm_srli_epi16(Blend, 8)), 8);
+}
+
+
+static void HilightSpanSrgbSse2(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i ColorWide = _mm_unpacklo_epi8(_mm_set1_epi32((int)Color), Zero);
+
+    UINT32 Index = 0;
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        UINT32 MaskBytes = 0;
+
+        CopyMemory(&MaskBytes, &Mask[Index], sizeof(MaskBytes));
+
+        if (MaskBytes == 0)
+        {
+            continue;
+        }
+
+        __m128i Source = _mm_loadu_si128((const __m128i*)&Pixels[Index]);
+
+        __m128i Blended = _mm_packus_epi16(
+            HilightWideSse2(_mm_unpacklo_epi8(Source, Zero), ColorWide),
+            HilightWideSse2(_mm_unpackhi_epi8(Source, Zero), ColorWide));
+
+        // Spread each mask byte across the four bytes of its pixel. Keep is all ones where the mask is zero.
+        __m128i Keep = _mm_cvtsi32_si128((int)MaskBytes);
+
+        Keep = _mm_unpacklo_epi8(Keep, Keep);
+
+        Keep = _mm_cmpeq_epi8(_mm_unpacklo_epi16(Keep, Keep), Zero);
+
+        _mm_storeu_si128((__m128i*)&Pixels[Index], _mm_or_si128(_mm_and_si128(Keep, Source), _mm_andnot_si128(Keep, Blended)));
+    }
+
+    HilightSpanSrgbScalar(&Pixels[Index], &Mask[Index], Count - Index, Color);
+}
+
+
+static __forceinline __m256i HilightWideAvx2(_In_ __m256i Wide, _In_ __m256i ColorWide)
+{
+    __m256i Sum = _mm256_add_epi16(
+        _mm256_add_epi16(
+            _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(Wide, _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(0, 0, 0, 0)),
+            _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(Wide, _MM_SHUFFLE(1, 1, 1, 1)), _MM_SHUFFLE(1, 1, 1, 1))),
+        _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(Wide, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 2, 2, 2)));
+
+    __m256i Alpha = _mm256_srli_epi16(_mm256_mulhi_epu16(Sum, _mm256_set1_epi16((short)43691)), 1);
+
+    __m256i Blend = _mm256_add_epi16(
+        _mm256_mullo_epi16(ColorWide, Alpha),
+        _mm256_mullo_epi16(Wide, _mm256_sub_epi16(_mm256_set1_epi16(255), Alpha)));
+
+    Blend = _mm256_add_epi16(Blend, _mm256_set1_epi16(128));
+
+    return _mm256_srli_epi16(_mm256_add_epi16(Blend, _mm256_srli_epi16(Blend, 8)), 8);
+}
+
+
+static void HilightSpanSrgbAvx2(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+    __m256i Zero = _mm256_setzero_si256();
+
+    __m256i ColorWide = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)Color), Zero);
+
+    UINT32 Index = 0;
+
+    for (; Index + 8 <= Count; Index += 8)
+    {
+        UINT64 MaskBytes = 0;
+
+        CopyMemory(&MaskBytes, &Mask[Index], sizeof(MaskBytes));
+
+        if (MaskBytes == 0)
+        {
+            continue;
+        }
+
+        __m256i Source = _mm256_loadu_si256((const __m256i*)&Pixels[Index]);
+
+        // unpack and pack both work within 128-bit lanes, so the pixels come back out in the order they went in.
+        __m256i Blended = _mm256_packus_epi16(
+            HilightWideAvx2(_mm256_unpacklo_epi8(Source, Zero), ColorWide),
+            HilightWideAvx2(_mm256_unpackhi_epi8(Source, Zero), ColorWide));
+
+        __m256i Keep = _mm256_cmpeq_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&Mask[Index])), Zero);
+
+        _mm256_storeu_si256((__m256i*)&Pixels[Index], _mm256_blendv_epi8(Blended, Source, Keep));
+    }
+
+    HilightSpanSrgbScalar(&Pixels[Index], &Mask[Index], Count - Index, Color);
+}
+
+
+static void HilightSpanLinearAvx2(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+    __m256i Zero = _mm256_setzero_si256();
+
+    __m256i ByteMask = _mm256_set1_epi32(0xFF);
+
+    __m256i ColorLinear[3] = {
+        _mm256_set1_epi32((int)gSrgbToLinear[Color & 0xFF]),
+        _mm256_set1_epi32((int)gSrgbToLinear[(Color >> 8) & 0xFF]),
+        _mm256_set1_epi32((int)gSrgbToLinear[(Color >> 16) & 0xFF]) };
+
+    __m256i ColorAlpha = _mm256_set1_epi32((int)(Color >> 24));
+
+    UINT32 Index = 0;
+
+    for (; Index + 8 <= Count; Index += 8)
+    {
+        UINT64 MaskBytes = 0;
+
+        CopyMemory(&MaskBytes, &Mask[Index], sizeof(MaskBytes));
+
+        if (MaskBytes == 0)
+        {
+            continue;
+        }
+
+        __m256i Source = _mm256_loadu_si256((const __m256i*)&Pixels[Index]);
+
+        // One pixel per 32-bit lane, one register per channel.
+        __m256i Channels[3] = {
+            _mm256_and_si256(Source, ByteMask),
+            _mm256_and_si256(_mm256_srli_epi32(Source, 8), ByteMask),
+            _mm256_and_si256(_mm256_srli_epi32(Source, 16), ByteMask) };
+
+        __m256i Alpha = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_add_epi32(Channels[0], Channels[1]), Channels[2]), _mm256_set1_epi32(43691)), 17);
+
+        __m256i Alpha256 = _mm256_add_epi32(Alpha, _mm256_srli_epi32(Alpha, 7));
+
+        __m256i InverseAlpha256 = _mm256_sub_epi32(_mm256_set1_epi32(256), Alpha256);
+
+        // The alpha channel is blended the same way as in sRGB mode.
+        __m256i Blend = _mm256_add_epi32(
+            _mm256_add_epi32(_mm256_mullo_epi32(ColorAlpha, Alpha), _mm256_mullo_epi32(_mm256_srli_epi32(Source, 24), _mm256_sub_epi32(_mm256_set1_epi32(255), Alpha))),
+            _mm256_set1_epi32(128));
+
+        __m256i Result = _mm256_slli_epi32(_mm256_srli_epi32(_mm256_add_epi32(Blend, _mm256_srli_epi32(Blend, 8)), 8), 24);
+
+        for (int Channel = 0; Channel < 3; Channel++)
+        {
+            __m256i Linear = _mm256_i32gather_epi32((const int*)gSrgbToLinear, Channels[Channel], 4);
+
+            Linear = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(ColorLinear[Channel], Alpha256), _mm256_mullo_epi32(Linear, InverseAlpha256)), _mm256_set1_epi32(128));
+
+            Linear = _mm256_srli_epi32(Linear, 8);
+
+            Result = _mm256_or_si256(Result, _mm256_slli_epi32(_mm256_i32gather_epi32((const int*)gLinearToSrgb, Linear, 4), Channel * 8));
+        }
+
+        __m256i Keep = _mm256_cmpeq_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&Mask[Index])), Zero);
+
+        _mm256_storeu_si256((__m256i*)&Pixels[Index], _mm256_blendv_epi8(Result, Source, Keep));
+    }
+
+    HilightSpanLinearScalar(&Pixels[Index], &Mask[Index], Count - Index, Color);
+}
+
+
+static BOOL IsAvx2Supported(void)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuid(CpuInfo, 0);
+
+    if (CpuInfo[0] < 7)
+    {
+        return FALSE;
+    }
+
+    __cpuid(CpuInfo, 1);
+
+    // The CPU has to support AVX, and the OS has to save the YMM registers (OSXSAVE + XCR0 bits 1 and 2.)
+    if ((CpuInfo[2] & (1 << 27)) == 0 || (CpuInfo[2] & (1 << 28)) == 0)
+    {
+        return FALSE;
+    }
+
+    if ((_xgetbv(0) & 6) != 6)
+    {
+        return FALSE;
+    }
+
+    __cpuidex(CpuInfo, 7, 0);
+
+    return (CpuInfo[1] & (1 << 5)) != 0;
+}
+
+#elif defined(_M_ARM64)
+
+static void HilightSpanSrgbNeon(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+    uint8x8_t ColorChannels[4] = {
+        vdup_n_u8((uint8_t)(Color)),
+        vdup_n_u8((uint8_t)(Color >> 8)),
+        vdup_n_u8((uint8_t)(Color >> 16)),
+        vdup_n_u8((uint8_t)(Color >> 24)) };
+
+    UINT32 Index = 0;
+
+    for (; Index + 8 <= Count; Index += 8)
+    {
+        uint8x8_t MaskBytes = vld1_u8(&Mask[Index]);
+
+        if (vget_lane_u64(vreinterpret_u64_u8(MaskBytes), 0) == 0)
+        {
+            continue;
+        }
+
+        // De-interleave eight pixels into one register each of B, G, R and A.
+        uint8x8x4_t Source = vld4_u8((const uint8_t*)&Pixels[Index]);
+
+        uint16x8_t Sum = vaddw_u8(vaddl_u8(Source.val[0], Source.val[1]), Source.val[2]);
+
+        uint16x8_t Alpha16 = vcombine_u16(
+            vshrn_n_u32(vmull_n_u16(vget_low_u16(Sum), 43691), 16),
+            vshrn_n_u32(vmull_n_u16(vget_high_u16(Sum), 43691), 16));
+
+        uint8x8_t Alpha = vmovn_u16(vshrq_n_u16(Alpha16, 1));
+
+        uint8x8_t InverseAlpha = vsub_u8(vdup_n_u8(255), Alpha);
+
+        uint8x8_t Keep = vtst_u8(MaskBytes, MaskBytes);
+
+        uint8x8x4_t Result;
+
+        for (int Channel = 0; Channel < 4; Channel++)
+        {
+            uint16x8_t Blend = vmlal_u8(vmull_u8(ColorChannels[Channel], Alpha), Source.val[Channel], InverseAlpha);
+
+            Blend = vaddq_u16(Blend, vdupq_n_u16(128));
+
+            Result.val[Channel] = vbsl_u8(Keep, vaddhn_u16(Blend, vshrq_n_u16(Blend, 8)), Source.val[Channel]);
+        }
+
+        vst4_u8((uint8_t*)&Pixels[Index], Result);
+    }
+
+    HilightSpanSrgbScalar(&Pixels[Index], &Mask[Index], Count - Index, Color);
+}
+
+#endif
+
+
+static void SelectHilightSpanFunctions(void)
+{
+    gHilightSpanSrgbFunction = HilightSpanSrgbScalar;
+
+    gHilightSpanLinearFunction = HilightSpanLinearScalar;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    if (IsAvx2Supported())
+    {
+        gHilightSpanSrgbFunction = HilightSpanSrgbAvx2;
+
+        gHilightSpanLinearFunction = HilightSpanLinearAvx2;
+    }
+    else if (IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+    {
+        gHilightSpanSrgbFunction = HilightSpanSrgbSse2;
+    }
+#elif defined(_M_ARM64)
+    gHilightSpanSrgbFunction = HilightSpanSrgbNeon;
+#endif
+}
+
+
+void HilightSpan(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    if (gHilightSpanSrgbFunction == NULL)
+    {
+        SelectHilightSpanFunctions();
+    }
+
+    if (Mode == BLENDMODE_LINEAR)
+    {
+        gHilightSpanLinearFunction(Pixels, Mask, Count, Color);
+    }
+    else
+    {
+        gHilightSpanSrgbFunction(Pixels, Mask, Count, Color);
+    }
+}
+
+
+void BlendRectScalar(_Inout_ UINT32* Pixels, _In_ INT32 Stride, _In_ const RECT* Rect, _In_ UINT32 Color, _In_ UINT8 Alpha, _In_ BLENDMODE Mode)
+{
+    // With a constant color and alpha, each output channel depends only on the input channel, so
+    // work out all 256 answers for each channel once and then it's just a lookup per channel.
+    UINT32 Tables[4][256];
+
+    for (UINT32 Channel = 0; Channel < 4; Channel++)
+    {
+        UINT32 ColorChannel = (Color >> (Channel * 8)) & 0xFF;
+
+        for (UINT32 Value = 0; Value < 256; Value++)
+        {
+            if (Mode == BLENDMODE_LINEAR && Channel < 3)
+            {
+                Tables[Channel][Value] = gLinearToSrgb[MixLinear(gSrgbToLinear[ColorChannel], gSrgbToLinear[Value], Alpha + (Alpha >> 7u))] << (Channel * 8);
+            }
+            else
+            {
+                Tables[Channel][Value] = Div255(ColorChannel * Alpha + Value * (255u - Alpha)) << (Channel * 8);
+            }
+        }
+    }
+
+    for (INT32 Y = Rect->top; Y < Rect->bottom; Y++)
+    {
+        UINT32* Row = &Pixels[(SIZE_T)Y * Stride];
+
+        for (INT32 X = Rect->left; X < Rect->right; X++)
+        {
+            UINT32 Pixel = Row[X];
+
+            Row[X] = Tables[0][Pixel & 0xFF] | Tables[1][(Pixel >> 8) & 0xFF] | Tables[2][(Pixel >> 16) & 0xFF] | Tables[3][Pixel >> 24];
+        }
+    }
+}
+
+
+// The same blend as BlendRect, for a single pixel.
+static __forceinline UINT32 BlendPixel(_In_ UINT32 Pixel, _In_ UINT32 Color, _In_ UINT32 Alpha, _In_ BLENDMODE Mode)
+{
+    UINT32 Result = Div255((Color >> 24) * Alpha + (Pixel >> 24) * (255 - Alpha)) << 24;
+
+    for (UINT32 Shift = 0; Shift < 24; Shift += 8)
+    {
+        if (Mode == BLENDMODE_LINEAR)
+        {
+            Result |= gLinearToSrgb[MixLinear(gSrgbToLinear[(Color >> Shift) & 0xFF], gSrgbToLinear[(Pixel >> Shift) & 0xFF], Alpha + (Alpha >> 7))] << Shift;
+        }
+        else
+        {
+            Result |= Div255(((Color >> Shift) & 0xFF) * Alpha + ((Pixel >> Shift) & 0xFF) * (255 - Alpha)) << Shift;
+        }
+    }
+
+    return Result;
+}
+
+
+void BlendRect(_Inout_ UINT32* Pixels, _In_ INT32 Stride, _In_ const RECT* Rect, _In_ UINT32 Color, _In_ UINT8 Alpha, _In_ BLENDMODE Mode)
+{
+    // Linear blending needs its table lookups, which don't vectorize, so it's left to the tables.
+    if (Mode == BLENDMODE_LINEAR)
+    {
+        BlendRectScalar(Pixels, Stride, Rect, Color, Alpha, Mode);
+
+        return;
+    }
+
+    UINT32 Width = (Rect->right > Rect->left) ? (UINT32)(Rect->right - Rect->left) : 0;
+
+    // Color * Alpha and the rounding are the same for every pixel, so each channel is one multiply and one add.
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i ColorTerm = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32((int)Color), Zero), _mm_set1_epi16((short)Alpha)), _mm_set1_epi16(128));
+
+    __m128i InverseAlpha = _mm_set1_epi16((short)(255 - Alpha));
+#elif defined(_M_ARM64)
+    uint16x8_t ColorTerms[4] = {
+        vdupq_n_u16((uint16_t)((Color & 0xFF) * Alpha + 128)),
+        vdupq_n_u16((uint16_t)(((Color >> 8) & 0xFF) * Alpha + 128)),
+        vdupq_n_u16((uint16_t)(((Color >> 16) & 0xFF) * Alpha + 128)),
+        vdupq_n_u16((uint16_t)((Color >> 24) * Alpha + 128)) };
+
+    uint8x8_t InverseAlpha = vdup_n_u8((uint8_t)(255 - Alpha));
+#endif
+
+    for (INT32 Y = Rect->top; Y < Rect->bottom; Y++)
+    {
+        UINT32* Row = &Pixels[(SIZE_T)Y * Stride + Rect->left];
+
+        UINT32 Index = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+        for (; Index + 4 <= Width; Index += 4)
+        {
+            __m128i Source = _mm_loadu_si128((const __m128i*)&Row[Index]);
+
+            __m128i Wide[2] = { _mm_unpacklo_epi8(Source, Zero), _mm_unpackhi_epi8(Source, Zero) };
+
+            for (int Half = 0; Half < 2; Half++)
+            {
+                __m128i Blend = _mm_add_epi16(ColorTerm, _mm_mullo_epi16(Wide[Half], InverseAlpha));
+
+                Wide[Half] = _mm_srli_epi16(_mm_add_epi16(Blend, _mm_srli_epi16(Blend, 8)), 8);
+            }
+
+            _mm_storeu_si128((__m128i*)&Row[Index], _mm_packus_epi16(Wide[0], Wide[1]));
+        }
+#elif defined(_M_ARM64)
+        for (; Index + 8 <= Width; Index += 8)
+        {
+            uint8x8x4_t Source = vld4_u8((const uint8_t*)&Row[Index]);
+
+            for (int Channel = 0; Channel < 4; Channel++)
+            {
+                uint16x8_t Blend = vmlal_u8(ColorTerms[Channel], Source.val[Channel], InverseAlpha);
+
+                Source.val[Channel] = vaddhn_u16(Blend, vshrq_n_u16(Blend, 8));
+            }
+
+            vst4_u8((uint8_t*)&Row[Index], Source);
+        }
+#endif
+
+        for (; Index < Width; Index++)
+        {
+            Row[Index] = BlendPixel(Row[Index], Color, Alpha, Mode);
+        }
+    }
+}
+
+
+void BlendSpanScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        if (Alpha[Index] == 255)
+        {
+            Pixels[Index] = Color;
+        }
+        else if (Alpha[Index] != 0)
+        {
+            Pixels[Index] = BlendPixel(Pixels[Index], Color, Alpha[Index], Mode);
+        }
+    }
+}
+
+
+void BlendSpan(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    UINT32 Index = 0;
+
+    // Almost every pixel of a shape is either all the way in or all the way out, so those are handled four
+    // at a time, and only the edges are blended. Linear blending needs table lookups, so its edges are always
+    // done one pixel at a time.
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i ColorWide = _mm_set1_epi32((int)Color);
+
+    __m128i ColorChannels = _mm_unpacklo_epi8(ColorWide, Zero);
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        UINT32 AlphaBytes = 0;
+
+        CopyMemory(&AlphaBytes, &Alpha[Index], sizeof(AlphaBytes));
+
+        if (AlphaBytes == 0)
+        {
+            continue;
+        }
+
+        if (AlphaBytes == 0xFFFFFFFF)
+        {
+            _mm_storeu_si128((__m128i*)&Pixels[Index], ColorWide);
+
+            continue;
+        }
+
+        if (Mode == BLENDMODE_LINEAR)
+        {
+            BlendSpanScalar(&Pixels[Index], &Alpha[Index], 4, Color, Mode);
+
+            continue;
+        }
+
+        __m128i Source = _mm_loadu_si128((const __m128i*)&Pixels[Index]);
+
+        // Spread each alpha byte across the four channels of its pixel, then widen to 16 bits.
+        __m128i Alphas = _mm_cvtsi32_si128((int)AlphaBytes);
+
+        Alphas = _mm_unpacklo_epi8(Alphas, Alphas);
+
+        Alphas = _mm_unpacklo_epi16(Alphas, Alphas);
+
+        __m128i Wide[2] = { _mm_unpacklo_epi8(Source, Zero), _mm_unpackhi_epi8(Source, Zero) };
+
+        __m128i WideAlpha[2] = { _mm_unpacklo_epi8(Alphas, Zero), _mm_unpackhi_epi8(Alphas, Zero) };
+
+        for (int Half = 0; Half < 2; Half++)
+        {
+            __m128i Blend = _mm_add_epi16(
+                _mm_mullo_epi16(ColorChannels, WideAlpha[Half]),
+                _mm_mullo_epi16(Wide[Half], _mm_sub_epi16(_mm_set1_epi16(255), WideAlpha[Half])));
+
+            Blend = _mm_add_epi16(Blend, _mm_set1_epi16(128));
+
+            Wide[Half] = _mm_srli_epi16(_mm_add_epi16(Blend, _mm_srli_epi16(Blend, 8)), 8);
+        }
+
+        _mm_storeu_si128((__m128i*)&Pixels[Index], _mm_packus_epi16(Wide[0], Wide[1]));
+    }
+#elif defined(_M_ARM64)
+    uint32x4_t ColorWide = vdupq_n_u32(Color);
+
+    uint8x8_t ColorChannels[4] = {
+        vdup_n_u8((uint8_t)(Color)),
+        vdup_n_u8((uint8_t)(Color >> 8)),
+        vdup_n_u8((uint8_t)(Color >> 16)),
+        vdup_n_u8((uint8_t)(Color >> 24)) };
+
+    for (; Index + 8 <= Count; Index += 8)
+    {
+        uint8x8_t Alphas = vld1_u8(&Alpha[Index]);
+
+        UINT64 AlphaBytes = vget_lane_u64(vreinterpret_u64_u8(Alphas), 0);
+
+        if (AlphaBytes == 0)
+        {
+            continue;
+        }
+
+        if (AlphaBytes == 0xFFFFFFFFFFFFFFFFULL)
+        {
+            vst1q_u32(&Pixels[Index], ColorWide);
+
+            vst1q_u32(&Pixels[Index + 4], ColorWide);
+
+            continue;
+        }
+
+        if (Mode == BLENDMODE_LINEAR)
+        {
+            BlendSpanScalar(&Pixels[Index], &Alpha[Index], 8, Color, Mode);
+
+            continue;
+        }
+
+        uint8x8x4_t Source = vld4_u8((const uint8_t*)&Pixels[Index]);
+
+        uint8x8_t InverseAlphas = vsub_u8(vdup_n_u8(255), Alphas);
+
+        for (int Channel = 0; Channel < 4; Channel++)
+        {
+            uint16x8_t Blend = vmlal_u8(vmull_u8(ColorChannels[Channel], Alphas), Source.val[Channel], InverseAlphas);
+
+            Blend = vaddq_u16(Blend, vdupq_n_u16(128));
+
+            Source.val[Channel] = vaddhn_u16(Blend, vshrq_n_u16(Blend, 8));
+        }
+
+        vst4_u8((uint8_t*)&Pixels[Index], Source);
+    }
+#endif
+
+    BlendSpanScalar(&Pixels[Index], &Alpha[Index], Count - Index, Color, Mode);
+}
+
+
+void MixSpanScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT32* Source, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ BLENDMODE Mode)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        if (Alpha[Index] == 255)
+        {
+            Pixels[Index] = Source[Index];
+        }
+        else if (Alpha[Index] != 0)
+        {
+            Pixels[Index] = BlendPixel(Pixels[Index], Source[Index], Alpha[Index], Mode);
+        }
+    }
+}
+
+
+void MixSpan(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT32* Source, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ BLENDMODE Mode)
+{
+    UINT32 Index = 0;
+
+    // The same as BlendSpan, except that every pixel has its own color to blend toward.
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i Zero = _mm_setzero_si128();
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        UINT32 AlphaBytes = 0;
+
+        CopyMemory(&AlphaBytes, &Alpha[Index], sizeof(AlphaBytes));
+
+        if (AlphaBytes == 0)
+        {
+            continue;
+        }
+
+        __m128i Colors = _mm_loadu_si128((const __m128i*)&Source[Index]);
+
+        if (AlphaBytes == 0xFFFFFFFF)
+        {
+            _mm_storeu_si128((__m128i*)&Pixels[Index], Colors);
+
+            continue;
+        }
+
+        if (Mode == BLENDMODE_LINEAR)
+        {
+            MixSpanScalar(&Pixels[Index], &Source[Index], &Alpha[Index], 4, Mode);
+
+            continue;
+        }
+
+        __m128i Destination = _mm_loadu_si128((const __m128i*)&Pixels[Index]);
+
+        __m128i Alphas = _mm_cvtsi32_si128((int)AlphaBytes);
+
+        Alphas = _mm_unpacklo_epi8(Alphas, Alphas);
+
+        Alphas = _mm_unpacklo_epi16(Alphas, Alphas);
+
+        __m128i Wide[2] = { _mm_unpacklo_epi8(Destination, Zero), _mm_unpackhi_epi8(Destination, Zero) };
+
+        __m128i WideColors[2] = { _mm_unpacklo_epi8(Colors, Zero), _mm_unpackhi_epi8(Colors, Zero) };
+
+        __m128i WideAlpha[2] = { _mm_unpacklo_epi8(Alphas, Zero), _mm_unpackhi_epi8(Alphas, Zero) };
+
+        for (int Half = 0; Half < 2; Half++)
+        {
+            __m128i Blend = _mm_add_epi16(
+                _mm_mullo_epi16(WideColors[Half], WideAlpha[Half]),
+                _mm_mullo_epi16(Wide[Half], _mm_sub_epi16(_mm_set1_epi16(255), WideAlpha[Half])));
+
+            Blend = _mm_add_epi16(Blend, _mm_set1_epi16(128));
+
+            Wide[Half] = _mm_srli_epi16(_mm_add_epi16(Blend, _mm_srli_epi16(Blend, 8)), 8);
+        }
+
+        _mm_storeu_si128((__m128i*)&Pixels[Index], _mm_packus_epi16(Wide[0], Wide[1]));
+    }
+#elif defined(_M_ARM64)
+    for (; Index + 8 <= Count; Index += 8)
+    {
+        uint8x8_t Alphas = vld1_u8(&Alpha[Index]);
+
+        UINT64 AlphaBytes = vget_lane_u64(vreinterpret_u64_u8(Alphas), 0);
+
+        if (AlphaBytes == 0)
+        {
+            continue;
+        }
+
+        if (AlphaBytes == 0xFFFFFFFFFFFFFFFFULL)
+        {
+            vst1q_u32(&Pixels[Index], vld1q_u32(&Source[Index]));
+
+            vst1q_u32(&Pixels[Index + 4], vld1q_u32(&Source[Index + 4]));
+
+            continue;
+        }
+
+        if (Mode == BLENDMODE_LINEAR)
+        {
+            MixSpanScalar(&Pixels[Index], &Source[Index], &Alpha[Index], 8, Mode);
+
+            continue;
+        }
+
+        uint8x8x4_t Destination = vld4_u8((const uint8_t*)&Pixels[Index]);
+
+        uint8x8x4_t Colors = vld4_u8((const uint8_t*)&Source[Index]);
+
+        uint8x8_t InverseAlphas = vsub_u8(vdup_n_u8(255), Alphas);
+
+        for (int Channel = 0; Channel < 4; Channel++)
+        {
+            uint16x8_t Blend = vmlal_u8(vmull_u8(Colors.val[Channel], Alphas), Destination.val[Channel], InverseAlphas);
+
+            Blend = vaddq_u16(Blend, vdupq_n_u16(128));
+
+            Destination.val[Channel] = vaddhn_u16(Blend, vshrq_n_u16(Blend, 8));
+        }
+
+        vst4_u8((uint8_t*)&Pixels[Index], Destination);
+    }
+#endif
+
+    MixSpanScalar(&Pixels[Index], &Source[Index], &Alpha[Index], Count - Index, Mode);
+}
+
+
+void FillSpanScalar(_Out_writes_(Count) UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        Pixels[Index] = Color;
+    }
+}
+
+
+void FillSpan(_Out_writes_(Count) UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color)
+{
+#if defined(_M_X64)
+    if (Count >= FILL_STREAM_THRESHOLD)
+    {
+        // Streaming stores have to be 16-byte aligned. DIB bits are always 4-byte aligned, so at most
+        // 3 pixels need to be written normally first.
+        while (((UINT_PTR)Pixels & 15) != 0)
+        {
+            *Pixels++ = Color;
+
+            Count--;
+        }
+
+        __m128i ColorWide = _mm_set1_epi32((int)Color);
+
+        UINT32 Index = 0;
+
+        for (; Index + 4 <= Count; Index += 4)
+        {
+            _mm_stream_si128((__m128i*)&Pixels[Index], ColorWide);
+        }
+
+        // Streaming stores are weakly ordered, so make sure they are all visible before anyone else,
+        // such as GDI, looks at the pixels.
+        _mm_sfence();
+
+        FillSpanScalar(&Pixels[Index], Count - Index, Color);
+
+        return;
+    }
+
+    __stosd((unsigned long*)Pixels, Color, Count);
+#elif defined(_M_IX86)
+    __stosd((unsigned long*)Pixels, Color, Count);
+#elif defined(_M_ARM64)
+    uint32x4_t ColorWide = vdupq_n_u32(Color);
+
+    UINT32 Index = 0;
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        vst1q_u32(&Pixels[Index], ColorWide);
+    }
+
+    FillSpanScalar(&Pixels[Index], Count - Index, Color);
+#else
+    FillSpanScalar(Pixels, Count, Color);
+#endif
+}
@@ -0,0 +1,82 @@
+// SnipExBlend.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Pixel kernels that work directly on the 32bpp BGRA bits of a DIB section, so that drawing tools
+// do not have to make a GDI call for every pixel they touch.
+
+#pragma once
+
+// Hilighter colors, in the same BGRA byte order as the DIB bits. (0xAARRGGBB when read as a UINT32.)
+#define HILIGHT_YELLOW 0xFFFFFF00
+
+#define HILIGHT_PINK   0xFFFF00DC
+
+#define HILIGHT_ORANGE 0xFFFF6A00
+
+#define HILIGHT_GREEN  0xFF00FF00
+
+// Linear light values are stored with 12 bits, which is enough that converting an 8-bit sRGB value
+// to linear and back always gives the same value back.
+#define LINEAR_MAX     4095
+
+// Fills at least this many pixels long bypass the cache with streaming stores, since the pixels would only
+// push everything else out of the cache before anyone read them back.
+#define FILL_STREAM_THRESHOLD 65536
+
+typedef enum BLENDMODE
+{
+    // Blends the 8-bit sRGB values directly, the same way GdiAlphaBlend does. Mixing colors this
+    // way makes them come out darker and muddier than they really should.
+    BLENDMODE_SRGB,
+
+    // Converts to linear light, blends, and converts back to sRGB. This is how light actually mixes.
+    BLENDMODE_LINEAR
+
+} BLENDMODE;
+
+
+// Builds the sRGB <-> linear lookup tables. Call this once at startup, before any of the other functions.
+void InitializeBlendTables(void);
+
+// Converts between 8-bit sRGB and 12-bit linear light using the lookup tables.
+UINT16 SrgbToLinear(_In_ UINT8 Srgb);
+
+UINT8 LinearToSrgb(_In_ UINT16 Linear);
+
+// Applies the hilighter blend to Count pixels. Only pixels whose Mask byte is nonzero are changed.
+// Each of those pixels is blended with Color using the pixel's own brightness, (R+G+B)/3, as the
+// alpha. Bright pixels (the paper) take on the color, and dark pixels (the text) stay dark.
+// Picks the fastest kernel that the CPU supports. Every kernel gives bit-identical results.
+void HilightSpan(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// The portable reference implementation of HilightSpan.
+void HilightSpanScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Mask, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Blends Color over every pixel in Rect with a constant Alpha. Stride is the width of a row, in pixels.
+// The alpha channel is always blended as plain numbers; only the color channels are gamma corrected.
+// sRGB blends are done with SSE2 or NEON, several pixels at a time. This is what dims the screen around
+// the selection while capturing, and the snip around a spotlight.
+void BlendRect(_Inout_ UINT32* Pixels, _In_ INT32 Stride, _In_ const RECT* Rect, _In_ UINT32 Color, _In_ UINT8 Alpha, _In_ BLENDMODE Mode);
+
+// The portable reference implementation of BlendRect.
+void BlendRectScalar(_Inout_ UINT32* Pixels, _In_ INT32 Stride, _In_ const RECT* Rect, _In_ UINT32 Color, _In_ UINT8 Alpha, _In_ BLENDMODE Mode);
+
+// Blends Color over Count pixels, each with its own Alpha. Used for the soft edges of anti-aliased shapes,
+// so it skips pixels with an alpha of 0 and just stores Color where the alpha is 255.
+void BlendSpan(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// The portable reference implementation of BlendSpan.
+void BlendSpanScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Blends each of Count pixels toward the pixel in the same place in Source by its own Alpha. This is how a
+// pixelate or blur redact stroke with a soft-edged brush copies from its filtered copy of the snip.
+void MixSpan(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT32* Source, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ BLENDMODE Mode);
+
+// The portable reference implementation of MixSpan.
+void MixSpanScalar(_Inout_updates_(Count) UINT32* Pixels, _In_reads_(Count) const UINT32* Source, _In_reads_(Count) const UINT8* Alpha, _In_ UINT32 Count, _In_ BLENDMODE Mode);
+
+// Sets Count pixels to Color. This is a 32-bit memset: rep stosd on x86/x64, or streaming stores for
+// fills of FILL_STREAM_THRESHOLD pixels or more, and 128-bit stores on ARM64.
+void FillSpan(_Out_writes_(Count) UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color);
+
+// The portable reference implementation of FillSpan.
+void FillSpanScalar(_Out_writes_(Count) UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color);
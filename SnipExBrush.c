@@ -0,0 +1,384 @@
+// SnipExBrush.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Brush tip masks, and stamping them along a stroke. The masks are drawn once with the shape rasterizer, so a
+// round tip has exactly the same smooth edge as an ellipse drawn with the ellipse tool.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+static BRUSHMASK gBrushMasks[BRUSH_CACHE_SIZE];
+
+// Counts up every time a mask is asked for.
+static UINT32 gBrushClock;
+
+
+static void FreeBrushMask(_Inout_ BRUSHMASK* Mask)
+{
+    if (Mask->Memory != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Mask->Memory);
+    }
+
+    ZeroMemory(Mask, sizeof(BRUSHMASK));
+}
+
+
+// Works out how much of each pixel a Width x Height tip covers.
+static BOOL BuildBrushMask(_Out_ BRUSHMASK* Mask, _In_ BRUSHTIP Tip, _In_ INT32 Width, _In_ INT32 Height)
+{
+    ZeroMemory(Mask, sizeof(BRUSHMASK));
+
+    INT32 Stride = (Width + 15) & ~15;
+
+    SIZE_T AlphaSize = (SIZE_T)Stride * Height;
+
+    // One allocation for everything: 15 spare bytes to line Alpha up on, then Alpha, then the row extents.
+    Mask->Memory = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, 15 + AlphaSize + 2 * (SIZE_T)Height * sizeof(INT32));
+
+    if (Mask->Memory == NULL)
+    {
+        return FALSE;
+    }
+
+    Mask->Tip = Tip;
+
+    Mask->Width = Width;
+
+    Mask->Height = Height;
+
+    Mask->Stride = Stride;
+
+    Mask->Alpha = (UINT8*)(((UINT_PTR)Mask->Memory + 15) & ~(UINT_PTR)15);
+
+    Mask->RowLeft = (INT32*)(Mask->Alpha + AlphaSize);
+
+    Mask->RowRight = Mask->RowLeft + Height;
+
+    if (Tip == BRUSHTIP_SQUARE)
+    {
+        for (INT32 Row = 0; Row < Height; Row++)
+        {
+            FillMemory(&Mask->Alpha[(SIZE_T)Row * Stride], (SIZE_T)Width, 0xFF);
+        }
+    }
+    else
+    {
+        // Draw the tip in white on black, and the blue channel is then how much of each pixel it covers.
+        UINT32* Pixels = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)Width * Height * sizeof(UINT32));
+
+        if (Pixels == NULL)
+        {
+            FreeBrushMask(Mask);
+
+            return FALSE;
+        }
+
+        RASTERTARGET Target = { 0 };
+
+        Target.Pixels = Pixels;
+
+        Target.Stride = Width;
+
+        SetRect(&Target.Bounds, 0, 0, Width, Height);
+
+        if (Tip == BRUSHTIP_ROUND)
+        {
+            RASTERPOINT Center = { (float)Width / 2.0f, (float)Height / 2.0f };
+
+            DrawEllipse(&Target, Center, (float)Width / 2.0f, (float)Height / 2.0f, 0.0f, 0xFFFFFFFF, BLENDMODE_SRGB);
+        }
+        else
+        {
+            float Slant = (float)min(Width, Height / 2);
+
+            RASTERPOINT Corners[4] = {
+                { 0.0f, Slant },
+                { (float)Width, 0.0f },
+                { (float)Width, (float)Height - Slant },
+                { 0.0f, (float)Height } };
+
+            FillPolygon(&Target, Corners, _countof(Corners), 0xFFFFFFFF, BLENDMODE_SRGB);
+        }
+
+        for (INT32 Row = 0; Row < Height; Row++)
+        {
+            for (INT32 Column = 0; Column < Width; Column++)
+            {
+                Mask->Alpha[(SIZE_T)Row * Stride + Column] = (UINT8)(Pixels[(SIZE_T)Row * Width + Column] & 0xFF);
+            }
+        }
+
+        HeapFree(GetProcessHeap(), 0, Pixels);
+    }
+
+    for (INT32 Row = 0; Row < Height; Row++)
+    {
+        const UINT8* Alpha = &Mask->Alpha[(SIZE_T)Row * Stride];
+
+        INT32 Left = 0;
+
+        INT32 Right = Width;
+
+        while (Left < Right && Alpha[Left] == 0)
+        {
+            Left++;
+        }
+
+        while (Right > Left && Alpha[Right - 1] == 0)
+        {
+            Right--;
+        }
+
+        Mask->RowLeft[Row] = Left;
+
+        Mask->RowRight[Row] = Right;
+    }
+
+    return TRUE;
+}
+
+
+const BRUSHMASK* GetBrushMask(_In_ BRUSHTIP Tip, _In_ INT32 Width, _In_ INT32 Height)
+{
+    if (Width < 1 || Height < 1)
+    {
+        return NULL;
+    }
+
+    gBrushClock++;
+
+    BRUSHMASK* Oldest = &gBrushMasks[0];
+
+    for (UINT32 Index = 0; Index < _countof(gBrushMasks); Index++)
+    {
+        BRUSHMASK* Mask = &gBrushMasks[Index];
+
+        if (Mask->Memory != NULL && Mask->Tip == Tip && Mask->Width == Width && Mask->Height == Height)
+        {
+            Mask->LastUsed = gBrushClock;
+
+            return Mask;
+        }
+
+        // An empty slot counts as the oldest of all.
+        if (Oldest->Memory != NULL && (Mask->Memory == NULL || Mask->LastUsed < Oldest->LastUsed))
+        {
+            Oldest = Mask;
+        }
+    }
+
+    FreeBrushMask(Oldest);
+
+    if (BuildBrushMask(Oldest, Tip, Width, Height) == FALSE)
+    {
+        return NULL;
+    }
+
+    Oldest->LastUsed = gBrushClock;
+
+    return Oldest;
+}
+
+
+void FreeBrushMasks(void)
+{
+    for (UINT32 Index = 0; Index < _countof(gBrushMasks); Index++)
+    {
+        FreeBrushMask(&gBrushMasks[Index]);
+    }
+}
+
+
+void StampBrush(_In_ const BRUSHMASK* Mask, _In_ POINT Point, _In_ const RECT* Clip, _In_ BRUSHROWFUNCTION Row, _In_opt_ void* Context)
+{
+    INT32 FirstRow = max(0, Clip->top - Point.y);
+
+    INT32 LastRow = min(Mask->Height, Clip->bottom - Point.y);
+
+    for (INT32 MaskRow = FirstRow; MaskRow < LastRow; MaskRow++)
+    {
+        INT32 Left = max(Point.x + Mask->RowLeft[MaskRow], Clip->left);
+
+        INT32 Right = min(Point.x + Mask->RowRight[MaskRow], Clip->right);
+
+        if (Left >= Right)
+        {
+            continue;
+        }
+
+        Row(Point.y + MaskRow, Left, (UINT32)(Right - Left), &Mask->Alpha[(SIZE_T)MaskRow * Mask->Stride + (Left - Point.x)], Context);
+    }
+}
+
+
+void StampBrushSegment(_In_ const BRUSHMASK* Mask, _In_ POINT From, _In_ POINT To, _In_ const RECT* Clip, _In_ BRUSHROWFUNCTION Row, _In_opt_ void* Context)
+{
+    RECT Reach = {
+        min(From.x, To.x),
+        min(From.y, To.y),
+        max(From.x, To.x) + Mask->Width,
+        max(From.y, To.y) + Mask->Height };
+
+    RECT Overlap = { 0 };
+
+    if (IntersectRect(&Overlap, &Reach, Clip) == FALSE)
+    {
+        return;
+    }
+
+    INT32 DeltaX = To.x - From.x;
+
+    INT32 DeltaY = To.y - From.y;
+
+    INT32 Steps = max(abs(DeltaX), abs(DeltaY));
+
+    for (INT32 Step = 0; Step <= Steps; Step++)
+    {
+        POINT Point = From;
+
+        if (Steps > 0)
+        {
+            Point.x += MulDiv(DeltaX, Step, Steps);
+
+            Point.y += MulDiv(DeltaY, Step, Steps);
+        }
+
+        // Only the stamps near the clip rectangle are worth going through row by row.
+        if (Point.x >= Clip->right || Point.y >= Clip->bottom || Point.x + Mask->Width <= Clip->left || Point.y + Mask->Height <= Clip->top)
+        {
+            continue;
+        }
+
+        StampBrush(Mask, Point, Clip, Row, Context);
+    }
+}
+
+
+BOOL MergeBrushRowScalar(_Inout_updates_(Count) UINT8* Coverage, _In_reads_(Count) const UINT8* Alpha, _Out_writes_(Count) UINT8* Extra, _In_ UINT32 Count)
+{
+    BOOL Grew = FALSE;
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        UINT32 New = Alpha[Index];
+
+        UINT32 Old = Coverage[Index];
+
+        if (New <= Old)
+        {
+            Extra[Index] = 0;
+
+            continue;
+        }
+
+        Coverage[Index] = (UINT8)New;
+
+        Extra[Index] = (Old == 0) ? (UINT8)New : (UINT8)(((New - Old) * 255 + (255 - Old) / 2) / (255 - Old));
+
+        Grew = TRUE;
+    }
+
+    return Grew;
+}
+
+
+BOOL MergeBrushRow(_Inout_updates_(Count) UINT8* Coverage, _In_reads_(Count) const UINT8* Alpha, _Out_writes_(Count) UINT8* Extra, _In_ UINT32 Count)
+{
+    BOOL Grew = FALSE;
+
+    UINT32 Index = 0;
+
+    // Most of a stamp either lands on pixels that the stroke hasn't touched yet, where the extra is just the new
+    // coverage, or on pixels that are already covered at least as much, where it's 0. Those are done 16 at a time.
+    // Only a soft edge landing on another soft edge needs the division, and that's left to the scalar code.
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i Zero = _mm_setzero_si128();
+
+    for (; Index + 16 <= Count; Index += 16)
+    {
+        __m128i Old = _mm_loadu_si128((const __m128i*)&Coverage[Index]);
+
+        __m128i New = _mm_loadu_si128((const __m128i*)&Alpha[Index]);
+
+        __m128i Up = _mm_subs_epu8(New, Old);
+
+        __m128i Flat = _mm_cmpeq_epi8(Up, Zero);
+
+        if (_mm_movemask_epi8(Flat) == 0xFFFF)
+        {
+            _mm_storeu_si128((__m128i*)&Extra[Index], Zero);
+
+            continue;
+        }
+
+        if (_mm_movemask_epi8(_mm_or_si128(Flat, _mm_cmpeq_epi8(Old, Zero))) != 0xFFFF)
+        {
+            Grew |= MergeBrushRowScalar(&Coverage[Index], &Alpha[Index], &Extra[Index], 16);
+
+            continue;
+        }
+
+        _mm_storeu_si128((__m128i*)&Coverage[Index], _mm_max_epu8(Old, New));
+
+        _mm_storeu_si128((__m128i*)&Extra[Index], Up);
+
+        Grew = TRUE;
+    }
+#elif defined(_M_ARM64)
+    for (; Index + 16 <= Count; Index += 16)
+    {
+        uint8x16_t Old = vld1q_u8(&Coverage[Index]);
+
+        uint8x16_t New = vld1q_u8(&Alpha[Index]);
+
+        uint8x16_t Up = vqsubq_u8(New, Old);
+
+        if (vmaxvq_u8(Up) == 0)
+        {
+            vst1q_u8(&Extra[Index], vdupq_n_u8(0));
+
+            continue;
+        }
+
+        if (vmaxvq_u8(vandq_u8(vtstq_u8(Up, Up), vtstq_u8(Old, Old))) != 0)
+        {
+            Grew |= MergeBrushRowScalar(&Coverage[Index], &Alpha[Index], &Extra[Index], 16);
+
+            continue;
+        }
+
+        vst1q_u8(&Coverage[Index], vmaxq_u8(Old, New));
+
+        vst1q_u8(&Extra[Index], Up);
+
+        Grew = TRUE;
+    }
+#endif
+
+    Grew |= MergeBrushRowScalar(&Coverage[Index], &Alpha[Index], &Extra[Index], Count - Index);
+
+    return Grew;
+}
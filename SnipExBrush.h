@@ -0,0 +1,85 @@
+// SnipExBrush.h
+// Author: Joseph Ryan Ries, 2017-2020
+// The tips that the hilighter and redact tool draw with. The first time a tip is used at a size, how much of
+// each pixel it covers is worked out and kept in a mask, so that drawing with it only has to stamp the mask
+// along the stroke. The mask's rows are 16-byte aligned, so that stamping goes 16 pixels at a time.
+
+#pragma once
+
+// The smallest and largest brush, in pixels from top to bottom.
+#define BRUSH_MIN_SIZE    4
+
+#define BRUSH_MAX_SIZE    128
+
+// How many masks are kept. When a new tip or size is needed, the one that was used longest ago is dropped.
+#define BRUSH_CACHE_SIZE  8
+
+typedef enum BRUSHTIP
+{
+    // Covers its whole rectangle. This is what the hilighter and redact tool have always drawn with.
+    BRUSHTIP_SQUARE,
+
+    // The ellipse that fits in its rectangle, with smooth edges.
+    BRUSHTIP_ROUND,
+
+    // The flat nib of a marker held at 45 degrees: upright on the left and right, and sloping up to the right on
+    // the top and bottom, so a stroke has slanted ends.
+    BRUSHTIP_CHISEL
+
+} BRUSHTIP;
+
+typedef struct BRUSHMASK
+{
+    BRUSHTIP Tip;
+
+    INT32    Width;
+
+    INT32    Height;
+
+    // The distance from one row of Alpha to the next, in bytes. A multiple of 16.
+    INT32    Stride;
+
+    // How much of each pixel the tip covers, from 0 to 255. Starts on a 16-byte boundary.
+    UINT8*   Alpha;
+
+    // The first, and one past the last, pixel of each row that the tip covers at all.
+    INT32*   RowLeft;
+
+    INT32*   RowRight;
+
+    // What was allocated for Alpha, RowLeft and RowRight, before Alpha was lined up.
+    void*    Memory;
+
+    // When the mask was last asked for, so that the cache knows which one to drop.
+    UINT32   LastUsed;
+
+} BRUSHMASK;
+
+// Called for each row of a stamp, already clipped. Alpha is how much of pixels Left through Left + Count - 1 of
+// row Y the tip covers.
+typedef void (*BRUSHROWFUNCTION)(_In_ INT32 Y, _In_ INT32 Left, _In_ UINT32 Count, _In_reads_(Count) const UINT8* Alpha, _In_opt_ void* Context);
+
+
+// Gets the mask of a Width x Height tip, working it out the first time it's asked for. The mask stays valid until
+// BRUSH_CACHE_SIZE other masks have been asked for, or FreeBrushMasks is called. Only call this from the thread
+// that draws on the snip. Returns NULL if memory could not be allocated.
+const BRUSHMASK* GetBrushMask(_In_ BRUSHTIP Tip, _In_ INT32 Width, _In_ INT32 Height);
+
+// Frees every mask in the cache.
+void FreeBrushMasks(void);
+
+// Passes each row of Mask, with its top-left corner at Point and clipped to Clip, to Row, top to bottom.
+void StampBrush(_In_ const BRUSHMASK* Mask, _In_ POINT Point, _In_ const RECT* Clip, _In_ BRUSHROWFUNCTION Row, _In_opt_ void* Context);
+
+// Stamps Mask at From, at To, and at every whole pixel in between, so that a fast drag leaves no gaps. The stamps
+// overlap, so Row has to cope with being given the same pixel more than once; MergeBrushRow does that.
+void StampBrushSegment(_In_ const BRUSHMASK* Mask, _In_ POINT From, _In_ POINT To, _In_ const RECT* Clip, _In_ BRUSHROWFUNCTION Row, _In_opt_ void* Context);
+
+// Raises each Coverage byte to its Alpha byte, if that's higher, and works out in Extra how much more the pixel has
+// to be blended by to get there: blending by Extra over a pixel that already has Old of the color in it leaves
+// 1 - (1 - Old) * (1 - Extra), so Extra = (New - Old) / (1 - Old). Extra is 0 wherever the coverage didn't go up.
+// Returns FALSE if none of it went up, so there's nothing to blend. Goes 16 pixels at a time with SSE2 or NEON.
+BOOL MergeBrushRow(_Inout_updates_(Count) UINT8* Coverage, _In_reads_(Count) const UINT8* Alpha, _Out_writes_(Count) UINT8* Extra, _In_ UINT32 Count);
+
+// The portable reference implementation of MergeBrushRow.
+BOOL MergeBrushRowScalar(_Inout_updates_(Count) UINT8* Coverage, _In_reads_(Count) const UINT8* Alpha, _Out_writes_(Count) UINT8* Extra, _In_ UINT32 Count);
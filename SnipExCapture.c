@@ -0,0 +1,173 @@
+// SnipExCapture.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Region capture planning. The snip only ever holds the selection and its padding, so a one-monitor snip of
+// a three-monitor desktop touches a third of the pixels that a whole-desktop capture does, and a small region
+// touches next to none.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExCapture.h"
+
+
+BOOL PlanRegionCapture(_In_ const RECT* Selection, _In_ INT32 Padding, _In_ INT32 DesktopWidth, _In_ INT32 DesktopHeight, _Out_ CAPTUREPLAN* Plan)
+{
+    RECT Desktop = { 0, 0, DesktopWidth, DesktopHeight };
+
+    RECT Normalized = { min(Selection->left, Selection->right), min(Selection->top, Selection->bottom), max(Selection->left, Selection->right), max(Selection->top, Selection->bottom) };
+
+    ZeroMemory(Plan, sizeof(CAPTUREPLAN));
+
+    if (Padding < 0 || IntersectRect(&Plan->Selection, &Normalized, &Desktop) == FALSE)
+    {
+        return FALSE;
+    }
+
+    Plan->Width  = (Plan->Selection.right - Plan->Selection.left) + Padding;
+
+    Plan->Height = (Plan->Selection.bottom - Plan->Selection.top) + Padding;
+
+    Plan->Source.left   = Plan->Selection.left;
+
+    Plan->Source.top    = Plan->Selection.top;
+
+    Plan->Source.right  = min(Plan->Selection.right + Padding, DesktopWidth);
+
+    Plan->Source.bottom = min(Plan->Selection.bottom + Padding, DesktopHeight);
+
+    return TRUE;
+}
+
+
+void ClearUncapturedPixels(_In_ const CAPTUREPLAN* Plan, _Inout_updates_(Plan->Width * Plan->Height) UINT32* Pixels)
+{
+    INT32 SourceWidth = Plan->Source.right - Plan->Source.left;
+
+    INT32 SourceHeight = Plan->Source.bottom - Plan->Source.top;
+
+    if (SourceWidth < Plan->Width)
+    {
+        for (INT32 Y = 0; Y < SourceHeight; Y++)
+        {
+            ZeroMemory(&Pixels[(SIZE_T)Y * Plan->Width + SourceWidth], (SIZE_T)(Plan->Width - SourceWidth) * sizeof(UINT32));
+        }
+    }
+
+    if (SourceHeight < Plan->Height)
+    {
+        ZeroMemory(&Pixels[(SIZE_T)SourceHeight * Plan->Width], (SIZE_T)(Plan->Height - SourceHeight) * Plan->Width * sizeof(UINT32));
+    }
+}
+
+
+void CopyCaptureRegion(_In_ const CAPTUREPLAN* Plan, _In_ const UINT32* Desktop, _In_ INT32 DesktopStride, _Out_writes_(Plan->Width * Plan->Height) UINT32* Pixels)
+{
+    INT32 SourceWidth = Plan->Source.right - Plan->Source.left;
+
+    for (INT32 Y = Plan->Source.top; Y < Plan->Source.bottom; Y++)
+    {
+        CopyMemory(&Pixels[(SIZE_T)(Y - Plan->Source.top) * Plan->Width], &Desktop[(SIZE_T)Y * DesktopStride + Plan->Source.left], (SIZE_T)SourceWidth * sizeof(UINT32));
+    }
+
+    ClearUncapturedPixels(Plan, Pixels);
+}
+
+
+BOOL CaptureDesktop(_Inout_ CAPTURESOURCE* Source, _Out_ UINT32* Pixels)
+{
+    INT32 Width = Source->Layout.Desktop.right - Source->Layout.Desktop.left;
+
+    RECT Area = { 0, 0, Width, Source->Layout.Desktop.bottom - Source->Layout.Desktop.top };
+
+    return Source->Capture(Source, &Area, Pixels, Width);
+}
+
+
+BOOL CaptureRegion(_Inout_ CAPTURESOURCE* Source, _In_ const CAPTUREPLAN* Plan, _Out_writes_(Plan->Width * Plan->Height) UINT32* Pixels)
+{
+    if (Source->Capture(Source, &Plan->Source, Pixels, Plan->Width) == FALSE)
+    {
+        return FALSE;
+    }
+
+    ClearUncapturedPixels(Plan, Pixels);
+
+    return TRUE;
+}
+
+
+BOOL RefreshCaptureLayout(_Inout_ CAPTURESOURCE* Source)
+{
+    CAPTURELAYOUT OldLayout = Source->Layout;
+
+    if (Source->Refresh == NULL || Source->Refresh(Source) == FALSE)
+    {
+        return FALSE;
+    }
+
+    return memcmp(&OldLayout, &Source->Layout, sizeof(CAPTURELAYOUT)) != 0;
+}
+
+
+void CloseCaptureSource(_Inout_ CAPTURESOURCE* Source)
+{
+    if (Source->Close != NULL)
+    {
+        Source->Close(Source);
+    }
+
+    ZeroMemory(Source, sizeof(CAPTURESOURCE));
+}
+
+
+void FindCaptureMonitor(_In_ const CAPTURELAYOUT* Layout, _In_ const RECT* Window, _Out_ RECT* Monitor)
+{
+    INT64 BestArea = -1;
+
+    INT64 BestDistance = MAXINT64;
+
+    *Monitor = Layout->Desktop;
+
+    // The monitor with the most of the window on it wins. If the window isn't on any of them, the one whose
+    // middle is closest to the window's middle does.
+    for (UINT32 Index = 0; Index < Layout->MonitorCount; Index++)
+    {
+        const RECT* Candidate = &Layout->Monitors[Index];
+
+        RECT Overlap = { 0 };
+
+        INT64 Area = 0;
+
+        if (IntersectRect(&Overlap, Candidate, Window))
+        {
+            Area = (INT64)(Overlap.right - Overlap.left) * (Overlap.bottom - Overlap.top);
+        }
+
+        INT64 DistanceX = ((INT64)Candidate->left + Candidate->right) - ((INT64)Window->left + Window->right);
+
+        INT64 DistanceY = ((INT64)Candidate->top + Candidate->bottom) - ((INT64)Window->top + Window->bottom);
+
+        INT64 Distance = DistanceX * DistanceX + DistanceY * DistanceY;
+
+        if (Area > BestArea || (Area == BestArea && Distance < BestDistance))
+        {
+            BestArea = Area;
+
+            BestDistance = Distance;
+
+            *Monitor = *Candidate;
+        }
+    }
+}
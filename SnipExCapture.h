@@ -0,0 +1,101 @@
+// SnipExCapture.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Works out how to take a snip of just one part of the desktop, such as one monitor or the same region as last
+// time, straight into the snip's pixels, without copying the whole desktop or showing the capture overlay first.
+// Nothing in here talks to the screen, so it works the same whatever the pixels come from. Where they do come
+// from is a CAPTURESOURCE: the screen (SnipExScreen.c), or frames saved to disk (SnipExReplay.c) so that captures
+// can be repeated exactly, and on machines that don't have the monitors.
+
+#pragma once
+
+// The most monitors a capture source keeps track of. More than that still get captured, as part of the desktop,
+// they just can't be snipped on their own.
+#define CAPTURE_MAX_MONITORS 16
+
+typedef struct CAPTUREPLAN
+{
+    // The size of the snip: the part of the selection that is on the desktop, plus the padding.
+    INT32 Width;
+
+    INT32 Height;
+
+    // The selection, right side up, clipped to the desktop, in desktop coordinates. Right and bottom are exclusive.
+    RECT  Selection;
+
+    // The part of the desktop that goes in the top left of the snip: the selection, plus as much of the padding
+    // as is still on the desktop. Whatever part of the snip this doesn't cover is black.
+    RECT  Source;
+
+} CAPTUREPLAN;
+
+typedef struct CAPTURELAYOUT
+{
+    // The whole desktop in screen coordinates. Monitors to the left of or above the primary one make left and top
+    // negative.
+    RECT   Desktop;
+
+    // Each monitor in screen coordinates.
+    RECT   Monitors[CAPTURE_MAX_MONITORS];
+
+    UINT32 MonitorCount;
+
+} CAPTURELAYOUT;
+
+typedef struct CAPTURESOURCE CAPTURESOURCE;
+
+// Copies Area, which is in desktop coordinates and on the desktop, into Pixels as top-down 32bpp BGRA, Stride
+// pixels to a row. Returns FALSE if the pixels could not be had.
+typedef BOOL (*CAPTUREFUNCTION)(_Inout_ CAPTURESOURCE* Source, _In_ const RECT* Area, _Out_ UINT32* Pixels, _In_ INT32 Stride);
+
+typedef void (*CLOSECAPTUREFUNCTION)(_Inout_ CAPTURESOURCE* Source);
+
+// Sets Source->Layout to the way the desktop and monitors are laid out right now. Returns FALSE if it can't tell,
+// in which case the layout is left as it was.
+typedef BOOL (*REFRESHCAPTUREFUNCTION)(_Inout_ CAPTURESOURCE* Source);
+
+struct CAPTURESOURCE
+{
+    CAPTURELAYOUT        Layout;
+
+    CAPTUREFUNCTION      Capture;
+
+    CLOSECAPTUREFUNCTION Close;
+
+    // NULL for sources whose layout never changes, such as saved frames.
+    REFRESHCAPTUREFUNCTION Refresh;
+
+    // Whatever the source needs to keep between captures.
+    void*                Context;
+};
+
+
+// Plans a snip of Selection, which is in desktop coordinates and can be upside down or back to front, on a
+// DesktopWidth x DesktopHeight desktop. Padding more pixels are added to the right and bottom, the way the drop
+// shadow needs. Returns FALSE if none of the selection is on the desktop.
+BOOL PlanRegionCapture(_In_ const RECT* Selection, _In_ INT32 Padding, _In_ INT32 DesktopWidth, _In_ INT32 DesktopHeight, _Out_ CAPTUREPLAN* Plan);
+
+// Sets every pixel of the Plan->Width x Plan->Height snip in Pixels that Plan->Source doesn't cover to black.
+// Call this after copying the source in, unless the snip was already all 0.
+void ClearUncapturedPixels(_In_ const CAPTUREPLAN* Plan, _Inout_updates_(Plan->Width * Plan->Height) UINT32* Pixels);
+
+// Copies Plan->Source out of a whole desktop, DesktopStride pixels to a row, into the Plan->Width x Plan->Height
+// snip in Pixels, and clears the rest of it. For capture sources that hand back the whole desktop at once.
+void CopyCaptureRegion(_In_ const CAPTUREPLAN* Plan, _In_ const UINT32* Desktop, _In_ INT32 DesktopStride, _Out_writes_(Plan->Width * Plan->Height) UINT32* Pixels);
+
+// Captures the whole desktop of Source into Pixels, which has room for all of it, one desktop width to a row.
+BOOL CaptureDesktop(_Inout_ CAPTURESOURCE* Source, _Out_ UINT32* Pixels);
+
+// Captures the snip that Plan describes, a plan made for Source's desktop, into the Plan->Width x Plan->Height
+// Pixels. Whatever part of the snip isn't on the desktop is black.
+BOOL CaptureRegion(_Inout_ CAPTURESOURCE* Source, _In_ const CAPTUREPLAN* Plan, _Out_writes_(Plan->Width * Plan->Height) UINT32* Pixels);
+
+// Brings Source->Layout up to date, for when monitors have been added, removed, moved or resized since Source was
+// opened. Returns TRUE if the layout changed.
+BOOL RefreshCaptureLayout(_Inout_ CAPTURESOURCE* Source);
+
+// Frees whatever Source holds on to. Does nothing if it was never opened or is already closed.
+void CloseCaptureSource(_Inout_ CAPTURESOURCE* Source);
+
+// Gets the monitor of Layout that Window, in screen coordinates, is mostly on, or the monitor nearest to it if it
+// isn't on any. Gets the whole desktop if Layout has no monitors.
+void FindCaptureMonitor(_In_ const CAPTURELAYOUT* Layout, _In_ const RECT* Window, _Out_ RECT* Monitor);
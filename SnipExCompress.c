@@ -0,0 +1,287 @@
+// SnipExCompress.c
+// Author: Joseph Ryan Ries, 2017-2020
+// An LZ4 block format compressor and decompressor.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExCompress.h"
+
+// Matches are found by hashing the 4 bytes at each position into a table of the last position they were seen at.
+#define HASH_BITS      12
+
+#define MIN_MATCH      4
+
+#define MAX_OFFSET     65535
+
+// The format needs the last 5 bytes to be literals, and the last match to start at least 12 bytes from the end.
+#define LAST_LITERALS  5
+
+#define MATCH_LIMIT    12
+
+
+static UINT32 Read32(_In_ const UINT8* Bytes)
+{
+    UINT32 Value = 0;
+
+    CopyMemory(&Value, Bytes, sizeof(Value));
+
+    return Value;
+}
+
+
+static UINT32 Hash(_In_ UINT32 Value)
+{
+    return (Value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+
+// Writes what's left of a length that didn't fit in its 4 bits of the token: 255 for as long as it takes, then the
+// rest. Returns the next byte to write, or NULL if it didn't fit.
+static UINT8* WriteLength(_In_ UINT8* Out, _In_ const UINT8* End, _In_ SIZE_T Length)
+{
+    while (Length >= 255)
+    {
+        if (Out >= End)
+        {
+            return NULL;
+        }
+
+        *Out++ = 255;
+
+        Length -= 255;
+    }
+
+    if (Out >= End)
+    {
+        return NULL;
+    }
+
+    *Out++ = (UINT8)Length;
+
+    return Out;
+}
+
+
+// Writes Literals bytes from Anchor, and then, if MatchLength isn't 0, a copy of MatchLength bytes from Offset back.
+// Returns the next byte to write, or NULL if it didn't fit.
+static UINT8* WriteSequence(_In_ UINT8* Out, _In_ const UINT8* End, _In_ const UINT8* Anchor, _In_ SIZE_T Literals, _In_ SIZE_T Offset, _In_ SIZE_T MatchLength)
+{
+    if (Out >= End)
+    {
+        return NULL;
+    }
+
+    UINT8* Token = Out++;
+
+    SIZE_T MatchExtra = (MatchLength == 0) ? 0 : MatchLength - MIN_MATCH;
+
+    *Token = (UINT8)((min(Literals, 15) << 4) | min(MatchExtra, 15));
+
+    if (Literals >= 15 && (Out = WriteLength(Out, End, Literals - 15)) == NULL)
+    {
+        return NULL;
+    }
+
+    if ((SIZE_T)(End - Out) < Literals)
+    {
+        return NULL;
+    }
+
+    // An empty block can come with no Source at all.
+    if (Literals > 0)
+    {
+        CopyMemory(Out, Anchor, Literals);
+
+        Out += Literals;
+    }
+
+    if (MatchLength == 0)
+    {
+        return Out;
+    }
+
+    if (End - Out < 2)
+    {
+        return NULL;
+    }
+
+    *Out++ = (UINT8)(Offset & 0xFF);
+
+    *Out++ = (UINT8)(Offset >> 8);
+
+    if (MatchExtra >= 15 && (Out = WriteLength(Out, End, MatchExtra - 15)) == NULL)
+    {
+        return NULL;
+    }
+
+    return Out;
+}
+
+
+SIZE_T CompressBlock(_In_reads_(Size) const UINT8* Source, _In_ SIZE_T Size, _Out_writes_(Capacity) UINT8* Destination, _In_ SIZE_T Capacity)
+{
+    // Where the 4 bytes with each hash were last seen. Every match is checked, so what's left in here from
+    // before, or the 0s at the start, can only cost a wasted compare.
+    UINT32 Table[1 << HASH_BITS] = { 0 };
+
+    const UINT8* End = Destination + Capacity;
+
+    UINT8* Out = Destination;
+
+    SIZE_T Anchor = 0;
+
+    SIZE_T Position = 0;
+
+    if (Size > MATCH_LIMIT)
+    {
+        SIZE_T Limit = Size - MATCH_LIMIT;
+
+        while (Position < Limit)
+        {
+            UINT32 Value = Read32(&Source[Position]);
+
+            UINT32 Slot = Hash(Value);
+
+            SIZE_T Candidate = Table[Slot];
+
+            Table[Slot] = (UINT32)Position;
+
+            if (Candidate >= Position || Position - Candidate > MAX_OFFSET || Read32(&Source[Candidate]) != Value)
+            {
+                // The longer it's been since the last match, the less likely there is to be one, so skip ahead faster.
+                Position += 1 + ((Position - Anchor) >> 6);
+
+                continue;
+            }
+
+            SIZE_T Length = MIN_MATCH;
+
+            while (Position + Length < Size - LAST_LITERALS && Source[Candidate + Length] == Source[Position + Length])
+            {
+                Length++;
+            }
+
+            if ((Out = WriteSequence(Out, End, &Source[Anchor], Position - Anchor, Position - Candidate, Length)) == NULL)
+            {
+                return 0;
+            }
+
+            Position += Length;
+
+            Anchor = Position;
+        }
+    }
+
+    if ((Out = WriteSequence(Out, End, &Source[Anchor], Size - Anchor, 0, 0)) == NULL)
+    {
+        return 0;
+    }
+
+    return (SIZE_T)(Out - Destination);
+}
+
+
+BOOL DecompressBlock(_In_reads_(Size) const UINT8* Source, _In_ SIZE_T Size, _Out_writes_(Capacity) UINT8* Destination, _In_ SIZE_T Capacity)
+{
+    const UINT8* In = Source;
+
+    const UINT8* InEnd = Source + Size;
+
+    UINT8* Out = Destination;
+
+    UINT8* OutEnd = Destination + Capacity;
+
+    while (In < InEnd)
+    {
+        UINT8 Token = *In++;
+
+        SIZE_T Literals = Token >> 4;
+
+        if (Literals == 15)
+        {
+            UINT8 Byte = 255;
+
+            while (Byte == 255 && In < InEnd)
+            {
+                Byte = *In++;
+
+                Literals += Byte;
+            }
+        }
+
+        if ((SIZE_T)(InEnd - In) < Literals || (SIZE_T)(OutEnd - Out) < Literals)
+        {
+            return FALSE;
+        }
+
+        if (Literals > 0)
+        {
+            CopyMemory(Out, In, Literals);
+
+            In += Literals;
+
+            Out += Literals;
+        }
+
+        // The last sequence is only literals.
+        if (In == InEnd)
+        {
+            break;
+        }
+
+        if (InEnd - In < 2)
+        {
+            return FALSE;
+        }
+
+        SIZE_T Offset = (SIZE_T)In[0] | ((SIZE_T)In[1] << 8);
+
+        In += 2;
+
+        SIZE_T Length = (Token & 15);
+
+        if (Length == 15)
+        {
+            UINT8 Byte = 255;
+
+            while (Byte == 255 && In < InEnd)
+            {
+                Byte = *In++;
+
+                Length += Byte;
+            }
+        }
+
+        Length += MIN_MATCH;
+
+        if (Offset == 0 || Offset > (SIZE_T)(Out - Destination) || (SIZE_T)(OutEnd - Out) < Length)
+        {
+            return FALSE;
+        }
+
+        // The copy can overlap what it's writing, to repeat a short run, so it has to go a byte at a time.
+        const UINT8* From = Out - Offset;
+
+        for (SIZE_T Index = 0; Index < Length; Index++)
+        {
+            Out[Index] = From[Index];
+        }
+
+        Out += Length;
+    }
+
+    return Out == OutEnd;
+}
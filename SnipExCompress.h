@@ -0,0 +1,18 @@
+// SnipExCompress.h
+// Author: Joseph Ryan Ries, 2017-2020
+// A small, fast compressor for the undo journal, in the LZ4 block format: runs of literal bytes, each followed by
+// a copy of 4 or more bytes from up to 65535 bytes back. It doesn't squeeze as hard as deflate, but it goes through
+// a 64x64 tile in microseconds, and the tiles it's given are mostly runs of zeros, which it squeezes very well.
+
+#pragma once
+
+// The most that CompressBlock can grow Size bytes to.
+#define COMPRESS_BOUND(Size) ((Size) + (Size) / 255 + 16)
+
+// Compresses Size bytes of Source into Destination, which has room for Capacity bytes. Returns how many bytes
+// were written, or 0 if they didn't fit. Capacity of COMPRESS_BOUND(Size) is always enough.
+SIZE_T CompressBlock(_In_reads_(Size) const UINT8* Source, _In_ SIZE_T Size, _Out_writes_(Capacity) UINT8* Destination, _In_ SIZE_T Capacity);
+
+// Decompresses Size bytes of Source, written by CompressBlock, into exactly Capacity bytes of Destination. Returns
+// FALSE if Source is damaged, or doesn't decompress to exactly Capacity bytes.
+BOOL DecompressBlock(_In_reads_(Size) const UINT8* Source, _In_ SIZE_T Size, _Out_writes_(Capacity) UINT8* Destination, _In_ SIZE_T Capacity);
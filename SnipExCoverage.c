@@ -0,0 +1,150 @@
+// SnipExCoverage.c
+// Author: Joseph Ryan Ries, 2017-2020
+// One-bit-per-pixel coverage map used by the hilighter.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExCoverage.h"
+
+
+static SIZE_T GetCoverageSizeInBytes(_In_ const COVERAGE* Coverage)
+{
+    return (SIZE_T)Coverage->WordsPerRow * Coverage->Height * sizeof(UINT64);
+}
+
+
+void InitializeCoverage(_Out_ COVERAGE* Coverage, _In_ UINT32 Width, _In_ UINT32 Height)
+{
+    Coverage->Width = Width;
+
+    Coverage->Height = Height;
+
+    Coverage->WordsPerRow = (Width + 63) / 64;
+
+    Coverage->Bits = NULL;
+}
+
+
+void FreeCoverage(_Inout_ COVERAGE* Coverage)
+{
+    if (Coverage->Bits != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Coverage->Bits);
+
+        Coverage->Bits = NULL;
+    }
+}
+
+
+BOOL CopyCoverage(_Out_ COVERAGE* Destination, _In_ const COVERAGE* Source)
+{
+    InitializeCoverage(Destination, Source->Width, Source->Height);
+
+    if (Source->Bits == NULL)
+    {
+        return TRUE;
+    }
+
+    Destination->Bits = HeapAlloc(GetProcessHeap(), 0, GetCoverageSizeInBytes(Source));
+
+    if (Destination->Bits == NULL)
+    {
+        return FALSE;
+    }
+
+    CopyMemory(Destination->Bits, Source->Bits, GetCoverageSizeInBytes(Source));
+
+    return TRUE;
+}
+
+
+void ClearCoverage(_Inout_ COVERAGE* Coverage, _In_ const RECT* Rect)
+{
+    INT32 Left = max(Rect->left, 0);
+
+    INT32 Right = min(Rect->right, (INT32)Coverage->Width);
+
+    INT32 Top = max(Rect->top, 0);
+
+    INT32 Bottom = min(Rect->bottom, (INT32)Coverage->Height);
+
+    if (Coverage->Bits == NULL || Left >= Right || Top >= Bottom)
+    {
+        return;
+    }
+
+    UINT32 FirstWord = (UINT32)Left >> 6;
+
+    UINT32 LastWord = (UINT32)(Right - 1) >> 6;
+
+    // The bits to keep in the first and last words of each row.
+    UINT64 FirstKeep = (1ULL << (Left & 63)) - 1;
+
+    UINT64 LastKeep = ((Right & 63) == 0) ? 0 : ~((1ULL << (Right & 63)) - 1);
+
+    for (INT32 Y = Top; Y < Bottom; Y++)
+    {
+        UINT64* Row = &Coverage->Bits[(SIZE_T)Y * Coverage->WordsPerRow];
+
+        if (FirstWord == LastWord)
+        {
+            Row[FirstWord] &= (FirstKeep | LastKeep);
+
+            continue;
+        }
+
+        Row[FirstWord] &= FirstKeep;
+
+        for (UINT32 Word = FirstWord + 1; Word < LastWord; Word++)
+        {
+            Row[Word] = 0;
+        }
+
+        Row[LastWord] &= LastKeep;
+    }
+}
+
+
+BOOL CoverPixel(_Inout_ COVERAGE* Coverage, _In_ INT32 X, _In_ INT32 Y)
+{
+    if (X < 0 || Y < 0 || (UINT32)X >= Coverage->Width || (UINT32)Y >= Coverage->Height)
+    {
+        return FALSE;
+    }
+
+    if (Coverage->Bits == NULL)
+    {
+        Coverage->Bits = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, GetCoverageSizeInBytes(Coverage));
+
+        if (Coverage->Bits == NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    UINT64* Word = &Coverage->Bits[(SIZE_T)Y * Coverage->WordsPerRow + ((UINT32)X >> 6)];
+
+    UINT64 Bit = 1ULL << (X & 63);
+
+    if (*Word & Bit)
+    {
+        return FALSE;
+    }
+
+    *Word |= Bit;
+
+    return TRUE;
+}
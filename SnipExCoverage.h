@@ -0,0 +1,51 @@
+// SnipExCoverage.h
+// Author: Joseph Ryan Ries, 2017-2020
+// A packed one-bit-per-pixel coverage map the size of the current snip. The hilighter uses it to
+// remember which pixels it has already hilighted, so that going back over the same text does not
+// keep making it darker.
+
+#pragma once
+
+typedef struct COVERAGE
+{
+    UINT32  Width;
+
+    UINT32  Height;
+
+    // Every row starts on its own 64-bit word so that a row can be tested or set without
+    // worrying about bits that belong to the row above or below it.
+    UINT32  WordsPerRow;
+
+    // NULL until the first pixel is covered, so a snip that is never hilighted costs nothing.
+    UINT64* Bits;
+
+} COVERAGE;
+
+
+// Sets the dimensions of the coverage map. No memory is allocated until the first pixel is covered.
+void InitializeCoverage(_Out_ COVERAGE* Coverage, _In_ UINT32 Width, _In_ UINT32 Height);
+
+// Frees the bits and leaves the map empty but with its dimensions intact.
+void FreeCoverage(_Inout_ COVERAGE* Coverage);
+
+// Makes Destination an independent copy of Source. Destination must be empty or freed.
+// Returns FALSE if memory could not be allocated.
+BOOL CopyCoverage(_Out_ COVERAGE* Destination, _In_ const COVERAGE* Source);
+
+// Uncovers every pixel in Rect, so that the part of the snip under it can be hilighted again after it is redrawn.
+void ClearCoverage(_Inout_ COVERAGE* Coverage, _In_ const RECT* Rect);
+
+// Returns TRUE if the pixel at X,Y has been covered. Pixels outside of the map are never covered.
+static __forceinline BOOL IsPixelCovered(_In_ const COVERAGE* Coverage, _In_ INT32 X, _In_ INT32 Y)
+{
+    if (Coverage->Bits == NULL || X < 0 || Y < 0 || (UINT32)X >= Coverage->Width || (UINT32)Y >= Coverage->Height)
+    {
+        return FALSE;
+    }
+
+    return (BOOL)((Coverage->Bits[(SIZE_T)Y * Coverage->WordsPerRow + ((UINT32)X >> 6)] >> (X & 63)) & 1);
+}
+
+// Marks the pixel at X,Y as covered. Returns TRUE if it was not already covered, FALSE if it
+// was already covered, lies outside of the map, or memory for the map could not be allocated.
+BOOL CoverPixel(_Inout_ COVERAGE* Coverage, _In_ INT32 X, _In_ INT32 Y);
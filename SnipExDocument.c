@@ -0,0 +1,1974 @@
+// SnipExDocument.c
+// Author: Joseph Ryan Ries, 2017-2020
+// The list of annotations that make up an edited snip, and the flattened copy that gets painted and saved.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <math.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+// What StrokeStamp needs to draw one stroke.
+typedef struct STROKESTAMP
+{
+    DOCUMENT*         Document;
+
+    const ANNOTATION* Stroke;
+
+    RECT              Clip;
+
+    // Where a redact stroke copies pixel X, Y from: Pixels[(Y - OriginY) * Stride + X - OriginX]. NULL to black out.
+    const UINT32*     Pixels;
+
+    INT32             Stride;
+
+    INT32             OriginX;
+
+    INT32             OriginY;
+
+    // Grown to cover every pixel that was drawn on.
+    RECT              Damage;
+
+} STROKESTAMP;
+
+
+static void AddSpanToRect(_Inout_ RECT* Rect, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right)
+{
+    if (Rect->left >= Rect->right)
+    {
+        SetRect(Rect, Left, Y, Right, Y + 1);
+    }
+    else
+    {
+        Rect->left = min(Rect->left, Left);
+
+        Rect->right = max(Rect->right, Right);
+
+        Rect->top = min(Rect->top, Y);
+
+        Rect->bottom = max(Rect->bottom, Y + 1);
+    }
+}
+
+
+static void ClearStrokeCoverage(_Inout_ DOCUMENT* Document, _In_ const RECT* Area)
+{
+    for (INT32 Row = Area->top; Row < Area->bottom; Row++)
+    {
+        ZeroMemory(&Document->StrokeCoverage[(SIZE_T)Row * Document->Width + Area->left], (SIZE_T)(Area->right - Area->left));
+    }
+}
+
+
+// Draws one row of a stroke, from Left up to Right. If Alpha is NULL, the brush covers every pixel of the row all
+// the way, and no other call covers any of them, which is how a square brush is swept. Otherwise, Alpha is how
+// much of each pixel, starting at Left, one stamp of a brush mask covers, and stamps overlap.
+static void StrokeRow(_Inout_ STROKESTAMP* Stamp, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right, _In_opt_ const UINT8* Alpha)
+{
+    DOCUMENT* Document = Stamp->Document;
+
+    const ANNOTATION* Stroke = Stamp->Stroke;
+
+    if (Y < Stamp->Clip.top || Y >= Stamp->Clip.bottom)
+    {
+        return;
+    }
+
+    INT32 SpanLeft = max(Left, Stamp->Clip.left);
+
+    INT32 SpanRight = min(Right, Stamp->Clip.right);
+
+    if (SpanLeft >= SpanRight)
+    {
+        return;
+    }
+
+    UINT32* Row = &Document->Raster[(SIZE_T)Y * Document->Width];
+
+    // Where the eraser or a pixelate or blur redact stroke copies from: pixel X of the row is Source[X - SourceX].
+    const UINT32* Source = NULL;
+
+    INT32 SourceX = 0;
+
+    if (Stroke->Type == ANNOTATION_ERASE)
+    {
+        Source = &Document->Base[(SIZE_T)Y * Document->Width];
+    }
+    else if (Stroke->Type == ANNOTATION_REDACT && Stamp->Pixels != NULL)
+    {
+        Source = &Stamp->Pixels[(SIZE_T)(Y - Stamp->OriginY) * Stamp->Stride];
+
+        SourceX = Stamp->OriginX;
+    }
+
+    if (Alpha == NULL)
+    {
+        if (Stroke->Type == ANNOTATION_HILIGHT)
+        {
+            UINT8 Mask[256] = { 0 };
+
+            for (INT32 First = SpanLeft; First < SpanRight; First += _countof(Mask))
+            {
+                INT32 Last = min(First + (INT32)_countof(Mask), SpanRight);
+
+                for (INT32 XPixel = First; XPixel < Last; XPixel++)
+                {
+                    // CoverPixel returns FALSE if this pixel was already hilighted, earlier in this stroke or
+                    // in an earlier stroke, so the same pixel never gets darkened twice.
+                    Mask[XPixel - First] = (UINT8)CoverPixel(&Document->Coverage, XPixel, Y);
+                }
+
+                HilightSpan(&Row[First], Mask, (UINT32)(Last - First), Stroke->Color, Stroke->BlendMode);
+            }
+        }
+        else if (Source != NULL)
+        {
+            CopyMemory(&Row[SpanLeft], &Source[SpanLeft - SourceX], (SIZE_T)(SpanRight - SpanLeft) * sizeof(UINT32));
+        }
+        else
+        {
+            FillSpan(&Row[SpanLeft], (UINT32)(SpanRight - SpanLeft), 0xFF000000);
+        }
+    }
+    else
+    {
+        UINT8* Coverage = &Document->StrokeCoverage[(SIZE_T)Y * Document->Width];
+
+        UINT8 Extra[256] = { 0 };
+
+        BOOL Grew = FALSE;
+
+        for (INT32 First = SpanLeft; First < SpanRight; First += _countof(Extra))
+        {
+            INT32 Last = min(First + (INT32)_countof(Extra), SpanRight);
+
+            UINT32 Count = (UINT32)(Last - First);
+
+            // Only whatever coverage this stamp adds to what the stroke has already covered is drawn.
+            if (MergeBrushRow(&Coverage[First], &Alpha[First - Left], Extra, Count) == FALSE)
+            {
+                continue;
+            }
+
+            Grew = TRUE;
+
+            if (Stroke->Type == ANNOTATION_HILIGHT)
+            {
+                // The hilighter doesn't fade in. A pixel is hilighted, once, as soon as the brush covers at least half of it.
+                for (UINT32 Index = 0; Index < Count; Index++)
+                {
+                    Extra[Index] = (UINT8)(Extra[Index] != 0 && Coverage[First + (INT32)Index] >= 128 && CoverPixel(&Document->Coverage, First + (INT32)Index, Y));
+                }
+
+                HilightSpan(&Row[First], Extra, Count, Stroke->Color, Stroke->BlendMode);
+            }
+            else if (Source != NULL)
+            {
+                MixSpan(&Row[First], &Source[First - SourceX], Extra, Count, BLENDMODE_SRGB);
+            }
+            else
+            {
+                BlendSpan(&Row[First], Extra, Count, 0xFF000000, BLENDMODE_SRGB);
+            }
+        }
+
+        if (Grew == FALSE)
+        {
+            return;
+        }
+    }
+
+    if (Stroke->Type == ANNOTATION_ERASE)
+    {
+        // The pixels are no longer hilighted, so a hilight stroke that comes after this one should hilight them again.
+        RECT Erased = { SpanLeft, Y, SpanRight, Y + 1 };
+
+        ClearCoverage(&Document->Coverage, &Erased);
+    }
+
+    AddSpanToRect(&Stamp->Damage, Y, SpanLeft, SpanRight);
+}
+
+
+// StampStroke callback for a square brush. Context points to a STROKESTAMP.
+static void StrokeStamp(_In_reads_(Count) const SPAN* Spans, _In_ UINT32 Count, _In_opt_ void* Context)
+{
+    for (UINT32 SpanIndex = 0; SpanIndex < Count; SpanIndex++)
+    {
+        StrokeRow((STROKESTAMP*)Context, Spans[SpanIndex].Y, Spans[SpanIndex].Left, Spans[SpanIndex].Right, NULL);
+    }
+}
+
+
+// StampBrushSegment callback for every other brush. Context points to a STROKESTAMP.
+static void StrokeBrushRow(_In_ INT32 Y, _In_ INT32 Left, _In_ UINT32 Count, _In_reads_(Count) const UINT8* Alpha, _In_opt_ void* Context)
+{
+    StrokeRow((STROKESTAMP*)Context, Y, Left, Left + (INT32)Count, Alpha);
+}
+
+
+// Draws the segments of a stroke that end at points FirstPoint through PointCount - 1.
+static void StampSegments(_Inout_ STROKESTAMP* Stamp, _In_ UINT32 FirstPoint)
+{
+    const ANNOTATION* Stroke = Stamp->Stroke;
+
+    // A square brush is swept exactly, a row at a time, and needs no mask. So does any other brush whose mask
+    // can't be allocated, which still covers everything that the stroke was meant to.
+    const BRUSHMASK* Mask = NULL;
+
+    if (Stroke->BrushTip != BRUSHTIP_SQUARE)
+    {
+        Mask = GetBrushMask(Stroke->BrushTip, Stroke->BrushWidth, Stroke->BrushHeight);
+    }
+
+    for (UINT32 Point = max(FirstPoint, 1); Point < Stroke->PointCount; Point++)
+    {
+        RECT SegmentBounds = { 0 };
+
+        RECT Overlap = { 0 };
+
+        GetStrokeBounds(Stroke->Points[Point - 1], Stroke->Points[Point], Stroke->BrushWidth, Stroke->BrushHeight, &SegmentBounds);
+
+        // Most segments of a long stroke are nowhere near the area being redrawn.
+        if (IntersectRect(&Overlap, &SegmentBounds, &Stamp->Clip) == FALSE)
+        {
+            continue;
+        }
+
+        if (Mask != NULL)
+        {
+            StampBrushSegment(Mask, Stroke->Points[Point - 1], Stroke->Points[Point], &Stamp->Clip, StrokeBrushRow, Stamp);
+        }
+        else
+        {
+            StampStroke(Stroke->Points[Point - 1], Stroke->Points[Point], Stroke->BrushWidth, Stroke->BrushHeight, Stamp->Document->Width, Stamp->Document->Height, StrokeStamp, Stamp);
+        }
+    }
+}
+
+
+static void FreeAnnotation(_In_ ANNOTATION* Annotation)
+{
+    if (Annotation->Points != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Annotation->Points);
+    }
+
+    if (Annotation->Patch != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Annotation->Patch);
+    }
+
+    if (Annotation->PenPoints != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Annotation->PenPoints);
+    }
+
+    if (Annotation->Text != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Annotation->Text);
+    }
+
+    FreeFloodRegion(&Annotation->Region);
+
+    if (Annotation->Font != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Annotation->Font);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Annotation);
+}
+
+
+// Makes sure that there's room for one more annotation in a list of Count. Returns FALSE if memory could not be allocated.
+static BOOL GrowAnnotationList(_Inout_ ANNOTATION*** Annotations, _In_ UINT32 Count, _Inout_ UINT32* Capacity)
+{
+    if (Count < *Capacity)
+    {
+        return TRUE;
+    }
+
+    UINT32 NewCapacity = (*Capacity == 0) ? 64 : *Capacity * 2;
+
+    ANNOTATION** NewAnnotations = NULL;
+
+    if (*Annotations == NULL)
+    {
+        NewAnnotations = HeapAlloc(GetProcessHeap(), 0, NewCapacity * sizeof(ANNOTATION*));
+    }
+    else
+    {
+        NewAnnotations = HeapReAlloc(GetProcessHeap(), 0, *Annotations, NewCapacity * sizeof(ANNOTATION*));
+    }
+
+    if (NewAnnotations == NULL)
+    {
+        return FALSE;
+    }
+
+    *Annotations = NewAnnotations;
+
+    *Capacity = NewCapacity;
+
+    return TRUE;
+}
+
+
+// Throws away the changes that were undone, since they can't be redone on top of something new.
+static void FreeRedo(_Inout_ DOCUMENT* Document)
+{
+    while (Document->RedoCount > 0)
+    {
+        FreeAnnotation(Document->Redo[--Document->RedoCount]);
+    }
+}
+
+
+// Puts Annotation on top of the document, which takes ownership of it.
+static BOOL PushAnnotation(_Inout_ DOCUMENT* Document, _In_ ANNOTATION* Annotation)
+{
+    if (GrowAnnotationList(&Document->Annotations, Document->Count, &Document->Capacity) == FALSE)
+    {
+        return FALSE;
+    }
+
+    FreeRedo(Document);
+
+    Annotation->Step = Document->Step;
+
+    Document->Annotations[Document->Count++] = Annotation;
+
+    return TRUE;
+}
+
+
+// Keeps the tiles under Area in the journal, as part of Annotation's step, before Annotation draws on them.
+static void SaveTiles(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Annotation, _In_ const RECT* Area)
+{
+    SaveJournalTiles(&Document->Journal, Annotation->Step, Document->Raster, &Document->Coverage, Area);
+}
+
+
+// Copies the pixels under Annotation->Bounds out of a whole-raster sized Source, for a redact stroke to keep.
+static BOOL CopyPatch(_Inout_ DOCUMENT* Document, _Inout_ ANNOTATION* Annotation, _In_ const UINT32* Source)
+{
+    INT32 Width = Annotation->Bounds.right - Annotation->Bounds.left;
+
+    INT32 Height = Annotation->Bounds.bottom - Annotation->Bounds.top;
+
+    Annotation->Patch = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    if (Annotation->Patch == NULL)
+    {
+        return FALSE;
+    }
+
+    for (INT32 Row = 0; Row < Height; Row++)
+    {
+        CopyMemory(&Annotation->Patch[(SIZE_T)Row * Width], &Source[(SIZE_T)(Annotation->Bounds.top + Row) * Document->Width + Annotation->Bounds.left], (SIZE_T)Width * sizeof(UINT32));
+    }
+
+    return TRUE;
+}
+
+
+// How many pixels a redact stroke's, a redacted region's or a callout's patch has.
+static SIZE_T GetPatchPixels(_In_ const ANNOTATION* Annotation)
+{
+    const RECT* Rect = (Annotation->Type == ANNOTATION_CALLOUT) ? &Annotation->Inset : &Annotation->Bounds;
+
+    INT32 Width = Rect->right - Rect->left;
+
+    INT32 Height = Rect->bottom - Rect->top;
+
+    if (Annotation->Type == ANNOTATION_CALLOUT)
+    {
+        return (SIZE_T)max(Width, 1) * max(Height, 1);
+    }
+
+    return (SIZE_T)max(Width, 0) * max(Height, 0);
+}
+
+
+static void PutRect(_Inout_ SESSIONRECORD* Record, _In_ const RECT* Rect)
+{
+    PutSessionUInt32(Record, (UINT32)Rect->left);
+
+    PutSessionUInt32(Record, (UINT32)Rect->top);
+
+    PutSessionUInt32(Record, (UINT32)Rect->right);
+
+    PutSessionUInt32(Record, (UINT32)Rect->bottom);
+}
+
+
+static void GetRect(_Inout_ SESSIONCURSOR* Cursor, _Out_ RECT* Rect)
+{
+    Rect->left = (INT32)GetSessionUInt32(Cursor);
+
+    Rect->top = (INT32)GetSessionUInt32(Cursor);
+
+    Rect->right = (INT32)GetSessionUInt32(Cursor);
+
+    Rect->bottom = (INT32)GetSessionUInt32(Cursor);
+}
+
+
+// Writes a finished annotation to the document's session, if it has one.
+static void RecordAnnotation(_In_ const DOCUMENT* Document, _In_ const ANNOTATION* Annotation)
+{
+    if (Document->Session == NULL)
+    {
+        return;
+    }
+
+    SESSIONRECORD Record = { 0 };
+
+    BeginSessionRecord(&Record, SESSIONRECORD_ANNOTATION);
+
+    PutSessionUInt32(&Record, Annotation->Step);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->Type);
+
+    PutRect(&Record, &Annotation->Bounds);
+
+    PutSessionUInt32(&Record, Annotation->Color);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->Start.x);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->Start.y);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->End.x);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->End.y);
+
+    PutRect(&Record, &Annotation->Inset);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->BrushTip);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->BrushWidth);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->BrushHeight);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->PenWidth);
+
+    PutSessionUInt32(&Record, (UINT32)Annotation->BlendMode);
+
+    PutSessionUInt32(&Record, Annotation->PointCount);
+
+    for (UINT32 Index = 0; Index < Annotation->PointCount; Index++)
+    {
+        PutSessionUInt32(&Record, (UINT32)Annotation->Points[Index].x);
+
+        PutSessionUInt32(&Record, (UINT32)Annotation->Points[Index].y);
+    }
+
+    PutSessionUInt32(&Record, Annotation->PenPointCount);
+
+    for (UINT32 Index = 0; Index < Annotation->PenPointCount; Index++)
+    {
+        UINT32 Bits[2] = { 0 };
+
+        CopyMemory(&Bits[0], &Annotation->PenPoints[Index].X, sizeof(UINT32));
+
+        CopyMemory(&Bits[1], &Annotation->PenPoints[Index].Y, sizeof(UINT32));
+
+        PutSessionUInt32(&Record, Bits[0]);
+
+        PutSessionUInt32(&Record, Bits[1]);
+    }
+
+    PutSessionUInt32(&Record, Annotation->Patch != NULL);
+
+    if (Annotation->Patch != NULL)
+    {
+        PutSessionBytes(&Record, Annotation->Patch, GetPatchPixels(Annotation) * sizeof(UINT32));
+    }
+
+    PutSessionUInt32(&Record, Annotation->Region.Bits != NULL);
+
+    if (Annotation->Region.Bits != NULL)
+    {
+        PutSessionUInt64(&Record, Annotation->Region.PixelCount);
+
+        PutSessionUInt32(&Record, Annotation->Region.WordsPerRow);
+
+        PutSessionBytes(&Record, Annotation->Region.Bits, (SIZE_T)Annotation->Region.WordsPerRow * (Annotation->Bounds.bottom - Annotation->Bounds.top) * sizeof(UINT64));
+    }
+
+    // The length of the text plus 1, or 0 if there is none. A wchar_t is written as 32 bits, since it isn't 16 everywhere.
+    UINT32 TextLength = (Annotation->Text != NULL) ? (UINT32)wcslen(Annotation->Text) + 1 : 0;
+
+    PutSessionUInt32(&Record, TextLength);
+
+    for (UINT32 Index = 0; Index + 1 < TextLength; Index++)
+    {
+        PutSessionUInt32(&Record, (UINT32)Annotation->Text[Index]);
+    }
+
+    PutSessionUInt32(&Record, (Annotation->Font != NULL) ? Annotation->FontSize : 0);
+
+    if (Annotation->Font != NULL)
+    {
+        PutSessionBytes(&Record, Annotation->Font, Annotation->FontSize);
+    }
+
+    AppendSessionRecord(Document->Session, &Record);
+}
+
+
+// Records an undo or a redo in the document's session, if it has one.
+static void RecordChange(_In_ const DOCUMENT* Document, _In_ SESSIONRECORDTYPE Type)
+{
+    if (Document->Session == NULL)
+    {
+        return;
+    }
+
+    SESSIONRECORD Record = { 0 };
+
+    BeginSessionRecord(&Record, (UINT32)Type);
+
+    AppendSessionRecord(Document->Session, &Record);
+}
+
+
+// Makes a new annotation from a record that RecordAnnotation wrote, and gets the step it was recorded with. Nothing
+// in the record is trusted: anything that doesn't fit the document, or could make drawing the annotation read or
+// write past what was allocated, means the record is damaged. Returns NULL if it is, or memory could not be allocated.
+static ANNOTATION* ReadAnnotation(_In_ const DOCUMENT* Document, _Inout_ SESSIONCURSOR* Cursor, _Out_ UINT32* Step)
+{
+    RECT Snip = { 0, 0, Document->Width, Document->Height };
+
+    RECT Clipped = { 0 };
+
+    ANNOTATION* Annotation = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ANNOTATION));
+
+    if (Annotation == NULL)
+    {
+        return NULL;
+    }
+
+    *Step = GetSessionUInt32(Cursor);
+
+    Annotation->Type = (ANNOTATIONTYPE)GetSessionUInt32(Cursor);
+
+    GetRect(Cursor, &Annotation->Bounds);
+
+    Annotation->Color = GetSessionUInt32(Cursor);
+
+    Annotation->Start.x = (INT32)GetSessionUInt32(Cursor);
+
+    Annotation->Start.y = (INT32)GetSessionUInt32(Cursor);
+
+    Annotation->End.x = (INT32)GetSessionUInt32(Cursor);
+
+    Annotation->End.y = (INT32)GetSessionUInt32(Cursor);
+
+    GetRect(Cursor, &Annotation->Inset);
+
+    Annotation->BrushTip = (BRUSHTIP)GetSessionUInt32(Cursor);
+
+    Annotation->BrushWidth = (INT32)GetSessionUInt32(Cursor);
+
+    Annotation->BrushHeight = (INT32)GetSessionUInt32(Cursor);
+
+    Annotation->PenWidth = (INT32)GetSessionUInt32(Cursor);
+
+    Annotation->BlendMode = (BLENDMODE)GetSessionUInt32(Cursor);
+
+    BOOL Damaged = (UINT32)Annotation->Type > ANNOTATION_CALLOUT || (UINT32)Annotation->BlendMode > BLENDMODE_LINEAR || (UINT32)Annotation->BrushTip > BRUSHTIP_CHISEL;
+
+    // Every annotation's bounds are clipped to the snip when it's added.
+    if (IsRectEmpty(&Annotation->Bounds) == FALSE && (IntersectRect(&Clipped, &Annotation->Bounds, &Snip) == FALSE || EqualRect(&Clipped, &Annotation->Bounds) == FALSE))
+    {
+        Damaged = TRUE;
+    }
+
+    if (Annotation->Type == ANNOTATION_HILIGHT || Annotation->Type == ANNOTATION_REDACT || Annotation->Type == ANNOTATION_ERASE)
+    {
+        Damaged |= Annotation->BrushWidth <= 0 || Annotation->BrushHeight <= 0;
+    }
+    else if (Annotation->Type != ANNOTATION_REGION && Annotation->Type != ANNOTATION_TEXT)
+    {
+        Damaged |= Annotation->PenWidth <= 0;
+    }
+
+    if (Annotation->Type == ANNOTATION_CALLOUT)
+    {
+        Damaged |= Annotation->Inset.right < Annotation->Inset.left || Annotation->Inset.bottom < Annotation->Inset.top;
+    }
+
+    // Each count is checked against what's left of the record before anything is allocated for it.
+    UINT32 PointCount = GetSessionUInt32(Cursor);
+
+    if (Damaged == FALSE && PointCount > 0 && PointCount <= (Cursor->Size - Cursor->Offset) / 8)
+    {
+        Annotation->Points = HeapAlloc(GetProcessHeap(), 0, PointCount * sizeof(POINT));
+
+        if (Annotation->Points != NULL)
+        {
+            Annotation->PointCount = PointCount;
+
+            Annotation->PointCapacity = PointCount;
+
+            for (UINT32 Index = 0; Index < PointCount; Index++)
+            {
+                Annotation->Points[Index].x = (INT32)GetSessionUInt32(Cursor);
+
+                Annotation->Points[Index].y = (INT32)GetSessionUInt32(Cursor);
+            }
+        }
+    }
+
+    Damaged |= (Annotation->PointCount != PointCount);
+
+    UINT32 PenPointCount = Damaged ? 0 : GetSessionUInt32(Cursor);
+
+    if (Damaged == FALSE && PenPointCount > 0 && PenPointCount <= (Cursor->Size - Cursor->Offset) / 8)
+    {
+        Annotation->PenPoints = HeapAlloc(GetProcessHeap(), 0, PenPointCount * sizeof(RASTERPOINT));
+
+        if (Annotation->PenPoints != NULL)
+        {
+            Annotation->PenPointCount = PenPointCount;
+
+            Annotation->PenPointCapacity = PenPointCount;
+
+            for (UINT32 Index = 0; Index < PenPointCount; Index++)
+            {
+                UINT32 Bits[2] = { 0 };
+
+                Bits[0] = GetSessionUInt32(Cursor);
+
+                Bits[1] = GetSessionUInt32(Cursor);
+
+                CopyMemory(&Annotation->PenPoints[Index].X, &Bits[0], sizeof(float));
+
+                CopyMemory(&Annotation->PenPoints[Index].Y, &Bits[1], sizeof(float));
+            }
+        }
+    }
+
+    Damaged |= (Annotation->PenPointCount != PenPointCount);
+
+    // A stroke's points are what it draws from, so one without any can't be drawn.
+    if (Annotation->Type == ANNOTATION_HILIGHT || Annotation->Type == ANNOTATION_REDACT || Annotation->Type == ANNOTATION_ERASE)
+    {
+        Damaged |= (Annotation->PointCount == 0);
+    }
+    else if (Annotation->Type == ANNOTATION_PEN)
+    {
+        Damaged |= (Annotation->PenPointCount == 0);
+    }
+
+    if (Damaged == FALSE && GetSessionUInt32(Cursor) != 0)
+    {
+        SIZE_T PatchBytes = GetPatchPixels(Annotation) * sizeof(UINT32);
+
+        if (PatchBytes > 0 && PatchBytes <= Cursor->Size - Cursor->Offset)
+        {
+            Annotation->Patch = HeapAlloc(GetProcessHeap(), 0, PatchBytes);
+        }
+
+        Damaged |= (Annotation->Patch == NULL || GetSessionBytes(Cursor, Annotation->Patch, PatchBytes) == FALSE);
+    }
+
+    if (Damaged == FALSE && GetSessionUInt32(Cursor) != 0)
+    {
+        Annotation->Region.Bounds = Annotation->Bounds;
+
+        Annotation->Region.PixelCount = GetSessionUInt64(Cursor);
+
+        Annotation->Region.WordsPerRow = GetSessionUInt32(Cursor);
+
+        // The words of each row have to cover the region's bounds exactly, as FloodFillRegion makes them.
+        if (IsRectEmpty(&Annotation->Bounds) == FALSE && Annotation->Region.WordsPerRow == (((UINT32)Annotation->Bounds.right - 1) >> 6) - ((UINT32)Annotation->Bounds.left >> 6) + 1)
+        {
+            SIZE_T RegionBytes = (SIZE_T)Annotation->Region.WordsPerRow * (Annotation->Bounds.bottom - Annotation->Bounds.top) * sizeof(UINT64);
+
+            if (RegionBytes <= Cursor->Size - Cursor->Offset)
+            {
+                Annotation->Region.Bits = HeapAlloc(GetProcessHeap(), 0, RegionBytes);
+            }
+
+            Damaged |= (Annotation->Region.Bits == NULL || GetSessionBytes(Cursor, Annotation->Region.Bits, RegionBytes) == FALSE);
+        }
+        else
+        {
+            Damaged = TRUE;
+        }
+    }
+
+    if (Annotation->Type == ANNOTATION_REGION)
+    {
+        Damaged |= (Annotation->Region.Bits == NULL);
+    }
+
+    UINT32 TextLength = Damaged ? 0 : GetSessionUInt32(Cursor);
+
+    if (TextLength > 0)
+    {
+        if (TextLength - 1 <= (Cursor->Size - Cursor->Offset) / 4)
+        {
+            Annotation->Text = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)TextLength * sizeof(wchar_t));
+        }
+
+        if (Annotation->Text != NULL)
+        {
+            for (UINT32 Index = 0; Index + 1 < TextLength; Index++)
+            {
+                Annotation->Text[Index] = (wchar_t)GetSessionUInt32(Cursor);
+            }
+
+            Annotation->Text[TextLength - 1] = L'\0';
+        }
+        else
+        {
+            Damaged = TRUE;
+        }
+    }
+
+    UINT32 FontSize = Damaged ? 0 : GetSessionUInt32(Cursor);
+
+    if (FontSize > 0)
+    {
+        if (FontSize <= Cursor->Size - Cursor->Offset)
+        {
+            Annotation->Font = HeapAlloc(GetProcessHeap(), 0, FontSize);
+        }
+
+        if (Annotation->Font != NULL && GetSessionBytes(Cursor, Annotation->Font, FontSize))
+        {
+            Annotation->FontSize = FontSize;
+        }
+        else
+        {
+            Damaged = TRUE;
+        }
+    }
+
+    if (Damaged || Cursor->Failed || Cursor->Offset != Cursor->Size)
+    {
+        FreeAnnotation(Annotation);
+
+        return NULL;
+    }
+
+    return Annotation;
+}
+
+
+BOOL InitializeDocument(_Out_ DOCUMENT* Document, _In_ UINT32* Raster, _In_ INT32 Width, _In_ INT32 Height, _In_ SIZE_T JournalBudget, _In_ RENDERFUNCTION Render, _In_opt_ void* RenderContext)
+{
+    ZeroMemory(Document, sizeof(DOCUMENT));
+
+    Document->Base = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    if (Document->Base == NULL)
+    {
+        return FALSE;
+    }
+
+    CopyMemory(Document->Base, Raster, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    Document->StrokeCoverage = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)Width * Height);
+
+    if (Document->StrokeCoverage == NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Document->Base);
+
+        return FALSE;
+    }
+
+    if (InitializeJournal(&Document->Journal, Width, Height, Document->Base, JournalBudget) == FALSE)
+    {
+        HeapFree(GetProcessHeap(), 0, Document->StrokeCoverage);
+
+        HeapFree(GetProcessHeap(), 0, Document->Base);
+
+        return FALSE;
+    }
+
+    Document->Width = Width;
+
+    Document->Height = Height;
+
+    Document->Raster = Raster;
+
+    Document->Render = Render;
+
+    Document->RenderContext = RenderContext;
+
+    InitializeCoverage(&Document->Coverage, (UINT32)Width, (UINT32)Height);
+
+    return TRUE;
+}
+
+
+void FreeDocument(_Inout_ DOCUMENT* Document)
+{
+    for (UINT32 Index = 0; Index < Document->Count; Index++)
+    {
+        FreeAnnotation(Document->Annotations[Index]);
+    }
+
+    if (Document->Annotations != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Document->Annotations);
+    }
+
+    FreeRedo(Document);
+
+    if (Document->Redo != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Document->Redo);
+    }
+
+    FreeJournal(&Document->Journal);
+
+    if (Document->Base != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Document->Base);
+    }
+
+    if (Document->StrokeCoverage != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Document->StrokeCoverage);
+    }
+
+    FreeCoverage(&Document->Coverage);
+
+    ZeroMemory(Document, sizeof(DOCUMENT));
+}
+
+
+void BeginDocumentStep(_Inout_ DOCUMENT* Document)
+{
+    Document->Step++;
+}
+
+
+ANNOTATION* AddAnnotation(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Annotation)
+{
+    ANNOTATION* Copy = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ANNOTATION));
+
+    if (Copy == NULL)
+    {
+        return NULL;
+    }
+
+    Copy->Type = Annotation->Type;
+
+    Copy->Color = Annotation->Color;
+
+    Copy->Start = Annotation->Start;
+
+    Copy->End = Annotation->End;
+
+    Copy->PenWidth = Annotation->PenWidth;
+
+    Copy->BlendMode = Annotation->BlendMode;
+
+    RECT Snip = { 0, 0, Document->Width, Document->Height };
+
+    IntersectRect(&Copy->Bounds, &Annotation->Bounds, &Snip);
+
+    if (Annotation->Text != NULL)
+    {
+        SIZE_T Length = wcslen(Annotation->Text) + 1;
+
+        Copy->Text = HeapAlloc(GetProcessHeap(), 0, Length * sizeof(wchar_t));
+
+        if (Copy->Text == NULL)
+        {
+            FreeAnnotation(Copy);
+
+            return NULL;
+        }
+
+        CopyMemory(Copy->Text, Annotation->Text, Length * sizeof(wchar_t));
+    }
+
+    if (Annotation->Font != NULL && Annotation->FontSize > 0)
+    {
+        Copy->Font = HeapAlloc(GetProcessHeap(), 0, Annotation->FontSize);
+
+        if (Copy->Font == NULL)
+        {
+            FreeAnnotation(Copy);
+
+            return NULL;
+        }
+
+        CopyMemory(Copy->Font, Annotation->Font, Annotation->FontSize);
+
+        Copy->FontSize = Annotation->FontSize;
+    }
+
+    if (PushAnnotation(Document, Copy) == FALSE)
+    {
+        FreeAnnotation(Copy);
+
+        return NULL;
+    }
+
+    SaveTiles(Document, Copy, &Copy->Bounds);
+
+    DrawAnnotation(Document, Copy, &Copy->Bounds);
+
+    RecordAnnotation(Document, Copy);
+
+    return Copy;
+}
+
+
+ANNOTATION* BeginStroke(_Inout_ DOCUMENT* Document, _In_ ANNOTATIONTYPE Type, _In_ POINT Point, _In_ BRUSHTIP BrushTip, _In_ INT32 BrushWidth, _In_ INT32 BrushHeight, _In_ UINT32 Color, _In_ BLENDMODE BlendMode)
+{
+    ANNOTATION* Stroke = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ANNOTATION));
+
+    if (Stroke == NULL)
+    {
+        return NULL;
+    }
+
+    Stroke->Type = Type;
+
+    Stroke->Color = Color;
+
+    Stroke->BrushTip = BrushTip;
+
+    Stroke->BrushWidth = BrushWidth;
+
+    Stroke->BrushHeight = BrushHeight;
+
+    Stroke->BlendMode = BlendMode;
+
+    Stroke->PointCapacity = 64;
+
+    Stroke->Points = HeapAlloc(GetProcessHeap(), 0, Stroke->PointCapacity * sizeof(POINT));
+
+    if (Stroke->Points == NULL || PushAnnotation(Document, Stroke) == FALSE)
+    {
+        FreeAnnotation(Stroke);
+
+        return NULL;
+    }
+
+    Stroke->Points[Stroke->PointCount++] = Point;
+
+    return Stroke;
+}
+
+
+BOOL AddStrokePoint(_Inout_ DOCUMENT* Document, _Inout_ ANNOTATION* Stroke, _In_ POINT Point, _In_opt_ const UINT32* Source, _Out_ RECT* Damage)
+{
+    SetRectEmpty(Damage);
+
+    if (Stroke->PointCount == Stroke->PointCapacity)
+    {
+        POINT* Points = HeapReAlloc(GetProcessHeap(), 0, Stroke->Points, Stroke->PointCapacity * 2 * sizeof(POINT));
+
+        if (Points == NULL)
+        {
+            return FALSE;
+        }
+
+        Stroke->Points = Points;
+
+        Stroke->PointCapacity *= 2;
+    }
+
+    Stroke->Points[Stroke->PointCount++] = Point;
+
+    RECT SegmentBounds = { 0 };
+
+    GetStrokeBounds(Stroke->Points[Stroke->PointCount - 2], Point, Stroke->BrushWidth, Stroke->BrushHeight, &SegmentBounds);
+
+    SaveTiles(Document, Stroke, &SegmentBounds);
+
+    STROKESTAMP Stamp = { 0 };
+
+    Stamp.Document = Document;
+
+    Stamp.Stroke = Stroke;
+
+    SetRect(&Stamp.Clip, 0, 0, Document->Width, Document->Height);
+
+    Stamp.Pixels = Source;
+
+    Stamp.Stride = Document->Width;
+
+    StampSegments(&Stamp, Stroke->PointCount - 1);
+
+    if (IsRectEmpty(&Stamp.Damage) == FALSE)
+    {
+        UnionRect(&Stroke->Bounds, &Stroke->Bounds, &Stamp.Damage);
+
+        *Damage = Stamp.Damage;
+    }
+
+    return TRUE;
+}
+
+
+BOOL EndStroke(_Inout_ DOCUMENT* Document, _In_ ANNOTATION* Stroke, _In_opt_ const UINT32* Source)
+{
+    if (Stroke->BrushTip != BRUSHTIP_SQUARE)
+    {
+        ClearStrokeCoverage(Document, &Stroke->Bounds);
+    }
+
+    if (IsRectEmpty(&Stroke->Bounds) == FALSE)
+    {
+        // If the patch can't be kept, the stroke will black out instead the next time it is redrawn, which
+        // still hides what was under it.
+        if (Stroke->Type == ANNOTATION_REDACT && Source != NULL)
+        {
+            CopyPatch(Document, Stroke, Source);
+        }
+
+        RecordAnnotation(Document, Stroke);
+
+        return TRUE;
+    }
+
+    for (UINT32 Index = Document->Count; Index > 0; Index--)
+    {
+        if (Document->Annotations[Index - 1] == Stroke)
+        {
+            MoveMemory(&Document->Annotations[Index - 1], &Document->Annotations[Index], (Document->Count - Index) * sizeof(ANNOTATION*));
+
+            Document->Count--;
+
+            // It kept the tiles that it was about to draw on, but didn't draw on them.
+            if (Document->Count == 0 || Document->Annotations[Document->Count - 1]->Step != Stroke->Step)
+            {
+                DiscardJournalStep(&Document->Journal, Stroke->Step);
+            }
+
+            FreeAnnotation(Stroke);
+
+            break;
+        }
+    }
+
+    return FALSE;
+}
+
+
+ANNOTATION* AddTranslatedStroke(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Stroke, _In_ INT32 OffsetX, _In_ INT32 OffsetY, _In_opt_ const UINT32* Source)
+{
+    ANNOTATION* Copy = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ANNOTATION));
+
+    if (Copy == NULL)
+    {
+        return NULL;
+    }
+
+    Copy->Type = Stroke->Type;
+
+    Copy->Color = Stroke->Color;
+
+    Copy->BrushTip = Stroke->BrushTip;
+
+    Copy->BrushWidth = Stroke->BrushWidth;
+
+    Copy->BrushHeight = Stroke->BrushHeight;
+
+    Copy->BlendMode = Stroke->BlendMode;
+
+    RECT Snip = { 0, 0, Document->Width, Document->Height };
+
+    RECT Bounds = Stroke->Bounds;
+
+    OffsetRect(&Bounds, OffsetX, OffsetY);
+
+    IntersectRect(&Copy->Bounds, &Bounds, &Snip);
+
+    Copy->PointCount = Stroke->PointCount;
+
+    Copy->PointCapacity = Stroke->PointCount;
+
+    Copy->Points = HeapAlloc(GetProcessHeap(), 0, Copy->PointCapacity * sizeof(POINT));
+
+    if (Copy->Points == NULL)
+    {
+        FreeAnnotation(Copy);
+
+        return NULL;
+    }
+
+    for (UINT32 Point = 0; Point < Copy->PointCount; Point++)
+    {
+        Copy->Points[Point].x = Stroke->Points[Point].x + OffsetX;
+
+        Copy->Points[Point].y = Stroke->Points[Point].y + OffsetY;
+    }
+
+    if (Copy->Type == ANNOTATION_REDACT && Source != NULL && IsRectEmpty(&Copy->Bounds) == FALSE)
+    {
+        CopyPatch(Document, Copy, Source);
+    }
+
+    if (PushAnnotation(Document, Copy) == FALSE)
+    {
+        FreeAnnotation(Copy);
+
+        return NULL;
+    }
+
+    SaveTiles(Document, Copy, &Copy->Bounds);
+
+    DrawAnnotation(Document, Copy, &Copy->Bounds);
+
+    RecordAnnotation(Document, Copy);
+
+    return Copy;
+}
+
+
+ANNOTATION* AddRegionAnnotation(_Inout_ DOCUMENT* Document, _Inout_ FLOODREGION* Region, _In_ UINT32 Color, _In_opt_ const UINT32* Source)
+{
+    ANNOTATION* Annotation = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ANNOTATION));
+
+    if (Annotation == NULL)
+    {
+        return NULL;
+    }
+
+    Annotation->Type = ANNOTATION_REGION;
+
+    Annotation->Color = Color;
+
+    Annotation->Bounds = Region->Bounds;
+
+    if (Source != NULL && CopyPatch(Document, Annotation, Source) == FALSE)
+    {
+        FreeAnnotation(Annotation);
+
+        return NULL;
+    }
+
+    if (PushAnnotation(Document, Annotation) == FALSE)
+    {
+        FreeAnnotation(Annotation);
+
+        return NULL;
+    }
+
+    Annotation->Region = *Region;
+
+    ZeroMemory(Region, sizeof(FLOODREGION));
+
+    SaveTiles(Document, Annotation, &Annotation->Bounds);
+
+    DrawAnnotation(Document, Annotation, &Annotation->Bounds);
+
+    RecordAnnotation(Document, Annotation);
+
+    return Annotation;
+}
+
+
+// Gets every pixel that segment Index of a pen stroke could draw on, before clipping.
+static void GetPenSegmentBounds(_In_ const ANNOTATION* Stroke, _In_ UINT32 Index, _Out_ RECT* Bounds)
+{
+    RASTERPOINT From = Stroke->PenPoints[(Index == 0) ? 0 : Index - 1];
+
+    RASTERPOINT To = Stroke->PenPoints[Index];
+
+    // The round ends stick out by half of the pen, plus a pixel for the smoothed edge.
+    float Reach = (float)Stroke->PenWidth / 2.0f + 1.0f;
+
+    SetRect(Bounds,
+        (LONG)floorf(min(From.X, To.X) - Reach),
+        (LONG)floorf(min(From.Y, To.Y) - Reach),
+        (LONG)ceilf(max(From.X, To.X) + Reach),
+        (LONG)ceilf(max(From.Y, To.Y) + Reach));
+}
+
+
+// Draws segment Index of a pen stroke, from point Index - 1 to point Index, or the dot at its first point if
+// Index is 0, clipped to Clip. Damage is grown to cover the pixels that were drawn on.
+static void DrawPenSegment(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Stroke, _In_ UINT32 Index, _In_ const RECT* Clip, _Inout_ RECT* Damage)
+{
+    RASTERPOINT From = Stroke->PenPoints[(Index == 0) ? 0 : Index - 1];
+
+    RASTERPOINT To = Stroke->PenPoints[Index];
+
+    RECT Area = { 0 };
+
+    GetPenSegmentBounds(Stroke, Index, &Area);
+
+    if (IntersectRect(&Area, &Area, Clip) == FALSE)
+    {
+        return;
+    }
+
+    RASTERTARGET Target = { 0 };
+
+    Target.Pixels = &Document->Raster[(SIZE_T)Area.top * Document->Width + Area.left];
+
+    Target.Coverage = &Document->StrokeCoverage[(SIZE_T)Area.top * Document->Width + Area.left];
+
+    Target.Stride = Document->Width;
+
+    Target.Bounds = Area;
+
+    DrawCapsule(&Target, From, To, (float)Stroke->PenWidth, Stroke->Color, Stroke->BlendMode);
+
+    UnionRect(Damage, Damage, &Area);
+}
+
+
+ANNOTATION* BeginPenStroke(_Inout_ DOCUMENT* Document, _In_ RASTERPOINT Point, _In_ INT32 PenWidth, _In_ UINT32 Color, _In_ BLENDMODE BlendMode, _Out_ RECT* Damage)
+{
+    SetRectEmpty(Damage);
+
+    ANNOTATION* Stroke = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ANNOTATION));
+
+    if (Stroke == NULL)
+    {
+        return NULL;
+    }
+
+    Stroke->Type = ANNOTATION_PEN;
+
+    Stroke->Color = Color;
+
+    Stroke->PenWidth = PenWidth;
+
+    Stroke->BlendMode = BlendMode;
+
+    Stroke->PenPointCapacity = 64;
+
+    Stroke->PenPoints = HeapAlloc(GetProcessHeap(), 0, Stroke->PenPointCapacity * sizeof(RASTERPOINT));
+
+    if (Stroke->PenPoints == NULL || PushAnnotation(Document, Stroke) == FALSE)
+    {
+        FreeAnnotation(Stroke);
+
+        return NULL;
+    }
+
+    Stroke->PenPoints[Stroke->PenPointCount++] = Point;
+
+    RECT Snip = { 0, 0, Document->Width, Document->Height };
+
+    RECT SegmentBounds = { 0 };
+
+    GetPenSegmentBounds(Stroke, 0, &SegmentBounds);
+
+    SaveTiles(Document, Stroke, &SegmentBounds);
+
+    DrawPenSegment(Document, Stroke, 0, &Snip, &Stroke->Bounds);
+
+    *Damage = Stroke->Bounds;
+
+    return Stroke;
+}
+
+
+BOOL AddPenPoint(_Inout_ DOCUMENT* Document, _Inout_ ANNOTATION* Stroke, _In_ RASTERPOINT Point, _Out_ RECT* Damage)
+{
+    SetRectEmpty(Damage);
+
+    if (Stroke->PenPointCount == Stroke->PenPointCapacity)
+    {
+        RASTERPOINT* Points = HeapReAlloc(GetProcessHeap(), 0, Stroke->PenPoints, Stroke->PenPointCapacity * 2 * sizeof(RASTERPOINT));
+
+        if (Points == NULL)
+        {
+            return FALSE;
+        }
+
+        Stroke->PenPoints = Points;
+
+        Stroke->PenPointCapacity *= 2;
+    }
+
+    Stroke->PenPoints[Stroke->PenPointCount++] = Point;
+
+    RECT Snip = { 0, 0, Document->Width, Document->Height };
+
+    RECT SegmentBounds = { 0 };
+
+    GetPenSegmentBounds(Stroke, Stroke->PenPointCount - 1, &SegmentBounds);
+
+    SaveTiles(Document, Stroke, &SegmentBounds);
+
+    DrawPenSegment(Document, Stroke, Stroke->PenPointCount - 1, &Snip, Damage);
+
+    UnionRect(&Stroke->Bounds, &Stroke->Bounds, Damage);
+
+    return TRUE;
+}
+
+
+void EndPenStroke(_Inout_ DOCUMENT* Document, _Inout_ ANNOTATION* Stroke, _In_ float Tolerance, _Out_ RECT* Damage)
+{
+    *Damage = Stroke->Bounds;
+
+    ClearStrokeCoverage(Document, &Stroke->Bounds);
+
+    UINT32 Count = SimplifyPolyline(Stroke->PenPoints, Stroke->PenPointCount, Tolerance);
+
+    if (Count != Stroke->PenPointCount)
+    {
+        Stroke->PenPointCount = Count;
+
+        // The simplified stroke is within a fraction of a pixel of what was drawn, but not exactly the same, and
+        // undo will redraw it from the simplified points. Draw it that way now too, so that undoing something
+        // else on top of it doesn't change it.
+        RedrawDocument(Document, &Stroke->Bounds);
+    }
+
+    RecordAnnotation(Document, Stroke);
+}
+
+
+// Pixel X covers X to X + 1, so the center of a pixel is half a pixel in. An outline with an even width is
+// moved onto the line between pixels instead, so that it covers whole pixels and comes out crisp.
+static RASTERPOINT GetPenPoint(_In_ POINT Point, _In_ INT32 PenWidth)
+{
+    float Offset = (PenWidth % 2 == 0) ? 0.0f : 0.5f;
+
+    RASTERPOINT PenPoint = { (float)Point.x + Offset, (float)Point.y + Offset };
+
+    return PenPoint;
+}
+
+
+void DrawBoxOrArrow(_In_ const RASTERTARGET* Target, _In_ const ANNOTATION* Annotation)
+{
+    RASTERPOINT Start = GetPenPoint(Annotation->Start, Annotation->PenWidth);
+
+    RASTERPOINT End = GetPenPoint(Annotation->End, Annotation->PenWidth);
+
+    if (Annotation->Type == ANNOTATION_BOX)
+    {
+        DrawBox(Target, Start, End, (float)Annotation->PenWidth, Annotation->Color, Annotation->BlendMode);
+    }
+    else if (Annotation->Type == ANNOTATION_ARROW)
+    {
+        DrawArrow(Target, Start, End, (float)Annotation->PenWidth, Annotation->Color, Annotation->BlendMode);
+    }
+}
+
+
+void GetBoxOrArrowBounds(_In_ const ANNOTATION* Annotation, _Out_ RECT* Bounds)
+{
+    SetRect(Bounds, min(Annotation->Start.x, Annotation->End.x), min(Annotation->Start.y, Annotation->End.y), max(Annotation->Start.x, Annotation->End.x) + 1, max(Annotation->Start.y, Annotation->End.y) + 1);
+
+    RASTERPOINT Head[3] = { 0 };
+
+    if (Annotation->Type == ANNOTATION_ARROW && GetArrowHead(GetPenPoint(Annotation->Start, Annotation->PenWidth), GetPenPoint(Annotation->End, Annotation->PenWidth), (float)Annotation->PenWidth, Head))
+    {
+        for (int Corner = 1; Corner < 3; Corner++)
+        {
+            Bounds->left = min(Bounds->left, (LONG)floorf(Head[Corner].X));
+
+            Bounds->top = min(Bounds->top, (LONG)floorf(Head[Corner].Y));
+
+            Bounds->right = max(Bounds->right, (LONG)ceilf(Head[Corner].X));
+
+            Bounds->bottom = max(Bounds->bottom, (LONG)ceilf(Head[Corner].Y));
+        }
+    }
+
+    // Half of the pen sticks out on either side of the outline, plus a pixel for its smoothed edge.
+    InflateRect(Bounds, Annotation->PenWidth / 2 + 1, Annotation->PenWidth / 2 + 1);
+}
+
+
+UINT32 GetSpotlightStrips(_In_ const ANNOTATION* Annotation, _In_ const RECT* Area, _Out_writes_(4) RECT* Strips)
+{
+    RECT Inside = { min(Annotation->Start.x, Annotation->End.x), min(Annotation->Start.y, Annotation->End.y), max(Annotation->Start.x, Annotation->End.x) + 1, max(Annotation->Start.y, Annotation->End.y) + 1 };
+
+    // The rows between the top and bottom strips, which the left and right strips share.
+    LONG Top = max(Area->top, min(Inside.top, Area->bottom));
+
+    LONG Bottom = min(Area->bottom, max(Inside.bottom, Top));
+
+    RECT Candidates[4] = {
+        { Area->left, Area->top, Area->right, Top },
+        { Area->left, Bottom, Area->right, Area->bottom },
+        { Area->left, Top, min(Area->right, Inside.left), Bottom },
+        { max(Area->left, Inside.right), Top, Area->right, Bottom } };
+
+    UINT32 Count = 0;
+
+    for (int Index = 0; Index < 4; Index++)
+    {
+        if (Candidates[Index].left < Candidates[Index].right && Candidates[Index].top < Candidates[Index].bottom)
+        {
+            Strips[Count++] = Candidates[Index];
+        }
+    }
+
+    return Count;
+}
+
+
+void DrawSpotlight(_In_ const RASTERTARGET* Target, _In_ const ANNOTATION* Annotation)
+{
+    RECT Strips[4] = { 0 };
+
+    UINT32 Count = GetSpotlightStrips(Annotation, &Target->Bounds, Strips);
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        // Target's pixels start at the top-left corner of its bounds.
+        OffsetRect(&Strips[Index], -Target->Bounds.left, -Target->Bounds.top);
+
+        BlendRect(Target->Pixels, Target->Stride, &Strips[Index], Annotation->Color | 0xFF000000, (UINT8)(Annotation->Color >> 24), Annotation->BlendMode);
+    }
+}
+
+
+BOOL GetCalloutSource(_In_ POINT Start, _In_ POINT End, _In_ INT32 Width, _In_ INT32 Height, _Out_ RECT* Source)
+{
+    RECT Corners = { min(Start.x, End.x), min(Start.y, End.y), max(Start.x, End.x) + 1, max(Start.y, End.y) + 1 };
+
+    RECT Snip = { 0, 0, Width, Height };
+
+    return IntersectRect(Source, &Corners, &Snip);
+}
+
+
+BOOL GetCalloutInset(_In_ const RECT* Source, _In_ INT32 Zoom, _In_ INT32 Width, _In_ INT32 Height, _Out_ RECT* Inset)
+{
+    INT32 SourceWidth = Source->right - Source->left;
+
+    INT32 SourceHeight = Source->bottom - Source->top;
+
+    for (; Zoom >= CALLOUT_MIN_ZOOM; Zoom--)
+    {
+        INT32 InsetWidth = SourceWidth * Zoom;
+
+        INT32 InsetHeight = SourceHeight * Zoom;
+
+        // Centered on the source along the side it's on, but kept inside the snip.
+        INT32 Left = min(max((Source->left + Source->right - InsetWidth) / 2, 0), Width - InsetWidth);
+
+        INT32 Top = min(max((Source->top + Source->bottom - InsetHeight) / 2, 0), Height - InsetHeight);
+
+        if (InsetHeight <= Height && Source->right + CALLOUT_GAP + InsetWidth <= Width)
+        {
+            SetRect(Inset, Source->right + CALLOUT_GAP, Top, Source->right + CALLOUT_GAP + InsetWidth, Top + InsetHeight);
+
+            return TRUE;
+        }
+
+        if (InsetHeight <= Height && Source->left - CALLOUT_GAP - InsetWidth >= 0)
+        {
+            SetRect(Inset, Source->left - CALLOUT_GAP - InsetWidth, Top, Source->left - CALLOUT_GAP, Top + InsetHeight);
+
+            return TRUE;
+        }
+
+        if (InsetWidth <= Width && Source->bottom + CALLOUT_GAP + InsetHeight <= Height)
+        {
+            SetRect(Inset, Left, Source->bottom + CALLOUT_GAP, Left + InsetWidth, Source->bottom + CALLOUT_GAP + InsetHeight);
+
+            return TRUE;
+        }
+
+        if (InsetWidth <= Width && Source->top - CALLOUT_GAP - InsetHeight >= 0)
+        {
+            SetRect(Inset, Left, Source->top - CALLOUT_GAP - InsetHeight, Left + InsetWidth, Source->top - CALLOUT_GAP);
+
+            return TRUE;
+        }
+    }
+
+    SetRectEmpty(Inset);
+
+    return FALSE;
+}
+
+
+void GetCalloutBounds(_In_ const ANNOTATION* Annotation, _Out_ RECT* Bounds)
+{
+    RECT Source = { Annotation->Start.x, Annotation->Start.y, Annotation->End.x + 1, Annotation->End.y + 1 };
+
+    UnionRect(Bounds, &Source, &Annotation->Inset);
+
+    // Half of the pen sticks out on either side of the frames and the lines, plus a pixel for its smoothed edge.
+    InflateRect(Bounds, Annotation->PenWidth / 2 + 1, Annotation->PenWidth / 2 + 1);
+}
+
+
+void DrawCallout(_In_ const RASTERTARGET* Target, _In_ const ANNOTATION* Annotation, _In_opt_ const UINT32* InsetPixels)
+{
+    const RECT* Inset = &Annotation->Inset;
+
+    RECT Area = { 0 };
+
+    if (InsetPixels != NULL && IntersectRect(&Area, &Target->Bounds, Inset))
+    {
+        INT32 InsetWidth = Inset->right - Inset->left;
+
+        for (INT32 Y = Area.top; Y < Area.bottom; Y++)
+        {
+            CopyMemory(
+                &Target->Pixels[(SIZE_T)(Y - Target->Bounds.top) * Target->Stride + (Area.left - Target->Bounds.left)],
+                &InsetPixels[(SIZE_T)(Y - Inset->top) * InsetWidth + (Area.left - Inset->left)],
+                (SIZE_T)(Area.right - Area.left) * sizeof(UINT32));
+        }
+    }
+
+    // The frames go around the outside edges of the pixels, so both corners are on the lines between pixels.
+    RASTERPOINT Source[2] = { { (float)Annotation->Start.x, (float)Annotation->Start.y }, { (float)Annotation->End.x + 1.0f, (float)Annotation->End.y + 1.0f } };
+
+    RASTERPOINT Copy[2] = { { (float)Inset->left, (float)Inset->top }, { (float)Inset->right, (float)Inset->bottom } };
+
+    // Join the two corners of the source that face the copy to the nearest two corners of the copy.
+    RASTERPOINT From[2] = { 0 };
+
+    RASTERPOINT To[2] = { 0 };
+
+    if (Inset->left >= Annotation->End.x + 1)
+    {
+        From[0].X = From[1].X = Source[1].X;
+
+        From[0].Y = Source[0].Y;
+
+        From[1].Y = Source[1].Y;
+
+        To[0] = Copy[0];
+
+        To[1].X = Copy[0].X;
+
+        To[1].Y = Copy[1].Y;
+    }
+    else if (Inset->right <= Annotation->Start.x)
+    {
+        From[0] = Source[0];
+
+        From[1].X = Source[0].X;
+
+        From[1].Y = Source[1].Y;
+
+        To[0].X = To[1].X = Copy[1].X;
+
+        To[0].Y = Copy[0].Y;
+
+        To[1].Y = Copy[1].Y;
+    }
+    else if (Inset->top >= Annotation->End.y + 1)
+    {
+        From[0].X = Source[0].X;
+
+        From[1].X = Source[1].X;
+
+        From[0].Y = From[1].Y = Source[1].Y;
+
+        To[0] = Copy[0];
+
+        To[1].X = Copy[1].X;
+
+        To[1].Y = Copy[0].Y;
+    }
+    else
+    {
+        From[0] = Source[0];
+
+        From[1].X = Source[1].X;
+
+        From[1].Y = Source[0].Y;
+
+        To[0].X = Copy[0].X;
+
+        To[1].X = Copy[1].X;
+
+        To[0].Y = To[1].Y = Copy[1].Y;
+    }
+
+    for (int Line = 0; Line < 2; Line++)
+    {
+        DrawLine(Target, From[Line], To[Line], (float)Annotation->PenWidth, Annotation->Color, Annotation->BlendMode);
+    }
+
+    DrawBox(Target, Source[0], Source[1], (float)Annotation->PenWidth, Annotation->Color, Annotation->BlendMode);
+
+    DrawBox(Target, Copy[0], Copy[1], (float)Annotation->PenWidth, Annotation->Color, Annotation->BlendMode);
+}
+
+
+ANNOTATION* AddCalloutAnnotation(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Callout)
+{
+    INT32 InsetWidth = Callout->Inset.right - Callout->Inset.left;
+
+    INT32 InsetHeight = Callout->Inset.bottom - Callout->Inset.top;
+
+    RECT Source = { Callout->Start.x, Callout->Start.y, Callout->End.x + 1, Callout->End.y + 1 };
+
+    ANNOTATION* Annotation = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ANNOTATION));
+
+    if (Annotation == NULL)
+    {
+        return NULL;
+    }
+
+    Annotation->Type = ANNOTATION_CALLOUT;
+
+    Annotation->Color = Callout->Color;
+
+    Annotation->Start = Callout->Start;
+
+    Annotation->End = Callout->End;
+
+    Annotation->Inset = Callout->Inset;
+
+    Annotation->PenWidth = Callout->PenWidth;
+
+    Annotation->BlendMode = Callout->BlendMode;
+
+    RECT Snip = { 0, 0, Document->Width, Document->Height };
+
+    IntersectRect(&Annotation->Bounds, &Callout->Bounds, &Snip);
+
+    Annotation->Patch = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)max(InsetWidth, 1) * max(InsetHeight, 1) * sizeof(UINT32));
+
+    if (Annotation->Patch == NULL || ResampleImage(Document->Raster, Document->Width, Document->Height, &Source, Annotation->Patch, InsetWidth, InsetWidth, InsetHeight) == FALSE)
+    {
+        FreeAnnotation(Annotation);
+
+        return NULL;
+    }
+
+    if (PushAnnotation(Document, Annotation) == FALSE)
+    {
+        FreeAnnotation(Annotation);
+
+        return NULL;
+    }
+
+    SaveTiles(Document, Annotation, &Annotation->Bounds);
+
+    DrawAnnotation(Document, Annotation, &Annotation->Bounds);
+
+    RecordAnnotation(Document, Annotation);
+
+    return Annotation;
+}
+
+
+void DrawAnnotation(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Annotation, _In_ const RECT* Clip)
+{
+    RECT Area = { 0 };
+
+    if (IntersectRect(&Area, Clip, &Annotation->Bounds) == FALSE)
+    {
+        return;
+    }
+
+    if (Annotation->Type == ANNOTATION_HILIGHT || Annotation->Type == ANNOTATION_REDACT || Annotation->Type == ANNOTATION_ERASE)
+    {
+        STROKESTAMP Stamp = { 0 };
+
+        Stamp.Document = Document;
+
+        Stamp.Stroke = Annotation;
+
+        Stamp.Clip = Area;
+
+        Stamp.Pixels = Annotation->Patch;
+
+        Stamp.Stride = Annotation->Bounds.right - Annotation->Bounds.left;
+
+        Stamp.OriginX = Annotation->Bounds.left;
+
+        Stamp.OriginY = Annotation->Bounds.top;
+
+        StampSegments(&Stamp, 1);
+
+        if (Annotation->BrushTip != BRUSHTIP_SQUARE)
+        {
+            ClearStrokeCoverage(Document, &Area);
+        }
+    }
+    else if (Annotation->Type == ANNOTATION_REGION)
+    {
+        INT32 PatchWidth = Annotation->Bounds.right - Annotation->Bounds.left;
+
+        for (INT32 Row = Area.top; Row < Area.bottom; Row++)
+        {
+            UINT32* Pixels = &Document->Raster[(SIZE_T)Row * Document->Width];
+
+            SPAN Span = { 0 };
+
+            for (INT32 Left = Area.left; GetNextRegionSpan(&Annotation->Region, Row, Left, Area.right, &Span); Left = Span.Right)
+            {
+                if (Annotation->Patch != NULL)
+                {
+                    CopyMemory(&Pixels[Span.Left], &Annotation->Patch[(SIZE_T)(Row - Annotation->Bounds.top) * PatchWidth + (Span.Left - Annotation->Bounds.left)], (SIZE_T)(Span.Right - Span.Left) * sizeof(UINT32));
+                }
+                else
+                {
+                    FillSpan(&Pixels[Span.Left], (UINT32)(Span.Right - Span.Left), Annotation->Color);
+                }
+            }
+        }
+    }
+    else if (Annotation->Type == ANNOTATION_PEN)
+    {
+        RECT Damage = { 0 };
+
+        for (UINT32 Index = 0; Index < Annotation->PenPointCount; Index++)
+        {
+            DrawPenSegment(Document, Annotation, Index, &Area, &Damage);
+        }
+
+        ClearStrokeCoverage(Document, &Area);
+    }
+    else if (Annotation->Type == ANNOTATION_BOX || Annotation->Type == ANNOTATION_ARROW || Annotation->Type == ANNOTATION_SPOTLIGHT || Annotation->Type == ANNOTATION_CALLOUT)
+    {
+        RASTERTARGET Target = { 0 };
+
+        Target.Pixels = &Document->Raster[(SIZE_T)Area.top * Document->Width + Area.left];
+
+        Target.Stride = Document->Width;
+
+        Target.Bounds = Area;
+
+        if (Annotation->Type == ANNOTATION_SPOTLIGHT)
+        {
+            DrawSpotlight(&Target, Annotation);
+        }
+        else if (Annotation->Type == ANNOTATION_CALLOUT)
+        {
+            DrawCallout(&Target, Annotation, Annotation->Patch);
+        }
+        else
+        {
+            DrawBoxOrArrow(&Target, Annotation);
+        }
+    }
+    else if (Document->Render != NULL)
+    {
+        Document->Render(Annotation, &Area, Document->RenderContext);
+    }
+}
+
+
+void RedrawDocument(_Inout_ DOCUMENT* Document, _In_ const RECT* Area)
+{
+    RECT Snip = { 0, 0, Document->Width, Document->Height };
+
+    RECT Redraw = { 0 };
+
+    if (IntersectRect(&Redraw, Area, &Snip) == FALSE)
+    {
+        return;
+    }
+
+    for (INT32 Row = Redraw.top; Row < Redraw.bottom; Row++)
+    {
+        SIZE_T Offset = (SIZE_T)Row * Document->Width + Redraw.left;
+
+        CopyMemory(&Document->Raster[Offset], &Document->Base[Offset], (SIZE_T)(Redraw.right - Redraw.left) * sizeof(UINT32));
+    }
+
+    // The hilight strokes that overlap the area are about to hilight it again from scratch.
+    ClearCoverage(&Document->Coverage, &Redraw);
+
+    for (UINT32 Index = 0; Index < Document->Count; Index++)
+    {
+        DrawAnnotation(Document, Document->Annotations[Index], &Redraw);
+    }
+}
+
+
+BOOL UndoDocumentStep(_Inout_ DOCUMENT* Document, _Out_ RECT* Damage)
+{
+    SetRectEmpty(Damage);
+
+    if (Document->Count == 0)
+    {
+        return FALSE;
+    }
+
+    UINT32 Step = Document->Annotations[Document->Count - 1]->Step;
+
+    while (Document->Count > 0 && Document->Annotations[Document->Count - 1]->Step == Step)
+    {
+        ANNOTATION* Annotation = Document->Annotations[--Document->Count];
+
+        UnionRect(Damage, Damage, &Annotation->Bounds);
+
+        // If there's no room to keep it for redo, it just can't be redone.
+        if (GrowAnnotationList(&Document->Redo, Document->RedoCount, &Document->RedoCapacity))
+        {
+            Document->Redo[Document->RedoCount++] = Annotation;
+        }
+        else
+        {
+            FreeAnnotation(Annotation);
+        }
+    }
+
+    // Copying back the tiles that the step drew on puts back exactly what was there before it, but if they
+    // didn't all fit in the journal, what was there has to be worked out again from the base.
+    if (RestoreJournalStep(&Document->Journal, Step, Document->Raster, &Document->Coverage) == FALSE)
+    {
+        RedrawDocument(Document, Damage);
+    }
+
+    RecordChange(Document, SESSIONRECORD_UNDO);
+
+    return TRUE;
+}
+
+
+BOOL RedoDocumentStep(_Inout_ DOCUMENT* Document, _Out_ RECT* Damage)
+{
+    SetRectEmpty(Damage);
+
+    if (Document->RedoCount == 0)
+    {
+        return FALSE;
+    }
+
+    UINT32 Step = Document->Redo[Document->RedoCount - 1]->Step;
+
+    BOOL Redone = FALSE;
+
+    // Undo put them on the redo list top first, so they come back off of it in the order that they were drawn.
+    while (Document->RedoCount > 0 && Document->Redo[Document->RedoCount - 1]->Step == Step)
+    {
+        if (GrowAnnotationList(&Document->Annotations, Document->Count, &Document->Capacity) == FALSE)
+        {
+            break;
+        }
+
+        ANNOTATION* Annotation = Document->Redo[--Document->RedoCount];
+
+        Document->Annotations[Document->Count++] = Annotation;
+
+        // The raster under it is just as it was when it was first drawn, so drawing it again on top gives the same pixels.
+        SaveTiles(Document, Annotation, &Annotation->Bounds);
+
+        DrawAnnotation(Document, Annotation, &Annotation->Bounds);
+
+        UnionRect(Damage, Damage, &Annotation->Bounds);
+
+        Redone = TRUE;
+    }
+
+    if (Redone)
+    {
+        RecordChange(Document, SESSIONRECORD_REDO);
+    }
+
+    return Redone;
+}
+
+
+UINT32 ReplayDocumentSession(_Inout_ DOCUMENT* Document, _Inout_ SESSIONREADER* Reader)
+{
+    UINT32 Replayed = 0;
+
+    UINT32 Type = 0;
+
+    SESSIONCURSOR Payload = { 0 };
+
+    RECT Damage = { 0 };
+
+    // Annotations that were recorded one after another with the same step were added as one change. An undo or
+    // a redo in between means that the next annotation starts a new one, even if the step number came back.
+    UINT32 LastStep = 0;
+
+    BOOL InStep = FALSE;
+
+    while (ReadSessionRecord(Reader, &Type, &Payload))
+    {
+        if (Type == SESSIONRECORD_ANNOTATION)
+        {
+            UINT32 Step = 0;
+
+            ANNOTATION* Annotation = ReadAnnotation(Document, &Payload, &Step);
+
+            if (Annotation == NULL)
+            {
+                break;
+            }
+
+            if (InStep == FALSE || Step != LastStep)
+            {
+                BeginDocumentStep(Document);
+            }
+
+            LastStep = Step;
+
+            InStep = TRUE;
+
+            if (PushAnnotation(Document, Annotation) == FALSE)
+            {
+                FreeAnnotation(Annotation);
+
+                break;
+            }
+
+            SaveTiles(Document, Annotation, &Annotation->Bounds);
+
+            DrawAnnotation(Document, Annotation, &Annotation->Bounds);
+
+            RecordAnnotation(Document, Annotation);
+        }
+        else if (Type == SESSIONRECORD_UNDO)
+        {
+            UndoDocumentStep(Document, &Damage);
+
+            InStep = FALSE;
+        }
+        else if (Type == SESSIONRECORD_REDO)
+        {
+            RedoDocumentStep(Document, &Damage);
+
+            InStep = FALSE;
+        }
+        else
+        {
+            break;
+        }
+
+        Replayed++;
+    }
+
+    return Replayed;
+}
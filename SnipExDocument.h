@@ -0,0 +1,273 @@
+// SnipExDocument.h
+// Author: Joseph Ryan Ries, 2017-2020
+// The snip as a list of annotations (boxes, arrows, text, pen strokes, filled regions, spotlights, callouts and hilight, redact and eraser strokes) on top of the
+// untouched screenshot, plus a flattened copy with all of them drawn in. Undoing a change takes its
+// annotations off of the list and copies back the tiles of the flattened copy that they drew on, from the
+// journal, or if those are gone, redraws only the part of it that they covered. Undone changes can be redone
+// until something new is added.
+// Needs SnipExStroke.h, SnipExCoverage.h, SnipExBlend.h, SnipExRaster.h, SnipExBrush.h, SnipExFlood.h, SnipExJournal.h and SnipExSession.h to be included first.
+
+#pragma once
+
+// How far a callout's magnified copy is put from the rectangle that it magnifies, in pixels.
+#define CALLOUT_GAP      24
+
+// If a callout's magnified copy doesn't fit in the snip, smaller zooms are tried, down to this one.
+#define CALLOUT_MIN_ZOOM 2
+
+typedef enum ANNOTATIONTYPE
+{
+    ANNOTATION_BOX,
+
+    ANNOTATION_ARROW,
+
+    ANNOTATION_HILIGHT,
+
+    ANNOTATION_REDACT,
+
+    ANNOTATION_TEXT,
+
+    ANNOTATION_PEN,
+
+    // Puts the snip back the way it was taken under the brush, over whatever was drawn there before it.
+    ANNOTATION_ERASE,
+
+    // An area of similar color, found with FloodFillRegion, filled with a color or redacted.
+    ANNOTATION_REGION,
+
+    // Dims everything outside of the rectangle from Start to End.
+    ANNOTATION_SPOTLIGHT,
+
+    // A magnified copy of a small part of the snip, framed, and joined to the part it magnifies by two lines.
+    ANNOTATION_CALLOUT
+
+} ANNOTATIONTYPE;
+
+typedef struct ANNOTATION
+{
+    ANNOTATIONTYPE Type;
+
+    // Annotations that were added as part of the same change, such as a redact stroke and the copies of it
+    // that RedactEveryOccurrence makes, share a step and are undone together.
+    UINT32    Step;
+
+    // Every pixel that the annotation draws on, in snip coordinates, clipped to the snip. Nothing outside of
+    // this rectangle is ever drawn, even if the geometry would reach further. Right and bottom are exclusive.
+    RECT      Bounds;
+
+    // 0xAARRGGBB. The hilight color for the hilighter, and the pen or text color for everything else. For a
+    // spotlight, the color that the outside is blended toward, and its alpha is how far.
+    UINT32    Color;
+
+    // The two ends of a box or an arrow, two opposite corners of a spotlight, or where the text goes. For a
+    // callout, the top-left and bottom-right pixels of the rectangle that it magnifies.
+    POINT     Start;
+
+    POINT     End;
+
+    // Where a callout puts its magnified copy. Right and bottom are exclusive.
+    RECT      Inset;
+
+    // The top-left corner of the brush at each mouse sample of a hilight, redact or eraser stroke.
+    POINT*    Points;
+
+    UINT32    PointCount;
+
+    UINT32    PointCapacity;
+
+    INT32     BrushWidth;
+
+    INT32     BrushHeight;
+
+    // The shape of the brush of a hilight, redact or eraser stroke, inside its BrushWidth x BrushHeight rectangle.
+    BRUSHTIP  BrushTip;
+
+    // The smoothed points of a pen stroke, in pixels.
+    RASTERPOINT* PenPoints;
+
+    UINT32    PenPointCount;
+
+    UINT32    PenPointCapacity;
+
+    // How wide the outline of a box, the line of an arrow or a pen stroke is, in pixels.
+    INT32     PenWidth;
+
+    BLENDMODE BlendMode;
+
+    // The pixelated or blurred pixels that a redact stroke or a redacted region copies from, one for each
+    // pixel in Bounds. NULL if the stroke blacks out, or the region is filled with Color, instead. For a
+    // callout, its magnified copy, one for each pixel in Inset.
+    UINT32*   Patch;
+
+    // Which pixels a filled or redacted region covers. Its bounds are the annotation's bounds.
+    FLOODREGION Region;
+
+    // The text, and whatever the renderer needs to know about the font it is drawn with.
+    wchar_t*  Text;
+
+    void*     Font;
+
+    UINT32    FontSize;
+
+} ANNOTATION;
+
+// Text is drawn by whoever owns the document, since it needs the platform's font rendering. The renderer
+// must draw Annotation into the document's raster, clipped to Clip, and must have finished with the raster's
+// pixels by the time it returns.
+typedef void (*RENDERFUNCTION)(_In_ const ANNOTATION* Annotation, _In_ const RECT* Clip, _In_opt_ void* Context);
+
+typedef struct DOCUMENT
+{
+    INT32          Width;
+
+    INT32          Height;
+
+    // The snip exactly as it was taken. Never changes.
+    UINT32*        Base;
+
+    // Base with every annotation drawn in, top-down, 32bpp. Owned by the caller.
+    UINT32*        Raster;
+
+    // Which pixels of Raster the hilighter has already darkened.
+    COVERAGE       Coverage;
+
+    // How much of each pixel of Raster the pen or brush stroke that is being drawn has covered so far, so that
+    // the round ends of pen segments and the stamps of a brush don't draw twice where they overlap. All 0
+    // whenever no stroke is being drawn.
+    UINT8*         StrokeCoverage;
+
+    // Bottom to top.
+    ANNOTATION**   Annotations;
+
+    UINT32         Count;
+
+    UINT32         Capacity;
+
+    UINT32         Step;
+
+    // The annotations of the changes that were undone, the most recently undone on top, so that they can be
+    // redone. Anything new being added throws them away.
+    ANNOTATION**   Redo;
+
+    UINT32         RedoCount;
+
+    UINT32         RedoCapacity;
+
+    // The tiles of Raster and Coverage that the most recent changes drew on, as they were before.
+    JOURNAL        Journal;
+
+    // Where every finished annotation, undo and redo is written as it happens, so that the snip can be put back
+    // together if SnipEx doesn't close cleanly. Set and owned by the caller. NULL if there isn't one.
+    SESSION*       Session;
+
+    RENDERFUNCTION Render;
+
+    void*          RenderContext;
+
+} DOCUMENT;
+
+
+// Starts an empty document over Raster, which must already hold the snip. Up to JournalBudget bytes of tiles are
+// kept to make undo fast. Returns FALSE if memory could not be allocated.
+BOOL InitializeDocument(_Out_ DOCUMENT* Document, _In_ UINT32* Raster, _In_ INT32 Width, _In_ INT32 Height, _In_ SIZE_T JournalBudget, _In_ RENDERFUNCTION Render, _In_opt_ void* RenderContext);
+
+// Frees the base, every annotation, including the undone ones, and the journal. The raster is left alone.
+void FreeDocument(_Inout_ DOCUMENT* Document);
+
+// Everything added from now until the next call is one change, as far as undo is concerned.
+void BeginDocumentStep(_Inout_ DOCUMENT* Document);
+
+// Adds a box, arrow or text annotation to the top of the document and draws it. Text and Font are copied.
+// Returns the stored annotation, or NULL if memory could not be allocated.
+ANNOTATION* AddAnnotation(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Annotation);
+
+// Starts a hilight, redact or eraser stroke with the top-left corner of a BrushWidth x BrushHeight brush with the
+// given tip at Point. Nothing is drawn until the stroke is extended with AddStrokePoint. Returns NULL if memory
+// could not be allocated.
+ANNOTATION* BeginStroke(_Inout_ DOCUMENT* Document, _In_ ANNOTATIONTYPE Type, _In_ POINT Point, _In_ BRUSHTIP BrushTip, _In_ INT32 BrushWidth, _In_ INT32 BrushHeight, _In_ UINT32 Color, _In_ BLENDMODE BlendMode);
+
+// Draws the stroke from its last point to Point and adds Point to it. A redact stroke copies from Source,
+// a pixelated or blurred copy of the whole raster, or blacks out if Source is NULL. An eraser stroke copies
+// from the base, and Source is ignored. Damage receives the
+// pixels that were drawn on, and is empty if there were none. Returns FALSE if memory could not be allocated.
+BOOL AddStrokePoint(_Inout_ DOCUMENT* Document, _Inout_ ANNOTATION* Stroke, _In_ POINT Point, _In_opt_ const UINT32* Source, _Out_ RECT* Damage);
+
+// Finishes a stroke. A redact stroke keeps the part of Source that it needs, so Source can be freed
+// afterwards. A stroke that never drew anything is removed. Returns FALSE if it was removed.
+BOOL EndStroke(_Inout_ DOCUMENT* Document, _In_ ANNOTATION* Stroke, _In_opt_ const UINT32* Source);
+
+// Adds a copy of a finished stroke, moved by OffsetX, OffsetY, to the current step and draws it. The copy is
+// clipped to the stroke's bounds, moved the same way. Returns NULL if memory could not be allocated.
+ANNOTATION* AddTranslatedStroke(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Stroke, _In_ INT32 OffsetX, _In_ INT32 OffsetY, _In_opt_ const UINT32* Source);
+
+// Adds a region to the top of the document and draws it. The region is filled with Color, or if Source is
+// given, the region's pixels are copied from it, for redacting with a pixelated or blurred copy of the whole
+// raster. The document takes over Region's bits, and Region is left empty. Returns NULL if memory could not
+// be allocated, in which case Region is left alone.
+ANNOTATION* AddRegionAnnotation(_Inout_ DOCUMENT* Document, _Inout_ FLOODREGION* Region, _In_ UINT32 Color, _In_opt_ const UINT32* Source);
+
+// Starts a pen stroke PenWidth pixels wide and draws a dot at Point. Damage receives the pixels that were
+// drawn on. Returns NULL if memory could not be allocated.
+ANNOTATION* BeginPenStroke(_Inout_ DOCUMENT* Document, _In_ RASTERPOINT Point, _In_ INT32 PenWidth, _In_ UINT32 Color, _In_ BLENDMODE BlendMode, _Out_ RECT* Damage);
+
+// Draws the pen stroke on from its last point to Point and adds Point to it. Only the new segment is drawn,
+// however long the stroke already is. Damage receives the pixels that were drawn on. Returns FALSE if memory
+// could not be allocated.
+BOOL AddPenPoint(_Inout_ DOCUMENT* Document, _Inout_ ANNOTATION* Stroke, _In_ RASTERPOINT Point, _Out_ RECT* Damage);
+
+// Finishes a pen stroke. Its points are simplified to within Tolerance pixels, and it is redrawn from them,
+// so that the raster matches what undo will draw. Damage receives the part of the raster that was redrawn.
+void EndPenStroke(_Inout_ DOCUMENT* Document, _Inout_ ANNOTATION* Stroke, _In_ float Tolerance, _Out_ RECT* Damage);
+
+// Draws a box or an arrow annotation into Target, smoothed, with a pen PenWidth pixels wide.
+void DrawBoxOrArrow(_In_ const RASTERTARGET* Target, _In_ const ANNOTATION* Annotation);
+
+// Gets every pixel that DrawBoxOrArrow could draw on, before clipping.
+void GetBoxOrArrowBounds(_In_ const ANNOTATION* Annotation, _Out_ RECT* Bounds);
+
+// Gets the parts of Area that a spotlight dims: up to four strips above, below, left and right of its
+// rectangle, which don't overlap. Returns how many there are.
+UINT32 GetSpotlightStrips(_In_ const ANNOTATION* Annotation, _In_ const RECT* Area, _Out_writes_(4) RECT* Strips);
+
+// Dims everything outside of a spotlight's rectangle in Target. Only the dimmed pixels are touched.
+void DrawSpotlight(_In_ const RASTERTARGET* Target, _In_ const ANNOTATION* Annotation);
+
+// Gets the rectangle from Start to End, corners included, clipped to a Width x Height snip, for a callout to magnify.
+// Returns FALSE if none of it is in the snip.
+BOOL GetCalloutSource(_In_ POINT Start, _In_ POINT End, _In_ INT32 Width, _In_ INT32 Height, _Out_ RECT* Source);
+
+// Works out where a callout's copy of Source, magnified Zoom times, goes in a Width x Height snip: CALLOUT_GAP
+// pixels to the right of Source, or else to its left, below it or above it, wherever it first fits. If it
+// doesn't fit anywhere, smaller zooms are tried. Returns FALSE if it doesn't fit even at CALLOUT_MIN_ZOOM.
+BOOL GetCalloutInset(_In_ const RECT* Source, _In_ INT32 Zoom, _In_ INT32 Width, _In_ INT32 Height, _Out_ RECT* Inset);
+
+// Gets every pixel that DrawCallout could draw on, before clipping.
+void GetCalloutBounds(_In_ const ANNOTATION* Annotation, _Out_ RECT* Bounds);
+
+// Draws a callout into Target: its magnified copy from InsetPixels, which has one pixel for each pixel of the
+// callout's Inset, and then the lines and frames, PenWidth pixels wide. If InsetPixels is NULL, whatever is
+// already in Target under the inset is left there.
+void DrawCallout(_In_ const RASTERTARGET* Target, _In_ const ANNOTATION* Annotation, _In_opt_ const UINT32* InsetPixels);
+
+// Adds a callout to the top of the document and draws it. Its magnified copy is made from the raster as it
+// is now, with ResampleImage. Returns NULL if memory could not be allocated.
+ANNOTATION* AddCalloutAnnotation(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Callout);
+
+// Draws one annotation into the raster, clipped to Clip.
+void DrawAnnotation(_Inout_ DOCUMENT* Document, _In_ const ANNOTATION* Annotation, _In_ const RECT* Clip);
+
+// Rebuilds Area of the raster from the base and the annotations that overlap it.
+void RedrawDocument(_Inout_ DOCUMENT* Document, _In_ const RECT* Area);
+
+// Removes the annotations of the most recent change and puts back what they covered. Damage receives the
+// part of the raster that changed. Returns FALSE if there was nothing to undo.
+BOOL UndoDocumentStep(_Inout_ DOCUMENT* Document, _Out_ RECT* Damage);
+
+// Puts the annotations of the most recently undone change back on top and draws them again. Damage receives the
+// part of the raster that changed. Returns FALSE if there was nothing to redo, or memory could not be allocated.
+BOOL RedoDocumentStep(_Inout_ DOCUMENT* Document, _Out_ RECT* Damage);
+
+// Replays the changes that the reader's session recorded, after the snip itself, onto a new document over the same
+// snip: adds each annotation again, undoes and redoes. Stops at the first record that is damaged. If the document
+// has a session of its own, the changes are recorded again in it. Returns how many changes were replayed.
+UINT32 ReplayDocumentSession(_Inout_ DOCUMENT* Document, _Inout_ SESSIONREADER* Reader);
@@ -0,0 +1,466 @@
+// SnipExFilter.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Pixelate and blur filters for the redact tool. Both keep a running sum of each color channel, so every
+// pixel costs a couple of adds and a multiply no matter how big the block or the radius is. The running
+// sums are kept in one SSE2 or NEON register per pixel where we can, and the image is split into bands
+// that are filtered on as many threads as the machine has.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExBlend.h"
+
+#include "SnipExFilter.h"
+
+// The vertical blur passes walk down the image this many columns at a time, so that every cache line
+// that gets loaded is used all the way across.
+#define FILTER_COLUMN_CHUNK 64
+
+
+typedef struct FILTERJOB
+{
+    const UINT32* Source;
+
+    UINT32*       Destination;
+
+    UINT32*       Temp;
+
+    INT32         Width;
+
+    INT32         Height;
+
+    // The block size for PixelateImage, or the radius for BlurImage.
+    INT32         Size;
+
+    // The band of rows or columns that this job covers. Last is exclusive.
+    INT32         First;
+
+    INT32         Last;
+
+} FILTERJOB;
+
+typedef void (*FILTERBANDFUNCTION)(_In_ const FILTERJOB* Job);
+
+typedef struct FILTERTHREAD
+{
+    FILTERBANDFUNCTION Function;
+
+    FILTERJOB          Job;
+
+} FILTERTHREAD;
+
+
+// CHANNELSUMS holds a running total for each of the 4 channels of a pixel. All three versions of these
+// helpers do exactly the same math, including the float rounding, so every platform gets the same pixels.
+#if defined(_M_IX86) || defined(_M_X64)
+
+typedef __m128i CHANNELSUMS;
+
+static __forceinline CHANNELSUMS ZeroSums(void)
+{
+    return _mm_setzero_si128();
+}
+
+
+static __forceinline CHANNELSUMS WidenPixel(_In_ UINT32 Pixel)
+{
+    __m128i Zero = _mm_setzero_si128();
+
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)Pixel), Zero), Zero);
+}
+
+
+static __forceinline CHANNELSUMS AddSums(_In_ CHANNELSUMS A, _In_ CHANNELSUMS B)
+{
+    return _mm_add_epi32(A, B);
+}
+
+
+static __forceinline CHANNELSUMS SubtractSums(_In_ CHANNELSUMS A, _In_ CHANNELSUMS B)
+{
+    return _mm_sub_epi32(A, B);
+}
+
+
+// Multiplies each sum by Scale, rounds, and packs the 4 channels back into a pixel.
+static __forceinline UINT32 ScaleSums(_In_ CHANNELSUMS Sums, _In_ float Scale)
+{
+    __m128i Channels = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(Sums), _mm_set1_ps(Scale)), _mm_set1_ps(0.5f)));
+
+    Channels = _mm_packs_epi32(Channels, Channels);
+
+    return (UINT32)_mm_cvtsi128_si32(_mm_packus_epi16(Channels, Channels));
+}
+
+#elif defined(_M_ARM64)
+
+typedef uint32x4_t CHANNELSUMS;
+
+static __forceinline CHANNELSUMS ZeroSums(void)
+{
+    return vdupq_n_u32(0);
+}
+
+
+static __forceinline CHANNELSUMS WidenPixel(_In_ UINT32 Pixel)
+{
+    return vmovl_u16(vget_low_u16(vmovl_u8(vcreate_u8(Pixel))));
+}
+
+
+static __forceinline CHANNELSUMS AddSums(_In_ CHANNELSUMS A, _In_ CHANNELSUMS B)
+{
+    return vaddq_u32(A, B);
+}
+
+
+static __forceinline CHANNELSUMS SubtractSums(_In_ CHANNELSUMS A, _In_ CHANNELSUMS B)
+{
+    return vsubq_u32(A, B);
+}
+
+
+static __forceinline UINT32 ScaleSums(_In_ CHANNELSUMS Sums, _In_ float Scale)
+{
+    uint32x4_t Channels = vcvtq_u32_f32(vaddq_f32(vmulq_f32(vcvtq_f32_u32(Sums), vdupq_n_f32(Scale)), vdupq_n_f32(0.5f)));
+
+    uint16x4_t Narrow = vmovn_u32(Channels);
+
+    return vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(Narrow, Narrow))), 0);
+}
+
+#else
+
+typedef struct CHANNELSUMS
+{
+    UINT32 Channel[4];
+
+} CHANNELSUMS;
+
+static __forceinline CHANNELSUMS ZeroSums(void)
+{
+    CHANNELSUMS Sums = { 0 };
+
+    return Sums;
+}
+
+
+static __forceinline CHANNELSUMS WidenPixel(_In_ UINT32 Pixel)
+{
+    CHANNELSUMS Sums = { { Pixel & 0xFF, (Pixel >> 8) & 0xFF, (Pixel >> 16) & 0xFF, Pixel >> 24 } };
+
+    return Sums;
+}
+
+
+static __forceinline CHANNELSUMS AddSums(_In_ CHANNELSUMS A, _In_ CHANNELSUMS B)
+{
+    for (UINT32 Channel = 0; Channel < 4; Channel++)
+    {
+        A.Channel[Channel] += B.Channel[Channel];
+    }
+
+    return A;
+}
+
+
+static __forceinline CHANNELSUMS SubtractSums(_In_ CHANNELSUMS A, _In_ CHANNELSUMS B)
+{
+    for (UINT32 Channel = 0; Channel < 4; Channel++)
+    {
+        A.Channel[Channel] -= B.Channel[Channel];
+    }
+
+    return A;
+}
+
+
+static __forceinline UINT32 ScaleSums(_In_ CHANNELSUMS Sums, _In_ float Scale)
+{
+    UINT32 Pixel = 0;
+
+    for (UINT32 Channel = 0; Channel < 4; Channel++)
+    {
+        Pixel |= (UINT32)((float)Sums.Channel[Channel] * Scale + 0.5f) << (Channel * 8);
+    }
+
+    return Pixel;
+}
+
+#endif
+
+
+static DWORD WINAPI FilterThreadProc(_In_ LPVOID Parameter)
+{
+    FILTERTHREAD* Thread = (FILTERTHREAD*)Parameter;
+
+    Thread->Function(&Thread->Job);
+
+    return 0;
+}
+
+
+// Splits Count rows or columns into bands that are a multiple of Alignment long, and runs Function on each
+// band on its own thread. One of the bands runs on the calling thread. Returns once every band is finished.
+static void RunFilterBands(_In_ FILTERBANDFUNCTION Function, _In_ const FILTERJOB* Job, _In_ INT32 Count, _In_ INT32 Alignment)
+{
+    SYSTEM_INFO SystemInfo = { 0 };
+
+    GetSystemInfo(&SystemInfo);
+
+    SIZE_T ThreadCount = min(SystemInfo.dwNumberOfProcessors, FILTER_MAX_THREADS);
+
+    ThreadCount = min(ThreadCount, ((SIZE_T)Job->Width * Job->Height) / FILTER_MIN_PIXELS_PER_THREAD);
+
+    ThreadCount = min(ThreadCount, ((SIZE_T)Count + Alignment - 1) / Alignment);
+
+    ThreadCount = max(ThreadCount, 1);
+
+    INT32 BandSize = (((Count + (INT32)ThreadCount - 1) / (INT32)ThreadCount + Alignment - 1) / Alignment) * Alignment;
+
+    FILTERTHREAD Threads[FILTER_MAX_THREADS];
+
+    HANDLE Handles[FILTER_MAX_THREADS] = { 0 };
+
+    DWORD HandleCount = 0;
+
+    for (INT32 Index = 0; Index < (INT32)ThreadCount; Index++)
+    {
+        Threads[Index].Function = Function;
+
+        Threads[Index].Job = *Job;
+
+        Threads[Index].Job.First = min(Index * BandSize, Count);
+
+        Threads[Index].Job.Last = min((Index + 1) * BandSize, Count);
+    }
+
+    for (INT32 Index = 1; Index < (INT32)ThreadCount; Index++)
+    {
+        HANDLE Thread = CreateThread(NULL, 0, FilterThreadProc, &Threads[Index], 0, NULL);
+
+        if (Thread == NULL)
+        {
+            // Still get the work done, just not in parallel.
+            Function(&Threads[Index].Job);
+        }
+        else
+        {
+            Handles[HandleCount++] = Thread;
+        }
+    }
+
+    Function(&Threads[0].Job);
+
+    if (HandleCount > 0)
+    {
+        WaitForMultipleObjects(HandleCount, Handles, TRUE, INFINITE);
+
+        for (DWORD Index = 0; Index < HandleCount; Index++)
+        {
+            CloseHandle(Handles[Index]);
+        }
+    }
+}
+
+
+static void PixelateBand(_In_ const FILTERJOB* Job)
+{
+    INT32 BlockSize = Job->Size;
+
+    for (INT32 Top = Job->First; Top < Job->Last; Top += BlockSize)
+    {
+        INT32 Bottom = min(Top + BlockSize, Job->Height);
+
+        for (INT32 Left = 0; Left < Job->Width; Left += BlockSize)
+        {
+            INT32 Right = min(Left + BlockSize, Job->Width);
+
+            CHANNELSUMS Sums = ZeroSums();
+
+            for (INT32 Y = Top; Y < Bottom; Y++)
+            {
+                const UINT32* Row = &Job->Source[(SIZE_T)Y * Job->Width];
+
+                for (INT32 X = Left; X < Right; X++)
+                {
+                    Sums = AddSums(Sums, WidenPixel(Row[X]));
+                }
+            }
+
+            UINT32 Average = ScaleSums(Sums, 1.0f / (float)((Bottom - Top) * (Right - Left)));
+
+            for (INT32 Y = Top; Y < Bottom; Y++)
+            {
+                FillSpan(&Job->Destination[(SIZE_T)Y * Job->Width + Left], (UINT32)(Right - Left), Average);
+            }
+        }
+    }
+}
+
+
+void PixelateImage(_In_reads_(Width * Height) const UINT32* Source, _Out_writes_(Width * Height) UINT32* Destination, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 BlockSize)
+{
+    FILTERJOB Job = { 0 };
+
+    Job.Source = Source;
+
+    Job.Destination = Destination;
+
+    Job.Width = Width;
+
+    Job.Height = Height;
+
+    Job.Size = min(max(BlockSize, 1), FILTER_MAX_BLOCK_SIZE);
+
+    // Each block only reads its own pixels, so bands of whole blocks can be done in any order, even in place.
+    RunFilterBands(PixelateBand, &Job, Height, Job.Size);
+}
+
+
+void BoxBlurLine(_In_ const UINT32* Source, _Out_ UINT32* Destination, _In_ INT32 Count, _In_ SIZE_T Stride, _In_ INT32 Radius)
+{
+    float Scale = 1.0f / (float)(2 * Radius + 1);
+
+    CHANNELSUMS Sums = ZeroSums();
+
+    // Start with the box centered on the first pixel. The part of the box past the edge is the edge pixel repeated.
+    for (INT32 Index = -Radius; Index <= Radius; Index++)
+    {
+        Sums = AddSums(Sums, WidenPixel(Source[(SIZE_T)min(max(Index, 0), Count - 1) * Stride]));
+    }
+
+    for (INT32 Index = 0; Index < Count; Index++)
+    {
+        Destination[(SIZE_T)Index * Stride] = ScaleSums(Sums, Scale);
+
+        // Slide the box one pixel along.
+        Sums = AddSums(Sums, WidenPixel(Source[(SIZE_T)min(Index + Radius + 1, Count - 1) * Stride]));
+
+        Sums = SubtractSums(Sums, WidenPixel(Source[(SIZE_T)max(Index - Radius, 0) * Stride]));
+    }
+}
+
+
+// The same as calling BoxBlurLine on columns Left through Right - 1, but it walks across the rows instead
+// of down the columns. Right - Left must be no more than FILTER_COLUMN_CHUNK.
+static void BoxBlurColumns(_In_ const UINT32* Source, _Out_ UINT32* Destination, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Left, _In_ INT32 Right, _In_ INT32 Radius)
+{
+    float Scale = 1.0f / (float)(2 * Radius + 1);
+
+    CHANNELSUMS Sums[FILTER_COLUMN_CHUNK];
+
+    INT32 Columns = Right - Left;
+
+    for (INT32 Column = 0; Column < Columns; Column++)
+    {
+        Sums[Column] = ZeroSums();
+    }
+
+    for (INT32 Index = -Radius; Index <= Radius; Index++)
+    {
+        const UINT32* Row = &Source[(SIZE_T)min(max(Index, 0), Height - 1) * Width + Left];
+
+        for (INT32 Column = 0; Column < Columns; Column++)
+        {
+            Sums[Column] = AddSums(Sums[Column], WidenPixel(Row[Column]));
+        }
+    }
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        UINT32* Output = &Destination[(SIZE_T)Y * Width + Left];
+
+        const UINT32* Incoming = &Source[(SIZE_T)min(Y + Radius + 1, Height - 1) * Width + Left];
+
+        const UINT32* Outgoing = &Source[(SIZE_T)max(Y - Radius, 0) * Width + Left];
+
+        for (INT32 Column = 0; Column < Columns; Column++)
+        {
+            Output[Column] = ScaleSums(Sums[Column], Scale);
+
+            Sums[Column] = SubtractSums(AddSums(Sums[Column], WidenPixel(Incoming[Column])), WidenPixel(Outgoing[Column]));
+        }
+    }
+}
+
+
+// The three horizontal passes, Source -> Temp -> Destination -> Temp, on rows First through Last - 1.
+static void BlurRowsBand(_In_ const FILTERJOB* Job)
+{
+    for (INT32 Y = Job->First; Y < Job->Last; Y++)
+    {
+        SIZE_T Row = (SIZE_T)Y * Job->Width;
+
+        BoxBlurLine(&Job->Source[Row], &Job->Temp[Row], Job->Width, 1, Job->Size);
+
+        BoxBlurLine(&Job->Temp[Row], &Job->Destination[Row], Job->Width, 1, Job->Size);
+
+        BoxBlurLine(&Job->Destination[Row], &Job->Temp[Row], Job->Width, 1, Job->Size);
+    }
+}
+
+
+// The three vertical passes, Temp -> Destination -> Temp -> Destination, on columns First through Last - 1.
+static void BlurColumnsBand(_In_ const FILTERJOB* Job)
+{
+    for (INT32 Left = Job->First; Left < Job->Last; Left += FILTER_COLUMN_CHUNK)
+    {
+        INT32 Right = min(Left + FILTER_COLUMN_CHUNK, Job->Last);
+
+        BoxBlurColumns(Job->Temp, Job->Destination, Job->Width, Job->Height, Left, Right, Job->Size);
+
+        BoxBlurColumns(Job->Destination, Job->Temp, Job->Width, Job->Height, Left, Right, Job->Size);
+
+        BoxBlurColumns(Job->Temp, Job->Destination, Job->Width, Job->Height, Left, Right, Job->Size);
+    }
+}
+
+
+BOOL BlurImage(_In_reads_(Width * Height) const UINT32* Source, _Out_writes_(Width * Height) UINT32* Destination, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Radius)
+{
+    FILTERJOB Job = { 0 };
+
+    Job.Temp = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    if (Job.Temp == NULL)
+    {
+        return FALSE;
+    }
+
+    Job.Source = Source;
+
+    Job.Destination = Destination;
+
+    Job.Width = Width;
+
+    Job.Height = Height;
+
+    Job.Size = min(max(Radius, 0), FILTER_MAX_RADIUS);
+
+    RunFilterBands(BlurRowsBand, &Job, Height, 1);
+
+    // Bands are a multiple of 16 columns (64 bytes) wide, so that threads seldom write to the same cache line.
+    RunFilterBands(BlurColumnsBand, &Job, Width, 16);
+
+    HeapFree(GetProcessHeap(), 0, Job.Temp);
+
+    return TRUE;
+}
@@ -0,0 +1,34 @@
+// SnipExFilter.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Whole-image filters for the pixelate and blur redaction modes. Both cost the same per pixel no matter
+// how big the blocks or the blur radius are, so that they stay fast enough to use on 4K and multi-monitor snips.
+
+#pragma once
+
+// Images smaller than this many pixels are filtered on the calling thread, since starting threads would
+// take longer than the filter itself.
+#define FILTER_MIN_PIXELS_PER_THREAD (256 * 1024)
+
+#define FILTER_MAX_THREADS           16
+
+// Bigger blocks would overflow the float math used to average them.
+#define FILTER_MAX_BLOCK_SIZE        256
+
+// The widest box that BlurImage accepts is (2 * FILTER_MAX_RADIUS) + 1 pixels.
+#define FILTER_MAX_RADIUS            255
+
+
+// Replaces every BlockSize x BlockSize block of a 32bpp image with the average color of that block. Blocks
+// line up with the top-left corner of the image, so filtering the same image twice gives the same mosaic.
+// Blocks along the right and bottom edges may be smaller. Source and Destination may be the same buffer.
+void PixelateImage(_In_reads_(Width * Height) const UINT32* Source, _Out_writes_(Width * Height) UINT32* Destination, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 BlockSize);
+
+// Blurs a 32bpp image with three passes of a (2 * Radius) + 1 box in each direction, which is very close to a
+// Gaussian blur with a sigma of sqrt(Radius * (Radius + 1)). Pixels past the edges count as copies of the
+// edge pixels. Source and Destination must not overlap. Returns FALSE if memory could not be allocated.
+BOOL BlurImage(_In_reads_(Width * Height) const UINT32* Source, _Out_writes_(Width * Height) UINT32* Destination, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Radius);
+
+// One box blur pass along a row or a column of Count pixels. Stride is the distance from one pixel to the
+// next, in pixels. BlurImage gives exactly the same results as calling this three times on every row and then
+// three times on every column, it just goes about it in a more cache friendly order.
+void BoxBlurLine(_In_ const UINT32* Source, _Out_ UINT32* Destination, _In_ INT32 Count, _In_ SIZE_T Stride, _In_ INT32 Radius);
@@ -0,0 +1,580 @@
+// SnipExFlood.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Scanline flood fill. The fill keeps two bitmaps the size of the snip: which pixels match the color that
+// was clicked on, worked out the first time the fill reaches each row, and which pixels have been filled.
+// Pixels that match but aren't filled yet are found 64 at a time with bit scans. Each run that gets filled
+// goes on a list, and when it comes off of the list the rows above and below it are searched for more.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <intrin.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExStroke.h"
+
+#include "SnipExFlood.h"
+
+typedef struct FLOODFILL
+{
+    const UINT32* Pixels;
+
+    INT32         Width;
+
+    INT32         Height;
+
+    UINT32        Color;
+
+    UINT8         Tolerance;
+
+    // How far past the ends of a run to look in the rows above and below it. 1 to fill diagonally.
+    INT32         Reach;
+
+    UINT32        WordsPerRow;
+
+    UINT64*       Match;
+
+    UINT64*       Filled;
+
+    // Whether each row of Match has been worked out yet.
+    UINT8*        RowReady;
+
+    // Filled runs whose neighbors still have to be looked at.
+    SPAN*         Spans;
+
+    UINT32        SpanCount;
+
+    // Runs were dropped because Spans was full.
+    BOOL          Overflowed;
+
+    RECT          Bounds;
+
+    UINT64        PixelCount;
+
+} FLOODFILL;
+
+
+// The index of the lowest set bit. Bits must not be 0. Done in halves, since 32-bit x86 has no 64-bit bit scan.
+static __forceinline INT32 GetLowestBit(_In_ UINT64 Bits)
+{
+    unsigned long Index = 0;
+
+    if ((UINT32)Bits != 0)
+    {
+        _BitScanForward(&Index, (UINT32)Bits);
+
+        return (INT32)Index;
+    }
+
+    _BitScanForward(&Index, (UINT32)(Bits >> 32));
+
+    return (INT32)Index + 32;
+}
+
+
+// The index of the highest set bit. Bits must not be 0.
+static __forceinline INT32 GetHighestBit(_In_ UINT64 Bits)
+{
+    unsigned long Index = 0;
+
+    if ((UINT32)(Bits >> 32) != 0)
+    {
+        _BitScanReverse(&Index, (UINT32)(Bits >> 32));
+
+        return (INT32)Index + 32;
+    }
+
+    _BitScanReverse(&Index, (UINT32)Bits);
+
+    return (INT32)Index;
+}
+
+
+// Finds the first bit from From up to To that is Value, where a bit is set if it is set in Row and clear in
+// Exclude, or just set in Row if Exclude is NULL. Returns To if there isn't one.
+static INT32 FindBit(_In_ const UINT64* Row, _In_opt_ const UINT64* Exclude, _In_ INT32 From, _In_ INT32 To, _In_ BOOL Value)
+{
+    while (From < To)
+    {
+        UINT32 Word = (UINT32)From >> 6;
+
+        UINT64 Bits = Row[Word] & ~((Exclude != NULL) ? Exclude[Word] : 0);
+
+        if (Value == FALSE)
+        {
+            Bits = ~Bits;
+        }
+
+        Bits &= ~0ULL << (From & 63);
+
+        if (Bits != 0)
+        {
+            return min((INT32)(Word * 64) + GetLowestBit(Bits), To);
+        }
+
+        From = (INT32)(Word + 1) * 64;
+    }
+
+    return To;
+}
+
+
+// Finds where the run of set bits that X is in begins, going left. Bits are counted the same way as in FindBit.
+static INT32 FindRunStart(_In_ const UINT64* Row, _In_opt_ const UINT64* Exclude, _In_ INT32 X)
+{
+    UINT32 Word = (UINT32)X >> 6;
+
+    // The clear bits at or to the left of X. When X is the last bit of its word, 2 << 63 wraps around to
+    // 0, and subtracting 1 leaves every bit.
+    UINT64 Clear = ~(Row[Word] & ~((Exclude != NULL) ? Exclude[Word] : 0)) & ((2ULL << (X & 63)) - 1);
+
+    while (Clear == 0)
+    {
+        if (Word == 0)
+        {
+            return 0;
+        }
+
+        Word--;
+
+        Clear = ~(Row[Word] & ~((Exclude != NULL) ? Exclude[Word] : 0));
+    }
+
+    return (INT32)(Word * 64) + GetHighestBit(Clear) + 1;
+}
+
+
+// Sets bits Left through Right - 1 of Row.
+static void SetBits(_Inout_ UINT64* Row, _In_ INT32 Left, _In_ INT32 Right)
+{
+    UINT32 FirstWord = (UINT32)Left >> 6;
+
+    UINT32 LastWord = (UINT32)(Right - 1) >> 6;
+
+    UINT64 FirstMask = ~0ULL << (Left & 63);
+
+    UINT64 LastMask = ((Right & 63) == 0) ? ~0ULL : ((1ULL << (Right & 63)) - 1);
+
+    if (FirstWord == LastWord)
+    {
+        Row[FirstWord] |= FirstMask & LastMask;
+
+        return;
+    }
+
+    Row[FirstWord] |= FirstMask;
+
+    for (UINT32 Word = FirstWord + 1; Word < LastWord; Word++)
+    {
+        Row[Word] = ~0ULL;
+    }
+
+    Row[LastWord] |= LastMask;
+}
+
+
+void MatchColorRowScalar(_In_reads_(Count) const UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color, _In_ UINT8 Tolerance, _Out_writes_((Count + 63) / 64) UINT64* Bits)
+{
+    ZeroMemory(Bits, (SIZE_T)((Count + 63) / 64) * sizeof(UINT64));
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        BOOL Matches = TRUE;
+
+        for (UINT32 Channel = 0; Channel < 3; Channel++)
+        {
+            INT32 Difference = (INT32)((Pixels[Index] >> (Channel * 8)) & 0xFF) - (INT32)((Color >> (Channel * 8)) & 0xFF);
+
+            if (Difference > Tolerance || Difference < -(INT32)Tolerance)
+            {
+                Matches = FALSE;
+            }
+        }
+
+        if (Matches)
+        {
+            Bits[Index >> 6] |= 1ULL << (Index & 63);
+        }
+    }
+}
+
+
+void MatchColorRow(_In_reads_(Count) const UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color, _In_ UINT8 Tolerance, _Out_writes_((Count + 63) / 64) UINT64* Bits)
+{
+    UINT32 Index = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i ColorMask = _mm_set1_epi32(0x00FFFFFF);
+
+    __m128i Target = _mm_set1_epi32((int)(Color & 0x00FFFFFF));
+
+    __m128i Limit = _mm_set1_epi32((int)(Tolerance * 0x010101u));
+
+    __m128i Zero = _mm_setzero_si128();
+
+    // A whole word of bits, 4 pixels at a time.
+    for (; Index + 64 <= Count; Index += 64)
+    {
+        UINT64 Word = 0;
+
+        for (UINT32 Pixel = 0; Pixel < 64; Pixel += 4)
+        {
+            __m128i Source = _mm_and_si128(_mm_loadu_si128((const __m128i*)&Pixels[Index + Pixel]), ColorMask);
+
+            // Unsigned bytes have no absolute difference in SSE2, but one of the two saturating subtractions is always 0.
+            __m128i Difference = _mm_or_si128(_mm_subs_epu8(Source, Target), _mm_subs_epu8(Target, Source));
+
+            // Every channel is within the tolerance if nothing is left after taking the tolerance away.
+            __m128i Within = _mm_cmpeq_epi32(_mm_subs_epu8(Difference, Limit), Zero);
+
+            Word |= (UINT64)(UINT32)_mm_movemask_ps(_mm_castsi128_ps(Within)) << Pixel;
+        }
+
+        Bits[Index >> 6] = Word;
+    }
+#elif defined(_M_ARM64)
+    uint8x16_t ColorMask = vreinterpretq_u8_u32(vdupq_n_u32(0x00FFFFFF));
+
+    uint8x16_t Target = vreinterpretq_u8_u32(vdupq_n_u32(Color & 0x00FFFFFF));
+
+    uint8x16_t Limit = vreinterpretq_u8_u32(vdupq_n_u32(Tolerance * 0x010101u));
+
+    const uint32_t LaneBits[4] = { 1, 2, 4, 8 };
+
+    uint32x4_t Lanes = vld1q_u32(LaneBits);
+
+    for (; Index + 64 <= Count; Index += 64)
+    {
+        UINT64 Word = 0;
+
+        for (UINT32 Pixel = 0; Pixel < 64; Pixel += 4)
+        {
+            uint8x16_t Source = vandq_u8(vld1q_u8((const uint8_t*)&Pixels[Index + Pixel]), ColorMask);
+
+            // Alpha was masked off of both, so it is always within the tolerance, and a pixel matches when all 4 bytes do.
+            uint32x4_t Within = vceqq_u32(vreinterpretq_u32_u8(vcleq_u8(vabdq_u8(Source, Target), Limit)), vdupq_n_u32(0xFFFFFFFF));
+
+            Word |= (UINT64)vaddvq_u32(vandq_u32(Within, Lanes)) << Pixel;
+        }
+
+        Bits[Index >> 6] = Word;
+    }
+#endif
+
+    MatchColorRowScalar(&Pixels[Index], Count - Index, Color, Tolerance, &Bits[Index >> 6]);
+}
+
+
+static void PushSpan(_Inout_ FLOODFILL* Fill, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right)
+{
+    if (Fill->SpanCount == FLOOD_MAX_PENDING_SPANS)
+    {
+        Fill->Overflowed = TRUE;
+
+        return;
+    }
+
+    SPAN* Span = &Fill->Spans[Fill->SpanCount++];
+
+    Span->Y = Y;
+
+    Span->Left = Left;
+
+    Span->Right = Right;
+}
+
+
+static void FillRun(_Inout_ FLOODFILL* Fill, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right)
+{
+    SetBits(&Fill->Filled[(SIZE_T)Y * Fill->WordsPerRow], Left, Right);
+
+    Fill->Bounds.left = min(Fill->Bounds.left, Left);
+
+    Fill->Bounds.right = max(Fill->Bounds.right, Right);
+
+    Fill->Bounds.top = min(Fill->Bounds.top, Y);
+
+    Fill->Bounds.bottom = max(Fill->Bounds.bottom, Y + 1);
+
+    Fill->PixelCount += (UINT64)(Right - Left);
+
+    PushSpan(Fill, Y, Left, Right);
+}
+
+
+// Works out which pixels of row Y match, the first time the fill gets there.
+static void PrepareRow(_Inout_ FLOODFILL* Fill, _In_ INT32 Y)
+{
+    if (Fill->RowReady[Y] == FALSE)
+    {
+        MatchColorRow(&Fill->Pixels[(SIZE_T)Y * Fill->Width], (UINT32)Fill->Width, Fill->Color, Fill->Tolerance, &Fill->Match[(SIZE_T)Y * Fill->WordsPerRow]);
+
+        Fill->RowReady[Y] = TRUE;
+    }
+}
+
+
+// Fills every run on row Y that matches, isn't filled yet, and touches Left through Right - 1.
+static void FillNeighbors(_Inout_ FLOODFILL* Fill, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right)
+{
+    PrepareRow(Fill, Y);
+
+    const UINT64* Match = &Fill->Match[(SIZE_T)Y * Fill->WordsPerRow];
+
+    const UINT64* Filled = &Fill->Filled[(SIZE_T)Y * Fill->WordsPerRow];
+
+    INT32 X = FindBit(Match, Filled, Left, Right, TRUE);
+
+    while (X < Right)
+    {
+        INT32 RunLeft = FindRunStart(Match, Filled, X);
+
+        INT32 RunRight = FindBit(Match, Filled, X, Fill->Width, FALSE);
+
+        FillRun(Fill, Y, RunLeft, RunRight);
+
+        X = FindBit(Match, Filled, RunRight, Right, TRUE);
+    }
+}
+
+
+// Whether row Y has pixels that match and aren't filled yet anywhere from Left through Right - 1.
+static BOOL HasUnfilledNeighbors(_Inout_ FLOODFILL* Fill, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right)
+{
+    if (Y < 0 || Y >= Fill->Height)
+    {
+        return FALSE;
+    }
+
+    PrepareRow(Fill, Y);
+
+    return FindBit(&Fill->Match[(SIZE_T)Y * Fill->WordsPerRow], &Fill->Filled[(SIZE_T)Y * Fill->WordsPerRow], Left, Right, TRUE) < Right;
+}
+
+
+// Puts back the runs that were dropped when the list was full: every filled run that still has pixels
+// next to it that should be filled. Stops early if the list fills up again.
+static void SweepFilledRuns(_Inout_ FLOODFILL* Fill)
+{
+    for (INT32 Y = Fill->Bounds.top; Y < Fill->Bounds.bottom && Fill->Overflowed == FALSE; Y++)
+    {
+        const UINT64* Filled = &Fill->Filled[(SIZE_T)Y * Fill->WordsPerRow];
+
+        INT32 X = FindBit(Filled, NULL, Fill->Bounds.left, Fill->Bounds.right, TRUE);
+
+        while (X < Fill->Bounds.right)
+        {
+            INT32 RunRight = FindBit(Filled, NULL, X, Fill->Width, FALSE);
+
+            INT32 Left = max(X - Fill->Reach, 0);
+
+            INT32 Right = min(RunRight + Fill->Reach, Fill->Width);
+
+            if (HasUnfilledNeighbors(Fill, Y - 1, Left, Right) || HasUnfilledNeighbors(Fill, Y + 1, Left, Right))
+            {
+                PushSpan(Fill, Y, X, RunRight);
+            }
+
+            X = FindBit(Filled, NULL, RunRight, Fill->Bounds.right, TRUE);
+        }
+    }
+}
+
+
+static void FreeFloodFill(_Inout_ FLOODFILL* Fill)
+{
+    if (Fill->Match != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Fill->Match);
+    }
+
+    if (Fill->Filled != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Fill->Filled);
+    }
+
+    if (Fill->RowReady != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Fill->RowReady);
+    }
+
+    if (Fill->Spans != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Fill->Spans);
+    }
+}
+
+
+BOOL FloodFillRegion(
+    _In_reads_(Width * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ INT32 X,
+    _In_ INT32 Y,
+    _In_ UINT8 Tolerance,
+    _In_ BOOL Diagonal,
+    _Out_ FLOODREGION* Region)
+{
+    ZeroMemory(Region, sizeof(FLOODREGION));
+
+    if (X < 0 || Y < 0 || X >= Width || Y >= Height)
+    {
+        return FALSE;
+    }
+
+    FLOODFILL Fill = { 0 };
+
+    Fill.Pixels = Pixels;
+
+    Fill.Width = Width;
+
+    Fill.Height = Height;
+
+    Fill.Color = Pixels[(SIZE_T)Y * Width + X];
+
+    Fill.Tolerance = Tolerance;
+
+    Fill.Reach = Diagonal ? 1 : 0;
+
+    Fill.WordsPerRow = ((UINT32)Width + 63) / 64;
+
+    Fill.Match = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Fill.WordsPerRow * Height * sizeof(UINT64));
+
+    Fill.Filled = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)Fill.WordsPerRow * Height * sizeof(UINT64));
+
+    Fill.RowReady = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)Height);
+
+    Fill.Spans = HeapAlloc(GetProcessHeap(), 0, FLOOD_MAX_PENDING_SPANS * sizeof(SPAN));
+
+    if (Fill.Match == NULL || Fill.Filled == NULL || Fill.RowReady == NULL || Fill.Spans == NULL)
+    {
+        FreeFloodFill(&Fill);
+
+        return FALSE;
+    }
+
+    SetRect(&Fill.Bounds, X, Y, X + 1, Y + 1);
+
+    PrepareRow(&Fill, Y);
+
+    FillNeighbors(&Fill, Y, X, X + 1);
+
+    for (;;)
+    {
+        while (Fill.SpanCount > 0)
+        {
+            SPAN Span = Fill.Spans[--Fill.SpanCount];
+
+            INT32 Left = max(Span.Left - Fill.Reach, 0);
+
+            INT32 Right = min(Span.Right + Fill.Reach, Width);
+
+            if (Span.Y > 0)
+            {
+                FillNeighbors(&Fill, Span.Y - 1, Left, Right);
+            }
+
+            if (Span.Y + 1 < Height)
+            {
+                FillNeighbors(&Fill, Span.Y + 1, Left, Right);
+            }
+        }
+
+        if (Fill.Overflowed == FALSE)
+        {
+            break;
+        }
+
+        Fill.Overflowed = FALSE;
+
+        SweepFilledRuns(&Fill);
+    }
+
+    // Keep only the words of Filled that cover the region's bounds.
+    UINT32 FirstWord = (UINT32)Fill.Bounds.left >> 6;
+
+    Region->WordsPerRow = (((UINT32)Fill.Bounds.right - 1) >> 6) - FirstWord + 1;
+
+    Region->Bits = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Region->WordsPerRow * (Fill.Bounds.bottom - Fill.Bounds.top) * sizeof(UINT64));
+
+    if (Region->Bits == NULL)
+    {
+        FreeFloodFill(&Fill);
+
+        ZeroMemory(Region, sizeof(FLOODREGION));
+
+        return FALSE;
+    }
+
+    for (INT32 Row = Fill.Bounds.top; Row < Fill.Bounds.bottom; Row++)
+    {
+        CopyMemory(&Region->Bits[(SIZE_T)(Row - Fill.Bounds.top) * Region->WordsPerRow], &Fill.Filled[(SIZE_T)Row * Fill.WordsPerRow + FirstWord], Region->WordsPerRow * sizeof(UINT64));
+    }
+
+    Region->Bounds = Fill.Bounds;
+
+    Region->PixelCount = Fill.PixelCount;
+
+    FreeFloodFill(&Fill);
+
+    return TRUE;
+}
+
+
+void FreeFloodRegion(_Inout_ FLOODREGION* Region)
+{
+    if (Region->Bits != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Region->Bits);
+    }
+
+    ZeroMemory(Region, sizeof(FLOODREGION));
+}
+
+
+BOOL GetNextRegionSpan(_In_ const FLOODREGION* Region, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right, _Out_ SPAN* Span)
+{
+    Left = max(Left, Region->Bounds.left);
+
+    Right = min(Right, Region->Bounds.right);
+
+    if (Region->Bits == NULL || Y < Region->Bounds.top || Y >= Region->Bounds.bottom || Left >= Right)
+    {
+        return FALSE;
+    }
+
+    // Bit 0 of each row is pixel Origin.
+    INT32 Origin = Region->Bounds.left & ~63;
+
+    const UINT64* Row = &Region->Bits[(SIZE_T)(Y - Region->Bounds.top) * Region->WordsPerRow];
+
+    INT32 Start = FindBit(Row, NULL, Left - Origin, Right - Origin, TRUE);
+
+    if (Start == Right - Origin)
+    {
+        return FALSE;
+    }
+
+    Span->Y = Y;
+
+    Span->Left = Start + Origin;
+
+    Span->Right = FindBit(Row, NULL, Start, Right - Origin, FALSE) + Origin;
+
+    return TRUE;
+}
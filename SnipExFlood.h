@@ -0,0 +1,57 @@
+// SnipExFlood.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Finds the connected area of similar color around a pixel, such as a text box or a notification, so that
+// it can be filled or redacted in one click. Whole runs of pixels are filled a row at a time, and which
+// pixels match is worked out a row at a time with SIMD, one bit per pixel.
+// Needs SnipExStroke.h to be included first.
+
+#pragma once
+
+// The most runs of pixels that can be waiting to have the rows above and below them looked at. Any more
+// than this are dropped, and found again afterwards by sweeping over what has been filled so far, so a
+// snip full of twisty little passages can't make the list grow without limit.
+#define FLOOD_MAX_PENDING_SPANS 16384
+
+typedef struct FLOODREGION
+{
+    // The smallest rectangle around the region. Right and bottom are exclusive. Empty if there is no region.
+    RECT    Bounds;
+
+    UINT64  PixelCount;
+
+    // One bit for each pixel of Bounds that is in the region, Bounds.top first. Each row starts on its own
+    // 64-bit word, and its first word holds pixels (Bounds.left & ~63) through (Bounds.left | 63).
+    UINT64* Bits;
+
+    UINT32  WordsPerRow;
+
+} FLOODREGION;
+
+
+// Sets bit Index of Bits, counting from bit 0 of Bits[0], for each of Count pixels whose color channels
+// are each no more than Tolerance away from Color's. Alpha is ignored. Bits must have room for Count bits,
+// rounded up to a whole word, and the bits past Count are cleared.
+void MatchColorRow(_In_reads_(Count) const UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color, _In_ UINT8 Tolerance, _Out_writes_((Count + 63) / 64) UINT64* Bits);
+
+// The portable reference implementation of MatchColorRow.
+void MatchColorRowScalar(_In_reads_(Count) const UINT32* Pixels, _In_ UINT32 Count, _In_ UINT32 Color, _In_ UINT8 Tolerance, _Out_writes_((Count + 63) / 64) UINT64* Bits);
+
+// Finds every pixel that can be reached from X, Y through pixels within Tolerance of the color at X, Y,
+// moving up, down, left and right, and also diagonally if Diagonal is TRUE. Needs two bits of memory per
+// pixel of the image while it works, plus a fixed amount for the pending runs. Free the result with
+// FreeFloodRegion. Returns FALSE if X, Y is outside of the image or memory could not be allocated.
+BOOL FloodFillRegion(
+    _In_reads_(Width * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ INT32 X,
+    _In_ INT32 Y,
+    _In_ UINT8 Tolerance,
+    _In_ BOOL Diagonal,
+    _Out_ FLOODREGION* Region);
+
+void FreeFloodRegion(_Inout_ FLOODREGION* Region);
+
+// Gets the first run of the region on row Y that ends after Left, clipped to Left through Right. Returns
+// FALSE if there are no more.
+BOOL GetNextRegionSpan(_In_ const FLOODREGION* Region, _In_ INT32 Y, _In_ INT32 Left, _In_ INT32 Right, _Out_ SPAN* Span);
@@ -0,0 +1,826 @@
+// SnipExJournal.c
+// Author: Joseph Ryan Ries, 2017-2020
+// The tiles that recent changes drew on, as they were before, so that undoing a change only has to copy them back.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExCoverage.h"
+
+#include "SnipExCompress.h"
+
+#include "SnipExJournal.h"
+
+// The most that a tile takes up uncompressed: its pixels and its words of the coverage map.
+#define TILE_MAX_BYTES (JOURNAL_TILE_SIZE * JOURNAL_TILE_SIZE * sizeof(UINT32) + JOURNAL_TILE_SIZE * (JOURNAL_TILE_SIZE / 64) * sizeof(UINT64))
+
+// The scratch file is mapped this much to begin with, and twice as much each time it fills up.
+#define FILE_FIRST_MAPPING ((UINT64)64 * 1024 * 1024)
+
+
+// Gets the pixels that tile Index covers, cut short at the right and bottom edges of the snip.
+static void GetTileRect(_In_ const JOURNAL* Journal, _In_ UINT32 Index, _Out_ RECT* Rect)
+{
+    INT32 Left = (INT32)(Index % Journal->TilesAcross) * JOURNAL_TILE_SIZE;
+
+    INT32 Top = (INT32)(Index / Journal->TilesAcross) * JOURNAL_TILE_SIZE;
+
+    SetRect(Rect, Left, Top, min(Left + JOURNAL_TILE_SIZE, Journal->Width), min(Top + JOURNAL_TILE_SIZE, Journal->Height));
+}
+
+
+// Gets how many bytes a tile takes up uncompressed, and how many of those are its pixels.
+static SIZE_T GetTileBytes(_In_ const JOURNAL* Journal, _In_ const JOURNALTILE* Tile, _Out_ SIZE_T* PixelBytes)
+{
+    RECT Rect = { 0 };
+
+    GetTileRect(Journal, Tile->Index, &Rect);
+
+    SIZE_T Width = (SIZE_T)(Rect.right - Rect.left);
+
+    SIZE_T Height = (SIZE_T)(Rect.bottom - Rect.top);
+
+    *PixelBytes = Width * Height * sizeof(UINT32);
+
+    return *PixelBytes + (Tile->HasCoverage ? ((Width + 63) / 64) * Height * sizeof(UINT64) : 0);
+}
+
+
+static void FreeTile(_Inout_ JOURNAL* Journal, _Inout_ JOURNALTILE* Tile)
+{
+    if (Tile->Tier == JOURNALTIER_RAW)
+    {
+        // The coverage words are in the same allocation as the pixels.
+        HeapFree(GetProcessHeap(), 0, Tile->Pixels);
+    }
+    else if (Tile->Tier == JOURNALTIER_PACKED)
+    {
+        HeapFree(GetProcessHeap(), 0, Tile->Packed);
+    }
+    else if (--Journal->FileTiles == 0)
+    {
+        // Nothing in the scratch file is needed any more, so it can start over from the beginning.
+        Journal->FileUsed = 0;
+    }
+}
+
+
+static void FreeJournalStep(_Inout_ JOURNAL* Journal, _Inout_ JOURNALSTEP* Step)
+{
+    for (UINT32 Index = 0; Index < Step->Count; Index++)
+    {
+        FreeTile(Journal, &Step->Tiles[Index]);
+    }
+
+    if (Step->Tiles != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Step->Tiles);
+    }
+
+    Journal->Bytes -= Step->Bytes;
+
+    Step->Tiles = NULL;
+
+    Step->Count = 0;
+
+    Step->Capacity = 0;
+
+    Step->Packed = 0;
+
+    Step->Spilled = 0;
+
+    Step->Bytes = 0;
+}
+
+
+static void RemoveJournalStep(_Inout_ JOURNAL* Journal, _In_ UINT32 Index)
+{
+    FreeJournalStep(Journal, &Journal->Steps[Index]);
+
+    MoveMemory(&Journal->Steps[Index], &Journal->Steps[Index + 1], (Journal->Count - Index - 1) * sizeof(JOURNALSTEP));
+
+    Journal->Count--;
+}
+
+
+// Throws away the tiles of the oldest steps that still have any in memory until the journal is back within its
+// budget. Steps whose tiles are all in the scratch file are left alone, since they only take up the memory of
+// their list of tiles. If the newest step is the only one left and it's still over, it throws away its own tiles,
+// and keeps no more of them.
+static void TrimJournal(_Inout_ JOURNAL* Journal)
+{
+    UINT32 Oldest = 0;
+
+    while (Journal->Bytes > Journal->Budget)
+    {
+        while (Oldest + 1 < Journal->Count && Journal->Steps[Oldest].Spilled == Journal->Steps[Oldest].Count)
+        {
+            Oldest++;
+        }
+
+        if (Oldest + 1 >= Journal->Count)
+        {
+            break;
+        }
+
+        RemoveJournalStep(Journal, Oldest);
+    }
+
+    if (Journal->Bytes > Journal->Budget && Journal->Count > 0)
+    {
+        FreeJournalStep(Journal, &Journal->Steps[Journal->Count - 1]);
+
+        Journal->Steps[Journal->Count - 1].Incomplete = TRUE;
+    }
+}
+
+
+// Gets the step that is keeping tiles for Step, starting a new one if Step isn't the newest. Returns NULL if
+// memory could not be allocated.
+static JOURNALSTEP* GetJournalStep(_Inout_ JOURNAL* Journal, _In_ UINT32 Step)
+{
+    if (Journal->Count > 0 && Journal->Steps[Journal->Count - 1].Step == Step)
+    {
+        return &Journal->Steps[Journal->Count - 1];
+    }
+
+    if (Journal->Count == Journal->Capacity)
+    {
+        UINT32 Capacity = (Journal->Capacity == 0) ? 64 : Journal->Capacity * 2;
+
+        JOURNALSTEP* Steps = NULL;
+
+        if (Journal->Steps == NULL)
+        {
+            Steps = HeapAlloc(GetProcessHeap(), 0, Capacity * sizeof(JOURNALSTEP));
+        }
+        else
+        {
+            Steps = HeapReAlloc(GetProcessHeap(), 0, Journal->Steps, Capacity * sizeof(JOURNALSTEP));
+        }
+
+        if (Steps == NULL)
+        {
+            return NULL;
+        }
+
+        Journal->Steps = Steps;
+
+        Journal->Capacity = Capacity;
+    }
+
+    JOURNALSTEP* New = &Journal->Steps[Journal->Count++];
+
+    ZeroMemory(New, sizeof(JOURNALSTEP));
+
+    New->Step = Step;
+
+    New->Serial = ++Journal->Serial;
+
+    // A new step pushes an older one out of the newest few, so the worker may have a step's tiles to compress.
+    SetEvent(Journal->WorkEvent);
+
+    return New;
+}
+
+
+// Copies tile Index of Raster and Coverage into a new tile of Step. Returns FALSE if memory could not be allocated.
+static BOOL SaveTile(_Inout_ JOURNAL* Journal, _Inout_ JOURNALSTEP* Step, _In_ UINT32 Index, _In_ const UINT32* Raster, _In_ const COVERAGE* Coverage)
+{
+    if (Step->Count == Step->Capacity)
+    {
+        UINT32 Capacity = (Step->Capacity == 0) ? 16 : Step->Capacity * 2;
+
+        JOURNALTILE* Tiles = NULL;
+
+        if (Step->Tiles == NULL)
+        {
+            Tiles = HeapAlloc(GetProcessHeap(), 0, Capacity * sizeof(JOURNALTILE));
+        }
+        else
+        {
+            Tiles = HeapReAlloc(GetProcessHeap(), 0, Step->Tiles, Capacity * sizeof(JOURNALTILE));
+        }
+
+        if (Tiles == NULL)
+        {
+            return FALSE;
+        }
+
+        Journal->Bytes += (SIZE_T)(Capacity - Step->Capacity) * sizeof(JOURNALTILE);
+
+        Step->Bytes += (SIZE_T)(Capacity - Step->Capacity) * sizeof(JOURNALTILE);
+
+        Step->Tiles = Tiles;
+
+        Step->Capacity = Capacity;
+    }
+
+    JOURNALTILE* Tile = &Step->Tiles[Step->Count];
+
+    ZeroMemory(Tile, sizeof(JOURNALTILE));
+
+    Tile->Index = Index;
+
+    Tile->Tier = JOURNALTIER_RAW;
+
+    Tile->HasCoverage = (Coverage->Bits != NULL);
+
+    RECT Rect = { 0 };
+
+    GetTileRect(Journal, Index, &Rect);
+
+    INT32 Width = Rect.right - Rect.left;
+
+    INT32 Height = Rect.bottom - Rect.top;
+
+    UINT32 Words = ((UINT32)Width + 63) / 64;
+
+    SIZE_T PixelBytes = 0;
+
+    SIZE_T Bytes = GetTileBytes(Journal, Tile, &PixelBytes);
+
+    Tile->Pixels = HeapAlloc(GetProcessHeap(), 0, Bytes);
+
+    if (Tile->Pixels == NULL)
+    {
+        return FALSE;
+    }
+
+    Tile->Coverage = Tile->HasCoverage ? (UINT64*)((UINT8*)Tile->Pixels + PixelBytes) : NULL;
+
+    for (INT32 Row = 0; Row < Height; Row++)
+    {
+        CopyMemory(&Tile->Pixels[(SIZE_T)Row * Width], &Raster[(SIZE_T)(Rect.top + Row) * Journal->Width + Rect.left], (SIZE_T)Width * sizeof(UINT32));
+
+        if (Tile->HasCoverage)
+        {
+            CopyMemory(&Tile->Coverage[(SIZE_T)Row * Words], &Coverage->Bits[(SIZE_T)(Rect.top + Row) * Coverage->WordsPerRow + (UINT32)Rect.left / 64], Words * sizeof(UINT64));
+        }
+    }
+
+    Step->Count++;
+
+    Step->Bytes += Bytes;
+
+    Journal->Bytes += Bytes;
+
+    return TRUE;
+}
+
+
+// XORs the pixels of a raw tile with the base, which turns them into what a packed tile holds, or back again.
+static void XorTileWithBase(_In_ const JOURNAL* Journal, _In_ UINT32 Index, _Inout_ UINT32* Pixels)
+{
+    RECT Rect = { 0 };
+
+    GetTileRect(Journal, Index, &Rect);
+
+    INT32 Width = Rect.right - Rect.left;
+
+    for (INT32 Row = Rect.top; Row < Rect.bottom; Row++)
+    {
+        const UINT32* Base = &Journal->Base[(SIZE_T)Row * Journal->Width + Rect.left];
+
+        for (INT32 Column = 0; Column < Width; Column++)
+        {
+            *Pixels++ ^= Base[Column];
+        }
+    }
+}
+
+
+// Compresses a raw tile. Returns FALSE if memory could not be allocated, and the tile is left raw.
+static BOOL PackTile(_Inout_ JOURNAL* Journal, _Inout_ JOURNALSTEP* Step, _Inout_ JOURNALTILE* Tile)
+{
+    SIZE_T PixelBytes = 0;
+
+    SIZE_T Bytes = GetTileBytes(Journal, Tile, &PixelBytes);
+
+    XorTileWithBase(Journal, Tile->Index, Tile->Pixels);
+
+    SIZE_T PackedSize = CompressBlock((const UINT8*)Tile->Pixels, Bytes, Journal->Scratch, COMPRESS_BOUND(TILE_MAX_BYTES));
+
+    UINT8* Packed = (PackedSize == 0) ? NULL : HeapAlloc(GetProcessHeap(), 0, PackedSize);
+
+    if (Packed == NULL)
+    {
+        XorTileWithBase(Journal, Tile->Index, Tile->Pixels);
+
+        return FALSE;
+    }
+
+    CopyMemory(Packed, Journal->Scratch, PackedSize);
+
+    HeapFree(GetProcessHeap(), 0, Tile->Pixels);
+
+    Tile->Pixels = NULL;
+
+    Tile->Coverage = NULL;
+
+    Tile->Packed = Packed;
+
+    Tile->PackedSize = (UINT32)PackedSize;
+
+    Tile->Tier = JOURNALTIER_PACKED;
+
+    Step->Bytes = Step->Bytes - Bytes + PackedSize;
+
+    Journal->Bytes = Journal->Bytes - Bytes + PackedSize;
+
+    return TRUE;
+}
+
+
+// Makes sure that at least Size more bytes can be added to the end of the scratch file, making it first if need be.
+// Returns FALSE if they can't.
+static BOOL ReserveScratchFile(_Inout_ JOURNAL* Journal, _In_ UINT64 Size)
+{
+    if (Journal->FileUsed + Size <= Journal->FileMapped)
+    {
+        return TRUE;
+    }
+
+    if (Journal->File == NULL)
+    {
+        wchar_t TempPath[MAX_PATH] = { 0 };
+
+        wchar_t FilePath[MAX_PATH] = { 0 };
+
+        if (GetTempPathW(_countof(TempPath), TempPath) == 0 || GetTempFileNameW(TempPath, L"SnX", 0, FilePath) == 0)
+        {
+            return FALSE;
+        }
+
+        // It's deleted as soon as it's closed, even if SnipEx crashes.
+        HANDLE File = CreateFileW(FilePath, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+
+        if (File == INVALID_HANDLE_VALUE)
+        {
+            return FALSE;
+        }
+
+        Journal->File = File;
+    }
+
+    UINT64 Mapped = max(Journal->FileMapped * 2, FILE_FIRST_MAPPING);
+
+    while (Mapped < Journal->FileUsed + Size)
+    {
+        Mapped *= 2;
+    }
+
+    if (Mapped > JOURNAL_FILE_LIMIT)
+    {
+        return FALSE;
+    }
+
+    // The bigger mapping is made before the old one is let go of, so that if it can't be, the tiles that are
+    // already in the file can still be read.
+    HANDLE Mapping = CreateFileMappingW(Journal->File, NULL, PAGE_READWRITE, (DWORD)(Mapped >> 32), (DWORD)Mapped, NULL);
+
+    if (Mapping == NULL)
+    {
+        return FALSE;
+    }
+
+    UINT8* View = MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)Mapped);
+
+    if (View == NULL)
+    {
+        CloseHandle(Mapping);
+
+        return FALSE;
+    }
+
+    if (Journal->FileView != NULL)
+    {
+        UnmapViewOfFile(Journal->FileView);
+
+        CloseHandle(Journal->FileMapping);
+    }
+
+    Journal->FileMapping = Mapping;
+
+    Journal->FileView = View;
+
+    Journal->FileMapped = Mapped;
+
+    return TRUE;
+}
+
+
+// Moves a packed tile to the end of the scratch file. Returns FALSE if it can't be.
+static BOOL SpillTile(_Inout_ JOURNAL* Journal, _Inout_ JOURNALSTEP* Step, _Inout_ JOURNALTILE* Tile)
+{
+    if (ReserveScratchFile(Journal, Tile->PackedSize) == FALSE)
+    {
+        return FALSE;
+    }
+
+    CopyMemory(&Journal->FileView[Journal->FileUsed], Tile->Packed, Tile->PackedSize);
+
+    HeapFree(GetProcessHeap(), 0, Tile->Packed);
+
+    Tile->Packed = NULL;
+
+    Tile->FileOffset = Journal->FileUsed;
+
+    Tile->Tier = JOURNALTIER_FILE;
+
+    Journal->FileUsed += Tile->PackedSize;
+
+    Journal->FileTiles++;
+
+    Step->Bytes -= Tile->PackedSize;
+
+    Journal->Bytes -= Tile->PackedSize;
+
+    return TRUE;
+}
+
+
+// Packs or spills the next tile that is due to be, oldest step first. Returns FALSE if there was nothing to do.
+static BOOL MigrateTile(_Inout_ JOURNAL* Journal)
+{
+    for (UINT32 Index = 0; Index + JOURNAL_HOT_STEPS < Journal->Count; Index++)
+    {
+        JOURNALSTEP* Step = &Journal->Steps[Index];
+
+        if (Step->Packed < Step->Count)
+        {
+            if (PackTile(Journal, Step, &Step->Tiles[Step->Packed]) == FALSE)
+            {
+                return FALSE;
+            }
+
+            Step->Packed++;
+
+            // A tile that doesn't compress comes out a little bigger than it went in, which can take the journal
+            // over its budget.
+            if (Journal->Bytes > Journal->Budget)
+            {
+                TrimJournal(Journal);
+            }
+
+            return TRUE;
+        }
+
+        if (Index + JOURNAL_WARM_STEPS < Journal->Count && Step->Spilled < Step->Count && Journal->FileFailed == FALSE)
+        {
+            if (SpillTile(Journal, Step, &Step->Tiles[Step->Spilled]) == FALSE)
+            {
+                Journal->FileFailed = TRUE;
+
+                continue;
+            }
+
+            Step->Spilled++;
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+static DWORD WINAPI JournalWorkerProc(_In_ LPVOID Parameter)
+{
+    JOURNAL* Journal = Parameter;
+
+    for (;;)
+    {
+        WaitForSingleObject(Journal->WorkEvent, INFINITE);
+
+        // One tile at a time, so that the UI thread is never kept waiting for the lock for long.
+        for (;;)
+        {
+            EnterCriticalSection(&Journal->Lock);
+
+            BOOL Stopping = Journal->Stopping;
+
+            BOOL Migrated = (Stopping == FALSE) && MigrateTile(Journal);
+
+            LeaveCriticalSection(&Journal->Lock);
+
+            if (Stopping)
+            {
+                return 0;
+            }
+
+            if (Migrated == FALSE)
+            {
+                break;
+            }
+        }
+    }
+}
+
+
+// Copies a tile back into Raster and Coverage. Returns FALSE if a compressed tile turned out to be damaged.
+static BOOL RestoreTile(_Inout_ JOURNAL* Journal, _In_ const JOURNALTILE* Tile, _Inout_ UINT32* Raster, _Inout_ COVERAGE* Coverage)
+{
+    RECT Rect = { 0 };
+
+    GetTileRect(Journal, Tile->Index, &Rect);
+
+    INT32 Width = Rect.right - Rect.left;
+
+    UINT32 Words = ((UINT32)Width + 63) / 64;
+
+    SIZE_T PixelBytes = 0;
+
+    SIZE_T Bytes = GetTileBytes(Journal, Tile, &PixelBytes);
+
+    const UINT32* Pixels = Tile->Pixels;
+
+    const UINT64* Words64 = Tile->Coverage;
+
+    if (Tile->Tier != JOURNALTIER_RAW)
+    {
+        const UINT8* Packed = (Tile->Tier == JOURNALTIER_PACKED) ? Tile->Packed : &Journal->FileView[Tile->FileOffset];
+
+        if (DecompressBlock(Packed, Tile->PackedSize, Journal->Scratch, Bytes) == FALSE)
+        {
+            return FALSE;
+        }
+
+        XorTileWithBase(Journal, Tile->Index, (UINT32*)Journal->Scratch);
+
+        Pixels = (const UINT32*)Journal->Scratch;
+
+        Words64 = Tile->HasCoverage ? (const UINT64*)(Journal->Scratch + PixelBytes) : NULL;
+    }
+
+    for (INT32 Row = Rect.top; Row < Rect.bottom; Row++)
+    {
+        CopyMemory(&Raster[(SIZE_T)Row * Journal->Width + Rect.left], &Pixels[(SIZE_T)(Row - Rect.top) * Width], (SIZE_T)Width * sizeof(UINT32));
+
+        if (Words64 != NULL && Coverage->Bits != NULL)
+        {
+            CopyMemory(&Coverage->Bits[(SIZE_T)Row * Coverage->WordsPerRow + (UINT32)Rect.left / 64], &Words64[(SIZE_T)(Row - Rect.top) * Words], Words * sizeof(UINT64));
+        }
+    }
+
+    // There was no coverage map when the tile was kept, so nothing in it had been hilighted yet.
+    if (Tile->HasCoverage == FALSE)
+    {
+        ClearCoverage(Coverage, &Rect);
+    }
+
+    return TRUE;
+}
+
+
+BOOL InitializeJournal(_Out_ JOURNAL* Journal, _In_ INT32 Width, _In_ INT32 Height, _In_reads_(Width * Height) const UINT32* Base, _In_ SIZE_T Budget)
+{
+    ZeroMemory(Journal, sizeof(JOURNAL));
+
+    Journal->Width = Width;
+
+    Journal->Height = Height;
+
+    Journal->TilesAcross = ((UINT32)Width + JOURNAL_TILE_SIZE - 1) / JOURNAL_TILE_SIZE;
+
+    Journal->TilesDown = ((UINT32)Height + JOURNAL_TILE_SIZE - 1) / JOURNAL_TILE_SIZE;
+
+    Journal->Base = Base;
+
+    if (Budget == 0)
+    {
+        return TRUE;
+    }
+
+    Journal->SavedBy = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)Journal->TilesAcross * Journal->TilesDown * sizeof(UINT32));
+
+    Journal->Scratch = HeapAlloc(GetProcessHeap(), 0, COMPRESS_BOUND(TILE_MAX_BYTES));
+
+    Journal->WorkEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+    if (Journal->SavedBy == NULL || Journal->Scratch == NULL || Journal->WorkEvent == NULL)
+    {
+        FreeJournal(Journal);
+
+        return FALSE;
+    }
+
+    InitializeCriticalSection(&Journal->Lock);
+
+    Journal->Worker = CreateThread(NULL, 0, JournalWorkerProc, Journal, 0, NULL);
+
+    if (Journal->Worker == NULL)
+    {
+        DeleteCriticalSection(&Journal->Lock);
+
+        FreeJournal(Journal);
+
+        return FALSE;
+    }
+
+    Journal->Budget = Budget;
+
+    return TRUE;
+}
+
+
+void FreeJournal(_Inout_ JOURNAL* Journal)
+{
+    if (Journal->Worker != NULL)
+    {
+        EnterCriticalSection(&Journal->Lock);
+
+        Journal->Stopping = TRUE;
+
+        LeaveCriticalSection(&Journal->Lock);
+
+        SetEvent(Journal->WorkEvent);
+
+        WaitForSingleObject(Journal->Worker, INFINITE);
+
+        CloseHandle(Journal->Worker);
+
+        DeleteCriticalSection(&Journal->Lock);
+    }
+
+    for (UINT32 Index = 0; Index < Journal->Count; Index++)
+    {
+        FreeJournalStep(Journal, &Journal->Steps[Index]);
+    }
+
+    if (Journal->Steps != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Journal->Steps);
+    }
+
+    if (Journal->SavedBy != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Journal->SavedBy);
+    }
+
+    if (Journal->Scratch != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Journal->Scratch);
+    }
+
+    if (Journal->WorkEvent != NULL)
+    {
+        CloseHandle(Journal->WorkEvent);
+    }
+
+    if (Journal->FileView != NULL)
+    {
+        UnmapViewOfFile(Journal->FileView);
+
+        CloseHandle(Journal->FileMapping);
+    }
+
+    if (Journal->File != NULL)
+    {
+        CloseHandle(Journal->File);
+    }
+
+    ZeroMemory(Journal, sizeof(JOURNAL));
+}
+
+
+void SaveJournalTiles(_Inout_ JOURNAL* Journal, _In_ UINT32 Step, _In_reads_(Journal->Width * Journal->Height) const UINT32* Raster, _In_ const COVERAGE* Coverage, _In_ const RECT* Area)
+{
+    RECT Snip = { 0, 0, Journal->Width, Journal->Height };
+
+    RECT Save = { 0 };
+
+    if (Journal->Budget == 0 || IntersectRect(&Save, Area, &Snip) == FALSE)
+    {
+        return;
+    }
+
+    EnterCriticalSection(&Journal->Lock);
+
+    JOURNALSTEP* Current = GetJournalStep(Journal, Step);
+
+    UINT32 FirstColumn = (UINT32)Save.left / JOURNAL_TILE_SIZE;
+
+    UINT32 LastColumn = (UINT32)(Save.right - 1) / JOURNAL_TILE_SIZE;
+
+    UINT32 FirstRow = (UINT32)Save.top / JOURNAL_TILE_SIZE;
+
+    UINT32 LastRow = (UINT32)(Save.bottom - 1) / JOURNAL_TILE_SIZE;
+
+    for (UINT32 Row = FirstRow; Current != NULL && Row <= LastRow && Current->Incomplete == FALSE; Row++)
+    {
+        for (UINT32 Column = FirstColumn; Column <= LastColumn && Current->Incomplete == FALSE; Column++)
+        {
+            UINT32 Index = Row * Journal->TilesAcross + Column;
+
+            if (Journal->SavedBy[Index] == Current->Serial)
+            {
+                continue;
+            }
+
+            if (SaveTile(Journal, Current, Index, Raster, Coverage) == FALSE)
+            {
+                // Without this tile the step can't be put back by copying, so the rest of it is no use either.
+                FreeJournalStep(Journal, Current);
+
+                Current->Incomplete = TRUE;
+
+                break;
+            }
+
+            Journal->SavedBy[Index] = Current->Serial;
+
+            if (Journal->Bytes > Journal->Budget)
+            {
+                TrimJournal(Journal);
+
+                // Trimming moves the steps down.
+                Current = &Journal->Steps[Journal->Count - 1];
+            }
+        }
+    }
+
+    LeaveCriticalSection(&Journal->Lock);
+}
+
+
+BOOL RestoreJournalStep(_Inout_ JOURNAL* Journal, _In_ UINT32 Step, _Inout_updates_(Journal->Width * Journal->Height) UINT32* Raster, _Inout_ COVERAGE* Coverage)
+{
+    if (Journal->Budget == 0)
+    {
+        return FALSE;
+    }
+
+    EnterCriticalSection(&Journal->Lock);
+
+    BOOL Restored = FALSE;
+
+    if (Journal->Count > 0 && Journal->Steps[Journal->Count - 1].Step == Step)
+    {
+        JOURNALSTEP* Newest = &Journal->Steps[Journal->Count - 1];
+
+        Restored = (Newest->Incomplete == FALSE);
+
+        for (UINT32 Index = 0; Index < Newest->Count && Restored; Index++)
+        {
+            Restored = RestoreTile(Journal, &Newest->Tiles[Index], Raster, Coverage);
+        }
+
+        RemoveJournalStep(Journal, Journal->Count - 1);
+    }
+
+    LeaveCriticalSection(&Journal->Lock);
+
+    return Restored;
+}
+
+
+void DiscardJournalStep(_Inout_ JOURNAL* Journal, _In_ UINT32 Step)
+{
+    if (Journal->Budget == 0)
+    {
+        return;
+    }
+
+    EnterCriticalSection(&Journal->Lock);
+
+    if (Journal->Count > 0 && Journal->Steps[Journal->Count - 1].Step == Step)
+    {
+        RemoveJournalStep(Journal, Journal->Count - 1);
+    }
+
+    LeaveCriticalSection(&Journal->Lock);
+}
+
+
+void GetJournalUsage(_Inout_ JOURNAL* Journal, _Out_ SIZE_T* Bytes, _Out_ UINT64* FileBytes)
+{
+    *Bytes = 0;
+
+    *FileBytes = 0;
+
+    if (Journal->Budget == 0)
+    {
+        return;
+    }
+
+    EnterCriticalSection(&Journal->Lock);
+
+    *Bytes = Journal->Bytes;
+
+    *FileBytes = Journal->FileUsed;
+
+    LeaveCriticalSection(&Journal->Lock);
+}
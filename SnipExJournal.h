@@ -0,0 +1,178 @@
+// SnipExJournal.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Keeps, for each recent change to the snip, the 64x64 tiles that it drew on, as they were just before it drew on
+// them. Undoing a change whose tiles are still kept only has to copy them back, however many annotations are
+// under it, so undo on a huge snip takes about as long as the change itself did. Only as many tiles as fit in the
+// budget are kept; when it's full, the oldest changes lose their tiles, and are undone by redrawing instead.
+// The tiles of the newest few changes are kept as they are. A worker thread compresses the tiles of older changes,
+// and moves those of older changes still out to a scratch file, and they are read back from there when needed.
+// Needs SnipExCoverage.h to be included first.
+
+#pragma once
+
+// A multiple of 64, so that each row of a tile is whole words of the hilighter's coverage map.
+#define JOURNAL_TILE_SIZE  64
+
+// How many of the newest steps keep their tiles uncompressed, since they're the likeliest to be undone.
+#define JOURNAL_HOT_STEPS  8
+
+// How many of the newest steps keep their tiles in memory. Older ones are moved out to the scratch file.
+#define JOURNAL_WARM_STEPS 64
+
+// How big the scratch file can get. Once it's full, tiles stay in memory, and count against the budget.
+#define JOURNAL_FILE_LIMIT ((UINT64)4 * 1024 * 1024 * 1024)
+
+typedef enum JOURNALTIER
+{
+    // Copied straight out of the raster.
+    JOURNALTIER_RAW,
+
+    // Compressed with CompressBlock, in memory.
+    JOURNALTIER_PACKED,
+
+    // Compressed with CompressBlock, in the scratch file.
+    JOURNALTIER_FILE
+
+} JOURNALTIER;
+
+typedef struct JOURNALTILE
+{
+    // Row * TilesAcross + Column.
+    UINT32      Index;
+
+    JOURNALTIER Tier;
+
+    // Whether the tile's words of the coverage map were kept. They weren't if there was no coverage map yet.
+    BOOL        HasCoverage;
+
+    // The tile's pixels, one row after another, and then its words of the coverage map. Tiles on the right and
+    // bottom edges of the snip are cut short. Only while the tile is raw.
+    UINT32*     Pixels;
+
+    UINT64*     Coverage;
+
+    // The same, compressed, except that each pixel is XORed with the base first, so that every pixel that
+    // nothing had been drawn on yet is 0. Only while the tile is packed.
+    UINT8*      Packed;
+
+    UINT32      PackedSize;
+
+    // Where the compressed tile is in the scratch file, once it's been moved there.
+    UINT64      FileOffset;
+
+} JOURNALTILE;
+
+typedef struct JOURNALSTEP
+{
+    // The document step that drew on the tiles.
+    UINT32       Step;
+
+    // Never used twice, unlike Step, which comes back when a change is undone and then redone.
+    UINT32       Serial;
+
+    JOURNALTILE* Tiles;
+
+    UINT32       Count;
+
+    UINT32       Capacity;
+
+    // How many of the tiles, from the first, have been compressed, and how many of those moved to the scratch file.
+    UINT32       Packed;
+
+    UINT32       Spilled;
+
+    // The memory that the tiles take up, in bytes. Not counting the scratch file.
+    SIZE_T       Bytes;
+
+    // The step went over the budget on its own, so its tiles were thrown away and no more are kept for it.
+    BOOL         Incomplete;
+
+} JOURNALSTEP;
+
+typedef struct JOURNAL
+{
+    INT32            Width;
+
+    INT32            Height;
+
+    UINT32           TilesAcross;
+
+    UINT32           TilesDown;
+
+    // The snip exactly as it was taken, which packed tiles are XORed with. Owned by the document.
+    const UINT32*    Base;
+
+    // For each tile, the serial of the newest step that kept it, so that a step only keeps each tile once.
+    UINT32*          SavedBy;
+
+    // Oldest to newest.
+    JOURNALSTEP*     Steps;
+
+    UINT32           Count;
+
+    UINT32           Capacity;
+
+    UINT32           Serial;
+
+    // The memory that the tiles of every step take up, in bytes, and how much they are allowed to.
+    SIZE_T           Bytes;
+
+    SIZE_T           Budget;
+
+    // Room to compress a tile into, or decompress one. Only used while holding Lock.
+    UINT8*           Scratch;
+
+    // The scratch file, which tiles are only ever added to the end of. It's mapped into memory FileMapped bytes at
+    // a time, and FileUsed bytes of that hold tiles. Once none of the tiles in it are needed, it starts over.
+    HANDLE           File;
+
+    HANDLE           FileMapping;
+
+    UINT8*           FileView;
+
+    UINT64           FileMapped;
+
+    UINT64           FileUsed;
+
+    UINT32           FileTiles;
+
+    // Set if the scratch file couldn't be made, or is full, so no more tiles are moved to it.
+    BOOL             FileFailed;
+
+    // Held by whoever is looking at or changing anything in the journal, since the worker thread changes it too.
+    CRITICAL_SECTION Lock;
+
+    HANDLE           Worker;
+
+    // Set whenever there may be tiles for the worker to compress or move.
+    HANDLE           WorkEvent;
+
+    BOOL             Stopping;
+
+} JOURNAL;
+
+
+// Starts an empty journal for a Width x Height snip, whose pixels as it was taken are Base, that keeps up to Budget
+// bytes of tiles in memory, and starts its worker thread. A budget of 0 keeps none. Returns FALSE if memory could not be
+// allocated or the thread could not be started.
+BOOL InitializeJournal(_Out_ JOURNAL* Journal, _In_ INT32 Width, _In_ INT32 Height, _In_reads_(Width * Height) const UINT32* Base, _In_ SIZE_T Budget);
+
+// Stops the worker thread, frees every tile, and deletes the scratch file.
+void FreeJournal(_Inout_ JOURNAL* Journal);
+
+// Keeps a copy of the tiles of Raster and Coverage that Area touches, and that Step hasn't kept yet. Call this just
+// before Step draws on Area. If memory runs short, the tiles of the oldest steps are thrown away to make room, or
+// if there's no other step left to throw away, Step's own.
+void SaveJournalTiles(_Inout_ JOURNAL* Journal, _In_ UINT32 Step, _In_reads_(Journal->Width * Journal->Height) const UINT32* Raster, _In_ const COVERAGE* Coverage, _In_ const RECT* Area);
+
+// If Step is the newest step in the journal, takes it out, and if it still has all of its tiles, copies them back
+// into Raster and Coverage, which puts back every pixel that it drew on. Compressed tiles are decompressed, and tiles
+// in the scratch file are read back from it. Returns FALSE if it didn't, and Step has to be undone by redrawing.
+BOOL RestoreJournalStep(_Inout_ JOURNAL* Journal, _In_ UINT32 Step, _Inout_updates_(Journal->Width * Journal->Height) UINT32* Raster, _Inout_ COVERAGE* Coverage);
+
+// If Step is the newest step in the journal, takes it out without copying anything back. For a step that kept
+// tiles but turned out not to draw anything, so that it doesn't get in the way of undoing the step before it.
+void DiscardJournalStep(_Inout_ JOURNAL* Journal, _In_ UINT32 Step);
+
+// Gets how much memory the journal's tiles take up, and how much of the scratch file is in use, in bytes.
+void GetJournalUsage(_Inout_ JOURNAL* Journal, _Out_ SIZE_T* Bytes, _Out_ UINT64* FileBytes);
@@ -0,0 +1,705 @@
+// SnipExMatch.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Template matching for "Redact every occurrence." Every position in the snip is first compared against a
+// copy of the template that has been shrunk down by Scale in each direction, using the sum of absolute
+// differences (SAD) of the colors. Shrinking can only make two images look more alike, never less, so any
+// position that fails the shrunken comparison can't possibly be a match and is skipped. Only the rare
+// positions that pass are compared at full size, and then checked with normalized cross-correlation.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <stdlib.h>
+#include <math.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExMatch.h"
+
+// The biggest amount that the image and the template are shrunk by for the first pass.
+#define MATCH_MAX_SCALE 8
+
+// Templates taller than this many shrunken rows only have their first MATCH_MAX_ROWS rows sorted by how busy they are.
+#define MATCH_MAX_ROWS  512
+
+
+typedef struct MATCHSEARCH
+{
+    const UINT32* Pixels;
+
+    INT32         Width;
+
+    INT32         Height;
+
+    RECT          Template;
+
+    INT32         TemplateWidth;
+
+    INT32         TemplateHeight;
+
+    UINT32        MaxDifference;
+
+    float         MinCorrelation;
+
+    // The image is shrunk by Scale in each direction by averaging Scale x Scale blocks together.
+    INT32         Scale;
+
+    UINT32*       Coarse;
+
+    INT32         CoarseWidth;
+
+    INT32         CoarseHeight;
+
+    // A match could start anywhere within a block, so there is one shrunken template for each of the
+    // Scale x Scale places it could start. Each one starts at the first pixel of the template that lines
+    // up with a block of the shrunken image.
+    UINT32*       CoarseTemplates;
+
+    INT32         CoarseTemplateSize;
+
+    // For each shrunken template, the order to compare its rows in: the busiest rows first, since those are
+    // the ones most likely to rule a position out. Plain background rows would match almost anywhere.
+    INT32*        RowOrders;
+
+    INT32         RowOrderSize;
+
+} MATCHSEARCH;
+
+typedef struct MATCHBAND
+{
+    const MATCHSEARCH* Search;
+
+    // The rows that this band looks for the top of a match in. Last is exclusive.
+    INT32              First;
+
+    INT32              Last;
+
+    UINT32             Count;
+
+    MATCH              Matches[MATCH_MAX_RESULTS];
+
+} MATCHBAND;
+
+
+UINT32 GetRowDifferenceScalar(_In_reads_(Count) const UINT32* A, _In_reads_(Count) const UINT32* B, _In_ INT32 Count)
+{
+    UINT32 Difference = 0;
+
+    for (INT32 Index = 0; Index < Count; Index++)
+    {
+        for (UINT32 Channel = 0; Channel < 3; Channel++)
+        {
+            INT32 ChannelA = (INT32)((A[Index] >> (Channel * 8)) & 0xFF);
+
+            INT32 ChannelB = (INT32)((B[Index] >> (Channel * 8)) & 0xFF);
+
+            Difference += (UINT32)abs(ChannelA - ChannelB);
+        }
+    }
+
+    return Difference;
+}
+
+
+UINT32 GetRowDifference(_In_reads_(Count) const UINT32* A, _In_reads_(Count) const UINT32* B, _In_ INT32 Count)
+{
+    INT32 Index = 0;
+
+    UINT32 Difference = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i ColorMask = _mm_set1_epi32(0x00FFFFFF);
+
+    __m128i Sums = _mm_setzero_si128();
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        __m128i WideA = _mm_and_si128(_mm_loadu_si128((const __m128i*)&A[Index]), ColorMask);
+
+        __m128i WideB = _mm_and_si128(_mm_loadu_si128((const __m128i*)&B[Index]), ColorMask);
+
+        Sums = _mm_add_epi64(Sums, _mm_sad_epu8(WideA, WideB));
+    }
+
+    Difference = (UINT32)(_mm_cvtsi128_si32(Sums) + _mm_cvtsi128_si32(_mm_srli_si128(Sums, 8)));
+#elif defined(_M_ARM64)
+    uint8x16_t ColorMask = vreinterpretq_u8_u32(vdupq_n_u32(0x00FFFFFF));
+
+    uint32x4_t Sums = vdupq_n_u32(0);
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        uint8x16_t WideA = vandq_u8(vld1q_u8((const uint8_t*)&A[Index]), ColorMask);
+
+        uint8x16_t WideB = vandq_u8(vld1q_u8((const uint8_t*)&B[Index]), ColorMask);
+
+        Sums = vpadalq_u16(Sums, vpaddlq_u8(vabdq_u8(WideA, WideB)));
+    }
+
+    Difference = vaddvq_u32(Sums);
+#endif
+
+    return Difference + GetRowDifferenceScalar(&A[Index], &B[Index], Count - Index);
+}
+
+
+// Compares a Width x Height block of two images, row by row in the order given by RowOrder (or top to bottom
+// if it's NULL), and gives up as soon as the difference is over MaxDifference. Returns the difference, or
+// MAXUINT32 if it gave up.
+static UINT32 GetBlockDifference(
+    _In_ const UINT32* A,
+    _In_ INT32 StrideA,
+    _In_ const UINT32* B,
+    _In_ INT32 StrideB,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_opt_ const INT32* RowOrder,
+    _In_ UINT32 MaxDifference)
+{
+    UINT32 Difference = 0;
+
+    for (INT32 Index = 0; Index < Height; Index++)
+    {
+        INT32 Row = (RowOrder != NULL) ? RowOrder[Index] : Index;
+
+        Difference += GetRowDifference(&A[(SIZE_T)Row * StrideA], &B[(SIZE_T)Row * StrideB], Width);
+
+        if (Difference > MaxDifference)
+        {
+            return MAXUINT32;
+        }
+    }
+
+    return Difference;
+}
+
+
+double GetCorrelation(_In_reads_(Width * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ const RECT* Template, _In_ INT32 X, _In_ INT32 Y)
+{
+    INT32 TemplateWidth = Template->right - Template->left;
+
+    INT32 TemplateHeight = Template->bottom - Template->top;
+
+    double Count = (double)TemplateWidth * TemplateHeight;
+
+    double SumT = 0, SumI = 0, SumTT = 0, SumII = 0, SumTI = 0;
+
+    for (INT32 Row = 0; Row < TemplateHeight; Row++)
+    {
+        const UINT32* RowT = &Pixels[(SIZE_T)(Template->top + Row) * Width + Template->left];
+
+        const UINT32* RowI = &Pixels[(SIZE_T)(Y + Row) * Width + X];
+
+        for (INT32 Column = 0; Column < TemplateWidth; Column++)
+        {
+            double T = (double)((RowT[Column] & 0xFF) + ((RowT[Column] >> 8) & 0xFF) + ((RowT[Column] >> 16) & 0xFF));
+
+            double I = (double)((RowI[Column] & 0xFF) + ((RowI[Column] >> 8) & 0xFF) + ((RowI[Column] >> 16) & 0xFF));
+
+            SumT += T;
+
+            SumI += I;
+
+            SumTT += T * T;
+
+            SumII += I * I;
+
+            SumTI += T * I;
+        }
+    }
+
+    double VarianceT = SumTT - SumT * SumT / Count;
+
+    double VarianceI = SumII - SumI * SumI / Count;
+
+    if (VarianceT <= 0.0 || VarianceI <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return (SumTI - SumT * SumI / Count) / sqrt(VarianceT * VarianceI);
+}
+
+
+// Averages each Scale x Scale block starting at Left, Top into one pixel of Destination, which is Columns x Rows.
+static void ShrinkImage(
+    _In_ const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Left,
+    _In_ INT32 Top,
+    _In_ INT32 Scale,
+    _Out_ UINT32* Destination,
+    _In_ INT32 Columns,
+    _In_ INT32 Rows)
+{
+    UINT32 BlockSize = (UINT32)(Scale * Scale);
+
+    for (INT32 Row = 0; Row < Rows; Row++)
+    {
+        for (INT32 Column = 0; Column < Columns; Column++)
+        {
+            UINT32 Sums[4] = { 0 };
+
+            for (INT32 Y = 0; Y < Scale; Y++)
+            {
+                const UINT32* Source = &Pixels[(SIZE_T)(Top + Row * Scale + Y) * Width + Left + Column * Scale];
+
+                for (INT32 X = 0; X < Scale; X++)
+                {
+                    for (UINT32 Channel = 0; Channel < 4; Channel++)
+                    {
+                        Sums[Channel] += (Source[X] >> (Channel * 8)) & 0xFF;
+                    }
+                }
+            }
+
+            Destination[(SIZE_T)Row * Columns + Column] = (Sums[0] / BlockSize) | ((Sums[1] / BlockSize) << 8) | ((Sums[2] / BlockSize) << 16) | ((Sums[3] / BlockSize) << 24);
+        }
+    }
+}
+
+
+// Sorts the rows of a Columns x Rows image from the one that differs most from the image's average color to the one
+// that differs least. Rows past MATCH_MAX_ROWS are left in order at the end.
+static void GetRowOrder(_In_ const UINT32* Pixels, _In_ INT32 Columns, _In_ INT32 Rows, _Out_writes_(Rows) INT32* RowOrder)
+{
+    UINT32 Sums[3] = { 0 };
+
+    for (INT32 Index = 0; Index < Columns * Rows; Index++)
+    {
+        for (UINT32 Channel = 0; Channel < 3; Channel++)
+        {
+            Sums[Channel] += (Pixels[Index] >> (Channel * 8)) & 0xFF;
+        }
+    }
+
+    UINT32 Average = 0;
+
+    for (UINT32 Channel = 0; Channel < 3; Channel++)
+    {
+        Average |= (Sums[Channel] / (UINT32)max(Columns * Rows, 1)) << (Channel * 8);
+    }
+
+    // An insertion sort is plenty; a shrunken template is only a handful of rows tall.
+    UINT32 Contrast[MATCH_MAX_ROWS] = { 0 };
+
+    for (INT32 Row = MATCH_MAX_ROWS; Row < Rows; Row++)
+    {
+        RowOrder[Row] = Row;
+    }
+
+    for (INT32 Row = 0; Row < min(Rows, MATCH_MAX_ROWS); Row++)
+    {
+        UINT32 RowContrast = 0;
+
+        for (INT32 Column = 0; Column < Columns; Column++)
+        {
+            RowContrast += GetRowDifferenceScalar(&Pixels[(SIZE_T)Row * Columns + Column], &Average, 1);
+        }
+
+        INT32 Index = Row;
+
+        while (Index > 0 && Contrast[Index - 1] < RowContrast)
+        {
+            Contrast[Index] = Contrast[Index - 1];
+
+            RowOrder[Index] = RowOrder[Index - 1];
+
+            Index--;
+        }
+
+        Contrast[Index] = RowContrast;
+
+        RowOrder[Index] = Row;
+    }
+}
+
+
+// Keeps Match unless it overlaps one that is at least as close. Throws out any that it overlaps and beats.
+static void AddMatch(_Inout_updates_(MaxCount) MATCH* Matches, _Inout_ UINT32* Count, _In_ UINT32 MaxCount, _In_ const MATCH* Match)
+{
+    RECT Overlap = { 0 };
+
+    UINT32 Kept = 0;
+
+    for (UINT32 Index = 0; Index < *Count; Index++)
+    {
+        if (IntersectRect(&Overlap, &Matches[Index].Rectangle, &Match->Rectangle))
+        {
+            if (Matches[Index].Difference <= Match->Difference)
+            {
+                return;
+            }
+
+            continue;
+        }
+
+        Matches[Kept++] = Matches[Index];
+    }
+
+    *Count = Kept;
+
+    if (*Count < MaxCount)
+    {
+        Matches[(*Count)++] = *Match;
+    }
+}
+
+
+static DWORD WINAPI MatchBandThreadProc(_In_ LPVOID Parameter)
+{
+    MATCHBAND* Band = (MATCHBAND*)Parameter;
+
+    const MATCHSEARCH* Search = Band->Search;
+
+    INT32 Scale = Search->Scale;
+
+    UINT32 MaxDifference = Search->MaxDifference * 3 * (UINT32)Search->TemplateWidth * (UINT32)Search->TemplateHeight;
+
+    const UINT32* Template = &Search->Pixels[(SIZE_T)Search->Template.top * Search->Width + Search->Template.left];
+
+    for (INT32 Y = Band->First; Y < Band->Last; Y++)
+    {
+        // How far down into the template the first row that lines up with a block of the shrunken image is.
+        INT32 OffsetY = (Scale - Y % Scale) % Scale;
+
+        INT32 CoarseRows = (Search->TemplateHeight - OffsetY) / Scale;
+
+        for (INT32 X = 0; X + Search->TemplateWidth <= Search->Width; X++)
+        {
+            // Skip over the template itself, and everywhere that would overlap it.
+            if (Y + Search->TemplateHeight > Search->Template.top && Y < Search->Template.bottom && X + Search->TemplateWidth > Search->Template.left && X < Search->Template.right)
+            {
+                X = Search->Template.right - 1;
+
+                continue;
+            }
+
+            INT32 OffsetX = (Scale - X % Scale) % Scale;
+
+            INT32 CoarseColumns = (Search->TemplateWidth - OffsetX) / Scale;
+
+            INT32 Phase = (Y % Scale) * Scale + X % Scale;
+
+            const UINT32* CoarseTemplate = &Search->CoarseTemplates[(SIZE_T)Phase * Search->CoarseTemplateSize];
+
+            const UINT32* Coarse = &Search->Coarse[(SIZE_T)((Y + OffsetY) / Scale) * Search->CoarseWidth + (X + OffsetX) / Scale];
+
+            // Each shrunken pixel is the average of Scale * Scale pixels, so it can differ by no more than the
+            // average of their differences, plus 1 per channel for rounding.
+            UINT32 MaxCoarseDifference = MaxDifference / (UINT32)(Scale * Scale) + 3 * (UINT32)(CoarseColumns * CoarseRows);
+
+            if (GetBlockDifference(Coarse, Search->CoarseWidth, CoarseTemplate, CoarseColumns, CoarseColumns, CoarseRows, &Search->RowOrders[(SIZE_T)Phase * Search->RowOrderSize], MaxCoarseDifference) == MAXUINT32)
+            {
+                continue;
+            }
+
+            MATCH Match = { 0 };
+
+            SetRect(&Match.Rectangle, X, Y, X + Search->TemplateWidth, Y + Search->TemplateHeight);
+
+            Match.Difference = GetBlockDifference(&Search->Pixels[(SIZE_T)Y * Search->Width + X], Search->Width, Template, Search->Width, Search->TemplateWidth, Search->TemplateHeight, NULL, MaxDifference);
+
+            if (Match.Difference == MAXUINT32)
+            {
+                continue;
+            }
+
+            if (Search->MinCorrelation > 0.0f && GetCorrelation(Search->Pixels, Search->Width, &Search->Template, X, Y) < Search->MinCorrelation)
+            {
+                continue;
+            }
+
+            AddMatch(Band->Matches, &Band->Count, _countof(Band->Matches), &Match);
+        }
+    }
+
+    return 0;
+}
+
+
+static int CompareMatches(_In_ const void* A, _In_ const void* B)
+{
+    UINT32 DifferenceA = ((const MATCH*)A)->Difference;
+
+    UINT32 DifferenceB = ((const MATCH*)B)->Difference;
+
+    return (DifferenceA > DifferenceB) - (DifferenceA < DifferenceB);
+}
+
+
+// The standard deviation of R+G+B across the template.
+static double GetTemplateDeviation(_In_ const MATCHSEARCH* Search)
+{
+    double Sum = 0, SumSquares = 0;
+
+    double Count = (double)Search->TemplateWidth * Search->TemplateHeight;
+
+    for (INT32 Y = Search->Template.top; Y < Search->Template.bottom; Y++)
+    {
+        for (INT32 X = Search->Template.left; X < Search->Template.right; X++)
+        {
+            UINT32 Pixel = Search->Pixels[(SIZE_T)Y * Search->Width + X];
+
+            double Brightness = (double)((Pixel & 0xFF) + ((Pixel >> 8) & 0xFF) + ((Pixel >> 16) & 0xFF));
+
+            Sum += Brightness;
+
+            SumSquares += Brightness * Brightness;
+        }
+    }
+
+    return sqrt(max(SumSquares / Count - (Sum / Count) * (Sum / Count), 0.0));
+}
+
+
+BOOL FindTemplateMatches(
+    _In_reads_(Width * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ const RECT* Template,
+    _In_ UINT32 MaxDifference,
+    _In_ float MinCorrelation,
+    _Out_ MATCHES* Matches)
+{
+    BOOL Result = FALSE;
+
+    MATCHSEARCH Search = { 0 };
+
+    MATCHBAND* Bands = NULL;
+
+    HANDLE Threads[MATCH_MAX_THREADS] = { 0 };
+
+    Matches->Count = 0;
+
+    Matches->Matches = NULL;
+
+    Search.Pixels = Pixels;
+
+    Search.Width = Width;
+
+    Search.Height = Height;
+
+    Search.Template.left = max(Template->left, 0);
+
+    Search.Template.top = max(Template->top, 0);
+
+    Search.Template.right = min(Template->right, Width);
+
+    Search.Template.bottom = min(Template->bottom, Height);
+
+    Search.TemplateWidth = Search.Template.right - Search.Template.left;
+
+    Search.TemplateHeight = Search.Template.bottom - Search.Template.top;
+
+    Search.MaxDifference = MaxDifference;
+
+    Search.MinCorrelation = MinCorrelation;
+
+    if (Search.TemplateWidth <= 0 || Search.TemplateHeight <= 0 || GetTemplateDeviation(&Search) < MATCH_MIN_DEVIATION)
+    {
+        // Nothing worth looking for.
+        return TRUE;
+    }
+
+    // Shrink as much as we can while the shrunken template stays at least 2 x 2, no matter where it starts in a block.
+    Search.Scale = MATCH_MAX_SCALE;
+
+    while (Search.Scale > 1 && min(Search.TemplateWidth, Search.TemplateHeight) < 3 * Search.Scale)
+    {
+        Search.Scale /= 2;
+    }
+
+    Search.CoarseWidth = Width / Search.Scale;
+
+    Search.CoarseHeight = Height / Search.Scale;
+
+    Search.CoarseTemplateSize = (Search.TemplateWidth / Search.Scale) * (Search.TemplateHeight / Search.Scale);
+
+    Search.Coarse = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Search.CoarseWidth * Search.CoarseHeight * sizeof(UINT32));
+
+    Search.CoarseTemplates = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Search.Scale * Search.Scale * Search.CoarseTemplateSize * sizeof(UINT32));
+
+    Search.RowOrderSize = Search.TemplateHeight / Search.Scale;
+
+    Search.RowOrders = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Search.Scale * Search.Scale * Search.RowOrderSize * sizeof(INT32));
+
+    Bands = HeapAlloc(GetProcessHeap(), 0, MATCH_MAX_THREADS * sizeof(MATCHBAND));
+
+    if (Search.Coarse == NULL || Search.CoarseTemplates == NULL || Search.RowOrders == NULL || Bands == NULL)
+    {
+        goto Cleanup;
+    }
+
+    ShrinkImage(Pixels, Width, 0, 0, Search.Scale, Search.Coarse, Search.CoarseWidth, Search.CoarseHeight);
+
+    for (INT32 PhaseY = 0; PhaseY < Search.Scale; PhaseY++)
+    {
+        for (INT32 PhaseX = 0; PhaseX < Search.Scale; PhaseX++)
+        {
+            // A match whose left edge is at PhaseX within a block lines up with the blocks OffsetX pixels into the template.
+            INT32 OffsetX = (Search.Scale - PhaseX) % Search.Scale;
+
+            INT32 OffsetY = (Search.Scale - PhaseY) % Search.Scale;
+
+            INT32 Phase = PhaseY * Search.Scale + PhaseX;
+
+            INT32 Columns = (Search.TemplateWidth - OffsetX) / Search.Scale;
+
+            INT32 Rows = (Search.TemplateHeight - OffsetY) / Search.Scale;
+
+            UINT32* CoarseTemplate = &Search.CoarseTemplates[(SIZE_T)Phase * Search.CoarseTemplateSize];
+
+            ShrinkImage(Pixels, Width, Search.Template.left + OffsetX, Search.Template.top + OffsetY, Search.Scale, CoarseTemplate, Columns, Rows);
+
+            GetRowOrder(CoarseTemplate, Columns, Rows, &Search.RowOrders[(SIZE_T)Phase * Search.RowOrderSize]);
+        }
+    }
+
+    // Split the rows that a match could start on into one band per thread.
+    INT32 Rows = Height - Search.TemplateHeight + 1;
+
+    SYSTEM_INFO SystemInfo = { 0 };
+
+    GetSystemInfo(&SystemInfo);
+
+    INT32 BandCount = (INT32)min(SystemInfo.dwNumberOfProcessors, MATCH_MAX_THREADS);
+
+    BandCount = max(min(BandCount, Rows / 16), 1);
+
+    for (INT32 Index = 0; Index < BandCount; Index++)
+    {
+        Bands[Index].Search = &Search;
+
+        Bands[Index].First = (INT32)(((INT64)Rows * Index) / BandCount);
+
+        Bands[Index].Last = (INT32)(((INT64)Rows * (Index + 1)) / BandCount);
+
+        Bands[Index].Count = 0;
+    }
+
+    for (INT32 Index = 1; Index < BandCount; Index++)
+    {
+        Threads[Index] = CreateThread(NULL, 0, MatchBandThreadProc, &Bands[Index], 0, NULL);
+
+        if (Threads[Index] == NULL)
+        {
+            // Still get the work done, just not in parallel.
+            MatchBandThreadProc(&Bands[Index]);
+        }
+    }
+
+    MatchBandThreadProc(&Bands[0]);
+
+    for (INT32 Index = 1; Index < BandCount; Index++)
+    {
+        if (Threads[Index] != NULL)
+        {
+            WaitForSingleObject(Threads[Index], INFINITE);
+
+            CloseHandle(Threads[Index]);
+        }
+    }
+
+    // Gather up every band's matches, closest first, and throw out the ones that overlap a closer match across band boundaries.
+    UINT32 Total = 0;
+
+    for (INT32 Index = 0; Index < BandCount; Index++)
+    {
+        Total += Bands[Index].Count;
+    }
+
+    if (Total == 0)
+    {
+        Result = TRUE;
+
+        goto Cleanup;
+    }
+
+    MATCH* All = HeapAlloc(GetProcessHeap(), 0, Total * sizeof(MATCH));
+
+    Matches->Matches = HeapAlloc(GetProcessHeap(), 0, min(Total, MATCH_MAX_RESULTS) * sizeof(MATCH));
+
+    if (All == NULL || Matches->Matches == NULL)
+    {
+        if (All != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, All);
+        }
+
+        FreeMatches(Matches);
+
+        goto Cleanup;
+    }
+
+    Total = 0;
+
+    for (INT32 Index = 0; Index < BandCount; Index++)
+    {
+        CopyMemory(&All[Total], Bands[Index].Matches, Bands[Index].Count * sizeof(MATCH));
+
+        Total += Bands[Index].Count;
+    }
+
+    qsort(All, Total, sizeof(MATCH), CompareMatches);
+
+    for (UINT32 Index = 0; Index < Total; Index++)
+    {
+        AddMatch(Matches->Matches, &Matches->Count, min(Total, MATCH_MAX_RESULTS), &All[Index]);
+    }
+
+    HeapFree(GetProcessHeap(), 0, All);
+
+    Result = TRUE;
+
+Cleanup:
+
+    if (Search.Coarse != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Search.Coarse);
+    }
+
+    if (Search.CoarseTemplates != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Search.CoarseTemplates);
+    }
+
+    if (Search.RowOrders != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Search.RowOrders);
+    }
+
+    if (Bands != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Bands);
+    }
+
+    return Result;
+}
+
+
+void FreeMatches(_Inout_ MATCHES* Matches)
+{
+    if (Matches->Matches != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Matches->Matches);
+    }
+
+    Matches->Matches = NULL;
+
+    Matches->Count = 0;
+}
@@ -0,0 +1,66 @@
+// SnipExMatch.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Finds every other place in a snip that looks the same as a given rectangle of it, so that an email
+// address or an avatar that shows up several times only has to be redacted once.
+
+#pragma once
+
+// A match is accepted if its colors are off by no more than this much per channel, on average.
+#define MATCH_MAX_DIFFERENCE  6
+
+// ...and, on top of that, if the brightness of the match correlates with the template at least this well.
+#define MATCH_MIN_CORRELATION 0.9f
+
+// Templates whose brightness varies less than this (the standard deviation of R+G+B) are just a flat patch of
+// color, which would match everywhere, so they are not searched for.
+#define MATCH_MIN_DEVIATION   12.0
+
+// The most matches that will be returned. Each search thread also stops looking once it has found this many.
+#define MATCH_MAX_RESULTS     256
+
+#define MATCH_MAX_THREADS     16
+
+typedef struct MATCH
+{
+    RECT   Rectangle;
+
+    // The sum of absolute differences of the color channels between the match and the template.
+    UINT32 Difference;
+
+} MATCH;
+
+typedef struct MATCHES
+{
+    UINT32 Count;
+
+    // Sorted from the closest match to the least close. Matches never overlap each other or the template.
+    MATCH* Matches;
+
+} MATCHES;
+
+
+// The sum of absolute differences between the color channels of two rows of pixels. Alpha is ignored.
+UINT32 GetRowDifference(_In_reads_(Count) const UINT32* A, _In_reads_(Count) const UINT32* B, _In_ INT32 Count);
+
+// The portable reference implementation of GetRowDifference.
+UINT32 GetRowDifferenceScalar(_In_reads_(Count) const UINT32* A, _In_reads_(Count) const UINT32* B, _In_ INT32 Count);
+
+// The normalized cross-correlation between the brightness of the Template rectangle and the same size
+// rectangle at X, Y. 1.0 is a perfect match. Returns 0 if either one is a flat color.
+double GetCorrelation(_In_reads_(Width * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ const RECT* Template, _In_ INT32 X, _In_ INT32 Y);
+
+// Finds the places in a top-down 32bpp image that look like the Template rectangle of the same image. Each
+// match's colors must be off by no more than MaxDifference per channel on average, and when MinCorrelation
+// is above 0, its brightness must correlate with the template at least that well. The search is done on a
+// smaller copy of the image first, so only the places that could possibly match are compared in full, and
+// it is split across threads. Free the result with FreeMatches. Returns FALSE if memory could not be allocated.
+BOOL FindTemplateMatches(
+    _In_reads_(Width * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ const RECT* Template,
+    _In_ UINT32 MaxDifference,
+    _In_ float MinCorrelation,
+    _Out_ MATCHES* Matches);
+
+void FreeMatches(_Inout_ MATCHES* Matches);
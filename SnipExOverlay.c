@@ -0,0 +1,298 @@
+// SnipExOverlay.c
+// Author: Joseph Ryan Ries, 2017-2020
+// The capture overlay as rectangles. Every pixel of the overlay is decided by which side of four lines it is on,
+// the edges of the selection, and two more lines just inside of them for the outline. So the lines of the old and
+// new selections together cut the screen into a small grid of cells, and every pixel in a cell changes or none do.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExOverlay.h"
+
+typedef struct OVERLAYSELECTION
+{
+    // Right side up, with right and bottom exclusive. Not clipped to the screen, so that an outline whose
+    // edge is off of the screen stays off of it.
+    RECT Rect;
+
+    // FALSE if the selection has no area, in which case the whole screen is dimmed.
+    BOOL HasArea;
+
+    BOOL Outlined;
+
+} OVERLAYSELECTION;
+
+
+static void NormalizeSelection(_In_ const RECT* Selection, _In_ BOOL Outlined, _Out_ OVERLAYSELECTION* Normalized)
+{
+    Normalized->Rect.left   = min(Selection->left, Selection->right);
+
+    Normalized->Rect.right  = max(Selection->left, Selection->right);
+
+    Normalized->Rect.top    = min(Selection->top, Selection->bottom);
+
+    Normalized->Rect.bottom = max(Selection->top, Selection->bottom);
+
+    Normalized->HasArea = (Normalized->Rect.left < Normalized->Rect.right && Normalized->Rect.top < Normalized->Rect.bottom);
+
+    Normalized->Outlined = Outlined;
+}
+
+
+static OVERLAYPIXEL ClassifyPixel(_In_ const OVERLAYSELECTION* Selection, _In_ INT32 X, _In_ INT32 Y)
+{
+    const RECT* Rect = &Selection->Rect;
+
+    if (Selection->HasArea == FALSE || X < Rect->left || X >= Rect->right || Y < Rect->top || Y >= Rect->bottom)
+    {
+        return OVERLAYPIXEL_DIMMED;
+    }
+
+    if (Selection->Outlined && (X == Rect->left || X == Rect->right - 1 || Y == Rect->top || Y == Rect->bottom - 1))
+    {
+        return OVERLAYPIXEL_OUTLINE;
+    }
+
+    return OVERLAYPIXEL_CLEAN;
+}
+
+
+// Adds Rect, clipped to the screen, unless there's nothing left of it.
+static void AddPiece(_Inout_ OVERLAYPIECE* Pieces, _Inout_ UINT32* Count, _In_ LONG Left, _In_ LONG Top, _In_ LONG Right, _In_ LONG Bottom, _In_ OVERLAYPIXEL Kind, _In_ INT32 Width, _In_ INT32 Height)
+{
+    RECT Rect = { max(Left, 0), max(Top, 0), min(Right, Width), min(Bottom, Height) };
+
+    if (Rect.left < Rect.right && Rect.top < Rect.bottom)
+    {
+        Pieces[*Count].Rect = Rect;
+
+        Pieces[*Count].Kind = Kind;
+
+        (*Count)++;
+    }
+}
+
+
+UINT32 GetOverlayPieces(_In_ const RECT* Selection, _In_ BOOL Outlined, _In_ INT32 Width, _In_ INT32 Height, _Out_writes_(OVERLAY_MAX_PIECES) OVERLAYPIECE* Pieces)
+{
+    OVERLAYSELECTION Normalized = { 0 };
+
+    UINT32 Count = 0;
+
+    NormalizeSelection(Selection, Outlined, &Normalized);
+
+    if (Normalized.HasArea == FALSE)
+    {
+        AddPiece(Pieces, &Count, 0, 0, Width, Height, OVERLAYPIXEL_DIMMED, Width, Height);
+
+        return Count;
+    }
+
+    LONG Left = Normalized.Rect.left;
+
+    LONG Top = Normalized.Rect.top;
+
+    LONG Right = Normalized.Rect.right;
+
+    LONG Bottom = Normalized.Rect.bottom;
+
+    AddPiece(Pieces, &Count, 0, 0, Width, Top, OVERLAYPIXEL_DIMMED, Width, Height);
+
+    AddPiece(Pieces, &Count, 0, Bottom, Width, Height, OVERLAYPIXEL_DIMMED, Width, Height);
+
+    AddPiece(Pieces, &Count, 0, Top, Left, Bottom, OVERLAYPIXEL_DIMMED, Width, Height);
+
+    AddPiece(Pieces, &Count, Right, Top, Width, Bottom, OVERLAYPIXEL_DIMMED, Width, Height);
+
+    if (Outlined == FALSE)
+    {
+        AddPiece(Pieces, &Count, Left, Top, Right, Bottom, OVERLAYPIXEL_CLEAN, Width, Height);
+
+        return Count;
+    }
+
+    // The top and bottom sides get the corners. A selection only 1 or 2 pixels across is all outline.
+    AddPiece(Pieces, &Count, Left, Top, Right, Top + 1, OVERLAYPIXEL_OUTLINE, Width, Height);
+
+    if (Bottom - 1 > Top)
+    {
+        AddPiece(Pieces, &Count, Left, Bottom - 1, Right, Bottom, OVERLAYPIXEL_OUTLINE, Width, Height);
+    }
+
+    AddPiece(Pieces, &Count, Left, Top + 1, Left + 1, Bottom - 1, OVERLAYPIXEL_OUTLINE, Width, Height);
+
+    if (Right - 1 > Left)
+    {
+        AddPiece(Pieces, &Count, Right - 1, Top + 1, Right, Bottom - 1, OVERLAYPIXEL_OUTLINE, Width, Height);
+    }
+
+    AddPiece(Pieces, &Count, Left + 1, Top + 1, Right - 1, Bottom - 1, OVERLAYPIXEL_CLEAN, Width, Height);
+
+    return Count;
+}
+
+
+// Adds the lines that Selection's pixels change on to Lines, clipped to 0 through Limit.
+static void AddSelectionLines(_Inout_ LONG* Lines, _Inout_ UINT32* Count, _In_ LONG Low, _In_ LONG High, _In_ LONG Limit)
+{
+    LONG Candidates[4] = { Low, Low + 1, High - 1, High };
+
+    for (UINT32 Index = 0; Index < _countof(Candidates); Index++)
+    {
+        Lines[(*Count)++] = max(0, min(Candidates[Index], Limit));
+    }
+}
+
+
+// Sorts Lines and removes the repeats. Returns how many are left. There are never more than 10, so this is
+// just an insertion sort.
+static UINT32 SortLines(_Inout_updates_(Count) LONG* Lines, _In_ UINT32 Count)
+{
+    UINT32 Unique = 0;
+
+    for (UINT32 Index = 1; Index < Count; Index++)
+    {
+        LONG Line = Lines[Index];
+
+        UINT32 Position = Index;
+
+        while (Position > 0 && Lines[Position - 1] > Line)
+        {
+            Lines[Position] = Lines[Position - 1];
+
+            Position--;
+        }
+
+        Lines[Position] = Line;
+    }
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        if (Unique == 0 || Lines[Unique - 1] != Lines[Index])
+        {
+            Lines[Unique++] = Lines[Index];
+        }
+    }
+
+    return Unique;
+}
+
+
+UINT32 GetOverlayDamage(
+    _In_ const RECT* OldSelection,
+    _In_ BOOL OldOutlined,
+    _In_ const RECT* NewSelection,
+    _In_ BOOL NewOutlined,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _Out_writes_(OVERLAY_MAX_DAMAGE) RECT* Damage)
+{
+    OVERLAYSELECTION Old = { 0 };
+
+    OVERLAYSELECTION New = { 0 };
+
+    LONG Columns[10] = { 0 };
+
+    LONG Rows[10] = { 0 };
+
+    UINT32 ColumnCount = 0;
+
+    UINT32 RowCount = 0;
+
+    UINT32 Count = 0;
+
+    if (Width <= 0 || Height <= 0)
+    {
+        return 0;
+    }
+
+    NormalizeSelection(OldSelection, OldOutlined, &Old);
+
+    NormalizeSelection(NewSelection, NewOutlined, &New);
+
+    Columns[ColumnCount++] = 0;
+
+    Columns[ColumnCount++] = Width;
+
+    Rows[RowCount++] = 0;
+
+    Rows[RowCount++] = Height;
+
+    if (Old.HasArea)
+    {
+        AddSelectionLines(Columns, &ColumnCount, Old.Rect.left, Old.Rect.right, Width);
+
+        AddSelectionLines(Rows, &RowCount, Old.Rect.top, Old.Rect.bottom, Height);
+    }
+
+    if (New.HasArea)
+    {
+        AddSelectionLines(Columns, &ColumnCount, New.Rect.left, New.Rect.right, Width);
+
+        AddSelectionLines(Rows, &RowCount, New.Rect.top, New.Rect.bottom, Height);
+    }
+
+    ColumnCount = SortLines(Columns, ColumnCount);
+
+    RowCount = SortLines(Rows, RowCount);
+
+    for (UINT32 Row = 0; Row + 1 < RowCount; Row++)
+    {
+        UINT32 Column = 0;
+
+        while (Column + 1 < ColumnCount)
+        {
+            // Cells are never empty, so the pixel at the top left of one stands for all of it.
+            if (ClassifyPixel(&Old, Columns[Column], Rows[Row]) == ClassifyPixel(&New, Columns[Column], Rows[Row]))
+            {
+                Column++;
+
+                continue;
+            }
+
+            UINT32 RunStart = Column;
+
+            while (Column + 1 < ColumnCount && ClassifyPixel(&Old, Columns[Column], Rows[Row]) != ClassifyPixel(&New, Columns[Column], Rows[Row]))
+            {
+                Column++;
+            }
+
+            RECT Run = { Columns[RunStart], Rows[Row], Columns[Column], Rows[Row + 1] };
+
+            BOOL Extended = FALSE;
+
+            // If the row of cells above had a run just like this one, make it taller instead of starting a new
+            // rectangle. Only rectangles that reach down to this row can match, however many there are above.
+            for (UINT32 Index = 0; Index < Count; Index++)
+            {
+                if (Damage[Index].left == Run.left && Damage[Index].right == Run.right && Damage[Index].bottom == Run.top)
+                {
+                    Damage[Index].bottom = Run.bottom;
+
+                    Extended = TRUE;
+
+                    break;
+                }
+            }
+
+            if (Extended == FALSE)
+            {
+                Damage[Count++] = Run;
+            }
+        }
+    }
+
+    return Count;
+}
@@ -0,0 +1,56 @@
+// SnipExOverlay.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Works out what the capture overlay looks like for a given selection, as a few rectangles that are each all
+// dimmed, all clean, or all outline, and which parts of the screen change when the selection does. The overlay
+// only repaints those parts while the user drags, instead of the whole desktop, which on a big multi-monitor
+// desktop is the difference between the rubber band keeping up with the mouse and lagging behind it.
+
+#pragma once
+
+// The most rectangles that make up the overlay: dimmed above, below, left and right of the selection, the
+// clean inside of it, and the four sides of its outline.
+#define OVERLAY_MAX_PIECES 9
+
+// The most rectangles that GetOverlayDamage can return. The edges of two selections cut the screen into at
+// most 9 x 9 cells, and each row of cells makes at most 5 runs of cells that changed.
+#define OVERLAY_MAX_DAMAGE 45
+
+typedef enum OVERLAYPIXEL
+{
+    // Copied from the dimmed copy of the screenshot.
+    OVERLAYPIXEL_DIMMED,
+
+    // Copied from the screenshot as it was taken.
+    OVERLAYPIXEL_CLEAN,
+
+    // Filled with black.
+    OVERLAYPIXEL_OUTLINE
+
+} OVERLAYPIXEL;
+
+typedef struct OVERLAYPIECE
+{
+    RECT         Rect;
+
+    OVERLAYPIXEL Kind;
+
+} OVERLAYPIECE;
+
+
+// Gets the rectangles that make up the overlay of a Width x Height screen when Selection is selected, with
+// a 1 pixel outline just inside of it if Outlined is TRUE. Selection can be upside down or back to front, the
+// way it was dragged. A selection with no area leaves the whole screen dimmed. No two pieces overlap, and
+// together they cover the whole screen exactly once. Returns how many there are.
+UINT32 GetOverlayPieces(_In_ const RECT* Selection, _In_ BOOL Outlined, _In_ INT32 Width, _In_ INT32 Height, _Out_writes_(OVERLAY_MAX_PIECES) OVERLAYPIECE* Pieces);
+
+// Gets rectangles that cover every pixel of a Width x Height screen that looks different with NewSelection
+// selected than with OldSelection selected, and nothing else. They don't overlap. Returns how many there are,
+// which is 0 if nothing changed.
+UINT32 GetOverlayDamage(
+    _In_ const RECT* OldSelection,
+    _In_ BOOL OldOutlined,
+    _In_ const RECT* NewSelection,
+    _In_ BOOL NewOutlined,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _Out_writes_(OVERLAY_MAX_DAMAGE) RECT* Damage);
@@ -0,0 +1,213 @@
+// SnipExPen.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Smoothing and simplifying for the freehand pen.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <math.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExPen.h"
+
+#define PEN_PI 3.14159265358979323846f
+
+// One span of the polyline that SimplifyPolyline still has to look at.
+typedef struct POLYLINESPAN
+{
+    UINT32 First;
+
+    UINT32 Last;
+
+} POLYLINESPAN;
+
+
+// How much of a new sample an exponential smoothing filter with the given cutoff frequency lets through.
+static float GetSmoothingFactor(_In_ float Cutoff, _In_ float Seconds)
+{
+    float TimeConstant = 1.0f / (2.0f * PEN_PI * Cutoff);
+
+    return 1.0f / (1.0f + TimeConstant / Seconds);
+}
+
+
+void ResetPenFilter(_Out_ PENFILTER* Filter)
+{
+    ZeroMemory(Filter, sizeof(PENFILTER));
+}
+
+
+RASTERPOINT FilterPenPoint(_Inout_ PENFILTER* Filter, _In_ RASTERPOINT Point, _In_ UINT32 Time)
+{
+    if (Filter->Started == FALSE)
+    {
+        Filter->Point = Point;
+
+        Filter->Time = Time;
+
+        Filter->Started = TRUE;
+
+        return Point;
+    }
+
+    // Unsigned, so that the message clock wrapping around doesn't matter. Samples that come in during the
+    // same millisecond are counted as a millisecond apart, rather than dividing by 0.
+    UINT32 Elapsed = max(Time - Filter->Time, 1);
+
+    float Seconds = (float)Elapsed / 1000.0f;
+
+    Filter->Time = Time;
+
+    float SpeedFactor = GetSmoothingFactor(PEN_FILTER_SPEED_CUTOFF, Seconds);
+
+    Filter->Speed.X += SpeedFactor * ((Point.X - Filter->Point.X) / Seconds - Filter->Speed.X);
+
+    Filter->Speed.Y += SpeedFactor * ((Point.Y - Filter->Point.Y) / Seconds - Filter->Speed.Y);
+
+    float Speed = sqrtf(Filter->Speed.X * Filter->Speed.X + Filter->Speed.Y * Filter->Speed.Y);
+
+    float Factor = GetSmoothingFactor(PEN_FILTER_MIN_CUTOFF + PEN_FILTER_BETA * Speed, Seconds);
+
+    Filter->Point.X += Factor * (Point.X - Filter->Point.X);
+
+    Filter->Point.Y += Factor * (Point.Y - Filter->Point.Y);
+
+    return Filter->Point;
+}
+
+
+// The distance from Point to the line segment from Start to End.
+static float GetDistanceToSegment(_In_ RASTERPOINT Point, _In_ RASTERPOINT Start, _In_ RASTERPOINT End)
+{
+    float DX = End.X - Start.X;
+
+    float DY = End.Y - Start.Y;
+
+    float LengthSquared = DX * DX + DY * DY;
+
+    float Along = 0.0f;
+
+    if (LengthSquared > 0.0f)
+    {
+        Along = ((Point.X - Start.X) * DX + (Point.Y - Start.Y) * DY) / LengthSquared;
+
+        Along = max(0.0f, min(1.0f, Along));
+    }
+
+    float X = Point.X - (Start.X + Along * DX);
+
+    float Y = Point.Y - (Start.Y + Along * DY);
+
+    return sqrtf(X * X + Y * Y);
+}
+
+
+UINT32 SimplifyPolyline(_Inout_updates_(Count) RASTERPOINT* Points, _In_ UINT32 Count, _In_ float Tolerance)
+{
+    if (Count < 3)
+    {
+        return Count;
+    }
+
+    // Which points to keep, and the spans still to look at. A span is only ever split in two, so there are never
+    // more spans waiting than there are points. Done with a list rather than recursion, since a long stroke
+    // could go thousands of calls deep.
+    UINT8* Keep = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)Count);
+
+    POLYLINESPAN* Spans = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Count * sizeof(POLYLINESPAN));
+
+    if (Keep == NULL || Spans == NULL)
+    {
+        if (Keep != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, Keep);
+        }
+
+        if (Spans != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, Spans);
+        }
+
+        return Count;
+    }
+
+    Keep[0] = TRUE;
+
+    Keep[Count - 1] = TRUE;
+
+    UINT32 SpanCount = 0;
+
+    Spans[SpanCount].First = 0;
+
+    Spans[SpanCount].Last = Count - 1;
+
+    SpanCount++;
+
+    while (SpanCount > 0)
+    {
+        POLYLINESPAN Span = Spans[--SpanCount];
+
+        float Farthest = 0.0f;
+
+        UINT32 FarthestIndex = 0;
+
+        for (UINT32 Index = Span.First + 1; Index < Span.Last; Index++)
+        {
+            float Distance = GetDistanceToSegment(Points[Index], Points[Span.First], Points[Span.Last]);
+
+            if (Distance > Farthest)
+            {
+                Farthest = Distance;
+
+                FarthestIndex = Index;
+            }
+        }
+
+        if (Farthest > Tolerance)
+        {
+            Keep[FarthestIndex] = TRUE;
+
+            Spans[SpanCount].First = Span.First;
+
+            Spans[SpanCount].Last = FarthestIndex;
+
+            SpanCount++;
+
+            Spans[SpanCount].First = FarthestIndex;
+
+            Spans[SpanCount].Last = Span.Last;
+
+            SpanCount++;
+        }
+    }
+
+    UINT32 Kept = 0;
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        if (Keep[Index])
+        {
+            Points[Kept++] = Points[Index];
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, Keep);
+
+    HeapFree(GetProcessHeap(), 0, Spans);
+
+    return Kept;
+}
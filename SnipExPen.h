@@ -0,0 +1,47 @@
+// SnipExPen.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Smoothing and simplifying for the freehand pen. Mouse samples are smoothed as they come in with a
+// 1 euro filter, which takes out the jitter when the mouse is moving slowly without lagging behind when
+// it's moving quickly. Once the stroke is done, its points are thinned out with Ramer-Douglas-Peucker.
+// Needs SnipExBlend.h and SnipExRaster.h to be included first.
+
+#pragma once
+
+// How much the pen is smoothed when the mouse is barely moving, as a cutoff frequency in Hz. Lower is smoother.
+#define PEN_FILTER_MIN_CUTOFF   3.0f
+
+// How quickly the smoothing lets up as the mouse speeds up, per pixel per second.
+#define PEN_FILTER_BETA         0.02f
+
+// The cutoff frequency, in Hz, that the mouse's speed is smoothed with before it's used to pick the cutoff.
+#define PEN_FILTER_SPEED_CUTOFF 1.0f
+
+// Points that are within this many pixels of the line through their neighbours are dropped when a stroke is simplified.
+#define PEN_SIMPLIFY_TOLERANCE  0.25f
+
+typedef struct PENFILTER
+{
+    // The last smoothed point.
+    RASTERPOINT Point;
+
+    // The smoothed speed of the mouse, in pixels per second.
+    RASTERPOINT Speed;
+
+    // When the last sample came in, in milliseconds.
+    UINT32      Time;
+
+    BOOL        Started;
+
+} PENFILTER;
+
+
+// Forgets the last stroke, so that the next sample starts a new one.
+void ResetPenFilter(_Out_ PENFILTER* Filter);
+
+// Takes a mouse sample, in pixels, and the time in milliseconds that it was taken at, such as from
+// GetMessageTime, and returns the smoothed point. The first sample of a stroke is returned as it is.
+RASTERPOINT FilterPenPoint(_Inout_ PENFILTER* Filter, _In_ RASTERPOINT Point, _In_ UINT32 Time);
+
+// Drops the points of a polyline that are within Tolerance pixels of the line that would be drawn without
+// them. The first and last points are always kept. Returns how many points are left, at the start of Points.
+UINT32 SimplifyPolyline(_Inout_updates_(Count) RASTERPOINT* Points, _In_ UINT32 Count, _In_ float Tolerance);
@@ -0,0 +1,914 @@
+// SnipExPng.c
+// Author: Joseph Ryan Ries, 2017-2020
+// A PNG reader. The image data is a zlib stream split across IDAT chunks, which are joined back together and
+// inflated in one go into a buffer that's exactly the size the header says it should be. Huffman codes of up to
+// PNG_FAST_BITS bits are decoded with one table lookup, and longer ones a bit at a time. Then each row has its
+// filter undone and is converted to BGRA.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <stdlib.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExPng.h"
+
+// Codes this many bits long or shorter are decoded with one lookup.
+#define PNG_FAST_BITS 10
+
+typedef struct HUFFMAN
+{
+    // For every PNG_FAST_BITS bits that could come next, the symbol that they start with shifted left by 4, plus
+    // the length of its code. 0 if the code is longer than PNG_FAST_BITS.
+    UINT16 Fast[1 << PNG_FAST_BITS];
+
+    // How many codes there are of each length, and the symbols, shortest code first.
+    UINT16 Counts[16];
+
+    UINT16 Symbols[288];
+
+} HUFFMAN;
+
+typedef struct INFLATE
+{
+    const UINT8* Input;
+
+    SIZE_T       InputSize;
+
+    SIZE_T       InputOffset;
+
+    // Bits that have been read but not used yet, first one lowest. The top PaddedBits of them are past the end
+    // of the input, and are only there so that a lookup near the end has something to look at.
+    UINT64       Bits;
+
+    UINT32       BitCount;
+
+    UINT32       PaddedBits;
+
+    UINT8*       Output;
+
+    SIZE_T       OutputSize;
+
+    SIZE_T       OutputOffset;
+
+    BOOL         Failed;
+
+} INFLATE;
+
+static const UINT16 gLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+static const UINT8 gLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+static const UINT16 gDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+static const UINT8 gDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// The order that the lengths of the code length code come in.
+static const UINT8 gCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static const UINT8 gPngSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+
+static UINT32 PeekBits(_Inout_ INFLATE* Inflate, _In_ UINT32 Count)
+{
+    while (Inflate->BitCount <= 56)
+    {
+        UINT64 Byte = 0;
+
+        if (Inflate->InputOffset < Inflate->InputSize)
+        {
+            Byte = Inflate->Input[Inflate->InputOffset++];
+        }
+        else
+        {
+            Inflate->PaddedBits += 8;
+        }
+
+        Inflate->Bits |= Byte << Inflate->BitCount;
+
+        Inflate->BitCount += 8;
+    }
+
+    return (UINT32)(Inflate->Bits & ((1ull << Count) - 1));
+}
+
+
+static void DropBits(_Inout_ INFLATE* Inflate, _In_ UINT32 Count)
+{
+    Inflate->Bits >>= Count;
+
+    Inflate->BitCount -= Count;
+
+    // Used up bits that were never in the input.
+    if (Inflate->PaddedBits > Inflate->BitCount)
+    {
+        Inflate->Failed = TRUE;
+    }
+}
+
+
+static UINT32 GetBits(_Inout_ INFLATE* Inflate, _In_ UINT32 Count)
+{
+    UINT32 Value = 0;
+
+    if (Count > 0)
+    {
+        Value = PeekBits(Inflate, Count);
+
+        DropBits(Inflate, Count);
+    }
+
+    return Value;
+}
+
+
+// Builds a canonical Huffman code from the code length of each of Count symbols. Returns FALSE if there are more
+// codes of some length than there's room for. A code with room left over is fine, as long as nothing uses it.
+static BOOL BuildHuffman(_Out_ HUFFMAN* Huffman, _In_reads_(Count) const UINT8* Lengths, _In_ UINT32 Count)
+{
+    UINT16 Offsets[16] = { 0 };
+
+    INT32 Left = 1;
+
+    UINT32 Code = 0;
+
+    ZeroMemory(Huffman, sizeof(HUFFMAN));
+
+    for (UINT32 Symbol = 0; Symbol < Count; Symbol++)
+    {
+        Huffman->Counts[Lengths[Symbol]]++;
+    }
+
+    Huffman->Counts[0] = 0;
+
+    for (UINT32 Length = 1; Length < 16; Length++)
+    {
+        Left = (Left << 1) - Huffman->Counts[Length];
+
+        if (Left < 0)
+        {
+            return FALSE;
+        }
+    }
+
+    for (UINT32 Length = 1; Length < 15; Length++)
+    {
+        Offsets[Length + 1] = Offsets[Length] + Huffman->Counts[Length];
+    }
+
+    for (UINT32 Symbol = 0; Symbol < Count; Symbol++)
+    {
+        if (Lengths[Symbol] != 0)
+        {
+            Huffman->Symbols[Offsets[Lengths[Symbol]]++] = (UINT16)Symbol;
+        }
+    }
+
+    // Codes are handed out shortest first, and in order of symbol within each length. They're stored first bit
+    // highest, but read first bit lowest, so each one is reversed to look it up.
+    for (UINT32 Length = 1, Index = 0; Length <= PNG_FAST_BITS; Length++)
+    {
+        for (UINT32 Number = 0; Number < Huffman->Counts[Length]; Number++, Index++, Code++)
+        {
+            UINT32 Reversed = 0;
+
+            for (UINT32 Bit = 0; Bit < Length; Bit++)
+            {
+                Reversed |= ((Code >> Bit) & 1) << (Length - 1 - Bit);
+            }
+
+            for (UINT32 Entry = Reversed; Entry < (1u << PNG_FAST_BITS); Entry += (1u << Length))
+            {
+                Huffman->Fast[Entry] = (UINT16)((Huffman->Symbols[Index] << 4) | Length);
+            }
+        }
+
+        Code <<= 1;
+    }
+
+    return TRUE;
+}
+
+
+static UINT32 DecodeSymbol(_Inout_ INFLATE* Inflate, _In_ const HUFFMAN* Huffman)
+{
+    UINT32 Entry = Huffman->Fast[PeekBits(Inflate, PNG_FAST_BITS)];
+
+    if (Entry != 0)
+    {
+        DropBits(Inflate, Entry & 15);
+
+        return Entry >> 4;
+    }
+
+    // A longer code. Go through it a bit at a time, counting up through the codes of each length.
+    INT32 Code = 0;
+
+    INT32 First = 0;
+
+    INT32 Index = 0;
+
+    for (UINT32 Length = 1; Length < 16; Length++)
+    {
+        Code |= (INT32)GetBits(Inflate, 1);
+
+        INT32 Count = Huffman->Counts[Length];
+
+        if (Code - Count < First)
+        {
+            return Huffman->Symbols[Index + (Code - First)];
+        }
+
+        Index += Count;
+
+        First = (First + Count) << 1;
+
+        Code <<= 1;
+    }
+
+    Inflate->Failed = TRUE;
+
+    return 0;
+}
+
+
+static BOOL InflateCodes(_Inout_ INFLATE* Inflate, _In_ const HUFFMAN* Literals, _In_ const HUFFMAN* Distances)
+{
+    while (Inflate->Failed == FALSE)
+    {
+        UINT32 Symbol = DecodeSymbol(Inflate, Literals);
+
+        if (Symbol < 256)
+        {
+            if (Inflate->OutputOffset >= Inflate->OutputSize)
+            {
+                return FALSE;
+            }
+
+            Inflate->Output[Inflate->OutputOffset++] = (UINT8)Symbol;
+
+            continue;
+        }
+
+        if (Symbol == 256)
+        {
+            return (Inflate->Failed == FALSE);
+        }
+
+        Symbol -= 257;
+
+        if (Symbol >= _countof(gLengthBase))
+        {
+            return FALSE;
+        }
+
+        SIZE_T Length = gLengthBase[Symbol] + GetBits(Inflate, gLengthExtra[Symbol]);
+
+        UINT32 DistanceSymbol = DecodeSymbol(Inflate, Distances);
+
+        if (DistanceSymbol >= _countof(gDistanceBase))
+        {
+            return FALSE;
+        }
+
+        SIZE_T Distance = gDistanceBase[DistanceSymbol] + GetBits(Inflate, gDistanceExtra[DistanceSymbol]);
+
+        if (Inflate->Failed || Distance > Inflate->OutputOffset || Length > Inflate->OutputSize - Inflate->OutputOffset)
+        {
+            return FALSE;
+        }
+
+        // The copy can overlap what it's copying, which is how runs are made. What has been copied so far repeats
+        // every Distance bytes, so each piece can be copied from twice as far back as the one before, and the
+        // pieces never overlap what they're copied from.
+        UINT8* Target = &Inflate->Output[Inflate->OutputOffset];
+
+        Inflate->OutputOffset += Length;
+
+        while (Length > 0)
+        {
+            SIZE_T Piece = min(Distance, Length);
+
+            CopyMemory(Target, Target - Distance, Piece);
+
+            Target += Piece;
+
+            Length -= Piece;
+
+            Distance += Piece;
+        }
+    }
+
+    return FALSE;
+}
+
+
+static BOOL InflateStored(_Inout_ INFLATE* Inflate)
+{
+    // Stored blocks start on a whole byte.
+    DropBits(Inflate, Inflate->BitCount & 7);
+
+    UINT32 Length = GetBits(Inflate, 16);
+
+    UINT32 Complement = GetBits(Inflate, 16);
+
+    if (Inflate->Failed || Length != (~Complement & 0xFFFF) || Length > Inflate->OutputSize - Inflate->OutputOffset)
+    {
+        return FALSE;
+    }
+
+    for (UINT32 Index = 0; Index < Length; Index++)
+    {
+        Inflate->Output[Inflate->OutputOffset++] = (UINT8)GetBits(Inflate, 8);
+    }
+
+    return (Inflate->Failed == FALSE);
+}
+
+
+static BOOL InflateFixed(_Inout_ INFLATE* Inflate)
+{
+    static HUFFMAN Literals;
+
+    static HUFFMAN Distances;
+
+    static BOOL Built;
+
+    // Built the first time, and the same after that, so it doesn't matter if two threads both build them.
+    if (Built == FALSE)
+    {
+        UINT8 Lengths[288] = { 0 };
+
+        for (UINT32 Symbol = 0; Symbol < 288; Symbol++)
+        {
+            Lengths[Symbol] = (Symbol < 144) ? 8 : (Symbol < 256) ? 9 : (Symbol < 280) ? 7 : 8;
+        }
+
+        BuildHuffman(&Literals, Lengths, 288);
+
+        for (UINT32 Symbol = 0; Symbol < 30; Symbol++)
+        {
+            Lengths[Symbol] = 5;
+        }
+
+        BuildHuffman(&Distances, Lengths, 30);
+
+        Built = TRUE;
+    }
+
+    return InflateCodes(Inflate, &Literals, &Distances);
+}
+
+
+static BOOL InflateDynamic(_Inout_ INFLATE* Inflate, _Inout_ HUFFMAN* Literals, _Inout_ HUFFMAN* Distances)
+{
+    UINT8 Lengths[288 + 32] = { 0 };
+
+    UINT32 LiteralCount = GetBits(Inflate, 5) + 257;
+
+    UINT32 DistanceCount = GetBits(Inflate, 5) + 1;
+
+    UINT32 CodeLengthCount = GetBits(Inflate, 4) + 4;
+
+    if (LiteralCount > 286 || DistanceCount > 30)
+    {
+        return FALSE;
+    }
+
+    for (UINT32 Index = 0; Index < CodeLengthCount; Index++)
+    {
+        Lengths[gCodeLengthOrder[Index]] = (UINT8)GetBits(Inflate, 3);
+    }
+
+    // The code length code goes in Literals for now, since it's built over straight after.
+    if (BuildHuffman(Literals, Lengths, 19) == FALSE)
+    {
+        return FALSE;
+    }
+
+    ZeroMemory(Lengths, sizeof(Lengths));
+
+    for (UINT32 Index = 0; Index < LiteralCount + DistanceCount && Inflate->Failed == FALSE; )
+    {
+        UINT32 Symbol = DecodeSymbol(Inflate, Literals);
+
+        UINT32 Repeat = 0;
+
+        UINT8 Length = 0;
+
+        if (Symbol < 16)
+        {
+            Lengths[Index++] = (UINT8)Symbol;
+
+            continue;
+        }
+
+        if (Symbol == 16)
+        {
+            if (Index == 0)
+            {
+                return FALSE;
+            }
+
+            Length = Lengths[Index - 1];
+
+            Repeat = 3 + GetBits(Inflate, 2);
+        }
+        else if (Symbol == 17)
+        {
+            Repeat = 3 + GetBits(Inflate, 3);
+        }
+        else
+        {
+            Repeat = 11 + GetBits(Inflate, 7);
+        }
+
+        if (Index + Repeat > LiteralCount + DistanceCount)
+        {
+            return FALSE;
+        }
+
+        while (Repeat-- > 0)
+        {
+            Lengths[Index++] = Length;
+        }
+    }
+
+    // Without a code for the end of the block, it would never end.
+    if (Inflate->Failed || Lengths[256] == 0)
+    {
+        return FALSE;
+    }
+
+    if (BuildHuffman(Literals, Lengths, LiteralCount) == FALSE || BuildHuffman(Distances, &Lengths[LiteralCount], DistanceCount) == FALSE)
+    {
+        return FALSE;
+    }
+
+    return InflateCodes(Inflate, Literals, Distances);
+}
+
+
+// Inflates the zlib stream in Input into exactly OutputSize bytes of Output.
+static BOOL InflateZlib(_In_reads_bytes_(InputSize) const UINT8* Input, _In_ SIZE_T InputSize, _Out_writes_bytes_(OutputSize) UINT8* Output, _In_ SIZE_T OutputSize)
+{
+    INFLATE Inflate = { 0 };
+
+    HUFFMAN* Tables = NULL;
+
+    BOOL Result = FALSE;
+
+    BOOL Final = FALSE;
+
+    // No preset dictionary, and the header's check bits have to add up.
+    if (InputSize < 6 || (Input[0] & 0x0F) != 8 || (Input[1] & 0x20) != 0 || ((Input[0] << 8) | Input[1]) % 31 != 0)
+    {
+        return FALSE;
+    }
+
+    if ((Tables = HeapAlloc(GetProcessHeap(), 0, 2 * sizeof(HUFFMAN))) == NULL)
+    {
+        return FALSE;
+    }
+
+    Inflate.Input = Input + 2;
+
+    Inflate.InputSize = InputSize - 2;
+
+    Inflate.Output = Output;
+
+    Inflate.OutputSize = OutputSize;
+
+    while (Final == FALSE)
+    {
+        Final = (BOOL)GetBits(&Inflate, 1);
+
+        UINT32 Type = GetBits(&Inflate, 2);
+
+        BOOL BlockResult = FALSE;
+
+        if (Inflate.Failed)
+        {
+            goto Exit;
+        }
+
+        switch (Type)
+        {
+            case 0:
+            {
+                BlockResult = InflateStored(&Inflate);
+
+                break;
+            }
+            case 1:
+            {
+                BlockResult = InflateFixed(&Inflate);
+
+                break;
+            }
+            case 2:
+            {
+                BlockResult = InflateDynamic(&Inflate, &Tables[0], &Tables[1]);
+
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+
+        if (BlockResult == FALSE)
+        {
+            goto Exit;
+        }
+    }
+
+    if (Inflate.OutputOffset != OutputSize)
+    {
+        goto Exit;
+    }
+
+    // The Adler-32 of the output comes after the last block, on a whole byte, high byte first.
+    DropBits(&Inflate, Inflate.BitCount & 7);
+
+    UINT32 Expected = GetBits(&Inflate, 8) << 24;
+
+    Expected |= GetBits(&Inflate, 8) << 16;
+
+    Expected |= GetBits(&Inflate, 8) << 8;
+
+    Expected |= GetBits(&Inflate, 8);
+
+    UINT32 Low = 1;
+
+    UINT32 High = 0;
+
+    for (SIZE_T Offset = 0; Offset < OutputSize; )
+    {
+        // 5552 bytes is as many as can be added up before the sums have to be brought back down.
+        SIZE_T End = min(Offset + 5552, OutputSize);
+
+        for (; Offset < End; Offset++)
+        {
+            Low += Output[Offset];
+
+            High += Low;
+        }
+
+        Low %= 65521;
+
+        High %= 65521;
+    }
+
+    Result = (Inflate.Failed == FALSE && Expected == ((High << 16) | Low));
+
+Exit:
+
+    HeapFree(GetProcessHeap(), 0, Tables);
+
+    return Result;
+}
+
+
+static UINT32 ReadBigEndian32(_In_reads_bytes_(4) const UINT8* Bytes)
+{
+    return ((UINT32)Bytes[0] << 24) | ((UINT32)Bytes[1] << 16) | ((UINT32)Bytes[2] << 8) | Bytes[3];
+}
+
+
+static UINT8 PaethPredictor(_In_ INT32 Left, _In_ INT32 Above, _In_ INT32 AboveLeft)
+{
+    INT32 Estimate = Left + Above - AboveLeft;
+
+    INT32 ToLeft = abs(Estimate - Left);
+
+    INT32 ToAbove = abs(Estimate - Above);
+
+    INT32 ToAboveLeft = abs(Estimate - AboveLeft);
+
+    if (ToLeft <= ToAbove && ToLeft <= ToAboveLeft)
+    {
+        return (UINT8)Left;
+    }
+
+    return (UINT8)((ToAbove <= ToAboveLeft) ? Above : AboveLeft);
+}
+
+
+// Undoes Filter on the Count bytes of Row in place. Above is the row above, already undone, or NULL for the first
+// row, which acts as if it had a row of 0s above it. The filter is picked once per row, not once per byte.
+static BOOL UnfilterRow(_Inout_updates_(Count) UINT8* Row, _In_opt_ const UINT8* Above, _In_ SIZE_T Count, _In_ UINT32 Channels, _In_ UINT8 Filter)
+{
+    SIZE_T First = min(Count, Channels);
+
+    switch (Filter)
+    {
+        case 0:
+        {
+            return TRUE;
+        }
+        case 1:
+        {
+            for (SIZE_T Index = Channels; Index < Count; Index++)
+            {
+                Row[Index] = (UINT8)(Row[Index] + Row[Index - Channels]);
+            }
+
+            return TRUE;
+        }
+        case 2:
+        {
+            if (Above != NULL)
+            {
+                for (SIZE_T Index = 0; Index < Count; Index++)
+                {
+                    Row[Index] = (UINT8)(Row[Index] + Above[Index]);
+                }
+            }
+
+            return TRUE;
+        }
+        case 3:
+        {
+            for (SIZE_T Index = 0; Index < First; Index++)
+            {
+                Row[Index] = (UINT8)(Row[Index] + ((Above != NULL) ? (Above[Index] >> 1) : 0));
+            }
+
+            for (SIZE_T Index = First; Index < Count; Index++)
+            {
+                Row[Index] = (UINT8)(Row[Index] + ((Row[Index - Channels] + ((Above != NULL) ? Above[Index] : 0)) >> 1));
+            }
+
+            return TRUE;
+        }
+        case 4:
+        {
+            // With no row above, Paeth always picks the left byte, the same as Sub.
+            if (Above == NULL)
+            {
+                return UnfilterRow(Row, NULL, Count, Channels, 1);
+            }
+
+            for (SIZE_T Index = 0; Index < First; Index++)
+            {
+                Row[Index] = (UINT8)(Row[Index] + PaethPredictor(0, Above[Index], 0));
+            }
+
+            for (SIZE_T Index = First; Index < Count; Index++)
+            {
+                Row[Index] = (UINT8)(Row[Index] + PaethPredictor(Row[Index - Channels], Above[Index], Above[Index - Channels]));
+            }
+
+            return TRUE;
+        }
+        default:
+        {
+            return FALSE;
+        }
+    }
+}
+
+
+// Converts Width pixels of Channels bytes each, gray, gray and alpha, RGB or RGBA, to BGRA.
+static void ConvertRow(_In_ const UINT8* Row, _Out_writes_(Width) UINT32* Target, _In_ UINT32 Width, _In_ UINT32 Channels)
+{
+    switch (Channels)
+    {
+        case 1:
+        {
+            for (UINT32 X = 0; X < Width; X++)
+            {
+                Target[X] = 0xFF000000 | ((UINT32)Row[X] * 0x010101);
+            }
+
+            break;
+        }
+        case 2:
+        {
+            for (UINT32 X = 0; X < Width; X++)
+            {
+                Target[X] = ((UINT32)Row[X * 2 + 1] << 24) | ((UINT32)Row[X * 2] * 0x010101);
+            }
+
+            break;
+        }
+        case 3:
+        {
+            for (UINT32 X = 0; X < Width; X++)
+            {
+                Target[X] = 0xFF000000 | ((UINT32)Row[X * 3] << 16) | ((UINT32)Row[X * 3 + 1] << 8) | Row[X * 3 + 2];
+            }
+
+            break;
+        }
+        default:
+        {
+            for (UINT32 X = 0; X < Width; X++)
+            {
+                Target[X] = ((UINT32)Row[X * 4 + 3] << 24) | ((UINT32)Row[X * 4] << 16) | ((UINT32)Row[X * 4 + 1] << 8) | Row[X * 4 + 2];
+            }
+
+            break;
+        }
+    }
+}
+
+
+BOOL IsPng(_In_reads_bytes_(Size) const UINT8* Data, _In_ SIZE_T Size)
+{
+    return (Size >= sizeof(gPngSignature) && memcmp(Data, gPngSignature, sizeof(gPngSignature)) == 0);
+}
+
+
+BOOL DecodePng(_In_reads_bytes_(Size) const UINT8* Data, _In_ SIZE_T Size, _Out_ UINT32** Pixels, _Out_ INT32* Width, _Out_ INT32* Height)
+{
+    BOOL Result = FALSE;
+
+    UINT8* Compressed = NULL;
+
+    SIZE_T CompressedSize = 0;
+
+    UINT8* Raw = NULL;
+
+    UINT32* Image = NULL;
+
+    UINT32 ImageWidth = 0;
+
+    UINT32 ImageHeight = 0;
+
+    UINT32 Channels = 0;
+
+    *Pixels = NULL;
+
+    *Width = 0;
+
+    *Height = 0;
+
+    if (IsPng(Data, Size) == FALSE)
+    {
+        return FALSE;
+    }
+
+    // Everything in the file but the image data can be skipped, so all that's needed from the chunks is the
+    // header and the IDATs, which are joined together in the order they come.
+    if ((Compressed = HeapAlloc(GetProcessHeap(), 0, Size)) == NULL)
+    {
+        return FALSE;
+    }
+
+    for (SIZE_T Offset = sizeof(gPngSignature); ; )
+    {
+        if (Size - Offset < 12)
+        {
+            goto Exit;
+        }
+
+        UINT32 Length = ReadBigEndian32(&Data[Offset]);
+
+        const UINT8* Type = &Data[Offset + 4];
+
+        const UINT8* Chunk = &Data[Offset + 8];
+
+        if (Length > Size - Offset - 12)
+        {
+            goto Exit;
+        }
+
+        if (memcmp(Type, "IHDR", 4) == 0)
+        {
+            if (Length != 13)
+            {
+                goto Exit;
+            }
+
+            ImageWidth = ReadBigEndian32(&Chunk[0]);
+
+            ImageHeight = ReadBigEndian32(&Chunk[4]);
+
+            // 8 bits per channel, the usual compression and filters, and not interlaced.
+            if (Chunk[8] != 8 || Chunk[10] != 0 || Chunk[11] != 0 || Chunk[12] != 0)
+            {
+                goto Exit;
+            }
+
+            switch (Chunk[9])
+            {
+                case 0:
+                {
+                    Channels = 1;
+
+                    break;
+                }
+                case 2:
+                {
+                    Channels = 3;
+
+                    break;
+                }
+                case 4:
+                {
+                    Channels = 2;
+
+                    break;
+                }
+                case 6:
+                {
+                    Channels = 4;
+
+                    break;
+                }
+                default:
+                {
+                    goto Exit;
+                }
+            }
+        }
+        else if (memcmp(Type, "IDAT", 4) == 0)
+        {
+            CopyMemory(&Compressed[CompressedSize], Chunk, Length);
+
+            CompressedSize += Length;
+        }
+        else if (memcmp(Type, "IEND", 4) == 0)
+        {
+            break;
+        }
+
+        Offset += (SIZE_T)Length + 12;
+    }
+
+    if (Channels == 0 || ImageWidth == 0 || ImageHeight == 0 || ImageWidth > PNG_MAX_DIMENSION || ImageHeight > PNG_MAX_DIMENSION)
+    {
+        goto Exit;
+    }
+
+    // Each row starts with the byte that says which filter it has.
+    SIZE_T RowBytes = (SIZE_T)ImageWidth * Channels + 1;
+
+    SIZE_T RawSize = RowBytes * ImageHeight;
+
+    if ((Raw = HeapAlloc(GetProcessHeap(), 0, RawSize)) == NULL || (Image = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)ImageWidth * ImageHeight * sizeof(UINT32))) == NULL)
+    {
+        goto Exit;
+    }
+
+    if (InflateZlib(Compressed, CompressedSize, Raw, RawSize) == FALSE)
+    {
+        goto Exit;
+    }
+
+    for (UINT32 Y = 0; Y < ImageHeight; Y++)
+    {
+        UINT8* Row = &Raw[Y * RowBytes + 1];
+
+        SIZE_T Count = RowBytes - 1;
+
+        if (UnfilterRow(Row, (Y > 0) ? &Raw[(Y - 1) * RowBytes + 1] : NULL, Count, Channels, Row[-1]) == FALSE)
+        {
+            goto Exit;
+        }
+
+        ConvertRow(Row, &Image[(SIZE_T)Y * ImageWidth], ImageWidth, Channels);
+    }
+
+    *Pixels = Image;
+
+    *Width = (INT32)ImageWidth;
+
+    *Height = (INT32)ImageHeight;
+
+    Image = NULL;
+
+    Result = TRUE;
+
+Exit:
+
+    if (Compressed != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Compressed);
+    }
+
+    if (Raw != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Raw);
+    }
+
+    if (Image != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Image);
+    }
+
+    return Result;
+}
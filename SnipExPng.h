@@ -0,0 +1,19 @@
+// SnipExPng.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Reads PNG files into 32bpp BGRA pixels, without GDI+ or anything else from Windows, so that frames saved as PNG
+// can be replayed anywhere. Only what screenshots are saved as is supported: 8 bits per channel, gray, gray and
+// alpha, RGB or RGBA, not interlaced.
+
+#pragma once
+
+// The widest or tallest image that will be read.
+#define PNG_MAX_DIMENSION 65536
+
+
+// Decodes the PNG file in the Size bytes of Data into Width x Height top-down BGRA pixels, which the caller frees
+// with HeapFree. Images without alpha come out opaque. Returns FALSE if it isn't a PNG, it's damaged, it's a kind
+// of PNG that isn't supported, or memory could not be allocated.
+BOOL DecodePng(_In_reads_bytes_(Size) const UINT8* Data, _In_ SIZE_T Size, _Out_ UINT32** Pixels, _Out_ INT32* Width, _Out_ INT32* Height);
+
+// Returns TRUE if the Size bytes of Data start with the PNG signature.
+BOOL IsPng(_In_reads_bytes_(Size) const UINT8* Data, _In_ SIZE_T Size);
@@ -0,0 +1,1018 @@
+// SnipExRaster.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Anti-aliased shape rasterizer. Polygons are broken into the pieces of their edges that fall in each
+// pixel, each piece adds the exact area to its right into a row of coverage cells, and a running sum
+// along the row then gives the coverage of every pixel, which is blended in with BlendSpan.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <math.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#define RASTER_MAX_POLYGONS 8
+
+// Corners further out than this many pixels are pulled in, so that the math on them can't overflow.
+#define RASTER_MAX_COORDINATE (1 << 20)
+
+#define RASTER_PI 3.14159265358979323846
+
+// A polygon corner on the 1/RASTER_SUBPIXELS pixel grid.
+typedef struct FIXEDPOINT
+{
+    INT32 X;
+
+    INT32 Y;
+
+} FIXEDPOINT;
+
+typedef struct RASTERPATH
+{
+    FIXEDPOINT Points[RASTER_MAX_POINTS];
+
+    UINT32     PointCount;
+
+    // Where each polygon ends in Points.
+    UINT32     Ends[RASTER_MAX_POLYGONS];
+
+    UINT32     PolygonCount;
+
+    // Set if the shape had too many corners or polygons, in which case it isn't drawn at all.
+    BOOL       Overflowed;
+
+} RASTERPATH;
+
+// The rows that are being filled right now, and the coverage cells that go with them.
+typedef struct RASTERBAND
+{
+    // One row of Right - Left + 1 cells for each row of the band. The extra cell at the end of each row
+    // catches what spills over from the last pixel.
+    INT32* Cells;
+
+    INT32  Stride;
+
+    INT32  Left;
+
+    INT32  Right;
+
+    INT32  Top;
+
+    INT32  Bottom;
+
+} RASTERBAND;
+
+
+// C division rounds toward zero. This rounds toward negative infinity. Denominator must not be 0.
+static INT64 FloorDivide(_In_ INT64 Numerator, _In_ INT64 Denominator)
+{
+    if (Denominator < 0)
+    {
+        Numerator = -Numerator;
+
+        Denominator = -Denominator;
+    }
+
+    INT64 Quotient = Numerator / Denominator;
+
+    if ((Numerator % Denominator) != 0 && Numerator < 0)
+    {
+        Quotient--;
+    }
+
+    return Quotient;
+}
+
+
+static INT32 ToFixed(_In_ double Value)
+{
+    Value *= RASTER_SUBPIXELS;
+
+    // Written so that NaN ends up clamped too.
+    if (!(Value > -(double)RASTER_MAX_COORDINATE * RASTER_SUBPIXELS))
+    {
+        Value = -(double)RASTER_MAX_COORDINATE * RASTER_SUBPIXELS;
+    }
+
+    if (Value > (double)RASTER_MAX_COORDINATE * RASTER_SUBPIXELS)
+    {
+        Value = (double)RASTER_MAX_COORDINATE * RASTER_SUBPIXELS;
+    }
+
+    return (INT32)floor(Value + 0.5);
+}
+
+
+// sin and cos from 0 to pi/2, with only adds and multiplies so that they give the same answer on every
+// CPU and C runtime. The series are good to better than 1e-11 across the whole range.
+static void GetSineAndCosine(_In_ double Angle, _Out_ double* Sine, _Out_ double* Cosine)
+{
+    double Square = Angle * Angle;
+
+    double SineSum = 1.0;
+
+    double CosineSum = 1.0;
+
+    for (int Term = 16; Term >= 2; Term -= 2)
+    {
+        SineSum = 1.0 - SineSum * Square / ((double)Term * (Term + 1));
+
+        CosineSum = 1.0 - CosineSum * Square / ((double)(Term - 1) * Term);
+    }
+
+    *Sine = Angle * SineSum;
+
+    *Cosine = CosineSum;
+}
+
+
+static void BeginPath(_Out_ RASTERPATH* Path)
+{
+    Path->PointCount = 0;
+
+    Path->PolygonCount = 0;
+
+    Path->Overflowed = FALSE;
+}
+
+
+static void AddCorner(_Inout_ RASTERPATH* Path, _In_ double X, _In_ double Y)
+{
+    if (Path->PointCount == RASTER_MAX_POINTS)
+    {
+        Path->Overflowed = TRUE;
+
+        return;
+    }
+
+    Path->Points[Path->PointCount].X = ToFixed(X);
+
+    Path->Points[Path->PointCount].Y = ToFixed(Y);
+
+    Path->PointCount++;
+}
+
+
+// Closes the polygon made of the corners added since the last one. Every polygon is turned to go around
+// the same way, except holes, which go around the other way, so that overlapping polygons add up and
+// holes take away.
+static void EndPolygon(_Inout_ RASTERPATH* Path, _In_ BOOL Hole)
+{
+    UINT32 First = (Path->PolygonCount == 0) ? 0 : Path->Ends[Path->PolygonCount - 1];
+
+    UINT32 Count = Path->PointCount - First;
+
+    if (Count < 3 || Path->Overflowed)
+    {
+        Path->PointCount = First;
+
+        return;
+    }
+
+    if (Path->PolygonCount == RASTER_MAX_POLYGONS)
+    {
+        Path->Overflowed = TRUE;
+
+        return;
+    }
+
+    FIXEDPOINT* Points = &Path->Points[First];
+
+    INT64 TwiceArea = 0;
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        FIXEDPOINT A = Points[Index];
+
+        FIXEDPOINT B = Points[(Index + 1) % Count];
+
+        TwiceArea += (INT64)A.X * B.Y - (INT64)B.X * A.Y;
+    }
+
+    if ((TwiceArea < 0) != (Hole == TRUE))
+    {
+        for (UINT32 Index = 0; Index < Count / 2; Index++)
+        {
+            FIXEDPOINT Swap = Points[Index];
+
+            Points[Index] = Points[Count - 1 - Index];
+
+            Points[Count - 1 - Index] = Swap;
+        }
+    }
+
+    Path->Ends[Path->PolygonCount++] = Path->PointCount;
+}
+
+
+// Adds a piece of an edge that lies entirely within one pixel column and one row. Whatever is to the
+// right of the piece in its own pixel is covered by the fraction of the pixel that is right of the piece,
+// and the running sum carries the whole piece's height on to every pixel further right.
+static __forceinline void AddPiece(_Inout_ INT32* Cells, _In_ const RASTERBAND* Band, _In_ INT32 Column, _In_ INT32 X0, _In_ INT32 X1, _In_ INT32 Height)
+{
+    if (Column >= Band->Right || Height == 0)
+    {
+        return;
+    }
+
+    // From 0 when the piece is on the pixel's left edge to 2 * RASTER_SUBPIXELS when it's on the right edge.
+    INT32 Offset = X0 + X1 - 2 * Column * RASTER_SUBPIXELS;
+
+    Cells[Column - Band->Left] += Height * (2 * RASTER_SUBPIXELS - Offset);
+
+    Cells[Column - Band->Left + 1] += Height * Offset;
+}
+
+
+static INT32 GetYAtX(_In_ INT32 XA, _In_ INT32 YA, _In_ INT32 XB, _In_ INT32 YB, _In_ INT32 X)
+{
+    INT64 Y = YA + FloorDivide((INT64)(YB - YA) * (X - XA), XB - XA);
+
+    return (INT32)max(min(Y, (INT64)max(YA, YB)), (INT64)min(YA, YB));
+}
+
+
+// Adds the part of an edge from A to B that lies within pixel row Row. YA must not be below YB.
+// Direction is 1 for an edge going down and -1 for an edge going up.
+static void AddRowSegment(_Inout_ RASTERBAND* Band, _In_ INT32 Row, _In_ INT32 XA, _In_ INT32 YA, _In_ INT32 XB, _In_ INT32 YB, _In_ INT32 Direction)
+{
+    INT32* Cells = &Band->Cells[(SIZE_T)(Row - Band->Top) * Band->Stride];
+
+    // Every crossing is worked out from the ends the segment came in with, so that where the band is
+    // clipped never moves a crossing, and a pixel comes out the same no matter what else is drawn with it.
+    const INT32 X0 = XA;
+
+    const INT32 Y0 = YA;
+
+    const INT32 X1 = XB;
+
+    const INT32 Y1 = YB;
+
+    INT32 LeftEdge = Band->Left * RASTER_SUBPIXELS;
+
+    INT32 RightEdge = Band->Right * RASTER_SUBPIXELS;
+
+    // Anything left of the band covers the whole row from the band's first pixel on, so it all goes into the
+    // first cell. Anything right of the band doesn't cover any of it.
+    if (min(XA, XB) < LeftEdge)
+    {
+        if (max(XA, XB) <= LeftEdge)
+        {
+            Cells[0] += Direction * (YB - YA) * 2 * RASTER_SUBPIXELS;
+
+            return;
+        }
+
+        INT32 YCross = GetYAtX(X0, Y0, X1, Y1, LeftEdge);
+
+        if (XA < LeftEdge)
+        {
+            Cells[0] += Direction * (YCross - YA) * 2 * RASTER_SUBPIXELS;
+
+            XA = LeftEdge;
+
+            YA = YCross;
+        }
+        else
+        {
+            Cells[0] += Direction * (YB - YCross) * 2 * RASTER_SUBPIXELS;
+
+            XB = LeftEdge;
+
+            YB = YCross;
+        }
+    }
+
+    if (max(XA, XB) > RightEdge)
+    {
+        if (min(XA, XB) >= RightEdge)
+        {
+            return;
+        }
+
+        INT32 YCross = GetYAtX(X0, Y0, X1, Y1, RightEdge);
+
+        if (XA > RightEdge)
+        {
+            XA = RightEdge;
+
+            YA = YCross;
+        }
+        else
+        {
+            XB = RightEdge;
+
+            YB = YCross;
+        }
+    }
+
+    // Walk from A to B one pixel column at a time.
+    INT32 X = XA;
+
+    INT32 Y = YA;
+
+    for (;;)
+    {
+        INT32 Column = 0;
+
+        INT32 EndX = XB;
+
+        INT32 EndY = YB;
+
+        if (XB > X)
+        {
+            Column = (INT32)FloorDivide(X, RASTER_SUBPIXELS);
+
+            if (XB > (Column + 1) * RASTER_SUBPIXELS)
+            {
+                EndX = (Column + 1) * RASTER_SUBPIXELS;
+
+                EndY = GetYAtX(X0, Y0, X1, Y1, EndX);
+            }
+        }
+        else if (XB < X)
+        {
+            Column = (INT32)FloorDivide(X - 1, RASTER_SUBPIXELS);
+
+            if (XB < Column * RASTER_SUBPIXELS)
+            {
+                EndX = Column * RASTER_SUBPIXELS;
+
+                EndY = GetYAtX(X0, Y0, X1, Y1, EndX);
+            }
+        }
+        else
+        {
+            Column = (INT32)FloorDivide(X, RASTER_SUBPIXELS);
+        }
+
+        AddPiece(Cells, Band, Column, X, EndX, Direction * (EndY - Y));
+
+        if (EndX == XB)
+        {
+            break;
+        }
+
+        X = EndX;
+
+        Y = EndY;
+    }
+}
+
+
+static void AddEdge(_Inout_ RASTERBAND* Band, _In_ FIXEDPOINT P0, _In_ FIXEDPOINT P1)
+{
+    if (P0.Y == P1.Y)
+    {
+        return;
+    }
+
+    INT32 Direction = 1;
+
+    if (P0.Y > P1.Y)
+    {
+        FIXEDPOINT Swap = P0;
+
+        P0 = P1;
+
+        P1 = Swap;
+
+        Direction = -1;
+    }
+
+    INT32 Top = max(P0.Y, Band->Top * RASTER_SUBPIXELS);
+
+    INT32 Bottom = min(P1.Y, Band->Bottom * RASTER_SUBPIXELS);
+
+    INT32 Y = Top;
+
+    INT32 X = P0.X + (INT32)FloorDivide((INT64)(P1.X - P0.X) * (Y - P0.Y), P1.Y - P0.Y);
+
+    while (Y < Bottom)
+    {
+        INT32 Row = (INT32)FloorDivide(Y, RASTER_SUBPIXELS);
+
+        INT32 NextY = min((Row + 1) * RASTER_SUBPIXELS, Bottom);
+
+        INT32 NextX = P0.X + (INT32)FloorDivide((INT64)(P1.X - P0.X) * (NextY - P0.Y), P1.Y - P0.Y);
+
+        AddRowSegment(Band, Row, X, Y, NextX, NextY, Direction);
+
+        X = NextX;
+
+        Y = NextY;
+    }
+}
+
+
+static void ResolveCoverageFrom(_Inout_updates_(Count + 1) INT32* Cells, _Out_writes_(Count) UINT8* Alpha, _In_ UINT32 Count, _In_ INT32 Sum)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        Sum += Cells[Index];
+
+        Cells[Index] = 0;
+
+        // Polygons that overlap add up past full coverage, and holes go negative, so clamp the magnitude.
+        UINT32 Coverage = (UINT32)min(abs(Sum), RASTER_FULL_COVERAGE);
+
+        Alpha[Index] = (UINT8)((Coverage * 255 + RASTER_FULL_COVERAGE / 2) >> 17);
+    }
+
+    Cells[Count] = 0;
+}
+
+
+void ResolveCoverageScalar(_Inout_updates_(Count + 1) INT32* Cells, _Out_writes_(Count) UINT8* Alpha, _In_ UINT32 Count)
+{
+    ResolveCoverageFrom(Cells, Alpha, Count, 0);
+}
+
+
+void ResolveCoverage(_Inout_updates_(Count + 1) INT32* Cells, _Out_writes_(Count) UINT8* Alpha, _In_ UINT32 Count)
+{
+    UINT32 Index = 0;
+
+    INT32 Sum = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i Full = _mm_set1_epi32(RASTER_FULL_COVERAGE);
+
+    __m128i Half = _mm_set1_epi32(RASTER_FULL_COVERAGE / 2);
+
+    __m128i Carry = Zero;
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        __m128i Sums = _mm_loadu_si128((const __m128i*)&Cells[Index]);
+
+        _mm_storeu_si128((__m128i*)&Cells[Index], Zero);
+
+        // Running sum within the four lanes, then add on everything before them.
+        Sums = _mm_add_epi32(Sums, _mm_slli_si128(Sums, 4));
+
+        Sums = _mm_add_epi32(Sums, _mm_slli_si128(Sums, 8));
+
+        Sums = _mm_add_epi32(Sums, Carry);
+
+        Carry = _mm_shuffle_epi32(Sums, _MM_SHUFFLE(3, 3, 3, 3));
+
+        // SSE2 has no 32-bit abs, min or multiply, so they're done the long way.
+        __m128i Sign = _mm_srai_epi32(Sums, 31);
+
+        __m128i Coverage = _mm_sub_epi32(_mm_xor_si128(Sums, Sign), Sign);
+
+        __m128i Over = _mm_cmpgt_epi32(Coverage, Full);
+
+        Coverage = _mm_or_si128(_mm_andnot_si128(Over, Coverage), _mm_and_si128(Over, Full));
+
+        Coverage = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(Coverage, 8), Coverage), Half), 17);
+
+        Coverage = _mm_packs_epi32(Coverage, Coverage);
+
+        Coverage = _mm_packus_epi16(Coverage, Coverage);
+
+        UINT32 Bytes = (UINT32)_mm_cvtsi128_si32(Coverage);
+
+        CopyMemory(&Alpha[Index], &Bytes, sizeof(Bytes));
+    }
+
+    Sum = _mm_cvtsi128_si32(Carry);
+#elif defined(_M_ARM64)
+    int32x4_t Zero = vdupq_n_s32(0);
+
+    int32x4_t Carry = Zero;
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        int32x4_t Sums = vld1q_s32(&Cells[Index]);
+
+        vst1q_s32(&Cells[Index], Zero);
+
+        Sums = vaddq_s32(Sums, vextq_s32(Zero, Sums, 3));
+
+        Sums = vaddq_s32(Sums, vextq_s32(Zero, Sums, 2));
+
+        Sums = vaddq_s32(Sums, Carry);
+
+        Carry = vdupq_laneq_s32(Sums, 3);
+
+        uint32x4_t Coverage = vminq_u32(vreinterpretq_u32_s32(vabsq_s32(Sums)), vdupq_n_u32(RASTER_FULL_COVERAGE));
+
+        Coverage = vshrq_n_u32(vmlaq_n_u32(vdupq_n_u32(RASTER_FULL_COVERAGE / 2), Coverage, 255), 17);
+
+        uint8x8_t Bytes = vqmovn_u16(vcombine_u16(vmovn_u32(Coverage), vdup_n_u16(0)));
+
+        vst1_lane_u32((uint32_t*)&Alpha[Index], vreinterpret_u32_u8(Bytes), 0);
+    }
+
+    Sum = vgetq_lane_s32(Carry, 0);
+#endif
+
+    ResolveCoverageFrom(&Cells[Index], &Alpha[Index], Count - Index, Sum);
+}
+
+
+// Turns the coverage of a row into however much more has to be blended in over what the target's Coverage
+// says is already there, and records the new coverage. Blending by Extra over a pixel that already has Old
+// of the color in it leaves 1 - (1 - Old) * (1 - Extra) of the color, so Extra = (New - Old) / (1 - Old).
+static void MergeCoverage(_Inout_updates_(Count) UINT8* Alpha, _Inout_updates_(Count) UINT8* Coverage, _In_ UINT32 Count)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        UINT32 New = Alpha[Index];
+
+        UINT32 Old = Coverage[Index];
+
+        if (New <= Old)
+        {
+            Alpha[Index] = 0;
+        }
+        else
+        {
+            Coverage[Index] = (UINT8)New;
+
+            if (Old != 0)
+            {
+                Alpha[Index] = (UINT8)(((New - Old) * 255 + (255 - Old) / 2) / (255 - Old));
+            }
+        }
+    }
+}
+
+
+static void FillPath(_In_ const RASTERTARGET* Target, _In_ const RASTERPATH* Path, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    if (Path->Overflowed || Path->PolygonCount == 0)
+    {
+        return;
+    }
+
+    INT32 MinX = MAXINT32;
+
+    INT32 MinY = MAXINT32;
+
+    INT32 MaxX = MININT32;
+
+    INT32 MaxY = MININT32;
+
+    for (UINT32 Index = 0; Index < Path->PointCount; Index++)
+    {
+        MinX = min(MinX, Path->Points[Index].X);
+
+        MinY = min(MinY, Path->Points[Index].Y);
+
+        MaxX = max(MaxX, Path->Points[Index].X);
+
+        MaxY = max(MaxY, Path->Points[Index].Y);
+    }
+
+    RECT Area = {
+        (LONG)FloorDivide(MinX, RASTER_SUBPIXELS),
+        (LONG)FloorDivide(MinY, RASTER_SUBPIXELS),
+        (LONG)FloorDivide(MaxX + RASTER_SUBPIXELS - 1, RASTER_SUBPIXELS),
+        (LONG)FloorDivide(MaxY + RASTER_SUBPIXELS - 1, RASTER_SUBPIXELS) };
+
+    if (IntersectRect(&Area, &Area, &Target->Bounds) == FALSE)
+    {
+        return;
+    }
+
+    RASTERBAND Band = { 0 };
+
+    Band.Left = Area.left;
+
+    Band.Right = Area.right;
+
+    Band.Stride = Band.Right - Band.Left + 1;
+
+    SIZE_T CellsSize = (SIZE_T)Band.Stride * RASTER_BAND_HEIGHT * sizeof(INT32);
+
+    Band.Cells = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, CellsSize + (SIZE_T)Band.Stride);
+
+    if (Band.Cells == NULL)
+    {
+        return;
+    }
+
+    UINT8* Alpha = (UINT8*)Band.Cells + CellsSize;
+
+    for (Band.Top = Area.top; Band.Top < Area.bottom; Band.Top += RASTER_BAND_HEIGHT)
+    {
+        Band.Bottom = min(Band.Top + RASTER_BAND_HEIGHT, Area.bottom);
+
+        UINT32 First = 0;
+
+        for (UINT32 Polygon = 0; Polygon < Path->PolygonCount; Polygon++)
+        {
+            UINT32 End = Path->Ends[Polygon];
+
+            for (UINT32 Index = First; Index < End; Index++)
+            {
+                AddEdge(&Band, Path->Points[Index], Path->Points[(Index + 1 < End) ? Index + 1 : First]);
+            }
+
+            First = End;
+        }
+
+        for (INT32 Row = Band.Top; Row < Band.Bottom; Row++)
+        {
+            SIZE_T Offset = (SIZE_T)(Row - Target->Bounds.top) * Target->Stride + (Band.Left - Target->Bounds.left);
+
+            ResolveCoverage(&Band.Cells[(SIZE_T)(Row - Band.Top) * Band.Stride], Alpha, (UINT32)(Band.Right - Band.Left));
+
+            if (Target->Coverage != NULL)
+            {
+                MergeCoverage(Alpha, &Target->Coverage[Offset], (UINT32)(Band.Right - Band.Left));
+            }
+
+            BlendSpan(&Target->Pixels[Offset], Alpha, (UINT32)(Band.Right - Band.Left), Color, Mode);
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, Band.Cells);
+}
+
+
+static void AddLine(_Inout_ RASTERPATH* Path, _In_ double X0, _In_ double Y0, _In_ double X1, _In_ double Y1, _In_ double Width)
+{
+    double DX = X1 - X0;
+
+    double DY = Y1 - Y0;
+
+    double Length = sqrt(DX * DX + DY * DY);
+
+    if (Length == 0.0 || Width <= 0.0)
+    {
+        return;
+    }
+
+    // Half of the width, at right angles to the line.
+    double NX = -DY / Length * Width / 2.0;
+
+    double NY = DX / Length * Width / 2.0;
+
+    AddCorner(Path, X0 + NX, Y0 + NY);
+
+    AddCorner(Path, X1 + NX, Y1 + NY);
+
+    AddCorner(Path, X1 - NX, Y1 - NY);
+
+    AddCorner(Path, X0 - NX, Y0 - NY);
+
+    EndPolygon(Path, FALSE);
+}
+
+
+// A stadium: half circles around both ends, joined by straight sides. It's one polygon rather than a line
+// and two circles, since the edges of overlapping polygons would add up to too much coverage where they touch.
+static void AddCapsule(_Inout_ RASTERPATH* Path, _In_ double X0, _In_ double Y0, _In_ double X1, _In_ double Y1, _In_ double Width)
+{
+    double Radius = Width / 2.0;
+
+    if (Radius <= 0.0)
+    {
+        return;
+    }
+
+    double DX = X1 - X0;
+
+    double DY = Y1 - Y0;
+
+    double Length = sqrt(DX * DX + DY * DY);
+
+    // Unit vectors along the line and at right angles to it. A dot can point any way.
+    double UX = (Length == 0.0) ? 1.0 : DX / Length;
+
+    double UY = (Length == 0.0) ? 0.0 : DY / Length;
+
+    double NX = -UY;
+
+    double NY = UX;
+
+    double Angle = sqrt(8.0 * RASTER_ELLIPSE_ERROR / Radius);
+
+    double SidesPerQuarter = ceil((RASTER_PI / 2.0) / Angle);
+
+    UINT32 Sides = (UINT32)max(min(SidesPerQuarter, RASTER_MAX_POINTS / 8), 2);
+
+    // Around the To end from one side to the other, then back around the From end.
+    for (int End = 0; End < 2; End++)
+    {
+        double CenterX = (End == 0) ? X1 : X0;
+
+        double CenterY = (End == 0) ? Y1 : Y0;
+
+        double Sign = (End == 0) ? 1.0 : -1.0;
+
+        for (UINT32 Side = 0; Side <= 2 * Sides; Side++)
+        {
+            double Sine = 0.0;
+
+            double Cosine = 0.0;
+
+            if (Side <= Sides)
+            {
+                GetSineAndCosine((RASTER_PI / 2.0) * Side / Sides, &Sine, &Cosine);
+            }
+            else
+            {
+                GetSineAndCosine((RASTER_PI / 2.0) * (Side - Sides) / Sides, &Cosine, &Sine);
+
+                Cosine = -Cosine;
+            }
+
+            AddCorner(Path, CenterX + Sign * Radius * (Cosine * NX + Sine * UX), CenterY + Sign * Radius * (Cosine * NY + Sine * UY));
+        }
+    }
+
+    EndPolygon(Path, FALSE);
+}
+
+
+static void AddRectangle(_Inout_ RASTERPATH* Path, _In_ double Left, _In_ double Top, _In_ double Right, _In_ double Bottom, _In_ BOOL Hole)
+{
+    AddCorner(Path, Left, Top);
+
+    AddCorner(Path, Right, Top);
+
+    AddCorner(Path, Right, Bottom);
+
+    AddCorner(Path, Left, Bottom);
+
+    EndPolygon(Path, Hole);
+}
+
+
+static void AddEllipse(_Inout_ RASTERPATH* Path, _In_ double CenterX, _In_ double CenterY, _In_ double RadiusX, _In_ double RadiusY, _In_ BOOL Hole)
+{
+    if (RadiusX <= 0.0 || RadiusY <= 0.0)
+    {
+        return;
+    }
+
+    // A side that spans Angle radians of a circle strays about Radius * Angle * Angle / 8 from it.
+    double Angle = sqrt(8.0 * RASTER_ELLIPSE_ERROR / max(RadiusX, RadiusY));
+
+    double SidesPerQuarter = ceil((RASTER_PI / 2.0) / Angle);
+
+    UINT32 Sides = (UINT32)max(min(SidesPerQuarter, RASTER_MAX_POINTS / 8), 2);
+
+    // Each quarter uses the same sines and cosines, so the ellipse comes out perfectly symmetrical.
+    for (UINT32 Quarter = 0; Quarter < 4; Quarter++)
+    {
+        for (UINT32 Side = 0; Side < Sides; Side++)
+        {
+            double Sine = 0.0;
+
+            double Cosine = 0.0;
+
+            GetSineAndCosine((RASTER_PI / 2.0) * Side / Sides, &Sine, &Cosine);
+
+            switch (Quarter)
+            {
+                case 0:
+                {
+                    AddCorner(Path, CenterX + RadiusX * Cosine, CenterY + RadiusY * Sine);
+
+                    break;
+                }
+                case 1:
+                {
+                    AddCorner(Path, CenterX - RadiusX * Sine, CenterY + RadiusY * Cosine);
+
+                    break;
+                }
+                case 2:
+                {
+                    AddCorner(Path, CenterX - RadiusX * Cosine, CenterY - RadiusY * Sine);
+
+                    break;
+                }
+                default:
+                {
+                    AddCorner(Path, CenterX + RadiusX * Sine, CenterY - RadiusY * Cosine);
+                }
+            }
+        }
+    }
+
+    EndPolygon(Path, Hole);
+}
+
+
+static BOOL GetArrowHeadCorners(_In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _Out_writes_(6) double* Corners, _Out_ double* HeadSize)
+{
+    double DX = (double)To.X - From.X;
+
+    double DY = (double)To.Y - From.Y;
+
+    double Length = sqrt(DX * DX + DY * DY);
+
+    if (Length == 0.0)
+    {
+        return FALSE;
+    }
+
+    // Unit vectors along the arrow and at right angles to it.
+    double UX = DX / Length;
+
+    double UY = DY / Length;
+
+    double VX = -UY;
+
+    double VY = UX;
+
+    *HeadSize = max(ARROW_HEAD_MIN_SIZE, 5.0f * Width);
+
+    double Half = *HeadSize / 2.0;
+
+    Corners[0] = To.X;
+
+    Corners[1] = To.Y;
+
+    Corners[2] = To.X - *HeadSize * UX + Half * VX;
+
+    Corners[3] = To.Y - *HeadSize * UY + Half * VY;
+
+    Corners[4] = To.X - *HeadSize * UX - Half * VX;
+
+    Corners[5] = To.Y - *HeadSize * UY - Half * VY;
+
+    return TRUE;
+}
+
+
+void FillPolygon(_In_ const RASTERTARGET* Target, _In_reads_(Count) const RASTERPOINT* Points, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    RASTERPATH Path;
+
+    BeginPath(&Path);
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        AddCorner(&Path, Points[Index].X, Points[Index].Y);
+    }
+
+    EndPolygon(&Path, FALSE);
+
+    FillPath(Target, &Path, Color, Mode);
+}
+
+
+void DrawLine(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    RASTERPATH Path;
+
+    BeginPath(&Path);
+
+    AddLine(&Path, From.X, From.Y, To.X, To.Y, Width);
+
+    FillPath(Target, &Path, Color, Mode);
+}
+
+
+void DrawCapsule(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    RASTERPATH Path;
+
+    BeginPath(&Path);
+
+    AddCapsule(&Path, From.X, From.Y, To.X, To.Y, Width);
+
+    FillPath(Target, &Path, Color, Mode);
+}
+
+
+void DrawBox(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT Corner1, _In_ RASTERPOINT Corner2, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    double Left = min(Corner1.X, Corner2.X);
+
+    double Top = min(Corner1.Y, Corner2.Y);
+
+    double Right = max(Corner1.X, Corner2.X);
+
+    double Bottom = max(Corner1.Y, Corner2.Y);
+
+    double Half = Width / 2.0;
+
+    RASTERPATH Path;
+
+    BeginPath(&Path);
+
+    AddRectangle(&Path, Left - Half, Top - Half, Right + Half, Bottom + Half, FALSE);
+
+    // A box that is narrower than its outline is just solid.
+    if (Right - Left > Width && Bottom - Top > Width)
+    {
+        AddRectangle(&Path, Left + Half, Top + Half, Right - Half, Bottom - Half, TRUE);
+    }
+
+    FillPath(Target, &Path, Color, Mode);
+}
+
+
+void DrawEllipse(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT Center, _In_ float RadiusX, _In_ float RadiusY, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    RASTERPATH Path;
+
+    BeginPath(&Path);
+
+    if (Width <= 0.0f)
+    {
+        AddEllipse(&Path, Center.X, Center.Y, RadiusX, RadiusY, FALSE);
+    }
+    else
+    {
+        double Half = Width / 2.0;
+
+        AddEllipse(&Path, Center.X, Center.Y, RadiusX + Half, RadiusY + Half, FALSE);
+
+        AddEllipse(&Path, Center.X, Center.Y, RadiusX - Half, RadiusY - Half, TRUE);
+    }
+
+    FillPath(Target, &Path, Color, Mode);
+}
+
+
+void DrawArrow(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode)
+{
+    double Head[6] = { 0 };
+
+    double HeadSize = 0.0;
+
+    if (GetArrowHeadCorners(From, To, Width, Head, &HeadSize) == FALSE)
+    {
+        return;
+    }
+
+    RASTERPATH Path;
+
+    BeginPath(&Path);
+
+    // The line stops a pixel inside of the head, so that its flat end doesn't poke out past the sides of the point.
+    double DX = (double)To.X - From.X;
+
+    double DY = (double)To.Y - From.Y;
+
+    double Length = sqrt(DX * DX + DY * DY);
+
+    double ShaftLength = Length - HeadSize + 1.0;
+
+    if (ShaftLength > 0.0)
+    {
+        AddLine(&Path, From.X, From.Y, From.X + DX * ShaftLength / Length, From.Y + DY * ShaftLength / Length, Width);
+    }
+
+    AddCorner(&Path, Head[0], Head[1]);
+
+    AddCorner(&Path, Head[2], Head[3]);
+
+    AddCorner(&Path, Head[4], Head[5]);
+
+    EndPolygon(&Path, FALSE);
+
+    FillPath(Target, &Path, Color, Mode);
+}
+
+
+BOOL GetArrowHead(_In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _Out_writes_(3) RASTERPOINT* Head)
+{
+    double Corners[6] = { 0 };
+
+    double HeadSize = 0.0;
+
+    if (GetArrowHeadCorners(From, To, Width, Corners, &HeadSize) == FALSE)
+    {
+        return FALSE;
+    }
+
+    for (int Corner = 0; Corner < 3; Corner++)
+    {
+        Head[Corner].X = (float)Corners[Corner * 2];
+
+        Head[Corner].Y = (float)Corners[Corner * 2 + 1];
+    }
+
+    return TRUE;
+}
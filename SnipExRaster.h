@@ -0,0 +1,89 @@
+// SnipExRaster.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Anti-aliased lines, boxes, arrows and ellipses, drawn straight into 32bpp BGRA pixels. Every shape is
+// turned into polygons, the exact area of each pixel that the polygons cover is added up with integer
+// math, and the color is blended in by that much. Once a shape's corners have been placed on the
+// 1/256 pixel grid nothing is left to rounding, so the same shape always comes out the same, bit for bit.
+// Needs SnipExBlend.h to be included first.
+
+#pragma once
+
+// Corners are placed on a grid this many times finer than the pixels.
+#define RASTER_SUBPIXELS      256
+
+// The coverage of a pixel that a polygon covers all the way: RASTER_SUBPIXELS rows of height, times twice
+// RASTER_SUBPIXELS columns of width, since each column's share is worked out from the sum of two x coordinates.
+#define RASTER_FULL_COVERAGE  (RASTER_SUBPIXELS * RASTER_SUBPIXELS * 2)
+
+// Polygons are filled this many rows at a time, so that a shape that spans the whole snip doesn't need
+// a coverage buffer as big as the snip.
+#define RASTER_BAND_HEIGHT    32
+
+// The most corners that a single shape can have, across all of its polygons.
+#define RASTER_MAX_POINTS     2048
+
+// Ellipses are made of enough straight sides that they are never more than this far, in pixels, from a true ellipse.
+#define RASTER_ELLIPSE_ERROR  0.0625
+
+// The arrow head is at least this long, and this wide at its base.
+#define ARROW_HEAD_MIN_SIZE   10.0f
+
+// A point in pixels. Pixel X, Y covers X to X + 1 and Y to Y + 1, so a whole number is on the line
+// between two pixels, and a line with an even width drawn there covers whole pixels on both sides.
+typedef struct RASTERPOINT
+{
+    float X;
+
+    float Y;
+
+} RASTERPOINT;
+
+typedef struct RASTERTARGET
+{
+    // Pixel X, Y is Pixels[(Y - Bounds.top) * Stride + (X - Bounds.left)].
+    UINT32* Pixels;
+
+    // The distance from one row to the next, in pixels.
+    INT32   Stride;
+
+    // The part of the image that Pixels holds. Nothing outside of it is drawn on.
+    RECT    Bounds;
+
+    // Optional, one byte for each pixel, laid out the same as Pixels, and all 0 to begin with. If it's there,
+    // it remembers how much of each pixel has been drawn on so far, and a shape that overlaps what's already
+    // there only adds whatever coverage is missing. Everything drawn into the target until the bytes are
+    // zeroed again then blends in as one shape, with no darker spots where the pieces overlap.
+    UINT8*  Coverage;
+
+} RASTERTARGET;
+
+
+// Fills a polygon with Color. Parts that the polygon goes around more than once are only filled once, though
+// pixels on the edges of those parts get the share of each time around, up to all of the pixel.
+void FillPolygon(_In_ const RASTERTARGET* Target, _In_reads_(Count) const RASTERPOINT* Points, _In_ UINT32 Count, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Draws a line Width pixels wide, centered on From-To, with flat ends.
+void DrawLine(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Draws a line Width pixels wide, centered on From-To, with round ends. From and To can be the same point, for a dot.
+void DrawCapsule(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Draws the outline of a box, Width pixels wide and centered on the edges of the box. The corners are square.
+void DrawBox(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT Corner1, _In_ RASTERPOINT Corner2, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Draws the outline of an ellipse, Width pixels wide and centered on the ellipse, or fills it if Width is 0.
+void DrawEllipse(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT Center, _In_ float RadiusX, _In_ float RadiusY, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Draws a line Width pixels wide from From to To, with a solid arrow head at To.
+void DrawArrow(_In_ const RASTERTARGET* Target, _In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _In_ UINT32 Color, _In_ BLENDMODE Mode);
+
+// Works out the 3 corners of the arrow head that DrawArrow puts at To, tip first. Returns FALSE if the
+// arrow has no length, so it has no direction.
+BOOL GetArrowHead(_In_ RASTERPOINT From, _In_ RASTERPOINT To, _In_ float Width, _Out_writes_(3) RASTERPOINT* Head);
+
+// Turns a row of accumulated coverage into alphas from 0 to 255, and zeroes the row for the next use.
+// Count + 1 cells are zeroed, since the cell just past the end of the row collects spill-over.
+void ResolveCoverage(_Inout_updates_(Count + 1) INT32* Cells, _Out_writes_(Count) UINT8* Alpha, _In_ UINT32 Count);
+
+// The portable reference implementation of ResolveCoverage.
+void ResolveCoverageScalar(_Inout_updates_(Count + 1) INT32* Cells, _Out_writes_(Count) UINT8* Alpha, _In_ UINT32 Count);
@@ -0,0 +1,413 @@
+// SnipExReplay.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Plays back frames listed in a manifest as if they were the screen. Each capture reads its frame from disk, copies
+// the part that was asked for, and lets go of the rest, so nothing is held in memory between captures but the list
+// of frames. Nothing in here talks to the screen.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExReplay.h"
+
+#include "SnipExPng.h"
+
+typedef struct REPLAY
+{
+    wchar_t Frames[REPLAY_MAX_FRAMES][MAX_PATH];
+
+    UINT32  FrameCount;
+
+    // The frame the next capture plays.
+    UINT32  NextFrame;
+
+} REPLAY;
+
+
+static BOOL ReadWholeFile(_In_ const wchar_t* Path, _Out_ UINT8** Data, _Out_ SIZE_T* Size)
+{
+    *Data = NULL;
+
+    *Size = 0;
+
+    HANDLE File = CreateFileW(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (File == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    LARGE_INTEGER FileSize = { 0 };
+
+    BOOL Loaded = FALSE;
+
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0 && (UINT64)FileSize.QuadPart <= MAXDWORD)
+    {
+        DWORD Read = 0;
+
+        *Data = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)FileSize.QuadPart);
+
+        if (*Data != NULL && ReadFile(File, *Data, (DWORD)FileSize.QuadPart, &Read, NULL) && Read == (DWORD)FileSize.QuadPart)
+        {
+            *Size = Read;
+
+            Loaded = TRUE;
+        }
+        else if (*Data != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, *Data);
+
+            *Data = NULL;
+        }
+    }
+
+    CloseHandle(File);
+
+    return Loaded;
+}
+
+
+static BOOL IsSpace(_In_ char Character)
+{
+    return (Character == ' ' || Character == '\t' || Character == '\r');
+}
+
+
+// Moves Line past the spaces at the start of it, then past the word after them, and returns the word's length.
+static SIZE_T NextWord(_Inout_ const char** Line, _Out_ const char** Word)
+{
+    while (IsSpace(**Line))
+    {
+        (*Line)++;
+    }
+
+    *Word = *Line;
+
+    while (**Line != '\0' && IsSpace(**Line) == FALSE)
+    {
+        (*Line)++;
+    }
+
+    return (SIZE_T)(*Line - *Word);
+}
+
+
+// Reads four whole numbers, a left, top, width and height, into Rect. The width and height have to be more than 0.
+static BOOL ParseRect(_In_ const char* Line, _Out_ RECT* Rect)
+{
+    LONG Values[4] = { 0 };
+
+    for (UINT32 Index = 0; Index < _countof(Values); Index++)
+    {
+        const char* Word = NULL;
+
+        SIZE_T Length = NextWord(&Line, &Word);
+
+        BOOL Negative = (Length > 0 && Word[0] == '-');
+
+        SIZE_T Digit = Negative ? 1 : 0;
+
+        INT64 Value = 0;
+
+        if (Length == Digit || Length - Digit > 9)
+        {
+            return FALSE;
+        }
+
+        for (; Digit < Length; Digit++)
+        {
+            if (Word[Digit] < '0' || Word[Digit] > '9')
+            {
+                return FALSE;
+            }
+
+            Value = Value * 10 + (Word[Digit] - '0');
+        }
+
+        Values[Index] = (LONG)(Negative ? -Value : Value);
+    }
+
+    if (Values[2] <= 0 || Values[3] <= 0 || (INT64)Values[0] + Values[2] > MAXINT32 || (INT64)Values[1] + Values[3] > MAXINT32)
+    {
+        return FALSE;
+    }
+
+    Rect->left = Values[0];
+
+    Rect->top = Values[1];
+
+    Rect->right = Values[0] + Values[2];
+
+    Rect->bottom = Values[1] + Values[3];
+
+    return TRUE;
+}
+
+
+// Puts the path of the frame named by the Length UTF-8 bytes of Name in Path. Names that aren't absolute are
+// relative to the folder the manifest is in.
+static BOOL ResolveFramePath(_In_ const wchar_t* ManifestPath, _In_reads_(Length) const char* Name, _In_ SIZE_T Length, _Out_writes_(MAX_PATH) wchar_t* Path)
+{
+    SIZE_T Folder = 0;
+
+    BOOL Absolute = (Name[0] == '\\' || Name[0] == '/' || (Length > 1 && Name[1] == ':'));
+
+    if (Absolute == FALSE)
+    {
+        for (SIZE_T Index = 0; ManifestPath[Index] != L'\0'; Index++)
+        {
+            if (ManifestPath[Index] == L'\\' || ManifestPath[Index] == L'/')
+            {
+                Folder = Index + 1;
+            }
+        }
+    }
+
+    if (Folder >= MAX_PATH || Length >= MAX_PATH)
+    {
+        return FALSE;
+    }
+
+    CopyMemory(Path, ManifestPath, Folder * sizeof(wchar_t));
+
+    int Converted = MultiByteToWideChar(CP_UTF8, 0, Name, (int)Length, &Path[Folder], (int)(MAX_PATH - 1 - Folder));
+
+    if (Converted <= 0)
+    {
+        return FALSE;
+    }
+
+    Path[Folder + (SIZE_T)Converted] = L'\0';
+
+    return TRUE;
+}
+
+
+static BOOL ReplayCapture(_Inout_ CAPTURESOURCE* Source, _In_ const RECT* Area, _Out_ UINT32* Pixels, _In_ INT32 Stride)
+{
+    REPLAY* Replay = Source->Context;
+
+    const wchar_t* Path = Replay->Frames[Replay->NextFrame];
+
+    INT32 DesktopWidth = Source->Layout.Desktop.right - Source->Layout.Desktop.left;
+
+    INT32 DesktopHeight = Source->Layout.Desktop.bottom - Source->Layout.Desktop.top;
+
+    UINT8* Data = NULL;
+
+    SIZE_T Size = 0;
+
+    UINT32* Decoded = NULL;
+
+    const UINT32* Frame = NULL;
+
+    BOOL Result = FALSE;
+
+    Replay->NextFrame = (Replay->NextFrame + 1) % Replay->FrameCount;
+
+    if (ReadWholeFile(Path, &Data, &Size) == FALSE)
+    {
+        return FALSE;
+    }
+
+    if (IsPng(Data, Size))
+    {
+        INT32 Width = 0;
+
+        INT32 Height = 0;
+
+        if (DecodePng(Data, Size, &Decoded, &Width, &Height) && Width == DesktopWidth && Height == DesktopHeight)
+        {
+            Frame = Decoded;
+        }
+    }
+    else if (Size == (SIZE_T)DesktopWidth * DesktopHeight * sizeof(UINT32))
+    {
+        Frame = (const UINT32*)Data;
+    }
+
+    if (Frame != NULL)
+    {
+        SIZE_T RowBytes = (SIZE_T)(Area->right - Area->left) * sizeof(UINT32);
+
+        for (INT32 Y = Area->top; Y < Area->bottom; Y++)
+        {
+            CopyMemory(&Pixels[(SIZE_T)(Y - Area->top) * Stride], &Frame[(SIZE_T)Y * DesktopWidth + Area->left], RowBytes);
+        }
+
+        Result = TRUE;
+    }
+
+    if (Decoded != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Decoded);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Data);
+
+    return Result;
+}
+
+
+static void ReplayClose(_Inout_ CAPTURESOURCE* Source)
+{
+    if (Source->Context != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Source->Context);
+
+        Source->Context = NULL;
+    }
+}
+
+
+BOOL OpenReplaySource(_In_ const wchar_t* ManifestPath, _Out_ CAPTURESOURCE* Source)
+{
+    UINT8* Manifest = NULL;
+
+    SIZE_T Size = 0;
+
+    REPLAY* Replay = NULL;
+
+    BOOL HasDesktop = FALSE;
+
+    BOOL Result = FALSE;
+
+    ZeroMemory(Source, sizeof(CAPTURESOURCE));
+
+    if (ReadWholeFile(ManifestPath, &Manifest, &Size) == FALSE)
+    {
+        return FALSE;
+    }
+
+    if ((Replay = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(REPLAY))) == NULL)
+    {
+        goto Exit;
+    }
+
+    for (SIZE_T Start = 0; Start < Size; )
+    {
+        char Line[1024] = { 0 };
+
+        SIZE_T End = Start;
+
+        while (End < Size && Manifest[End] != '\n')
+        {
+            End++;
+        }
+
+        if (End - Start >= sizeof(Line))
+        {
+            goto Exit;
+        }
+
+        CopyMemory(Line, &Manifest[Start], End - Start);
+
+        Start = End + 1;
+
+        const char* Rest = Line;
+
+        const char* Word = NULL;
+
+        SIZE_T Length = NextWord(&Rest, &Word);
+
+        if (Length == 0 || Word[0] == '#')
+        {
+            continue;
+        }
+
+        if (Length == 7 && memcmp(Word, "desktop", 7) == 0)
+        {
+            if (ParseRect(Rest, &Source->Layout.Desktop) == FALSE)
+            {
+                goto Exit;
+            }
+
+            HasDesktop = TRUE;
+        }
+        else if (Length == 7 && memcmp(Word, "monitor", 7) == 0)
+        {
+            if (Source->Layout.MonitorCount >= CAPTURE_MAX_MONITORS || ParseRect(Rest, &Source->Layout.Monitors[Source->Layout.MonitorCount]) == FALSE)
+            {
+                goto Exit;
+            }
+
+            Source->Layout.MonitorCount++;
+        }
+        else if (Length == 5 && memcmp(Word, "frame", 5) == 0)
+        {
+            // The name is the rest of the line, so that it can have spaces in it.
+            const char* Name = NULL;
+
+            NextWord(&Rest, &Name);
+
+            Length = strlen(Name);
+
+            while (Length > 0 && IsSpace(Name[Length - 1]))
+            {
+                Length--;
+            }
+
+            if (Length == 0 || Replay->FrameCount >= REPLAY_MAX_FRAMES || ResolveFramePath(ManifestPath, Name, Length, Replay->Frames[Replay->FrameCount]) == FALSE)
+            {
+                goto Exit;
+            }
+
+            Replay->FrameCount++;
+        }
+        else
+        {
+            goto Exit;
+        }
+    }
+
+    if (HasDesktop == FALSE || Replay->FrameCount == 0)
+    {
+        goto Exit;
+    }
+
+    // Monitors are clipped to the desktop, so that snipping one never reaches off of it.
+    for (UINT32 Index = 0; Index < Source->Layout.MonitorCount; Index++)
+    {
+        if (IntersectRect(&Source->Layout.Monitors[Index], &Source->Layout.Monitors[Index], &Source->Layout.Desktop) == FALSE)
+        {
+            goto Exit;
+        }
+    }
+
+    Source->Capture = ReplayCapture;
+
+    Source->Close = ReplayClose;
+
+    Source->Context = Replay;
+
+    Replay = NULL;
+
+    Result = TRUE;
+
+Exit:
+
+    if (Replay != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Replay);
+    }
+
+    if (Result == FALSE)
+    {
+        ZeroMemory(Source, sizeof(CAPTURESOURCE));
+    }
+
+    HeapFree(GetProcessHeap(), 0, Manifest);
+
+    return Result;
+}
@@ -0,0 +1,30 @@
+// SnipExReplay.h
+// Author: Joseph Ryan Ries, 2017-2020
+// A capture source that plays back frames saved to disk instead of looking at the screen, so that a capture can be
+// repeated exactly, on any machine, whatever monitors it has. Start SnipEx with --replay and the path of a
+// manifest, a text file like this one:
+//
+//     # Three 4K monitors, the first one to the left of the primary.
+//     desktop -3840 0 11520 2160
+//     monitor -3840 0 3840 2160
+//     monitor 0 0 3840 2160
+//     monitor 3840 0 3840 2160
+//     frame first.png
+//     frame second.raw
+//
+// desktop and monitor are left, top, width and height in screen coordinates. Each frame is a file holding the
+// whole desktop, either a PNG, or raw top-down 32bpp BGRA pixels with nothing else in the file. Paths are relative
+// to the manifest. Each capture plays the next frame, going back to the first after the last. Lines starting with
+// # are ignored.
+
+#pragma once
+
+#include "SnipExCapture.h"
+
+// The most frames a manifest can list.
+#define REPLAY_MAX_FRAMES 256
+
+
+// Opens the manifest at ManifestPath and makes Source play it back. Returns FALSE if the manifest can't be read,
+// doesn't say how big the desktop is, or lists no frames. Frames themselves aren't read until they're captured.
+BOOL OpenReplaySource(_In_ const wchar_t* ManifestPath, _Out_ CAPTURESOURCE* Source);
@@ -0,0 +1,753 @@
+// SnipExResample.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Lanczos-3 resampling for callouts. The image is filtered across into a temporary buffer and then down
+// into the destination, and both passes use fixed-point weights that are worked out once for each column
+// and each row, so every pixel is only a handful of multiply-adds. Those are done with SSE2 or NEON, the
+// same math as the scalar version down to the rounding, and big images are split into bands of rows that
+// are resampled on as many threads as the machine has.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <math.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExResample.h"
+
+#define RESAMPLE_WEIGHT_ONE (1 << RESAMPLE_WEIGHT_BITS)
+
+
+// Which source pixels each destination pixel along one direction is made from, and how much of each.
+typedef struct RESAMPLEWEIGHTS
+{
+    INT32*  First;
+
+    INT32*  Count;
+
+    // TapStride weights for each destination pixel, of which the first Count are used. They add up to RESAMPLE_WEIGHT_ONE.
+    INT16*  Weights;
+
+    INT32   TapStride;
+
+} RESAMPLEWEIGHTS;
+
+typedef struct RESAMPLEJOB
+{
+    const UINT32*          Source;
+
+    INT32                  Width;
+
+    // The source rows from TempTop on, resampled across to the destination's width.
+    UINT32*                Temp;
+
+    INT32                  TempTop;
+
+    UINT32*                Destination;
+
+    INT32                  DestinationStride;
+
+    INT32                  DestinationWidth;
+
+    const RESAMPLEWEIGHTS* Columns;
+
+    const RESAMPLEWEIGHTS* Rows;
+
+    BOOL                   Scalar;
+
+    // The band of rows that this job covers, of Temp or of Destination. Last is exclusive.
+    INT32                  First;
+
+    INT32                  Last;
+
+} RESAMPLEJOB;
+
+typedef void (*RESAMPLEBANDFUNCTION)(_In_ const RESAMPLEJOB* Job);
+
+typedef struct RESAMPLETHREAD
+{
+    RESAMPLEBANDFUNCTION Function;
+
+    RESAMPLEJOB          Job;
+
+} RESAMPLETHREAD;
+
+
+static double Lanczos(_In_ double X)
+{
+    if (X == 0.0)
+    {
+        return 1.0;
+    }
+
+    if (X <= -RESAMPLE_LANCZOS_RADIUS || X >= RESAMPLE_LANCZOS_RADIUS)
+    {
+        return 0.0;
+    }
+
+    double PiX = 3.14159265358979323846 * X;
+
+    return RESAMPLE_LANCZOS_RADIUS * sin(PiX) * sin(PiX / RESAMPLE_LANCZOS_RADIUS) / (PiX * PiX);
+}
+
+
+static void FreeWeights(_Inout_ RESAMPLEWEIGHTS* Weights)
+{
+    if (Weights->First != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Weights->First);
+    }
+
+    if (Weights->Count != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Weights->Count);
+    }
+
+    if (Weights->Weights != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Weights->Weights);
+    }
+
+    ZeroMemory(Weights, sizeof(RESAMPLEWEIGHTS));
+}
+
+
+// Works out the weights for resizing the SourceLength pixels from SourceStart on to DestinationLength pixels.
+// Pixels at or past SourceLimit, or before 0, are left out and the rest of the weights make up for them.
+static BOOL ComputeWeights(_Out_ RESAMPLEWEIGHTS* Weights, _In_ INT32 SourceStart, _In_ INT32 SourceLength, _In_ INT32 SourceLimit, _In_ INT32 DestinationLength)
+{
+    ZeroMemory(Weights, sizeof(RESAMPLEWEIGHTS));
+
+    double Scale = (double)DestinationLength / (double)SourceLength;
+
+    // Shrinking stretches the filter out, so that every source pixel still counts toward the result.
+    double FilterScale = (Scale < 1.0) ? 1.0 / Scale : 1.0;
+
+    double Support = RESAMPLE_LANCZOS_RADIUS * FilterScale;
+
+    Weights->TapStride = ((INT32)ceil(Support) * 2) + 2;
+
+    Weights->First = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)DestinationLength * sizeof(INT32));
+
+    Weights->Count = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)DestinationLength * sizeof(INT32));
+
+    Weights->Weights = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)DestinationLength * Weights->TapStride * sizeof(INT16));
+
+    double* Exact = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Weights->TapStride * sizeof(double));
+
+    if (Weights->First == NULL || Weights->Count == NULL || Weights->Weights == NULL || Exact == NULL)
+    {
+        FreeWeights(Weights);
+
+        if (Exact != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, Exact);
+        }
+
+        return FALSE;
+    }
+
+    for (INT32 Index = 0; Index < DestinationLength; Index++)
+    {
+        // Pixel X covers X to X + 1, so its center is at X + 0.5.
+        double Center = (double)SourceStart + ((double)Index + 0.5) / Scale;
+
+        INT32 Low = max(0, (INT32)floor(Center - Support - 0.5) + 1);
+
+        INT32 High = min(SourceLimit, (INT32)ceil(Center + Support - 0.5));
+
+        High = min(High, Low + Weights->TapStride);
+
+        double Total = 0.0;
+
+        for (INT32 Tap = 0; Tap < High - Low; Tap++)
+        {
+            Exact[Tap] = Lanczos(((double)(Low + Tap) + 0.5 - Center) / FilterScale);
+
+            Total += Exact[Tap];
+        }
+
+        INT16* Fixed = &Weights->Weights[(SIZE_T)Index * Weights->TapStride];
+
+        INT32 Sum = 0;
+
+        INT32 Largest = 0;
+
+        for (INT32 Tap = 0; Tap < High - Low; Tap++)
+        {
+            Fixed[Tap] = (INT16)floor((Exact[Tap] / Total) * RESAMPLE_WEIGHT_ONE + 0.5);
+
+            Sum += Fixed[Tap];
+
+            if (Fixed[Tap] > Fixed[Largest])
+            {
+                Largest = Tap;
+            }
+        }
+
+        // Whatever rounding left over goes on the biggest weight, so that a flat color stays exactly the same.
+        Fixed[Largest] = (INT16)(Fixed[Largest] + RESAMPLE_WEIGHT_ONE - Sum);
+
+        // At whole-number zooms a lot of the taps land right on the filter's zeroes, so trim those off of both ends.
+        INT32 Skip = 0;
+
+        while (Skip < High - Low - 1 && Fixed[Skip] == 0)
+        {
+            Skip++;
+        }
+
+        while (High - Low - Skip > 1 && Fixed[High - Low - 1] == 0)
+        {
+            High--;
+        }
+
+        MoveMemory(Fixed, &Fixed[Skip], (SIZE_T)(High - Low - Skip) * sizeof(INT16));
+
+        ZeroMemory(&Fixed[High - Low - Skip], (SIZE_T)(Weights->TapStride - (High - Low - Skip)) * sizeof(INT16));
+
+        Weights->First[Index] = Low + Skip;
+
+        Weights->Count[Index] = High - Low - Skip;
+    }
+
+    HeapFree(GetProcessHeap(), 0, Exact);
+
+    return TRUE;
+}
+
+
+// Rounds, shifts and clamps each channel's weighted sum and packs them back into a pixel.
+static __forceinline UINT32 PackSums(_In_reads_(4) const INT32* Sums)
+{
+    UINT32 Pixel = 0;
+
+    for (UINT32 Channel = 0; Channel < 4; Channel++)
+    {
+        INT32 Value = (Sums[Channel] + (RESAMPLE_WEIGHT_ONE / 2)) >> RESAMPLE_WEIGHT_BITS;
+
+        Pixel |= (UINT32)min(max(Value, 0), 255) << (Channel * 8);
+    }
+
+    return Pixel;
+}
+
+
+static void ResampleRowScalar(_In_ const UINT32* Row, _Out_writes_(Count) UINT32* Destination, _In_ const RESAMPLEWEIGHTS* Columns, _In_ INT32 Count)
+{
+    for (INT32 Index = 0; Index < Count; Index++)
+    {
+        const UINT32* Taps = &Row[Columns->First[Index]];
+
+        const INT16* Weights = &Columns->Weights[(SIZE_T)Index * Columns->TapStride];
+
+        INT32 Sums[4] = { 0 };
+
+        for (INT32 Tap = 0; Tap < Columns->Count[Index]; Tap++)
+        {
+            for (UINT32 Channel = 0; Channel < 4; Channel++)
+            {
+                Sums[Channel] += Weights[Tap] * (INT32)((Taps[Tap] >> (Channel * 8)) & 0xFF);
+            }
+        }
+
+        Destination[Index] = PackSums(Sums);
+    }
+}
+
+
+// Filters down through TapCount rows, RowStride pixels apart, for pixels First through Last - 1.
+static void ResampleColumnsScalar(_In_ const UINT32* Rows, _In_ INT32 RowStride, _In_reads_(TapCount) const INT16* Weights, _In_ INT32 TapCount, _Out_ UINT32* Destination, _In_ INT32 First, _In_ INT32 Last)
+{
+    for (INT32 Index = First; Index < Last; Index++)
+    {
+        INT32 Sums[4] = { 0 };
+
+        for (INT32 Tap = 0; Tap < TapCount; Tap++)
+        {
+            UINT32 Pixel = Rows[(SIZE_T)Tap * RowStride + Index];
+
+            for (UINT32 Channel = 0; Channel < 4; Channel++)
+            {
+                Sums[Channel] += Weights[Tap] * (INT32)((Pixel >> (Channel * 8)) & 0xFF);
+            }
+        }
+
+        Destination[Index] = PackSums(Sums);
+    }
+}
+
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+// Two weights side by side in each 32-bit lane, for _mm_madd_epi16.
+static __forceinline __m128i PairWeights(_In_ INT16 First, _In_ INT16 Second)
+{
+    return _mm_set1_epi32((int)(((UINT32)(UINT16)Second << 16) | (UINT16)First));
+}
+
+
+static void ResampleRowSse2(_In_ const UINT32* Row, _Out_writes_(Count) UINT32* Destination, _In_ const RESAMPLEWEIGHTS* Columns, _In_ INT32 Count)
+{
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i Round = _mm_set1_epi32(RESAMPLE_WEIGHT_ONE / 2);
+
+    for (INT32 Index = 0; Index < Count; Index++)
+    {
+        const UINT32* Taps = &Row[Columns->First[Index]];
+
+        const INT16* Weights = &Columns->Weights[(SIZE_T)Index * Columns->TapStride];
+
+        INT32 TapCount = Columns->Count[Index];
+
+        __m128i Sums = Round;
+
+        INT32 Tap = 0;
+
+        for (; Tap + 2 <= TapCount; Tap += 2)
+        {
+            __m128i Pair = _mm_loadl_epi64((const __m128i*)&Taps[Tap]);
+
+            // Interleave the two pixels' channels and widen them to 16 bits, so that madd multiplies each channel of
+            // both pixels by their weights and adds them together in one go.
+            Pair = _mm_unpacklo_epi8(_mm_unpacklo_epi8(Pair, _mm_srli_si128(Pair, 4)), Zero);
+
+            Sums = _mm_add_epi32(Sums, _mm_madd_epi16(Pair, PairWeights(Weights[Tap], Weights[Tap + 1])));
+        }
+
+        if (Tap < TapCount)
+        {
+            __m128i Single = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)Taps[Tap]), Zero), Zero);
+
+            Sums = _mm_add_epi32(Sums, _mm_madd_epi16(Single, PairWeights(Weights[Tap], 0)));
+        }
+
+        Sums = _mm_srai_epi32(Sums, RESAMPLE_WEIGHT_BITS);
+
+        Sums = _mm_packs_epi32(Sums, Sums);
+
+        Destination[Index] = (UINT32)_mm_cvtsi128_si32(_mm_packus_epi16(Sums, Sums));
+    }
+}
+
+
+static void ResampleColumnsSse2(_In_ const UINT32* Rows, _In_ INT32 RowStride, _In_reads_(TapCount) const INT16* Weights, _In_ INT32 TapCount, _Out_ UINT32* Destination, _In_ INT32 Count)
+{
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i Round = _mm_set1_epi32(RESAMPLE_WEIGHT_ONE / 2);
+
+    INT32 Index = 0;
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        __m128i Sums[4] = { Round, Round, Round, Round };
+
+        for (INT32 Tap = 0; Tap < TapCount; Tap += 2)
+        {
+            BOOL HasPair = (Tap + 1 < TapCount);
+
+            __m128i Upper = _mm_loadu_si128((const __m128i*)&Rows[(SIZE_T)Tap * RowStride + Index]);
+
+            __m128i Lower = HasPair ? _mm_loadu_si128((const __m128i*)&Rows[(SIZE_T)(Tap + 1) * RowStride + Index]) : Zero;
+
+            __m128i Both = PairWeights(Weights[Tap], HasPair ? Weights[Tap + 1] : 0);
+
+            // Pixels 0 and 1, then 2 and 3, with each channel of the upper row next to the same channel of the lower row.
+            __m128i Low = _mm_unpacklo_epi8(Upper, Lower);
+
+            __m128i High = _mm_unpackhi_epi8(Upper, Lower);
+
+            Sums[0] = _mm_add_epi32(Sums[0], _mm_madd_epi16(_mm_unpacklo_epi8(Low, Zero), Both));
+
+            Sums[1] = _mm_add_epi32(Sums[1], _mm_madd_epi16(_mm_unpackhi_epi8(Low, Zero), Both));
+
+            Sums[2] = _mm_add_epi32(Sums[2], _mm_madd_epi16(_mm_unpacklo_epi8(High, Zero), Both));
+
+            Sums[3] = _mm_add_epi32(Sums[3], _mm_madd_epi16(_mm_unpackhi_epi8(High, Zero), Both));
+        }
+
+        __m128i First = _mm_packs_epi32(_mm_srai_epi32(Sums[0], RESAMPLE_WEIGHT_BITS), _mm_srai_epi32(Sums[1], RESAMPLE_WEIGHT_BITS));
+
+        __m128i Second = _mm_packs_epi32(_mm_srai_epi32(Sums[2], RESAMPLE_WEIGHT_BITS), _mm_srai_epi32(Sums[3], RESAMPLE_WEIGHT_BITS));
+
+        _mm_storeu_si128((__m128i*)&Destination[Index], _mm_packus_epi16(First, Second));
+    }
+
+    ResampleColumnsScalar(Rows, RowStride, Weights, TapCount, Destination, Index, Count);
+}
+
+#elif defined(_M_ARM64)
+
+static void ResampleRowNeon(_In_ const UINT32* Row, _Out_writes_(Count) UINT32* Destination, _In_ const RESAMPLEWEIGHTS* Columns, _In_ INT32 Count)
+{
+    for (INT32 Index = 0; Index < Count; Index++)
+    {
+        const UINT32* Taps = &Row[Columns->First[Index]];
+
+        const INT16* Weights = &Columns->Weights[(SIZE_T)Index * Columns->TapStride];
+
+        int32x4_t Sums = vdupq_n_s32(RESAMPLE_WEIGHT_ONE / 2);
+
+        for (INT32 Tap = 0; Tap < Columns->Count[Index]; Tap++)
+        {
+            int16x4_t Channels = vreinterpret_s16_u16(vget_low_u16(vmovl_u8(vcreate_u8(Taps[Tap]))));
+
+            Sums = vmlal_n_s16(Sums, Channels, Weights[Tap]);
+        }
+
+        int16x4_t Narrow = vqmovn_s32(vshrq_n_s32(Sums, RESAMPLE_WEIGHT_BITS));
+
+        Destination[Index] = vget_lane_u32(vreinterpret_u32_u8(vqmovun_s16(vcombine_s16(Narrow, Narrow))), 0);
+    }
+}
+
+
+static void ResampleColumnsNeon(_In_ const UINT32* Rows, _In_ INT32 RowStride, _In_reads_(TapCount) const INT16* Weights, _In_ INT32 TapCount, _Out_ UINT32* Destination, _In_ INT32 Count)
+{
+    INT32 Index = 0;
+
+    for (; Index + 4 <= Count; Index += 4)
+    {
+        int32x4_t Sums[4] = {
+            vdupq_n_s32(RESAMPLE_WEIGHT_ONE / 2),
+            vdupq_n_s32(RESAMPLE_WEIGHT_ONE / 2),
+            vdupq_n_s32(RESAMPLE_WEIGHT_ONE / 2),
+            vdupq_n_s32(RESAMPLE_WEIGHT_ONE / 2) };
+
+        for (INT32 Tap = 0; Tap < TapCount; Tap++)
+        {
+            uint8x16_t Pixels = vld1q_u8((const uint8_t*)&Rows[(SIZE_T)Tap * RowStride + Index]);
+
+            int16x8_t Low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(Pixels)));
+
+            int16x8_t High = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(Pixels)));
+
+            Sums[0] = vmlal_n_s16(Sums[0], vget_low_s16(Low), Weights[Tap]);
+
+            Sums[1] = vmlal_n_s16(Sums[1], vget_high_s16(Low), Weights[Tap]);
+
+            Sums[2] = vmlal_n_s16(Sums[2], vget_low_s16(High), Weights[Tap]);
+
+            Sums[3] = vmlal_n_s16(Sums[3], vget_high_s16(High), Weights[Tap]);
+        }
+
+        int16x8_t First = vcombine_s16(vqmovn_s32(vshrq_n_s32(Sums[0], RESAMPLE_WEIGHT_BITS)), vqmovn_s32(vshrq_n_s32(Sums[1], RESAMPLE_WEIGHT_BITS)));
+
+        int16x8_t Second = vcombine_s16(vqmovn_s32(vshrq_n_s32(Sums[2], RESAMPLE_WEIGHT_BITS)), vqmovn_s32(vshrq_n_s32(Sums[3], RESAMPLE_WEIGHT_BITS)));
+
+        vst1q_u8((uint8_t*)&Destination[Index], vcombine_u8(vqmovun_s16(First), vqmovun_s16(Second)));
+    }
+
+    ResampleColumnsScalar(Rows, RowStride, Weights, TapCount, Destination, Index, Count);
+}
+
+#endif
+
+
+static void ResampleRowsBand(_In_ const RESAMPLEJOB* Job)
+{
+    for (INT32 Row = Job->First; Row < Job->Last; Row++)
+    {
+        const UINT32* Source = &Job->Source[(SIZE_T)(Job->TempTop + Row) * Job->Width];
+
+        UINT32* Temp = &Job->Temp[(SIZE_T)Row * Job->DestinationWidth];
+
+        if (Job->Scalar)
+        {
+            ResampleRowScalar(Source, Temp, Job->Columns, Job->DestinationWidth);
+
+            continue;
+        }
+
+#if defined(_M_IX86) || defined(_M_X64)
+        ResampleRowSse2(Source, Temp, Job->Columns, Job->DestinationWidth);
+#elif defined(_M_ARM64)
+        ResampleRowNeon(Source, Temp, Job->Columns, Job->DestinationWidth);
+#else
+        ResampleRowScalar(Source, Temp, Job->Columns, Job->DestinationWidth);
+#endif
+    }
+}
+
+
+static void ResampleColumnsBand(_In_ const RESAMPLEJOB* Job)
+{
+    const RESAMPLEWEIGHTS* Rows = Job->Rows;
+
+    for (INT32 Row = Job->First; Row < Job->Last; Row++)
+    {
+        const UINT32* Temp = &Job->Temp[(SIZE_T)(Rows->First[Row] - Job->TempTop) * Job->DestinationWidth];
+
+        const INT16* Weights = &Rows->Weights[(SIZE_T)Row * Rows->TapStride];
+
+        UINT32* Destination = &Job->Destination[(SIZE_T)Row * Job->DestinationStride];
+
+        if (Job->Scalar)
+        {
+            ResampleColumnsScalar(Temp, Job->DestinationWidth, Weights, Rows->Count[Row], Destination, 0, Job->DestinationWidth);
+
+            continue;
+        }
+
+#if defined(_M_IX86) || defined(_M_X64)
+        ResampleColumnsSse2(Temp, Job->DestinationWidth, Weights, Rows->Count[Row], Destination, Job->DestinationWidth);
+#elif defined(_M_ARM64)
+        ResampleColumnsNeon(Temp, Job->DestinationWidth, Weights, Rows->Count[Row], Destination, Job->DestinationWidth);
+#else
+        ResampleColumnsScalar(Temp, Job->DestinationWidth, Weights, Rows->Count[Row], Destination, 0, Job->DestinationWidth);
+#endif
+    }
+}
+
+
+static DWORD WINAPI ResampleThreadProc(_In_ LPVOID Parameter)
+{
+    RESAMPLETHREAD* Thread = (RESAMPLETHREAD*)Parameter;
+
+    Thread->Function(&Thread->Job);
+
+    return 0;
+}
+
+
+// Splits Count rows into bands and runs Function on each band on its own thread. One of the bands runs on the
+// calling thread. PixelsPerRow decides how many threads are worth starting. Returns once every band is finished.
+static void RunResampleBands(_In_ RESAMPLEBANDFUNCTION Function, _In_ const RESAMPLEJOB* Job, _In_ INT32 Count, _In_ INT32 PixelsPerRow)
+{
+    SIZE_T ThreadCount = 1;
+
+    if (Job->Scalar == FALSE)
+    {
+        SYSTEM_INFO SystemInfo = { 0 };
+
+        GetSystemInfo(&SystemInfo);
+
+        ThreadCount = min(SystemInfo.dwNumberOfProcessors, RESAMPLE_MAX_THREADS);
+
+        ThreadCount = min(ThreadCount, ((SIZE_T)Count * PixelsPerRow) / RESAMPLE_MIN_PIXELS_PER_THREAD);
+
+        ThreadCount = min(ThreadCount, (SIZE_T)Count);
+
+        ThreadCount = max(ThreadCount, 1);
+    }
+
+    INT32 BandSize = (Count + (INT32)ThreadCount - 1) / (INT32)ThreadCount;
+
+    RESAMPLETHREAD Threads[RESAMPLE_MAX_THREADS];
+
+    HANDLE Handles[RESAMPLE_MAX_THREADS] = { 0 };
+
+    DWORD HandleCount = 0;
+
+    for (INT32 Index = 0; Index < (INT32)ThreadCount; Index++)
+    {
+        Threads[Index].Function = Function;
+
+        Threads[Index].Job = *Job;
+
+        Threads[Index].Job.First = min(Index * BandSize, Count);
+
+        Threads[Index].Job.Last = min((Index + 1) * BandSize, Count);
+    }
+
+    for (INT32 Index = 1; Index < (INT32)ThreadCount; Index++)
+    {
+        HANDLE Thread = CreateThread(NULL, 0, ResampleThreadProc, &Threads[Index], 0, NULL);
+
+        if (Thread == NULL)
+        {
+            // Still get the work done, just not in parallel.
+            Function(&Threads[Index].Job);
+        }
+        else
+        {
+            Handles[HandleCount++] = Thread;
+        }
+    }
+
+    Function(&Threads[0].Job);
+
+    if (HandleCount > 0)
+    {
+        WaitForMultipleObjects(HandleCount, Handles, TRUE, INFINITE);
+
+        for (DWORD Index = 0; Index < HandleCount; Index++)
+        {
+            CloseHandle(Handles[Index]);
+        }
+    }
+}
+
+
+static BOOL Resample(
+    _In_reads_(Width * Height) const UINT32* Source,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ const RECT* Rect,
+    _Out_ UINT32* Destination,
+    _In_ INT32 DestinationStride,
+    _In_ INT32 DestinationWidth,
+    _In_ INT32 DestinationHeight,
+    _In_ BOOL Scalar)
+{
+    if (Rect->left < 0 || Rect->top < 0 || Rect->right > Width || Rect->bottom > Height || Rect->left >= Rect->right || Rect->top >= Rect->bottom || DestinationWidth <= 0 || DestinationHeight <= 0)
+    {
+        return FALSE;
+    }
+
+    RESAMPLEWEIGHTS Columns = { 0 };
+
+    RESAMPLEWEIGHTS Rows = { 0 };
+
+    if (ComputeWeights(&Columns, Rect->left, Rect->right - Rect->left, Width, DestinationWidth) == FALSE)
+    {
+        return FALSE;
+    }
+
+    if (ComputeWeights(&Rows, Rect->top, Rect->bottom - Rect->top, Height, DestinationHeight) == FALSE)
+    {
+        FreeWeights(&Columns);
+
+        return FALSE;
+    }
+
+    // Only the source rows that some destination row takes from are resampled across.
+    INT32 TempTop = Height;
+
+    INT32 TempBottom = 0;
+
+    for (INT32 Row = 0; Row < DestinationHeight; Row++)
+    {
+        TempTop = min(TempTop, Rows.First[Row]);
+
+        TempBottom = max(TempBottom, Rows.First[Row] + Rows.Count[Row]);
+    }
+
+    RESAMPLEJOB Job = { 0 };
+
+    Job.Source = Source;
+
+    Job.Width = Width;
+
+    Job.Temp = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)(TempBottom - TempTop) * DestinationWidth * sizeof(UINT32));
+
+    Job.TempTop = TempTop;
+
+    Job.Destination = Destination;
+
+    Job.DestinationStride = DestinationStride;
+
+    Job.DestinationWidth = DestinationWidth;
+
+    Job.Columns = &Columns;
+
+    Job.Rows = &Rows;
+
+    Job.Scalar = Scalar;
+
+    if (Job.Temp == NULL)
+    {
+        FreeWeights(&Columns);
+
+        FreeWeights(&Rows);
+
+        return FALSE;
+    }
+
+    RunResampleBands(ResampleRowsBand, &Job, TempBottom - TempTop, DestinationWidth);
+
+    RunResampleBands(ResampleColumnsBand, &Job, DestinationHeight, DestinationWidth);
+
+    HeapFree(GetProcessHeap(), 0, Job.Temp);
+
+    FreeWeights(&Columns);
+
+    FreeWeights(&Rows);
+
+    return TRUE;
+}
+
+
+BOOL ResampleImage(
+    _In_reads_(Width * Height) const UINT32* Source,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ const RECT* Rect,
+    _Out_ UINT32* Destination,
+    _In_ INT32 DestinationStride,
+    _In_ INT32 DestinationWidth,
+    _In_ INT32 DestinationHeight)
+{
+    return Resample(Source, Width, Height, Rect, Destination, DestinationStride, DestinationWidth, DestinationHeight, FALSE);
+}
+
+
+BOOL ResampleImageScalar(
+    _In_reads_(Width * Height) const UINT32* Source,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ const RECT* Rect,
+    _Out_ UINT32* Destination,
+    _In_ INT32 DestinationStride,
+    _In_ INT32 DestinationWidth,
+    _In_ INT32 DestinationHeight)
+{
+    return Resample(Source, Width, Height, Rect, Destination, DestinationStride, DestinationWidth, DestinationHeight, TRUE);
+}
+
+
+void ResampleImageNearest(
+    _In_ const UINT32* Source,
+    _In_ INT32 Width,
+    _In_ const RECT* Rect,
+    _Out_ UINT32* Destination,
+    _In_ INT32 DestinationStride,
+    _In_ INT32 DestinationWidth,
+    _In_ INT32 DestinationHeight)
+{
+    INT64 RectWidth = Rect->right - Rect->left;
+
+    INT64 RectHeight = Rect->bottom - Rect->top;
+
+    INT32 PreviousY = -1;
+
+    for (INT32 Y = 0; Y < DestinationHeight; Y++)
+    {
+        UINT32* Row = &Destination[(SIZE_T)Y * DestinationStride];
+
+        // The source pixel whose area the center of this destination pixel falls in.
+        INT32 SourceY = Rect->top + (INT32)(((2 * (INT64)Y + 1) * RectHeight) / (2 * (INT64)DestinationHeight));
+
+        // When magnifying, most rows are the same as the one above them.
+        if (SourceY == PreviousY)
+        {
+            CopyMemory(Row, &Destination[(SIZE_T)(Y - 1) * DestinationStride], (SIZE_T)DestinationWidth * sizeof(UINT32));
+
+            continue;
+        }
+
+        const UINT32* SourceRow = &Source[(SIZE_T)SourceY * Width + Rect->left];
+
+        for (INT32 X = 0; X < DestinationWidth; X++)
+        {
+            Row[X] = SourceRow[((2 * (INT64)X + 1) * RectWidth) / (2 * (INT64)DestinationWidth)];
+        }
+
+        PreviousY = SourceY;
+    }
+}
@@ -0,0 +1,56 @@
+// SnipExResample.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Resizes part of a snip, for the magnified inset of a callout. The finished inset uses a Lanczos-3 filter,
+// one direction at a time, with the weights worked out once per row and column. Dragging uses a plain
+// nearest-neighbour copy, which costs next to nothing.
+
+#pragma once
+
+// Each filter weight is a fixed-point number with this many bits after the point.
+#define RESAMPLE_WEIGHT_BITS            14
+
+// How many pixels on either side of the center a Lanczos-3 filter reaches, before any downscaling.
+#define RESAMPLE_LANCZOS_RADIUS         3
+
+// Images smaller than this many pixels are resampled on the calling thread, since starting threads would
+// take longer than the resampling itself.
+#define RESAMPLE_MIN_PIXELS_PER_THREAD  (256 * 1024)
+
+#define RESAMPLE_MAX_THREADS            16
+
+
+// Resizes Rect of a Width x Height 32bpp image to DestinationWidth x DestinationHeight with a Lanczos-3 filter.
+// The filter reaches past the edges of Rect into the rest of the image, so a magnified part of a snip blends into
+// its surroundings the way it did in the snip; pixels past the edges of the image are left out. DestinationStride
+// is the width of a row of Destination, in pixels. Large images are split across threads. Returns FALSE if
+// memory could not be allocated.
+BOOL ResampleImage(
+    _In_reads_(Width * Height) const UINT32* Source,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ const RECT* Rect,
+    _Out_ UINT32* Destination,
+    _In_ INT32 DestinationStride,
+    _In_ INT32 DestinationWidth,
+    _In_ INT32 DestinationHeight);
+
+// The portable, single-threaded reference implementation of ResampleImage. Gives exactly the same pixels.
+BOOL ResampleImageScalar(
+    _In_reads_(Width * Height) const UINT32* Source,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ const RECT* Rect,
+    _Out_ UINT32* Destination,
+    _In_ INT32 DestinationStride,
+    _In_ INT32 DestinationWidth,
+    _In_ INT32 DestinationHeight);
+
+// Resizes Rect of a 32bpp image Width pixels wide by copying the nearest pixel, for the preview while dragging.
+void ResampleImageNearest(
+    _In_ const UINT32* Source,
+    _In_ INT32 Width,
+    _In_ const RECT* Rect,
+    _Out_ UINT32* Destination,
+    _In_ INT32 DestinationStride,
+    _In_ INT32 DestinationWidth,
+    _In_ INT32 DestinationHeight);
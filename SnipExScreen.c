@@ -0,0 +1,150 @@
+// SnipExScreen.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Captures the screen with BitBlt. The screen is copied into a DIB section, which is the only way GDI hands back
+// pixels that can be read, then the rows are copied out of it into whatever the caller wants them in.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExScreen.h"
+
+
+static BOOL CALLBACK AddMonitor(_In_ HMONITOR Monitor, _In_ HDC DC, _In_ LPRECT Rect, _In_ LPARAM Parameter)
+{
+    CAPTURELAYOUT* Layout = (CAPTURELAYOUT*)Parameter;
+
+    MONITORINFO MonitorInfo = { sizeof(MONITORINFO) };
+
+    UNREFERENCED_PARAMETER(DC);
+
+    UNREFERENCED_PARAMETER(Rect);
+
+    if (Layout->MonitorCount < CAPTURE_MAX_MONITORS && GetMonitorInfoW(Monitor, &MonitorInfo))
+    {
+        Layout->Monitors[Layout->MonitorCount++] = MonitorInfo.rcMonitor;
+    }
+
+    return TRUE;
+}
+
+
+static BOOL ScreenCapture(_Inout_ CAPTURESOURCE* Source, _In_ const RECT* Area, _Out_ UINT32* Pixels, _In_ INT32 Stride)
+{
+    INT32 Width = Area->right - Area->left;
+
+    INT32 Height = Area->bottom - Area->top;
+
+    BITMAPINFO BitmapInfo = { 0 };
+
+    UINT32* Bits = NULL;
+
+    BOOL Result = FALSE;
+
+    BitmapInfo.bmiHeader.biSize        = sizeof(BITMAPINFOHEADER);
+
+    BitmapInfo.bmiHeader.biWidth       = Width;
+
+    BitmapInfo.bmiHeader.biHeight      = -Height;
+
+    BitmapInfo.bmiHeader.biPlanes      = 1;
+
+    BitmapInfo.bmiHeader.biBitCount    = 32;
+
+    BitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+    HDC ScreenDC = GetDC(NULL);
+
+    HDC MemoryDC = CreateCompatibleDC(ScreenDC);
+
+    HBITMAP Bitmap = CreateDIBSection(ScreenDC, &BitmapInfo, DIB_RGB_COLORS, (void**)&Bits, NULL, 0);
+
+    if (ScreenDC != NULL && MemoryDC != NULL && Bitmap != NULL)
+    {
+        HGDIOBJ OldBitmap = SelectObject(MemoryDC, Bitmap);
+
+        if (BitBlt(MemoryDC, 0, 0, Width, Height, ScreenDC, Area->left + Source->Layout.Desktop.left, Area->top + Source->Layout.Desktop.top, SRCCOPY))
+        {
+            GdiFlush();
+
+            for (INT32 Y = 0; Y < Height; Y++)
+            {
+                CopyMemory(&Pixels[(SIZE_T)Y * Stride], &Bits[(SIZE_T)Y * Width], (SIZE_T)Width * sizeof(UINT32));
+            }
+
+            Result = TRUE;
+        }
+
+        SelectObject(MemoryDC, OldBitmap);
+    }
+
+    if (Bitmap != NULL)
+    {
+        DeleteObject(Bitmap);
+    }
+
+    if (MemoryDC != NULL)
+    {
+        DeleteDC(MemoryDC);
+    }
+
+    if (ScreenDC != NULL)
+    {
+        ReleaseDC(NULL, ScreenDC);
+    }
+
+    return Result;
+}
+
+
+static BOOL RefreshScreenLayout(_Inout_ CAPTURESOURCE* Source)
+{
+    CAPTURELAYOUT Layout = { 0 };
+
+    Layout.Desktop.left   = GetSystemMetrics(SM_XVIRTUALSCREEN);
+
+    Layout.Desktop.top    = GetSystemMetrics(SM_YVIRTUALSCREEN);
+
+    Layout.Desktop.right  = Layout.Desktop.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+
+    Layout.Desktop.bottom = Layout.Desktop.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+
+    if (IsRectEmpty(&Layout.Desktop))
+    {
+        return FALSE;
+    }
+
+    EnumDisplayMonitors(NULL, NULL, AddMonitor, (LPARAM)&Layout);
+
+    Source->Layout = Layout;
+
+    return TRUE;
+}
+
+
+BOOL OpenScreenSource(_Out_ CAPTURESOURCE* Source)
+{
+    ZeroMemory(Source, sizeof(CAPTURESOURCE));
+
+    if (RefreshScreenLayout(Source) == FALSE)
+    {
+        return FALSE;
+    }
+
+    Source->Capture = ScreenCapture;
+
+    Source->Refresh = RefreshScreenLayout;
+
+    return TRUE;
+}
@@ -0,0 +1,12 @@
+// SnipExScreen.h
+// Author: Joseph Ryan Ries, 2017-2020
+// The capture source that everything is normally snipped from: the screen, through GDI.
+
+#pragma once
+
+#include "SnipExCapture.h"
+
+
+// Makes Source capture the screen, with the desktop and monitors laid out the way they are right now. Returns FALSE
+// if the size of the desktop can't be had. RefreshCaptureLayout catches Source up when the monitors change.
+BOOL OpenScreenSource(_Out_ CAPTURESOURCE* Source);
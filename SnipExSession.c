@@ -0,0 +1,685 @@
+// SnipExSession.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Writes the snip and its changes to a file as they happen, and reads them back after a crash.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExCompress.h"
+
+#include "SnipExSession.h"
+
+// Magic, version, width, height, and a checksum of those.
+#define HEADER_SIZE 20
+
+// Type, size before compressing, size after compressing, and a checksum of those and the compressed bytes.
+#define FRAME_SIZE  16
+
+
+// 32-bit FNV-1a, carried on from Hash.
+static UINT32 Checksum(_In_ UINT32 Hash, _In_reads_(Size) const UINT8* Bytes, _In_ SIZE_T Size)
+{
+    for (SIZE_T Index = 0; Index < Size; Index++)
+    {
+        Hash = (Hash ^ Bytes[Index]) * 16777619U;
+    }
+
+    return Hash;
+}
+
+
+static void Write32(_Out_writes_(4) UINT8* Bytes, _In_ UINT32 Value)
+{
+    Bytes[0] = (UINT8)Value;
+
+    Bytes[1] = (UINT8)(Value >> 8);
+
+    Bytes[2] = (UINT8)(Value >> 16);
+
+    Bytes[3] = (UINT8)(Value >> 24);
+}
+
+
+static UINT32 Read32(_In_reads_(4) const UINT8* Bytes)
+{
+    return (UINT32)Bytes[0] | ((UINT32)Bytes[1] << 8) | ((UINT32)Bytes[2] << 16) | ((UINT32)Bytes[3] << 24);
+}
+
+
+// Makes sure that there's room for Extra more bytes in Record. Returns FALSE, and marks it as failed, if memory
+// could not be allocated.
+static BOOL GrowRecord(_Inout_ SESSIONRECORD* Record, _In_ SIZE_T Extra)
+{
+    if (Record->Failed)
+    {
+        return FALSE;
+    }
+
+    if (Record->Size + Extra <= Record->Capacity)
+    {
+        return TRUE;
+    }
+
+    SIZE_T NewCapacity = (Record->Capacity == 0) ? 64 : Record->Capacity * 2;
+
+    while (NewCapacity < Record->Size + Extra)
+    {
+        NewCapacity *= 2;
+    }
+
+    UINT8* NewData = NULL;
+
+    if (Record->Data == NULL)
+    {
+        NewData = HeapAlloc(GetProcessHeap(), 0, NewCapacity);
+    }
+    else
+    {
+        NewData = HeapReAlloc(GetProcessHeap(), 0, Record->Data, NewCapacity);
+    }
+
+    if (NewData == NULL)
+    {
+        Record->Failed = TRUE;
+
+        return FALSE;
+    }
+
+    Record->Data = NewData;
+
+    Record->Capacity = NewCapacity;
+
+    return TRUE;
+}
+
+
+static void FreeRecord(_Inout_ SESSIONRECORD* Record)
+{
+    if (Record->Data != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Record->Data);
+    }
+
+    ZeroMemory(Record, sizeof(SESSIONRECORD));
+}
+
+
+// Compresses Size bytes of Data and adds them to Out as a record of the given type, with its frame.
+static void FrameRecord(_Inout_ SESSIONRECORD* Out, _In_ UINT32 Type, _In_reads_(Size) const UINT8* Data, _In_ SIZE_T Size)
+{
+    SIZE_T Bound = COMPRESS_BOUND(Size);
+
+    if (Size > MAXUINT32 || GrowRecord(Out, FRAME_SIZE + Bound) == FALSE)
+    {
+        Out->Failed = TRUE;
+
+        return;
+    }
+
+    UINT8* Frame = &Out->Data[Out->Size];
+
+    SIZE_T Packed = CompressBlock(Data, Size, &Frame[FRAME_SIZE], Bound);
+
+    Write32(&Frame[0], Type);
+
+    Write32(&Frame[4], (UINT32)Size);
+
+    Write32(&Frame[8], (UINT32)Packed);
+
+    Write32(&Frame[12], Checksum(Checksum(2166136261U, Frame, 12), &Frame[FRAME_SIZE], Packed));
+
+    Out->Size += FRAME_SIZE + Packed;
+}
+
+
+// Writes Out to the end of the file and makes sure that it's on the disk. Once anything fails to be written,
+// nothing more is, so that whatever comes after a gap can't be mistaken for what was in it.
+static void WriteOut(_Inout_ SESSION* Session, _Inout_ SESSIONRECORD* Out)
+{
+    DWORD Written = 0;
+
+    if (Out->Failed)
+    {
+        Session->Failed = TRUE;
+    }
+
+    if (Session->Failed == FALSE && Out->Size > 0)
+    {
+        if (Out->Size > MAXDWORD || WriteFile(Session->File, Out->Data, (DWORD)Out->Size, &Written, NULL) == FALSE || Written != Out->Size || FlushFileBuffers(Session->File) == FALSE)
+        {
+            Session->Failed = TRUE;
+        }
+    }
+
+    Out->Size = 0;
+}
+
+
+// Writes the header and the snip, a chunk at a time.
+static void WriteSessionBase(_Inout_ SESSION* Session)
+{
+    SESSIONRECORD Out = { 0 };
+
+    if (GrowRecord(&Out, HEADER_SIZE))
+    {
+        Write32(&Out.Data[0], SESSION_MAGIC);
+
+        Write32(&Out.Data[4], SESSION_VERSION);
+
+        Write32(&Out.Data[8], (UINT32)Session->Width);
+
+        Write32(&Out.Data[12], (UINT32)Session->Height);
+
+        Write32(&Out.Data[16], Checksum(2166136261U, Out.Data, 16));
+
+        Out.Size = HEADER_SIZE;
+    }
+
+    SIZE_T RowBytes = (SIZE_T)Session->Width * sizeof(UINT32);
+
+    INT32 RowsPerChunk = (INT32)max(SESSION_BASE_CHUNK / RowBytes, 1);
+
+    for (INT32 Row = 0; Row < Session->Height && Out.Failed == FALSE; Row += RowsPerChunk)
+    {
+        INT32 Rows = min(RowsPerChunk, Session->Height - Row);
+
+        FrameRecord(&Out, SESSIONRECORD_BASE, (const UINT8*)&Session->Base[(SIZE_T)Row * Session->Width], RowBytes * Rows);
+
+        WriteOut(Session, &Out);
+    }
+
+    WriteOut(Session, &Out);
+
+    FreeRecord(&Out);
+}
+
+
+static DWORD WINAPI SessionWriterProc(_In_ LPVOID Parameter)
+{
+    SESSION* Session = Parameter;
+
+    SESSIONRECORD Out = { 0 };
+
+    WriteSessionBase(Session);
+
+    for (;;)
+    {
+        WaitForSingleObject(Session->WorkEvent, INFINITE);
+
+        // Takes everything that has been handed over since the last batch, so that the UI thread only ever waits
+        // for the lock as long as that takes.
+        EnterCriticalSection(&Session->Lock);
+
+        SESSIONRECORD* Batch = Session->Pending;
+
+        UINT32 Count = Session->PendingCount;
+
+        BOOL Stopping = Session->Stopping;
+
+        Session->Pending = NULL;
+
+        Session->PendingCount = 0;
+
+        Session->PendingCapacity = 0;
+
+        LeaveCriticalSection(&Session->Lock);
+
+        for (UINT32 Index = 0; Index < Count; Index++)
+        {
+            FrameRecord(&Out, Batch[Index].Type, Batch[Index].Data, Batch[Index].Size);
+
+            FreeRecord(&Batch[Index]);
+        }
+
+        if (Batch != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, Batch);
+        }
+
+        WriteOut(Session, &Out);
+
+        if (Stopping)
+        {
+            break;
+        }
+    }
+
+    FreeRecord(&Out);
+
+    return 0;
+}
+
+
+BOOL OpenSession(_Out_ SESSION* Session, _In_ const wchar_t* Path, _In_reads_(Width * Height) const UINT32* Base, _In_ INT32 Width, _In_ INT32 Height)
+{
+    ZeroMemory(Session, sizeof(SESSION));
+
+    if (wcscpy_s(Session->Path, _countof(Session->Path), Path) != 0)
+    {
+        return FALSE;
+    }
+
+    // Not shared, so that another SnipEx that starts up while this one is running doesn't try to recover it.
+    Session->File = CreateFileW(Path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (Session->File == INVALID_HANDLE_VALUE)
+    {
+        Session->File = NULL;
+
+        return FALSE;
+    }
+
+    Session->Base = Base;
+
+    Session->Width = Width;
+
+    Session->Height = Height;
+
+    Session->WorkEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+    if (Session->WorkEvent == NULL)
+    {
+        CloseSession(Session, TRUE);
+
+        return FALSE;
+    }
+
+    InitializeCriticalSection(&Session->Lock);
+
+    Session->Writer = CreateThread(NULL, 0, SessionWriterProc, Session, 0, NULL);
+
+    if (Session->Writer == NULL)
+    {
+        DeleteCriticalSection(&Session->Lock);
+
+        CloseSession(Session, TRUE);
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+void CloseSession(_Inout_ SESSION* Session, _In_ BOOL Discard)
+{
+    if (Session->Writer != NULL)
+    {
+        EnterCriticalSection(&Session->Lock);
+
+        Session->Stopping = TRUE;
+
+        LeaveCriticalSection(&Session->Lock);
+
+        SetEvent(Session->WorkEvent);
+
+        WaitForSingleObject(Session->Writer, INFINITE);
+
+        CloseHandle(Session->Writer);
+
+        DeleteCriticalSection(&Session->Lock);
+    }
+
+    // Only left over if the writer never started.
+    for (UINT32 Index = 0; Index < Session->PendingCount; Index++)
+    {
+        FreeRecord(&Session->Pending[Index]);
+    }
+
+    if (Session->Pending != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Session->Pending);
+    }
+
+    if (Session->WorkEvent != NULL)
+    {
+        CloseHandle(Session->WorkEvent);
+    }
+
+    if (Session->File != NULL)
+    {
+        CloseHandle(Session->File);
+
+        if (Discard)
+        {
+            DeleteFileW(Session->Path);
+        }
+    }
+
+    ZeroMemory(Session, sizeof(SESSION));
+}
+
+
+void BeginSessionRecord(_Out_ SESSIONRECORD* Record, _In_ UINT32 Type)
+{
+    ZeroMemory(Record, sizeof(SESSIONRECORD));
+
+    Record->Type = Type;
+}
+
+
+void PutSessionUInt32(_Inout_ SESSIONRECORD* Record, _In_ UINT32 Value)
+{
+    if (GrowRecord(Record, sizeof(UINT32)))
+    {
+        Write32(&Record->Data[Record->Size], Value);
+
+        Record->Size += sizeof(UINT32);
+    }
+}
+
+
+void PutSessionUInt64(_Inout_ SESSIONRECORD* Record, _In_ UINT64 Value)
+{
+    PutSessionUInt32(Record, (UINT32)Value);
+
+    PutSessionUInt32(Record, (UINT32)(Value >> 32));
+}
+
+
+void PutSessionBytes(_Inout_ SESSIONRECORD* Record, _In_reads_bytes_(Size) const void* Bytes, _In_ SIZE_T Size)
+{
+    if (Size > 0 && GrowRecord(Record, Size))
+    {
+        CopyMemory(&Record->Data[Record->Size], Bytes, Size);
+
+        Record->Size += Size;
+    }
+}
+
+
+void AppendSessionRecord(_Inout_ SESSION* Session, _Inout_ SESSIONRECORD* Record)
+{
+    if (Session->Writer == NULL)
+    {
+        FreeRecord(Record);
+
+        return;
+    }
+
+    EnterCriticalSection(&Session->Lock);
+
+    BOOL Queued = FALSE;
+
+    // A record that couldn't be kept leaves a gap, and replaying what comes after a gap would give the wrong snip.
+    if (Record->Failed)
+    {
+        Session->Failed = TRUE;
+
+        LeaveCriticalSection(&Session->Lock);
+
+        FreeRecord(Record);
+
+        return;
+    }
+
+    if (Session->PendingCount == Session->PendingCapacity)
+    {
+        UINT32 NewCapacity = (Session->PendingCapacity == 0) ? 64 : Session->PendingCapacity * 2;
+
+        SESSIONRECORD* NewPending = NULL;
+
+        if (Session->Pending == NULL)
+        {
+            NewPending = HeapAlloc(GetProcessHeap(), 0, NewCapacity * sizeof(SESSIONRECORD));
+        }
+        else
+        {
+            NewPending = HeapReAlloc(GetProcessHeap(), 0, Session->Pending, NewCapacity * sizeof(SESSIONRECORD));
+        }
+
+        if (NewPending != NULL)
+        {
+            Session->Pending = NewPending;
+
+            Session->PendingCapacity = NewCapacity;
+        }
+    }
+
+    if (Session->PendingCount < Session->PendingCapacity)
+    {
+        Session->Pending[Session->PendingCount++] = *Record;
+
+        Queued = TRUE;
+    }
+    else
+    {
+        Session->Failed = TRUE;
+    }
+
+    LeaveCriticalSection(&Session->Lock);
+
+    if (Queued)
+    {
+        ZeroMemory(Record, sizeof(SESSIONRECORD));
+
+        SetEvent(Session->WorkEvent);
+    }
+    else
+    {
+        FreeRecord(Record);
+    }
+}
+
+
+BOOL LoadSessionFile(_In_ const wchar_t* Path, _Out_ UINT8** Data, _Out_ SIZE_T* Size)
+{
+    *Data = NULL;
+
+    *Size = 0;
+
+    HANDLE File = CreateFileW(Path, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (File == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    LARGE_INTEGER FileSize = { 0 };
+
+    BOOL Loaded = FALSE;
+
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0 && (UINT64)FileSize.QuadPart <= MAXDWORD)
+    {
+        DWORD Read = 0;
+
+        *Data = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)FileSize.QuadPart);
+
+        if (*Data != NULL && ReadFile(File, *Data, (DWORD)FileSize.QuadPart, &Read, NULL) && Read == (DWORD)FileSize.QuadPart)
+        {
+            *Size = Read;
+
+            Loaded = TRUE;
+        }
+        else if (*Data != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, *Data);
+
+            *Data = NULL;
+        }
+    }
+
+    CloseHandle(File);
+
+    return Loaded;
+}
+
+
+BOOL BeginSessionRead(_Out_ SESSIONREADER* Reader, _In_reads_bytes_(Size) const UINT8* Data, _In_ SIZE_T Size)
+{
+    ZeroMemory(Reader, sizeof(SESSIONREADER));
+
+    if (Size < HEADER_SIZE || Read32(&Data[0]) != SESSION_MAGIC || Read32(&Data[4]) != SESSION_VERSION || Read32(&Data[16]) != Checksum(2166136261U, Data, 16))
+    {
+        return FALSE;
+    }
+
+    Reader->Width = (INT32)Read32(&Data[8]);
+
+    Reader->Height = (INT32)Read32(&Data[12]);
+
+    if (Reader->Width <= 0 || Reader->Height <= 0)
+    {
+        return FALSE;
+    }
+
+    Reader->Data = Data;
+
+    Reader->Size = Size;
+
+    Reader->Offset = HEADER_SIZE;
+
+    return TRUE;
+}
+
+
+BOOL ReadSessionBase(_Inout_ SESSIONREADER* Reader, _Out_writes_(Reader->Width * Reader->Height) UINT32* Pixels)
+{
+    SIZE_T Total = (SIZE_T)Reader->Width * Reader->Height * sizeof(UINT32);
+
+    SIZE_T Filled = 0;
+
+    while (Filled < Total)
+    {
+        UINT32 Type = 0;
+
+        SESSIONCURSOR Payload = { 0 };
+
+        if (ReadSessionRecord(Reader, &Type, &Payload) == FALSE || Type != SESSIONRECORD_BASE || Payload.Size > Total - Filled)
+        {
+            return FALSE;
+        }
+
+        CopyMemory((UINT8*)Pixels + Filled, Payload.Data, Payload.Size);
+
+        Filled += Payload.Size;
+    }
+
+    return TRUE;
+}
+
+
+BOOL ReadSessionRecord(_Inout_ SESSIONREADER* Reader, _Out_ UINT32* Type, _Out_ SESSIONCURSOR* Payload)
+{
+    *Type = 0;
+
+    ZeroMemory(Payload, sizeof(SESSIONCURSOR));
+
+    if (Reader->Size - Reader->Offset < FRAME_SIZE)
+    {
+        return FALSE;
+    }
+
+    const UINT8* Frame = &Reader->Data[Reader->Offset];
+
+    UINT32 Size = Read32(&Frame[4]);
+
+    UINT32 Packed = Read32(&Frame[8]);
+
+    // Anything after a damaged record can't be trusted, even if it looks fine, since it might not be what came
+    // right after the record that was there before.
+    Reader->Offset = Reader->Size;
+
+    if (Packed > Reader->Size - (SIZE_T)(Frame - Reader->Data) - FRAME_SIZE || Read32(&Frame[12]) != Checksum(Checksum(2166136261U, Frame, 12), &Frame[FRAME_SIZE], Packed))
+    {
+        return FALSE;
+    }
+
+    // Nothing compresses by more than 255 to 1, so a size bigger than that is damage that the checksum missed.
+    if ((UINT64)Size > (UINT64)Packed * 255)
+    {
+        return FALSE;
+    }
+
+    if (Size > Reader->BufferCapacity)
+    {
+        if (Reader->Buffer != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, Reader->Buffer);
+        }
+
+        Reader->BufferCapacity = 0;
+
+        if ((Reader->Buffer = HeapAlloc(GetProcessHeap(), 0, Size)) == NULL)
+        {
+            return FALSE;
+        }
+
+        Reader->BufferCapacity = Size;
+    }
+
+    if (DecompressBlock(&Frame[FRAME_SIZE], Packed, Reader->Buffer, Size) == FALSE)
+    {
+        return FALSE;
+    }
+
+    Reader->Offset = (SIZE_T)(Frame - Reader->Data) + FRAME_SIZE + Packed;
+
+    *Type = Read32(&Frame[0]);
+
+    Payload->Data = Reader->Buffer;
+
+    Payload->Size = Size;
+
+    return TRUE;
+}
+
+
+void EndSessionRead(_Inout_ SESSIONREADER* Reader)
+{
+    if (Reader->Buffer != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Reader->Buffer);
+    }
+
+    ZeroMemory(Reader, sizeof(SESSIONREADER));
+}
+
+
+UINT32 GetSessionUInt32(_Inout_ SESSIONCURSOR* Cursor)
+{
+    UINT8 Bytes[4] = { 0 };
+
+    GetSessionBytes(Cursor, Bytes, sizeof(Bytes));
+
+    return Read32(Bytes);
+}
+
+
+UINT64 GetSessionUInt64(_Inout_ SESSIONCURSOR* Cursor)
+{
+    UINT64 Low = GetSessionUInt32(Cursor);
+
+    return Low | ((UINT64)GetSessionUInt32(Cursor) << 32);
+}
+
+
+BOOL GetSessionBytes(_Inout_ SESSIONCURSOR* Cursor, _Out_writes_bytes_(Size) void* Bytes, _In_ SIZE_T Size)
+{
+    if (Cursor->Failed || Size > Cursor->Size - Cursor->Offset)
+    {
+        Cursor->Failed = TRUE;
+
+        ZeroMemory(Bytes, Size);
+
+        return FALSE;
+    }
+
+    CopyMemory(Bytes, &Cursor->Data[Cursor->Offset], Size);
+
+    Cursor->Offset += Size;
+
+    return TRUE;
+}
@@ -0,0 +1,168 @@
+// SnipExSession.h
+// Author: Joseph Ryan Ries, 2017-2020
+// A file that the snip and every change made to it are written to as they happen, so that if SnipEx doesn't close
+// cleanly, the snip can be put back together the next time it starts. The file is only ever added to: a header,
+// then the snip as it was taken, then a record for each change. Every record is compressed and has a checksum, so
+// a record that was only partly written when SnipEx went down is found, and it and anything after it are ignored.
+// Records are written by a worker thread, a batch at a time with one flush per batch, so drawing never waits on
+// the disk. Everything in the file is little-endian, and reading it back needs nothing from Windows but memory.
+
+#pragma once
+
+// "SNXS"
+#define SESSION_MAGIC      0x53584E53
+
+#define SESSION_VERSION    1
+
+// How many bytes of the snip go in each of its records, at most. Always at least one whole row.
+#define SESSION_BASE_CHUNK (1024 * 1024)
+
+typedef enum SESSIONRECORDTYPE
+{
+    // Rows of the snip as it was taken, top to bottom. These come first, until the whole snip has been written.
+    SESSIONRECORD_BASE = 1,
+
+    // An annotation, written by whoever owns the session.
+    SESSIONRECORD_ANNOTATION,
+
+    SESSIONRECORD_UNDO,
+
+    SESSIONRECORD_REDO
+
+} SESSIONRECORDTYPE;
+
+// A record being put together, before it's handed to the writer.
+typedef struct SESSIONRECORD
+{
+    UINT32 Type;
+
+    UINT8* Data;
+
+    SIZE_T Size;
+
+    SIZE_T Capacity;
+
+    // Set if memory ran out while adding to it. A record like that is thrown away instead of being written.
+    BOOL   Failed;
+
+} SESSIONRECORD;
+
+// A record that was read back.
+typedef struct SESSIONCURSOR
+{
+    const UINT8* Data;
+
+    SIZE_T       Size;
+
+    SIZE_T       Offset;
+
+    // Set if anything was read past the end. Whatever was read is 0.
+    BOOL         Failed;
+
+} SESSIONCURSOR;
+
+typedef struct SESSION
+{
+    // So that it can be deleted once it isn't needed.
+    wchar_t          Path[MAX_PATH];
+
+    HANDLE           File;
+
+    // The snip as it was taken, which the writer writes out first. Owned by the document.
+    const UINT32*    Base;
+
+    INT32            Width;
+
+    INT32            Height;
+
+    // Records waiting to be written, oldest first.
+    SESSIONRECORD*   Pending;
+
+    UINT32           PendingCount;
+
+    UINT32           PendingCapacity;
+
+    // Held by whoever is looking at or changing Pending or Stopping.
+    CRITICAL_SECTION Lock;
+
+    HANDLE           Writer;
+
+    // Set whenever there are records for the writer to write.
+    HANDLE           WorkEvent;
+
+    BOOL             Stopping;
+
+    // Set if the file couldn't be written to, or a record couldn't be kept, after which nothing more is written.
+    BOOL             Failed;
+
+} SESSION;
+
+// Reads a session back out of memory.
+typedef struct SESSIONREADER
+{
+    const UINT8* Data;
+
+    SIZE_T       Size;
+
+    SIZE_T       Offset;
+
+    INT32        Width;
+
+    INT32        Height;
+
+    // Where the record that was read last is decompressed to.
+    UINT8*       Buffer;
+
+    SIZE_T       BufferCapacity;
+
+} SESSIONREADER;
+
+
+// Creates the file at Path, replacing whatever was there, and starts the writer, which writes the Width x Height
+// snip in Base to it first. Base has to stay as it is until the session is closed. Returns FALSE if the file could
+// not be created or the writer could not be started.
+BOOL OpenSession(_Out_ SESSION* Session, _In_ const wchar_t* Path, _In_reads_(Width * Height) const UINT32* Base, _In_ INT32 Width, _In_ INT32 Height);
+
+// Waits for every record that was handed to the writer to be written, stops it, and closes the file. If Discard
+// is TRUE, the file is deleted, since nothing in it will be needed. Safe to call on a session that was never opened.
+void CloseSession(_Inout_ SESSION* Session, _In_ BOOL Discard);
+
+// Starts an empty record of the given SESSIONRECORDTYPE.
+void BeginSessionRecord(_Out_ SESSIONRECORD* Record, _In_ UINT32 Type);
+
+void PutSessionUInt32(_Inout_ SESSIONRECORD* Record, _In_ UINT32 Value);
+
+void PutSessionUInt64(_Inout_ SESSIONRECORD* Record, _In_ UINT64 Value);
+
+// Adds Size bytes as they are. Arrays of pixels go in this way, and are little-endian because every platform that
+// SnipEx runs on is.
+void PutSessionBytes(_Inout_ SESSIONRECORD* Record, _In_reads_bytes_(Size) const void* Bytes, _In_ SIZE_T Size);
+
+// Hands Record to the writer, which owns it from then on, and returns straight away. Record is left empty. If
+// memory ran out while putting it together, it is thrown away instead.
+void AppendSessionRecord(_Inout_ SESSION* Session, _Inout_ SESSIONRECORD* Record);
+
+// Reads the whole file at Path into memory, for BeginSessionRead. The caller frees Data with HeapFree. Returns
+// FALSE if there is no such file, or it's in use by another SnipEx.
+BOOL LoadSessionFile(_In_ const wchar_t* Path, _Out_ UINT8** Data, _Out_ SIZE_T* Size);
+
+// Starts reading a session from Size bytes of Data, which have to stay as they are until EndSessionRead. Returns
+// FALSE if it doesn't start with a session header.
+BOOL BeginSessionRead(_Out_ SESSIONREADER* Reader, _In_reads_bytes_(Size) const UINT8* Data, _In_ SIZE_T Size);
+
+// Reads the snip as it was taken into Pixels, which has room for Reader->Width * Reader->Height pixels. Returns
+// FALSE if the file ends or is damaged before the whole snip.
+BOOL ReadSessionBase(_Inout_ SESSIONREADER* Reader, _Out_writes_(Reader->Width * Reader->Height) UINT32* Pixels);
+
+// Reads the next record. Payload points into the reader, and is good until the next record is read. Returns FALSE
+// once there are no more, or at the first record that is damaged or was only partly written.
+BOOL ReadSessionRecord(_Inout_ SESSIONREADER* Reader, _Out_ UINT32* Type, _Out_ SESSIONCURSOR* Payload);
+
+void EndSessionRead(_Inout_ SESSIONREADER* Reader);
+
+UINT32 GetSessionUInt32(_Inout_ SESSIONCURSOR* Cursor);
+
+UINT64 GetSessionUInt64(_Inout_ SESSIONCURSOR* Cursor);
+
+// Copies the next Size bytes into Bytes. Returns FALSE, and fills Bytes with 0, if there aren't that many left.
+BOOL GetSessionBytes(_Inout_ SESSIONCURSOR* Cursor, _Out_writes_bytes_(Size) void* Bytes, _In_ SIZE_T Size);
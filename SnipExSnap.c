@@ -0,0 +1,636 @@
+// SnipExSnap.c
+// Author: Joseph Ryan Ries, 2017-2020
+// An edge is where the brightness steps from one pixel to the next, smoothed over the rows (or columns) either side
+// so that one odd pixel doesn't count. It's measured between two pixels rather than on one, so the same edge is
+// where a selection starts on one side and stops on the other. Finding the edge pixels is the expensive part, and
+// is done 8 pixels at a time, by the background analysis of the screenshot, in bands of rows. Then one pass down
+// the mask finds where each column's vertical edges and each row's horizontal edges start and stop, 8 columns to a
+// word, so that only the starts and stops are looked at one by one, and keeps only the long edges. A second pass
+// writes the kept edges out as sorted lists, which the mouse looks up with a binary search.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#include <intrin.h>
+#include <stdlib.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExSnap.h"
+
+// Marked in the mask on the pixels of edges that are long enough to keep.
+#define SNAPEDGE_KEEP_VERTICAL    4
+
+#define SNAPEDGE_KEEP_HORIZONTAL  8
+
+// A flag repeated in each byte of a word, to check 8 pixels of the mask at once.
+#define EIGHT_TIMES(Flag)         (0x0101010101010101ull * (Flag))
+
+
+static __forceinline UINT32 Brightness(_In_ UINT32 Pixel)
+{
+    return ((((Pixel >> 16) & 0xFF) * 77) + (((Pixel >> 8) & 0xFF) * 150) + ((Pixel & 0xFF) * 29)) >> 8;
+}
+
+
+// Reads Count bytes of the mask, up to 8, into one word. The bytes past Count are 0.
+static __forceinline UINT64 ReadBytes(_In_reads_(Count) const UINT8* Bytes, _In_ INT32 Count)
+{
+    UINT64 Word = 0;
+
+    if (Count == sizeof(Word))
+    {
+        CopyMemory(&Word, Bytes, sizeof(Word));
+    }
+    else
+    {
+        CopyMemory(&Word, Bytes, (SIZE_T)Count);
+    }
+
+    return Word;
+}
+
+
+// The index of the lowest set bit. Bits must not be 0. Done in halves, since 32-bit x86 has no 64-bit bit scan.
+static __forceinline INT32 GetLowestBit(_In_ UINT64 Bits)
+{
+    unsigned long Index = 0;
+
+    if ((UINT32)Bits != 0)
+    {
+        _BitScanForward(&Index, (UINT32)Bits);
+
+        return (INT32)Index;
+    }
+
+    _BitScanForward(&Index, (UINT32)(Bits >> 32));
+
+    return (INT32)Index + 32;
+}
+
+
+void GetEdgeRowScalar(
+    _In_reads_(Width) const UINT8* Above,
+    _In_reads_(Width) const UINT8* Middle,
+    _In_reads_(Width) const UINT8* Below,
+    _In_ INT32 Width,
+    _In_ INT32 First,
+    _In_ INT32 Last,
+    _Out_writes_(Width) UINT8* Edges)
+{
+    for (INT32 X = First; X < Last; X++)
+    {
+        INT32 Left = max(X - 1, 0);
+
+        INT32 Right = min(X + 1, Width - 1);
+
+        // The first column has nothing to its left, so it never has a vertical edge.
+        INT32 Across = (X == 0) ? 0 : (Above[X] + 2 * Middle[X] + Below[X]) - (Above[X - 1] + 2 * Middle[X - 1] + Below[X - 1]);
+
+        INT32 Down = (Middle[Left] - Above[Left]) + 2 * (Middle[X] - Above[X]) + (Middle[Right] - Above[Right]);
+
+        Edges[X] = (UINT8)((abs(Across) >= SNAP_EDGE_THRESHOLD ? SNAPEDGE_VERTICAL : 0) | (abs(Down) >= SNAP_EDGE_THRESHOLD ? SNAPEDGE_HORIZONTAL : 0));
+    }
+}
+
+
+void GetEdgeRow(
+    _In_reads_(Width) const UINT8* Above,
+    _In_reads_(Width) const UINT8* Middle,
+    _In_reads_(Width) const UINT8* Below,
+    _In_ INT32 Width,
+    _Out_writes_(Width) UINT8* Edges)
+{
+    // The first column, and the last one, which would read past the end of the row, are left to the scalar loop.
+    INT32 X = 1;
+
+    GetEdgeRowScalar(Above, Middle, Below, Width, 0, min(Width, 1), Edges);
+
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i Threshold = _mm_set1_epi16(SNAP_EDGE_THRESHOLD - 1);
+
+    __m128i Vertical = _mm_set1_epi16(SNAPEDGE_VERTICAL);
+
+    __m128i Horizontal = _mm_set1_epi16(SNAPEDGE_HORIZONTAL);
+
+    for (; X + 9 <= Width; X += 8)
+    {
+        __m128i AboveLeft = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Above[X - 1]), Zero);
+
+        __m128i AboveHere = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Above[X]), Zero);
+
+        __m128i AboveRight = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Above[X + 1]), Zero);
+
+        __m128i MiddleLeft = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Middle[X - 1]), Zero);
+
+        __m128i MiddleHere = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Middle[X]), Zero);
+
+        __m128i MiddleRight = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Middle[X + 1]), Zero);
+
+        __m128i BelowLeft = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Below[X - 1]), Zero);
+
+        __m128i BelowHere = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)&Below[X]), Zero);
+
+        // Both sums are at most 4 * 255 either way, which fits in 16 bits with room to spare.
+        __m128i Across = _mm_sub_epi16(
+            _mm_add_epi16(_mm_add_epi16(AboveHere, BelowHere), _mm_slli_epi16(MiddleHere, 1)),
+            _mm_add_epi16(_mm_add_epi16(AboveLeft, BelowLeft), _mm_slli_epi16(MiddleLeft, 1)));
+
+        __m128i Down = _mm_add_epi16(
+            _mm_add_epi16(_mm_sub_epi16(MiddleLeft, AboveLeft), _mm_sub_epi16(MiddleRight, AboveRight)),
+            _mm_slli_epi16(_mm_sub_epi16(MiddleHere, AboveHere), 1));
+
+        Across = _mm_max_epi16(Across, _mm_sub_epi16(Zero, Across));
+
+        Down = _mm_max_epi16(Down, _mm_sub_epi16(Zero, Down));
+
+        __m128i Flags = _mm_or_si128(
+            _mm_and_si128(_mm_cmpgt_epi16(Across, Threshold), Vertical),
+            _mm_and_si128(_mm_cmpgt_epi16(Down, Threshold), Horizontal));
+
+        _mm_storel_epi64((__m128i*)&Edges[X], _mm_packus_epi16(Flags, Flags));
+    }
+#elif defined(_M_ARM64)
+    int16x8_t Threshold = vdupq_n_s16(SNAP_EDGE_THRESHOLD - 1);
+
+    uint16x8_t Vertical = vdupq_n_u16(SNAPEDGE_VERTICAL);
+
+    uint16x8_t Horizontal = vdupq_n_u16(SNAPEDGE_HORIZONTAL);
+
+    for (; X + 9 <= Width; X += 8)
+    {
+        int16x8_t AboveLeft = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Above[X - 1])));
+
+        int16x8_t AboveHere = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Above[X])));
+
+        int16x8_t AboveRight = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Above[X + 1])));
+
+        int16x8_t MiddleLeft = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Middle[X - 1])));
+
+        int16x8_t MiddleHere = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Middle[X])));
+
+        int16x8_t MiddleRight = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Middle[X + 1])));
+
+        int16x8_t BelowLeft = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Below[X - 1])));
+
+        int16x8_t BelowHere = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&Below[X])));
+
+        int16x8_t Across = vsubq_s16(
+            vaddq_s16(vaddq_s16(AboveHere, BelowHere), vshlq_n_s16(MiddleHere, 1)),
+            vaddq_s16(vaddq_s16(AboveLeft, BelowLeft), vshlq_n_s16(MiddleLeft, 1)));
+
+        int16x8_t Down = vaddq_s16(
+            vaddq_s16(vsubq_s16(MiddleLeft, AboveLeft), vsubq_s16(MiddleRight, AboveRight)),
+            vshlq_n_s16(vsubq_s16(MiddleHere, AboveHere), 1));
+
+        uint16x8_t Flags = vorrq_u16(
+            vandq_u16(vcgtq_s16(vabsq_s16(Across), Threshold), Vertical),
+            vandq_u16(vcgtq_s16(vabsq_s16(Down), Threshold), Horizontal));
+
+        vst1_u8(&Edges[X], vmovn_u16(Flags));
+    }
+#endif
+
+    GetEdgeRowScalar(Above, Middle, Below, Width, X, Width, Edges);
+}
+
+
+void GetBrightnessRow(_In_reads_(Width * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Y, _Out_writes_(Width) UINT8* Row)
+{
+    // Rows off of the top and bottom are the edge rows repeated, so that the border doesn't look like an edge.
+    const UINT32* Source = &Pixels[(SIZE_T)max(0, min(Y, Height - 1)) * Width];
+
+    INT32 X = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i RedBlueMask = _mm_set1_epi32(0x00FF00FF);
+
+    __m128i GreenMask = _mm_set1_epi32(0x000000FF);
+
+    // Blue and red are side by side in each pixel once green and alpha are masked off, so one multiply-add weighs
+    // them both. Green is on its own.
+    __m128i RedBlueWeights = _mm_set1_epi32((77 << 16) | 29);
+
+    __m128i GreenWeight = _mm_set1_epi32(150);
+
+    for (; X + 16 <= Width; X += 16)
+    {
+        __m128i Sums[4];
+
+        for (INT32 Part = 0; Part < 4; Part++)
+        {
+            __m128i Four = _mm_loadu_si128((const __m128i*)&Source[X + Part * 4]);
+
+            __m128i RedBlue = _mm_madd_epi16(_mm_and_si128(Four, RedBlueMask), RedBlueWeights);
+
+            __m128i Green = _mm_madd_epi16(_mm_and_si128(_mm_srli_epi32(Four, 8), GreenMask), GreenWeight);
+
+            Sums[Part] = _mm_srli_epi32(_mm_add_epi32(RedBlue, Green), 8);
+        }
+
+        __m128i Eight = _mm_packs_epi32(Sums[0], Sums[1]);
+
+        __m128i Sixteen = _mm_packus_epi16(Eight, _mm_packs_epi32(Sums[2], Sums[3]));
+
+        _mm_storeu_si128((__m128i*)&Row[X], Sixteen);
+    }
+#elif defined(_M_ARM64)
+    uint8x8_t BlueWeight = vdup_n_u8(29);
+
+    uint8x8_t GreenWeight = vdup_n_u8(150);
+
+    uint8x8_t RedWeight = vdup_n_u8(77);
+
+    for (; X + 8 <= Width; X += 8)
+    {
+        // Splits 8 pixels into a vector of each channel. The weights add up to 256, so the sum fits in 16 bits.
+        uint8x8x4_t Channels = vld4_u8((const uint8_t*)&Source[X]);
+
+        uint16x8_t Sum = vmull_u8(Channels.val[0], BlueWeight);
+
+        Sum = vmlal_u8(Sum, Channels.val[1], GreenWeight);
+
+        Sum = vmlal_u8(Sum, Channels.val[2], RedWeight);
+
+        vst1_u8(&Row[X], vshrn_n_u16(Sum, 8));
+    }
+#endif
+
+    for (; X < Width; X++)
+    {
+        Row[X] = (UINT8)Brightness(Source[X]);
+    }
+}
+
+
+// Keeps the vertical edge down column X from row Start up to End, if it's long enough, and counts it in the rows'
+// totals, which are kept one row down in RowStart until they're added up.
+static void EndVerticalEdge(_Inout_ UINT8* Mask, _In_ INT32 Width, _Inout_ UINT32* RowStart, _In_ INT32 X, _In_ INT32 Start, _In_ INT32 End)
+{
+    if (End - Start < SNAP_MIN_LENGTH)
+    {
+        return;
+    }
+
+    for (INT32 Y = Start; Y < End; Y++)
+    {
+        Mask[(SIZE_T)Y * Width + X] |= SNAPEDGE_KEEP_VERTICAL;
+
+        RowStart[Y + 1]++;
+    }
+}
+
+
+// Keeps the horizontal edge along Row from column Start up to End, if it's long enough, and counts it in the
+// columns' totals, which are kept one column along in ColumnStart until they're added up.
+static void EndHorizontalEdge(_Inout_ UINT8* Row, _Inout_ UINT32* ColumnStart, _In_ INT32 Start, _In_ INT32 End)
+{
+    if (End - Start < SNAP_MIN_LENGTH)
+    {
+        return;
+    }
+
+    for (INT32 X = Start; X < End; X++)
+    {
+        Row[X] |= SNAPEDGE_KEEP_HORIZONTAL;
+
+        ColumnStart[X + 1]++;
+    }
+}
+
+
+static BOOL IsCancelled(_In_opt_ volatile LONG* Cancelled)
+{
+    return (Cancelled != NULL && InterlockedCompareExchange(Cancelled, FALSE, FALSE) != FALSE);
+}
+
+
+BOOL BuildSnapEdges(
+    _Inout_updates_(Width * Height) UINT8* Mask,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_opt_ volatile LONG* Cancelled,
+    _Out_ SNAPEDGES* Edges)
+{
+    BOOL Result = FALSE;
+
+    ZeroMemory(Edges, sizeof(SNAPEDGES));
+
+    if (Width <= 0 || Height <= 0 || Width > MAXUINT16 || Height > MAXUINT16)
+    {
+        return FALSE;
+    }
+
+    Edges->Width = Width;
+
+    Edges->Height = Height;
+
+    Edges->RowStart = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, ((SIZE_T)Height + 1) * sizeof(UINT32));
+
+    Edges->ColumnStart = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, ((SIZE_T)Width + 1) * sizeof(UINT32));
+
+    // The row each column's vertical edge started on, if Running says the column is on one. Later, where the next
+    // of each column's rows goes in Edges->Rows.
+    INT32* Starts = HeapAlloc(GetProcessHeap(), 0, (SIZE_T)Width * sizeof(INT32));
+
+    // Each column's byte is SNAPEDGE_VERTICAL while it's on a vertical edge, so that comparing it with the row's
+    // finds where the edges start and stop, 8 columns at a time.
+    UINT8* Running = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, (SIZE_T)Width);
+
+    if (Edges->RowStart == NULL || Edges->ColumnStart == NULL || Starts == NULL || Running == NULL)
+    {
+        goto Exit;
+    }
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        UINT8* Row = &Mask[(SIZE_T)Y * Width];
+
+        if (IsCancelled(Cancelled))
+        {
+            goto Exit;
+        }
+
+        // Where the horizontal edge the row is on started, or -1 if it isn't on one.
+        INT32 Start = -1;
+
+        // The flag of the column to the left of the 8 being looked at, in the first of the 8 bytes.
+        UINT64 Previous = 0;
+
+        for (INT32 X = 0; X < Width; X += 8)
+        {
+            INT32 Count = min(8, Width - X);
+
+            UINT64 Flags = ReadBytes(&Row[X], Count);
+
+            // The columns where a vertical edge starts or stops on this row, one bit each.
+            UINT64 Changes = (Flags ^ ReadBytes(&Running[X], Count)) & EIGHT_TIMES(SNAPEDGE_VERTICAL);
+
+            while (Changes != 0)
+            {
+                INT32 Column = X + GetLowestBit(Changes) / 8;
+
+                Changes &= Changes - 1;
+
+                Running[Column] ^= SNAPEDGE_VERTICAL;
+
+                if (Running[Column] != 0)
+                {
+                    Starts[Column] = Y;
+                }
+                else
+                {
+                    EndVerticalEdge(Mask, Width, Edges->RowStart, Column, Starts[Column], Y);
+                }
+            }
+
+            Flags &= EIGHT_TIMES(SNAPEDGE_HORIZONTAL);
+
+            // The columns where a horizontal edge starts or stops, which are the ones whose flag isn't the same as
+            // the flag of the column to their left.
+            Changes = Flags ^ ((Flags << 8) | Previous);
+
+            Previous = Flags >> 56;
+
+            while (Changes != 0)
+            {
+                INT32 Column = X + GetLowestBit(Changes) / 8;
+
+                Changes &= Changes - 1;
+
+                if (Start < 0)
+                {
+                    Start = Column;
+                }
+                else
+                {
+                    EndHorizontalEdge(Row, Edges->ColumnStart, Start, Column);
+
+                    Start = -1;
+                }
+            }
+        }
+
+        if (Start >= 0)
+        {
+            EndHorizontalEdge(Row, Edges->ColumnStart, Start, Width);
+        }
+    }
+
+    for (INT32 X = 0; X < Width; X++)
+    {
+        if (Running[X] != 0)
+        {
+            EndVerticalEdge(Mask, Width, Edges->RowStart, X, Starts[X], Height);
+        }
+    }
+
+    // Each count becomes where its row's or column's list starts.
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        Edges->RowStart[Y + 1] += Edges->RowStart[Y];
+    }
+
+    for (INT32 X = 0; X < Width; X++)
+    {
+        Edges->ColumnStart[X + 1] += Edges->ColumnStart[X];
+
+        Starts[X] = (INT32)Edges->ColumnStart[X];
+    }
+
+    Edges->Columns = HeapAlloc(GetProcessHeap(), 0, max(Edges->RowStart[Height], 1) * sizeof(UINT16));
+
+    Edges->Rows = HeapAlloc(GetProcessHeap(), 0, max(Edges->ColumnStart[Width], 1) * sizeof(UINT16));
+
+    if (Edges->Columns == NULL || Edges->Rows == NULL)
+    {
+        goto Exit;
+    }
+
+    // Going left to right along each row, and down the rows, puts every list in order without sorting.
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        const UINT8* Row = &Mask[(SIZE_T)Y * Width];
+
+        UINT32 Next = Edges->RowStart[Y];
+
+        if (IsCancelled(Cancelled))
+        {
+            goto Exit;
+        }
+
+        for (INT32 X = 0; X < Width; X += 8)
+        {
+            UINT64 Kept = ReadBytes(&Row[X], min(8, Width - X)) & EIGHT_TIMES(SNAPEDGE_KEEP_VERTICAL | SNAPEDGE_KEEP_HORIZONTAL);
+
+            while (Kept != 0)
+            {
+                INT32 Bit = GetLowestBit(Kept);
+
+                INT32 Column = X + Bit / 8;
+
+                Kept &= Kept - 1;
+
+                if ((1 << (Bit % 8)) == SNAPEDGE_KEEP_VERTICAL)
+                {
+                    Edges->Columns[Next++] = (UINT16)Column;
+                }
+                else
+                {
+                    Edges->Rows[Starts[Column]++] = (UINT16)Y;
+                }
+            }
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+
+    if (Starts != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Starts);
+    }
+
+    if (Running != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Running);
+    }
+
+    if (Result == FALSE)
+    {
+        FreeSnapEdges(Edges);
+    }
+
+    return Result;
+}
+
+
+void FreeSnapEdges(_Inout_ SNAPEDGES* Edges)
+{
+    if (Edges->RowStart != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Edges->RowStart);
+    }
+
+    if (Edges->Columns != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Edges->Columns);
+    }
+
+    if (Edges->ColumnStart != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Edges->ColumnStart);
+    }
+
+    if (Edges->Rows != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, Edges->Rows);
+    }
+
+    ZeroMemory(Edges, sizeof(SNAPEDGES));
+}
+
+
+// Finds the one of the Count positions in the sorted List that's nearest to Position, and if it's nearer than
+// Nearest, makes it the new nearest.
+static void FindNearest(_In_reads_(Count) const UINT16* List, _In_ UINT32 Count, _In_ INT32 Position, _Inout_ INT32* Nearest, _Inout_ INT32* Snapped)
+{
+    UINT32 Low = 0;
+
+    UINT32 High = Count;
+
+    while (Low < High)
+    {
+        UINT32 Middle = Low + (High - Low) / 2;
+
+        if ((INT32)List[Middle] < Position)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    // Low is the first one at or after Position, so the only other one that can be nearer is the one before it.
+    if (Low < Count && (INT32)List[Low] - Position < *Nearest)
+    {
+        *Nearest = (INT32)List[Low] - Position;
+
+        *Snapped = List[Low];
+    }
+
+    if (Low > 0 && Position - (INT32)List[Low - 1] < *Nearest)
+    {
+        *Nearest = Position - (INT32)List[Low - 1];
+
+        *Snapped = List[Low - 1];
+    }
+}
+
+
+// Looks for the position nearest to Position in the lists of the Count lines within Distance of Line, nearest
+// line first. Starts, with Count + 1 entries, says where each line's list is in Lists.
+static BOOL SnapToEdge(
+    _In_reads_(Count + 1) const UINT32* Starts,
+    _In_ const UINT16* Lists,
+    _In_ INT32 Count,
+    _In_ INT32 Line,
+    _In_ INT32 Position,
+    _In_ INT32 Distance,
+    _Out_ INT32* Snapped)
+{
+    INT32 Nearest = Distance + 1;
+
+    *Snapped = Position;
+
+    if (Starts == NULL || Distance < 0)
+    {
+        return FALSE;
+    }
+
+    for (INT32 Offset = 0; Offset <= Distance && Nearest > 0; Offset++)
+    {
+        for (INT32 Side = 0; Side < (Offset == 0 ? 1 : 2); Side++)
+        {
+            INT32 Index = (Side == 0) ? Line - Offset : Line + Offset;
+
+            if (Index >= 0 && Index < Count)
+            {
+                FindNearest(&Lists[Starts[Index]], Starts[Index + 1] - Starts[Index], Position, &Nearest, Snapped);
+            }
+        }
+    }
+
+    return (Nearest <= Distance);
+}
+
+
+BOOL SnapToVerticalEdge(_In_ const SNAPEDGES* Edges, _In_ INT32 X, _In_ INT32 Y, _In_ INT32 Distance, _Out_ INT32* Snapped)
+{
+    return SnapToEdge(Edges->RowStart, Edges->Columns, Edges->Height, Y, X, Distance, Snapped);
+}
+
+
+BOOL SnapToHorizontalEdge(_In_ const SNAPEDGES* Edges, _In_ INT32 X, _In_ INT32 Y, _In_ INT32 Distance, _Out_ INT32* Snapped)
+{
+    return SnapToEdge(Edges->ColumnStart, Edges->Rows, Edges->Width, X, Y, Distance, Snapped);
+}
@@ -0,0 +1,88 @@
+// SnipExSnap.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Finds the long, straight edges in a screenshot, such as the borders of windows, toolbars and panes, so that the
+// capture selection can snap to them as it's dragged. The edges are found once per screenshot and kept as a sorted
+// list of edge columns for each row and edge rows for each column, so that finding the one nearest the mouse is a
+// binary search, however big the desktop is.
+
+#pragma once
+
+// How much the brightness has to change from one side of an edge to the other. The change is summed over three
+// rows (or columns) weighted 1, 2, 1, so this is 4 times the change in brightness of a single row.
+#define SNAP_EDGE_THRESHOLD  64
+
+// Edges shorter than this many pixels are left out, so that text and icons don't get in the way.
+#define SNAP_MIN_LENGTH      24
+
+// How close the mouse has to be to an edge, in pixels at 96 DPI, for the selection to snap to it.
+#define SNAP_DISTANCE        6
+
+// What each byte of the edge mask says about its pixel. An edge between the pixel and the one to the left of it.
+#define SNAPEDGE_VERTICAL    1
+
+// An edge between the pixel and the one above it.
+#define SNAPEDGE_HORIZONTAL  2
+
+typedef struct SNAPEDGES
+{
+    INT32   Width;
+
+    INT32   Height;
+
+    // Row Y's edges are Columns[RowStart[Y]] up to Columns[RowStart[Y + 1]], left to right. An edge at column X
+    // is between X - 1 and X, so it's where a selection's left side starts or its right side stops.
+    UINT32* RowStart;
+
+    UINT16* Columns;
+
+    // Column X's edges are Rows[ColumnStart[X]] up to Rows[ColumnStart[X + 1]], top to bottom.
+    UINT32* ColumnStart;
+
+    UINT16* Rows;
+
+} SNAPEDGES;
+
+
+// Sets each byte of Edges from First up to Last to the SNAPEDGE_ flags of the pixel in the row whose brightness
+// is in Middle. Above and Below are the brightness of the rows above and below it. This is the reference that
+// GetEdgeRow is checked against, and does the columns that are left over after GetEdgeRow's vectors.
+void GetEdgeRowScalar(
+    _In_reads_(Width) const UINT8* Above,
+    _In_reads_(Width) const UINT8* Middle,
+    _In_reads_(Width) const UINT8* Below,
+    _In_ INT32 Width,
+    _In_ INT32 First,
+    _In_ INT32 Last,
+    _Out_writes_(Width) UINT8* Edges);
+
+// Sets every byte of Edges to the SNAPEDGE_ flags of its pixel, 8 at a time with SSE2 or NEON.
+void GetEdgeRow(
+    _In_reads_(Width) const UINT8* Above,
+    _In_reads_(Width) const UINT8* Middle,
+    _In_reads_(Width) const UINT8* Below,
+    _In_ INT32 Width,
+    _Out_writes_(Width) UINT8* Edges);
+
+// Sets each byte of Row to the brightness of the pixel in row Y of the Width x Height image in Pixels, from 0 to
+// 255. Rows above and below the image are its top and bottom rows repeated, so that the border isn't an edge.
+void GetBrightnessRow(_In_reads_(Width * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Y, _Out_writes_(Width) UINT8* Row);
+
+// Makes the lists of edges in Edges from the whole of Mask, leaving out the ones shorter than SNAP_MIN_LENGTH.
+// Mask is scribbled on. Gives up and returns FALSE if Cancelled is set while it's working, or if memory could not be
+// allocated, in which case Edges is empty. Width can't be more than 65535 and nor can Height.
+BOOL BuildSnapEdges(
+    _Inout_updates_(Width * Height) UINT8* Mask,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_opt_ volatile LONG* Cancelled,
+    _Out_ SNAPEDGES* Edges);
+
+void FreeSnapEdges(_Inout_ SNAPEDGES* Edges);
+
+// Looks in the rows within Distance of Y for the vertical edge nearest to X, and no further than Distance from it.
+// Returns FALSE if there isn't one. If two are just as near, the one in the nearer row wins.
+BOOL SnapToVerticalEdge(_In_ const SNAPEDGES* Edges, _In_ INT32 X, _In_ INT32 Y, _In_ INT32 Distance, _Out_ INT32* Snapped);
+
+// Looks in the columns within Distance of X for the horizontal edge nearest to Y, and no further than Distance
+// from it. Returns FALSE if there isn't one.
+BOOL SnapToHorizontalEdge(_In_ const SNAPEDGES* Edges, _In_ INT32 X, _In_ INT32 Y, _In_ INT32 Distance, _Out_ INT32* Snapped);
@@ -0,0 +1,162 @@
+// SnipExStroke.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Span generator for brush strokes.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExStroke.h"
+
+
+// C division rounds toward zero. This rounds toward negative infinity. Denominator must be positive.
+static INT64 FloorDivide(_In_ INT64 Numerator, _In_ INT64 Denominator)
+{
+    INT64 Quotient = Numerator / Denominator;
+
+    if ((Numerator % Denominator) != 0 && Numerator < 0)
+    {
+        Quotient--;
+    }
+
+    return Quotient;
+}
+
+
+void GetStrokeBounds(_In_ POINT From, _In_ POINT To, _In_ INT32 BrushWidth, _In_ INT32 BrushHeight, _Out_ RECT* Bounds)
+{
+    Bounds->left   = min(From.x, To.x);
+
+    Bounds->top    = min(From.y, To.y);
+
+    Bounds->right  = max(From.x, To.x) + BrushWidth;
+
+    Bounds->bottom = max(From.y, To.y) + BrushHeight;
+}
+
+
+BOOL GetStrokeSpan(_In_ POINT From, _In_ POINT To, _In_ INT32 BrushWidth, _In_ INT32 BrushHeight, _In_ INT32 Y, _Out_ SPAN* Span)
+{
+    // The stroke looks the same drawn in either direction, so always go downward.
+    if (To.y < From.y)
+    {
+        POINT Temp = From;
+
+        From = To;
+
+        To = Temp;
+    }
+
+    INT64 DeltaX = (INT64)To.x - From.x;
+
+    INT64 DeltaY = (INT64)To.y - From.y;
+
+    Span->Y = Y;
+
+    if (DeltaY == 0)
+    {
+        if (Y < From.y || Y >= From.y + BrushHeight)
+        {
+            return FALSE;
+        }
+
+        Span->Left  = min(From.x, To.x);
+
+        Span->Right = max(From.x, To.x) + BrushWidth;
+
+        return TRUE;
+    }
+
+    // With the brush at From + t * (To - From), rounded to the nearest pixel, row Y is covered while the
+    // top of the brush is at least Y - BrushHeight + 0.5 and less than Y + 0.5. Work in units of
+    // t * DeltaY * 2 so that everything stays an integer, halves included.
+    INT64 Start = max(2 * ((INT64)Y - BrushHeight - From.y) + 1, 0);
+
+    INT64 End   = min(2 * ((INT64)Y - From.y) + 1, 2 * DeltaY + 1);
+
+    if (Start >= End)
+    {
+        return FALSE;
+    }
+
+    End = min(End, 2 * DeltaY);
+
+    // The x position of the brush at Start and End, times DeltaY * 2, plus a half for rounding.
+    INT64 StartX = 2 * (INT64)From.x * DeltaY + DeltaX * Start + DeltaY;
+
+    INT64 EndX   = 2 * (INT64)From.x * DeltaY + DeltaX * End + DeltaY;
+
+    Span->Left  = (INT32)FloorDivide(min(StartX, EndX), 2 * DeltaY);
+
+    Span->Right = (INT32)FloorDivide(max(StartX, EndX), 2 * DeltaY) + BrushWidth;
+
+    return TRUE;
+}
+
+
+void StampStroke(
+    _In_ POINT From,
+    _In_ POINT To,
+    _In_ INT32 BrushWidth,
+    _In_ INT32 BrushHeight,
+    _In_ INT32 ClipWidth,
+    _In_ INT32 ClipHeight,
+    _In_ STAMPFUNCTION Stamp,
+    _In_opt_ void* Context)
+{
+    RECT Bounds = { 0 };
+
+    GetStrokeBounds(From, To, BrushWidth, BrushHeight, &Bounds);
+
+    INT32 FirstY = max(Bounds.top, 0);
+
+    INT32 LastY  = min(Bounds.bottom, ClipHeight);
+
+    SPAN Batch[STROKE_BATCH_SIZE];
+
+    UINT32 Count = 0;
+
+    for (INT32 Y = FirstY; Y < LastY; Y++)
+    {
+        SPAN Span = { 0 };
+
+        if (GetStrokeSpan(From, To, BrushWidth, BrushHeight, Y, &Span) == FALSE)
+        {
+            continue;
+        }
+
+        Span.Left  = max(Span.Left, 0);
+
+        Span.Right = min(Span.Right, ClipWidth);
+
+        if (Span.Left >= Span.Right)
+        {
+            continue;
+        }
+
+        Batch[Count++] = Span;
+
+        if (Count == _countof(Batch))
+        {
+            Stamp(Batch, Count, Context);
+
+            Count = 0;
+        }
+    }
+
+    if (Count > 0)
+    {
+        Stamp(Batch, Count, Context);
+    }
+}
@@ -0,0 +1,45 @@
+// SnipExStroke.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Turns the movement of a rectangular brush from one mouse sample to the next into rows of pixels
+// (spans), so that a fast drag draws a solid band instead of a trail of separate blocks.
+
+#pragma once
+
+// How many spans StampStroke hands to its stamp function at once.
+#define STROKE_BATCH_SIZE 64
+
+// One row of pixels. Right is exclusive, so the span covers Left through Right - 1.
+typedef struct SPAN
+{
+    INT32 Y;
+
+    INT32 Left;
+
+    INT32 Right;
+
+} SPAN;
+
+// Called by StampStroke with a batch of spans that are already clipped to the bitmap.
+typedef void (*STAMPFUNCTION)(_In_reads_(Count) const SPAN* Spans, _In_ UINT32 Count, _In_opt_ void* Context);
+
+
+// Gets the rows touched by a BrushWidth x BrushHeight brush whose top-left corner slides from From to To.
+// Bounds->bottom and Bounds->right are exclusive.
+void GetStrokeBounds(_In_ POINT From, _In_ POINT To, _In_ INT32 BrushWidth, _In_ INT32 BrushHeight, _Out_ RECT* Bounds);
+
+// Gets the span that the stroke covers on row Y. Returns FALSE if the stroke does not touch that row.
+// The brush is treated as sliding smoothly between the two points, so every row of the band is solid
+// no matter how far apart the points are.
+BOOL GetStrokeSpan(_In_ POINT From, _In_ POINT To, _In_ INT32 BrushWidth, _In_ INT32 BrushHeight, _In_ INT32 Y, _Out_ SPAN* Span);
+
+// Works out every span of the stroke, clips them to a ClipWidth x ClipHeight bitmap, and passes them to
+// Stamp in batches of up to STROKE_BATCH_SIZE, top to bottom. Each pixel appears in exactly one span.
+void StampStroke(
+    _In_ POINT From,
+    _In_ POINT To,
+    _In_ INT32 BrushWidth,
+    _In_ INT32 BrushHeight,
+    _In_ INT32 ClipWidth,
+    _In_ INT32 ClipHeight,
+    _In_ STAMPFUNCTION Stamp,
+    _In_opt_ void* Context);
@@ -0,0 +1,315 @@
+// SnipExTextLines.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Text line detection for the hilighter. Counts the ink in every row of the snip (the horizontal
+// projection profile) and splits the snip wherever the ink stops.
+
+#ifndef UNICODE
+#define UNICODE
+#endif
+#ifndef _UNICODE
+#define _UNICODE
+#endif
+
+#pragma warning(push, 0)
+#include <windows.h>
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#pragma warning(pop)
+
+#pragma warning(disable: 4820)
+#pragma warning(disable: 4710)
+#pragma warning(disable: 5045)
+
+#include "SnipExTextLines.h"
+
+
+UINT32 GetBackgroundColor(_In_reads_(Stride * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Stride)
+{
+    // 4 bits per channel is plenty to tell the background apart from everything else.
+    UINT32 Histogram[4096] = { 0 };
+
+    SIZE_T PixelCount = (SIZE_T)Width * Height;
+
+    // Look at no more than about a million pixels, even for huge snips. An odd step keeps
+    // the samples from lining up with the columns.
+    SIZE_T Step = (PixelCount / 1000000) | 1;
+
+    UINT32 Pixel = 0;
+
+    UINT32 Bin = 0;
+
+    UINT32 BestBin = 0;
+
+    for (SIZE_T Index = 0; Index < PixelCount; Index += Step)
+    {
+        Pixel = Pixels[(Index / (SIZE_T)Width) * (SIZE_T)Stride + Index % (SIZE_T)Width];
+
+        Bin = ((Pixel >> 12) & 0xF00) | ((Pixel >> 8) & 0xF0) | ((Pixel >> 4) & 0xF);
+
+        if (++Histogram[Bin] > Histogram[BestBin])
+        {
+            BestBin = Bin;
+        }
+    }
+
+    for (SIZE_T Index = 0; Index < PixelCount; Index += Step)
+    {
+        Pixel = Pixels[(Index / (SIZE_T)Width) * (SIZE_T)Stride + Index % (SIZE_T)Width];
+
+        Bin = ((Pixel >> 12) & 0xF00) | ((Pixel >> 8) & 0xF0) | ((Pixel >> 4) & 0xF);
+
+        if (Bin == BestBin)
+        {
+            return Pixel;
+        }
+    }
+
+    return 0xFFFFFFFF;
+}
+
+
+static __forceinline BOOL IsInk(_In_ UINT32 Pixel, _In_ UINT32 Background)
+{
+    for (UINT32 Shift = 0; Shift < 24; Shift += 8)
+    {
+        INT32 Difference = (INT32)((Pixel >> Shift) & 0xFF) - (INT32)((Background >> Shift) & 0xFF);
+
+        if (Difference > TEXT_INK_THRESHOLD || Difference < -TEXT_INK_THRESHOLD)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+static UINT32 CountRowInk(_In_reads_(Width) const UINT32* Row, _In_ INT32 Width, _In_ UINT32 Background)
+{
+    UINT32 Count = 0;
+
+    INT32 Index = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    __m128i BackgroundVector = _mm_set1_epi32((int)Background);
+
+    // The alpha byte gets a threshold of 255 so that it can never count as ink.
+    __m128i Threshold = _mm_set1_epi32((int)(0xFF000000 | (TEXT_INK_THRESHOLD << 16) | (TEXT_INK_THRESHOLD << 8) | TEXT_INK_THRESHOLD));
+
+    __m128i Zero = _mm_setzero_si128();
+
+    __m128i Counts = _mm_setzero_si128();
+
+    for (; Index + 4 <= Width; Index += 4)
+    {
+        __m128i Pixel = _mm_loadu_si128((const __m128i*)&Row[Index]);
+
+        __m128i Difference = _mm_or_si128(_mm_subs_epu8(Pixel, BackgroundVector), _mm_subs_epu8(BackgroundVector, Pixel));
+
+        // Lanes are all ones for pixels that are not ink. Subtracting -1 counts one non-ink pixel.
+        Counts = _mm_sub_epi32(Counts, _mm_cmpeq_epi32(_mm_subs_epu8(Difference, Threshold), Zero));
+    }
+
+    Counts = _mm_add_epi32(Counts, _mm_shuffle_epi32(Counts, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    Counts = _mm_add_epi32(Counts, _mm_shuffle_epi32(Counts, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    Count = (UINT32)Index - (UINT32)_mm_cvtsi128_si32(Counts);
+#elif defined(_M_ARM64)
+    uint8x16_t BackgroundVector = vreinterpretq_u8_u32(vdupq_n_u32(Background));
+
+    uint8x16_t Threshold = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000 | (TEXT_INK_THRESHOLD << 16) | (TEXT_INK_THRESHOLD << 8) | TEXT_INK_THRESHOLD));
+
+    uint32x4_t Counts = vdupq_n_u32(0);
+
+    for (; Index + 4 <= Width; Index += 4)
+    {
+        uint8x16_t Pixel = vreinterpretq_u8_u32(vld1q_u32(&Row[Index]));
+
+        uint8x16_t Over = vcgtq_u8(vabdq_u8(Pixel, BackgroundVector), Threshold);
+
+        // Lanes are all ones for ink pixels. Subtracting -1 counts one ink pixel.
+        Counts = vsubq_u32(Counts, vtstq_u32(vreinterpretq_u32_u8(Over), vreinterpretq_u32_u8(Over)));
+    }
+
+    Count = vaddvq_u32(Counts);
+#endif
+
+    for (; Index < Width; Index++)
+    {
+        Count += (UINT32)IsInk(Row[Index], Background);
+    }
+
+    return Count;
+}
+
+
+void GetRowInkProfile(
+    _In_reads_(Stride * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ INT32 Stride,
+    _In_ UINT32 Background,
+    _Out_writes_(Height) UINT32* Profile)
+{
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        Profile[Y] = CountRowInk(&Pixels[(SIZE_T)Y * Stride], Width, Background);
+    }
+}
+
+
+static void AddTextLine(_Inout_ TEXTLINES* TextLines, _In_ INT32 Top, _In_ INT32 Bottom)
+{
+    if (Bottom - Top >= TEXT_LINE_MIN_HEIGHT && Bottom - Top <= TEXT_LINE_MAX_HEIGHT)
+    {
+        TextLines->Lines[TextLines->Count].Top = Top;
+
+        TextLines->Lines[TextLines->Count].Height = Bottom - Top;
+
+        TextLines->Count++;
+    }
+}
+
+
+BOOL FindTextLines(_In_reads_(Stride * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Stride, _Out_ TEXTLINES* TextLines)
+{
+    TextLines->Count = 0;
+
+    // Lines are separated by at least one blank row, so there can't be more than this many.
+    TextLines->Lines = HeapAlloc(GetProcessHeap(), 0, ((SIZE_T)Height / 2 + 1) * sizeof(TEXTLINE));
+
+    UINT32* Profile = HeapAlloc(GetProcessHeap(), 0, ((SIZE_T)Height + 1) * sizeof(UINT32));
+
+    if (TextLines->Lines == NULL || Profile == NULL)
+    {
+        FreeTextLines(TextLines);
+
+        if (Profile != NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, Profile);
+        }
+
+        return FALSE;
+    }
+
+    GetRowInkProfile(Pixels, Width, Height, Stride, GetBackgroundColor(Pixels, Width, Height, Stride), Profile);
+
+    // Things that run down the whole snip, like window borders and scroll bars, put the same
+    // amount of ink in every row. Only count ink above that.
+    UINT32 Floor = MAXUINT32;
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        Floor = min(Floor, Profile[Y]);
+    }
+
+    UINT32 Threshold = Floor + 2;
+
+    INT32 RunTop = -1;
+
+    INT32 RunBottom = -1;
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        if (Profile[Y] < Threshold)
+        {
+            continue;
+        }
+
+        // A single blank row inside a run is usually the gap between the dot and the stem of an i, not the end of the line.
+        if (RunTop >= 0 && Y <= RunBottom + 1)
+        {
+            RunBottom = Y + 1;
+
+            continue;
+        }
+
+        if (RunTop >= 0)
+        {
+            AddTextLine(TextLines, RunTop, RunBottom);
+        }
+
+        RunTop = Y;
+
+        RunBottom = Y + 1;
+    }
+
+    if (RunTop >= 0)
+    {
+        AddTextLine(TextLines, RunTop, RunBottom);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Profile);
+
+    return TRUE;
+}
+
+
+void FreeTextLines(_Inout_ TEXTLINES* TextLines)
+{
+    if (TextLines->Lines != NULL)
+    {
+        HeapFree(GetProcessHeap(), 0, TextLines->Lines);
+
+        TextLines->Lines = NULL;
+    }
+
+    TextLines->Count = 0;
+}
+
+
+const TEXTLINE* FindNearestTextLine(_In_ const TEXTLINES* TextLines, _In_ INT32 Y, _In_ INT32 MaxDistance)
+{
+    // Find the first line that ends below Y.
+    UINT32 Low = 0;
+
+    UINT32 High = TextLines->Count;
+
+    while (Low < High)
+    {
+        UINT32 Middle = Low + (High - Low) / 2;
+
+        if (TextLines->Lines[Middle].Top + TextLines->Lines[Middle].Height <= Y)
+        {
+            Low = Middle + 1;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+
+    const TEXTLINE* Nearest = NULL;
+
+    INT32 NearestDistance = MaxDistance + 1;
+
+    // That line either contains Y or is the nearest line below it. The line before it is the nearest line above.
+    if (Low < TextLines->Count)
+    {
+        INT32 Distance = max(TextLines->Lines[Low].Top - Y, 0);
+
+        if (Distance < NearestDistance)
+        {
+            Nearest = &TextLines->Lines[Low];
+
+            NearestDistance = Distance;
+        }
+    }
+
+    if (Low > 0)
+    {
+        INT32 Distance = Y - (TextLines->Lines[Low - 1].Top + TextLines->Lines[Low - 1].Height - 1);
+
+        if (Distance < NearestDistance)
+        {
+            Nearest = &TextLines->Lines[Low - 1];
+        }
+    }
+
+    return Nearest;
+}
+
@@ -0,0 +1,60 @@
+// SnipExTextLines.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Finds the lines of text in a snip, so that the hilighter can line itself up with the text the user
+// is hilighting instead of with wherever the mouse happened to be when the stroke started.
+
+#pragma once
+
+// A pixel counts as ink if any of its color channels differs from the background by more than this.
+#define TEXT_INK_THRESHOLD       48
+
+// Runs of inked rows shorter or taller than this are not treated as lines of text.
+#define TEXT_LINE_MIN_HEIGHT     4
+
+#define TEXT_LINE_MAX_HEIGHT     96
+
+// The hilighter only snaps to a line of text if the stroke starts within this many pixels of it.
+#define TEXT_LINE_SNAP_DISTANCE  12
+
+typedef struct TEXTLINE
+{
+    INT32 Top;
+
+    INT32 Height;
+
+} TEXTLINE;
+
+typedef struct TEXTLINES
+{
+    UINT32    Count;
+
+    // Sorted from top to bottom. Lines never overlap.
+    TEXTLINE* Lines;
+
+} TEXTLINES;
+
+
+// The functions below work on 32bpp images whose rows are Stride pixels apart, so that they can look at part of a
+// bigger image without copying it.
+
+// Guesses the background color of an image by finding its most common color.
+UINT32 GetBackgroundColor(_In_reads_(Stride * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Stride);
+
+// Counts the ink pixels in each row of an image. Profile receives one count per row.
+void GetRowInkProfile(
+    _In_reads_(Stride * Height) const UINT32* Pixels,
+    _In_ INT32 Width,
+    _In_ INT32 Height,
+    _In_ INT32 Stride,
+    _In_ UINT32 Background,
+    _Out_writes_(Height) UINT32* Profile);
+
+// Splits a top-down image into lines of text. Free the result with FreeTextLines.
+// Returns FALSE if memory could not be allocated.
+BOOL FindTextLines(_In_reads_(Stride * Height) const UINT32* Pixels, _In_ INT32 Width, _In_ INT32 Height, _In_ INT32 Stride, _Out_ TEXTLINES* TextLines);
+
+void FreeTextLines(_Inout_ TEXTLINES* TextLines);
+
+// Returns the line of text that contains row Y, or else the nearest line no more than MaxDistance rows away.
+// Returns NULL if there is no such line. This is a binary search.
+const TEXTLINE* FindNearestTextLine(_In_ const TEXTLINES* TextLines, _In_ INT32 Y, _In_ INT32 MaxDistance);
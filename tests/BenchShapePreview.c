@@ -0,0 +1,189 @@
+// BenchShapePreview.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Counts the bytes copied per mouse move while a box or an arrow is dragged out, the way SnipEx used to do it and
+// the way it does it now, and times both. It used to copy the whole snip to draw the shape on, then copy that to
+// the window. Now the shape is only drawn over the window, and each move repaints just where the shape was and
+// where it is. It also checks that what's on the window at the end is the same both ways, which is what shows
+// the repainted area misses nothing.
+//
+//     BenchShapePreview [moves]
+
+#include <windows.h>
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+#include "Test.h"
+
+// The same as SHAPE_PEN_WIDTH in SnipEx.h.
+#define PREVIEW_PEN_WIDTH 2
+
+
+// Where the shape is dragged to on Move, and what it looks like.
+static void GetShape(ANNOTATIONTYPE Type, INT32 Width, INT32 Height, UINT32 Move, ANNOTATION* Shape)
+{
+    ZeroMemory(Shape, sizeof(ANNOTATION));
+
+    Shape->Type = Type;
+
+    Shape->Color = 0xFFFF0000;
+
+    Shape->PenWidth = PREVIEW_PEN_WIDTH;
+
+    Shape->BlendMode = BLENDMODE_SRGB;
+
+    Shape->Start.x = Width / 4;
+
+    Shape->Start.y = Height / 4;
+
+    // A few pixels a move, the way a mouse reports a drag, wandering back and forth across the snip.
+    Shape->End.x = Width / 4 + (INT32)((Move * 7) % (UINT32)(Width / 2)) - Width / 8;
+
+    Shape->End.y = Height / 4 + (INT32)((Move * 3) % (UINT32)(Height / 2)) - Height / 8;
+
+    RECT Snip = { 0, 0, Width, Height };
+
+    GetBoxOrArrowBounds(Shape, &Shape->Bounds);
+
+    IntersectRect(&Shape->Bounds, &Shape->Bounds, &Snip);
+}
+
+
+static void DrawShapeOver(UINT32* Pixels, INT32 Width, const RECT* Clip, const ANNOTATION* Shape)
+{
+    RASTERTARGET Target = { &Pixels[(SIZE_T)Clip->top * Width + Clip->left], Width, *Clip, NULL };
+
+    DrawBoxOrArrow(&Target, Shape);
+}
+
+
+static void Bench(ANNOTATIONTYPE Type, INT32 Width, INT32 Height, UINT32 Moves)
+{
+    SIZE_T Size = (SIZE_T)Width * Height * sizeof(UINT32);
+
+    UINT32* Snip = malloc(Size);
+
+    UINT32* Scratch = malloc(Size);
+
+    UINT32* OldWindow = malloc(Size);
+
+    UINT32* NewWindow = malloc(Size);
+
+    RECT Whole = { 0, 0, Width, Height };
+
+    ANNOTATION Shape;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Snip[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    // Before: every move copied the snip to draw the shape on, then copied all of that to the window.
+    double OldBytes = 0;
+
+    double Start = TestSeconds();
+
+    for (UINT32 Move = 0; Move < Moves; Move++)
+    {
+        GetShape(Type, Width, Height, Move, &Shape);
+
+        memcpy(Scratch, Snip, Size);
+
+        DrawShapeOver(Scratch, Width, &Whole, &Shape);
+
+        memcpy(OldWindow, Scratch, Size);
+
+        OldBytes += 2.0 * (double)Size;
+    }
+
+    double OldSeconds = TestSeconds() - Start;
+
+    // After: the window starts out as the snip, and each move repaints where the shape was and where it is now,
+    // from the snip, then draws the shape over that.
+    double NewBytes = 0;
+
+    RECT Previous = { 0 };
+
+    memcpy(NewWindow, Snip, Size);
+
+    Start = TestSeconds();
+
+    for (UINT32 Move = 0; Move < Moves; Move++)
+    {
+        RECT Damage;
+
+        GetShape(Type, Width, Height, Move, &Shape);
+
+        UnionRect(&Damage, &Previous, &Shape.Bounds);
+
+        Previous = Shape.Bounds;
+
+        for (INT32 Y = Damage.top; Y < Damage.bottom; Y++)
+        {
+            memcpy(&NewWindow[(SIZE_T)Y * Width + Damage.left], &Snip[(SIZE_T)Y * Width + Damage.left], (SIZE_T)(Damage.right - Damage.left) * sizeof(UINT32));
+        }
+
+        if (IsRectEmpty(&Damage) == FALSE)
+        {
+            DrawShapeOver(NewWindow, Width, &Damage, &Shape);
+        }
+
+        NewBytes += (double)(Damage.right - Damage.left) * (Damage.bottom - Damage.top) * sizeof(UINT32);
+    }
+
+    double NewSeconds = TestSeconds() - Start;
+
+    CHECK(memcmp(OldWindow, NewWindow, Size) == 0);
+
+    printf("%-5s %5d x %-5d before %9.1f KB/move %8.3f ms/move   after %9.1f KB/move %8.3f ms/move   %6.0fx fewer bytes\n",
+        Type == ANNOTATION_BOX ? "box" : "arrow", Width, Height,
+        OldBytes / Moves / 1024.0, OldSeconds * 1000.0 / Moves,
+        NewBytes / Moves / 1024.0, NewSeconds * 1000.0 / Moves,
+        OldBytes / max(NewBytes, 1.0));
+
+    free(Snip);
+
+    free(Scratch);
+
+    free(OldWindow);
+
+    free(NewWindow);
+}
+
+
+int main(int ArgumentCount, char** Arguments)
+{
+    static const INT32 Sizes[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 2160 } };
+
+    UINT32 Moves = (ArgumentCount > 1) ? (UINT32)atoi(Arguments[1]) : 30;
+
+    InitializeBlendTables();
+
+    for (UINT32 Size = 0; Size < _countof(Sizes); Size++)
+    {
+        Bench(ANNOTATION_BOX, Sizes[Size][0], Sizes[Size][1], Moves);
+
+        Bench(ANNOTATION_ARROW, Sizes[Size][0], Sizes[Size][1], Moves);
+    }
+
+    return TestResult();
+}
@@ -0,0 +1,271 @@
+// BenchUndoTiers.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Makes a thousand edits to a snip the size of two 4K monitors side by side, lets the undo journal's worker pack
+// and move out the older ones, and reports how much memory the process holds and how many bytes of tiles each edit
+// cost the journal, then how long undo takes for steps whose tiles are raw, packed, in the scratch file, or gone and
+// redrawn, and how long redoing them all again takes. Now and then it checks that what undo and redo left is what
+// redrawing everything gives.
+//
+//     BenchUndoTiers [width height edits budget-in-MB]
+
+#include <windows.h>
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+#include "Test.h"
+
+// Raw, packed and file are the journal's tiers; redrawn is a step that has no tiles left.
+#define TIER_REDRAWN 3
+
+
+// How much of the process is in memory, in megabytes.
+static long GetResidentMegabytes(void)
+{
+    long Pages = 0;
+
+    long Resident = 0;
+
+    FILE* File = fopen("/proc/self/statm", "r");
+
+    if (File != NULL)
+    {
+        if (fscanf(File, "%ld %ld", &Pages, &Resident) != 2)
+        {
+            Resident = 0;
+        }
+
+        fclose(File);
+    }
+
+    return Resident * (sysconf(_SC_PAGESIZE) / 1024) / 1024;
+}
+
+
+// A hilighter, redact or eraser stroke of a dozen points wandering across the snip.
+static void AddEdit(DOCUMENT* Document)
+{
+    static const ANNOTATIONTYPE Types[] = { ANNOTATION_HILIGHT, ANNOTATION_REDACT, ANNOTATION_ERASE };
+
+    ANNOTATIONTYPE Type = Types[TestRandom() % _countof(Types)];
+
+    POINT Point = { TestRandomRange(0, Document->Width - 1), TestRandomRange(0, Document->Height - 1) };
+
+    RECT Damage;
+
+    BeginDocumentStep(Document);
+
+    ANNOTATION* Stroke = BeginStroke(Document, Type, Point, BRUSHTIP_SQUARE, TestRandomRange(8, 37), TestRandomRange(8, 37), (Type == ANNOTATION_HILIGHT) ? HILIGHT_YELLOW : 0xFF000000, BLENDMODE_SRGB);
+
+    CHECK(Stroke != NULL);
+
+    for (UINT32 Sample = 0; Stroke != NULL && Sample < 12; Sample++)
+    {
+        POINT Next = { Stroke->Points[Stroke->PointCount - 1].x + TestRandomRange(-100, 100), Stroke->Points[Stroke->PointCount - 1].y + TestRandomRange(-20, 20) };
+
+        AddStrokePoint(Document, Stroke, Next, NULL, &Damage);
+    }
+
+    if (Stroke != NULL)
+    {
+        EndStroke(Document, Stroke, NULL);
+    }
+}
+
+
+// Which tier the tiles of the step that undo would take out are in.
+static UINT32 GetUndoTier(DOCUMENT* Document)
+{
+    JOURNAL* Journal = &Document->Journal;
+
+    UINT32 Tier = TIER_REDRAWN;
+
+    EnterCriticalSection(&Journal->Lock);
+
+    if (Journal->Count > 0 && Document->Count > 0)
+    {
+        const JOURNALSTEP* Step = &Journal->Steps[Journal->Count - 1];
+
+        if (Step->Step == Document->Annotations[Document->Count - 1]->Step && Step->Incomplete == FALSE && Step->Count > 0)
+        {
+            Tier = (Step->Spilled == Step->Count) ? JOURNALTIER_FILE : (Step->Packed == Step->Count) ? JOURNALTIER_PACKED : JOURNALTIER_RAW;
+        }
+    }
+
+    LeaveCriticalSection(&Journal->Lock);
+
+    return Tier;
+}
+
+
+// Whether redrawing the whole snip changes nothing, which it doesn't if undo left it exactly right.
+static BOOL IsRedrawnTheSame(DOCUMENT* Document)
+{
+    SIZE_T Bytes = (SIZE_T)Document->Width * Document->Height * sizeof(UINT32);
+
+    UINT32* Copy = malloc(Bytes);
+
+    RECT All = { 0, 0, Document->Width, Document->Height };
+
+    memcpy(Copy, Document->Raster, Bytes);
+
+    RedrawDocument(Document, &All);
+
+    BOOL Same = (memcmp(Copy, Document->Raster, Bytes) == 0);
+
+    free(Copy);
+
+    return Same;
+}
+
+
+int main(int ArgumentCount, char** Arguments)
+{
+    static const char* TierNames[] = { "raw", "packed", "file", "redrawn" };
+
+    INT32 Width = (ArgumentCount > 2) ? atoi(Arguments[1]) : 7680;
+
+    INT32 Height = (ArgumentCount > 2) ? atoi(Arguments[2]) : 2160;
+
+    UINT32 Edits = (ArgumentCount > 3) ? (UINT32)atoi(Arguments[3]) : 1000;
+
+    SIZE_T Budget = ((ArgumentCount > 4) ? (SIZE_T)atoll(Arguments[4]) : 256) * 1024 * 1024;
+
+    double Total[4] = { 0 };
+
+    double Slowest[4] = { 0 };
+
+    UINT32 Undone[4] = { 0 };
+
+    UINT32* Raster = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    DOCUMENT Document;
+
+    SIZE_T Bytes;
+
+    UINT64 FileBytes;
+
+    InitializeBlendTables();
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Raster[Index] = 0xFF000000 | (UINT32)((Index / Width) * 3 + (Index % Width)) * 0x010101;
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, Width, Height, Budget, NULL, NULL));
+
+    printf("%d x %d, %zu MB budget: %ld MB in memory to start with\n", Width, Height, Budget / (1024 * 1024), GetResidentMegabytes());
+
+    double Start = TestSeconds();
+
+    for (UINT32 Edit = 0; Edit < Edits; Edit++)
+    {
+        AddEdit(&Document);
+    }
+
+    printf("%u edits in %.0f ms, %ld MB in memory\n", Edits, (TestSeconds() - Start) * 1000.0, GetResidentMegabytes());
+
+    GetJournalUsage(&Document.Journal, &Bytes, &FileBytes);
+
+    printf("journal: %zu bytes of tiles per edit before the worker packs them\n", (Bytes + (SIZE_T)FileBytes) / max(Edits, 1));
+
+    // Gives the worker time to catch up, the way the user's pauses do.
+    Sleep(2000);
+
+    GetJournalUsage(&Document.Journal, &Bytes, &FileBytes);
+
+    printf("once the worker is done: %zu MB of tiles in memory, %llu MB in the scratch file, %u steps kept, %ld MB in memory\n", Bytes / (1024 * 1024), (unsigned long long)FileBytes / (1024 * 1024), Document.Journal.Count, GetResidentMegabytes());
+
+    printf("journal: %zu bytes of tiles per edit once the worker is done\n", (Bytes + (SIZE_T)FileBytes) / max(Edits, 1));
+
+    for (UINT32 Edit = 0; Edit < Edits; Edit++)
+    {
+        UINT32 Tier = GetUndoTier(&Document);
+
+        RECT Damage;
+
+        Start = TestSeconds();
+
+        CHECK(UndoDocumentStep(&Document, &Damage));
+
+        double Seconds = TestSeconds() - Start;
+
+        Total[Tier] += Seconds;
+
+        Slowest[Tier] = max(Slowest[Tier], Seconds);
+
+        Undone[Tier]++;
+
+        if (Edit % 100 == 0 && IsRedrawnTheSame(&Document) == FALSE)
+        {
+            fprintf(stderr, "after %u undos the snip isn't what redrawing it gives\n", Edit + 1);
+
+            gTestFailures++;
+        }
+    }
+
+    for (UINT32 Tier = 0; Tier < _countof(TierNames); Tier++)
+    {
+        if (Undone[Tier] > 0)
+        {
+            printf("undo %-7s %4u steps, mean %7.3f ms, slowest %7.3f ms\n", TierNames[Tier], Undone[Tier], Total[Tier] * 1000.0 / Undone[Tier], Slowest[Tier] * 1000.0);
+        }
+    }
+
+    // Redo draws each step again on top, whichever tier its tiles were in.
+    double RedoTotal = 0.0;
+
+    double RedoSlowest = 0.0;
+
+    for (UINT32 Edit = 0; Edit < Edits; Edit++)
+    {
+        RECT Damage;
+
+        Start = TestSeconds();
+
+        CHECK(RedoDocumentStep(&Document, &Damage));
+
+        double Seconds = TestSeconds() - Start;
+
+        RedoTotal += Seconds;
+
+        RedoSlowest = max(RedoSlowest, Seconds);
+
+        if (Edit % 100 == 99 && IsRedrawnTheSame(&Document) == FALSE)
+        {
+            fprintf(stderr, "after %u redos the snip isn't what redrawing it gives\n", Edit + 1);
+
+            gTestFailures++;
+        }
+    }
+
+    if (Edits > 0)
+    {
+        printf("redo         %4u steps, mean %7.3f ms, slowest %7.3f ms\n", Edits, RedoTotal * 1000.0 / Edits, RedoSlowest * 1000.0);
+    }
+
+    FreeDocument(&Document);
+
+    free(Raster);
+
+    return TestResult();
+}
@@ -0,0 +1,251 @@
+// ReplayBench.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Replays a saved frame set through the capture pipeline and times it: whole desktop captures, one snip of each
+// monitor, and snips of random regions, the same way SnipEx takes them when started with --replay.
+//
+//     ReplayBench [manifest [rounds]]
+//
+// Without a manifest, it saves a frame set of its own to the temp folder, two monitors with a PNG frame and a raw
+// one, and also checks that every capture of it came out with the right pixels. That's what ctest runs.
+
+#include <windows.h>
+
+#include "SnipExCapture.h"
+
+#include "SnipExReplay.h"
+
+#include "Test.h"
+
+#include "TestFrames.h"
+
+#define BENCH_MONITOR_WIDTH  1280
+
+#define BENCH_MONITOR_HEIGHT 720
+
+#define BENCH_FRAME_COUNT    2
+
+#define BENCH_REGION_COUNT   64
+
+// The frames the made-up frame set holds, so that captures of it can be checked.
+static UINT32* gExpected[BENCH_FRAME_COUNT];
+
+
+// Saves a frame set of two monitors side by side, the first one to the left of the primary, into Folder.
+static BOOL MakeFrameSet(const char* Folder, char* ManifestPath, size_t ManifestPathSize)
+{
+    INT32 Width = 2 * BENCH_MONITOR_WIDTH;
+
+    INT32 Height = BENCH_MONITOR_HEIGHT;
+
+    char Path[512];
+
+    char Manifest[512];
+
+    for (UINT32 Frame = 0; Frame < BENCH_FRAME_COUNT; Frame++)
+    {
+        gExpected[Frame] = malloc((size_t)Width * Height * sizeof(UINT32));
+
+        MakeTestDesktop(gExpected[Frame], Width, Height, Frame);
+    }
+
+    size_t PngSize = 0;
+
+    UINT8* Png = EncodeTestPng(gExpected[0], Width, Height, 2, TESTPNG_FIXED, &PngSize);
+
+    snprintf(Path, sizeof(Path), "%s/frame0.png", Folder);
+
+    BOOL Saved = WriteTestFile(Path, Png, PngSize);
+
+    free(Png);
+
+    snprintf(Path, sizeof(Path), "%s/frame1.raw", Folder);
+
+    Saved = Saved && WriteTestFile(Path, gExpected[1], (size_t)Width * Height * sizeof(UINT32));
+
+    int Length = snprintf(Manifest, sizeof(Manifest),
+        "# Made by ReplayBench.\n"
+        "desktop %d 0 %d %d\n"
+        "monitor %d 0 %d %d\n"
+        "monitor 0 0 %d %d\n"
+        "frame frame0.png\n"
+        "frame frame1.raw\n",
+        -BENCH_MONITOR_WIDTH, Width, Height,
+        -BENCH_MONITOR_WIDTH, BENCH_MONITOR_WIDTH, Height,
+        BENCH_MONITOR_WIDTH, Height);
+
+    snprintf(ManifestPath, ManifestPathSize, "%s/manifest.txt", Folder);
+
+    return Saved && WriteTestFile(ManifestPath, Manifest, (size_t)Length);
+}
+
+
+// Checks a snip of Plan against the frame it should have come from, if the frame is known.
+static void CheckRegion(const CAPTUREPLAN* Plan, const UINT32* Pixels, UINT32 Frame, INT32 DesktopWidth)
+{
+    if (gExpected[0] == NULL)
+    {
+        return;
+    }
+
+    UINT32* Expected = malloc((size_t)Plan->Width * Plan->Height * sizeof(UINT32));
+
+    CopyCaptureRegion(Plan, gExpected[Frame % BENCH_FRAME_COUNT], DesktopWidth, Expected);
+
+    CHECK(memcmp(Pixels, Expected, (size_t)Plan->Width * Plan->Height * sizeof(UINT32)) == 0);
+
+    free(Expected);
+}
+
+
+static void Report(const char* What, UINT32 Count, double Seconds, double Bytes)
+{
+    printf("%-24s %6u captures  %8.3f ms each  %8.1f MB/s\n", What, Count, 1000.0 * Seconds / Count, Bytes / Seconds / (1024.0 * 1024.0));
+}
+
+
+int main(int ArgumentCount, char** Arguments)
+{
+    char ManifestPath[512];
+
+    char Folder[256] = { 0 };
+
+    wchar_t WideManifestPath[512];
+
+    CAPTURESOURCE Source;
+
+    UINT32 Rounds = (ArgumentCount > 2) ? (UINT32)atoi(Arguments[2]) : 4;
+
+    if (ArgumentCount > 1)
+    {
+        snprintf(ManifestPath, sizeof(ManifestPath), "%s", Arguments[1]);
+    }
+    else
+    {
+        const char* Temp = getenv("TMPDIR");
+
+        snprintf(Folder, sizeof(Folder), "%s/ReplayBenchXXXXXX", (Temp != NULL && Temp[0] != '\0') ? Temp : "/tmp");
+
+        if (mkdtemp(Folder) == NULL || MakeFrameSet(Folder, ManifestPath, sizeof(ManifestPath)) == FALSE)
+        {
+            fprintf(stderr, "Could not save a frame set to %s\n", Folder);
+
+            return 1;
+        }
+    }
+
+    mbstowcs(WideManifestPath, ManifestPath, _countof(WideManifestPath));
+
+    if (OpenReplaySource(WideManifestPath, &Source) == FALSE)
+    {
+        fprintf(stderr, "Could not open %s\n", ManifestPath);
+
+        return 1;
+    }
+
+    INT32 Width = Source.Layout.Desktop.right - Source.Layout.Desktop.left;
+
+    INT32 Height = Source.Layout.Desktop.bottom - Source.Layout.Desktop.top;
+
+    UINT32* Desktop = malloc((size_t)Width * Height * sizeof(UINT32));
+
+    UINT32* Snip = malloc(((size_t)Width + 16) * ((size_t)Height + 16) * sizeof(UINT32));
+
+    UINT32 Frame = 0;
+
+    printf("%s: %d x %d desktop, %u monitors, %u rounds\n", ManifestPath, Width, Height, Source.Layout.MonitorCount, Rounds);
+
+    // Each capture plays the next frame, so Frame keeps count to know which one each capture should match.
+    double Start = TestSeconds();
+
+    for (UINT32 Round = 0; Round < Rounds; Round++, Frame++)
+    {
+        CHECK(CaptureDesktop(&Source, Desktop));
+
+        if (gExpected[0] != NULL)
+        {
+            CHECK(memcmp(Desktop, gExpected[Frame % BENCH_FRAME_COUNT], (size_t)Width * Height * sizeof(UINT32)) == 0);
+        }
+    }
+
+    Report("whole desktop", Rounds, TestSeconds() - Start, (double)Rounds * Width * Height * sizeof(UINT32));
+
+    double Bytes = 0;
+
+    Start = TestSeconds();
+
+    for (UINT32 Round = 0; Round < Rounds; Round++)
+    {
+        for (UINT32 Monitor = 0; Monitor < Source.Layout.MonitorCount; Monitor++, Frame++)
+        {
+            RECT Selection = Source.Layout.Monitors[Monitor];
+
+            CAPTUREPLAN Plan;
+
+            OffsetRect(&Selection, -Source.Layout.Desktop.left, -Source.Layout.Desktop.top);
+
+            CHECK(PlanRegionCapture(&Selection, 0, Width, Height, &Plan));
+
+            CHECK(CaptureRegion(&Source, &Plan, Snip));
+
+            CheckRegion(&Plan, Snip, Frame, Width);
+
+            Bytes += (double)Plan.Width * Plan.Height * sizeof(UINT32);
+        }
+    }
+
+    Report("each monitor", Rounds * Source.Layout.MonitorCount, TestSeconds() - Start, Bytes);
+
+    Bytes = 0;
+
+    Start = TestSeconds();
+
+    for (UINT32 Round = 0; Round < Rounds * BENCH_REGION_COUNT; Round++)
+    {
+        // Some of these hang off the desktop, which the plan clips, and some are dragged up or to the left.
+        RECT Selection = { TestRandomRange(-64, Width), TestRandomRange(-64, Height), TestRandomRange(-64, Width + 64), TestRandomRange(-64, Height + 64) };
+
+        CAPTUREPLAN Plan;
+
+        if (PlanRegionCapture(&Selection, 8, Width, Height, &Plan) == FALSE)
+        {
+            continue;
+        }
+
+        CHECK(CaptureRegion(&Source, &Plan, Snip));
+
+        CheckRegion(&Plan, Snip, Frame++, Width);
+
+        Bytes += (double)Plan.Width * Plan.Height * sizeof(UINT32);
+    }
+
+    Report("random regions", Rounds * BENCH_REGION_COUNT, TestSeconds() - Start, Bytes);
+
+    CloseCaptureSource(&Source);
+
+    free(Desktop);
+
+    free(Snip);
+
+    if (Folder[0] != '\0')
+    {
+        char Path[512];
+
+        const char* Names[] = { "frame0.png", "frame1.raw", "manifest.txt" };
+
+        for (UINT32 Index = 0; Index < _countof(Names); Index++)
+        {
+            snprintf(Path, sizeof(Path), "%s/%s", Folder, Names[Index]);
+
+            remove(Path);
+        }
+
+        rmdir(Folder);
+    }
+
+    for (UINT32 Index = 0; Index < BENCH_FRAME_COUNT; Index++)
+    {
+        free(gExpected[Index]);
+    }
+
+    return TestResult();
+}
@@ -0,0 +1,77 @@
+// Test.h
+// Author: Joseph Ryan Ries, 2017-2020
+// What every test program shares: checks that count failures instead of stopping at the first one, a clock for
+// the benchmarks, and random numbers that come out the same every run.
+
+#pragma once
+
+#include <stdio.h>
+
+#include <time.h>
+
+static int gTestFailures;
+
+// Reports Condition if it's false, and carries on.
+#define CHECK(Condition) \
+    do \
+    { \
+        if (!(Condition)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Condition); \
+            gTestFailures++; \
+        } \
+    } while (0)
+
+// Like CHECK, but also says what the two values were.
+#define CHECK_EQUAL(Expected, Actual) \
+    do \
+    { \
+        long long ExpectedValue = (long long)(Expected); \
+        long long ActualValue = (long long)(Actual); \
+        if (ExpectedValue != ActualValue) \
+        { \
+            fprintf(stderr, "%s:%d: expected %s == %s, which is %lld, but it was %lld\n", __FILE__, __LINE__, #Expected, #Actual, ExpectedValue, ActualValue); \
+            gTestFailures++; \
+        } \
+    } while (0)
+
+// What main returns: 0 if every check passed.
+static inline int TestResult(void)
+{
+    if (gTestFailures > 0)
+    {
+        fprintf(stderr, "%d check%s failed\n", gTestFailures, gTestFailures == 1 ? "" : "s");
+    }
+
+    return gTestFailures > 0 ? 1 : 0;
+}
+
+// Seconds since some time in the past, for timing things.
+static inline double TestSeconds(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+
+    return (double)Now.tv_sec + (double)Now.tv_nsec / 1e9;
+}
+
+static unsigned long long gTestRandom = 0x9E3779B97F4A7C15ull;
+
+// The next of a sequence of random numbers that's the same every run, so that a failure can be repeated.
+static inline unsigned int TestRandom(void)
+{
+    gTestRandom ^= gTestRandom << 13;
+
+    gTestRandom ^= gTestRandom >> 7;
+
+    gTestRandom ^= gTestRandom << 17;
+
+    return (unsigned int)(gTestRandom >> 16);
+}
+
+// A random number from Low up to and including High.
+static inline int TestRandomRange(int Low, int High)
+{
+    return Low + (int)(TestRandom() % (unsigned int)(High - Low + 1));
+}
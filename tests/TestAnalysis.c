@@ -0,0 +1,509 @@
+// TestAnalysis.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that the background analysis gives exactly what working each result out on the calling thread gives, on
+// screenshots of all sizes, with anywhere from one worker to eight, and whichever result is waited for first: the
+// dimmed copy, the snap edges, the gradient, the row hashes, the histogram and the pyramid. Checks
+// that cancelling it, straight away or part way, stops it promptly and leaves what was ready still ready. Then times
+// it on a frame the size of three 4K monitors, against making the dimmed copy on the UI thread the way SnipEx used
+// to, before the overlay could be shown.
+
+#include <windows.h>
+
+#include "SnipExBlend.h"
+
+#include "SnipExSnap.h"
+
+#include "SnipExAnalysis.h"
+
+#include "Test.h"
+
+#include "TestFrames.h"
+
+#define DIM_COLOR 0xFFAAAAAA
+
+#define DIM_ALPHA 128
+
+
+// Pretends to have Count processors, which StartAnalysis starts one fewer workers than.
+static void SetProcessorCount(UINT32 Count)
+{
+    char Value[16];
+
+    snprintf(Value, sizeof(Value), "%u", Count);
+
+    setenv("SNIPEX_TEST_CPUS", Value, 1);
+}
+
+
+// Flat windows with noise on a noisy background, so that there are long edges and short ones.
+static void MakeScreenshot(UINT32* Pixels, INT32 Width, INT32 Height)
+{
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Pixels[Index] = 0xFF000000 | ((TestRandom() % 3) ? 0x808080 : ((TestRandom() << 8) ^ TestRandom()));
+    }
+
+    for (INT32 Window = TestRandomRange(0, 11); Window > 0; Window--)
+    {
+        INT32 Left = TestRandomRange(0, Width - 1);
+
+        INT32 Top = TestRandomRange(0, Height - 1);
+
+        INT32 Right = TestRandomRange(Left + 1, Width);
+
+        INT32 Bottom = TestRandomRange(Top + 1, Height);
+
+        UINT32 Fill = 0xFF000000 | ((TestRandom() << 8) ^ TestRandom());
+
+        for (INT32 Y = Top; Y < Bottom; Y++)
+        {
+            for (INT32 X = Left; X < Right; X++)
+            {
+                Pixels[(SIZE_T)Y * Width + X] = (TestRandom() % 50) ? Fill : (0xFF000000 | TestRandom());
+            }
+        }
+    }
+}
+
+
+// The lists of edges, made on this thread, one row at a time.
+static BOOL MakeSnapEdges(const UINT32* Pixels, INT32 Width, INT32 Height, SNAPEDGES* Edges)
+{
+    UINT8* Mask = malloc((SIZE_T)Width * Height);
+
+    UINT8* Rows = malloc((SIZE_T)Width * 3);
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        GetBrightnessRow(Pixels, Width, Height, Y - 1, Rows);
+
+        GetBrightnessRow(Pixels, Width, Height, Y, Rows + Width);
+
+        GetBrightnessRow(Pixels, Width, Height, Y + 1, Rows + 2 * (SIZE_T)Width);
+
+        GetEdgeRowScalar(Rows, Rows + Width, Rows + 2 * (SIZE_T)Width, Width, 0, Width, &Mask[(SIZE_T)Y * Width]);
+    }
+
+    BOOL Built = BuildSnapEdges(Mask, Width, Height, NULL, Edges);
+
+    free(Rows);
+
+    free(Mask);
+
+    return Built;
+}
+
+
+static BOOL IsSameSnapEdges(const SNAPEDGES* Expected, const SNAPEDGES* Actual)
+{
+    INT32 Width = Expected->Width;
+
+    INT32 Height = Expected->Height;
+
+    return Actual->Width == Width && Actual->Height == Height &&
+        Actual->RowStart != NULL && Actual->ColumnStart != NULL &&
+        memcmp(Expected->RowStart, Actual->RowStart, ((SIZE_T)Height + 1) * sizeof(UINT32)) == 0 &&
+        memcmp(Expected->ColumnStart, Actual->ColumnStart, ((SIZE_T)Width + 1) * sizeof(UINT32)) == 0 &&
+        memcmp(Expected->Columns, Actual->Columns, Expected->RowStart[Height] * sizeof(UINT16)) == 0 &&
+        memcmp(Expected->Rows, Actual->Rows, Expected->ColumnStart[Width] * sizeof(UINT16)) == 0;
+}
+
+
+static UINT8 GetBrightness(const UINT32* Pixels, INT32 Width, INT32 Height, INT32 X, INT32 Y)
+{
+    UINT32 Pixel = Pixels[(SIZE_T)max(0, min(Y, Height - 1)) * Width + max(0, min(X, Width - 1))];
+
+    return (UINT8)(((((Pixel >> 16) & 0xFF) * 77) + (((Pixel >> 8) & 0xFF) * 150) + ((Pixel & 0xFF) * 29)) >> 8);
+}
+
+
+// The Sobel gradient at X, Y, with the pixels off of each side being the side ones repeated.
+static UINT8 GetGradient(const UINT32* Pixels, INT32 Width, INT32 Height, INT32 X, INT32 Y)
+{
+    INT32 Across = 0;
+
+    INT32 Down = 0;
+
+    for (INT32 Offset = -1; Offset <= 1; Offset++)
+    {
+        INT32 Weight = (Offset == 0) ? 2 : 1;
+
+        Across += Weight * (GetBrightness(Pixels, Width, Height, X + 1, Y + Offset) - GetBrightness(Pixels, Width, Height, X - 1, Y + Offset));
+
+        Down += Weight * (GetBrightness(Pixels, Width, Height, X + Offset, Y + 1) - GetBrightness(Pixels, Width, Height, X + Offset, Y - 1));
+    }
+
+    return (UINT8)((abs(Across) + abs(Down)) >> 3);
+}
+
+
+// Each channel of the four pixels averaged on its own, rounding to nearest.
+static UINT32 GetAverage(UINT32 A, UINT32 B, UINT32 C, UINT32 D)
+{
+    UINT32 Average = 0;
+
+    for (UINT32 Shift = 0; Shift < 32; Shift += 8)
+    {
+        UINT32 Sum = ((A >> Shift) & 0xFF) + ((B >> Shift) & 0xFF) + ((C >> Shift) & 0xFF) + ((D >> Shift) & 0xFF);
+
+        Average |= ((Sum + 2) / 4) << Shift;
+    }
+
+    return Average;
+}
+
+
+// Checks the gradient, row hashes, histogram and pyramid against each worked out pixel by pixel.
+static void CheckOtherResults(const ANALYSIS* Analysis, const UINT32* Pixels, INT32 Width, INT32 Height)
+{
+    static LONG Histogram[ANALYSIS_HISTOGRAM_BINS];
+
+    memset(Histogram, 0, sizeof(Histogram));
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        UINT64 Hash = 0xCBF29CE484222325ull;
+
+        for (INT32 X = 0; X < Width; X++)
+        {
+            UINT32 Pixel = Pixels[(SIZE_T)Y * Width + X];
+
+            Hash = (Hash ^ Pixel) * 0x100000001B3ull;
+
+            Histogram[(((Pixel >> 20) & 0xF) << 8) | (((Pixel >> 12) & 0xF) << 4) | ((Pixel >> 4) & 0xF)]++;
+
+            if (Analysis->Gradient[(SIZE_T)Y * Width + X] != GetGradient(Pixels, Width, Height, X, Y))
+            {
+                fprintf(stderr, "the gradient of %d x %d at %d,%d is %u, not %u\n", Width, Height, X, Y, Analysis->Gradient[(SIZE_T)Y * Width + X], GetGradient(Pixels, Width, Height, X, Y));
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+
+        if (Analysis->RowHashes[Y] != Hash)
+        {
+            fprintf(stderr, "the hash of row %d of %d x %d is wrong\n", Y, Width, Height);
+
+            gTestFailures++;
+
+            return;
+        }
+    }
+
+    if (memcmp(Histogram, (const LONG*)Analysis->Histogram, sizeof(Histogram)) != 0)
+    {
+        fprintf(stderr, "the histogram of %d x %d isn't the colors counted one by one\n", Width, Height);
+
+        gTestFailures++;
+    }
+
+    const UINT32* Source = Pixels;
+
+    INT32 SourceWidth = Width;
+
+    INT32 SourceHeight = Height;
+
+    UINT32 Levels = 0;
+
+    // Each level is made from the one above it, until it would be too small.
+    while (Levels < ANALYSIS_PYRAMID_LEVELS && SourceWidth / 2 >= ANALYSIS_PYRAMID_MIN && SourceHeight / 2 >= ANALYSIS_PYRAMID_MIN)
+    {
+        const ANALYSISLEVEL* Level = &Analysis->Pyramid[Levels];
+
+        if (Levels >= Analysis->PyramidLevels || Level->Width != SourceWidth / 2 || Level->Height != SourceHeight / 2)
+        {
+            fprintf(stderr, "level %u of the pyramid of %d x %d is missing or the wrong size\n", Levels, Width, Height);
+
+            gTestFailures++;
+
+            return;
+        }
+
+        for (INT32 Y = 0; Y < Level->Height; Y++)
+        {
+            for (INT32 X = 0; X < Level->Width; X++)
+            {
+                const UINT32* Upper = &Source[(SIZE_T)(2 * Y) * SourceWidth + 2 * X];
+
+                if (Level->Pixels[(SIZE_T)Y * Level->Width + X] != GetAverage(Upper[0], Upper[1], Upper[SourceWidth], Upper[SourceWidth + 1]))
+                {
+                    fprintf(stderr, "level %u of the pyramid of %d x %d is wrong at %d,%d\n", Levels, Width, Height, X, Y);
+
+                    gTestFailures++;
+
+                    return;
+                }
+            }
+        }
+
+        Source = Level->Pixels;
+
+        SourceWidth = Level->Width;
+
+        SourceHeight = Level->Height;
+
+        Levels++;
+    }
+
+    CHECK_EQUAL(Analysis->PyramidLevels, Levels);
+}
+
+
+static void TestResults(void)
+{
+    for (UINT32 Trial = 0; Trial < 60; Trial++)
+    {
+        // Tiny ones, and sizes that aren't a whole number of bands.
+        INT32 Width = (Trial < 4) ? (INT32)Trial + 1 : TestRandomRange(1, 300);
+
+        INT32 Height = (Trial < 4) ? 1 : TestRandomRange(1, 300);
+
+        BLENDMODE Mode = (Trial % 2) ? BLENDMODE_LINEAR : BLENDMODE_SRGB;
+
+        SIZE_T Bytes = (SIZE_T)Width * Height * sizeof(UINT32);
+
+        UINT32* Pixels = malloc(Bytes);
+
+        UINT32* Dimmed = malloc(Bytes);
+
+        UINT32* Expected = malloc(Bytes);
+
+        RECT All = { 0, 0, Width, Height };
+
+        ANALYSIS Analysis;
+
+        SNAPEDGES ExpectedEdges;
+
+        MakeScreenshot(Pixels, Width, Height);
+
+        memcpy(Expected, Pixels, Bytes);
+
+        BlendRectScalar(Expected, Width, &All, DIM_COLOR, DIM_ALPHA, Mode);
+
+        CHECK(MakeSnapEdges(Pixels, Width, Height, &ExpectedEdges));
+
+        SetProcessorCount((UINT32)TestRandomRange(1, 9));
+
+        if (StartAnalysis(&Analysis, Pixels, Width, Height, Dimmed, DIM_COLOR, DIM_ALPHA, Mode) == FALSE)
+        {
+            fprintf(stderr, "StartAnalysis of %d x %d failed\n", Width, Height);
+
+            gTestFailures++;
+
+            break;
+        }
+
+        // Usually the dimmed copy is wanted first, but any of them can be.
+        ANALYSISRESULT Order[ANALYSISRESULT_COUNT];
+
+        for (UINT32 Result = 0; Result < ANALYSISRESULT_COUNT; Result++)
+        {
+            UINT32 Other = (Trial % 3) ? Result : (UINT32)TestRandomRange(0, Result);
+
+            Order[Result] = (ANALYSISRESULT)Result;
+
+            Order[Result] = Order[Other];
+
+            Order[Other] = (ANALYSISRESULT)Result;
+        }
+
+        for (UINT32 Result = 0; Result < ANALYSISRESULT_COUNT; Result++)
+        {
+            CHECK(WaitForAnalysis(&Analysis, Order[Result]));
+        }
+
+        for (UINT32 Result = 0; Result < ANALYSISRESULT_COUNT; Result++)
+        {
+            CHECK(IsAnalysisReady(&Analysis, (ANALYSISRESULT)Result));
+        }
+
+        if (memcmp(Expected, Dimmed, Bytes) != 0)
+        {
+            fprintf(stderr, "the dimmed copy of %d x %d in mode %d isn't what BlendRectScalar gives\n", Width, Height, Mode);
+
+            gTestFailures++;
+        }
+
+        if (IsSameSnapEdges(&ExpectedEdges, &Analysis.SnapEdges) == FALSE)
+        {
+            fprintf(stderr, "the edges of %d x %d aren't the ones made on one thread\n", Width, Height);
+
+            gTestFailures++;
+        }
+
+        CheckOtherResults(&Analysis, Pixels, Width, Height);
+
+        // The mask is freed as soon as the lists are made from it.
+        CHECK(Analysis.Edges == NULL);
+
+        StopAnalysis(&Analysis);
+
+        CHECK(Analysis.Tasks == NULL && Analysis.Gradient == NULL && Analysis.RowHashes == NULL && Analysis.Pyramid[0].Pixels == NULL);
+
+        FreeSnapEdges(&ExpectedEdges);
+
+        free(Expected);
+
+        free(Dimmed);
+
+        free(Pixels);
+    }
+
+    // Nothing to analyse, and an analysis that was never started.
+    ANALYSIS Analysis;
+
+    UINT32 Pixel = 0;
+
+    CHECK(StartAnalysis(&Analysis, &Pixel, 0, 1, &Pixel, DIM_COLOR, DIM_ALPHA, BLENDMODE_SRGB) == FALSE);
+
+    CHECK(WaitForAnalysis(&Analysis, ANALYSISRESULT_DIMMED) == FALSE);
+
+    StopAnalysis(&Analysis);
+}
+
+
+static void TestCancel(void)
+{
+    enum { Width = 2000, Height = 1500 };
+
+    UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32* Dimmed = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32 Unfinished = 0;
+
+    double Slowest = 0.0;
+
+    MakeTestDesktop(Pixels, Width, Height, 1);
+
+    for (UINT32 Trial = 0; Trial < 100; Trial++)
+    {
+        ANALYSIS Analysis;
+
+        SetProcessorCount(Trial % 8 + 1);
+
+        CHECK(StartAnalysis(&Analysis, Pixels, Width, Height, Dimmed, DIM_COLOR, DIM_ALPHA, BLENDMODE_SRGB));
+
+        // Escape pressed straight away, or once the overlay is up.
+        if (Trial % 2)
+        {
+            CHECK(WaitForAnalysis(&Analysis, ANALYSISRESULT_DIMMED));
+        }
+
+        double Start = TestSeconds();
+
+        CancelAnalysis(&Analysis);
+
+        // What was ready stays ready, and what wasn't is never waited for.
+        CHECK(IsAnalysisReady(&Analysis, ANALYSISRESULT_DIMMED) || Trial % 2 == 0);
+
+        if (WaitForAnalysis(&Analysis, ANALYSISRESULT_EDGES) == FALSE)
+        {
+            Unfinished++;
+        }
+        else
+        {
+            CHECK(IsAnalysisReady(&Analysis, ANALYSISRESULT_EDGES));
+        }
+
+        StopAnalysis(&Analysis);
+
+        Slowest = max(Slowest, TestSeconds() - Start);
+
+        // Whatever was made is freed.
+        CHECK(Analysis.Edges == NULL && Analysis.Gradient == NULL && Analysis.RowHashes == NULL && Analysis.Pyramid[0].Pixels == NULL && Analysis.SnapEdges.RowStart == NULL);
+    }
+
+    printf("cancelled 100 times: %u stopped before the edges were done, slowest stop %.2f ms\n", Unfinished, Slowest * 1000.0);
+
+    free(Dimmed);
+
+    free(Pixels);
+}
+
+
+// A frame the size of three 4K monitors side by side.
+static void Bench(void)
+{
+    enum { Width = 11520, Height = 2160 };
+
+    static const UINT32 ProcessorCounts[] = { 1, 2, 4, 8 };
+
+    UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32* Dimmed = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    RECT All = { 0, 0, Width, Height };
+
+    SNAPEDGES Edges;
+
+    MakeTestDesktop(Pixels, Width, Height, 3);
+
+    // So that neither way pays for the pages being touched for the first time.
+    memset(Dimmed, 0, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    double Start = TestSeconds();
+
+    memcpy(Dimmed, Pixels, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    BlendRect(Dimmed, Width, &All, DIM_COLOR, DIM_ALPHA, BLENDMODE_SRGB);
+
+    double Inline = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    CHECK(MakeSnapEdges(Pixels, Width, Height, &Edges));
+
+    double InlineEdges = TestSeconds() - Start;
+
+    printf("%d x %d on one thread: dimmed copy %.1f ms, edges %.1f ms (%ld processors here)\n", Width, Height, Inline * 1000.0, InlineEdges * 1000.0, sysconf(_SC_NPROCESSORS_ONLN));
+
+    for (UINT32 Count = 0; Count < _countof(ProcessorCounts); Count++)
+    {
+        ANALYSIS Analysis;
+
+        SetProcessorCount(ProcessorCounts[Count]);
+
+        Start = TestSeconds();
+
+        CHECK(StartAnalysis(&Analysis, Pixels, Width, Height, Dimmed, DIM_COLOR, DIM_ALPHA, BLENDMODE_SRGB));
+
+        double Ready[ANALYSISRESULT_COUNT];
+
+        for (UINT32 Result = 0; Result < ANALYSISRESULT_COUNT; Result++)
+        {
+            CHECK(WaitForAnalysis(&Analysis, (ANALYSISRESULT)Result));
+
+            Ready[Result] = (TestSeconds() - Start) * 1000.0;
+        }
+
+        CHECK(IsSameSnapEdges(&Edges, &Analysis.SnapEdges));
+
+        printf("with %u processor%s, %u worker%s, ready after: dimmed copy %.1f ms, edges %.1f ms, gradient %.1f ms, row hashes %.1f ms, histogram %.1f ms, pyramid %.1f ms\n", ProcessorCounts[Count], (ProcessorCounts[Count] == 1) ? "" : "s", Analysis.ThreadCount, (Analysis.ThreadCount == 1) ? "" : "s",
+            Ready[ANALYSISRESULT_DIMMED], Ready[ANALYSISRESULT_EDGES], Ready[ANALYSISRESULT_GRADIENT], Ready[ANALYSISRESULT_ROWHASHES], Ready[ANALYSISRESULT_HISTOGRAM], Ready[ANALYSISRESULT_PYRAMID]);
+
+        StopAnalysis(&Analysis);
+    }
+
+    FreeSnapEdges(&Edges);
+
+    free(Dimmed);
+
+    free(Pixels);
+}
+
+
+int main(void)
+{
+    InitializeBlendTables();
+
+    TestResults();
+
+    TestCancel();
+
+    Bench();
+
+    return TestResult();
+}
@@ -0,0 +1,381 @@
+// TestBlend.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that every blend kernel gives exactly what its scalar version gives, at every length and alignment that
+// leaves some pixels over after the vectors, and times the two against each other.
+
+#include <windows.h>
+
+#include "SnipExBlend.h"
+
+#include "Test.h"
+
+// Spans up to this long are checked at every length, which covers every way they can be split between vectors.
+#define BLEND_MAX_COUNT  80
+
+// The span that's timed.
+#define BLEND_BENCH_COUNT (1920 * 1080)
+
+static const UINT32 gColors[] = { HILIGHT_YELLOW, HILIGHT_PINK, HILIGHT_ORANGE, HILIGHT_GREEN, 0x80000000, 0x00FFFFFF };
+
+
+// Random pixels, with some of them black and white, since those are the ends of every range.
+static void RandomPixels(UINT32* Pixels, UINT32 Count)
+{
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        UINT32 Kind = TestRandom() % 8;
+
+        Pixels[Index] = (Kind == 0) ? 0xFF000000 : (Kind == 1) ? 0xFFFFFFFF : (TestRandom() << 16) ^ TestRandom();
+    }
+}
+
+
+// A mask in runs, the way brushes make them, with a few odd bytes that are neither 0 nor 255.
+static void RandomMask(UINT8* Mask, UINT32 Count)
+{
+    UINT8 Value = 0;
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        if (TestRandom() % 6 == 0)
+        {
+            UINT32 Kind = TestRandom() % 3;
+
+            Value = (Kind == 0) ? 0 : (Kind == 1) ? 255 : (UINT8)TestRandom();
+        }
+
+        Mask[Index] = Value;
+    }
+}
+
+
+static void ReportSpeed(const char* What, double Scalar, double Fast)
+{
+    printf("%-24s scalar %7.3f ms  fast %7.3f ms  %5.1fx\n", What, Scalar * 1000.0, Fast * 1000.0, Scalar / Fast);
+}
+
+
+static void TestHilightSpan(BLENDMODE Mode)
+{
+    UINT32 Original[BLEND_MAX_COUNT + 4];
+
+    UINT32 Expected[BLEND_MAX_COUNT + 4];
+
+    UINT32 Actual[BLEND_MAX_COUNT + 4];
+
+    UINT8 Mask[BLEND_MAX_COUNT + 4];
+
+    for (UINT32 Color = 0; Color < _countof(gColors); Color++)
+    {
+        for (UINT32 Offset = 0; Offset < 4; Offset++)
+        {
+            for (UINT32 Count = 0; Count <= BLEND_MAX_COUNT; Count++)
+            {
+                RandomPixels(Original, _countof(Original));
+
+                RandomMask(Mask, _countof(Mask));
+
+                memcpy(Expected, Original, sizeof(Original));
+
+                memcpy(Actual, Original, sizeof(Original));
+
+                HilightSpanScalar(&Expected[Offset], &Mask[Offset], Count, gColors[Color], Mode);
+
+                HilightSpan(&Actual[Offset], &Mask[Offset], Count, gColors[Color], Mode);
+
+                if (memcmp(Expected, Actual, sizeof(Actual)) != 0)
+                {
+                    fprintf(stderr, "HilightSpan mode %d, color %08X, offset %u, count %u differs from HilightSpanScalar\n", Mode, gColors[Color], Offset, Count);
+
+                    gTestFailures++;
+                }
+            }
+        }
+    }
+
+    UINT32* Pixels = malloc(BLEND_BENCH_COUNT * sizeof(UINT32));
+
+    UINT8* BenchMask = malloc(BLEND_BENCH_COUNT);
+
+    RandomPixels(Pixels, BLEND_BENCH_COUNT);
+
+    memset(BenchMask, 1, BLEND_BENCH_COUNT);
+
+    double Start = TestSeconds();
+
+    HilightSpanScalar(Pixels, BenchMask, BLEND_BENCH_COUNT, HILIGHT_YELLOW, Mode);
+
+    double Scalar = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    HilightSpan(Pixels, BenchMask, BLEND_BENCH_COUNT, HILIGHT_YELLOW, Mode);
+
+    ReportSpeed(Mode == BLENDMODE_LINEAR ? "HilightSpan (linear)" : "HilightSpan (sRGB)", Scalar, TestSeconds() - Start);
+
+    free(BenchMask);
+
+    free(Pixels);
+}
+
+
+static void TestBlendRect(BLENDMODE Mode)
+{
+    enum { Stride = 48, Height = 12 };
+
+    UINT32 Expected[Stride * Height];
+
+    UINT32 Actual[Stride * Height];
+
+    for (UINT32 Trial = 0; Trial < 2000; Trial++)
+    {
+        RECT Rect = { TestRandomRange(0, Stride), TestRandomRange(0, Height), 0, 0 };
+
+        UINT32 Color = gColors[TestRandom() % _countof(gColors)];
+
+        UINT8 Alpha = (Trial < 2) ? (UINT8)(Trial * 255) : (UINT8)TestRandom();
+
+        Rect.right = TestRandomRange(Rect.left, Stride);
+
+        Rect.bottom = TestRandomRange(Rect.top, Height);
+
+        RandomPixels(Expected, _countof(Expected));
+
+        memcpy(Actual, Expected, sizeof(Expected));
+
+        BlendRectScalar(Expected, Stride, &Rect, Color, Alpha, Mode);
+
+        BlendRect(Actual, Stride, &Rect, Color, Alpha, Mode);
+
+        if (memcmp(Expected, Actual, sizeof(Actual)) != 0)
+        {
+            fprintf(stderr, "BlendRect mode %d, color %08X, alpha %u, rect %d,%d-%d,%d differs from BlendRectScalar\n", Mode, Color, Alpha, Rect.left, Rect.top, Rect.right, Rect.bottom);
+
+            gTestFailures++;
+        }
+    }
+
+    // A spotlight dims with BlendRect, half way toward black by default, here over the whole of a 1080p snip. The
+    // linear one is the scalar one, since its table lookups don't vectorize.
+    UINT32* Pixels = malloc(BLEND_BENCH_COUNT * sizeof(UINT32));
+
+    RECT All = { 0, 0, 1920, BLEND_BENCH_COUNT / 1920 };
+
+    RandomPixels(Pixels, BLEND_BENCH_COUNT);
+
+    double Start = TestSeconds();
+
+    BlendRectScalar(Pixels, 1920, &All, 0xFF000000, 128, Mode);
+
+    double Scalar = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    BlendRect(Pixels, 1920, &All, 0xFF000000, 128, Mode);
+
+    ReportSpeed(Mode == BLENDMODE_LINEAR ? "spotlight dim (linear)" : "spotlight dim (sRGB)", Scalar, TestSeconds() - Start);
+
+    free(Pixels);
+}
+
+
+static void TestBlendSpan(BLENDMODE Mode)
+{
+    UINT32 Expected[BLEND_MAX_COUNT + 4];
+
+    UINT32 Actual[BLEND_MAX_COUNT + 4];
+
+    UINT8 Alpha[BLEND_MAX_COUNT + 4];
+
+    for (UINT32 Color = 0; Color < _countof(gColors); Color++)
+    {
+        for (UINT32 Offset = 0; Offset < 4; Offset++)
+        {
+            for (UINT32 Count = 0; Count <= BLEND_MAX_COUNT; Count++)
+            {
+                RandomPixels(Expected, _countof(Expected));
+
+                RandomMask(Alpha, _countof(Alpha));
+
+                memcpy(Actual, Expected, sizeof(Expected));
+
+                BlendSpanScalar(&Expected[Offset], &Alpha[Offset], Count, gColors[Color], Mode);
+
+                BlendSpan(&Actual[Offset], &Alpha[Offset], Count, gColors[Color], Mode);
+
+                if (memcmp(Expected, Actual, sizeof(Actual)) != 0)
+                {
+                    fprintf(stderr, "BlendSpan mode %d, color %08X, offset %u, count %u differs from BlendSpanScalar\n", Mode, gColors[Color], Offset, Count);
+
+                    gTestFailures++;
+                }
+            }
+        }
+    }
+}
+
+
+static void TestMixSpan(BLENDMODE Mode)
+{
+    UINT32 Expected[BLEND_MAX_COUNT + 4];
+
+    UINT32 Actual[BLEND_MAX_COUNT + 4];
+
+    UINT32 Source[BLEND_MAX_COUNT + 4];
+
+    UINT8 Alpha[BLEND_MAX_COUNT + 4];
+
+    for (UINT32 Trial = 0; Trial < 4; Trial++)
+    {
+        for (UINT32 Offset = 0; Offset < 4; Offset++)
+        {
+            for (UINT32 Count = 0; Count <= BLEND_MAX_COUNT; Count++)
+            {
+                RandomPixels(Expected, _countof(Expected));
+
+                RandomPixels(Source, _countof(Source));
+
+                RandomMask(Alpha, _countof(Alpha));
+
+                memcpy(Actual, Expected, sizeof(Expected));
+
+                MixSpanScalar(&Expected[Offset], &Source[Offset], &Alpha[Offset], Count, Mode);
+
+                MixSpan(&Actual[Offset], &Source[Offset], &Alpha[Offset], Count, Mode);
+
+                if (memcmp(Expected, Actual, sizeof(Actual)) != 0)
+                {
+                    fprintf(stderr, "MixSpan mode %d, offset %u, count %u differs from MixSpanScalar\n", Mode, Offset, Count);
+
+                    gTestFailures++;
+                }
+            }
+        }
+    }
+}
+
+
+static void TestFillSpan(void)
+{
+    UINT32 Expected[BLEND_MAX_COUNT + 4];
+
+    UINT32 Actual[BLEND_MAX_COUNT + 4];
+
+    for (UINT32 Offset = 0; Offset < 4; Offset++)
+    {
+        for (UINT32 Count = 0; Count <= BLEND_MAX_COUNT; Count++)
+        {
+            RandomPixels(Expected, _countof(Expected));
+
+            memcpy(Actual, Expected, sizeof(Expected));
+
+            FillSpanScalar(&Expected[Offset], Count, 0xFF000000);
+
+            FillSpan(&Actual[Offset], Count, 0xFF000000);
+
+            if (memcmp(Expected, Actual, sizeof(Actual)) != 0)
+            {
+                fprintf(stderr, "FillSpan offset %u, count %u differs from FillSpanScalar\n", Offset, Count);
+
+                gTestFailures++;
+            }
+        }
+    }
+
+    // Fills this long use streaming stores, which have their own way of getting to an aligned address.
+    UINT32* Pixels = malloc((FILL_STREAM_THRESHOLD + 8) * sizeof(UINT32));
+
+    for (UINT32 Offset = 0; Offset < 4; Offset++)
+    {
+        UINT32 Count = FILL_STREAM_THRESHOLD + 3 - Offset;
+
+        memset(Pixels, 0x5A, (FILL_STREAM_THRESHOLD + 8) * sizeof(UINT32));
+
+        FillSpan(&Pixels[Offset], Count, 0xFF123456);
+
+        for (UINT32 Index = 0; Index < FILL_STREAM_THRESHOLD + 8; Index++)
+        {
+            BOOL Filled = (Index >= Offset && Index < Offset + Count);
+
+            if (Pixels[Index] != (Filled ? 0xFF123456 : 0x5A5A5A5A))
+            {
+                fprintf(stderr, "FillSpan of %u pixels at %u got pixel %u wrong\n", Count, Offset, Index);
+
+                gTestFailures++;
+
+                break;
+            }
+        }
+    }
+
+    free(Pixels);
+
+    // Streaming stores pay off once the fill is bigger than the cache, like a redact over most of a 4K snip.
+    Pixels = malloc(4 * BLEND_BENCH_COUNT * sizeof(UINT32));
+
+    FillSpanScalar(Pixels, 4 * BLEND_BENCH_COUNT, 0);
+
+    double Start = TestSeconds();
+
+    FillSpanScalar(Pixels, 4 * BLEND_BENCH_COUNT, 0xFF000000);
+
+    double Scalar = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    FillSpan(Pixels, 4 * BLEND_BENCH_COUNT, 0xFF000000);
+
+    ReportSpeed("FillSpan", Scalar, TestSeconds() - Start);
+
+    free(Pixels);
+}
+
+
+static void TestBlendTables(void)
+{
+    // 12 bits are supposed to be enough that every sRGB value survives the trip to linear and back.
+    for (UINT32 Srgb = 0; Srgb < 256; Srgb++)
+    {
+        CHECK_EQUAL(Srgb, LinearToSrgb(SrgbToLinear((UINT8)Srgb)));
+    }
+
+    CHECK_EQUAL(0, SrgbToLinear(0));
+
+    CHECK_EQUAL(LINEAR_MAX, SrgbToLinear(255));
+
+    for (UINT32 Srgb = 1; Srgb < 256; Srgb++)
+    {
+        CHECK(SrgbToLinear((UINT8)Srgb) > SrgbToLinear((UINT8)(Srgb - 1)));
+    }
+
+    // Half way between black and white in light is much brighter than half way in sRGB numbers.
+    CHECK(LinearToSrgb(LINEAR_MAX / 2) > 180);
+}
+
+
+int main(void)
+{
+    InitializeBlendTables();
+
+    TestBlendTables();
+
+    TestHilightSpan(BLENDMODE_SRGB);
+
+    TestHilightSpan(BLENDMODE_LINEAR);
+
+    TestBlendRect(BLENDMODE_SRGB);
+
+    TestBlendRect(BLENDMODE_LINEAR);
+
+    TestBlendSpan(BLENDMODE_SRGB);
+
+    TestBlendSpan(BLENDMODE_LINEAR);
+
+    TestMixSpan(BLENDMODE_SRGB);
+
+    TestMixSpan(BLENDMODE_LINEAR);
+
+    TestFillSpan();
+
+    return TestResult();
+}
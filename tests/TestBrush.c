@@ -0,0 +1,350 @@
+// TestBrush.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks the coverage merging kernel against the scalar one, that brush masks are the shapes they're meant to be
+// and are kept and dropped the way the cache says, and that stamping a segment leaves each pixel covered by the
+// most that any one stamp along it covers it. Then times stamping segments with each tip from the smallest size to
+// the largest, merging with the scalar kernel and with the fast one.
+
+#include <windows.h>
+
+#include "SnipExBrush.h"
+
+#include "Test.h"
+
+#define CANVAS_WIDTH  200
+
+#define CANVAS_HEIGHT 150
+
+#define BENCH_WIDTH   1024
+
+#define BENCH_HEIGHT  512
+
+typedef struct CANVAS
+{
+    UINT8 Coverage[CANVAS_HEIGHT][CANVAS_WIDTH];
+
+    RECT  Clip;
+
+    BOOL  Scalar;
+
+} CANVAS;
+
+typedef struct BENCHCANVAS
+{
+    UINT8* Coverage;
+
+    BOOL   Scalar;
+
+} BENCHCANVAS;
+
+
+static void TestMergeBrushRow(void)
+{
+    UINT8 ExpectedCoverage[84];
+
+    UINT8 ActualCoverage[84];
+
+    UINT8 Alpha[84];
+
+    UINT8 ExpectedExtra[84];
+
+    UINT8 ActualExtra[84];
+
+    for (UINT32 Trial = 0; Trial < 20000; Trial++)
+    {
+        UINT32 Offset = TestRandom() % 4;
+
+        UINT32 Count = (UINT32)TestRandomRange(0, 80);
+
+        for (UINT32 Index = 0; Index < _countof(Alpha); Index++)
+        {
+            UINT32 Kind = TestRandom() % 4;
+
+            ExpectedCoverage[Index] = (Kind == 0) ? 0 : (Kind == 1) ? 255 : (UINT8)TestRandom();
+
+            Kind = TestRandom() % 4;
+
+            Alpha[Index] = (Kind == 0) ? 0 : (Kind == 1) ? 255 : (UINT8)TestRandom();
+        }
+
+        // Most rows of a stroke go over what the last stamp already covered, and add nothing.
+        if (Trial % 3 == 0)
+        {
+            memcpy(Alpha, ExpectedCoverage, sizeof(Alpha));
+        }
+
+        memcpy(ActualCoverage, ExpectedCoverage, sizeof(ActualCoverage));
+
+        memset(ExpectedExtra, 0xAA, sizeof(ExpectedExtra));
+
+        memset(ActualExtra, 0xAA, sizeof(ActualExtra));
+
+        BOOL Expected = MergeBrushRowScalar(&ExpectedCoverage[Offset], &Alpha[Offset], &ExpectedExtra[Offset], Count);
+
+        BOOL Actual = MergeBrushRow(&ActualCoverage[Offset], &Alpha[Offset], &ActualExtra[Offset], Count);
+
+        if (Expected != Actual || memcmp(ExpectedCoverage, ActualCoverage, sizeof(ActualCoverage)) != 0 || memcmp(ExpectedExtra, ActualExtra, sizeof(ActualExtra)) != 0)
+        {
+            fprintf(stderr, "MergeBrushRow of %u pixels at offset %u differs from MergeBrushRowScalar\n", Count, Offset);
+
+            gTestFailures++;
+
+            return;
+        }
+    }
+}
+
+
+static void TestMasks(void)
+{
+    for (INT32 Height = BRUSH_MIN_SIZE; Height <= BRUSH_MAX_SIZE; Height += 7)
+    {
+        for (BRUSHTIP Tip = BRUSHTIP_SQUARE; Tip <= BRUSHTIP_CHISEL; Tip++)
+        {
+            INT32 Width = (Height * 3) / 5 + 1;
+
+            const BRUSHMASK* Mask = GetBrushMask(Tip, Width, Height);
+
+            CHECK(Mask != NULL && Mask->Tip == Tip && Mask->Width == Width && Mask->Height == Height);
+
+            CHECK(Mask->Stride >= Width && Mask->Stride % 16 == 0 && (UINT_PTR)Mask->Alpha % 16 == 0);
+
+            for (INT32 Y = 0; Y < Height; Y++)
+            {
+                const UINT8* Row = &Mask->Alpha[(SIZE_T)Y * Mask->Stride];
+
+                INT32 Left = Width;
+
+                INT32 Right = 0;
+
+                for (INT32 X = 0; X < Width; X++)
+                {
+                    if (Row[X] != 0)
+                    {
+                        Left = min(Left, X);
+
+                        Right = X + 1;
+                    }
+
+                    // The square covers all of every pixel, and the round tip is the same flipped either way, give
+                    // or take the rounding of the ellipse's sides.
+                    if (Tip == BRUSHTIP_SQUARE)
+                    {
+                        CHECK_EQUAL(255, Row[X]);
+                    }
+                    else if (Tip == BRUSHTIP_ROUND)
+                    {
+                        CHECK(abs(Row[X] - Row[Width - 1 - X]) <= 1);
+
+                        CHECK(abs(Row[X] - Mask->Alpha[(SIZE_T)(Height - 1 - Y) * Mask->Stride + X]) <= 1);
+                    }
+                }
+
+                // An empty row has nothing between its ends.
+                if (Right == 0)
+                {
+                    CHECK(Mask->RowLeft[Y] >= Mask->RowRight[Y]);
+                }
+                else
+                {
+                    CHECK_EQUAL(Left, Mask->RowLeft[Y]);
+
+                    CHECK_EQUAL(Right, Mask->RowRight[Y]);
+                }
+            }
+
+            // The middle of every tip that's more than a few pixels across is solid.
+            if (Width >= 8)
+            {
+                CHECK_EQUAL(255, Mask->Alpha[(SIZE_T)(Height / 2) * Mask->Stride + Width / 2]);
+            }
+        }
+    }
+
+    // A mask that was asked for lately comes straight from the cache; one that was pushed out is made again.
+    FreeBrushMasks();
+
+    const BRUSHMASK* First = GetBrushMask(BRUSHTIP_ROUND, 20, 30);
+
+    CHECK(GetBrushMask(BRUSHTIP_ROUND, 20, 30) == First);
+
+    CHECK(GetBrushMask(BRUSHTIP_CHISEL, 20, 30) != First);
+
+    for (INT32 Size = 0; Size < BRUSH_CACHE_SIZE; Size++)
+    {
+        CHECK(GetBrushMask(BRUSHTIP_SQUARE, 10, BRUSH_MIN_SIZE + Size) != NULL);
+    }
+
+    const BRUSHMASK* Again = GetBrushMask(BRUSHTIP_ROUND, 20, 30);
+
+    CHECK(Again != NULL && Again->Tip == BRUSHTIP_ROUND && Again->Width == 20 && Again->Height == 30);
+
+    FreeBrushMasks();
+}
+
+
+static void MergeRow(INT32 Y, INT32 Left, UINT32 Count, const UINT8* Alpha, void* Context)
+{
+    CANVAS* Canvas = Context;
+
+    UINT8 Extra[BRUSH_MAX_SIZE];
+
+    CHECK(Y >= Canvas->Clip.top && Y < Canvas->Clip.bottom && Left >= Canvas->Clip.left && Left + (INT32)Count <= Canvas->Clip.right && Count <= BRUSH_MAX_SIZE);
+
+    if (Canvas->Scalar)
+    {
+        MergeBrushRowScalar(&Canvas->Coverage[Y][Left], Alpha, Extra, Count);
+    }
+    else
+    {
+        MergeBrushRow(&Canvas->Coverage[Y][Left], Alpha, Extra, Count);
+    }
+}
+
+
+static void TestSegments(void)
+{
+    static CANVAS Expected;
+
+    static CANVAS Actual;
+
+    for (UINT32 Trial = 0; Trial < 1000; Trial++)
+    {
+        BRUSHTIP Tip = (BRUSHTIP)(Trial % 3);
+
+        const BRUSHMASK* Mask = GetBrushMask(Tip, TestRandomRange(BRUSH_MIN_SIZE, 40), TestRandomRange(BRUSH_MIN_SIZE, 60));
+
+        POINT From = { TestRandomRange(-50, CANVAS_WIDTH + 10), TestRandomRange(-50, CANVAS_HEIGHT + 10) };
+
+        POINT To = { TestRandomRange(-50, CANVAS_WIDTH + 10), TestRandomRange(-50, CANVAS_HEIGHT + 10) };
+
+        RECT Clip = { TestRandomRange(0, 50), TestRandomRange(0, 50), TestRandomRange(100, CANVAS_WIDTH), TestRandomRange(80, CANVAS_HEIGHT) };
+
+        INT32 Steps = max(abs(To.x - From.x), abs(To.y - From.y));
+
+        memset(&Expected, 0, sizeof(Expected));
+
+        memset(&Actual, 0, sizeof(Actual));
+
+        Expected.Clip = Actual.Clip = Clip;
+
+        Expected.Scalar = TRUE;
+
+        StampBrushSegment(Mask, From, To, &Clip, MergeRow, &Actual);
+
+        // One stamp for every pixel along the way, one at a time.
+        for (INT32 Step = 0; Step <= Steps; Step++)
+        {
+            POINT At = { From.x, From.y };
+
+            if (Steps > 0)
+            {
+                At.x += (INT32)(((INT64)(To.x - From.x) * Step * 2 + (To.x >= From.x ? Steps : -Steps)) / (2 * Steps));
+
+                At.y += (INT32)(((INT64)(To.y - From.y) * Step * 2 + (To.y >= From.y ? Steps : -Steps)) / (2 * Steps));
+            }
+
+            StampBrush(Mask, At, &Clip, MergeRow, &Expected);
+        }
+
+        if (memcmp(Expected.Coverage, Actual.Coverage, sizeof(Actual.Coverage)) != 0)
+        {
+            fprintf(stderr, "brush %d, %d x %d, from %d,%d to %d,%d doesn't cover what stamping every pixel does\n", Tip, Mask->Width, Mask->Height, From.x, From.y, To.x, To.y);
+
+            gTestFailures++;
+
+            return;
+        }
+    }
+}
+
+
+static void BenchRow(INT32 Y, INT32 Left, UINT32 Count, const UINT8* Alpha, void* Context)
+{
+    BENCHCANVAS* Canvas = Context;
+
+    UINT8 Extra[BRUSH_MAX_SIZE];
+
+    if (Canvas->Scalar)
+    {
+        MergeBrushRowScalar(&Canvas->Coverage[(SIZE_T)Y * BENCH_WIDTH + Left], Alpha, Extra, Count);
+    }
+    else
+    {
+        MergeBrushRow(&Canvas->Coverage[(SIZE_T)Y * BENCH_WIDTH + Left], Alpha, Extra, Count);
+    }
+}
+
+
+// How many stamps a second StampBrushSegment gets through along an 800 pixel segment, merging each row with Scalar
+// or the fast kernel.
+static double GetStampsPerSecond(const BRUSHMASK* Mask, BOOL Scalar)
+{
+    enum { Repeats = 20 };
+
+    static const RECT Clip = { 0, 0, BENCH_WIDTH, BENCH_HEIGHT };
+
+    BENCHCANVAS Canvas = { calloc(BENCH_WIDTH, BENCH_HEIGHT), Scalar };
+
+    POINT From = { 0, 100 };
+
+    POINT To = { 800, 250 };
+
+    double Start = TestSeconds();
+
+    for (UINT32 Repeat = 0; Repeat < Repeats; Repeat++)
+    {
+        StampBrushSegment(Mask, From, To, &Clip, BenchRow, &Canvas);
+    }
+
+    double Seconds = TestSeconds() - Start;
+
+    free(Canvas.Coverage);
+
+    return (double)Repeats * (max(abs(To.x - From.x), abs(To.y - From.y)) + 1) / Seconds;
+}
+
+
+static void BenchSegments(void)
+{
+    static const BRUSHTIP Tips[] = { BRUSHTIP_ROUND, BRUSHTIP_CHISEL, BRUSHTIP_SQUARE };
+
+    static const char* TipNames[] = { "round", "chisel", "square" };
+
+    for (UINT32 Tip = 0; Tip < _countof(Tips); Tip++)
+    {
+        for (INT32 Size = BRUSH_MIN_SIZE; Size <= BRUSH_MAX_SIZE; Size *= 2)
+        {
+            const BRUSHMASK* Mask = GetBrushMask(Tips[Tip], Size, Size);
+
+            CHECK(Mask != NULL);
+
+            if (Mask == NULL)
+            {
+                continue;
+            }
+
+            double Scalar = GetStampsPerSecond(Mask, TRUE);
+
+            double Fast = GetStampsPerSecond(Mask, FALSE);
+
+            printf("%-6s %3d px  scalar %9.0f stamps/s  fast %9.0f stamps/s  %5.1fx\n", TipNames[Tip], Size, Scalar, Fast, Fast / Scalar);
+        }
+    }
+}
+
+
+int main(void)
+{
+    TestMergeBrushRow();
+
+    TestMasks();
+
+    TestSegments();
+
+    BenchSegments();
+
+    FreeBrushMasks();
+
+    return TestResult();
+}
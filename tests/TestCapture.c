@@ -0,0 +1,402 @@
+// TestCapture.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks region capture planning against the selection worked out by hand: snips of random selections, on and
+// off the desktop and dragged every which way, come out the right size, with each pixel copied from the right
+// place on the desktop or black, whether they're copied out of a whole desktop or asked of a capture source for
+// just their part. Checks that monitor snips ask the source for that monitor and nothing more, that the monitor a
+// window is mostly on is found, and that layout changes are noticed. Then times snipping one monitor of three 4K
+// ones against copying the whole desktop, which is what every snip used to start with.
+
+#include <windows.h>
+
+#include "SnipExCapture.h"
+
+#include "Test.h"
+
+#define DESKTOP_WIDTH  97
+
+#define DESKTOP_HEIGHT 61
+
+// What a made-up capture source hands back, and what it was asked for.
+typedef struct TESTSOURCE
+{
+    const UINT32* Desktop;
+
+    INT32         Width;
+
+    RECT          Asked;
+
+    UINT32        Captures;
+
+    // The layout that the next refresh finds, and whether it can find one at all.
+    CAPTURELAYOUT NextLayout;
+
+    BOOL          CanRefresh;
+
+} TESTSOURCE;
+
+
+static UINT32 GetDesktopPixel(INT32 X, INT32 Y)
+{
+    return 0xFF000000 | (((UINT32)X * 2654435761u) ^ ((UINT32)Y * 40503u));
+}
+
+
+static BOOL CaptureTestSource(CAPTURESOURCE* Source, const RECT* Area, UINT32* Pixels, INT32 Stride)
+{
+    TESTSOURCE* Test = Source->Context;
+
+    Test->Asked = *Area;
+
+    Test->Captures++;
+
+    for (INT32 Y = Area->top; Y < Area->bottom; Y++)
+    {
+        memcpy(&Pixels[(SIZE_T)(Y - Area->top) * Stride], &Test->Desktop[(SIZE_T)Y * Test->Width + Area->left], (SIZE_T)(Area->right - Area->left) * sizeof(UINT32));
+    }
+
+    return TRUE;
+}
+
+
+static BOOL RefreshTestSource(CAPTURESOURCE* Source)
+{
+    TESTSOURCE* Test = Source->Context;
+
+    if (Test->CanRefresh == FALSE)
+    {
+        return FALSE;
+    }
+
+    Source->Layout = Test->NextLayout;
+
+    return TRUE;
+}
+
+
+static void TestPlans(void)
+{
+    UINT32* Desktop = malloc((SIZE_T)DESKTOP_WIDTH * DESKTOP_HEIGHT * sizeof(UINT32));
+
+    TESTSOURCE Test = { Desktop, DESKTOP_WIDTH };
+
+    CAPTURESOURCE Source = { { { 0, 0, DESKTOP_WIDTH, DESKTOP_HEIGHT } }, CaptureTestSource, NULL, NULL, &Test };
+
+    UINT32 Planned = 0;
+
+    for (INT32 Y = 0; Y < DESKTOP_HEIGHT; Y++)
+    {
+        for (INT32 X = 0; X < DESKTOP_WIDTH; X++)
+        {
+            Desktop[(SIZE_T)Y * DESKTOP_WIDTH + X] = GetDesktopPixel(X, Y);
+        }
+    }
+
+    for (UINT32 Trial = 0; Trial < 50000; Trial++)
+    {
+        RECT Selection = { TestRandomRange(-20, DESKTOP_WIDTH + 20), TestRandomRange(-20, DESKTOP_HEIGHT + 20), TestRandomRange(-20, DESKTOP_WIDTH + 20), TestRandomRange(-20, DESKTOP_HEIGHT + 20) };
+
+        INT32 Padding = (TestRandom() % 2) ? 8 : 0;
+
+        CAPTUREPLAN Plan;
+
+        // The selection right side up and on the desktop, worked out by hand.
+        INT32 Left = max(min(Selection.left, Selection.right), 0);
+
+        INT32 Right = min(max(Selection.left, Selection.right), DESKTOP_WIDTH);
+
+        INT32 Top = max(min(Selection.top, Selection.bottom), 0);
+
+        INT32 Bottom = min(max(Selection.top, Selection.bottom), DESKTOP_HEIGHT);
+
+        BOOL OnDesktop = (Left < Right && Top < Bottom);
+
+        if (PlanRegionCapture(&Selection, Padding, DESKTOP_WIDTH, DESKTOP_HEIGHT, &Plan) != OnDesktop)
+        {
+            fprintf(stderr, "PlanRegionCapture of %d,%d-%d,%d should have returned %d\n", Selection.left, Selection.top, Selection.right, Selection.bottom, OnDesktop);
+
+            gTestFailures++;
+
+            break;
+        }
+
+        if (OnDesktop == FALSE)
+        {
+            continue;
+        }
+
+        Planned++;
+
+        CHECK_EQUAL(Right - Left + Padding, Plan.Width);
+
+        CHECK_EQUAL(Bottom - Top + Padding, Plan.Height);
+
+        CHECK(Plan.Selection.left == Left && Plan.Selection.top == Top && Plan.Selection.right == Right && Plan.Selection.bottom == Bottom);
+
+        SIZE_T Bytes = (SIZE_T)Plan.Width * Plan.Height * sizeof(UINT32);
+
+        UINT32* Copied = malloc(Bytes);
+
+        UINT32* Captured = malloc(Bytes);
+
+        // Whatever was in the snip's pixels before, which all has to be written over.
+        memset(Copied, 0xAB, Bytes);
+
+        memset(Captured, 0xCD, Bytes);
+
+        CopyCaptureRegion(&Plan, Desktop, DESKTOP_WIDTH, Copied);
+
+        Test.Captures = 0;
+
+        CHECK(CaptureRegion(&Source, &Plan, Captured));
+
+        // Only the part of the desktop that goes in the snip is asked for, once.
+        CHECK_EQUAL(1, Test.Captures);
+
+        CHECK(EqualRect(&Test.Asked, &Plan.Source));
+
+        for (INT32 Y = 0; Y < Plan.Height; Y++)
+        {
+            for (INT32 X = 0; X < Plan.Width; X++)
+            {
+                UINT32 Expected = (Left + X < DESKTOP_WIDTH && Top + Y < DESKTOP_HEIGHT) ? GetDesktopPixel(Left + X, Top + Y) : 0;
+
+                if (Copied[(SIZE_T)Y * Plan.Width + X] != Expected || Captured[(SIZE_T)Y * Plan.Width + X] != Expected)
+                {
+                    fprintf(stderr, "snip of %d,%d-%d,%d with %d padding has the wrong pixel at %d,%d\n", Selection.left, Selection.top, Selection.right, Selection.bottom, Padding, X, Y);
+
+                    gTestFailures++;
+
+                    Y = Plan.Height;
+
+                    break;
+                }
+            }
+        }
+
+        free(Captured);
+
+        free(Copied);
+    }
+
+    printf("%u selections planned and captured exactly\n", Planned);
+
+    free(Desktop);
+}
+
+
+// A monitor to the left of the primary one and one above it, so that the desktop's left and top are negative,
+// and the monitors aren't all the same size.
+static const CAPTURELAYOUT gLayout =
+{
+    { -1280, -600, 1920, 1080 },
+    { { 0, 0, 1920, 1080 }, { -1280, 56, 0, 1080 }, { 0, -600, 800, 0 } },
+    3
+};
+
+
+static void TestMonitors(void)
+{
+    static const struct
+    {
+        RECT  Window;
+
+        INT32 Monitor;
+
+    } Cases[] =
+    {
+        // Inside one monitor.
+        { { 100, 100, 500, 400 }, 0 },
+        { { -1000, 300, -500, 600 }, 1 },
+        { { 100, -500, 300, -100 }, 2 },
+        // Across two, mostly on one or the other.
+        { { -300, 200, 100, 500 }, 1 },
+        { { -100, 200, 300, 500 }, 0 },
+        { { 100, -400, 300, 50 }, 2 },
+        { { 100, -50, 300, 300 }, 0 },
+        // Off every monitor: in the empty corner above the left one, and past the right edge of the desktop.
+        { { -900, -500, -800, -400 }, 1 },
+        { { 2500, 500, 2700, 700 }, 0 },
+        { { -200, -580, -100, -560 }, 2 }
+    };
+
+    for (UINT32 Case = 0; Case < _countof(Cases); Case++)
+    {
+        RECT Monitor;
+
+        FindCaptureMonitor(&gLayout, &Cases[Case].Window, &Monitor);
+
+        if (EqualRect(&Monitor, &gLayout.Monitors[Cases[Case].Monitor]) == FALSE)
+        {
+            fprintf(stderr, "window %d,%d-%d,%d should be found on monitor %d, but was found on %d,%d-%d,%d\n", Cases[Case].Window.left, Cases[Case].Window.top, Cases[Case].Window.right, Cases[Case].Window.bottom, Cases[Case].Monitor, Monitor.left, Monitor.top, Monitor.right, Monitor.bottom);
+
+            gTestFailures++;
+        }
+    }
+
+    // With no monitors, the whole desktop.
+    CAPTURELAYOUT NoMonitors = gLayout;
+
+    RECT Monitor;
+
+    NoMonitors.MonitorCount = 0;
+
+    FindCaptureMonitor(&NoMonitors, &Cases[0].Window, &Monitor);
+
+    CHECK(EqualRect(&Monitor, &gLayout.Desktop));
+
+    // A snip of each monitor, in desktop coordinates, is just that monitor, with nothing else asked of the source.
+    INT32 Width = gLayout.Desktop.right - gLayout.Desktop.left;
+
+    INT32 Height = gLayout.Desktop.bottom - gLayout.Desktop.top;
+
+    UINT32* Desktop = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    TESTSOURCE Test = { Desktop, Width };
+
+    CAPTURESOURCE Source = { gLayout, CaptureTestSource, NULL, NULL, &Test };
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        for (INT32 X = 0; X < Width; X++)
+        {
+            Desktop[(SIZE_T)Y * Width + X] = GetDesktopPixel(X, Y);
+        }
+    }
+
+    for (UINT32 Index = 0; Index < gLayout.MonitorCount; Index++)
+    {
+        RECT Selection = gLayout.Monitors[Index];
+
+        CAPTUREPLAN Plan;
+
+        OffsetRect(&Selection, -gLayout.Desktop.left, -gLayout.Desktop.top);
+
+        CHECK(PlanRegionCapture(&Selection, 0, Width, Height, &Plan));
+
+        CHECK(EqualRect(&Plan.Source, &Selection));
+
+        UINT32* Pixels = malloc((SIZE_T)Plan.Width * Plan.Height * sizeof(UINT32));
+
+        CHECK(CaptureRegion(&Source, &Plan, Pixels));
+
+        CHECK(EqualRect(&Test.Asked, &Selection));
+
+        CHECK_EQUAL(GetDesktopPixel(Selection.left, Selection.top), Pixels[0]);
+
+        CHECK_EQUAL(GetDesktopPixel(Selection.right - 1, Selection.bottom - 1), Pixels[(SIZE_T)Plan.Width * Plan.Height - 1]);
+
+        free(Pixels);
+    }
+
+    free(Desktop);
+}
+
+
+static void TestRefresh(void)
+{
+    TESTSOURCE Test = { 0 };
+
+    CAPTURESOURCE Source = { gLayout, CaptureTestSource, NULL, NULL, &Test };
+
+    // A source that can't have its layout change, such as saved frames.
+    CHECK(RefreshCaptureLayout(&Source) == FALSE);
+
+    Source.Refresh = RefreshTestSource;
+
+    // The same layout as before isn't a change.
+    Test.NextLayout = gLayout;
+
+    Test.CanRefresh = TRUE;
+
+    CHECK(RefreshCaptureLayout(&Source) == FALSE);
+
+    // A monitor unplugged is.
+    Test.NextLayout.MonitorCount = 2;
+
+    SetRect(&Test.NextLayout.Desktop, -1280, 0, 1920, 1080);
+
+    ZeroMemory(&Test.NextLayout.Monitors[2], sizeof(RECT));
+
+    CHECK(RefreshCaptureLayout(&Source));
+
+    CHECK(Source.Layout.MonitorCount == 2 && EqualRect(&Source.Layout.Desktop, &Test.NextLayout.Desktop));
+
+    // If the layout can't be had, the last one is kept.
+    Test.CanRefresh = FALSE;
+
+    Test.NextLayout = gLayout;
+
+    CHECK(RefreshCaptureLayout(&Source) == FALSE);
+
+    CHECK_EQUAL(2, Source.Layout.MonitorCount);
+}
+
+
+// One 4K monitor, and a region of one, out of three side by side, against copying the whole desktop.
+static void Bench(void)
+{
+    enum { Width = 11520, Height = 2160, Rounds = 10 };
+
+    static const RECT Selections[] = { { 3840, 0, 7680, 2160 }, { 5000, 800, 5800, 1400 } };
+
+    static const char* Names[] = { "one 4K monitor", "an 800 x 600 region" };
+
+    UINT32* Desktop = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32* Copy = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Desktop[Index] = (UINT32)Index;
+    }
+
+    double Start = TestSeconds();
+
+    for (UINT32 Round = 0; Round < Rounds; Round++)
+    {
+        memcpy(Copy, Desktop, (SIZE_T)Width * Height * sizeof(UINT32));
+    }
+
+    double Whole = (TestSeconds() - Start) / Rounds;
+
+    for (UINT32 Selection = 0; Selection < _countof(Selections); Selection++)
+    {
+        CAPTUREPLAN Plan;
+
+        CHECK(PlanRegionCapture(&Selections[Selection], 8, Width, Height, &Plan));
+
+        UINT32* Pixels = malloc((SIZE_T)Plan.Width * Plan.Height * sizeof(UINT32));
+
+        Start = TestSeconds();
+
+        for (UINT32 Round = 0; Round < Rounds; Round++)
+        {
+            CopyCaptureRegion(&Plan, Desktop, Width, Pixels);
+        }
+
+        double Region = (TestSeconds() - Start) / Rounds;
+
+        printf("snip of %-20s %6.1f MB in %6.2f ms; copying the whole %d x %d desktop first is %6.1f MB in %6.2f ms\n", Names[Selection], (double)Plan.Width * Plan.Height * sizeof(UINT32) / 1048576.0, Region * 1000.0, Width, Height, (double)Width * Height * sizeof(UINT32) / 1048576.0, Whole * 1000.0);
+
+        free(Pixels);
+    }
+
+    free(Copy);
+
+    free(Desktop);
+}
+
+
+int main(void)
+{
+    TestPlans();
+
+    TestMonitors();
+
+    TestRefresh();
+
+    Bench();
+
+    return TestResult();
+}
@@ -0,0 +1,415 @@
+// TestCompress.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that CompressBlock and DecompressBlock give back exactly what went in, for blocks of every kind from
+// empty to longer than the 64K window, that neither writes past the room it's given, and that damaged blocks are
+// turned down rather than read past their ends. Then checks that the undo journal's worker packs older steps and
+// moves the oldest to the scratch file, and that they still come back exactly, and times the codec on a tile.
+
+#include <windows.h>
+
+#include "SnipExCompress.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExJournal.h"
+
+#include "Test.h"
+
+#define MAX_BLOCK   (100 * 1024)
+
+#define SNIP_WIDTH  700
+
+#define SNIP_HEIGHT 450
+
+#define SNIP_BYTES  ((SIZE_T)SNIP_WIDTH * SNIP_HEIGHT * sizeof(UINT32))
+
+#define STEPS       (JOURNAL_WARM_STEPS + 30)
+
+
+// Fills Block with one of the kinds of bytes that tiles are made of.
+static void FillBlock(UINT8* Block, SIZE_T Size, UINT32 Kind)
+{
+    for (SIZE_T Index = 0; Index < Size; Index++)
+    {
+        switch (Kind)
+        {
+            // Noise, which doesn't compress at all.
+            case 0:
+            {
+                Block[Index] = (UINT8)TestRandom();
+
+                break;
+            }
+            // Mostly zeros, like a tile XORed with the base that a thin stroke went over.
+            case 1:
+            {
+                Block[Index] = (TestRandom() % 50 == 0) ? (UINT8)TestRandom() : 0;
+
+                break;
+            }
+            // A short pattern over and over, so that copies overlap the bytes they write.
+            case 2:
+            {
+                Block[Index] = (UINT8)((Index / 7) % 5);
+
+                break;
+            }
+            // Copies of what came a few bytes back, broken up now and then.
+            default:
+            {
+                Block[Index] = (Index > 3 && TestRandom() % 8 != 0) ? Block[Index - 3] : (UINT8)TestRandom();
+            }
+        }
+    }
+}
+
+
+static void TestRoundTrip(void)
+{
+    UINT8* Source = malloc(MAX_BLOCK);
+
+    UINT8* Compressed = malloc(COMPRESS_BOUND(MAX_BLOCK) + 16);
+
+    UINT8* Decompressed = malloc(MAX_BLOCK + 16);
+
+    for (UINT32 Trial = 0; Trial < 4000; Trial++)
+    {
+        // Small blocks mostly, and now and then one longer than the furthest a copy can reach back.
+        SIZE_T Size = (Trial % 10 == 0) ? (SIZE_T)TestRandomRange(0, MAX_BLOCK) : (SIZE_T)TestRandomRange(0, 300);
+
+        UINT32 Kind = TestRandom() % 4;
+
+        FillBlock(Source, Size, Kind);
+
+        memset(Compressed, 0xEE, COMPRESS_BOUND(Size) + 16);
+
+        SIZE_T CompressedSize = CompressBlock(Source, Size, Compressed, COMPRESS_BOUND(Size));
+
+        if (CompressedSize == 0 || CompressedSize > COMPRESS_BOUND(Size))
+        {
+            fprintf(stderr, "CompressBlock of %zu bytes of kind %u gave %zu bytes, with room for %zu\n", Size, Kind, CompressedSize, (SIZE_T)COMPRESS_BOUND(Size));
+
+            gTestFailures++;
+
+            break;
+        }
+
+        for (SIZE_T Index = COMPRESS_BOUND(Size); Index < COMPRESS_BOUND(Size) + 16; Index++)
+        {
+            CHECK_EQUAL(0xEE, Compressed[Index]);
+        }
+
+        memset(Decompressed, 0xEE, Size + 16);
+
+        if (DecompressBlock(Compressed, CompressedSize, Decompressed, Size) == FALSE || memcmp(Source, Decompressed, Size) != 0)
+        {
+            fprintf(stderr, "%zu bytes of kind %u don't come back the same from %zu compressed bytes\n", Size, Kind, CompressedSize);
+
+            gTestFailures++;
+
+            break;
+        }
+
+        for (SIZE_T Index = Size; Index < Size + 16; Index++)
+        {
+            CHECK_EQUAL(0xEE, Decompressed[Index]);
+        }
+
+        // It has to be exactly the size it was.
+        if (Size > 0)
+        {
+            CHECK(DecompressBlock(Compressed, CompressedSize, Decompressed, Size - 1) == FALSE);
+        }
+
+        CHECK(DecompressBlock(Compressed, CompressedSize, Decompressed, Size + 1) == FALSE);
+
+        // With a byte less room than it needs, it doesn't fit.
+        if (CompressedSize > 1)
+        {
+            CHECK_EQUAL(0, CompressBlock(Source, Size, Compressed, CompressedSize - 1));
+        }
+
+        // Cut short or damaged, it's either turned down or decompresses to something, but never goes past either
+        // end, which the sanitizer build checks.
+        if (CompressedSize > 1)
+        {
+            CHECK(DecompressBlock(Compressed, TestRandomRange(0, (int)CompressedSize - 1), Decompressed, Size) == FALSE || Size == 0);
+
+            Compressed[TestRandom() % CompressedSize] ^= (UINT8)TestRandomRange(1, 255);
+
+            DecompressBlock(Compressed, CompressedSize, Decompressed, Size);
+
+            for (SIZE_T Index = Size; Index < Size + 16; Index++)
+            {
+                CHECK_EQUAL(0xEE, Decompressed[Index]);
+            }
+        }
+    }
+
+    free(Decompressed);
+
+    free(Compressed);
+
+    free(Source);
+}
+
+
+// Draws a stroke's worth of new pixels across Area, the way an annotation would, and covers some of them.
+static void Scribble(UINT32* Raster, COVERAGE* Coverage, const RECT* Area)
+{
+    UINT32 Color = 0xFF000000 | ((TestRandom() << 8) ^ TestRandom());
+
+    for (INT32 Y = Area->top; Y < Area->bottom; Y++)
+    {
+        for (INT32 X = Area->left; X < Area->right; X++)
+        {
+            Raster[(SIZE_T)Y * SNIP_WIDTH + X] = (TestRandom() % 16 == 0) ? (Color ^ TestRandom()) : Color;
+
+            if ((X + Y) % 3 == 0)
+            {
+                CoverPixel(Coverage, X, Y);
+            }
+        }
+    }
+}
+
+
+// Whether the worker has packed every step it's meant to and moved every one it's meant to to the scratch file.
+static BOOL IsJournalSettled(JOURNAL* Journal)
+{
+    BOOL Settled = TRUE;
+
+    EnterCriticalSection(&Journal->Lock);
+
+    for (UINT32 Index = 0; Index + JOURNAL_HOT_STEPS < Journal->Count; Index++)
+    {
+        const JOURNALSTEP* Step = &Journal->Steps[Index];
+
+        if (Step->Packed < Step->Count || (Index + JOURNAL_WARM_STEPS < Journal->Count && Step->Spilled < Step->Count))
+        {
+            Settled = FALSE;
+        }
+    }
+
+    LeaveCriticalSection(&Journal->Lock);
+
+    return Settled;
+}
+
+
+// How much memory the journal's tiles would take up if none of them had been packed or moved.
+static SIZE_T GetRawBytes(const JOURNAL* Journal)
+{
+    SIZE_T Bytes = 0;
+
+    for (UINT32 Index = 0; Index < Journal->Count; Index++)
+    {
+        for (UINT32 Tile = 0; Tile < Journal->Steps[Index].Count; Tile++)
+        {
+            const JOURNALTILE* Kept = &Journal->Steps[Index].Tiles[Tile];
+
+            SIZE_T Width = min(JOURNAL_TILE_SIZE, Journal->Width - (INT32)(Kept->Index % Journal->TilesAcross) * JOURNAL_TILE_SIZE);
+
+            SIZE_T Height = min(JOURNAL_TILE_SIZE, Journal->Height - (INT32)(Kept->Index / Journal->TilesAcross) * JOURNAL_TILE_SIZE);
+
+            Bytes += Width * Height * sizeof(UINT32) + (Kept->HasCoverage ? Height * sizeof(UINT64) : 0);
+        }
+    }
+
+    return Bytes;
+}
+
+
+static void TestTiers(void)
+{
+    UINT32* Base = malloc(SNIP_BYTES);
+
+    UINT32* Raster = malloc(SNIP_BYTES);
+
+    UINT32** Before = calloc(STEPS + 1, sizeof(UINT32*));
+
+    COVERAGE* CoveredBefore = calloc(STEPS + 1, sizeof(COVERAGE));
+
+    COVERAGE Coverage;
+
+    JOURNAL Journal;
+
+    SIZE_T RawBytes;
+
+    SIZE_T Bytes;
+
+    UINT64 FileBytes;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)SNIP_WIDTH * SNIP_HEIGHT; Index++)
+    {
+        Base[Index] = 0xFF000000 | (UINT32)((Index / SNIP_WIDTH) * 3 + (Index % SNIP_WIDTH)) * 0x010101;
+    }
+
+    memcpy(Raster, Base, SNIP_BYTES);
+
+    InitializeCoverage(&Coverage, SNIP_WIDTH, SNIP_HEIGHT);
+
+    CHECK(InitializeJournal(&Journal, SNIP_WIDTH, SNIP_HEIGHT, Base, (SIZE_T)1 << 30));
+
+    for (UINT32 Step = 1; Step <= STEPS; Step++)
+    {
+        RECT Area;
+
+        Area.left = TestRandomRange(0, SNIP_WIDTH - 1);
+
+        Area.top = TestRandomRange(0, SNIP_HEIGHT - 1);
+
+        Area.right = TestRandomRange(Area.left + 1, min(Area.left + 300, SNIP_WIDTH));
+
+        Area.bottom = TestRandomRange(Area.top + 1, min(Area.top + 40, SNIP_HEIGHT));
+
+        Before[Step] = malloc(SNIP_BYTES);
+
+        memcpy(Before[Step], Raster, SNIP_BYTES);
+
+        CHECK(CopyCoverage(&CoveredBefore[Step], &Coverage));
+
+        SaveJournalTiles(&Journal, Step, Raster, &Coverage, &Area);
+
+        Scribble(Raster, &Coverage, &Area);
+    }
+
+    // The worker goes one tile at a time, and may not have started yet.
+    for (UINT32 Wait = 0; Wait < 1000 && IsJournalSettled(&Journal) == FALSE; Wait++)
+    {
+        Sleep(10);
+    }
+
+    CHECK(IsJournalSettled(&Journal));
+
+    GetJournalUsage(&Journal, &Bytes, &FileBytes);
+
+    RawBytes = GetRawBytes(&Journal);
+
+    printf("%u steps: %zu KB of tiles as they were drawn over, %zu KB in memory and %llu KB in the scratch file once packed and moved\n", STEPS, RawBytes / 1024, Bytes / 1024, (unsigned long long)FileBytes / 1024);
+
+    CHECK(Bytes < RawBytes / 2);
+
+    CHECK(FileBytes > 0);
+
+    CHECK_EQUAL(JOURNALTIER_FILE, Journal.Steps[0].Tiles[0].Tier);
+
+    CHECK_EQUAL(JOURNALTIER_PACKED, Journal.Steps[STEPS - JOURNAL_WARM_STEPS].Tiles[0].Tier);
+
+    CHECK_EQUAL(JOURNALTIER_RAW, Journal.Steps[STEPS - 1].Tiles[0].Tier);
+
+    // Every step comes back exactly, whichever tier its tiles ended up in.
+    for (UINT32 Step = STEPS; Step > 0; Step--)
+    {
+        CHECK(RestoreJournalStep(&Journal, Step, Raster, &Coverage));
+
+        if (memcmp(Before[Step], Raster, SNIP_BYTES) != 0)
+        {
+            fprintf(stderr, "restoring step %u doesn't put back what it drew over\n", Step);
+
+            gTestFailures++;
+
+            memcpy(Raster, Before[Step], SNIP_BYTES);
+        }
+
+        for (INT32 Y = 0; Y < SNIP_HEIGHT; Y++)
+        {
+            for (INT32 X = 0; X < SNIP_WIDTH; X++)
+            {
+                if (IsPixelCovered(&CoveredBefore[Step], X, Y) != IsPixelCovered(&Coverage, X, Y))
+                {
+                    fprintf(stderr, "restoring step %u doesn't put back the coverage of %d,%d\n", Step, X, Y);
+
+                    gTestFailures++;
+
+                    Y = SNIP_HEIGHT;
+
+                    break;
+                }
+            }
+        }
+
+        FreeCoverage(&Coverage);
+
+        CHECK(CopyCoverage(&Coverage, &CoveredBefore[Step]));
+
+        FreeCoverage(&CoveredBefore[Step]);
+
+        free(Before[Step]);
+    }
+
+    CHECK(memcmp(Raster, Base, SNIP_BYTES) == 0);
+
+    // With nothing left in it, the scratch file starts over.
+    GetJournalUsage(&Journal, &Bytes, &FileBytes);
+
+    CHECK_EQUAL(0, Bytes);
+
+    CHECK_EQUAL(0, FileBytes);
+
+    FreeJournal(&Journal);
+
+    FreeCoverage(&Coverage);
+
+    free(CoveredBefore);
+
+    free(Before);
+
+    free(Raster);
+
+    free(Base);
+}
+
+
+// A full tile of pixels and its words of the coverage map, which a thin stroke drew across.
+static void BenchTile(void)
+{
+    enum { Size = JOURNAL_TILE_SIZE * JOURNAL_TILE_SIZE * sizeof(UINT32) + JOURNAL_TILE_SIZE * sizeof(UINT64), Rounds = 10000 };
+
+    static UINT8 Source[Size];
+
+    static UINT8 Compressed[COMPRESS_BOUND(Size)];
+
+    static UINT8 Decompressed[Size];
+
+    for (SIZE_T Index = 0; Index < Size; Index++)
+    {
+        Source[Index] = (Index % 256 < 230) ? 0 : (UINT8)TestRandom();
+    }
+
+    SIZE_T CompressedSize = 0;
+
+    double Start = TestSeconds();
+
+    for (UINT32 Round = 0; Round < Rounds; Round++)
+    {
+        CompressedSize = CompressBlock(Source, Size, Compressed, sizeof(Compressed));
+    }
+
+    double Compress = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    for (UINT32 Round = 0; Round < Rounds; Round++)
+    {
+        CHECK(DecompressBlock(Compressed, CompressedSize, Decompressed, Size));
+    }
+
+    double Decompress = TestSeconds() - Start;
+
+    CHECK(memcmp(Source, Decompressed, Size) == 0);
+
+    printf("tile of %d bytes -> %zu bytes, compress %.2f us, decompress %.2f us\n", Size, CompressedSize, Compress * 1e6 / Rounds, Decompress * 1e6 / Rounds);
+}
+
+
+int main(void)
+{
+    TestRoundTrip();
+
+    TestTiers();
+
+    BenchTile();
+
+    return TestResult();
+}
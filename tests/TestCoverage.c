@@ -0,0 +1,209 @@
+// TestCoverage.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks the hilighter's coverage bitset against a plain array of one BOOL per pixel. Then plays back a long
+// hilighter stroke across a 4K snip and times each mouse move, over fresh pixels and back over hilighted ones.
+
+#include <windows.h>
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+#include "Test.h"
+
+
+static void CheckSame(const COVERAGE* Coverage, const BOOL* Expected, INT32 Width, INT32 Height)
+{
+    for (INT32 Y = -1; Y <= Height; Y++)
+    {
+        for (INT32 X = -1; X <= Width; X++)
+        {
+            BOOL Inside = (X >= 0 && Y >= 0 && X < Width && Y < Height);
+
+            if (IsPixelCovered(Coverage, X, Y) != (Inside && Expected[Y * Width + X]))
+            {
+                fprintf(stderr, "pixel %d,%d of %d x %d is wrong\n", X, Y, Width, Height);
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+    }
+}
+
+
+static void TestSize(INT32 Width, INT32 Height)
+{
+    COVERAGE Coverage;
+
+    COVERAGE Copy;
+
+    BOOL* Expected = calloc((size_t)Width * Height, sizeof(BOOL));
+
+    InitializeCoverage(&Coverage, (UINT32)Width, (UINT32)Height);
+
+    // Nothing is allocated until something is covered.
+    CHECK(Coverage.Bits == NULL);
+
+    CHECK(CoverPixel(&Coverage, -1, 0) == FALSE);
+
+    CHECK(CoverPixel(&Coverage, Width, Height - 1) == FALSE);
+
+    for (INT32 Trial = 0; Trial < Width * Height; Trial++)
+    {
+        INT32 X = TestRandomRange(0, Width - 1);
+
+        INT32 Y = TestRandomRange(0, Height - 1);
+
+        // Covering a pixel says whether it was covered before, which is what stops the hilighter going over it twice.
+        CHECK_EQUAL(!Expected[Y * Width + X], CoverPixel(&Coverage, X, Y));
+
+        Expected[Y * Width + X] = TRUE;
+    }
+
+    CheckSame(&Coverage, Expected, Width, Height);
+
+    CHECK(CopyCoverage(&Copy, &Coverage));
+
+    BOOL* Copied = malloc((size_t)Width * Height * sizeof(BOOL));
+
+    memcpy(Copied, Expected, (size_t)Width * Height * sizeof(BOOL));
+
+    for (INT32 Trial = 0; Trial < 20; Trial++)
+    {
+        RECT Rect = { TestRandomRange(-8, Width), TestRandomRange(-8, Height), TestRandomRange(-8, Width + 8), TestRandomRange(-8, Height + 8) };
+
+        ClearCoverage(&Coverage, &Rect);
+
+        for (INT32 Y = max(Rect.top, 0); Y < min(Rect.bottom, Height); Y++)
+        {
+            for (INT32 X = max(Rect.left, 0); X < min(Rect.right, Width); X++)
+            {
+                Expected[Y * Width + X] = FALSE;
+            }
+        }
+    }
+
+    CheckSame(&Coverage, Expected, Width, Height);
+
+    // Clearing the map mustn't have cleared the copy.
+    CheckSame(&Copy, Copied, Width, Height);
+
+    FreeCoverage(&Coverage);
+
+    CHECK(Coverage.Bits == NULL);
+
+    CHECK(IsPixelCovered(&Coverage, 0, 0) == FALSE);
+
+    FreeCoverage(&Copy);
+
+    free(Copied);
+
+    free(Expected);
+}
+
+
+// Drags the hilighter along a line of text across the whole of a 4K snip, a few pixels each mouse move the way a
+// hand does, then back over what it has already hilighted, and prints how long each mouse move took on average.
+static void BenchHilightStroke(void)
+{
+    enum { Width = 3840, Height = 2160, Passes = 40 };
+
+    UINT32* Raster = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    DOCUMENT Document;
+
+    RECT Damage;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Raster[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, Width, Height, 256 * 1024 * 1024, NULL, NULL));
+
+    BeginDocumentStep(&Document);
+
+    POINT Mouse = { 0, Height / 2 };
+
+    ANNOTATION* Stroke = BeginStroke(&Document, ANNOTATION_HILIGHT, Mouse, BRUSHTIP_SQUARE, 10, 20, HILIGHT_YELLOW, BLENDMODE_LINEAR);
+
+    CHECK(Stroke != NULL);
+
+    // The first pass, and every one after it.
+    UINT32 Events[2] = { 0 };
+
+    double Seconds[2] = { 0 };
+
+    for (UINT32 Pass = 0; Stroke != NULL && Pass < Passes; Pass++)
+    {
+        INT32 Direction = (Pass % 2 == 0) ? 1 : -1;
+
+        UINT32 Again = (Pass > 0);
+
+        double Start = TestSeconds();
+
+        while ((Direction > 0) ? (Mouse.x < Width - 10) : (Mouse.x > 0))
+        {
+            Mouse.x = max(0, min(Width - 10, Mouse.x + Direction * TestRandomRange(1, 12)));
+
+            CHECK(AddStrokePoint(&Document, Stroke, Mouse, NULL, &Damage));
+
+            Events[Again]++;
+        }
+
+        Seconds[Again] += TestSeconds() - Start;
+    }
+
+    printf("hilighter across %d x %d, fresh pixels:      %5u mouse moves, %6.0f ns each\n", Width, Height, Events[0], Seconds[0] * 1e9 / max(Events[0], 1));
+
+    printf("hilighter across %d x %d, already hilighted: %5u mouse moves, %6.0f ns each\n", Width, Height, Events[1], Seconds[1] * 1e9 / max(Events[1], 1));
+
+    if (Stroke != NULL)
+    {
+        EndStroke(&Document, Stroke, NULL);
+    }
+
+    FreeDocument(&Document);
+
+    free(Raster);
+}
+
+
+int main(void)
+{
+    TestSize(1, 1);
+
+    TestSize(63, 5);
+
+    TestSize(64, 7);
+
+    TestSize(65, 3);
+
+    TestSize(200, 130);
+
+    InitializeBlendTables();
+
+    BenchHilightStroke();
+
+    return TestResult();
+}
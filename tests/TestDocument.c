@@ -0,0 +1,644 @@
+// TestDocument.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that the display list and the flattened raster always agree: that redrawing the whole snip from the list
+// gives the raster back exactly, that undoing every change gives back the snip as it was taken, and that redoing
+// them all gives back exactly what was drawn. Also that the eraser puts back the snip as it was taken under its brush,
+// and that a spotlight dims everything outside of its rectangle once and nothing inside it. Then times adding,
+// undoing and redrawing part of a snip that has thousands of annotations on it, and how much memory they take, and
+// erasing with the same brush on a small snip and on a 100 megapixel one.
+
+#include <windows.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+#include "Test.h"
+
+#include "TestEdits.h"
+
+#define SNIP_WIDTH  333
+
+#define SNIP_HEIGHT 251
+
+#define SNIP_BYTES  ((SIZE_T)SNIP_WIDTH * SNIP_HEIGHT * sizeof(UINT32))
+
+#define MAX_CHANGES 60
+
+
+// Whether redrawing all of Document from its annotations changes anything, in the raster or in which pixels the
+// hilighter has darkened.
+static BOOL IsRedrawnTheSame(DOCUMENT* Document)
+{
+    UINT32* Before = malloc(SNIP_BYTES);
+
+    COVERAGE Coverage;
+
+    RECT Whole = { 0, 0, SNIP_WIDTH, SNIP_HEIGHT };
+
+    BOOL Same;
+
+    memcpy(Before, Document->Raster, SNIP_BYTES);
+
+    CHECK(CopyCoverage(&Coverage, &Document->Coverage));
+
+    RedrawDocument(Document, &Whole);
+
+    Same = (memcmp(Before, Document->Raster, SNIP_BYTES) == 0);
+
+    for (INT32 Y = 0; Y < SNIP_HEIGHT && Same; Y++)
+    {
+        for (INT32 X = 0; X < SNIP_WIDTH && Same; X++)
+        {
+            Same = (IsPixelCovered(&Coverage, X, Y) == IsPixelCovered(&Document->Coverage, X, Y));
+        }
+    }
+
+    FreeCoverage(&Coverage);
+
+    free(Before);
+
+    return Same;
+}
+
+
+// Makes some changes, then undoes them all and redoes them all, checking the raster against what it was at each
+// step along the way.
+static void TestUndoRedo(SIZE_T JournalBudget)
+{
+    UINT32* Raster = malloc(SNIP_BYTES);
+
+    UINT32* Source = malloc(SNIP_BYTES);
+
+    // What the raster was after each change, the snip as it was taken first.
+    UINT32* Drawn[MAX_CHANGES + 1];
+
+    UINT32 Changes = 0;
+
+    DOCUMENT Document;
+
+    RECT Damage;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)SNIP_WIDTH * SNIP_HEIGHT; Index++)
+    {
+        // Flat patches among the noise, so that filled regions are more than one pixel.
+        Raster[Index] = ((Index / 37) % 3 == 0) ? 0xFFC0C0C0 : 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+
+        Source[Index] = 0xFF000000 | (UINT32)(Index * 40503u);
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, SNIP_WIDTH, SNIP_HEIGHT, JournalBudget, NULL, NULL));
+
+    CHECK(UndoDocumentStep(&Document, &Damage) == FALSE);
+
+    CHECK(RedoDocumentStep(&Document, &Damage) == FALSE);
+
+    Drawn[0] = malloc(SNIP_BYTES);
+
+    memcpy(Drawn[0], Raster, SNIP_BYTES);
+
+    while (Changes < MAX_CHANGES)
+    {
+        UINT32 Count = Document.Count;
+
+        AddRandomChange(&Document, Source);
+
+        // A stroke that missed the snip, or a callout with nowhere to go, adds nothing to undo.
+        if (Document.Count == Count)
+        {
+            continue;
+        }
+
+        Changes++;
+
+        Drawn[Changes] = malloc(SNIP_BYTES);
+
+        memcpy(Drawn[Changes], Raster, SNIP_BYTES);
+
+        if (IsRedrawnTheSame(&Document) == FALSE)
+        {
+            fprintf(stderr, "journal budget %zu: redrawing after change %u doesn't give the raster\n", JournalBudget, Changes);
+
+            gTestFailures++;
+        }
+    }
+
+    for (UINT32 Change = Changes; Change > 0; Change--)
+    {
+        CHECK(UndoDocumentStep(&Document, &Damage));
+
+        if (memcmp(Raster, Drawn[Change - 1], SNIP_BYTES) != 0)
+        {
+            fprintf(stderr, "journal budget %zu: undoing change %u doesn't put the raster back\n", JournalBudget, Change);
+
+            gTestFailures++;
+        }
+
+        CHECK(Document.Journal.Bytes <= JournalBudget);
+    }
+
+    CHECK(UndoDocumentStep(&Document, &Damage) == FALSE);
+
+    CHECK_EQUAL(0, Document.Count);
+
+    CHECK(memcmp(Raster, Document.Base, SNIP_BYTES) == 0);
+
+    CHECK(IsRedrawnTheSame(&Document));
+
+    for (UINT32 Change = 1; Change <= Changes; Change++)
+    {
+        CHECK(RedoDocumentStep(&Document, &Damage));
+
+        if (memcmp(Raster, Drawn[Change], SNIP_BYTES) != 0)
+        {
+            fprintf(stderr, "journal budget %zu: redoing change %u doesn't draw it again the same\n", JournalBudget, Change);
+
+            gTestFailures++;
+        }
+    }
+
+    CHECK(RedoDocumentStep(&Document, &Damage) == FALSE);
+
+    CHECK(IsRedrawnTheSame(&Document));
+
+    // Anything new throws away what was undone.
+    CHECK(UndoDocumentStep(&Document, &Damage));
+
+    CHECK_EQUAL(1, Document.RedoCount);
+
+    BeginDocumentStep(&Document);
+
+    AddRandomShape(&Document);
+
+    CHECK_EQUAL(0, Document.RedoCount);
+
+    FreeDocument(&Document);
+
+    for (UINT32 Change = 0; Change <= Changes; Change++)
+    {
+        free(Drawn[Change]);
+    }
+
+    free(Raster);
+
+    free(Source);
+}
+
+
+// Changes, undoes and redoes in a random order, and checks after each that the raster is what the list says.
+static void TestRandomOrder(SIZE_T JournalBudget)
+{
+    UINT32* Raster = malloc(SNIP_BYTES);
+
+    UINT32* Source = malloc(SNIP_BYTES);
+
+    DOCUMENT Document;
+
+    RECT Damage;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)SNIP_WIDTH * SNIP_HEIGHT; Index++)
+    {
+        Raster[Index] = ((Index / 53) % 2 == 0) ? 0xFF2060A0 : 0xFF000000 | (UINT32)(Index * 2246822519u >> 8);
+
+        Source[Index] = 0xFF000000 | (UINT32)(Index * 40503u);
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, SNIP_WIDTH, SNIP_HEIGHT, JournalBudget, NULL, NULL));
+
+    for (UINT32 Operation = 0; Operation < 300; Operation++)
+    {
+        UINT32 Choice = TestRandom() % 10;
+
+        if (Choice < 5)
+        {
+            AddRandomChange(&Document, Source);
+        }
+        else if (Choice < 8)
+        {
+            UndoDocumentStep(&Document, &Damage);
+        }
+        else
+        {
+            RedoDocumentStep(&Document, &Damage);
+        }
+
+        if (IsRedrawnTheSame(&Document) == FALSE)
+        {
+            fprintf(stderr, "journal budget %zu: the raster isn't what the list draws after operation %u\n", JournalBudget, Operation);
+
+            gTestFailures++;
+
+            break;
+        }
+    }
+
+    while (UndoDocumentStep(&Document, &Damage))
+    {
+    }
+
+    CHECK(memcmp(Raster, Document.Base, SNIP_BYTES) == 0);
+
+    FreeDocument(&Document);
+
+    free(Raster);
+
+    free(Source);
+}
+
+
+// Erases across a snip that has been drawn all over, and checks that the snip is back exactly as it was taken
+// everywhere under a square brush, and untouched everywhere else.
+static void TestEraser(void)
+{
+    UINT32* Raster = malloc(SNIP_BYTES);
+
+    UINT32* Drawn = malloc(SNIP_BYTES);
+
+    DOCUMENT Document;
+
+    RECT Damage;
+
+    RECT Erased = { 40, 100, 0, 0 };
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)SNIP_WIDTH * SNIP_HEIGHT; Index++)
+    {
+        Raster[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, SNIP_WIDTH, SNIP_HEIGHT, (SIZE_T)1 << 30, NULL, NULL));
+
+    for (UINT32 Change = 0; Change < 20; Change++)
+    {
+        AddRandomChange(&Document, NULL);
+    }
+
+    memcpy(Drawn, Raster, SNIP_BYTES);
+
+    BeginDocumentStep(&Document);
+
+    POINT Point = { Erased.left, Erased.top };
+
+    ANNOTATION* Stroke = BeginStroke(&Document, ANNOTATION_ERASE, Point, BRUSHTIP_SQUARE, 20, 30, 0, BLENDMODE_SRGB);
+
+    for (Point.x = Erased.left; Point.x <= 250; Point.x += 37)
+    {
+        CHECK(AddStrokePoint(&Document, Stroke, Point, NULL, &Damage));
+    }
+
+    CHECK(EndStroke(&Document, Stroke, NULL));
+
+    Erased.right = Point.x - 37 + 20;
+
+    Erased.bottom = Erased.top + 30;
+
+    for (INT32 Y = 0; Y < SNIP_HEIGHT; Y++)
+    {
+        for (INT32 X = 0; X < SNIP_WIDTH; X++)
+        {
+            SIZE_T Index = (SIZE_T)Y * SNIP_WIDTH + X;
+
+            BOOL Under = (X >= Erased.left && X < Erased.right && Y >= Erased.top && Y < Erased.bottom);
+
+            UINT32 Expected = Under ? Document.Base[Index] : Drawn[Index];
+
+            if (Raster[Index] != Expected)
+            {
+                fprintf(stderr, "after erasing, pixel %d,%d is %08X, not %08X\n", X, Y, Raster[Index], Expected);
+
+                gTestFailures++;
+
+                goto Exit;
+            }
+        }
+    }
+
+    CHECK(IsRedrawnTheSame(&Document));
+
+    CHECK(UndoDocumentStep(&Document, &Damage));
+
+    CHECK(memcmp(Raster, Drawn, SNIP_BYTES) == 0);
+
+Exit:
+    FreeDocument(&Document);
+
+    free(Raster);
+
+    free(Drawn);
+}
+
+
+// Checks that the strips a spotlight dims cover every pixel of an area outside of its rectangle exactly once
+// and nothing inside it, and that dimming them is the same as dimming each of those pixels on its own.
+static void TestSpotlight(void)
+{
+    enum { Size = 60 };
+
+    static UINT8 Count[Size][Size];
+
+    static UINT32 Expected[Size * Size];
+
+    static UINT32 Actual[Size * Size];
+
+    for (UINT32 Trial = 0; Trial < 20000; Trial++)
+    {
+        ANNOTATION Spotlight = { 0 };
+
+        RECT Area = { TestRandomRange(0, 40), TestRandomRange(0, 40), 0, 0 };
+
+        RECT Strips[4];
+
+        Spotlight.Type = ANNOTATION_SPOTLIGHT;
+
+        Spotlight.Color = 0x99000000;
+
+        Spotlight.BlendMode = (Trial % 2) ? BLENDMODE_LINEAR : BLENDMODE_SRGB;
+
+        // Dragged either way, and partly off of the area.
+        Spotlight.Start.x = TestRandomRange(-10, 49);
+
+        Spotlight.Start.y = TestRandomRange(-10, 49);
+
+        Spotlight.End.x = TestRandomRange(-10, 49);
+
+        Spotlight.End.y = TestRandomRange(-10, 49);
+
+        Area.right = Area.left + TestRandomRange(0, 19);
+
+        Area.bottom = Area.top + TestRandomRange(0, 19);
+
+        UINT32 StripCount = GetSpotlightStrips(&Spotlight, &Area, Strips);
+
+        CHECK(StripCount <= 4);
+
+        memset(Count, 0, sizeof(Count));
+
+        for (UINT32 Strip = 0; Strip < StripCount; Strip++)
+        {
+            CHECK(IsRectEmpty(&Strips[Strip]) == FALSE);
+
+            for (INT32 Y = Strips[Strip].top; Y < Strips[Strip].bottom; Y++)
+            {
+                for (INT32 X = Strips[Strip].left; X < Strips[Strip].right; X++)
+                {
+                    Count[Y][X]++;
+                }
+            }
+        }
+
+        for (INT32 Index = 0; Index < Size * Size; Index++)
+        {
+            Expected[Index] = (TestRandom() << 16) ^ TestRandom();
+        }
+
+        memcpy(Actual, Expected, sizeof(Actual));
+
+        for (INT32 Y = 0; Y < Size; Y++)
+        {
+            for (INT32 X = 0; X < Size; X++)
+            {
+                BOOL InArea = (X >= Area.left && X < Area.right && Y >= Area.top && Y < Area.bottom);
+
+                BOOL Inside = (X >= min(Spotlight.Start.x, Spotlight.End.x) && X <= max(Spotlight.Start.x, Spotlight.End.x) && Y >= min(Spotlight.Start.y, Spotlight.End.y) && Y <= max(Spotlight.Start.y, Spotlight.End.y));
+
+                if (Count[Y][X] != (InArea && Inside == FALSE))
+                {
+                    fprintf(stderr, "spotlight %d,%d-%d,%d over %d,%d-%d,%d covers pixel %d,%d %u times\n", Spotlight.Start.x, Spotlight.Start.y, Spotlight.End.x, Spotlight.End.y, Area.left, Area.top, Area.right, Area.bottom, X, Y, Count[Y][X]);
+
+                    gTestFailures++;
+
+                    return;
+                }
+
+                if (Count[Y][X])
+                {
+                    RECT Pixel = { X, Y, X + 1, Y + 1 };
+
+                    BlendRectScalar(Expected, Size, &Pixel, 0xFF000000, 0x99, Spotlight.BlendMode);
+                }
+            }
+        }
+
+        if (IsRectEmpty(&Area) == FALSE)
+        {
+            RASTERTARGET Target = { &Actual[Area.top * Size + Area.left], Size, Area, NULL };
+
+            DrawSpotlight(&Target, &Spotlight);
+        }
+
+        if (memcmp(Expected, Actual, sizeof(Actual)) != 0)
+        {
+            fprintf(stderr, "spotlight %d,%d-%d,%d drawn over %d,%d-%d,%d isn't dimmed pixel by pixel\n", Spotlight.Start.x, Spotlight.Start.y, Spotlight.End.x, Spotlight.End.y, Area.left, Area.top, Area.right, Area.bottom);
+
+            gTestFailures++;
+
+            return;
+        }
+    }
+}
+
+
+// How many bytes the heap has handed out and not been given back, or 0 if there's no way to tell.
+static SIZE_T GetHeapBytes(void)
+{
+#ifdef __GLIBC__
+    struct mallinfo2 Info = mallinfo2();
+
+    return Info.uordblks + Info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+
+// Puts thousands of random changes on a screen-sized snip and reports the memory they hold, then how long it takes
+// to add one more, to undo one, and to redraw a piece of the snip under all of them.
+static void BenchManyAnnotations(void)
+{
+    enum { Width = 1920, Height = 1080, Changes = 3000, Trials = 50, Piece = 256 };
+
+    UINT32* Raster = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    DOCUMENT Document;
+
+    RECT Damage;
+
+    SIZE_T JournalBytes;
+
+    UINT64 FileBytes;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Raster[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    SIZE_T Before = GetHeapBytes();
+
+    CHECK(InitializeDocument(&Document, Raster, Width, Height, 256 * 1024 * 1024, NULL, NULL));
+
+    SIZE_T Empty = GetHeapBytes();
+
+    for (UINT32 Change = 0; Change < Changes; Change++)
+    {
+        AddRandomChange(&Document, NULL);
+    }
+
+    SIZE_T Full = GetHeapBytes();
+
+    GetJournalUsage(&Document.Journal, &JournalBytes, &FileBytes);
+
+    printf("%u annotations on %d x %d: document %zu KB empty, %zu KB full, %zu KB of it undo tiles, %zu bytes per annotation without them\n",
+        Document.Count, Width, Height, (Empty - Before) / 1024, (Full - Before) / 1024, JournalBytes / 1024, (Full - Empty - min(JournalBytes, Full - Empty)) / max(Document.Count, 1));
+
+    double Start = TestSeconds();
+
+    for (UINT32 Trial = 0; Trial < Trials; Trial++)
+    {
+        AddRandomChange(&Document, NULL);
+    }
+
+    double Add = (TestSeconds() - Start) / Trials;
+
+    Start = TestSeconds();
+
+    for (UINT32 Trial = 0; Trial < Trials; Trial++)
+    {
+        CHECK(UndoDocumentStep(&Document, &Damage));
+    }
+
+    double Undo = (TestSeconds() - Start) / Trials;
+
+    Start = TestSeconds();
+
+    for (UINT32 Trial = 0; Trial < Trials; Trial++)
+    {
+        RECT Area = { TestRandomRange(0, Width - Piece), TestRandomRange(0, Height - Piece), 0, 0 };
+
+        Area.right = Area.left + Piece;
+
+        Area.bottom = Area.top + Piece;
+
+        RedrawDocument(&Document, &Area);
+    }
+
+    double Redraw = (TestSeconds() - Start) / Trials;
+
+    printf("with %u annotations: add %7.3f ms, undo %7.3f ms, redraw of %d x %d %7.3f ms\n", Document.Count, Add * 1000.0, Undo * 1000.0, Piece, Piece, Redraw * 1000.0);
+
+    CHECK(IsRedrawnTheSame(&Document));
+
+    FreeDocument(&Document);
+
+    free(Raster);
+}
+
+
+// Times the mouse moves of an eraser stroke with a 32 x 32 brush. What each one costs should only depend on the
+// brush, so it should come out the same however big the snip is.
+static void BenchEraser(INT32 Width, INT32 Height)
+{
+    enum { Events = 4000, Brush = 32, Step = 4 };
+
+    UINT32* Raster = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    DOCUMENT Document;
+
+    RECT Damage;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Raster[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, Width, Height, 256 * 1024 * 1024, NULL, NULL));
+
+    // The same path on every snip, over the middle SNIP_WIDTH x SNIP_HEIGHT of it: back and forth, moving down a
+    // little at each end.
+    INT32 Left = (Width - SNIP_WIDTH) / 2;
+
+    INT32 Top = (Height - SNIP_HEIGHT) / 2;
+
+    BeginDocumentStep(&Document);
+
+    POINT Point = { Left, Top };
+
+    ANNOTATION* Stroke = BeginStroke(&Document, ANNOTATION_ERASE, Point, BRUSHTIP_SQUARE, Brush, Brush, 0, BLENDMODE_SRGB);
+
+    CHECK(Stroke != NULL);
+
+    double Start = TestSeconds();
+
+    for (UINT32 Event = 0; Stroke != NULL && Event < Events; Event++)
+    {
+        INT32 Across = (INT32)(Event * Step) % (2 * (SNIP_WIDTH - Brush));
+
+        Point.x = Left + ((Across < SNIP_WIDTH - Brush) ? Across : 2 * (SNIP_WIDTH - Brush) - Across);
+
+        Point.y = Top + (INT32)(Event * Step / (SNIP_WIDTH - Brush)) % (SNIP_HEIGHT - Brush);
+
+        CHECK(AddStrokePoint(&Document, Stroke, Point, NULL, &Damage));
+    }
+
+    double Seconds = TestSeconds() - Start;
+
+    if (Stroke != NULL)
+    {
+        EndStroke(&Document, Stroke, NULL);
+    }
+
+    printf("eraser %d x %d brush on %5d x %-5d (%5.1f MP): %6.0f ns per mouse move\n", Brush, Brush, Width, Height, (double)Width * Height / 1e6, Seconds * 1e9 / Events);
+
+    FreeDocument(&Document);
+
+    free(Raster);
+}
+
+
+int main(void)
+{
+    InitializeBlendTables();
+
+    // With room for every tile, some of them, and none, so that undo both copies tiles back and redraws.
+    TestUndoRedo((SIZE_T)1 << 30);
+
+    TestUndoRedo(256 * 1024);
+
+    TestUndoRedo(0);
+
+    TestRandomOrder((SIZE_T)1 << 30);
+
+    TestEraser();
+
+    TestSpotlight();
+
+    TestRandomOrder(64 * 1024);
+
+    BenchManyAnnotations();
+
+    BenchEraser(SNIP_WIDTH, SNIP_HEIGHT);
+
+    BenchEraser(12288, 8192);
+
+    return TestResult();
+}
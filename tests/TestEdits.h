@@ -0,0 +1,206 @@
+// TestEdits.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Makes random changes to a document the way someone using SnipEx would: boxes and arrows, hilight, redact and
+// eraser strokes, pen strokes, filled and redacted regions, spotlights and callouts, each as a step of its own.
+// Text isn't made, since drawing it needs the platform's fonts.
+// Needs SnipExDocument.h and Test.h to be included first.
+
+#pragma once
+
+// If set, called when a change has added one annotation and is about to add another, such as a copy of a redact
+// stroke, so that a test can look at the document as it was part way through the change.
+static void (*gOnPartOfChange)(DOCUMENT* Document);
+
+
+static void AddRandomBrushStroke(DOCUMENT* Document, const UINT32* Source)
+{
+    static const ANNOTATIONTYPE Types[] = { ANNOTATION_HILIGHT, ANNOTATION_REDACT, ANNOTATION_ERASE };
+
+    ANNOTATIONTYPE Type = Types[TestRandom() % _countof(Types)];
+
+    // Half of the redact strokes black out and half copy from the pixelated or blurred copy.
+    const UINT32* StrokeSource = (Type == ANNOTATION_REDACT && TestRandom() % 2) ? Source : NULL;
+
+    POINT Point = { TestRandomRange(-20, Document->Width + 20), TestRandomRange(-20, Document->Height + 20) };
+
+    ANNOTATION* Stroke = BeginStroke(
+        Document,
+        Type,
+        Point,
+        (BRUSHTIP)(TestRandom() % 3),
+        TestRandomRange(4, 34),
+        TestRandomRange(4, 44),
+        (Type == ANNOTATION_HILIGHT) ? HILIGHT_YELLOW : 0xFF000000,
+        (TestRandom() % 2) ? BLENDMODE_LINEAR : BLENDMODE_SRGB);
+
+    CHECK(Stroke != NULL);
+
+    for (INT32 Move = TestRandomRange(1, 9); Move > 0; Move--)
+    {
+        RECT Damage;
+
+        Point.x += TestRandomRange(-40, 40);
+
+        Point.y += (TestRandom() % 3 == 0) ? TestRandomRange(-10, 10) : 0;
+
+        CHECK(AddStrokePoint(Document, Stroke, Point, StrokeSource, &Damage));
+    }
+
+    // A stroke that never touched the snip is taken off again, and can't be copied.
+    if (EndStroke(Document, Stroke, StrokeSource) && Type == ANNOTATION_REDACT && TestRandom() % 2)
+    {
+        if (gOnPartOfChange != NULL)
+        {
+            gOnPartOfChange(Document);
+        }
+
+        CHECK(AddTranslatedStroke(Document, Stroke, TestRandomRange(-50, 50), TestRandomRange(-50, 50), StrokeSource) != NULL);
+    }
+}
+
+
+static void AddRandomPenStroke(DOCUMENT* Document)
+{
+    RECT Damage;
+
+    RASTERPOINT Point = { (float)TestRandomRange(0, Document->Width - 1), (float)TestRandomRange(0, Document->Height - 1) };
+
+    ANNOTATION* Stroke = BeginPenStroke(Document, Point, TestRandomRange(1, 6), 0xFFFF0000, BLENDMODE_SRGB, &Damage);
+
+    CHECK(Stroke != NULL);
+
+    for (UINT32 Move = 0; Move < 10; Move++)
+    {
+        Point.X += (float)TestRandomRange(-10, 10) + 0.25f;
+
+        Point.Y += (float)TestRandomRange(-10, 10) + 0.5f;
+
+        CHECK(AddPenPoint(Document, Stroke, Point, &Damage));
+    }
+
+    EndPenStroke(Document, Stroke, PEN_SIMPLIFY_TOLERANCE, &Damage);
+}
+
+
+static void AddRandomRegion(DOCUMENT* Document, const UINT32* Source)
+{
+    FLOODREGION Region;
+
+    CHECK(FloodFillRegion(Document->Raster, Document->Width, Document->Height, TestRandomRange(0, Document->Width - 1), TestRandomRange(0, Document->Height - 1), (UINT8)TestRandomRange(0, 120), TestRandom() % 2, &Region));
+
+    CHECK(AddRegionAnnotation(Document, &Region, 0xFF0000FF, (TestRandom() % 2) ? Source : NULL) != NULL);
+
+    FreeFloodRegion(&Region);
+}
+
+
+static void AddRandomShape(DOCUMENT* Document)
+{
+    ANNOTATION Shape = { 0 };
+
+    Shape.Start.x = TestRandomRange(0, Document->Width - 1);
+
+    Shape.Start.y = TestRandomRange(0, Document->Height - 1);
+
+    Shape.End.x = TestRandomRange(0, Document->Width - 1);
+
+    Shape.End.y = TestRandomRange(0, Document->Height - 1);
+
+    Shape.Color = 0xFF00FF00;
+
+    Shape.PenWidth = 2;
+
+    Shape.BlendMode = (TestRandom() % 2) ? BLENDMODE_LINEAR : BLENDMODE_SRGB;
+
+    switch (TestRandom() % 4)
+    {
+        case 0:
+        case 1:
+        {
+            Shape.Type = (TestRandom() % 2) ? ANNOTATION_BOX : ANNOTATION_ARROW;
+
+            GetBoxOrArrowBounds(&Shape, &Shape.Bounds);
+
+            CHECK(AddAnnotation(Document, &Shape) != NULL);
+
+            break;
+        }
+        case 2:
+        {
+            Shape.Type = ANNOTATION_SPOTLIGHT;
+
+            Shape.Color = 0x99000000;
+
+            SetRect(&Shape.Bounds, 0, 0, Document->Width, Document->Height);
+
+            CHECK(AddAnnotation(Document, &Shape) != NULL);
+
+            break;
+        }
+        default:
+        {
+            RECT Source;
+
+            Shape.Type = ANNOTATION_CALLOUT;
+
+            Shape.End.x = Shape.Start.x + TestRandomRange(2, 30);
+
+            Shape.End.y = Shape.Start.y + TestRandomRange(2, 20);
+
+            // Somewhere that the magnified copy fits, or nothing.
+            if (GetCalloutSource(Shape.Start, Shape.End, Document->Width, Document->Height, &Source) && GetCalloutInset(&Source, TestRandomRange(CALLOUT_MIN_ZOOM, 5), Document->Width, Document->Height, &Shape.Inset))
+            {
+                Shape.Start.x = Source.left;
+
+                Shape.Start.y = Source.top;
+
+                Shape.End.x = Source.right - 1;
+
+                Shape.End.y = Source.bottom - 1;
+
+                GetCalloutBounds(&Shape, &Shape.Bounds);
+
+                CHECK(AddCalloutAnnotation(Document, &Shape) != NULL);
+            }
+
+            break;
+        }
+    }
+}
+
+
+// Adds one random change to Document as a step of its own. Source is the pixelated or blurred copy of the
+// raster that redacting copies from.
+static void AddRandomChange(DOCUMENT* Document, const UINT32* Source)
+{
+    BeginDocumentStep(Document);
+
+    switch (TestRandom() % 6)
+    {
+        case 0:
+        case 1:
+        {
+            AddRandomBrushStroke(Document, Source);
+
+            break;
+        }
+        case 2:
+        {
+            AddRandomPenStroke(Document);
+
+            break;
+        }
+        case 3:
+        {
+            AddRandomRegion(Document, Source);
+
+            break;
+        }
+        default:
+        {
+            AddRandomShape(Document);
+
+            break;
+        }
+    }
+}
@@ -0,0 +1,279 @@
+// TestFilter.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks pixelate and blur against averages worked out one pixel at a time, on images big enough to be split
+// between threads, and times them at every size from 2 to 64 on a snip of two 4K monitors side by side, to show
+// that the time doesn't grow with the size.
+
+#include <windows.h>
+
+#include "SnipExBlend.h"
+
+#include "SnipExFilter.h"
+
+#include "Test.h"
+
+
+// Whether every channel of A and B is within Tolerance of each other. The filters average in float, so they can
+// round the other way from an average worked out exactly.
+static BOOL IsClose(UINT32 A, UINT32 B, INT32 Tolerance)
+{
+    for (UINT32 Shift = 0; Shift < 32; Shift += 8)
+    {
+        if (abs((INT32)((A >> Shift) & 0xFF) - (INT32)((B >> Shift) & 0xFF)) > Tolerance)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+static UINT32* RandomImage(INT32 Width, INT32 Height)
+{
+    UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Pixels[Index] = (TestRandom() << 16) ^ TestRandom();
+    }
+
+    return Pixels;
+}
+
+
+static void TestPixelate(INT32 Width, INT32 Height, INT32 BlockSize)
+{
+    UINT32* Source = RandomImage(Width, Height);
+
+    UINT32* Destination = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    PixelateImage(Source, Destination, Width, Height, BlockSize);
+
+    for (INT32 Top = 0; Top < Height; Top += BlockSize)
+    {
+        for (INT32 Left = 0; Left < Width; Left += BlockSize)
+        {
+            INT32 Right = min(Left + BlockSize, Width);
+
+            INT32 Bottom = min(Top + BlockSize, Height);
+
+            double Sums[4] = { 0 };
+
+            UINT32 Average = 0;
+
+            for (INT32 Y = Top; Y < Bottom; Y++)
+            {
+                for (INT32 X = Left; X < Right; X++)
+                {
+                    for (UINT32 Channel = 0; Channel < 4; Channel++)
+                    {
+                        Sums[Channel] += (Source[(SIZE_T)Y * Width + X] >> (Channel * 8)) & 0xFF;
+                    }
+                }
+            }
+
+            for (UINT32 Channel = 0; Channel < 4; Channel++)
+            {
+                Average |= (UINT32)(Sums[Channel] / ((Bottom - Top) * (Right - Left)) + 0.5) << (Channel * 8);
+            }
+
+            for (INT32 Y = Top; Y < Bottom; Y++)
+            {
+                for (INT32 X = Left; X < Right; X++)
+                {
+                    if (IsClose(Destination[(SIZE_T)Y * Width + X], Average, 1) == FALSE)
+                    {
+                        fprintf(stderr, "%d x %d pixelated with %d pixel blocks: pixel %d,%d is %08X, not %08X\n", Width, Height, BlockSize, X, Y, Destination[(SIZE_T)Y * Width + X], Average);
+
+                        gTestFailures++;
+
+                        goto Exit;
+                    }
+                }
+            }
+        }
+    }
+
+    // Pixelating in place gives the same mosaic.
+    PixelateImage(Source, Source, Width, Height, BlockSize);
+
+    CHECK(memcmp(Source, Destination, (SIZE_T)Width * Height * sizeof(UINT32)) == 0);
+
+Exit:
+    free(Source);
+
+    free(Destination);
+}
+
+
+static void TestBoxBlurLine(void)
+{
+    UINT32 Source[100];
+
+    UINT32 Destination[100];
+
+    for (INT32 Count = 1; Count <= 50; Count++)
+    {
+        for (INT32 Radius = 0; Radius <= 60; Radius += 1 + Radius / 4)
+        {
+            for (INT32 Index = 0; Index < Count * 2; Index++)
+            {
+                Source[Index] = (TestRandom() << 16) ^ TestRandom();
+            }
+
+            // Every other pixel, to check Stride.
+            BoxBlurLine(Source, Destination, Count, 2, Radius);
+
+            for (INT32 Index = 0; Index < Count; Index++)
+            {
+                UINT32 Average = 0;
+
+                for (UINT32 Channel = 0; Channel < 4; Channel++)
+                {
+                    double Sum = 0;
+
+                    for (INT32 Offset = -Radius; Offset <= Radius; Offset++)
+                    {
+                        Sum += (Source[2 * min(max(Index + Offset, 0), Count - 1)] >> (Channel * 8)) & 0xFF;
+                    }
+
+                    Average |= (UINT32)(Sum / (2 * Radius + 1) + 0.5) << (Channel * 8);
+                }
+
+                if (IsClose(Destination[2 * Index], Average, 1) == FALSE)
+                {
+                    fprintf(stderr, "BoxBlurLine of %d pixels with radius %d: pixel %d is %08X, not %08X\n", Count, Radius, Index, Destination[2 * Index], Average);
+
+                    gTestFailures++;
+
+                    return;
+                }
+            }
+        }
+    }
+}
+
+
+static void TestBlur(INT32 Width, INT32 Height, INT32 Radius)
+{
+    UINT32* Source = RandomImage(Width, Height);
+
+    UINT32* Expected = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32* Temp = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32* Actual = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    // BlurImage promises exactly what three passes of BoxBlurLine along every row and then every column give.
+    memcpy(Expected, Source, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    for (UINT32 Pass = 0; Pass < 6; Pass++)
+    {
+        BOOL Rows = (Pass < 3);
+
+        for (INT32 Line = 0; Line < (Rows ? Height : Width); Line++)
+        {
+            SIZE_T First = Rows ? (SIZE_T)Line * Width : (SIZE_T)Line;
+
+            BoxBlurLine(&Expected[First], &Temp[First], Rows ? Width : Height, Rows ? 1 : (SIZE_T)Width, Radius);
+        }
+
+        memcpy(Expected, Temp, (SIZE_T)Width * Height * sizeof(UINT32));
+    }
+
+    double Start = TestSeconds();
+
+    CHECK(BlurImage(Source, Actual, Width, Height, Radius));
+
+    double Seconds = TestSeconds() - Start;
+
+    if (memcmp(Expected, Actual, (SIZE_T)Width * Height * sizeof(UINT32)) != 0)
+    {
+        fprintf(stderr, "BlurImage of %d x %d with radius %d differs from BoxBlurLine\n", Width, Height, Radius);
+
+        gTestFailures++;
+    }
+
+    if ((SIZE_T)Width * Height >= FILTER_MIN_PIXELS_PER_THREAD)
+    {
+        printf("BlurImage %5d x %-5d radius %-3d %8.3f ms\n", Width, Height, Radius, Seconds * 1000.0);
+    }
+
+    free(Source);
+
+    free(Expected);
+
+    free(Temp);
+
+    free(Actual);
+}
+
+
+static void BenchFilters(void)
+{
+    enum { Width = 7680, Height = 2160 };
+
+    UINT32* Source = RandomImage(Width, Height);
+
+    UINT32* Destination = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    // Touches every page of Destination first, so that the first run isn't the only one to pay for them.
+    memset(Destination, 0, (SIZE_T)Width * Height * sizeof(UINT32));
+
+    for (INT32 Size = 2; Size <= 64; Size *= 2)
+    {
+        double Start = TestSeconds();
+
+        CHECK(BlurImage(Source, Destination, Width, Height, Size));
+
+        double Blur = TestSeconds() - Start;
+
+        Start = TestSeconds();
+
+        PixelateImage(Source, Destination, Width, Height, Size);
+
+        double Pixelate = TestSeconds() - Start;
+
+        printf("%d x %d, radius or block size %-2d  BlurImage %8.3f ms  PixelateImage %8.3f ms\n", Width, Height, Size, Blur * 1000.0, Pixelate * 1000.0);
+    }
+
+    free(Destination);
+
+    free(Source);
+}
+
+
+int main(void)
+{
+    // Pretend to have 4 processors, so that the big images are split between threads even on a machine with one.
+    setenv("SNIPEX_TEST_CPUS", "4", 1);
+
+    InitializeBlendTables();
+
+    TestPixelate(1, 1, 1);
+
+    TestPixelate(37, 23, 1);
+
+    TestPixelate(37, 23, 8);
+
+    TestPixelate(100, 60, FILTER_MAX_BLOCK_SIZE);
+
+    TestPixelate(1283, 719, 16);
+
+    TestBoxBlurLine();
+
+    TestBlur(1, 1, 3);
+
+    TestBlur(37, 23, 0);
+
+    TestBlur(37, 23, 5);
+
+    TestBlur(20, 90, 40);
+
+    TestBlur(1283, 719, 8);
+
+    BenchFilters();
+
+    return TestResult();
+}
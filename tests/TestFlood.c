@@ -0,0 +1,338 @@
+// TestFlood.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks the color matching kernel against the scalar one, and that the span flood fill finds exactly the pixels
+// that a plain one-pixel-at-a-time fill finds, including on mazes and combs with far more branches than it keeps
+// waiting at once, and times it.
+
+#include <windows.h>
+
+#include "SnipExStroke.h"
+
+#include "SnipExFlood.h"
+
+#include "Test.h"
+
+#define WHITE 0xFFFFFFFF
+
+#define BLACK 0xFF000000
+
+
+static void TestMatchColorRow(void)
+{
+    UINT32 Pixels[300];
+
+    UINT64 Expected[8];
+
+    UINT64 Actual[8];
+
+    for (UINT32 Trial = 0; Trial < 3000; Trial++)
+    {
+        UINT32 Color = (TestRandom() << 16) ^ TestRandom();
+
+        UINT8 Tolerance = (UINT8)TestRandomRange(0, 64);
+
+        UINT32 Offset = TestRandom() % 4;
+
+        UINT32 Count = (UINT32)TestRandomRange(0, _countof(Pixels) - 4);
+
+        for (UINT32 Index = 0; Index < _countof(Pixels); Index++)
+        {
+            // One channel off by about the tolerance either way, and alpha, which doesn't count, flipped now and then.
+            UINT32 Shift = (TestRandom() % 3) * 8;
+
+            INT32 Channel = (INT32)((Color >> Shift) & 0xFF) + TestRandomRange(-Tolerance - 3, Tolerance + 3);
+
+            Pixels[Index] = (Color & ~(0xFFu << Shift)) | (UINT32)min(max(Channel, 0), 255) << Shift;
+
+            Pixels[Index] ^= (TestRandom() % 7 == 0) ? 0xFF000000 : 0;
+        }
+
+        // Every bit is written, including the ones past Count in the last word.
+        memset(Expected, 0xAB, sizeof(Expected));
+
+        memset(Actual, 0xCD, sizeof(Actual));
+
+        MatchColorRowScalar(&Pixels[Offset], Count, Color, Tolerance, Expected);
+
+        MatchColorRow(&Pixels[Offset], Count, Color, Tolerance, Actual);
+
+        if (memcmp(Expected, Actual, (Count + 63) / 64 * sizeof(UINT64)) != 0)
+        {
+            fprintf(stderr, "MatchColorRow of %u pixels at offset %u, tolerance %u, differs from MatchColorRowScalar\n", Count, Offset, Tolerance);
+
+            gTestFailures++;
+
+            return;
+        }
+    }
+}
+
+
+static BOOL IsWithin(UINT32 A, UINT32 B, INT32 Tolerance)
+{
+    for (UINT32 Shift = 0; Shift < 24; Shift += 8)
+    {
+        if (abs((INT32)((A >> Shift) & 0xFF) - (INT32)((B >> Shift) & 0xFF)) > Tolerance)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+// Fills from X, Y one pixel at a time, with a queue. Returns one byte for each pixel, 1 where it's in the region.
+static UINT8* FloodFillReference(const UINT32* Pixels, INT32 Width, INT32 Height, INT32 X, INT32 Y, INT32 Tolerance, BOOL Diagonal)
+{
+    UINT8* Filled = calloc((SIZE_T)Width * Height, 1);
+
+    SIZE_T* Queue = malloc((SIZE_T)Width * Height * sizeof(SIZE_T));
+
+    SIZE_T Head = 0;
+
+    SIZE_T Tail = 0;
+
+    UINT32 Color = Pixels[(SIZE_T)Y * Width + X];
+
+    Filled[(SIZE_T)Y * Width + X] = 1;
+
+    Queue[Tail++] = (SIZE_T)Y * Width + X;
+
+    while (Head < Tail)
+    {
+        INT32 PixelX = (INT32)(Queue[Head] % Width);
+
+        INT32 PixelY = (INT32)(Queue[Head] / Width);
+
+        Head++;
+
+        for (INT32 DY = -1; DY <= 1; DY++)
+        {
+            for (INT32 DX = -1; DX <= 1; DX++)
+            {
+                INT32 NextX = PixelX + DX;
+
+                INT32 NextY = PixelY + DY;
+
+                if ((DX == 0 && DY == 0) || (Diagonal == FALSE && DX != 0 && DY != 0) || NextX < 0 || NextY < 0 || NextX >= Width || NextY >= Height)
+                {
+                    continue;
+                }
+
+                SIZE_T Next = (SIZE_T)NextY * Width + NextX;
+
+                if (Filled[Next] == 0 && IsWithin(Pixels[Next], Color, Tolerance))
+                {
+                    Filled[Next] = 1;
+
+                    Queue[Tail++] = Next;
+                }
+            }
+        }
+    }
+
+    free(Queue);
+
+    return Filled;
+}
+
+
+static void CheckFill(const char* Name, const UINT32* Pixels, INT32 Width, INT32 Height, INT32 X, INT32 Y, INT32 Tolerance, BOOL Diagonal)
+{
+    FLOODREGION Region;
+
+    RECT Bounds = { Width, Height, 0, 0 };
+
+    UINT64 PixelCount = 0;
+
+    UINT8* Row = malloc((SIZE_T)Width);
+
+    double Start = TestSeconds();
+
+    CHECK(FloodFillRegion(Pixels, Width, Height, X, Y, (UINT8)Tolerance, Diagonal, &Region));
+
+    double Seconds = TestSeconds() - Start;
+
+    UINT8* Expected = FloodFillReference(Pixels, Width, Height, X, Y, Tolerance, Diagonal);
+
+    for (INT32 PixelY = 0; PixelY < Height; PixelY++)
+    {
+        SPAN Span;
+
+        INT32 Left = 0;
+
+        memset(Row, 0, (SIZE_T)Width);
+
+        // The spans of a row come in order, without overlapping.
+        while (GetNextRegionSpan(&Region, PixelY, Left, Width, &Span))
+        {
+            CHECK(Span.Y == PixelY && Span.Left >= Left && Span.Left < Span.Right && Span.Right <= Width);
+
+            memset(&Row[Span.Left], 1, (SIZE_T)(Span.Right - Span.Left));
+
+            Left = Span.Right;
+        }
+
+        if (memcmp(Row, &Expected[(SIZE_T)PixelY * Width], (SIZE_T)Width) != 0)
+        {
+            fprintf(stderr, "%s %d x %d from %d,%d: row %d isn't what a pixel by pixel fill finds\n", Name, Width, Height, X, Y, PixelY);
+
+            gTestFailures++;
+
+            break;
+        }
+
+        for (INT32 PixelX = 0; PixelX < Width; PixelX++)
+        {
+            if (Row[PixelX])
+            {
+                PixelCount++;
+
+                Bounds.left = min(Bounds.left, PixelX);
+
+                Bounds.top = min(Bounds.top, PixelY);
+
+                Bounds.right = max(Bounds.right, PixelX + 1);
+
+                Bounds.bottom = max(Bounds.bottom, PixelY + 1);
+            }
+        }
+    }
+
+    CHECK_EQUAL(PixelCount, Region.PixelCount);
+
+    CHECK(EqualRect(&Bounds, &Region.Bounds));
+
+    if ((SIZE_T)Width * Height >= 1000000)
+    {
+        printf("FloodFillRegion %-12s %5d x %-5d %s %8.2f ms, %llu pixels\n", Name, Width, Height, Diagonal ? "8-way" : "4-way", Seconds * 1000.0, (unsigned long long)Region.PixelCount);
+    }
+
+    FreeFloodRegion(&Region);
+
+    CHECK(Region.Bits == NULL);
+
+    free(Expected);
+
+    free(Row);
+}
+
+
+static void TestFloodFill(void)
+{
+    FLOODREGION Region;
+
+    // Outside of the image there's nothing to fill.
+    UINT32 Pixel = WHITE;
+
+    CHECK(FloodFillRegion(&Pixel, 1, 1, 1, 0, 0, FALSE, &Region) == FALSE);
+
+    CheckFill("one pixel", &Pixel, 1, 1, 0, 0, 0, FALSE);
+
+    // Noise with a few levels, so the tolerance decides where the region ends.
+    for (UINT32 Trial = 0; Trial < 12; Trial++)
+    {
+        INT32 Width = TestRandomRange(1, 340);
+
+        INT32 Height = TestRandomRange(1, 220);
+
+        UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+        for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+        {
+            Pixels[Index] = 0xFF808080 + (TestRandom() % 3) * 0x202020;
+        }
+
+        CheckFill("noise", Pixels, Width, Height, TestRandomRange(0, Width - 1), TestRandomRange(0, Height - 1), TestRandomRange(0, 40), Trial % 2);
+
+        free(Pixels);
+    }
+
+    enum { Size = 2000 };
+
+    UINT32* Pixels = malloc((SIZE_T)Size * Size * sizeof(UINT32));
+
+    // A comb: teeth every other column, joined along the top, which has a branch for every tooth.
+    for (INT32 Y = 0; Y < Size; Y++)
+    {
+        for (INT32 X = 0; X < Size; X++)
+        {
+            Pixels[(SIZE_T)Y * Size + X] = (Y == 0 || X % 2 == 0) ? WHITE : BLACK;
+        }
+    }
+
+    CheckFill("comb", Pixels, Size, Size, 0, 0, 0, FALSE);
+
+    free(Pixels);
+
+    // A comb wide enough to have more teeth than there's room for waiting runs, so that some are dropped and
+    // found again by the sweep.
+    enum { CombWidth = 4 * FLOOD_MAX_PENDING_SPANS, CombHeight = 40 };
+
+    Pixels = malloc((SIZE_T)CombWidth * CombHeight * sizeof(UINT32));
+
+    for (INT32 Y = 0; Y < CombHeight; Y++)
+    {
+        for (INT32 X = 0; X < CombWidth; X++)
+        {
+            Pixels[(SIZE_T)Y * CombWidth + X] = (Y == 0 || X % 2 == 0) ? WHITE : BLACK;
+        }
+    }
+
+    CheckFill("wide comb", Pixels, CombWidth, CombHeight, 0, 0, 0, FALSE);
+
+    free(Pixels);
+
+    Pixels = malloc((SIZE_T)Size * Size * sizeof(UINT32));
+
+    // A checkerboard, which is all one region diagonally and one pixel straight.
+    for (INT32 Y = 0; Y < Size; Y++)
+    {
+        for (INT32 X = 0; X < Size; X++)
+        {
+            Pixels[(SIZE_T)Y * Size + X] = ((X ^ Y) & 1) ? WHITE : BLACK;
+        }
+    }
+
+    CheckFill("checkerboard", Pixels, Size, Size, 0, 0, 0, TRUE);
+
+    CheckFill("checkerboard", Pixels, Size, Size, 0, 0, 0, FALSE);
+
+    // A corridor that winds back and forth across the whole image.
+    for (INT32 Y = 0; Y < Size; Y++)
+    {
+        for (INT32 X = 0; X < Size; X++)
+        {
+            BOOL Wall = (Y % 2 == 1) && (((Y / 2) % 2 == 0) ? X != Size - 1 : X != 0);
+
+            Pixels[(SIZE_T)Y * Size + X] = Wall ? BLACK : WHITE;
+        }
+    }
+
+    CheckFill("serpentine", Pixels, Size, Size, 0, 0, 0, FALSE);
+
+    // Random walls, just sparse enough that most of the open pixels join up, in thousands of twisty passages.
+    for (SIZE_T Index = 0; Index < (SIZE_T)Size * Size; Index++)
+    {
+        Pixels[Index] = (TestRandom() % 100 < 35) ? BLACK : WHITE;
+    }
+
+    Pixels[0] = Pixels[1] = Pixels[Size] = WHITE;
+
+    CheckFill("percolation", Pixels, Size, Size, 0, 0, 0, FALSE);
+
+    CheckFill("percolation", Pixels, Size, Size, 0, 0, 0, TRUE);
+
+    free(Pixels);
+}
+
+
+int main(void)
+{
+    TestMatchColorRow();
+
+    TestFloodFill();
+
+    return TestResult();
+}
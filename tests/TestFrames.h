@@ -0,0 +1,493 @@
+// TestFrames.h
+// Author: Joseph Ryan Ries, 2017-2020
+// Makes desktops for the tests to capture, and saves them the way the replay source reads them: as raw BGRA, or as
+// PNG. The PNG writer is only here so that the tests don't need a library to make their input. It can store the
+// image uncompressed, or compress it with the fixed Huffman codes and back references, which between them use most
+// of what SnipExPng.c has to decode.
+
+#pragma once
+
+#include <stdio.h>
+
+#include <stdlib.h>
+
+#include <string.h>
+
+typedef enum TESTPNGCOMPRESSION
+{
+    TESTPNG_STORED,
+
+    TESTPNG_FIXED
+
+} TESTPNGCOMPRESSION;
+
+typedef struct TESTBUFFER
+{
+    UINT8* Data;
+
+    size_t Size;
+
+    size_t Capacity;
+
+    // Bits that haven't made a whole byte yet, for the compressor.
+    UINT32 Bits;
+
+    UINT32 BitCount;
+
+} TESTBUFFER;
+
+
+static inline void AppendBytes(TESTBUFFER* Buffer, const void* Data, size_t Size)
+{
+    if (Size == 0)
+    {
+        return;
+    }
+
+    if (Buffer->Size + Size > Buffer->Capacity)
+    {
+        Buffer->Capacity = (Buffer->Size + Size) * 2;
+
+        Buffer->Data = realloc(Buffer->Data, Buffer->Capacity);
+    }
+
+    memcpy(&Buffer->Data[Buffer->Size], Data, Size);
+
+    Buffer->Size += Size;
+}
+
+
+static inline void AppendByte(TESTBUFFER* Buffer, UINT8 Byte)
+{
+    AppendBytes(Buffer, &Byte, 1);
+}
+
+
+static inline void AppendBigEndian(TESTBUFFER* Buffer, UINT32 Value)
+{
+    UINT8 Bytes[4] = { (UINT8)(Value >> 24), (UINT8)(Value >> 16), (UINT8)(Value >> 8), (UINT8)Value };
+
+    AppendBytes(Buffer, Bytes, sizeof(Bytes));
+}
+
+
+// Deflate's bits go in least significant first, except for Huffman codes, which go in most significant first.
+static inline void AppendBits(TESTBUFFER* Buffer, UINT32 Value, UINT32 Count)
+{
+    Buffer->Bits |= Value << Buffer->BitCount;
+
+    Buffer->BitCount += Count;
+
+    while (Buffer->BitCount >= 8)
+    {
+        AppendByte(Buffer, (UINT8)Buffer->Bits);
+
+        Buffer->Bits >>= 8;
+
+        Buffer->BitCount -= 8;
+    }
+}
+
+
+static inline void AppendCode(TESTBUFFER* Buffer, UINT32 Code, UINT32 Length)
+{
+    UINT32 Reversed = 0;
+
+    for (UINT32 Bit = 0; Bit < Length; Bit++)
+    {
+        Reversed |= ((Code >> Bit) & 1) << (Length - 1 - Bit);
+    }
+
+    AppendBits(Buffer, Reversed, Length);
+}
+
+
+static inline UINT32 TestCrc32(const UINT8* Data, size_t Size)
+{
+    UINT32 Crc = 0xFFFFFFFF;
+
+    for (size_t Index = 0; Index < Size; Index++)
+    {
+        Crc ^= Data[Index];
+
+        for (int Bit = 0; Bit < 8; Bit++)
+        {
+            Crc = (Crc >> 1) ^ (0xEDB88320 & (0 - (Crc & 1)));
+        }
+    }
+
+    return ~Crc;
+}
+
+
+static inline UINT32 TestAdler32(const UINT8* Data, size_t Size)
+{
+    UINT32 A = 1;
+
+    UINT32 B = 0;
+
+    for (size_t Index = 0; Index < Size; Index++)
+    {
+        A = (A + Data[Index]) % 65521;
+
+        B = (B + A) % 65521;
+    }
+
+    return (B << 16) | A;
+}
+
+
+// The fixed literal/length code of Symbol, from section 3.2.6 of RFC 1951.
+static inline void AppendFixedSymbol(TESTBUFFER* Buffer, UINT32 Symbol)
+{
+    if (Symbol < 144)
+    {
+        AppendCode(Buffer, 0x30 + Symbol, 8);
+    }
+    else if (Symbol < 256)
+    {
+        AppendCode(Buffer, 0x190 + Symbol - 144, 9);
+    }
+    else if (Symbol < 280)
+    {
+        AppendCode(Buffer, Symbol - 256, 7);
+    }
+    else
+    {
+        AppendCode(Buffer, 0xC0 + Symbol - 280, 8);
+    }
+}
+
+
+static inline void AppendFixedMatch(TESTBUFFER* Buffer, UINT32 Length, UINT32 Distance)
+{
+    static const UINT16 LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+    static const UINT8 LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+    static const UINT16 DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+    static const UINT8 DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    UINT32 Code = 28;
+
+    while (LengthBase[Code] > Length)
+    {
+        Code--;
+    }
+
+    AppendFixedSymbol(Buffer, 257 + Code);
+
+    AppendBits(Buffer, Length - LengthBase[Code], LengthExtra[Code]);
+
+    Code = 29;
+
+    while (DistanceBase[Code] > Distance)
+    {
+        Code--;
+    }
+
+    AppendCode(Buffer, Code, 5);
+
+    AppendBits(Buffer, Distance - DistanceBase[Code], DistanceExtra[Code]);
+}
+
+
+// Compresses Data into Buffer as a zlib stream.
+static inline void AppendZlib(TESTBUFFER* Buffer, const UINT8* Data, size_t Size, TESTPNGCOMPRESSION Compression)
+{
+    AppendByte(Buffer, 0x78);
+
+    AppendByte(Buffer, 0x01);
+
+    if (Compression == TESTPNG_STORED)
+    {
+        size_t Offset = 0;
+
+        do
+        {
+            size_t Length = (Size - Offset > 65535) ? 65535 : Size - Offset;
+
+            AppendByte(Buffer, (Offset + Length == Size) ? 1 : 0);
+
+            AppendByte(Buffer, (UINT8)Length);
+
+            AppendByte(Buffer, (UINT8)(Length >> 8));
+
+            AppendByte(Buffer, (UINT8)~Length);
+
+            AppendByte(Buffer, (UINT8)(~Length >> 8));
+
+            AppendBytes(Buffer, &Data[Offset], Length);
+
+            Offset += Length;
+
+        } while (Offset < Size);
+    }
+    else
+    {
+        // Greedy matching, with a hash of the next three bytes to find where they were last seen.
+        INT32* LastSeen = malloc(65536 * sizeof(INT32));
+
+        size_t Index = 0;
+
+        memset(LastSeen, 0xFF, 65536 * sizeof(INT32));
+
+        AppendBits(Buffer, 1, 1);
+
+        AppendBits(Buffer, 1, 2);
+
+        while (Index < Size)
+        {
+            UINT32 Length = 0;
+
+            size_t Candidate = 0;
+
+            if (Index + 3 <= Size)
+            {
+                UINT32 Hash = ((UINT32)Data[Index] * 506832829u ^ (UINT32)Data[Index + 1] * 2654435761u ^ Data[Index + 2]) & 0xFFFF;
+
+                if (LastSeen[Hash] >= 0 && Index - (size_t)LastSeen[Hash] <= 32768)
+                {
+                    Candidate = (size_t)LastSeen[Hash];
+
+                    while (Length < 258 && Index + Length < Size && Data[Candidate + Length] == Data[Index + Length])
+                    {
+                        Length++;
+                    }
+                }
+
+                LastSeen[Hash] = (INT32)Index;
+            }
+
+            if (Length >= 3)
+            {
+                AppendFixedMatch(Buffer, Length, (UINT32)(Index - Candidate));
+
+                Index += Length;
+            }
+            else
+            {
+                AppendFixedSymbol(Buffer, Data[Index]);
+
+                Index++;
+            }
+        }
+
+        AppendFixedSymbol(Buffer, 256);
+
+        AppendBits(Buffer, 0, 7);
+
+        free(LastSeen);
+    }
+
+    AppendBigEndian(Buffer, TestAdler32(Data, Size));
+}
+
+
+static inline void AppendChunk(TESTBUFFER* Buffer, const char* Type, const UINT8* Data, size_t Size)
+{
+    size_t Start = Buffer->Size + 4;
+
+    AppendBigEndian(Buffer, (UINT32)Size);
+
+    AppendBytes(Buffer, Type, 4);
+
+    AppendBytes(Buffer, Data, Size);
+
+    AppendBigEndian(Buffer, TestCrc32(&Buffer->Data[Start], Size + 4));
+}
+
+
+static inline UINT8 PaethPredictor(UINT8 Left, UINT8 Above, UINT8 AboveLeft)
+{
+    int Estimate = Left + Above - AboveLeft;
+
+    int ToLeft = abs(Estimate - Left);
+
+    int ToAbove = abs(Estimate - Above);
+
+    int ToAboveLeft = abs(Estimate - AboveLeft);
+
+    if (ToLeft <= ToAbove && ToLeft <= ToAboveLeft)
+    {
+        return Left;
+    }
+
+    return (ToAbove <= ToAboveLeft) ? Above : AboveLeft;
+}
+
+
+// Encodes Width x Height BGRA pixels as a PNG of ColorType 0 (gray, taken from green), 2 (RGB), 4 (gray and
+// alpha) or 6 (RGBA). Row Y uses filter Y % 5, so that every filter gets used. The caller frees the PNG.
+static inline UINT8* EncodeTestPng(const UINT32* Pixels, INT32 Width, INT32 Height, UINT8 ColorType, TESTPNGCOMPRESSION Compression, size_t* Size)
+{
+    static const UINT8 Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    size_t Channels = (ColorType == 0) ? 1 : (ColorType == 2) ? 3 : (ColorType == 4) ? 2 : 4;
+
+    size_t RowBytes = Channels * (size_t)Width;
+
+    UINT8* Raw = calloc((RowBytes + 1) * (size_t)Height, 1);
+
+    UINT8* Previous = calloc(RowBytes, 1);
+
+    UINT8* Current = malloc(RowBytes);
+
+    TESTBUFFER Png = { 0 };
+
+    TESTBUFFER Compressed = { 0 };
+
+    UINT8 Header[13] = { 0 };
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        UINT8* Filtered = &Raw[(RowBytes + 1) * (size_t)Y];
+
+        UINT8 Filter = (UINT8)(Y % 5);
+
+        for (INT32 X = 0; X < Width; X++)
+        {
+            UINT32 Pixel = Pixels[(size_t)Y * Width + X];
+
+            UINT8 Channel[4] = { (UINT8)(Pixel >> 16), (UINT8)(Pixel >> 8), (UINT8)Pixel, (UINT8)(Pixel >> 24) };
+
+            UINT8* Out = &Current[Channels * (size_t)X];
+
+            switch (ColorType)
+            {
+                case 0:  Out[0] = Channel[1];                                                               break;
+                case 2:  Out[0] = Channel[0]; Out[1] = Channel[1]; Out[2] = Channel[2];                     break;
+                case 4:  Out[0] = Channel[1]; Out[1] = Channel[3];                                          break;
+                default: Out[0] = Channel[0]; Out[1] = Channel[1]; Out[2] = Channel[2]; Out[3] = Channel[3]; break;
+            }
+        }
+
+        Filtered[0] = Filter;
+
+        for (size_t Byte = 0; Byte < RowBytes; Byte++)
+        {
+            UINT8 Left = (Byte >= Channels) ? Current[Byte - Channels] : 0;
+
+            UINT8 Above = (Y > 0) ? Previous[Byte] : 0;
+
+            UINT8 AboveLeft = (Y > 0 && Byte >= Channels) ? Previous[Byte - Channels] : 0;
+
+            UINT8 Prediction = 0;
+
+            switch (Filter)
+            {
+                case 1:  Prediction = Left;                                      break;
+                case 2:  Prediction = Above;                                     break;
+                case 3:  Prediction = (UINT8)((Left + Above) / 2);               break;
+                case 4:  Prediction = PaethPredictor(Left, Above, AboveLeft);    break;
+                default:                                                         break;
+            }
+
+            Filtered[1 + Byte] = (UINT8)(Current[Byte] - Prediction);
+        }
+
+        memcpy(Previous, Current, RowBytes);
+    }
+
+    Header[0] = (UINT8)(Width >> 24);
+
+    Header[1] = (UINT8)(Width >> 16);
+
+    Header[2] = (UINT8)(Width >> 8);
+
+    Header[3] = (UINT8)Width;
+
+    Header[4] = (UINT8)(Height >> 24);
+
+    Header[5] = (UINT8)(Height >> 16);
+
+    Header[6] = (UINT8)(Height >> 8);
+
+    Header[7] = (UINT8)Height;
+
+    Header[8] = 8;
+
+    Header[9] = ColorType;
+
+    AppendZlib(&Compressed, Raw, (RowBytes + 1) * (size_t)Height, Compression);
+
+    AppendBytes(&Png, Signature, sizeof(Signature));
+
+    AppendChunk(&Png, "IHDR", Header, sizeof(Header));
+
+    // Split the data over two IDAT chunks, since the decoder has to join them back up.
+    AppendChunk(&Png, "IDAT", Compressed.Data, Compressed.Size / 2);
+
+    AppendChunk(&Png, "IDAT", &Compressed.Data[Compressed.Size / 2], Compressed.Size - Compressed.Size / 2);
+
+    AppendChunk(&Png, "IEND", NULL, 0);
+
+    free(Compressed.Data);
+
+    free(Raw);
+
+    free(Previous);
+
+    free(Current);
+
+    *Size = Png.Size;
+
+    return Png.Data;
+}
+
+
+// Fills the Width x Height Pixels with something like a desktop: a gradient background with flat, bordered windows
+// on it, and some noise, so that it neither compresses to nothing nor is all noise. Seed picks which desktop.
+static inline void MakeTestDesktop(UINT32* Pixels, INT32 Width, INT32 Height, UINT32 Seed)
+{
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        for (INT32 X = 0; X < Width; X++)
+        {
+            Pixels[(size_t)Y * Width + X] = 0xFF000000 | (UINT32)((X * 255 / Width) << 16) | (UINT32)((Y * 255 / Height) << 8) | (Seed * 40 & 0xFF);
+        }
+    }
+
+    for (UINT32 Window = 0; Window < 6; Window++)
+    {
+        UINT32 Hash = (Seed + 1) * 2654435761u * (Window + 1);
+
+        INT32 Left = (INT32)(Hash % (UINT32)Width);
+
+        INT32 Top = (INT32)((Hash >> 8) % (UINT32)Height);
+
+        INT32 Right = Left + Width / 4 < Width ? Left + Width / 4 : Width;
+
+        INT32 Bottom = Top + Height / 3 < Height ? Top + Height / 3 : Height;
+
+        UINT32 Fill = 0xFF000000 | (Hash & 0x00FFFFFF) | 0x00404040;
+
+        for (INT32 Y = Top; Y < Bottom; Y++)
+        {
+            for (INT32 X = Left; X < Right; X++)
+            {
+                BOOL Border = (X == Left || X == Right - 1 || Y == Top || Y == Bottom - 1);
+
+                UINT32 Noise = ((UINT32)(X * 7 + Y * 13) * 2246822519u >> 28);
+
+                Pixels[(size_t)Y * Width + X] = Border ? 0xFF202020 : Fill - Noise;
+            }
+        }
+    }
+}
+
+
+static inline BOOL WriteTestFile(const char* Path, const void* Data, size_t Size)
+{
+    FILE* File = fopen(Path, "wb");
+
+    if (File == NULL)
+    {
+        return FALSE;
+    }
+
+    BOOL Written = (fwrite(Data, 1, Size, File) == Size);
+
+    return (fclose(File) == 0) && Written;
+}
@@ -0,0 +1,385 @@
+// TestJournal.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that the undo journal puts back exactly what each step drew over, for far more steps than the old 32, that
+// it stays inside its budget and says so when a step's tiles are gone, and times undo through it against undo by
+// redrawing on a 4K snip with a few hundred annotations on it.
+
+#include <windows.h>
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+#include "Test.h"
+
+// Not a multiple of the tile size, so the tiles on the right and bottom are cut short.
+#define SNIP_WIDTH  333
+
+#define SNIP_HEIGHT 251
+
+#define SNIP_BYTES  ((SIZE_T)SNIP_WIDTH * SNIP_HEIGHT * sizeof(UINT32))
+
+#define STEPS       100
+
+typedef struct SNAPSHOT
+{
+    UINT32*  Raster;
+
+    COVERAGE Coverage;
+
+} SNAPSHOT;
+
+
+static void TakeSnapshot(SNAPSHOT* Snapshot, const UINT32* Raster, const COVERAGE* Coverage)
+{
+    Snapshot->Raster = malloc(SNIP_BYTES);
+
+    memcpy(Snapshot->Raster, Raster, SNIP_BYTES);
+
+    CHECK(CopyCoverage(&Snapshot->Coverage, Coverage));
+}
+
+
+static void FreeSnapshot(SNAPSHOT* Snapshot)
+{
+    free(Snapshot->Raster);
+
+    FreeCoverage(&Snapshot->Coverage);
+}
+
+
+static BOOL IsSnapshot(const SNAPSHOT* Snapshot, const UINT32* Raster, const COVERAGE* Coverage)
+{
+    if (memcmp(Snapshot->Raster, Raster, SNIP_BYTES) != 0)
+    {
+        return FALSE;
+    }
+
+    for (INT32 Y = 0; Y < SNIP_HEIGHT; Y++)
+    {
+        for (INT32 X = 0; X < SNIP_WIDTH; X++)
+        {
+            if (IsPixelCovered(&Snapshot->Coverage, X, Y) != IsPixelCovered(Coverage, X, Y))
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+
+// Puts the raster and coverage back the way they were in Snapshot, the way redrawing would.
+static void RestoreSnapshot(const SNAPSHOT* Snapshot, UINT32* Raster, COVERAGE* Coverage)
+{
+    memcpy(Raster, Snapshot->Raster, SNIP_BYTES);
+
+    FreeCoverage(Coverage);
+
+    CHECK(CopyCoverage(Coverage, &Snapshot->Coverage));
+}
+
+
+static void RandomArea(RECT* Area)
+{
+    // Now and then the whole snip, which is every tile, edges and all.
+    if (TestRandom() % 10 == 0)
+    {
+        SetRect(Area, 0, 0, SNIP_WIDTH, SNIP_HEIGHT);
+
+        return;
+    }
+
+    Area->left = TestRandomRange(0, SNIP_WIDTH - 1);
+
+    Area->top = TestRandomRange(0, SNIP_HEIGHT - 1);
+
+    Area->right = TestRandomRange(Area->left + 1, min(Area->left + 150, SNIP_WIDTH));
+
+    Area->bottom = TestRandomRange(Area->top + 1, min(Area->top + 150, SNIP_HEIGHT));
+}
+
+
+// Draws over Area, the way a step would: new pixels everywhere, and some of them hilighted.
+static void Scribble(UINT32* Raster, COVERAGE* Coverage, const RECT* Area)
+{
+    for (INT32 Y = Area->top; Y < Area->bottom; Y++)
+    {
+        for (INT32 X = Area->left; X < Area->right; X++)
+        {
+            Raster[(SIZE_T)Y * SNIP_WIDTH + X] = 0xFF000000 | ((TestRandom() << 8) ^ TestRandom());
+
+            if (TestRandom() % 5 == 0)
+            {
+                CoverPixel(Coverage, X, Y);
+            }
+        }
+    }
+}
+
+
+static void TestSteps(SIZE_T Budget)
+{
+    UINT32* Base = malloc(SNIP_BYTES);
+
+    UINT32* Raster = malloc(SNIP_BYTES);
+
+    SNAPSHOT* Before = calloc(STEPS + 1, sizeof(SNAPSHOT));
+
+    COVERAGE Coverage;
+
+    JOURNAL Journal;
+
+    UINT32 Restored = 0;
+
+    SIZE_T Bytes;
+
+    UINT64 FileBytes;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)SNIP_WIDTH * SNIP_HEIGHT; Index++)
+    {
+        Base[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    memcpy(Raster, Base, SNIP_BYTES);
+
+    InitializeCoverage(&Coverage, SNIP_WIDTH, SNIP_HEIGHT);
+
+    CHECK(InitializeJournal(&Journal, SNIP_WIDTH, SNIP_HEIGHT, Base, Budget));
+
+    for (UINT32 Step = 1; Step <= STEPS; Step++)
+    {
+        RECT Area;
+
+        TakeSnapshot(&Before[Step], Raster, &Coverage);
+
+        // Some steps draw in a few places, some of them overlapping, and each tile must be kept as it was before
+        // the first of them.
+        for (INT32 Part = TestRandomRange(1, 3); Part > 0; Part--)
+        {
+            RandomArea(&Area);
+
+            SaveJournalTiles(&Journal, Step, Raster, &Coverage, &Area);
+
+            Scribble(Raster, &Coverage, &Area);
+        }
+
+        GetJournalUsage(&Journal, &Bytes, &FileBytes);
+
+        CHECK(Bytes <= Budget);
+    }
+
+    // Only the newest step can be taken out.
+    if (Budget > 0)
+    {
+        UINT32 Newest = Raster[0];
+
+        CHECK(RestoreJournalStep(&Journal, STEPS - 1, Raster, &Coverage) == FALSE);
+
+        CHECK_EQUAL(Newest, Raster[0]);
+    }
+
+    for (UINT32 Step = STEPS; Step > 0; Step--)
+    {
+        if (RestoreJournalStep(&Journal, Step, Raster, &Coverage))
+        {
+            Restored++;
+
+            if (IsSnapshot(&Before[Step], Raster, &Coverage) == FALSE)
+            {
+                fprintf(stderr, "journal budget %zu: restoring step %u doesn't put back what it drew over\n", Budget, Step);
+
+                gTestFailures++;
+            }
+        }
+        else
+        {
+            RestoreSnapshot(&Before[Step], Raster, &Coverage);
+        }
+
+        FreeSnapshot(&Before[Step]);
+    }
+
+    CHECK(memcmp(Raster, Base, SNIP_BYTES) == 0);
+
+    printf("journal budget %10zu: %3u of %u steps undone from their tiles\n", Budget, Restored, STEPS);
+
+    // There's no cap on how many steps are kept, only on the memory they take.
+    if (Budget >= (SIZE_T)1 << 30)
+    {
+        CHECK_EQUAL(STEPS, Restored);
+    }
+    else if (Budget == 0)
+    {
+        CHECK_EQUAL(0, Restored);
+    }
+
+    FreeJournal(&Journal);
+
+    FreeCoverage(&Coverage);
+
+    free(Before);
+
+    free(Raster);
+
+    free(Base);
+}
+
+
+// A step that keeps tiles but turns out to draw nothing can be thrown away, and then the one before it can be undone.
+static void TestDiscard(void)
+{
+    UINT32* Base = malloc(SNIP_BYTES);
+
+    UINT32* Raster = malloc(SNIP_BYTES);
+
+    COVERAGE Coverage;
+
+    JOURNAL Journal;
+
+    RECT Area = { 10, 20, 200, 100 };
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)SNIP_WIDTH * SNIP_HEIGHT; Index++)
+    {
+        Base[Index] = 0xFF000000 | (UINT32)Index;
+    }
+
+    memcpy(Raster, Base, SNIP_BYTES);
+
+    InitializeCoverage(&Coverage, SNIP_WIDTH, SNIP_HEIGHT);
+
+    CHECK(InitializeJournal(&Journal, SNIP_WIDTH, SNIP_HEIGHT, Base, (SIZE_T)1 << 30));
+
+    SaveJournalTiles(&Journal, 1, Raster, &Coverage, &Area);
+
+    Scribble(Raster, &Coverage, &Area);
+
+    SaveJournalTiles(&Journal, 2, Raster, &Coverage, &Area);
+
+    CHECK(RestoreJournalStep(&Journal, 1, Raster, &Coverage) == FALSE);
+
+    DiscardJournalStep(&Journal, 2);
+
+    CHECK(RestoreJournalStep(&Journal, 1, Raster, &Coverage));
+
+    CHECK(memcmp(Raster, Base, SNIP_BYTES) == 0);
+
+    CHECK(RestoreJournalStep(&Journal, 1, Raster, &Coverage) == FALSE);
+
+    FreeJournal(&Journal);
+
+    FreeCoverage(&Coverage);
+
+    free(Raster);
+
+    free(Base);
+}
+
+
+// Undoes the last of a few hundred hilight strokes on a 4K snip, from the journal and by redrawing.
+static void BenchUndo(SIZE_T Budget)
+{
+    enum { Width = 3840, Height = 2160, Strokes = 300 };
+
+    UINT32* Raster = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    DOCUMENT Document;
+
+    RECT Damage;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Raster[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, Width, Height, Budget, NULL, NULL));
+
+    for (UINT32 Stroke = 0; Stroke < Strokes; Stroke++)
+    {
+        POINT Point = { TestRandomRange(0, Width - 400), TestRandomRange(0, Height - 40) };
+
+        BeginDocumentStep(&Document);
+
+        ANNOTATION* Annotation = BeginStroke(&Document, ANNOTATION_HILIGHT, Point, BRUSHTIP_SQUARE, 10, 24, HILIGHT_YELLOW, BLENDMODE_LINEAR);
+
+        Point.x += 300;
+
+        CHECK(AddStrokePoint(&Document, Annotation, Point, NULL, &Damage));
+
+        EndStroke(&Document, Annotation, NULL);
+    }
+
+    // The whole snip has a spotlight over it, so redrawing any of it means drawing everything under it.
+    BeginDocumentStep(&Document);
+
+    ANNOTATION Spotlight = { 0 };
+
+    Spotlight.Type = ANNOTATION_SPOTLIGHT;
+
+    Spotlight.Color = 0x99000000;
+
+    Spotlight.Start.x = Width / 4;
+
+    Spotlight.Start.y = Height / 4;
+
+    Spotlight.End.x = Width / 2;
+
+    Spotlight.End.y = Height / 2;
+
+    SetRect(&Spotlight.Bounds, 0, 0, Width, Height);
+
+    CHECK(AddAnnotation(&Document, &Spotlight) != NULL);
+
+    double Start = TestSeconds();
+
+    CHECK(UndoDocumentStep(&Document, &Damage));
+
+    double Seconds = TestSeconds() - Start;
+
+    printf("undo of a spotlight over %u strokes on %d x %d, %s: %8.2f ms\n", Strokes, Width, Height, (Budget > 0) ? "from the journal" : "by redrawing   ", Seconds * 1000.0);
+
+    FreeDocument(&Document);
+
+    free(Raster);
+}
+
+
+int main(void)
+{
+    InitializeBlendTables();
+
+    TestSteps((SIZE_T)1 << 30);
+
+    TestSteps(2 * 1024 * 1024);
+
+    TestSteps(256 * 1024);
+
+    TestSteps(0);
+
+    TestDiscard();
+
+    BenchUndo((SIZE_T)1 << 30);
+
+    BenchUndo(0);
+
+    return TestResult();
+}
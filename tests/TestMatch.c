@@ -0,0 +1,194 @@
+// TestMatch.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks the row difference kernel against the scalar one, and that "redact every occurrence" finds every copy of
+// a patch pasted into an image, and nothing else.
+
+#include <windows.h>
+
+#include "SnipExMatch.h"
+
+#include "Test.h"
+
+
+static void TestRowDifference(void)
+{
+    UINT32 A[80];
+
+    UINT32 B[80];
+
+    for (INT32 Offset = 0; Offset < 4; Offset++)
+    {
+        for (INT32 Count = 0; Count <= 76; Count++)
+        {
+            for (UINT32 Index = 0; Index < _countof(A); Index++)
+            {
+                A[Index] = (TestRandom() << 16) ^ TestRandom();
+
+                // Mostly close, the way a near match is, but with some far off.
+                B[Index] = (TestRandom() % 4 == 0) ? (TestRandom() << 16) ^ TestRandom() : A[Index] ^ (TestRandom() & 0x07070707);
+            }
+
+            CHECK_EQUAL(GetRowDifferenceScalar(&A[Offset], &B[Offset], Count), GetRowDifference(&A[Offset], &B[Offset], Count));
+        }
+    }
+
+    // Alpha doesn't count.
+    A[0] = 0x00102030;
+
+    B[0] = 0xFF112233;
+
+    CHECK_EQUAL(6, GetRowDifference(A, B, 1));
+}
+
+
+// Pastes the Width x Height patch at Patch into Pixels at X, Y, with up to Noise added to each channel.
+static void PastePatch(UINT32* Pixels, INT32 Stride, const UINT32* Patch, INT32 Width, INT32 Height, INT32 X, INT32 Y, UINT32 Noise)
+{
+    for (INT32 Row = 0; Row < Height; Row++)
+    {
+        for (INT32 Column = 0; Column < Width; Column++)
+        {
+            UINT32 Pixel = Patch[Row * Width + Column];
+
+            UINT32 Add = (Noise > 0) ? (TestRandom() % (Noise + 1)) * 0x010101 : 0;
+
+            // The patch's channels stay under 0xF0, so a little noise can't carry into the next channel.
+            Pixels[(SIZE_T)(Y + Row) * Stride + X + Column] = Pixel + Add;
+        }
+    }
+}
+
+
+static void TestFindMatches(INT32 Width, INT32 Height, BOOL Report)
+{
+    enum { PatchWidth = 90, PatchHeight = 14 };
+
+    static const POINT Places[] = { { 10, 10 }, { 300, 40 }, { 31, 200 }, { 500, 300 }, { 123, 401 }, { 700, 77 } };
+
+    UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32 Patch[PatchWidth * PatchHeight];
+
+    MATCHES Matches;
+
+    UINT32 Found[_countof(Places)] = { 0 };
+
+    // A smooth background, which has nothing on it like the patch.
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        for (INT32 X = 0; X < Width; X++)
+        {
+            Pixels[(SIZE_T)Y * Width + X] = 0xFF000000 | (UINT32)((X / 7) & 0x7F) << 16 | (UINT32)((Y / 5) & 0x7F) << 8 | 0x40;
+        }
+    }
+
+    // Something like a word of text: dark strokes on white.
+    for (INT32 Index = 0; Index < PatchWidth * PatchHeight; Index++)
+    {
+        Patch[Index] = (TestRandom() % 3 == 0) ? 0xFF202020 : 0xFFE8E8E8;
+    }
+
+    for (UINT32 Place = 0; Place < _countof(Places); Place++)
+    {
+        if (Places[Place].x + PatchWidth <= Width && Places[Place].y + PatchHeight <= Height)
+        {
+            PastePatch(Pixels, Width, Patch, PatchWidth, PatchHeight, Places[Place].x, Places[Place].y, (Place == 0) ? 0 : 3);
+        }
+    }
+
+    RECT Template = { Places[0].x, Places[0].y, Places[0].x + PatchWidth, Places[0].y + PatchHeight };
+
+    double Start = TestSeconds();
+
+    CHECK(FindTemplateMatches(Pixels, Width, Height, &Template, MATCH_MAX_DIFFERENCE, MATCH_MIN_CORRELATION, &Matches));
+
+    double Seconds = TestSeconds() - Start;
+
+    for (UINT32 Index = 0; Index < Matches.Count; Index++)
+    {
+        const RECT* Match = &Matches.Matches[Index].Rectangle;
+
+        BOOL Known = FALSE;
+
+        RECT Overlap;
+
+        CHECK(IntersectRect(&Overlap, Match, &Template) == FALSE);
+
+        CHECK(Index == 0 || Matches.Matches[Index - 1].Difference <= Matches.Matches[Index].Difference);
+
+        for (UINT32 Other = 0; Other < Index; Other++)
+        {
+            CHECK(IntersectRect(&Overlap, Match, &Matches.Matches[Other].Rectangle) == FALSE);
+        }
+
+        for (UINT32 Place = 1; Place < _countof(Places); Place++)
+        {
+            if (Match->left == Places[Place].x && Match->top == Places[Place].y && Match->right - Match->left == PatchWidth && Match->bottom - Match->top == PatchHeight)
+            {
+                Found[Place]++;
+
+                Known = TRUE;
+            }
+        }
+
+        if (Known == FALSE)
+        {
+            fprintf(stderr, "%d x %d: match at %d,%d isn't one of the copies\n", Width, Height, Match->left, Match->top);
+
+            gTestFailures++;
+        }
+    }
+
+    for (UINT32 Place = 1; Place < _countof(Places); Place++)
+    {
+        BOOL Pasted = (Places[Place].x + PatchWidth <= Width && Places[Place].y + PatchHeight <= Height);
+
+        if (Found[Place] != (Pasted ? 1u : 0u))
+        {
+            fprintf(stderr, "%d x %d: the copy at %d,%d was found %u times\n", Width, Height, Places[Place].x, Places[Place].y, Found[Place]);
+
+            gTestFailures++;
+        }
+    }
+
+    if (Report)
+    {
+        printf("FindTemplateMatches %d x %d: %u matches in %.3f ms\n", Width, Height, Matches.Count, Seconds * 1000.0);
+    }
+
+    FreeMatches(&Matches);
+
+    // A flat patch would match everywhere, so it isn't looked for.
+    RECT Flat = { Width - 40, Height - 20, Width - 10, Height - 10 };
+
+    for (INT32 Y = Flat.top; Y < Flat.bottom; Y++)
+    {
+        for (INT32 X = Flat.left; X < Flat.right; X++)
+        {
+            Pixels[(SIZE_T)Y * Width + X] = 0xFF808080;
+        }
+    }
+
+    CHECK(FindTemplateMatches(Pixels, Width, Height, &Flat, MATCH_MAX_DIFFERENCE, MATCH_MIN_CORRELATION, &Matches));
+
+    CHECK_EQUAL(0, Matches.Count);
+
+    FreeMatches(&Matches);
+
+    free(Pixels);
+}
+
+
+int main(void)
+{
+    // Pretend to have 4 processors, so that the search is split between threads even on a machine with one.
+    setenv("SNIPEX_TEST_CPUS", "4", 1);
+
+    TestRowDifference();
+
+    TestFindMatches(800, 450, FALSE);
+
+    TestFindMatches(1920, 1080, TRUE);
+
+    return TestResult();
+}
@@ -0,0 +1,229 @@
+// TestOverlay.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that the overlay's pieces cover the screen exactly once and are each what that part of the screen should
+// look like, and that the damage between two selections is exactly the pixels that look different, over a couple
+// of hundred thousand selections on a small screen, some dragged back to front, some with no area. Then counts the
+// bytes touched per mouse move while the selection is dragged, on desktops from one monitor up to three 4K ones,
+// against the old repaint of the whole desktop.
+
+#include <windows.h>
+
+#include "SnipExOverlay.h"
+
+#include "Test.h"
+
+#define SCREEN_WIDTH  37
+
+#define SCREEN_HEIGHT 29
+
+
+// What the pixel at X, Y looks like with Selection selected, worked out on its own.
+static OVERLAYPIXEL GetPixelKind(const RECT* Selection, BOOL Outlined, INT32 X, INT32 Y)
+{
+    INT32 Left = min(Selection->left, Selection->right);
+
+    INT32 Right = max(Selection->left, Selection->right);
+
+    INT32 Top = min(Selection->top, Selection->bottom);
+
+    INT32 Bottom = max(Selection->top, Selection->bottom);
+
+    if (Left >= Right || Top >= Bottom || X < Left || X >= Right || Y < Top || Y >= Bottom)
+    {
+        return OVERLAYPIXEL_DIMMED;
+    }
+
+    if (Outlined && (X == Left || X == Right - 1 || Y == Top || Y == Bottom - 1))
+    {
+        return OVERLAYPIXEL_OUTLINE;
+    }
+
+    return OVERLAYPIXEL_CLEAN;
+}
+
+
+static void RandomSelection(RECT* Selection)
+{
+    Selection->left = TestRandomRange(-3, SCREEN_WIDTH + 3);
+
+    Selection->top = TestRandomRange(-3, SCREEN_HEIGHT + 3);
+
+    Selection->right = TestRandomRange(-3, SCREEN_WIDTH + 3);
+
+    Selection->bottom = TestRandomRange(-3, SCREEN_HEIGHT + 3);
+}
+
+
+static void TestPiecesAndDamage(void)
+{
+    static UINT8 Covered[SCREEN_HEIGHT][SCREEN_WIDTH];
+
+    for (UINT32 Trial = 0; Trial < 200000; Trial++)
+    {
+        OVERLAYPIECE Pieces[OVERLAY_MAX_PIECES];
+
+        RECT Damage[OVERLAY_MAX_DAMAGE];
+
+        RECT Old;
+
+        RECT New;
+
+        RandomSelection(&Old);
+
+        // Mostly a few pixels' drag, the way the mouse moves, and now and then somewhere else altogether.
+        if (TestRandom() % 2)
+        {
+            New = Old;
+
+            New.right += TestRandomRange(-3, 3);
+
+            New.bottom += TestRandomRange(-3, 3);
+        }
+        else
+        {
+            RandomSelection(&New);
+        }
+
+        if (TestRandom() % 8 == 0)
+        {
+            Old.right = Old.left;
+        }
+
+        BOOL OldOutlined = (TestRandom() % 4 != 0);
+
+        BOOL NewOutlined = (TestRandom() % 4 != 0);
+
+        UINT32 PieceCount = GetOverlayPieces(&Old, OldOutlined, SCREEN_WIDTH, SCREEN_HEIGHT, Pieces);
+
+        CHECK(PieceCount <= OVERLAY_MAX_PIECES);
+
+        memset(Covered, 0, sizeof(Covered));
+
+        for (UINT32 Piece = 0; Piece < PieceCount; Piece++)
+        {
+            for (INT32 Y = Pieces[Piece].Rect.top; Y < Pieces[Piece].Rect.bottom; Y++)
+            {
+                for (INT32 X = Pieces[Piece].Rect.left; X < Pieces[Piece].Rect.right; X++)
+                {
+                    Covered[Y][X]++;
+
+                    if (Pieces[Piece].Kind != GetPixelKind(&Old, OldOutlined, X, Y))
+                    {
+                        fprintf(stderr, "overlay piece %u of selection %d,%d-%d,%d is the wrong kind at %d,%d\n", Piece, Old.left, Old.top, Old.right, Old.bottom, X, Y);
+
+                        gTestFailures++;
+
+                        return;
+                    }
+                }
+            }
+        }
+
+        for (SIZE_T Pixel = 0; Pixel < sizeof(Covered); Pixel++)
+        {
+            if (((const UINT8*)Covered)[Pixel] != 1)
+            {
+                fprintf(stderr, "overlay pieces of selection %d,%d-%d,%d don't cover the screen exactly once\n", Old.left, Old.top, Old.right, Old.bottom);
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+
+        UINT32 DamageCount = GetOverlayDamage(&Old, OldOutlined, &New, NewOutlined, SCREEN_WIDTH, SCREEN_HEIGHT, Damage);
+
+        CHECK(DamageCount <= OVERLAY_MAX_DAMAGE);
+
+        memset(Covered, 0, sizeof(Covered));
+
+        for (UINT32 Rect = 0; Rect < DamageCount; Rect++)
+        {
+            CHECK(IsRectEmpty(&Damage[Rect]) == FALSE);
+
+            for (INT32 Y = Damage[Rect].top; Y < Damage[Rect].bottom; Y++)
+            {
+                for (INT32 X = Damage[Rect].left; X < Damage[Rect].right; X++)
+                {
+                    Covered[Y][X]++;
+                }
+            }
+        }
+
+        for (INT32 Y = 0; Y < SCREEN_HEIGHT; Y++)
+        {
+            for (INT32 X = 0; X < SCREEN_WIDTH; X++)
+            {
+                BOOL Changed = GetPixelKind(&Old, OldOutlined, X, Y) != GetPixelKind(&New, NewOutlined, X, Y);
+
+                if (Covered[Y][X] != (Changed ? 1 : 0))
+                {
+                    fprintf(stderr, "damage from selection %d,%d-%d,%d to %d,%d-%d,%d covers %d,%d %u times\n", Old.left, Old.top, Old.right, Old.bottom, New.left, New.top, New.right, New.bottom, X, Y, Covered[Y][X]);
+
+                    gTestFailures++;
+
+                    return;
+                }
+            }
+        }
+    }
+}
+
+
+// Drags a selection out from the middle of the top left quarter, a few pixels a move.
+static void Bench(INT32 Width, INT32 Height)
+{
+    enum { Moves = 2000 };
+
+    RECT Selection = { Width / 4, Height / 4, Width / 4, Height / 4 };
+
+    double Bytes = 0.0;
+
+    UINT32 Rects = 0;
+
+    double Start = TestSeconds();
+
+    for (UINT32 Move = 0; Move < Moves; Move++)
+    {
+        RECT Damage[OVERLAY_MAX_DAMAGE];
+
+        RECT Old = Selection;
+
+        Selection.right = min(Selection.right + TestRandomRange(-2, 6), Width - 1);
+
+        Selection.bottom = min(Selection.bottom + TestRandomRange(-2, 6), Height - 1);
+
+        UINT32 Count = GetOverlayDamage(&Old, TRUE, &Selection, TRUE, Width, Height, Damage);
+
+        Rects += Count;
+
+        // Each pixel that changed is read from the dimmed or clean copy and written to the window.
+        for (UINT32 Rect = 0; Rect < Count; Rect++)
+        {
+            Bytes += (double)(Damage[Rect].right - Damage[Rect].left) * (Damage[Rect].bottom - Damage[Rect].top) * sizeof(UINT32) * 2;
+        }
+    }
+
+    double Seconds = (TestSeconds() - Start) / Moves;
+
+    // The old repaint copied the whole screenshot, blended most of the copy, and then copied all of it to the
+    // window: each a read and a write of every pixel.
+    double OldBytes = (double)Width * Height * sizeof(UINT32) * 6;
+
+    printf("%5d x %-4d  now %8.1f KB per move (%.1f rects, %.2f us to work out), was %8.0f KB per move, %.0fx less\n", Width, Height, Bytes / Moves / 1024.0, (double)Rects / Moves, Seconds * 1e6, OldBytes / 1024.0, OldBytes / (Bytes / Moves));
+}
+
+
+int main(void)
+{
+    static const INT32 Sizes[][2] = { { 1920, 1080 }, { 3840, 2160 }, { 7680, 2160 }, { 11520, 2160 } };
+
+    TestPiecesAndDamage();
+
+    for (UINT32 Size = 0; Size < _countof(Sizes); Size++)
+    {
+        Bench(Sizes[Size][0], Sizes[Size][1]);
+    }
+
+    return TestResult();
+}
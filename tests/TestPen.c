@@ -0,0 +1,324 @@
+// TestPen.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that the pen's filter takes out jitter without falling behind, that simplifying a stroke never drops a
+// point that's further than the tolerance from what's drawn without it, and that drawing a long stroke costs the
+// same per point at the end as at the start.
+
+#include <windows.h>
+
+#include <math.h>
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+#include "Test.h"
+
+#define PEN_SNIP_WIDTH  1600
+
+#define PEN_SNIP_HEIGHT 900
+
+#define PEN_POINTS      10000
+
+
+static float GetDistance(RASTERPOINT A, RASTERPOINT B)
+{
+    return sqrtf((A.X - B.X) * (A.X - B.X) + (A.Y - B.Y) * (A.Y - B.Y));
+}
+
+
+static float GetDistanceToSegmentReference(RASTERPOINT Point, RASTERPOINT From, RASTERPOINT To)
+{
+    double DX = To.X - From.X;
+
+    double DY = To.Y - From.Y;
+
+    double LengthSquared = DX * DX + DY * DY;
+
+    double Along = (LengthSquared > 0) ? ((Point.X - From.X) * DX + (Point.Y - From.Y) * DY) / LengthSquared : 0;
+
+    Along = min(max(Along, 0.0), 1.0);
+
+    RASTERPOINT Nearest = { (float)(From.X + Along * DX), (float)(From.Y + Along * DY) };
+
+    return GetDistance(Point, Nearest);
+}
+
+
+static void TestFilter(void)
+{
+    PENFILTER Filter;
+
+    RASTERPOINT Still = { 300.0f, 200.0f };
+
+    ResetPenFilter(&Filter);
+
+    // The first sample isn't moved, and a mouse that stays put stays put.
+    RASTERPOINT Point = FilterPenPoint(&Filter, Still, 1000);
+
+    CHECK(Point.X == Still.X && Point.Y == Still.Y);
+
+    for (UINT32 Sample = 1; Sample <= 20; Sample++)
+    {
+        Point = FilterPenPoint(&Filter, Still, 1000 + Sample * 8);
+
+        CHECK(GetDistance(Point, Still) < 0.001f);
+    }
+
+    // A hand that shakes by a pixel while it holds still mostly comes out still.
+    double Shake = 0;
+
+    for (UINT32 Sample = 0; Sample < 500; Sample++)
+    {
+        RASTERPOINT Jittered = { Still.X + TestRandomRange(-1, 1), Still.Y + TestRandomRange(-1, 1) };
+
+        Point = FilterPenPoint(&Filter, Jittered, 2000 + Sample * 8);
+
+        Shake += GetDistance(Point, Still);
+    }
+
+    CHECK(Shake / 500 < 0.35);
+
+    // Moving quickly across the snip, the smoothed point keeps up.
+    ResetPenFilter(&Filter);
+
+    for (UINT32 Sample = 0; Sample < 200; Sample++)
+    {
+        RASTERPOINT Fast = { 100.0f + Sample * 12.0f, 300.0f };
+
+        Point = FilterPenPoint(&Filter, Fast, Sample * 8);
+
+        if (Sample > 20 && GetDistance(Point, Fast) > 12.0f)
+        {
+            fprintf(stderr, "the pen falls %g pixels behind a mouse moving 1500 pixels a second\n", GetDistance(Point, Fast));
+
+            gTestFailures++;
+
+            break;
+        }
+    }
+
+    // Starting again doesn't smooth from where the last stroke ended.
+    ResetPenFilter(&Filter);
+
+    Point = FilterPenPoint(&Filter, Still, 99999);
+
+    CHECK(Point.X == Still.X && Point.Y == Still.Y);
+}
+
+
+static void TestSimplify(void)
+{
+    static RASTERPOINT Original[2000];
+
+    static RASTERPOINT Points[2000];
+
+    RASTERPOINT Line[50];
+
+    for (UINT32 Count = 0; Count < 3; Count++)
+    {
+        CHECK_EQUAL(Count, SimplifyPolyline(Line, Count, PEN_SIMPLIFY_TOLERANCE));
+    }
+
+    // Points along a straight line all go but the ends.
+    for (UINT32 Index = 0; Index < _countof(Line); Index++)
+    {
+        Line[Index].X = 10.0f + Index * 2.0f;
+
+        Line[Index].Y = 5.0f + Index * 0.5f;
+    }
+
+    CHECK_EQUAL(2, SimplifyPolyline(Line, _countof(Line), PEN_SIMPLIFY_TOLERANCE));
+
+    CHECK(Line[1].X == 10.0f + 49 * 2.0f && Line[1].Y == 5.0f + 49 * 0.5f);
+
+    for (UINT32 Trial = 0; Trial < 50; Trial++)
+    {
+        float Tolerance = (Trial % 2) ? PEN_SIMPLIFY_TOLERANCE : 2.0f;
+
+        UINT32 Count = (UINT32)TestRandomRange(3, _countof(Original));
+
+        RASTERPOINT Point = { 500.0f, 500.0f };
+
+        for (UINT32 Index = 0; Index < Count; Index++)
+        {
+            // Wandering the way a hand does, with a few sharp turns.
+            Point.X += TestRandomRange(-100, 300) / 100.0f;
+
+            Point.Y += (Index % 97 < 10) ? TestRandomRange(-500, 500) / 100.0f : TestRandomRange(-50, 60) / 100.0f;
+
+            Original[Index] = Point;
+        }
+
+        memcpy(Points, Original, Count * sizeof(RASTERPOINT));
+
+        UINT32 Kept = SimplifyPolyline(Points, Count, Tolerance);
+
+        CHECK(Kept >= 2 && Kept <= Count);
+
+        CHECK(memcmp(&Points[0], &Original[0], sizeof(RASTERPOINT)) == 0);
+
+        CHECK(memcmp(&Points[Kept - 1], &Original[Count - 1], sizeof(RASTERPOINT)) == 0);
+
+        // What's left is some of the points, in order, and every point that went is near the segment that
+        // replaced it.
+        UINT32 Next = 1;
+
+        UINT32 Previous = 0;
+
+        for (UINT32 Index = 1; Index < Count && Next < Kept; Index++)
+        {
+            if (memcmp(&Original[Index], &Points[Next], sizeof(RASTERPOINT)) != 0)
+            {
+                continue;
+            }
+
+            for (UINT32 Dropped = Previous + 1; Dropped < Index; Dropped++)
+            {
+                if (GetDistanceToSegmentReference(Original[Dropped], Original[Previous], Original[Index]) > Tolerance + 0.001f)
+                {
+                    fprintf(stderr, "point %u of %u was dropped but is %g pixels from the line\n", Dropped, Count, GetDistanceToSegmentReference(Original[Dropped], Original[Previous], Original[Index]));
+
+                    gTestFailures++;
+
+                    return;
+                }
+            }
+
+            Previous = Index;
+
+            Next++;
+        }
+
+        CHECK_EQUAL(Kept, Next);
+    }
+}
+
+
+static void TestLongStroke(void)
+{
+    UINT32* Raster = malloc((SIZE_T)PEN_SNIP_WIDTH * PEN_SNIP_HEIGHT * sizeof(UINT32));
+
+    UINT32* Drawn = malloc((SIZE_T)PEN_SNIP_WIDTH * PEN_SNIP_HEIGHT * sizeof(UINT32));
+
+    RECT Whole = { 0, 0, PEN_SNIP_WIDTH, PEN_SNIP_HEIGHT };
+
+    DOCUMENT Document;
+
+    PENFILTER Filter;
+
+    RECT Damage;
+
+    double First = 0;
+
+    double Last = 0;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)PEN_SNIP_WIDTH * PEN_SNIP_HEIGHT; Index++)
+    {
+        Raster[Index] = 0xFF000000 | (UINT32)(Index * 2654435761u >> 8);
+    }
+
+    CHECK(InitializeDocument(&Document, Raster, PEN_SNIP_WIDTH, PEN_SNIP_HEIGHT, (SIZE_T)1 << 30, NULL, NULL));
+
+    BeginDocumentStep(&Document);
+
+    ResetPenFilter(&Filter);
+
+    RASTERPOINT Point = { 800.0f, 450.0f };
+
+    ANNOTATION* Stroke = BeginPenStroke(&Document, FilterPenPoint(&Filter, Point, 0), 3, 0xFFFF0000, BLENDMODE_LINEAR, &Damage);
+
+    CHECK(Stroke != NULL);
+
+    double Start = TestSeconds();
+
+    // A long scribble that goes back over itself many times.
+    for (UINT32 Sample = 1; Sample < PEN_POINTS; Sample++)
+    {
+        float Along = Sample * 0.01f;
+
+        Point.X = 800.0f + 600.0f * sinf(Along * 1.3f) * cosf(Along * 0.07f) + TestRandomRange(-1, 1) * 0.4f;
+
+        Point.Y = 450.0f + 380.0f * sinf(Along * 1.9f) + TestRandomRange(-1, 1) * 0.4f;
+
+        CHECK(AddPenPoint(&Document, Stroke, FilterPenPoint(&Filter, Point, Sample * 8), &Damage));
+
+        // Each point only draws the segment it adds, so it mustn't touch more than that segment's neighbourhood.
+        CHECK(Damage.right - Damage.left < 64 && Damage.bottom - Damage.top < 64);
+
+        if (Sample == 1000)
+        {
+            First = TestSeconds() - Start;
+        }
+        else if (Sample == PEN_POINTS - 1000)
+        {
+            Start = TestSeconds();
+        }
+    }
+
+    Last = TestSeconds() - Start;
+
+    EndPenStroke(&Document, Stroke, PEN_SIMPLIFY_TOLERANCE, &Damage);
+
+    printf("pen stroke of %u points: %.2f us a point for the first 1000, %.2f us for the last 1000, %u points after simplifying\n", PEN_POINTS, First * 1000.0, Last * 1000.0, Stroke->PenPointCount);
+
+    CHECK(Stroke->PenPointCount < PEN_POINTS / 2);
+
+    // Nothing is left of the stroke's coverage for the next one.
+    for (SIZE_T Index = 0; Index < (SIZE_T)PEN_SNIP_WIDTH * PEN_SNIP_HEIGHT; Index++)
+    {
+        if (Document.StrokeCoverage[Index] != 0)
+        {
+            fprintf(stderr, "stroke coverage left at pixel %zu\n", Index);
+
+            gTestFailures++;
+
+            break;
+        }
+    }
+
+    // The raster is what undo and redo will draw.
+    memcpy(Drawn, Raster, (SIZE_T)PEN_SNIP_WIDTH * PEN_SNIP_HEIGHT * sizeof(UINT32));
+
+    RedrawDocument(&Document, &Whole);
+
+    CHECK(memcmp(Drawn, Raster, (SIZE_T)PEN_SNIP_WIDTH * PEN_SNIP_HEIGHT * sizeof(UINT32)) == 0);
+
+    FreeDocument(&Document);
+
+    free(Raster);
+
+    free(Drawn);
+}
+
+
+int main(void)
+{
+    InitializeBlendTables();
+
+    TestFilter();
+
+    TestSimplify();
+
+    TestLongStroke();
+
+    return TestResult();
+}
@@ -0,0 +1,227 @@
+// TestPng.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that DecodePng reads every kind of PNG it says it supports, with every filter and every kind of deflate
+// block, and that damaged files are turned away rather than read past the end of.
+
+#include <windows.h>
+
+#include "SnipExPng.h"
+
+#include "Test.h"
+
+#include "TestFrames.h"
+
+// A 32 x 32 RGB image compressed by zlib with dynamic Huffman codes, which TestFrames.h can't make. Each row is
+// filtered with Sub. Pixel (X, Y) is red X * 4, green Y * 8 and blue X * Y / 4.
+static const UINT8 gDynamicPng[] =
+{
+    0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x20, 0x08, 0x02, 0x00, 0x00, 0x00, 0xFC, 0x18, 0xED,
+    0xA3, 0x00, 0x00, 0x00, 0xD9, 0x49, 0x44, 0x41, 0x54, 0x78, 0xDA, 0xB5, 0x8D, 0x11, 0x53, 0x84,
+    0x61, 0x18, 0x45, 0xCF, 0xD9, 0xFD, 0x76, 0xF7, 0xC3, 0x30, 0x0C, 0xC3, 0x30, 0x0C, 0xC3, 0x70,
+    0x31, 0x5C, 0x0C, 0xC3, 0x30, 0x0C, 0xC3, 0x30, 0x0C, 0xC3, 0xC5, 0x70, 0x31, 0x0C, 0xC3, 0xC5,
+    0xC5, 0xEC, 0x9D, 0xFB, 0x03, 0x6E, 0x33, 0x77, 0xEE, 0x9C, 0xE7, 0x3C, 0x70, 0x05, 0xA6, 0xFF,
+    0x8C, 0xCC, 0x79, 0x5B, 0x67, 0x39, 0x4B, 0xD5, 0x6F, 0x39, 0x1F, 0x03, 0xC6, 0xA3, 0xC6, 0x72,
+    0x91, 0xB6, 0x1F, 0xB9, 0xCC, 0x81, 0x45, 0x9D, 0xE5, 0x8A, 0x50, 0xFD, 0x96, 0xEB, 0x31, 0xB0,
+    0x88, 0x47, 0x8D, 0xE5, 0x86, 0xB0, 0xFD, 0xC8, 0x6D, 0x0E, 0x2C, 0xEB, 0x2C, 0x77, 0x84, 0xEA,
+    0xB7, 0x6C, 0xC7, 0xC0, 0x32, 0x1E, 0x35, 0x96, 0x7B, 0xC2, 0xF6, 0x23, 0xBB, 0x1C, 0x98, 0xEA,
+    0x2C, 0x0F, 0x84, 0xEA, 0xB7, 0x3C, 0x8E, 0x81, 0x29, 0x1E, 0x35, 0x96, 0x27, 0xC2, 0xF6, 0x23,
+    0xCF, 0x39, 0xB0, 0xAA, 0xB3, 0xBC, 0x10, 0xAA, 0xDF, 0xF2, 0x3A, 0x06, 0x56, 0xF1, 0xA8, 0xB1,
+    0xBC, 0x11, 0xB6, 0x1F, 0x79, 0xCF, 0x81, 0x75, 0x9D, 0xE5, 0x83, 0x50, 0xFD, 0x96, 0xCF, 0x31,
+    0xB0, 0x8E, 0x47, 0x8D, 0x65, 0x4F, 0xD8, 0x7E, 0xE4, 0x2B, 0x07, 0x36, 0x75, 0x96, 0x03, 0xA1,
+    0xFA, 0x2D, 0xDF, 0x63, 0x60, 0x13, 0x8F, 0x1A, 0xCB, 0x0F, 0x61, 0xFB, 0x91, 0xDF, 0x1C, 0x98,
+    0xEB, 0x2C, 0x47, 0x42, 0xF5, 0x5B, 0x4E, 0x63, 0x60, 0x8E, 0x47, 0x8D, 0xFF, 0x00, 0x9B, 0xF6,
+    0x2E, 0x19, 0x9F, 0x82, 0xC9, 0x22, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42,
+    0x60, 0x82
+};
+
+
+// What a pixel comes out as once it has been through a PNG of ColorType.
+static UINT32 ExpectedPixel(UINT32 Pixel, UINT8 ColorType)
+{
+    UINT32 Gray = (Pixel >> 8) & 0xFF;
+
+    switch (ColorType)
+    {
+        case 0:  return 0xFF000000 | (Gray << 16) | (Gray << 8) | Gray;
+        case 2:  return 0xFF000000 | Pixel;
+        case 4:  return (Pixel & 0xFF000000) | (Gray << 16) | (Gray << 8) | Gray;
+        default: return Pixel;
+    }
+}
+
+
+static void TestRoundTrip(INT32 Width, INT32 Height, UINT8 ColorType, TESTPNGCOMPRESSION Compression)
+{
+    UINT32* Pixels = malloc((size_t)Width * Height * sizeof(UINT32));
+
+    for (INT32 Index = 0; Index < Width * Height; Index++)
+    {
+        // Some of it random, so that alpha isn't always the same, and some of it flat, so that there is something
+        // for back references to find.
+        Pixels[Index] = (Index % 7 < 3) ? (TestRandom() << 8) ^ TestRandom() : 0x80336699;
+    }
+
+    size_t Size = 0;
+
+    UINT8* Png = EncodeTestPng(Pixels, Width, Height, ColorType, Compression, &Size);
+
+    UINT32* Decoded = NULL;
+
+    INT32 DecodedWidth = 0;
+
+    INT32 DecodedHeight = 0;
+
+    CHECK(IsPng(Png, Size));
+
+    CHECK(DecodePng(Png, Size, &Decoded, &DecodedWidth, &DecodedHeight));
+
+    if (Decoded != NULL)
+    {
+        CHECK_EQUAL(Width, DecodedWidth);
+
+        CHECK_EQUAL(Height, DecodedHeight);
+
+        for (INT32 Index = 0; Index < Width * Height; Index++)
+        {
+            if (Decoded[Index] != ExpectedPixel(Pixels[Index], ColorType))
+            {
+                fprintf(stderr, "%d x %d color type %u, compression %d: pixel %d is %08X, not %08X\n", Width, Height, ColorType, Compression, Index, Decoded[Index], ExpectedPixel(Pixels[Index], ColorType));
+
+                gTestFailures++;
+
+                break;
+            }
+        }
+
+        HeapFree(GetProcessHeap(), 0, Decoded);
+    }
+
+    free(Png);
+
+    free(Pixels);
+}
+
+
+static void TestDynamicHuffman(void)
+{
+    UINT32* Decoded = NULL;
+
+    INT32 Width = 0;
+
+    INT32 Height = 0;
+
+    CHECK(DecodePng(gDynamicPng, sizeof(gDynamicPng), &Decoded, &Width, &Height));
+
+    if (Decoded == NULL)
+    {
+        return;
+    }
+
+    CHECK_EQUAL(32, Width);
+
+    CHECK_EQUAL(32, Height);
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        for (INT32 X = 0; X < Width; X++)
+        {
+            UINT32 Expected = 0xFF000000 | ((UINT32)(X * 4) << 16) | ((UINT32)(Y * 8) << 8) | (UINT32)((X * Y) >> 2);
+
+            CHECK_EQUAL(Expected, Decoded[Y * Width + X]);
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, Decoded);
+}
+
+
+// Every way of cutting a PNG short, and a lot of single flipped bits, must fail or succeed without touching memory
+// it shouldn't. Run under a sanitizer, this is what finds the reads past the end.
+static void TestDamagedFiles(void)
+{
+    UINT32 Pixels[40 * 30];
+
+    MakeTestDesktop(Pixels, 40, 30, 3);
+
+    for (UINT32 Compression = TESTPNG_STORED; Compression <= TESTPNG_FIXED; Compression++)
+    {
+        size_t Size = 0;
+
+        UINT8* Png = EncodeTestPng(Pixels, 40, 30, 6, (TESTPNGCOMPRESSION)Compression, &Size);
+
+        UINT8* Damaged = malloc(Size);
+
+        for (size_t Length = 0; Length < Size; Length++)
+        {
+            UINT32* Decoded = NULL;
+
+            INT32 Width = 0;
+
+            INT32 Height = 0;
+
+            // Copied to a buffer of just that length, so that reading past it is caught.
+            UINT8* Short = malloc(Length + 1);
+
+            memcpy(Short, Png, Length);
+
+            CHECK(DecodePng(Short, Length, &Decoded, &Width, &Height) == FALSE);
+
+            free(Short);
+        }
+
+        for (UINT32 Trial = 0; Trial < 2000; Trial++)
+        {
+            UINT32* Decoded = NULL;
+
+            INT32 Width = 0;
+
+            INT32 Height = 0;
+
+            memcpy(Damaged, Png, Size);
+
+            Damaged[8 + TestRandom() % (Size - 8)] ^= (UINT8)(1 << (TestRandom() % 8));
+
+            if (DecodePng(Damaged, Size, &Decoded, &Width, &Height))
+            {
+                CHECK(Width > 0 && Height > 0);
+
+                HeapFree(GetProcessHeap(), 0, Decoded);
+            }
+        }
+
+        free(Damaged);
+
+        free(Png);
+    }
+
+    CHECK(IsPng((const UINT8*)"\x89PNG\r\n\x1A", 7) == FALSE);
+
+    CHECK(IsPng((const UINT8*)"GIF89a\0\0\0\0", 10) == FALSE);
+}
+
+
+int main(void)
+{
+    static const UINT8 ColorTypes[] = { 0, 2, 4, 6 };
+
+    for (UINT32 Type = 0; Type < _countof(ColorTypes); Type++)
+    {
+        TestRoundTrip(1, 1, ColorTypes[Type], TESTPNG_STORED);
+
+        TestRoundTrip(37, 23, ColorTypes[Type], TESTPNG_STORED);
+
+        TestRoundTrip(37, 23, ColorTypes[Type], TESTPNG_FIXED);
+
+        // Big enough to need more than one stored block and the whole 32K window.
+        TestRoundTrip(300, 200, ColorTypes[Type], TESTPNG_STORED);
+
+        TestRoundTrip(300, 200, ColorTypes[Type], TESTPNG_FIXED);
+    }
+
+    TestDynamicHuffman();
+
+    TestDamagedFiles();
+
+    return TestResult();
+}
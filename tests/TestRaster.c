@@ -0,0 +1,471 @@
+// TestRaster.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks the coverage kernel against the scalar one, that a polygon covers each pixel by exactly the area that it
+// overlaps, that a shape comes out the same bit for bit however it's clipped, and that a coverage buffer keeps
+// overlapping pieces from drawing twice. Then times lines, box outlines, ellipses and arrow heads of a few widths.
+
+#include <windows.h>
+
+#include <math.h>
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "Test.h"
+
+#define RASTER_TEST_WIDTH  160
+
+#define RASTER_TEST_HEIGHT 120
+
+#define RASTER_BENCH_WIDTH  1920
+
+#define RASTER_BENCH_HEIGHT 1080
+
+#define RASTER_BENCH_SHAPES 2000
+
+
+static void TestResolveCoverage(void)
+{
+    INT32 ExpectedCells[90];
+
+    INT32 ActualCells[90];
+
+    UINT8 Expected[90];
+
+    UINT8 Actual[90];
+
+    for (UINT32 Offset = 0; Offset < 4; Offset++)
+    {
+        for (UINT32 Count = 0; Count + Offset + 1 < _countof(ExpectedCells); Count++)
+        {
+            for (UINT32 Index = 0; Index < _countof(ExpectedCells); Index++)
+            {
+                // Steps up and down by up to a pixel and a half of coverage, so the running sum goes past full and
+                // below zero, the way overlapping polygons and holes make it.
+                ExpectedCells[Index] = TestRandomRange(-RASTER_FULL_COVERAGE * 3 / 2, RASTER_FULL_COVERAGE * 3 / 2) / 8;
+            }
+
+            memcpy(ActualCells, ExpectedCells, sizeof(ExpectedCells));
+
+            memset(Expected, 0xAA, sizeof(Expected));
+
+            memset(Actual, 0xAA, sizeof(Actual));
+
+            ResolveCoverageScalar(&ExpectedCells[Offset], &Expected[Offset], Count);
+
+            ResolveCoverage(&ActualCells[Offset], &Actual[Offset], Count);
+
+            if (memcmp(Expected, Actual, sizeof(Actual)) != 0 || memcmp(ExpectedCells, ActualCells, sizeof(ActualCells)) != 0)
+            {
+                fprintf(stderr, "ResolveCoverage offset %u, count %u differs from ResolveCoverageScalar\n", Offset, Count);
+
+                gTestFailures++;
+            }
+
+            // The row and the cell after it are left zeroed for the next one.
+            for (UINT32 Index = Offset; Index <= Offset + Count; Index++)
+            {
+                CHECK_EQUAL(0, ActualCells[Index]);
+            }
+        }
+    }
+}
+
+
+static void ClearTarget(UINT32* Pixels)
+{
+    for (UINT32 Index = 0; Index < RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT; Index++)
+    {
+        Pixels[Index] = 0xFF000000;
+    }
+}
+
+
+// How much of the pixel at X, Y the rectangle from Left, Top to Right, Bottom covers.
+static double GetOverlap(INT32 X, INT32 Y, double Left, double Top, double Right, double Bottom)
+{
+    double Width = min(Right, X + 1.0) - max(Left, (double)X);
+
+    double Height = min(Bottom, Y + 1.0) - max(Top, (double)Y);
+
+    return (Width > 0 && Height > 0) ? Width * Height : 0;
+}
+
+
+static void TestPolygonArea(void)
+{
+    static UINT32 Pixels[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+    RASTERTARGET Target = { Pixels, RASTER_TEST_WIDTH, { 0, 0, RASTER_TEST_WIDTH, RASTER_TEST_HEIGHT }, NULL };
+
+    for (UINT32 Trial = 0; Trial < 200; Trial++)
+    {
+        // Corners on the 1/256 pixel grid, so the area is exact.
+        double Left = TestRandomRange(-10 * RASTER_SUBPIXELS, 100 * RASTER_SUBPIXELS) / (double)RASTER_SUBPIXELS;
+
+        double Top = TestRandomRange(-10 * RASTER_SUBPIXELS, 80 * RASTER_SUBPIXELS) / (double)RASTER_SUBPIXELS;
+
+        double Right = Left + TestRandomRange(0, 60 * RASTER_SUBPIXELS) / (double)RASTER_SUBPIXELS;
+
+        double Bottom = Top + TestRandomRange(0, 50 * RASTER_SUBPIXELS) / (double)RASTER_SUBPIXELS;
+
+        RASTERPOINT Corners[4] = { { (float)Left, (float)Top }, { (float)Right, (float)Top }, { (float)Right, (float)Bottom }, { (float)Left, (float)Bottom } };
+
+        // Going around twice fills the same pixels, and going the other way around fills them by the same amount.
+        RASTERPOINT Twice[8] = { Corners[0], Corners[1], Corners[2], Corners[3], Corners[0], Corners[1], Corners[2], Corners[3] };
+
+        RASTERPOINT Backwards[4] = { Corners[3], Corners[2], Corners[1], Corners[0] };
+
+        static UINT32 Once[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+        ClearTarget(Pixels);
+
+        FillPolygon(&Target, Corners, 4, 0xFFFFFFFF, BLENDMODE_SRGB);
+
+        memcpy(Once, Pixels, sizeof(Pixels));
+
+        for (INT32 Y = 0; Y < RASTER_TEST_HEIGHT; Y++)
+        {
+            for (INT32 X = 0; X < RASTER_TEST_WIDTH; X++)
+            {
+                // Coverage rounds to an alpha, and then the blend rounds again.
+                INT32 Expected = (INT32)floor(GetOverlap(X, Y, Left, Top, Right, Bottom) * 255.0 + 0.5);
+
+                INT32 Actual = (INT32)(Pixels[Y * RASTER_TEST_WIDTH + X] & 0xFF);
+
+                if (abs(Expected - Actual) > 2)
+                {
+                    fprintf(stderr, "rectangle %g,%g-%g,%g: pixel %d,%d is %d, not %d\n", Left, Top, Right, Bottom, X, Y, Actual, Expected);
+
+                    gTestFailures++;
+
+                    return;
+                }
+            }
+        }
+
+        ClearTarget(Pixels);
+
+        FillPolygon(&Target, Twice, 8, 0xFFFFFFFF, BLENDMODE_SRGB);
+
+        for (UINT32 Index = 0; Index < RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT; Index++)
+        {
+            // Coverage adds up before it's clamped, so only the pixels inside are sure to be filled just once. A
+            // pixel on the edge gets twice its share.
+            double Overlap = GetOverlap((INT32)(Index % RASTER_TEST_WIDTH), (INT32)(Index / RASTER_TEST_WIDTH), Left, Top, Right, Bottom);
+
+            if ((Overlap == 0 || Overlap == 1) && Pixels[Index] != Once[Index])
+            {
+                fprintf(stderr, "rectangle %g,%g-%g,%g gone around twice: pixel %u is %08X, not %08X\n", Left, Top, Right, Bottom, Index, Pixels[Index], Once[Index]);
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+
+        ClearTarget(Pixels);
+
+        FillPolygon(&Target, Backwards, 4, 0xFFFFFFFF, BLENDMODE_SRGB);
+
+        CHECK(memcmp(Once, Pixels, sizeof(Pixels)) == 0);
+    }
+}
+
+
+static RASTERPOINT RandomPoint(void)
+{
+    RASTERPOINT Point = { TestRandomRange(-2000, RASTER_TEST_WIDTH * 100 + 2000) / 100.0f, TestRandomRange(-2000, RASTER_TEST_HEIGHT * 100 + 2000) / 100.0f };
+
+    return Point;
+}
+
+
+// Draws the kind of shape picked by Kind: a line, a capsule, a box, an ellipse, a filled ellipse or an arrow.
+static void DrawShape(const RASTERTARGET* Target, UINT32 Kind, RASTERPOINT From, RASTERPOINT To, float Width, BLENDMODE Mode)
+{
+    UINT32 Color = 0xFFFF4000;
+
+    switch (Kind)
+    {
+        case 0:
+        {
+            DrawLine(Target, From, To, Width, Color, Mode);
+
+            break;
+        }
+        case 1:
+        {
+            DrawCapsule(Target, From, To, Width, Color, Mode);
+
+            break;
+        }
+        case 2:
+        {
+            DrawBox(Target, From, To, Width, Color, Mode);
+
+            break;
+        }
+        case 3:
+        {
+            DrawEllipse(Target, From, fabsf(To.X - From.X) / 2, fabsf(To.Y - From.Y) / 2, Width, Color, Mode);
+
+            break;
+        }
+        case 4:
+        {
+            DrawEllipse(Target, From, fabsf(To.X - From.X) / 2, fabsf(To.Y - From.Y) / 2, 0, Color, Mode);
+
+            break;
+        }
+        default:
+        {
+            DrawArrow(Target, From, To, Width, Color, Mode);
+
+            break;
+        }
+    }
+}
+
+
+// Draws shapes into the whole image and into a piece of it, and checks that the piece comes out the same as
+// that part of the whole, which is what lets the app redraw only the part of the snip that changed.
+static void TestClipping(void)
+{
+    static UINT32 Whole[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+    static UINT32 Piece[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+    RASTERTARGET WholeTarget = { Whole, RASTER_TEST_WIDTH, { 0, 0, RASTER_TEST_WIDTH, RASTER_TEST_HEIGHT }, NULL };
+
+    for (UINT32 Trial = 0; Trial < 3000; Trial++)
+    {
+        UINT32 Kind = Trial % 6;
+
+        RASTERPOINT From = RandomPoint();
+
+        RASTERPOINT To = RandomPoint();
+
+        float Width = TestRandomRange(25, 1200) / 100.0f;
+
+        BLENDMODE Mode = (TestRandom() % 2) ? BLENDMODE_LINEAR : BLENDMODE_SRGB;
+
+        RECT Clip = { TestRandomRange(0, RASTER_TEST_WIDTH - 1), TestRandomRange(0, RASTER_TEST_HEIGHT - 1), 0, 0 };
+
+        Clip.right = TestRandomRange(Clip.left + 1, RASTER_TEST_WIDTH);
+
+        Clip.bottom = TestRandomRange(Clip.top + 1, RASTER_TEST_HEIGHT);
+
+        ClearTarget(Whole);
+
+        ClearTarget(Piece);
+
+        DrawShape(&WholeTarget, Kind, From, To, Width, Mode);
+
+        // The piece has its own pixels, with a stride of its own.
+        RASTERTARGET PieceTarget = { Piece, Clip.right - Clip.left, Clip, NULL };
+
+        DrawShape(&PieceTarget, Kind, From, To, Width, Mode);
+
+        for (INT32 Y = Clip.top; Y < Clip.bottom; Y++)
+        {
+            if (memcmp(&Whole[Y * RASTER_TEST_WIDTH + Clip.left], &Piece[(Y - Clip.top) * PieceTarget.Stride], (SIZE_T)PieceTarget.Stride * sizeof(UINT32)) != 0)
+            {
+                fprintf(stderr, "shape %u from %g,%g to %g,%g, %g wide, clipped to %d,%d-%d,%d: row %d differs\n", Kind, From.X, From.Y, To.X, To.Y, Width, Clip.left, Clip.top, Clip.right, Clip.bottom, Y);
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+
+        // Nothing past the piece is touched.
+        for (INT32 Index = (Clip.bottom - Clip.top) * PieceTarget.Stride; Index < RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT; Index++)
+        {
+            if (Piece[Index] != 0xFF000000)
+            {
+                fprintf(stderr, "shape %u clipped to %d,%d-%d,%d drew outside of it\n", Kind, Clip.left, Clip.top, Clip.right, Clip.bottom);
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+    }
+}
+
+
+// With a coverage buffer, capsules that overlap blend in as one shape: drawing the same one again adds nothing,
+// and drawing ones that it covers adds no more than the rounding of where their edges fall.
+static void TestCoverageBuffer(void)
+{
+    static UINT32 Pixels[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+    static UINT32 Once[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+    static UINT8 Coverage[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+    static UINT8 OnceCoverage[RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT];
+
+    RASTERTARGET Target = { Pixels, RASTER_TEST_WIDTH, { 0, 0, RASTER_TEST_WIDTH, RASTER_TEST_HEIGHT }, Coverage };
+
+    for (UINT32 Trial = 0; Trial < 200; Trial++)
+    {
+        RASTERPOINT From = RandomPoint();
+
+        RASTERPOINT To = RandomPoint();
+
+        RASTERPOINT Middle = { (From.X + To.X) / 2, (From.Y + To.Y) / 2 };
+
+        float Width = TestRandomRange(100, 1600) / 100.0f;
+
+        UINT32 Color = 0xFF3080FF;
+
+        ClearTarget(Pixels);
+
+        memset(Coverage, 0, sizeof(Coverage));
+
+        DrawCapsule(&Target, From, To, Width, Color, BLENDMODE_LINEAR);
+
+        memcpy(Once, Pixels, sizeof(Pixels));
+
+        memcpy(OnceCoverage, Coverage, sizeof(Coverage));
+
+        DrawCapsule(&Target, From, To, Width, Color, BLENDMODE_LINEAR);
+
+        CHECK(memcmp(Once, Pixels, sizeof(Pixels)) == 0);
+
+        DrawCapsule(&Target, Middle, Middle, Width, Color, BLENDMODE_LINEAR);
+
+        DrawCapsule(&Target, From, Middle, Width, Color, BLENDMODE_LINEAR);
+
+        for (UINT32 Index = 0; Index < RASTER_TEST_WIDTH * RASTER_TEST_HEIGHT; Index++)
+        {
+            // A pixel is only drawn on again if it's covered more than it was.
+            if (Coverage[Index] > OnceCoverage[Index] + 2 || (Coverage[Index] == OnceCoverage[Index] && Pixels[Index] != Once[Index]))
+            {
+                fprintf(stderr, "capsule from %g,%g to %g,%g, %g wide, darkened where it was drawn over itself\n", From.X, From.Y, To.X, To.Y, Width);
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+    }
+}
+
+
+static void ReportSpeed(const char* What, float Width, double Seconds)
+{
+    printf("%-16s %2.0f px wide  %7.3f ms  %9.0f primitives/s\n", What, Width, Seconds * 1000.0, RASTER_BENCH_SHAPES / Seconds);
+}
+
+
+// Times each kind of shape that the box and arrow tools draw, at the sizes that people draw them, 1, 2 and 8
+// pixels wide. The arrow heads are filled on their own, without their lines.
+static void BenchShapes(void)
+{
+    static const char* Names[] = { "DrawLine", "DrawBox", "DrawEllipse", "arrow head fill" };
+
+    static const float Widths[] = { 1.0f, 2.0f, 8.0f };
+
+    UINT32* Pixels = malloc((SIZE_T)RASTER_BENCH_WIDTH * RASTER_BENCH_HEIGHT * sizeof(UINT32));
+
+    RASTERPOINT* From = malloc(RASTER_BENCH_SHAPES * sizeof(RASTERPOINT));
+
+    RASTERPOINT* To = malloc(RASTER_BENCH_SHAPES * sizeof(RASTERPOINT));
+
+    RASTERTARGET Target = { Pixels, RASTER_BENCH_WIDTH, { 0, 0, RASTER_BENCH_WIDTH, RASTER_BENCH_HEIGHT }, NULL };
+
+    for (UINT32 Index = 0; Index < RASTER_BENCH_WIDTH * RASTER_BENCH_HEIGHT; Index++)
+    {
+        Pixels[Index] = 0xFF000000;
+    }
+
+    // From 20 to 400 pixels across, the same shapes for every width.
+    for (UINT32 Shape = 0; Shape < RASTER_BENCH_SHAPES; Shape++)
+    {
+        From[Shape].X = TestRandomRange(0, (RASTER_BENCH_WIDTH - 400) * 100) / 100.0f;
+
+        From[Shape].Y = TestRandomRange(0, (RASTER_BENCH_HEIGHT - 400) * 100) / 100.0f;
+
+        To[Shape].X = From[Shape].X + TestRandomRange(2000, 40000) / 100.0f;
+
+        To[Shape].Y = From[Shape].Y + TestRandomRange(2000, 40000) / 100.0f;
+    }
+
+    for (UINT32 Kind = 0; Kind < _countof(Names); Kind++)
+    {
+        for (UINT32 Size = 0; Size < _countof(Widths); Size++)
+        {
+            float Width = Widths[Size];
+
+            double Start = TestSeconds();
+
+            for (UINT32 Shape = 0; Shape < RASTER_BENCH_SHAPES; Shape++)
+            {
+                switch (Kind)
+                {
+                    case 0:
+                    {
+                        DrawLine(&Target, From[Shape], To[Shape], Width, 0xFFFF4000, BLENDMODE_SRGB);
+
+                        break;
+                    }
+                    case 1:
+                    {
+                        DrawBox(&Target, From[Shape], To[Shape], Width, 0xFFFF4000, BLENDMODE_SRGB);
+
+                        break;
+                    }
+                    case 2:
+                    {
+                        RASTERPOINT Center = { (From[Shape].X + To[Shape].X) / 2, (From[Shape].Y + To[Shape].Y) / 2 };
+
+                        DrawEllipse(&Target, Center, (To[Shape].X - From[Shape].X) / 2, (To[Shape].Y - From[Shape].Y) / 2, Width, 0xFFFF4000, BLENDMODE_SRGB);
+
+                        break;
+                    }
+                    default:
+                    {
+                        RASTERPOINT Head[3];
+
+                        if (GetArrowHead(From[Shape], To[Shape], Width, Head))
+                        {
+                            FillPolygon(&Target, Head, 3, 0xFFFF4000, BLENDMODE_SRGB);
+                        }
+
+                        break;
+                    }
+                }
+            }
+
+            ReportSpeed(Names[Kind], Width, TestSeconds() - Start);
+        }
+    }
+
+    free(To);
+
+    free(From);
+
+    free(Pixels);
+}
+
+
+int main(void)
+{
+    InitializeBlendTables();
+
+    TestResolveCoverage();
+
+    TestPolygonArea();
+
+    TestClipping();
+
+    TestCoverageBuffer();
+
+    BenchShapes();
+
+    return TestResult();
+}
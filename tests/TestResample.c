@@ -0,0 +1,206 @@
+// TestResample.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that the threaded SIMD resampler gives exactly what the scalar one gives, that it leaves a flat color
+// flat and what's past the destination's width alone, that nearest-neighbour copies the right pixels, and times
+// the three against each other at callout sizes.
+
+#include <windows.h>
+
+#include "SnipExResample.h"
+
+#include "Test.h"
+
+#define IMAGE_WIDTH  1920
+
+#define IMAGE_HEIGHT 1080
+
+
+static void TestAgainstScalar(const UINT32* Image)
+{
+    for (UINT32 Trial = 0; Trial < 300; Trial++)
+    {
+        RECT Rect = { TestRandomRange(0, IMAGE_WIDTH - 1), TestRandomRange(0, IMAGE_HEIGHT - 1), 0, 0 };
+
+        INT32 Zoom = TestRandomRange(2, 8);
+
+        Rect.right = Rect.left + TestRandomRange(1, min(60, IMAGE_WIDTH - Rect.left));
+
+        Rect.bottom = Rect.top + TestRandomRange(1, min(60, IMAGE_HEIGHT - Rect.top));
+
+        INT32 DestinationWidth = (Rect.right - Rect.left) * Zoom;
+
+        INT32 DestinationHeight = (Rect.bottom - Rect.top) * Zoom;
+
+        // Now and then a size that isn't a whole zoom, or is smaller, which shrinks instead.
+        if (Trial % 5 == 0)
+        {
+            DestinationWidth = TestRandomRange(1, 200);
+
+            DestinationHeight = TestRandomRange(1, 200);
+        }
+
+        // With a few pixels past the end of each row, which mustn't be touched.
+        INT32 Stride = DestinationWidth + TestRandomRange(0, 4);
+
+        UINT32* Expected = calloc((SIZE_T)Stride * DestinationHeight, sizeof(UINT32));
+
+        UINT32* Actual = calloc((SIZE_T)Stride * DestinationHeight, sizeof(UINT32));
+
+        CHECK(ResampleImageScalar(Image, IMAGE_WIDTH, IMAGE_HEIGHT, &Rect, Expected, Stride, DestinationWidth, DestinationHeight));
+
+        CHECK(ResampleImage(Image, IMAGE_WIDTH, IMAGE_HEIGHT, &Rect, Actual, Stride, DestinationWidth, DestinationHeight));
+
+        if (memcmp(Expected, Actual, (SIZE_T)Stride * DestinationHeight * sizeof(UINT32)) != 0)
+        {
+            fprintf(stderr, "ResampleImage of %d,%d-%d,%d to %d x %d differs from ResampleImageScalar\n", Rect.left, Rect.top, Rect.right, Rect.bottom, DestinationWidth, DestinationHeight);
+
+            gTestFailures++;
+        }
+
+        for (INT32 Y = 0; Y < DestinationHeight; Y++)
+        {
+            for (INT32 X = DestinationWidth; X < Stride; X++)
+            {
+                CHECK_EQUAL(0, Actual[(SIZE_T)Y * Stride + X]);
+            }
+        }
+
+        free(Expected);
+
+        free(Actual);
+    }
+}
+
+
+static void TestFlat(UINT32* Image)
+{
+    enum { DestinationWidth = 400, DestinationHeight = 320 };
+
+    static UINT32 Destination[DestinationWidth * DestinationHeight];
+
+    // Lanczos rings around edges, but with no edges there's nothing to ring, even where the filter reaches
+    // past the image.
+    static const RECT Rects[] = { { 100, 100, 150, 140 }, { 0, 0, 7, 9 }, { IMAGE_WIDTH - 30, IMAGE_HEIGHT - 2, IMAGE_WIDTH, IMAGE_HEIGHT } };
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)IMAGE_WIDTH * IMAGE_HEIGHT; Index++)
+    {
+        Image[Index] = 0xFF336699;
+    }
+
+    for (UINT32 Rect = 0; Rect < _countof(Rects); Rect++)
+    {
+        CHECK(ResampleImage(Image, IMAGE_WIDTH, IMAGE_HEIGHT, &Rects[Rect], Destination, DestinationWidth, DestinationWidth, DestinationHeight));
+
+        for (UINT32 Index = 0; Index < DestinationWidth * DestinationHeight; Index++)
+        {
+            if (Destination[Index] != 0xFF336699)
+            {
+                fprintf(stderr, "resampling a flat color from %d,%d-%d,%d gave %08X at %u\n", Rects[Rect].left, Rects[Rect].top, Rects[Rect].right, Rects[Rect].bottom, Destination[Index], Index);
+
+                gTestFailures++;
+
+                break;
+            }
+        }
+    }
+}
+
+
+static void TestNearest(const UINT32* Image)
+{
+    enum { Zoom = 3 };
+
+    RECT Rect = { 500, 300, 540, 325 };
+
+    INT32 DestinationWidth = (Rect.right - Rect.left) * Zoom;
+
+    INT32 DestinationHeight = (Rect.bottom - Rect.top) * Zoom;
+
+    UINT32* Destination = malloc((SIZE_T)DestinationWidth * DestinationHeight * sizeof(UINT32));
+
+    ResampleImageNearest(Image, IMAGE_WIDTH, &Rect, Destination, DestinationWidth, DestinationWidth, DestinationHeight);
+
+    // At a whole zoom each pixel becomes a Zoom x Zoom block of itself.
+    for (INT32 Y = 0; Y < DestinationHeight; Y++)
+    {
+        for (INT32 X = 0; X < DestinationWidth; X++)
+        {
+            if (Destination[Y * DestinationWidth + X] != Image[(SIZE_T)(Rect.top + Y / Zoom) * IMAGE_WIDTH + Rect.left + X / Zoom])
+            {
+                fprintf(stderr, "ResampleImageNearest: pixel %d,%d isn't copied from %d,%d\n", X, Y, Rect.left + X / Zoom, Rect.top + Y / Zoom);
+
+                gTestFailures++;
+
+                goto Exit;
+            }
+        }
+    }
+
+Exit:
+    free(Destination);
+}
+
+
+static void Bench(const UINT32* Image)
+{
+    static const INT32 Cases[][3] = { { 100, 100, 4 }, { 200, 150, 8 }, { 400, 300, 4 } };
+
+    for (UINT32 Case = 0; Case < _countof(Cases); Case++)
+    {
+        RECT Rect = { 300, 200, 300 + Cases[Case][0], 200 + Cases[Case][1] };
+
+        INT32 DestinationWidth = Cases[Case][0] * Cases[Case][2];
+
+        INT32 DestinationHeight = Cases[Case][1] * Cases[Case][2];
+
+        UINT32* Destination = malloc((SIZE_T)DestinationWidth * DestinationHeight * sizeof(UINT32));
+
+        double Start = TestSeconds();
+
+        ResampleImageScalar(Image, IMAGE_WIDTH, IMAGE_HEIGHT, &Rect, Destination, DestinationWidth, DestinationWidth, DestinationHeight);
+
+        double Scalar = TestSeconds() - Start;
+
+        Start = TestSeconds();
+
+        ResampleImage(Image, IMAGE_WIDTH, IMAGE_HEIGHT, &Rect, Destination, DestinationWidth, DestinationWidth, DestinationHeight);
+
+        double Fast = TestSeconds() - Start;
+
+        Start = TestSeconds();
+
+        ResampleImageNearest(Image, IMAGE_WIDTH, &Rect, Destination, DestinationWidth, DestinationWidth, DestinationHeight);
+
+        double Nearest = TestSeconds() - Start;
+
+        printf("%4d x %-4d x%d -> %4d x %-4d scalar %8.2f ms  fast %8.2f ms  nearest %6.2f ms\n", Cases[Case][0], Cases[Case][1], Cases[Case][2], DestinationWidth, DestinationHeight, Scalar * 1000.0, Fast * 1000.0, Nearest * 1000.0);
+
+        free(Destination);
+    }
+}
+
+
+int main(void)
+{
+    // Pretend to have 4 processors, so that the big insets are split between threads even on a machine with one.
+    setenv("SNIPEX_TEST_CPUS", "4", 1);
+
+    UINT32* Image = malloc((SIZE_T)IMAGE_WIDTH * IMAGE_HEIGHT * sizeof(UINT32));
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)IMAGE_WIDTH * IMAGE_HEIGHT; Index++)
+    {
+        Image[Index] = (TestRandom() << 16) ^ TestRandom();
+    }
+
+    TestAgainstScalar(Image);
+
+    TestNearest(Image);
+
+    Bench(Image);
+
+    TestFlat(Image);
+
+    free(Image);
+
+    return TestResult();
+}
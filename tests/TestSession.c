@@ -0,0 +1,480 @@
+// TestSession.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Records a few hundred random changes, undos and redos to a session file, and checks that replaying it puts the
+// document back exactly as it was, and that a replay records the same session again. Then cuts the file short and
+// damages it in a couple of hundred ways, and kills the process that's writing it at random moments, mid-batch, and
+// checks that whatever is left always replays to a state that the document was really in, and never to anything
+// else.
+
+#include <windows.h>
+
+#include <signal.h>
+
+#include <sys/wait.h>
+
+#include "SnipExStroke.h"
+
+#include "SnipExCoverage.h"
+
+#include "SnipExBlend.h"
+
+#include "SnipExRaster.h"
+
+#include "SnipExBrush.h"
+
+#include "SnipExPen.h"
+
+#include "SnipExFlood.h"
+
+#include "SnipExResample.h"
+
+#include "SnipExJournal.h"
+
+#include "SnipExSession.h"
+
+#include "SnipExDocument.h"
+
+#include "Test.h"
+
+#include "TestEdits.h"
+
+#define SNIP_WIDTH  333
+
+#define SNIP_HEIGHT 251
+
+#define SNIP_BYTES  ((SIZE_T)SNIP_WIDTH * SNIP_HEIGHT * sizeof(UINT32))
+
+#define OPERATIONS  400
+
+#define KILLS       20
+
+// Every state that the document was in while the operations were made, oldest first.
+static UINT64 gStates[OPERATIONS * 2 + 1];
+
+static UINT32 gStateCount;
+
+
+static UINT64 HashDocument(const DOCUMENT* Document)
+{
+    UINT64 Hash = 14695981039346656037ull;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Document->Width * Document->Height; Index++)
+    {
+        Hash = (Hash ^ Document->Raster[Index]) * 1099511628211ull;
+    }
+
+    for (UINT32 Index = 0; Index < Document->Count; Index++)
+    {
+        const ANNOTATION* Annotation = Document->Annotations[Index];
+
+        Hash = (Hash ^ Annotation->Type ^ ((UINT64)Annotation->PointCount << 8) ^ ((UINT64)Annotation->PenPointCount << 32)) * 1099511628211ull;
+    }
+
+    return (Hash ^ ((UINT64)Document->Count << 40) ^ Document->RedoCount) * 1099511628211ull;
+}
+
+
+static void RememberState(DOCUMENT* Document)
+{
+    gStates[gStateCount++] = HashDocument(Document);
+}
+
+
+static BOOL IsRememberedState(UINT64 Hash, UINT32* Index)
+{
+    for (UINT32 State = 0; State < gStateCount; State++)
+    {
+        if (gStates[State] == Hash)
+        {
+            *Index = State;
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+static void MakeSnip(UINT32* Base, UINT32* Source)
+{
+    for (SIZE_T Index = 0; Index < (SIZE_T)SNIP_WIDTH * SNIP_HEIGHT; Index++)
+    {
+        INT32 X = (INT32)(Index % SNIP_WIDTH);
+
+        INT32 Y = (INT32)(Index / SNIP_WIDTH);
+
+        Base[Index] = ((X / 20 + Y / 20) % 3) ? 0xFF203040 : 0xFFE0E0E0;
+
+        Source[Index] = 0xFF000000 | (UINT32)(Index * 40503u);
+    }
+}
+
+
+// Makes the same operations every time it's called: changes mostly, with undos and redos in between. If Slowly is
+// set, it pauses now and then, so that the writer writes the records in lots of small batches.
+static void MakeOperations(DOCUMENT* Document, const UINT32* Source, BOOL Slowly)
+{
+    gTestRandom = 0x2545F4914F6CDD1Dull;
+
+    for (UINT32 Operation = 0; Operation < OPERATIONS; Operation++)
+    {
+        RECT Damage;
+
+        UINT32 Kind = TestRandom() % 10;
+
+        if (Kind < 6)
+        {
+            AddRandomChange(Document, Source);
+        }
+        else if (Kind < 8)
+        {
+            UndoDocumentStep(Document, &Damage);
+        }
+        else
+        {
+            RedoDocumentStep(Document, &Damage);
+        }
+
+        if (gOnPartOfChange != NULL)
+        {
+            gOnPartOfChange(Document);
+        }
+
+        if (Slowly && Operation % 7 == 0)
+        {
+            usleep(200);
+        }
+    }
+}
+
+
+// Replays Size bytes of a session onto a new document, and records it again at RecordPath, if that's set. Returns
+// FALSE if there wasn't a whole snip to replay onto.
+static BOOL Replay(const UINT8* Data, SIZE_T Size, const wchar_t* RecordPath, UINT64* Hash, UINT32* Records, double* Seconds)
+{
+    SESSIONREADER Reader;
+
+    BOOL Replayed = FALSE;
+
+    double Start = TestSeconds();
+
+    if (BeginSessionRead(&Reader, Data, Size))
+    {
+        CHECK(Reader.Width == SNIP_WIDTH && Reader.Height == SNIP_HEIGHT);
+
+        UINT32* Raster = malloc((SIZE_T)Reader.Width * Reader.Height * sizeof(UINT32));
+
+        if (ReadSessionBase(&Reader, Raster))
+        {
+            DOCUMENT Document;
+
+            SESSION Session;
+
+            CHECK(InitializeDocument(&Document, Raster, Reader.Width, Reader.Height, 64 * 1024 * 1024, NULL, NULL));
+
+            if (RecordPath != NULL)
+            {
+                CHECK(OpenSession(&Session, RecordPath, Document.Base, Document.Width, Document.Height));
+
+                Document.Session = &Session;
+            }
+
+            *Records = ReplayDocumentSession(&Document, &Reader);
+
+            *Seconds = TestSeconds() - Start;
+
+            *Hash = HashDocument(&Document);
+
+            if (RecordPath != NULL)
+            {
+                CloseSession(&Session, FALSE);
+            }
+
+            FreeDocument(&Document);
+
+            Replayed = TRUE;
+        }
+
+        free(Raster);
+
+        EndSessionRead(&Reader);
+    }
+
+    return Replayed;
+}
+
+
+static void GetSessionPath(wchar_t* Path, const wchar_t* Prefix)
+{
+    wchar_t Directory[MAX_PATH];
+
+    CHECK(GetTempPathW(MAX_PATH, Directory) > 0);
+
+    CHECK(GetTempFileNameW(Directory, Prefix, 0, Path) != 0);
+}
+
+
+// Records the operations, and replays them, and replays the replay. Leaves the session in Data, for the next tests.
+static void TestRecordAndReplay(UINT8** Data, SIZE_T* Size)
+{
+    UINT32* Base = malloc(SNIP_BYTES);
+
+    UINT32* Source = malloc(SNIP_BYTES);
+
+    wchar_t Path[MAX_PATH];
+
+    wchar_t RecordedAgainPath[MAX_PATH];
+
+    DOCUMENT Document;
+
+    SESSION Session;
+
+    UINT64 Hash = 0;
+
+    UINT32 Records = 0;
+
+    double Seconds = 0.0;
+
+    MakeSnip(Base, Source);
+
+    GetSessionPath(Path, L"snx");
+
+    GetSessionPath(RecordedAgainPath, L"snx");
+
+    CHECK(InitializeDocument(&Document, Base, SNIP_WIDTH, SNIP_HEIGHT, 64 * 1024 * 1024, NULL, NULL));
+
+    CHECK(OpenSession(&Session, Path, Document.Base, SNIP_WIDTH, SNIP_HEIGHT));
+
+    Document.Session = &Session;
+
+    gOnPartOfChange = RememberState;
+
+    RememberState(&Document);
+
+    double Start = TestSeconds();
+
+    MakeOperations(&Document, Source, FALSE);
+
+    double Recording = TestSeconds() - Start;
+
+    gOnPartOfChange = NULL;
+
+    CloseSession(&Session, FALSE);
+
+    FreeDocument(&Document);
+
+    CHECK(LoadSessionFile(Path, Data, Size));
+
+    CHECK(Replay(*Data, *Size, RecordedAgainPath, &Hash, &Records, &Seconds));
+
+    printf("%u operations made in %.2f ms with a session, %zu KB of it, replayed %u records in %.2f ms\n", OPERATIONS, Recording * 1000.0, *Size / 1024, Records, Seconds * 1000.0);
+
+    if (Hash != gStates[gStateCount - 1])
+    {
+        fprintf(stderr, "replaying the session doesn't give the document back as it was\n");
+
+        gTestFailures++;
+    }
+
+    // A replay records each change again, so recovering from that, after a second crash, gets the same document.
+    UINT8* RecordedAgain = NULL;
+
+    SIZE_T RecordedAgainSize = 0;
+
+    CHECK(LoadSessionFile(RecordedAgainPath, &RecordedAgain, &RecordedAgainSize));
+
+    CHECK(Replay(RecordedAgain, RecordedAgainSize, NULL, &Hash, &Records, &Seconds));
+
+    if (Hash != gStates[gStateCount - 1])
+    {
+        fprintf(stderr, "replaying the session that a replay recorded doesn't give the document back as it was\n");
+
+        gTestFailures++;
+    }
+
+    HeapFree(GetProcessHeap(), 0, RecordedAgain);
+
+    DeleteFileW(RecordedAgainPath);
+
+    DeleteFileW(Path);
+
+    free(Source);
+
+    free(Base);
+}
+
+
+// Whatever is left of a damaged session replays to a state the document was in, or not at all.
+static void TestDamage(const UINT8* Data, SIZE_T Size)
+{
+    UINT8* Damaged = malloc(Size + 8);
+
+    UINT32 Unreadable = 0;
+
+    UINT32 Trial = 0;
+
+    for (Trial = 0; Trial < 200; Trial++)
+    {
+        UINT64 Hash = 0;
+
+        UINT32 Records = 0;
+
+        UINT32 State = 0;
+
+        double Seconds = 0.0;
+
+        SIZE_T DamagedSize = Size;
+
+        memcpy(Damaged, Data, Size);
+
+        // Cut short, sometimes with a little garbage after, the way a sector that was never written reads back;
+        // or with a byte changed somewhere.
+        if (Trial % 2 == 0)
+        {
+            DamagedSize = (SIZE_T)TestRandom() % (Size + 1);
+
+            if (Trial % 3 == 0)
+            {
+                for (UINT32 Extra = 0; Extra < 8; Extra++)
+                {
+                    Damaged[DamagedSize++] = (UINT8)TestRandom();
+                }
+            }
+        }
+        else
+        {
+            Damaged[TestRandom() % Size] ^= (UINT8)TestRandomRange(1, 255);
+        }
+
+        if (Replay(Damaged, DamagedSize, NULL, &Hash, &Records, &Seconds) == FALSE)
+        {
+            Unreadable++;
+        }
+        else if (IsRememberedState(Hash, &State) == FALSE)
+        {
+            fprintf(stderr, "session damaged in trial %u replays to a state the document was never in\n", Trial);
+
+            gTestFailures++;
+        }
+    }
+
+    printf("%u damaged sessions: %u without a whole snip, the rest replayed to a state the document was in\n", Trial, Unreadable);
+
+    free(Damaged);
+}
+
+
+// Kills the process that's writing a session at a random moment while it's making the operations, and checks that
+// what it had written by then replays to a state the document was in.
+static void TestKill(void)
+{
+    UINT32 Recovered = 0;
+
+    UINT32 Operations = 0;
+
+    for (UINT32 Kill = 0; Kill < KILLS; Kill++)
+    {
+        wchar_t Path[MAX_PATH];
+
+        GetSessionPath(Path, L"snx");
+
+        fflush(stdout);
+
+        pid_t Writer = fork();
+
+        if (Writer == 0)
+        {
+            UINT32* Base = malloc(SNIP_BYTES);
+
+            UINT32* Source = malloc(SNIP_BYTES);
+
+            DOCUMENT Document;
+
+            SESSION Session;
+
+            MakeSnip(Base, Source);
+
+            InitializeDocument(&Document, Base, SNIP_WIDTH, SNIP_HEIGHT, 64 * 1024 * 1024, NULL, NULL);
+
+            OpenSession(&Session, Path, Document.Base, SNIP_WIDTH, SNIP_HEIGHT);
+
+            Document.Session = &Session;
+
+            MakeOperations(&Document, Source, TRUE);
+
+            for (;;)
+            {
+                pause();
+            }
+        }
+
+        CHECK(Writer > 0);
+
+        usleep(2000 + TestRandom() % (OPERATIONS * 250));
+
+        kill(Writer, SIGKILL);
+
+        waitpid(Writer, NULL, 0);
+
+        UINT8* Data = NULL;
+
+        SIZE_T Size = 0;
+
+        UINT64 Hash = 0;
+
+        UINT32 Records = 0;
+
+        UINT32 State = 0;
+
+        double Seconds = 0.0;
+
+        if (LoadSessionFile(Path, &Data, &Size))
+        {
+            if (Replay(Data, Size, NULL, &Hash, &Records, &Seconds))
+            {
+                if (IsRememberedState(Hash, &State))
+                {
+                    Recovered++;
+
+                    Operations += State;
+                }
+                else
+                {
+                    fprintf(stderr, "a session whose writer was killed replays to a state the document was never in\n");
+
+                    gTestFailures++;
+                }
+            }
+
+            HeapFree(GetProcessHeap(), 0, Data);
+        }
+
+        DeleteFileW(Path);
+    }
+
+    printf("writer killed %u times: recovered %u times, on average to state %u of %u\n", KILLS, Recovered, (Recovered > 0) ? Operations / Recovered : 0, gStateCount - 1);
+}
+
+
+int main(void)
+{
+    UINT8* Data = NULL;
+
+    SIZE_T Size = 0;
+
+    InitializeBlendTables();
+
+    TestRecordAndReplay(&Data, &Size);
+
+    if (Data != NULL)
+    {
+        TestDamage(Data, Size);
+
+        HeapFree(GetProcessHeap(), 0, Data);
+    }
+
+    TestKill();
+
+    return TestResult();
+}
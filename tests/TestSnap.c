@@ -0,0 +1,591 @@
+// TestSnap.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks the edge finding that the capture selection snaps to against the slow way of doing each part: the vector
+// edge rows against the scalar ones, brightness against the formula, the mask against one worked out pixel by
+// pixel, the lists against runs found one pixel at a time, and each snap against looking along every row or column
+// in range. Then times each part on a frame the size of three 4K monitors.
+
+#include <windows.h>
+
+#include "SnipExSnap.h"
+
+#include "Test.h"
+
+#include "TestFrames.h"
+
+
+static UINT8 GetBrightness(UINT32 Pixel)
+{
+    return (UINT8)(((((Pixel >> 16) & 0xFF) * 77) + (((Pixel >> 8) & 0xFF) * 150) + ((Pixel & 0xFF) * 29)) >> 8);
+}
+
+
+static INT32 GetPixelBrightness(const UINT32* Pixels, INT32 Width, INT32 X, INT32 Y)
+{
+    return GetBrightness(Pixels[(SIZE_T)Y * Width + X]);
+}
+
+
+// Where the pixel Position along Line is in the mask, when the lines are columns or when they're rows.
+static SIZE_T GetMaskIndex(BOOL Columns, INT32 Width, INT32 Line, INT32 Position)
+{
+    return Columns ? (SIZE_T)Position * Width + Line : (SIZE_T)Line * Width + Position;
+}
+
+
+// Flat windows with noise on a noisy background, so that there are long edges and short ones.
+static void MakeScreenshot(UINT32* Pixels, INT32 Width, INT32 Height)
+{
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Pixels[Index] = 0xFF000000 | ((TestRandom() % 3) ? 0x808080 : ((TestRandom() << 8) ^ TestRandom()));
+    }
+
+    for (INT32 Window = TestRandomRange(0, 11); Window > 0; Window--)
+    {
+        INT32 Left = TestRandomRange(0, Width - 1);
+
+        INT32 Top = TestRandomRange(0, Height - 1);
+
+        INT32 Right = TestRandomRange(Left + 1, Width);
+
+        INT32 Bottom = TestRandomRange(Top + 1, Height);
+
+        UINT32 Fill = 0xFF000000 | ((TestRandom() << 8) ^ TestRandom());
+
+        for (INT32 Y = Top; Y < Bottom; Y++)
+        {
+            for (INT32 X = Left; X < Right; X++)
+            {
+                Pixels[(SIZE_T)Y * Width + X] = (TestRandom() % 50) ? Fill : (0xFF000000 | TestRandom());
+            }
+        }
+    }
+}
+
+
+// The SNAPEDGE_ flags of every pixel, worked out one pixel at a time straight from the screenshot.
+static void GetMaskSlowly(const UINT32* Pixels, INT32 Width, INT32 Height, UINT8* Mask)
+{
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        INT32 Up = max(Y - 1, 0);
+
+        INT32 Down = min(Y + 1, Height - 1);
+
+        for (INT32 X = 0; X < Width; X++)
+        {
+            INT32 Left = max(X - 1, 0);
+
+            INT32 Right = min(X + 1, Width - 1);
+
+            INT32 Here = GetPixelBrightness(Pixels, Width, X, Up) + 2 * GetPixelBrightness(Pixels, Width, X, Y) + GetPixelBrightness(Pixels, Width, X, Down);
+
+            INT32 ToTheLeft = GetPixelBrightness(Pixels, Width, Left, Up) + 2 * GetPixelBrightness(Pixels, Width, Left, Y) + GetPixelBrightness(Pixels, Width, Left, Down);
+
+            // The first column has nothing to its left.
+            INT32 Across = (X == 0) ? 0 : Here - ToTheLeft;
+
+            INT32 Below = (GetPixelBrightness(Pixels, Width, Left, Y) - GetPixelBrightness(Pixels, Width, Left, Up)) +
+                2 * (GetPixelBrightness(Pixels, Width, X, Y) - GetPixelBrightness(Pixels, Width, X, Up)) +
+                (GetPixelBrightness(Pixels, Width, Right, Y) - GetPixelBrightness(Pixels, Width, Right, Up));
+
+            Mask[(SIZE_T)Y * Width + X] = (UINT8)((abs(Across) >= SNAP_EDGE_THRESHOLD ? SNAPEDGE_VERTICAL : 0) | (abs(Below) >= SNAP_EDGE_THRESHOLD ? SNAPEDGE_HORIZONTAL : 0));
+        }
+    }
+}
+
+
+// The mask the way the analysis makes it, a row at a time.
+static void GetMask(const UINT32* Pixels, INT32 Width, INT32 Height, UINT8* Mask)
+{
+    UINT8* Rows = malloc((SIZE_T)Width * 3);
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        GetBrightnessRow(Pixels, Width, Height, Y - 1, Rows);
+
+        GetBrightnessRow(Pixels, Width, Height, Y, Rows + Width);
+
+        GetBrightnessRow(Pixels, Width, Height, Y + 1, Rows + 2 * (SIZE_T)Width);
+
+        GetEdgeRow(Rows, Rows + Width, Rows + 2 * (SIZE_T)Width, Width, &Mask[(SIZE_T)Y * Width]);
+    }
+
+    free(Rows);
+}
+
+
+static void TestEdgeRows(void)
+{
+    enum { Most = 100, Guard = 16 };
+
+    UINT8 Above[Most + 8];
+
+    UINT8 Middle[Most + 8];
+
+    UINT8 Below[Most + 8];
+
+    UINT8 Expected[Most + Guard];
+
+    UINT8 Actual[Most + 8 + Guard];
+
+    for (UINT32 Trial = 0; Trial < 100000; Trial++)
+    {
+        INT32 Width = TestRandomRange(1, Most);
+
+        // Rows that don't start on an 8 byte boundary.
+        INT32 Offset = TestRandomRange(0, 7);
+
+        // Steps of all heights, some just either side of the threshold, and flat stretches between them.
+        for (INT32 X = 0; X < Width + Offset; X++)
+        {
+            Above[X] = (UINT8)((TestRandom() % 4) ? 100 : TestRandom());
+
+            Middle[X] = (UINT8)((TestRandom() % 4) ? Above[X] + TestRandomRange(-40, 40) : TestRandom());
+
+            Below[X] = (UINT8)((TestRandom() % 4) ? Middle[X] : TestRandom());
+        }
+
+        memset(Expected, 0xCD, sizeof(Expected));
+
+        memset(Actual, 0xCD, sizeof(Actual));
+
+        GetEdgeRowScalar(&Above[Offset], &Middle[Offset], &Below[Offset], Width, 0, Width, Expected);
+
+        GetEdgeRow(&Above[Offset], &Middle[Offset], &Below[Offset], Width, &Actual[Offset]);
+
+        if (memcmp(Expected, &Actual[Offset], (SIZE_T)Width + Guard) != 0)
+        {
+            fprintf(stderr, "GetEdgeRow of %d bytes from offset %d isn't what GetEdgeRowScalar gives, or wrote past the end\n", Width, Offset);
+
+            gTestFailures++;
+
+            return;
+        }
+    }
+}
+
+
+static void TestBrightnessRows(void)
+{
+    for (UINT32 Trial = 0; Trial < 2000; Trial++)
+    {
+        INT32 Width = TestRandomRange(1, 70);
+
+        INT32 Height = TestRandomRange(1, 5);
+
+        UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+        UINT8* Row = malloc((SIZE_T)Width + 1);
+
+        for (INT32 Index = 0; Index < Width * Height; Index++)
+        {
+            Pixels[Index] = (TestRandom() << 8) ^ TestRandom();
+        }
+
+        // Rows off of the top and the bottom are the edge rows.
+        for (INT32 Y = -3; Y < Height + 3; Y++)
+        {
+            INT32 Source = max(0, min(Y, Height - 1));
+
+            Row[Width] = 0xCD;
+
+            GetBrightnessRow(Pixels, Width, Height, Y, Row);
+
+            CHECK(Row[Width] == 0xCD);
+
+            for (INT32 X = 0; X < Width; X++)
+            {
+                if (Row[X] != GetBrightness(Pixels[(SIZE_T)Source * Width + X]))
+                {
+                    fprintf(stderr, "GetBrightnessRow of row %d of %d x %d is %u at %d, not %u\n", Y, Width, Height, Row[X], X, GetBrightness(Pixels[(SIZE_T)Source * Width + X]));
+
+                    gTestFailures++;
+
+                    break;
+                }
+            }
+        }
+
+        free(Row);
+
+        free(Pixels);
+    }
+}
+
+
+// Each pixel of Kept is 1 if it's on a run of Flag at least SNAP_MIN_LENGTH long, down the columns for vertical
+// edges or along the rows for horizontal ones.
+static void GetKeptSlowly(const UINT8* Mask, INT32 Width, INT32 Height, UINT8 Flag, UINT8* Kept)
+{
+    BOOL Down = (Flag == SNAPEDGE_VERTICAL);
+
+    INT32 Lines = Down ? Width : Height;
+
+    INT32 Length = Down ? Height : Width;
+
+    memset(Kept, 0, (SIZE_T)Width * Height);
+
+    for (INT32 Line = 0; Line < Lines; Line++)
+    {
+        INT32 Position = 0;
+
+        while (Position < Length)
+        {
+            if ((Mask[GetMaskIndex(Down, Width, Line, Position)] & Flag) == 0)
+            {
+                Position++;
+
+                continue;
+            }
+
+            INT32 Start = Position;
+
+            while (Position < Length && (Mask[GetMaskIndex(Down, Width, Line, Position)] & Flag))
+            {
+                Position++;
+            }
+
+            for (INT32 Run = Start; Position - Start >= SNAP_MIN_LENGTH && Run < Position; Run++)
+            {
+                Kept[GetMaskIndex(Down, Width, Line, Run)] = 1;
+            }
+        }
+    }
+}
+
+
+// Whether each list has exactly the kept pixels of its row or column, in order.
+static BOOL IsSameLists(const SNAPEDGES* Edges, const UINT8* Vertical, const UINT8* Horizontal)
+{
+    INT32 Width = Edges->Width;
+
+    INT32 Height = Edges->Height;
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        UINT32 Next = Edges->RowStart[Y];
+
+        for (INT32 X = 0; X < Width; X++)
+        {
+            if (Vertical[(SIZE_T)Y * Width + X] && (Next >= Edges->RowStart[Y + 1] || Edges->Columns[Next++] != X))
+            {
+                return FALSE;
+            }
+        }
+
+        if (Next != Edges->RowStart[Y + 1])
+        {
+            return FALSE;
+        }
+    }
+
+    for (INT32 X = 0; X < Width; X++)
+    {
+        UINT32 Next = Edges->ColumnStart[X];
+
+        for (INT32 Y = 0; Y < Height; Y++)
+        {
+            if (Horizontal[(SIZE_T)Y * Width + X] && (Next >= Edges->ColumnStart[X + 1] || Edges->Rows[Next++] != Y))
+            {
+                return FALSE;
+            }
+        }
+
+        if (Next != Edges->ColumnStart[X + 1])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+// Looks along each line within Distance of Line, nearest first and the one before it first when two are as near,
+// for the kept pixel nearest to Position: at or after it first, then before it. Lines and positions are rows and
+// columns for vertical edges, or columns and rows for horizontal ones.
+static BOOL SnapSlowly(const UINT8* Kept, INT32 Width, INT32 Height, BOOL Vertical, INT32 Line, INT32 Position, INT32 Distance, INT32* Snapped)
+{
+    INT32 Lines = Vertical ? Height : Width;
+
+    INT32 Length = Vertical ? Width : Height;
+
+    INT32 Nearest = Distance + 1;
+
+    *Snapped = Position;
+
+    for (INT32 Offset = 0; Offset <= Distance; Offset++)
+    {
+        for (INT32 Side = 0; Side < ((Offset == 0) ? 1 : 2); Side++)
+        {
+            INT32 Index = (Side == 0) ? Line - Offset : Line + Offset;
+
+            if (Index < 0 || Index >= Lines)
+            {
+                continue;
+            }
+
+            for (INT32 Next = max(Position, 0); Next < Length && Next - Position < Nearest; Next++)
+            {
+                if (Kept[GetMaskIndex(Vertical == FALSE, Width, Index, Next)])
+                {
+                    Nearest = Next - Position;
+
+                    *Snapped = Next;
+
+                    break;
+                }
+            }
+
+            for (INT32 Next = min(Position - 1, Length - 1); Next >= 0 && Position - Next < Nearest; Next--)
+            {
+                if (Kept[GetMaskIndex(Vertical == FALSE, Width, Index, Next)])
+                {
+                    Nearest = Position - Next;
+
+                    *Snapped = Next;
+
+                    break;
+                }
+            }
+        }
+    }
+
+    return (Nearest <= Distance);
+}
+
+
+static void TestEdges(void)
+{
+    for (UINT32 Trial = 0; Trial < 1500; Trial++)
+    {
+        INT32 Width = TestRandomRange(1, (Trial % 3) ? 200 : 40);
+
+        INT32 Height = TestRandomRange(1, (Trial % 2) ? 150 : 30);
+
+        SIZE_T Count = (SIZE_T)Width * Height;
+
+        UINT32* Pixels = malloc(Count * sizeof(UINT32));
+
+        UINT8* Mask = malloc(Count);
+
+        UINT8* Expected = malloc(Count);
+
+        UINT8* Vertical = malloc(Count);
+
+        UINT8* Horizontal = malloc(Count);
+
+        SNAPEDGES Edges;
+
+        MakeScreenshot(Pixels, Width, Height);
+
+        GetMask(Pixels, Width, Height, Mask);
+
+        GetMaskSlowly(Pixels, Width, Height, Expected);
+
+        if (memcmp(Expected, Mask, Count) != 0)
+        {
+            fprintf(stderr, "the edge mask of %d x %d isn't the one worked out pixel by pixel\n", Width, Height);
+
+            gTestFailures++;
+        }
+
+        GetKeptSlowly(Expected, Width, Height, SNAPEDGE_VERTICAL, Vertical);
+
+        GetKeptSlowly(Expected, Width, Height, SNAPEDGE_HORIZONTAL, Horizontal);
+
+        if (BuildSnapEdges(Mask, Width, Height, NULL, &Edges) == FALSE)
+        {
+            fprintf(stderr, "BuildSnapEdges of %d x %d failed\n", Width, Height);
+
+            gTestFailures++;
+        }
+        else if (IsSameLists(&Edges, Vertical, Horizontal) == FALSE)
+        {
+            fprintf(stderr, "the lists of edges of %d x %d aren't the long runs of the mask\n", Width, Height);
+
+            gTestFailures++;
+        }
+        else
+        {
+            // Including the mouse just off of the snip, which it can be while the selection is dragged.
+            for (UINT32 Query = 0; Query < 200; Query++)
+            {
+                INT32 X = TestRandomRange(-2, Width + 1);
+
+                INT32 Y = TestRandomRange(-2, Height + 1);
+
+                INT32 Distance = TestRandomRange(0, 9);
+
+                INT32 Expect;
+
+                INT32 Snapped;
+
+                BOOL Found = SnapSlowly(Vertical, Width, Height, TRUE, Y, X, Distance, &Expect);
+
+                if (SnapToVerticalEdge(&Edges, X, Y, Distance, &Snapped) != Found || Snapped != Expect)
+                {
+                    fprintf(stderr, "snapping %d,%d to a vertical edge within %d of %d x %d gave %d, not %d\n", X, Y, Distance, Width, Height, Snapped, Expect);
+
+                    gTestFailures++;
+
+                    break;
+                }
+
+                Found = SnapSlowly(Horizontal, Width, Height, FALSE, X, Y, Distance, &Expect);
+
+                if (SnapToHorizontalEdge(&Edges, X, Y, Distance, &Snapped) != Found || Snapped != Expect)
+                {
+                    fprintf(stderr, "snapping %d,%d to a horizontal edge within %d of %d x %d gave %d, not %d\n", X, Y, Distance, Width, Height, Snapped, Expect);
+
+                    gTestFailures++;
+
+                    break;
+                }
+            }
+        }
+
+        FreeSnapEdges(&Edges);
+
+        free(Horizontal);
+
+        free(Vertical);
+
+        free(Expected);
+
+        free(Mask);
+
+        free(Pixels);
+    }
+}
+
+
+// Lists that were given up on are empty, and snapping to them finds nothing.
+static void TestCancelled(void)
+{
+    enum { Width = 500, Height = 500 };
+
+    UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT8* Mask = malloc((SIZE_T)Width * Height);
+
+    volatile LONG Cancelled = TRUE;
+
+    SNAPEDGES Edges;
+
+    INT32 Snapped;
+
+    MakeTestDesktop(Pixels, Width, Height, 1);
+
+    GetMask(Pixels, Width, Height, Mask);
+
+    CHECK(BuildSnapEdges(Mask, Width, Height, &Cancelled, &Edges) == FALSE);
+
+    CHECK(Edges.RowStart == NULL && Edges.Columns == NULL && Edges.ColumnStart == NULL && Edges.Rows == NULL);
+
+    CHECK(SnapToVerticalEdge(&Edges, 10, 10, SNAP_DISTANCE, &Snapped) == FALSE && Snapped == 10);
+
+    CHECK(SnapToHorizontalEdge(&Edges, 10, 10, SNAP_DISTANCE, &Snapped) == FALSE && Snapped == 10);
+
+    // Too wide for the lists' 16 bit positions.
+    CHECK(BuildSnapEdges(Mask, 65536, 1, NULL, &Edges) == FALSE);
+
+    free(Mask);
+
+    free(Pixels);
+}
+
+
+// A frame the size of three 4K monitors side by side.
+static void Bench(void)
+{
+    enum { Width = 11520, Height = 2160, Queries = 1000000 };
+
+    UINT32* Pixels = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT8* Mask = malloc((SIZE_T)Width * Height);
+
+    UINT8* Rows = malloc((SIZE_T)Width * 3);
+
+    SNAPEDGES Edges;
+
+    UINT32 Found = 0;
+
+    MakeTestDesktop(Pixels, Width, Height, 3);
+
+    memset(Mask, 0, (SIZE_T)Width * Height);
+
+    double Start = TestSeconds();
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        GetBrightnessRow(Pixels, Width, Height, Y - 1, Rows);
+
+        GetBrightnessRow(Pixels, Width, Height, Y, Rows + Width);
+
+        GetBrightnessRow(Pixels, Width, Height, Y + 1, Rows + 2 * (SIZE_T)Width);
+
+        GetEdgeRowScalar(Rows, Rows + Width, Rows + 2 * (SIZE_T)Width, Width, 0, Width, &Mask[(SIZE_T)Y * Width]);
+    }
+
+    double Scalar = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    GetMask(Pixels, Width, Height, Mask);
+
+    double Vector = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    CHECK(BuildSnapEdges(Mask, Width, Height, NULL, &Edges));
+
+    double Lists = TestSeconds() - Start;
+
+    Start = TestSeconds();
+
+    for (UINT32 Query = 0; Query < Queries; Query++)
+    {
+        INT32 Snapped;
+
+        INT32 X = TestRandomRange(0, Width - 1);
+
+        INT32 Y = TestRandomRange(0, Height - 1);
+
+        Found += SnapToVerticalEdge(&Edges, X, Y, SNAP_DISTANCE, &Snapped);
+
+        Found += SnapToHorizontalEdge(&Edges, X, Y, SNAP_DISTANCE, &Snapped);
+    }
+
+    double Snaps = TestSeconds() - Start;
+
+    printf("%d x %d: mask %.1f ms with scalar edge rows, %.1f ms with vector ones; lists %.1f ms, %u vertical and %u horizontal edge pixels kept\n", Width, Height, Scalar * 1000.0, Vector * 1000.0, Lists * 1000.0, Edges.RowStart[Height], Edges.ColumnStart[Width]);
+
+    printf("%u snaps, %.0f ns each, %u found an edge\n", Queries * 2, Snaps * 1e9 / (Queries * 2), Found);
+
+    FreeSnapEdges(&Edges);
+
+    free(Rows);
+
+    free(Mask);
+
+    free(Pixels);
+}
+
+
+int main(void)
+{
+    TestEdgeRows();
+
+    TestBrightnessRows();
+
+    TestEdges();
+
+    TestCancelled();
+
+    Bench();
+
+    return TestResult();
+}
@@ -0,0 +1,222 @@
+// TestStroke.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks that a stroke between two mouse samples leaves no gaps: every pixel that the brush passes over on its way
+// from one to the other is in exactly one span, and the spans don't reach much further than that. Then times
+// StampStroke for mouse moves from 1 to 1024 pixels long.
+
+#include <windows.h>
+
+#include <math.h>
+
+#include "SnipExStroke.h"
+
+#include "Test.h"
+
+#define STROKE_CLIP_WIDTH  300
+
+#define STROKE_CLIP_HEIGHT 200
+
+typedef struct STROKETEST
+{
+    // How many times each pixel was stamped.
+    UINT8  Stamped[STROKE_CLIP_HEIGHT][STROKE_CLIP_WIDTH];
+
+    // Which pixels the brush passes over.
+    BOOL   Swept[STROKE_CLIP_HEIGHT][STROKE_CLIP_WIDTH];
+
+    INT32  LastY;
+
+    BOOL   OutOfOrder;
+
+} STROKETEST;
+
+
+static void Stamp(_In_reads_(Count) const SPAN* Spans, _In_ UINT32 Count, _In_opt_ void* Context)
+{
+    STROKETEST* Test = Context;
+
+    CHECK(Count > 0 && Count <= STROKE_BATCH_SIZE);
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        const SPAN* Span = &Spans[Index];
+
+        if (Span->Y < 0 || Span->Y >= STROKE_CLIP_HEIGHT || Span->Left < 0 || Span->Right > STROKE_CLIP_WIDTH || Span->Left >= Span->Right)
+        {
+            fprintf(stderr, "span %d: %d-%d isn't clipped\n", Span->Y, Span->Left, Span->Right);
+
+            gTestFailures++;
+
+            continue;
+        }
+
+        Test->OutOfOrder |= (Span->Y < Test->LastY);
+
+        Test->LastY = Span->Y;
+
+        for (INT32 X = Span->Left; X < Span->Right; X++)
+        {
+            Test->Stamped[Span->Y][X]++;
+        }
+    }
+}
+
+
+// Marks the pixels under the brush with its top-left corner at X, Y.
+static void Sweep(STROKETEST* Test, INT32 X, INT32 Y, INT32 BrushWidth, INT32 BrushHeight)
+{
+    for (INT32 Row = max(Y, 0); Row < min(Y + BrushHeight, STROKE_CLIP_HEIGHT); Row++)
+    {
+        for (INT32 Column = max(X, 0); Column < min(X + BrushWidth, STROKE_CLIP_WIDTH); Column++)
+        {
+            Test->Swept[Row][Column] = TRUE;
+        }
+    }
+}
+
+
+static void TestStroke(STROKETEST* Test, POINT From, POINT To, INT32 BrushWidth, INT32 BrushHeight)
+{
+    INT32 Steps = abs(To.x - From.x) + abs(To.y - From.y) + 1;
+
+    INT32 Extra = 0;
+
+    memset(Test, 0, sizeof(STROKETEST));
+
+    Test->LastY = MININT32;
+
+    StampStroke(From, To, BrushWidth, BrushHeight, STROKE_CLIP_WIDTH, STROKE_CLIP_HEIGHT, Stamp, Test);
+
+    // The brush stamped at every whole pixel along the way, which is what a mouse that reported every pixel it
+    // moved would have drawn.
+    for (INT32 Step = 0; Step <= Steps; Step++)
+    {
+        double Along = (double)Step / Steps;
+
+        Sweep(Test, (INT32)floor(From.x + (To.x - From.x) * Along + 0.5), (INT32)floor(From.y + (To.y - From.y) * Along + 0.5), BrushWidth, BrushHeight);
+    }
+
+    CHECK(Test->OutOfOrder == FALSE);
+
+    for (INT32 Y = 0; Y < STROKE_CLIP_HEIGHT; Y++)
+    {
+        for (INT32 X = 0; X < STROKE_CLIP_WIDTH; X++)
+        {
+            if (Test->Stamped[Y][X] > 1 || (Test->Swept[Y][X] && Test->Stamped[Y][X] == 0))
+            {
+                fprintf(stderr, "stroke %d,%d to %d,%d with a %d x %d brush: pixel %d,%d stamped %u times\n", From.x, From.y, To.x, To.y, BrushWidth, BrushHeight, X, Y, Test->Stamped[Y][X]);
+
+                gTestFailures++;
+
+                return;
+            }
+
+            Extra += (Test->Stamped[Y][X] && Test->Swept[Y][X] == FALSE);
+        }
+    }
+
+    // Sliding smoothly covers a little more than stepping a pixel at a time does, at most a pixel or so either
+    // side on each row.
+    if (Extra > 2 * (abs(To.y - From.y) + BrushHeight))
+    {
+        fprintf(stderr, "stroke %d,%d to %d,%d with a %d x %d brush covers %d pixels too many\n", From.x, From.y, To.x, To.y, BrushWidth, BrushHeight, Extra);
+
+        gTestFailures++;
+    }
+
+    // Every span of the stroke is somewhere in its bounds.
+    RECT Bounds;
+
+    GetStrokeBounds(From, To, BrushWidth, BrushHeight, &Bounds);
+
+    for (INT32 Y = 0; Y < STROKE_CLIP_HEIGHT; Y++)
+    {
+        for (INT32 X = 0; X < STROKE_CLIP_WIDTH; X++)
+        {
+            if (Test->Stamped[Y][X] && (X < Bounds.left || X >= Bounds.right || Y < Bounds.top || Y >= Bounds.bottom))
+            {
+                fprintf(stderr, "pixel %d,%d is outside the stroke's bounds\n", X, Y);
+
+                gTestFailures++;
+
+                return;
+            }
+        }
+    }
+}
+
+
+// Adds up the pixels, so that the spans are used and the time is all StampStroke's.
+static void CountPixels(_In_reads_(Count) const SPAN* Spans, _In_ UINT32 Count, _In_opt_ void* Context)
+{
+    UINT64* Pixels = Context;
+
+    for (UINT32 Index = 0; Index < Count; Index++)
+    {
+        *Pixels += (UINT64)(Spans[Index].Right - Spans[Index].Left);
+    }
+}
+
+
+// Times StampStroke with the hilighter's brush for mouse moves of each length, straight across and at an angle,
+// across a 4K snip, and prints what each move cost.
+static void BenchStroke(void)
+{
+    enum { Width = 3840, Height = 2160, BrushWidth = 10, BrushHeight = 20, Events = 20000 };
+
+    for (INT32 Length = 1; Length <= 1024; Length *= 4)
+    {
+        for (UINT32 Slanted = 0; Slanted < 2; Slanted++)
+        {
+            UINT64 Pixels = 0;
+
+            double Start = TestSeconds();
+
+            for (UINT32 Event = 0; Event < Events; Event++)
+            {
+                POINT From = { (INT32)(Event * 7 % (Width - Length - BrushWidth)), (INT32)(Event * 13 % (Height - Length - BrushHeight)) };
+
+                POINT To = { From.x + Length, From.y + (Slanted ? Length / 2 : 0) };
+
+                StampStroke(From, To, BrushWidth, BrushHeight, Width, Height, CountPixels, &Pixels);
+            }
+
+            double Seconds = TestSeconds() - Start;
+
+            printf("StampStroke %4d px %-8s %6.0f ns per mouse move, %5.2f ns per pixel\n", Length, Slanted ? "slanted" : "across", Seconds * 1e9 / Events, Seconds * 1e9 / (double)Pixels);
+        }
+    }
+}
+
+
+int main(void)
+{
+    static STROKETEST Test;
+
+    for (UINT32 Trial = 0; Trial < 5000; Trial++)
+    {
+        POINT From = { TestRandomRange(-20, STROKE_CLIP_WIDTH + 20), TestRandomRange(-20, STROKE_CLIP_HEIGHT + 20) };
+
+        POINT To = { TestRandomRange(-20, STROKE_CLIP_WIDTH + 20), TestRandomRange(-20, STROKE_CLIP_HEIGHT + 20) };
+
+        // Straight across and straight down are what the hilighter mostly draws.
+        if (Trial % 3 == 0)
+        {
+            To.y = From.y;
+        }
+        else if (Trial % 5 == 0)
+        {
+            To.x = From.x;
+        }
+        else if (Trial % 7 == 0)
+        {
+            To = From;
+        }
+
+        TestStroke(&Test, From, To, TestRandomRange(1, 12), TestRandomRange(1, 30));
+    }
+
+    BenchStroke();
+
+    return TestResult();
+}
@@ -0,0 +1,250 @@
+// TestTextLines.c
+// Author: Joseph Ryan Ries, 2017-2020
+// Checks the ink counts against a pixel by pixel count, and that lines of made-up text are found where they were
+// drawn, including in part of a bigger image. Then times finding them in a page of text two 4K monitors wide.
+
+#include <windows.h>
+
+#include "SnipExTextLines.h"
+
+#include "Test.h"
+
+#define PAGE_COLOR 0xFFF8F8F0
+
+#define INK_COLOR  0xFF202020
+
+
+static BOOL IsInkReference(UINT32 Pixel, UINT32 Background)
+{
+    for (UINT32 Shift = 0; Shift < 24; Shift += 8)
+    {
+        if (abs((INT32)((Pixel >> Shift) & 0xFF) - (INT32)((Background >> Shift) & 0xFF)) > TEXT_INK_THRESHOLD)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+static void TestRowInkProfile(void)
+{
+    enum { Stride = 80, Height = 6 };
+
+    UINT32 Pixels[Stride * Height];
+
+    UINT32 Profile[Height];
+
+    for (INT32 Width = 0; Width <= Stride; Width++)
+    {
+        UINT32 Background = (TestRandom() << 8) ^ TestRandom();
+
+        for (INT32 Index = 0; Index < Stride * Height; Index++)
+        {
+            // Some near the background and some far from it, with alpha that must never count.
+            UINT32 Noise = (TestRandom() % 2) ? TestRandom() & 0x3F3F3F : TestRandom() & 0xFFFFFF;
+
+            Pixels[Index] = ((Background & 0xFFFFFF) ^ Noise) | (TestRandom() << 24);
+        }
+
+        GetRowInkProfile(Pixels, Width, Height, Stride, Background, Profile);
+
+        for (INT32 Y = 0; Y < Height; Y++)
+        {
+            UINT32 Expected = 0;
+
+            for (INT32 X = 0; X < Width; X++)
+            {
+                Expected += (UINT32)IsInkReference(Pixels[Y * Stride + X], Background);
+            }
+
+            CHECK_EQUAL(Expected, Profile[Y]);
+        }
+    }
+}
+
+
+// Draws a line of text Height rows tall at Top: blobs of ink with gaps between them, like words, and a row
+// with nothing in it a third of the way down, like the gap under the dot of an i.
+static void DrawTextLine(UINT32* Pixels, INT32 Width, INT32 Stride, INT32 Top, INT32 Height)
+{
+    for (INT32 Y = Top; Y < Top + Height; Y++)
+    {
+        if (Y == Top + Height / 3 && Height >= 6)
+        {
+            continue;
+        }
+
+        for (INT32 X = 10; X < Width - 10; X++)
+        {
+            if ((X / 3) % 4 != 3 && (X / 40) % 5 != 4)
+            {
+                Pixels[(SIZE_T)Y * Stride + X] = INK_COLOR;
+            }
+        }
+    }
+}
+
+
+static void TestFindTextLines(void)
+{
+    // The snip is in the middle of a bigger image, with a border down the left, like a window's, in every row.
+    enum { Stride = 700, ImageHeight = 400, Left = 50, Top = 20, Width = 600, Height = 360 };
+
+    static const TEXTLINE Drawn[] = { { 10, 14 }, { 40, 14 }, { 70, 20 }, { 120, 6 }, { 150, 30 }, { 300, 9 } };
+
+    UINT32* Image = malloc((SIZE_T)Stride * ImageHeight * sizeof(UINT32));
+
+    UINT32* Snip = &Image[Top * Stride + Left];
+
+    TEXTLINES TextLines;
+
+    for (INT32 Index = 0; Index < Stride * ImageHeight; Index++)
+    {
+        // Outside the snip is all ink, which mustn't be looked at.
+        Image[Index] = 0xFF000000;
+    }
+
+    for (INT32 Y = 0; Y < Height; Y++)
+    {
+        for (INT32 X = 0; X < Width; X++)
+        {
+            Snip[Y * Stride + X] = (X < 2) ? 0xFF808080 : PAGE_COLOR;
+        }
+    }
+
+    for (UINT32 Index = 0; Index < _countof(Drawn); Index++)
+    {
+        DrawTextLine(Snip, Width, Stride, Drawn[Index].Top, Drawn[Index].Height);
+    }
+
+    // Two rows with a speck of dust in them, which aren't a line of text.
+    Snip[200 * Stride + 300] = INK_COLOR;
+
+    Snip[201 * Stride + 300] = INK_COLOR;
+
+    CHECK_EQUAL(PAGE_COLOR, GetBackgroundColor(Snip, Width, Height, Stride));
+
+    CHECK(FindTextLines(Snip, Width, Height, Stride, &TextLines));
+
+    CHECK_EQUAL(_countof(Drawn), TextLines.Count);
+
+    for (UINT32 Index = 0; Index < min(TextLines.Count, _countof(Drawn)); Index++)
+    {
+        CHECK_EQUAL(Drawn[Index].Top, TextLines.Lines[Index].Top);
+
+        CHECK_EQUAL(Drawn[Index].Height, TextLines.Lines[Index].Height);
+    }
+
+    // In a line, between two lines, and too far from any.
+    const TEXTLINE* Nearest = FindNearestTextLine(&TextLines, 45, TEXT_LINE_SNAP_DISTANCE);
+
+    CHECK(Nearest != NULL && Nearest->Top == 40);
+
+    Nearest = FindNearestTextLine(&TextLines, 27, TEXT_LINE_SNAP_DISTANCE);
+
+    CHECK(Nearest != NULL && Nearest->Top == 10);
+
+    Nearest = FindNearestTextLine(&TextLines, 33, TEXT_LINE_SNAP_DISTANCE);
+
+    CHECK(Nearest != NULL && Nearest->Top == 40);
+
+    CHECK(FindNearestTextLine(&TextLines, 240, TEXT_LINE_SNAP_DISTANCE) == NULL);
+
+    CHECK(FindNearestTextLine(&TextLines, 5, 0) == NULL);
+
+    CHECK(FindNearestTextLine(&TextLines, Height + 100, TEXT_LINE_SNAP_DISTANCE) == NULL);
+
+    FreeTextLines(&TextLines);
+
+    CHECK(TextLines.Lines == NULL);
+
+    // Nothing but background has no lines in it.
+    CHECK(FindTextLines(&Snip[(Height - 40) * Stride], Width, 40, Stride, &TextLines));
+
+    CHECK_EQUAL(0, TextLines.Count);
+
+    CHECK(FindNearestTextLine(&TextLines, 10, TEXT_LINE_SNAP_DISTANCE) == NULL);
+
+    FreeTextLines(&TextLines);
+
+    free(Image);
+}
+
+
+static void ReportSpeed(const char* What, INT32 Width, INT32 Height, double Seconds)
+{
+    printf("%-18s %d x %d  %7.3f ms  %9.0f rows/s  %6.0f MB/s\n", What, Width, Height, Seconds * 1000.0, Height / Seconds, (double)Width * Height * sizeof(UINT32) / Seconds / (1024 * 1024));
+}
+
+
+// A line of text every 24 rows across a 7680 x 2160 page, which is what the hilighter's background thread has to
+// look through when someone snips both of two 4K monitors.
+static void BenchFindTextLines(void)
+{
+    enum { Width = 7680, Height = 2160, Spacing = 24, LineHeight = 14, Repeats = 5 };
+
+    UINT32* Page = malloc((SIZE_T)Width * Height * sizeof(UINT32));
+
+    UINT32* Profile = malloc(Height * sizeof(UINT32));
+
+    TEXTLINES TextLines;
+
+    for (SIZE_T Index = 0; Index < (SIZE_T)Width * Height; Index++)
+    {
+        Page[Index] = PAGE_COLOR;
+    }
+
+    for (INT32 Top = Spacing / 2; Top + LineHeight <= Height; Top += Spacing)
+    {
+        DrawTextLine(Page, Width, Width, Top, LineHeight);
+    }
+
+    double Start = TestSeconds();
+
+    for (UINT32 Repeat = 0; Repeat < Repeats; Repeat++)
+    {
+        CHECK_EQUAL(PAGE_COLOR, GetBackgroundColor(Page, Width, Height, Width));
+    }
+
+    ReportSpeed("GetBackgroundColor", Width, Height, (TestSeconds() - Start) / Repeats);
+
+    Start = TestSeconds();
+
+    for (UINT32 Repeat = 0; Repeat < Repeats; Repeat++)
+    {
+        GetRowInkProfile(Page, Width, Height, Width, PAGE_COLOR, Profile);
+    }
+
+    ReportSpeed("GetRowInkProfile", Width, Height, (TestSeconds() - Start) / Repeats);
+
+    Start = TestSeconds();
+
+    for (UINT32 Repeat = 0; Repeat < Repeats; Repeat++)
+    {
+        CHECK(FindTextLines(Page, Width, Height, Width, &TextLines));
+
+        CHECK_EQUAL((Height - Spacing / 2 - LineHeight) / Spacing + 1, (INT32)TextLines.Count);
+
+        FreeTextLines(&TextLines);
+    }
+
+    ReportSpeed("FindTextLines", Width, Height, (TestSeconds() - Start) / Repeats);
+
+    free(Profile);
+
+    free(Page);
+}
+
+
+int main(void)
+{
+    TestRowInkProfile();
+
+    TestFindTextLines();
+
+    BenchFindTextLines();
+
+    return TestResult();
+}
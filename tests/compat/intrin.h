@@ -0,0 +1,57 @@
+// intrin.h
+// Author: Joseph Ryan Ries, 2017-2020
+// The MSVC intrinsics that SnipEx's portable modules use, written with GCC and Clang builtins.
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static inline unsigned char _BitScanForward(unsigned long* Index, unsigned long Mask)
+{
+    if (Mask == 0)
+    {
+        return 0;
+    }
+
+    *Index = (unsigned long)__builtin_ctzl(Mask);
+
+    return 1;
+}
+
+static inline unsigned char _BitScanReverse(unsigned long* Index, unsigned long Mask)
+{
+    if (Mask == 0)
+    {
+        return 0;
+    }
+
+    *Index = (unsigned long)(8 * sizeof(unsigned long) - 1 - __builtin_clzl(Mask));
+
+    return 1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline void __cpuidex(int Info[4], int Leaf, int Subleaf)
+{
+    __asm__ __volatile__("cpuid" : "=a"(Info[0]), "=b"(Info[1]), "=c"(Info[2]), "=d"(Info[3]) : "a"(Leaf), "c"(Subleaf));
+}
+
+static inline void __cpuid(int Info[4], int Leaf)
+{
+    __cpuidex(Info, Leaf, 0);
+}
+
+static inline void __stosd(unsigned long* Destination, unsigned long Data, size_t Count)
+{
+    uint32_t* Target = (uint32_t*)Destination;
+
+    for (size_t Index = 0; Index < Count; Index++)
+    {
+        Target[Index] = (uint32_t)Data;
+    }
+}
+#endif
@@ -0,0 +1,1047 @@
+// windows.h
+// Author: Joseph Ryan Ries, 2017-2020
+// The parts of the Windows API that SnipEx's portable modules use, written on top of POSIX, so that those modules
+// and their tests build and run with GCC or Clang on Linux. Only what the modules use is here, and it only behaves
+// as much like Windows as the tests need. Nothing in here is part of SnipEx itself.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+// The modules pick their SIMD code by the compiler's target, the way MSVC names it.
+#if defined(__x86_64__) && !defined(_M_X64)
+#define _M_X64 100
+#elif defined(__i386__) && !defined(_M_IX86)
+#define _M_IX86 600
+#elif defined(__aarch64__) && !defined(_M_ARM64)
+#define _M_ARM64 1
+#endif
+
+#define __forceinline inline __attribute__((always_inline))
+
+#define WINAPI
+
+#define CALLBACK
+
+#define UNREFERENCED_PARAMETER(Parameter) (void)(Parameter)
+
+#define _countof(Array) (sizeof(Array) / sizeof((Array)[0]))
+
+#ifndef min
+#define min(A, B) (((A) < (B)) ? (A) : (B))
+#endif
+
+#ifndef max
+#define max(A, B) (((A) > (B)) ? (A) : (B))
+#endif
+
+// Annotations.
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Inout_opt_
+#define _In_reads_(Count)
+#define _In_reads_bytes_(Count)
+#define _In_reads_opt_(Count)
+#define _Out_writes_(Count)
+#define _Out_writes_bytes_(Count)
+#define _Out_writes_opt_(Count)
+#define _Inout_updates_(Count)
+#define _Inout_updates_bytes_(Count)
+#define _Outptr_
+#define _Outptr_result_maybenull_
+#define _Success_(Expression)
+#define _Ret_maybenull_
+
+// Types.
+typedef int BOOL;
+
+typedef unsigned char BYTE;
+
+typedef int8_t INT8;
+
+typedef uint8_t UINT8;
+
+typedef int16_t INT16;
+
+typedef uint16_t UINT16;
+
+typedef int32_t INT32;
+
+typedef uint32_t UINT32;
+
+typedef int64_t INT64;
+
+typedef uint64_t UINT64;
+
+typedef uint32_t DWORD;
+
+typedef uint16_t WORD;
+
+typedef int32_t LONG;
+
+typedef uint32_t ULONG;
+
+typedef uint32_t UINT;
+
+typedef size_t SIZE_T;
+
+typedef intptr_t SSIZE_T;
+
+typedef uintptr_t UINT_PTR;
+
+typedef intptr_t INT_PTR;
+
+typedef uintptr_t ULONG_PTR;
+
+typedef void* LPVOID;
+
+typedef void* HANDLE;
+
+typedef union LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+
+        LONG  HighPart;
+    };
+
+    long long QuadPart;
+
+} LARGE_INTEGER;
+
+typedef struct POINT
+{
+    LONG x;
+
+    LONG y;
+
+} POINT;
+
+typedef struct RECT
+{
+    LONG left;
+
+    LONG top;
+
+    LONG right;
+
+    LONG bottom;
+
+} RECT, *LPRECT;
+
+typedef struct SYSTEM_INFO
+{
+    DWORD dwNumberOfProcessors;
+
+} SYSTEM_INFO;
+
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID Parameter);
+
+#define TRUE                     1
+#define FALSE                    0
+
+#define MAXUINT16                0xFFFF
+#define MAXUINT32                0xFFFFFFFFu
+#define MAXDWORD                 0xFFFFFFFFu
+#define MAXINT32                 INT32_MAX
+#define MININT32                 INT32_MIN
+#define MAXINT64                 INT64_MAX
+#define MAXUINT64                UINT64_MAX
+#define MAXSIZE_T                SIZE_MAX
+#define MAX_PATH                 260
+
+#define HEAP_ZERO_MEMORY         0x00000008
+
+#define INFINITE                 0xFFFFFFFF
+#define WAIT_OBJECT_0            0
+#define WAIT_TIMEOUT             258
+#define WAIT_FAILED              0xFFFFFFFF
+
+#define INVALID_HANDLE_VALUE     ((HANDLE)(intptr_t)-1)
+
+#define GENERIC_READ             0x80000000
+#define GENERIC_WRITE            0x40000000
+#define FILE_SHARE_READ          0x00000001
+#define FILE_SHARE_WRITE         0x00000002
+#define FILE_SHARE_DELETE        0x00000004
+#define CREATE_NEW               1
+#define CREATE_ALWAYS            2
+#define OPEN_EXISTING            3
+#define OPEN_ALWAYS              4
+#define FILE_ATTRIBUTE_NORMAL    0x00000080
+#define FILE_ATTRIBUTE_TEMPORARY 0x00000100
+#define FILE_FLAG_DELETE_ON_CLOSE 0x04000000
+
+#define PAGE_READWRITE           0x04
+#define FILE_MAP_ALL_ACCESS      0x000F001F
+#define FILE_MAP_READ            0x00000004
+#define FILE_MAP_WRITE           0x00000002
+
+#define CP_UTF8                  65001
+
+#define PF_XMMI64_INSTRUCTIONS_AVAILABLE 10
+
+#define CopyMemory(Destination, Source, Length)  memcpy((Destination), (Source), (Length))
+#define MoveMemory(Destination, Source, Length)  memmove((Destination), (Source), (Length))
+#define FillMemory(Destination, Length, Fill)    memset((Destination), (Fill), (Length))
+#define ZeroMemory(Destination, Length)          memset((Destination), 0, (Length))
+
+// Memory. There's only the one heap.
+static inline HANDLE GetProcessHeap(void)
+{
+    return (HANDLE)1;
+}
+
+static inline void* HeapAlloc(HANDLE Heap, DWORD Flags, SIZE_T Size)
+{
+    (void)Heap;
+
+    return (Flags & HEAP_ZERO_MEMORY) ? calloc(1, Size ? Size : 1) : malloc(Size ? Size : 1);
+}
+
+static inline void* HeapReAlloc(HANDLE Heap, DWORD Flags, void* Memory, SIZE_T Size)
+{
+    (void)Heap;
+
+    (void)Flags;
+
+    return realloc(Memory, Size ? Size : 1);
+}
+
+static inline BOOL HeapFree(HANDLE Heap, DWORD Flags, void* Memory)
+{
+    (void)Heap;
+
+    (void)Flags;
+
+    free(Memory);
+
+    return TRUE;
+}
+
+// Rectangles.
+static inline BOOL IsRectEmpty(const RECT* Rect)
+{
+    return Rect->left >= Rect->right || Rect->top >= Rect->bottom;
+}
+
+static inline BOOL SetRect(RECT* Rect, int Left, int Top, int Right, int Bottom)
+{
+    Rect->left = Left;
+
+    Rect->top = Top;
+
+    Rect->right = Right;
+
+    Rect->bottom = Bottom;
+
+    return TRUE;
+}
+
+static inline BOOL SetRectEmpty(RECT* Rect)
+{
+    return SetRect(Rect, 0, 0, 0, 0);
+}
+
+static inline BOOL OffsetRect(RECT* Rect, int X, int Y)
+{
+    return SetRect(Rect, Rect->left + X, Rect->top + Y, Rect->right + X, Rect->bottom + Y);
+}
+
+static inline BOOL InflateRect(RECT* Rect, int X, int Y)
+{
+    return SetRect(Rect, Rect->left - X, Rect->top - Y, Rect->right + X, Rect->bottom + Y);
+}
+
+static inline BOOL EqualRect(const RECT* A, const RECT* B)
+{
+    return A->left == B->left && A->top == B->top && A->right == B->right && A->bottom == B->bottom;
+}
+
+static inline BOOL IntersectRect(RECT* Result, const RECT* A, const RECT* B)
+{
+    RECT Overlap = { max(A->left, B->left), max(A->top, B->top), min(A->right, B->right), min(A->bottom, B->bottom) };
+
+    if (IsRectEmpty(&Overlap))
+    {
+        SetRectEmpty(Result);
+
+        return FALSE;
+    }
+
+    *Result = Overlap;
+
+    return TRUE;
+}
+
+static inline BOOL UnionRect(RECT* Result, const RECT* A, const RECT* B)
+{
+    if (IsRectEmpty(A) && IsRectEmpty(B))
+    {
+        SetRectEmpty(Result);
+
+        return FALSE;
+    }
+
+    if (IsRectEmpty(A) || IsRectEmpty(B))
+    {
+        *Result = IsRectEmpty(A) ? *B : *A;
+
+        return TRUE;
+    }
+
+    return SetRect(Result, min(A->left, B->left), min(A->top, B->top), max(A->right, B->right), max(A->bottom, B->bottom));
+}
+
+static inline int MulDiv(int Number, int Numerator, int Denominator)
+{
+    long long Product = (long long)Number * Numerator;
+
+    long long Half = (Denominator < 0 ? -(long long)Denominator : Denominator) / 2;
+
+    if (Denominator == 0)
+    {
+        return -1;
+    }
+
+    return (int)(((Product < 0) == (Denominator < 0) ? Product + Half : Product - Half) / Denominator);
+}
+
+// Interlocked operations, all full barriers, as they are on Windows.
+static inline LONG InterlockedIncrement(volatile LONG* Value)
+{
+    return __atomic_add_fetch(Value, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedDecrement(volatile LONG* Value)
+{
+    return __atomic_sub_fetch(Value, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedExchange(volatile LONG* Value, LONG New)
+{
+    return __atomic_exchange_n(Value, New, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedExchangeAdd(volatile LONG* Value, LONG Add)
+{
+    return __atomic_fetch_add(Value, Add, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedCompareExchange(volatile LONG* Value, LONG New, LONG Comparand)
+{
+    __atomic_compare_exchange_n(Value, &Comparand, New, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+    return Comparand;
+}
+
+static inline void Sleep(DWORD Milliseconds)
+{
+    if (Milliseconds == 0)
+    {
+        sched_yield();
+    }
+    else
+    {
+        usleep((useconds_t)Milliseconds * 1000);
+    }
+}
+
+static inline DWORD GetTickCount(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+
+    return (DWORD)((UINT64)Now.tv_sec * 1000 + (UINT64)Now.tv_nsec / 1000000);
+}
+
+static inline void GetSystemInfo(SYSTEM_INFO* SystemInfo)
+{
+    // The tests can pretend to have more or fewer processors than there are.
+    const char* Override = getenv("SNIPEX_TEST_CPUS");
+
+    long Count = (Override != NULL) ? atol(Override) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    SystemInfo->dwNumberOfProcessors = (DWORD)max(Count, 1L);
+}
+
+static inline BOOL IsProcessorFeaturePresent(DWORD Feature)
+{
+    (void)Feature;
+
+#if defined(__SSE2__) || defined(__aarch64__)
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+// Critical sections.
+typedef pthread_mutex_t CRITICAL_SECTION;
+
+static inline void InitializeCriticalSection(CRITICAL_SECTION* Section)
+{
+    pthread_mutex_init(Section, NULL);
+}
+
+static inline void DeleteCriticalSection(CRITICAL_SECTION* Section)
+{
+    pthread_mutex_destroy(Section);
+}
+
+static inline void EnterCriticalSection(CRITICAL_SECTION* Section)
+{
+    pthread_mutex_lock(Section);
+}
+
+static inline void LeaveCriticalSection(CRITICAL_SECTION* Section)
+{
+    pthread_mutex_unlock(Section);
+}
+
+// Handles. Every handle starts with its kind. Threads and events are waited on under one lock and one condition,
+// which is slow, but makes waiting on several of them at once simple.
+typedef enum COMPATHANDLEKIND
+{
+    COMPAT_THREAD = 0x5E1,
+
+    COMPAT_EVENT,
+
+    COMPAT_FILE,
+
+    COMPAT_MAPPING
+
+} COMPATHANDLEKIND;
+
+typedef struct COMPATTHREAD
+{
+    COMPATHANDLEKIND      Kind;
+
+    pthread_t             Thread;
+
+    LPTHREAD_START_ROUTINE Start;
+
+    LPVOID                Parameter;
+
+    BOOL                  Finished;
+
+} COMPATTHREAD;
+
+typedef struct COMPATEVENT
+{
+    COMPATHANDLEKIND Kind;
+
+    BOOL             ManualReset;
+
+    BOOL             Signaled;
+
+} COMPATEVENT;
+
+typedef struct COMPATFILE
+{
+    COMPATHANDLEKIND Kind;
+
+    int              Descriptor;
+
+} COMPATFILE;
+
+typedef struct COMPATMAPPING
+{
+    COMPATHANDLEKIND Kind;
+
+    int              Descriptor;
+
+} COMPATMAPPING;
+
+// Every handle is allocated as big as the biggest kind, so that looking at one as the wrong kind is harmless.
+typedef union COMPATHANDLE
+{
+    COMPATTHREAD  Thread;
+
+    COMPATEVENT   Event;
+
+    COMPATFILE    File;
+
+    COMPATMAPPING Mapping;
+
+} COMPATHANDLE;
+
+static pthread_mutex_t gCompatLock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t gCompatChanged = PTHREAD_COND_INITIALIZER;
+
+static void* CompatThreadMain(void* Parameter)
+{
+    COMPATTHREAD* Thread = Parameter;
+
+    Thread->Start(Thread->Parameter);
+
+    pthread_mutex_lock(&gCompatLock);
+
+    Thread->Finished = TRUE;
+
+    pthread_cond_broadcast(&gCompatChanged);
+
+    pthread_mutex_unlock(&gCompatLock);
+
+    return NULL;
+}
+
+static inline HANDLE CreateThread(void* Security, SIZE_T StackSize, LPTHREAD_START_ROUTINE Start, LPVOID Parameter, DWORD Flags, DWORD* ThreadId)
+{
+    COMPATTHREAD* Thread = calloc(1, sizeof(COMPATHANDLE));
+
+    (void)Security;
+
+    (void)StackSize;
+
+    (void)Flags;
+
+    if (Thread == NULL)
+    {
+        return NULL;
+    }
+
+    Thread->Kind = COMPAT_THREAD;
+
+    Thread->Start = Start;
+
+    Thread->Parameter = Parameter;
+
+    if (pthread_create(&Thread->Thread, NULL, CompatThreadMain, Thread) != 0)
+    {
+        free(Thread);
+
+        return NULL;
+    }
+
+    if (ThreadId != NULL)
+    {
+        *ThreadId = 0;
+    }
+
+    return Thread;
+}
+
+static inline HANDLE CreateEventW(void* Security, BOOL ManualReset, BOOL InitialState, const wchar_t* Name)
+{
+    COMPATEVENT* Event = calloc(1, sizeof(COMPATHANDLE));
+
+    (void)Security;
+
+    (void)Name;
+
+    if (Event != NULL)
+    {
+        Event->Kind = COMPAT_EVENT;
+
+        Event->ManualReset = ManualReset;
+
+        Event->Signaled = InitialState;
+    }
+
+    return Event;
+}
+
+static inline BOOL SetEvent(HANDLE Handle)
+{
+    pthread_mutex_lock(&gCompatLock);
+
+    ((COMPATEVENT*)Handle)->Signaled = TRUE;
+
+    pthread_cond_broadcast(&gCompatChanged);
+
+    pthread_mutex_unlock(&gCompatLock);
+
+    return TRUE;
+}
+
+static inline BOOL ResetEvent(HANDLE Handle)
+{
+    pthread_mutex_lock(&gCompatLock);
+
+    ((COMPATEVENT*)Handle)->Signaled = FALSE;
+
+    pthread_mutex_unlock(&gCompatLock);
+
+    return TRUE;
+}
+
+// Called with gCompatLock held.
+static inline BOOL CompatIsSignaled(HANDLE Handle)
+{
+    if (*(COMPATHANDLEKIND*)Handle == COMPAT_THREAD)
+    {
+        return ((COMPATTHREAD*)Handle)->Finished;
+    }
+
+    return ((COMPATEVENT*)Handle)->Signaled;
+}
+
+// Called with gCompatLock held, once the wait is satisfied by Handle.
+static inline void CompatConsume(HANDLE Handle)
+{
+    if (*(COMPATHANDLEKIND*)Handle == COMPAT_EVENT && ((COMPATEVENT*)Handle)->ManualReset == FALSE)
+    {
+        ((COMPATEVENT*)Handle)->Signaled = FALSE;
+    }
+}
+
+static inline DWORD WaitForMultipleObjects(DWORD Count, const HANDLE* Handles, BOOL WaitAll, DWORD Milliseconds)
+{
+    struct timespec Deadline;
+
+    DWORD Result = WAIT_TIMEOUT;
+
+    clock_gettime(CLOCK_REALTIME, &Deadline);
+
+    if (Milliseconds != INFINITE)
+    {
+        Deadline.tv_sec += Milliseconds / 1000;
+
+        Deadline.tv_nsec += (long)(Milliseconds % 1000) * 1000000;
+
+        if (Deadline.tv_nsec >= 1000000000)
+        {
+            Deadline.tv_sec++;
+
+            Deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&gCompatLock);
+
+    for (;;)
+    {
+        DWORD Signaled = 0;
+
+        DWORD First = Count;
+
+        for (DWORD Index = 0; Index < Count; Index++)
+        {
+            if (CompatIsSignaled(Handles[Index]))
+            {
+                Signaled++;
+
+                First = min(First, Index);
+            }
+        }
+
+        if (WaitAll ? (Signaled == Count) : (Signaled > 0))
+        {
+            for (DWORD Index = 0; Index < Count; Index++)
+            {
+                if (WaitAll || Index == First)
+                {
+                    CompatConsume(Handles[Index]);
+                }
+            }
+
+            Result = WaitAll ? WAIT_OBJECT_0 : WAIT_OBJECT_0 + First;
+
+            break;
+        }
+
+        if (Milliseconds == INFINITE)
+        {
+            pthread_cond_wait(&gCompatChanged, &gCompatLock);
+        }
+        else if (pthread_cond_timedwait(&gCompatChanged, &gCompatLock, &Deadline) == ETIMEDOUT)
+        {
+            Result = WAIT_TIMEOUT;
+
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&gCompatLock);
+
+    return Result;
+}
+
+static inline DWORD WaitForSingleObject(HANDLE Handle, DWORD Milliseconds)
+{
+    return WaitForMultipleObjects(1, &Handle, TRUE, Milliseconds);
+}
+
+// Files. Paths are wide strings on Windows and bytes here; the tests only use plain ASCII paths.
+static inline void CompatGetPath(const wchar_t* Path, char* Buffer, size_t BufferSize)
+{
+    size_t Length = wcstombs(Buffer, Path, BufferSize - 1);
+
+    Buffer[(Length == (size_t)-1) ? 0 : min(Length, BufferSize - 1)] = '\0';
+}
+
+static inline HANDLE CreateFileW(const wchar_t* Path, DWORD Access, DWORD Share, void* Security, DWORD Disposition, DWORD Flags, HANDLE Template)
+{
+    char NarrowPath[4 * MAX_PATH];
+
+    int OpenFlags = (Access & GENERIC_WRITE) ? O_RDWR : O_RDONLY;
+
+    COMPATFILE* File = NULL;
+
+    (void)Share;
+
+    (void)Security;
+
+    (void)Template;
+
+    CompatGetPath(Path, NarrowPath, sizeof(NarrowPath));
+
+    switch (Disposition)
+    {
+        case CREATE_NEW:    OpenFlags |= O_CREAT | O_EXCL;  break;
+        case CREATE_ALWAYS: OpenFlags |= O_CREAT | O_TRUNC; break;
+        case OPEN_ALWAYS:   OpenFlags |= O_CREAT;           break;
+        default:                                            break;
+    }
+
+    int Descriptor = open(NarrowPath, OpenFlags | O_CLOEXEC, 0600);
+
+    if (Descriptor < 0)
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+
+    // POSIX lets the name go while the file is still open, which is as good as deleting it on close.
+    if (Flags & FILE_FLAG_DELETE_ON_CLOSE)
+    {
+        unlink(NarrowPath);
+    }
+
+    File = calloc(1, sizeof(COMPATHANDLE));
+
+    if (File == NULL)
+    {
+        close(Descriptor);
+
+        return INVALID_HANDLE_VALUE;
+    }
+
+    File->Kind = COMPAT_FILE;
+
+    File->Descriptor = Descriptor;
+
+    return File;
+}
+
+static inline BOOL ReadFile(HANDLE Handle, void* Buffer, DWORD Size, DWORD* Read, void* Overlapped)
+{
+    ssize_t Result = read(((COMPATFILE*)Handle)->Descriptor, Buffer, Size);
+
+    (void)Overlapped;
+
+    *Read = (Result < 0) ? 0 : (DWORD)Result;
+
+    return Result >= 0;
+}
+
+static inline BOOL WriteFile(HANDLE Handle, const void* Buffer, DWORD Size, DWORD* Written, void* Overlapped)
+{
+    ssize_t Result = write(((COMPATFILE*)Handle)->Descriptor, Buffer, Size);
+
+    (void)Overlapped;
+
+    *Written = (Result < 0) ? 0 : (DWORD)Result;
+
+    return Result >= 0;
+}
+
+static inline BOOL FlushFileBuffers(HANDLE Handle)
+{
+    return fsync(((COMPATFILE*)Handle)->Descriptor) == 0;
+}
+
+static inline BOOL GetFileSizeEx(HANDLE Handle, LARGE_INTEGER* Size)
+{
+    struct stat Status;
+
+    if (fstat(((COMPATFILE*)Handle)->Descriptor, &Status) != 0)
+    {
+        return FALSE;
+    }
+
+    Size->QuadPart = Status.st_size;
+
+    return TRUE;
+}
+
+static inline BOOL DeleteFileW(const wchar_t* Path)
+{
+    char NarrowPath[4 * MAX_PATH];
+
+    CompatGetPath(Path, NarrowPath, sizeof(NarrowPath));
+
+    return unlink(NarrowPath) == 0;
+}
+
+static inline DWORD GetTempPathW(DWORD BufferLength, wchar_t* Buffer)
+{
+    const char* Directory = getenv("TMPDIR");
+
+    int Length = swprintf(Buffer, BufferLength, L"%s/", (Directory != NULL && Directory[0] != '\0') ? Directory : "/tmp");
+
+    return (Length < 0) ? 0 : (DWORD)Length;
+}
+
+static inline UINT GetTempFileNameW(const wchar_t* Directory, const wchar_t* Prefix, UINT Unique, wchar_t* Name)
+{
+    static volatile LONG Counter;
+
+    (void)Unique;
+
+    for (;;)
+    {
+        swprintf(Name, MAX_PATH, L"%ls%.3ls%d_%d.tmp", Directory, Prefix, (int)getpid(), (int)InterlockedIncrement(&Counter));
+
+        // Like Windows, make the file, so that nobody else gets the same name.
+        HANDLE File = CreateFileW(Name, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if (File != INVALID_HANDLE_VALUE)
+        {
+            close(((COMPATFILE*)File)->Descriptor);
+
+            free(File);
+
+            return 1;
+        }
+
+        if (errno != EEXIST)
+        {
+            return 0;
+        }
+    }
+}
+
+static inline HANDLE CreateFileMappingW(HANDLE File, void* Security, DWORD Protection, DWORD SizeHigh, DWORD SizeLow, const wchar_t* Name)
+{
+    COMPATMAPPING* Mapping = NULL;
+
+    struct stat Status;
+
+    off_t Size = (off_t)(((UINT64)SizeHigh << 32) | SizeLow);
+
+    (void)Security;
+
+    (void)Protection;
+
+    (void)Name;
+
+    if (fstat(((COMPATFILE*)File)->Descriptor, &Status) != 0)
+    {
+        return NULL;
+    }
+
+    // Like Windows, mapping more than the file holds makes the file bigger.
+    if (Size > Status.st_size && ftruncate(((COMPATFILE*)File)->Descriptor, Size) != 0)
+    {
+        return NULL;
+    }
+
+    Mapping = calloc(1, sizeof(COMPATHANDLE));
+
+    if (Mapping != NULL)
+    {
+        Mapping->Kind = COMPAT_MAPPING;
+
+        Mapping->Descriptor = dup(((COMPATFILE*)File)->Descriptor);
+    }
+
+    return Mapping;
+}
+
+// munmap needs the size of the view, which UnmapViewOfFile isn't given, so every view is remembered here.
+typedef struct COMPATVIEW
+{
+    void*              Address;
+
+    SIZE_T             Size;
+
+    struct COMPATVIEW* Next;
+
+} COMPATVIEW;
+
+static COMPATVIEW* gCompatViews;
+
+static inline void* MapViewOfFile(HANDLE Mapping, DWORD Access, DWORD OffsetHigh, DWORD OffsetLow, SIZE_T Size)
+{
+    COMPATVIEW* View = calloc(1, sizeof(COMPATVIEW));
+
+    off_t Offset = (off_t)(((UINT64)OffsetHigh << 32) | OffsetLow);
+
+    int Protection = (Access & (FILE_MAP_WRITE | FILE_MAP_ALL_ACCESS)) ? PROT_READ | PROT_WRITE : PROT_READ;
+
+    if (View == NULL)
+    {
+        return NULL;
+    }
+
+    if (Size == 0)
+    {
+        struct stat Status;
+
+        fstat(((COMPATMAPPING*)Mapping)->Descriptor, &Status);
+
+        Size = (SIZE_T)(Status.st_size - Offset);
+    }
+
+    View->Address = mmap(NULL, Size, Protection, MAP_SHARED, ((COMPATMAPPING*)Mapping)->Descriptor, Offset);
+
+    if (View->Address == MAP_FAILED)
+    {
+        free(View);
+
+        return NULL;
+    }
+
+    View->Size = Size;
+
+    pthread_mutex_lock(&gCompatLock);
+
+    View->Next = gCompatViews;
+
+    gCompatViews = View;
+
+    pthread_mutex_unlock(&gCompatLock);
+
+    return View->Address;
+}
+
+static inline BOOL UnmapViewOfFile(const void* Address)
+{
+    COMPATVIEW* View = NULL;
+
+    pthread_mutex_lock(&gCompatLock);
+
+    for (COMPATVIEW** Link = &gCompatViews; *Link != NULL; Link = &(*Link)->Next)
+    {
+        if ((*Link)->Address == Address)
+        {
+            View = *Link;
+
+            *Link = View->Next;
+
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&gCompatLock);
+
+    if (View == NULL)
+    {
+        return FALSE;
+    }
+
+    munmap(View->Address, View->Size);
+
+    free(View);
+
+    return TRUE;
+}
+
+static inline BOOL CloseHandle(HANDLE Handle)
+{
+    switch (*(COMPATHANDLEKIND*)Handle)
+    {
+        case COMPAT_THREAD:
+        {
+            // Windows lets a running thread's handle be closed. The tests never do that, so this can join it.
+            pthread_join(((COMPATTHREAD*)Handle)->Thread, NULL);
+
+            break;
+        }
+        case COMPAT_FILE:
+        {
+            close(((COMPATFILE*)Handle)->Descriptor);
+
+            break;
+        }
+        case COMPAT_MAPPING:
+        {
+            close(((COMPATMAPPING*)Handle)->Descriptor);
+
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    free(Handle);
+
+    return TRUE;
+}
+
+// Strings.
+static inline int MultiByteToWideChar(UINT CodePage, DWORD Flags, const char* Source, int SourceLength, wchar_t* Destination, int DestinationLength)
+{
+    (void)CodePage;
+
+    (void)Flags;
+
+    if (SourceLength < 0)
+    {
+        SourceLength = (int)strlen(Source) + 1;
+    }
+
+    if (DestinationLength == 0)
+    {
+        return SourceLength;
+    }
+
+    if (SourceLength > DestinationLength)
+    {
+        return 0;
+    }
+
+    // Good enough for ASCII, which is all the tests use.
+    for (int Index = 0; Index < SourceLength; Index++)
+    {
+        Destination[Index] = (unsigned char)Source[Index];
+    }
+
+    return SourceLength;
+}
+
+static inline int wcscpy_s(wchar_t* Destination, size_t DestinationLength, const wchar_t* Source)
+{
+    if (wcslen(Source) >= DestinationLength)
+    {
+        return ERANGE;
+    }
+
+    wcscpy(Destination, Source);
+
+    return 0;
+}
+
+static inline int wcscat_s(wchar_t* Destination, size_t DestinationLength, const wchar_t* Source)
+{
+    if (wcslen(Destination) + wcslen(Source) >= DestinationLength)
+    {
+        return ERANGE;
+    }
+
+    wcscat(Destination, Source);
+
+    return 0;
+}